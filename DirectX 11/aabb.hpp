@@ -0,0 +1,78 @@
+#pragma once
+
+//
+// NOTE(georgy): Axis aligned bounding box as min and max corners, and the overlap tests the spatial structures share.
+//
+
+struct aabb
+{
+	v3 Min;
+	v3 Max;
+};
+
+inline aabb
+AABBFromCenterExtent(v3 Center, v3 Extent)
+{
+	aabb Result = {Center - Extent, Center + Extent};
+	return(Result);
+}
+
+inline aabb
+Union(aabb A, aabb B)
+{
+	aabb Result;
+	Result.Min = V3(fminf(A.Min.x, B.Min.x), fminf(A.Min.y, B.Min.y), fminf(A.Min.z, B.Min.z));
+	Result.Max = V3(fmaxf(A.Max.x, B.Max.x), fmaxf(A.Max.y, B.Max.y), fmaxf(A.Max.z, B.Max.z));
+	return(Result);
+}
+
+// NOTE(georgy): Half the surface area, SAH only compares areas so the factor doesn't matter
+inline real32
+SurfaceArea(aabb A)
+{
+	v3 D = A.Max - A.Min;
+	real32 Result = D.x*D.y + D.y*D.z + D.z*D.x;
+	return(Result);
+}
+
+inline bool
+Contains(aabb Outer, aabb Inner)
+{
+	bool Result = (Outer.Min.x <= Inner.Min.x) && (Outer.Min.y <= Inner.Min.y) && (Outer.Min.z <= Inner.Min.z) &&
+				  (Inner.Max.x <= Outer.Max.x) && (Inner.Max.y <= Outer.Max.y) && (Inner.Max.z <= Outer.Max.z);
+	return(Result);
+}
+
+inline bool
+operator==(aabb A, aabb B)
+{
+	bool Result = (A.Min.x == B.Min.x) && (A.Min.y == B.Min.y) && (A.Min.z == B.Min.z) &&
+				  (A.Max.x == B.Max.x) && (A.Max.y == B.Max.y) && (A.Max.z == B.Max.z);
+	return(Result);
+}
+
+// NOTE(georgy): Slab test. InvDirection is 1/Direction per component, infinities for 0 components work out.
+// On a hit T is where the ray enters the box (0 if it starts inside).
+inline bool
+RayIntersectsAABB(aabb Box, v3 Origin, v3 InvDirection, real32 MaxT, real32 *T)
+{
+	real32 TX0 = (Box.Min.x - Origin.x)*InvDirection.x, TX1 = (Box.Max.x - Origin.x)*InvDirection.x;
+	real32 TY0 = (Box.Min.y - Origin.y)*InvDirection.y, TY1 = (Box.Max.y - Origin.y)*InvDirection.y;
+	real32 TZ0 = (Box.Min.z - Origin.z)*InvDirection.z, TZ1 = (Box.Max.z - Origin.z)*InvDirection.z;
+	real32 TEnter = fmaxf(fmaxf(fminf(TX0, TX1), fminf(TY0, TY1)), fmaxf(fminf(TZ0, TZ1), 0.0f));
+	real32 TExit = fminf(fminf(fmaxf(TX0, TX1), fmaxf(TY0, TY1)), fminf(fmaxf(TZ0, TZ1), MaxT));
+	*T = TEnter;
+	bool Result = (TEnter <= TExit);
+	return(Result);
+}
+
+inline bool
+SphereIntersectsAABB(aabb Box, v3 Center, real32 Radius)
+{
+	v3 Closest = V3(fminf(fmaxf(Center.x, Box.Min.x), Box.Max.x),
+					fminf(fmaxf(Center.y, Box.Min.y), Box.Max.y),
+					fminf(fmaxf(Center.z, Box.Min.z), Box.Max.z));
+	v3 D = Center - Closest;
+	bool Result = (Dot(D, D) <= Radius*Radius);
+	return(Result);
+}
@@ -0,0 +1,501 @@
+#pragma once
+
+#include "memory_arena.hpp"
+#include "aabb.hpp"
+#include "frustum.hpp"
+
+//
+// NOTE(georgy): Dynamic AABB tree (bounding volume hierarchy) over object bounds, for broadphase queries.
+//
+// Leaves hold a fattened copy of the object's box, so an object that moves a little doesn't touch the tree at all.
+// Inserting walks down from the root to the node where the new leaf adds the least surface area (SAH),
+// then walks back up refitting the boxes. On the way up every node tries swapping one of its children with
+// a grandchild under the other child, and does it if that makes the changed child's box smaller.
+// Those rotations keep the tree close to a good SAH tree without ever rebuilding it.
+//
+// Nodes live in one fixed pool with a free list. A leaf's node index is the handle the caller keeps for the object.
+//
+
+#define AABB_TREE_NULL_NODE 0xFFFFFFFF
+#define AABB_TREE_STACK_SIZE 256
+
+struct aabb_tree_node
+{
+	aabb Box;
+
+	// NOTE(georgy): Next free node while the node is on the free list
+	uint32_t Parent;
+	uint32_t Children[2];
+
+	// NOTE(georgy): Leaves are 0, free nodes -1
+	int32_t Height;
+	uint32_t Object;
+};
+
+struct aabb_tree
+{
+	uint32_t Root;
+	uint32_t FreeList;
+	uint32_t MaxNodeCount;
+	uint32_t NodeCount;
+	uint32_t LeafCount;
+	aabb_tree_node *Nodes;
+
+	// NOTE(georgy): How much leaf boxes are grown on every side
+	real32 Margin;
+
+	uint64_t RotationCount;
+};
+
+// NOTE(georgy): A binary tree with N leaves has N - 1 inner nodes
+static void
+InitializeAABBTree(aabb_tree *Tree, memory_arena *Arena, uint32_t MaxLeafCount, real32 Margin)
+{
+	*Tree = {};
+	Tree->Root = AABB_TREE_NULL_NODE;
+	Tree->MaxNodeCount = 2*MaxLeafCount;
+	Tree->Nodes = PushArray(Arena, Tree->MaxNodeCount, aabb_tree_node);
+	Tree->Margin = Margin;
+
+	for(uint32_t NodeIndex = 0; NodeIndex < Tree->MaxNodeCount; NodeIndex++)
+	{
+		Tree->Nodes[NodeIndex].Parent = NodeIndex + 1;
+		Tree->Nodes[NodeIndex].Height = -1;
+	}
+	Tree->Nodes[Tree->MaxNodeCount - 1].Parent = AABB_TREE_NULL_NODE;
+	Tree->FreeList = 0;
+}
+
+inline bool
+IsLeaf(aabb_tree_node *Node)
+{
+	bool Result = (Node->Children[0] == AABB_TREE_NULL_NODE);
+	return(Result);
+}
+
+static uint32_t
+AllocateAABBTreeNode(aabb_tree *Tree)
+{
+	Assert(Tree->FreeList != AABB_TREE_NULL_NODE);
+
+	uint32_t Result = Tree->FreeList;
+	aabb_tree_node *Node = Tree->Nodes + Result;
+	Tree->FreeList = Node->Parent;
+	Tree->NodeCount++;
+
+	Node->Parent = AABB_TREE_NULL_NODE;
+	Node->Children[0] = Node->Children[1] = AABB_TREE_NULL_NODE;
+	Node->Height = 0;
+	Node->Object = 0;
+
+	return(Result);
+}
+
+inline void
+FreeAABBTreeNode(aabb_tree *Tree, uint32_t NodeIndex)
+{
+	Tree->Nodes[NodeIndex].Parent = Tree->FreeList;
+	Tree->Nodes[NodeIndex].Height = -1;
+	Tree->FreeList = NodeIndex;
+	Tree->NodeCount--;
+}
+
+inline void
+RefitAABBTreeNode(aabb_tree *Tree, uint32_t NodeIndex)
+{
+	aabb_tree_node *Node = Tree->Nodes + NodeIndex;
+	aabb_tree_node *A = Tree->Nodes + Node->Children[0];
+	aabb_tree_node *B = Tree->Nodes + Node->Children[1];
+	Node->Box = Union(A->Box, B->Box);
+	Node->Height = 1 + ((A->Height > B->Height) ? A->Height : B->Height);
+}
+
+// NOTE(georgy): Tries the 4 swaps of a child of Node with a grandchild under its other child. Node's box doesn't change,
+// only the box of the child that gets a new child, so the best swap is the one that shrinks that box the most.
+static void
+RotateAABBTreeNode(aabb_tree *Tree, uint32_t NodeIndex)
+{
+	aabb_tree_node *Node = Tree->Nodes + NodeIndex;
+	if(Node->Height < 2)
+	{
+		return;
+	}
+
+	real32 BestAreaChange = 0.0f;
+	uint32_t BestChild = 0, BestGrandchild = 0;
+	for(uint32_t Child = 0; Child < 2; Child++)
+	{
+		aabb_tree_node *Moved = Tree->Nodes + Node->Children[Child];
+		aabb_tree_node *Other = Tree->Nodes + Node->Children[1 - Child];
+		if(IsLeaf(Other))
+		{
+			continue;
+		}
+
+		real32 OtherArea = SurfaceArea(Other->Box);
+		for(uint32_t Grandchild = 0; Grandchild < 2; Grandchild++)
+		{
+			// NOTE(georgy): After the swap Other holds Moved and the grandchild that stays
+			aabb_tree_node *Stays = Tree->Nodes + Other->Children[1 - Grandchild];
+			real32 AreaChange = SurfaceArea(Union(Moved->Box, Stays->Box)) - OtherArea;
+			if(AreaChange < BestAreaChange)
+			{
+				BestAreaChange = AreaChange;
+				BestChild = Child;
+				BestGrandchild = Grandchild;
+			}
+		}
+	}
+
+	if(BestAreaChange < 0.0f)
+	{
+		uint32_t MovedIndex = Node->Children[BestChild];
+		uint32_t OtherIndex = Node->Children[1 - BestChild];
+		aabb_tree_node *Other = Tree->Nodes + OtherIndex;
+		uint32_t GrandchildIndex = Other->Children[BestGrandchild];
+
+		Node->Children[BestChild] = GrandchildIndex;
+		Tree->Nodes[GrandchildIndex].Parent = NodeIndex;
+		Other->Children[BestGrandchild] = MovedIndex;
+		Tree->Nodes[MovedIndex].Parent = OtherIndex;
+
+		RefitAABBTreeNode(Tree, OtherIndex);
+		RefitAABBTreeNode(Tree, NodeIndex);
+		Tree->RotationCount++;
+	}
+}
+
+// NOTE(georgy): Refits the nodes from NodeIndex up, rotating on the way. A rotation never changes the rotated node's own box,
+// so once a node comes out with the same box and height as before nothing above it can change and the walk stops.
+// Small objects in a crowded part of the tree usually stop a few levels up instead of going all the way to the root.
+static void
+RefitAABBTreeAncestors(aabb_tree *Tree, uint32_t NodeIndex)
+{
+	while(NodeIndex != AABB_TREE_NULL_NODE)
+	{
+		aabb_tree_node *Node = Tree->Nodes + NodeIndex;
+		aabb OldBox = Node->Box;
+		int32_t OldHeight = Node->Height;
+
+		RefitAABBTreeNode(Tree, NodeIndex);
+		RotateAABBTreeNode(Tree, NodeIndex);
+		if((Node->Box == OldBox) && (Node->Height == OldHeight))
+		{
+			break;
+		}
+		NodeIndex = Node->Parent;
+	}
+}
+
+static void
+InsertAABBTreeLeaf(aabb_tree *Tree, uint32_t Leaf)
+{
+	if(Tree->Root == AABB_TREE_NULL_NODE)
+	{
+		Tree->Root = Leaf;
+		Tree->Nodes[Leaf].Parent = AABB_TREE_NULL_NODE;
+		return;
+	}
+
+	// NOTE(georgy): Going down a level costs the area the leaf adds to the node, stopping here costs a new parent
+	// over this node and the leaf. Go down into the child where the leaf adds the least until stopping is cheaper.
+	aabb LeafBox = Tree->Nodes[Leaf].Box;
+	uint32_t Sibling = Tree->Root;
+	while(!IsLeaf(Tree->Nodes + Sibling))
+	{
+		aabb_tree_node *Node = Tree->Nodes + Sibling;
+		real32 CombinedArea = SurfaceArea(Union(Node->Box, LeafBox));
+		real32 Cost = 2.0f*CombinedArea;
+		real32 InheritedCost = 2.0f*(CombinedArea - SurfaceArea(Node->Box));
+
+		real32 ChildCosts[2];
+		for(uint32_t Child = 0; Child < 2; Child++)
+		{
+			aabb_tree_node *ChildNode = Tree->Nodes + Node->Children[Child];
+			real32 ChildCombinedArea = SurfaceArea(Union(ChildNode->Box, LeafBox));
+			ChildCosts[Child] = InheritedCost + (IsLeaf(ChildNode) ? ChildCombinedArea : (ChildCombinedArea - SurfaceArea(ChildNode->Box)));
+		}
+
+		if((Cost < ChildCosts[0]) && (Cost < ChildCosts[1]))
+		{
+			break;
+		}
+		Sibling = Node->Children[(ChildCosts[0] <= ChildCosts[1]) ? 0 : 1];
+	}
+
+	uint32_t OldParent = Tree->Nodes[Sibling].Parent;
+	uint32_t NewParent = AllocateAABBTreeNode(Tree);
+	aabb_tree_node *Parent = Tree->Nodes + NewParent;
+	Parent->Parent = OldParent;
+	Parent->Children[0] = Sibling;
+	Parent->Children[1] = Leaf;
+	Tree->Nodes[Sibling].Parent = NewParent;
+	Tree->Nodes[Leaf].Parent = NewParent;
+	if(OldParent == AABB_TREE_NULL_NODE)
+	{
+		Tree->Root = NewParent;
+	}
+	else
+	{
+		aabb_tree_node *Grandparent = Tree->Nodes + OldParent;
+		Grandparent->Children[(Grandparent->Children[0] == Sibling) ? 0 : 1] = NewParent;
+	}
+
+	// NOTE(georgy): The new parent has no old box to compare against, it's always refitted
+	RefitAABBTreeNode(Tree, NewParent);
+	RotateAABBTreeNode(Tree, NewParent);
+	RefitAABBTreeAncestors(Tree, OldParent);
+}
+
+// NOTE(georgy): The leaf's parent goes away and its sibling takes the parent's place
+static void
+RemoveAABBTreeLeaf(aabb_tree *Tree, uint32_t Leaf)
+{
+	if(Leaf == Tree->Root)
+	{
+		Tree->Root = AABB_TREE_NULL_NODE;
+		return;
+	}
+
+	uint32_t ParentIndex = Tree->Nodes[Leaf].Parent;
+	aabb_tree_node *Parent = Tree->Nodes + ParentIndex;
+	uint32_t Grandparent = Parent->Parent;
+	uint32_t Sibling = Parent->Children[(Parent->Children[0] == Leaf) ? 1 : 0];
+
+	Tree->Nodes[Sibling].Parent = Grandparent;
+	if(Grandparent == AABB_TREE_NULL_NODE)
+	{
+		Tree->Root = Sibling;
+	}
+	else
+	{
+		aabb_tree_node *GrandparentNode = Tree->Nodes + Grandparent;
+		GrandparentNode->Children[(GrandparentNode->Children[0] == ParentIndex) ? 0 : 1] = Sibling;
+	}
+	FreeAABBTreeNode(Tree, ParentIndex);
+
+	RefitAABBTreeAncestors(Tree, Grandparent);
+}
+
+inline aabb
+FattenAABB(aabb_tree *Tree, aabb Box)
+{
+	v3 Margin = V3(Tree->Margin, Tree->Margin, Tree->Margin);
+	aabb Result = {Box.Min - Margin, Box.Max + Margin};
+	return(Result);
+}
+
+// NOTE(georgy): Returns the leaf, that's the object's handle for moving and removing it
+static uint32_t
+AddAABBTreeObject(aabb_tree *Tree, uint32_t Object, aabb Box)
+{
+	uint32_t Result = AllocateAABBTreeNode(Tree);
+	Tree->Nodes[Result].Box = FattenAABB(Tree, Box);
+	Tree->Nodes[Result].Object = Object;
+	InsertAABBTreeLeaf(Tree, Result);
+	Tree->LeafCount++;
+
+	return(Result);
+}
+
+static void
+RemoveAABBTreeObject(aabb_tree *Tree, uint32_t Leaf)
+{
+	Assert(IsLeaf(Tree->Nodes + Leaf));
+
+	RemoveAABBTreeLeaf(Tree, Leaf);
+	FreeAABBTreeNode(Tree, Leaf);
+	Tree->LeafCount--;
+}
+
+// NOTE(georgy): Nothing happens while the new box is still inside the leaf's fat box.
+// Returns whether the leaf had to be reinserted.
+static bool
+MoveAABBTreeObject(aabb_tree *Tree, uint32_t Leaf, aabb Box)
+{
+	aabb_tree_node *Node = Tree->Nodes + Leaf;
+	Assert(IsLeaf(Node));
+
+	bool Result = !Contains(Node->Box, Box);
+	if(Result)
+	{
+		RemoveAABBTreeLeaf(Tree, Leaf);
+		Node->Box = FattenAABB(Tree, Box);
+		InsertAABBTreeLeaf(Tree, Leaf);
+	}
+
+	return(Result);
+}
+
+//
+// NOTE(georgy): Queries. They write the objects of the leaves they find to Objects and return how many there are.
+// Leaves are fat, so the results can include objects that are just outside, the caller tests its own bounds if it cares.
+//
+
+// NOTE(georgy): Inner nodes completely inside the frustum hand over all their leaves without testing them
+#define AABB_TREE_INSIDE_FLAG 0x80000000
+
+static uint32_t
+QueryAABBTreeFrustum(aabb_tree *Tree, frustum *Frustum, uint32_t *Objects, uint32_t MaxObjectCount)
+{
+	uint32_t Result = 0;
+	if(Tree->Root == AABB_TREE_NULL_NODE)
+	{
+		return(Result);
+	}
+
+	uint32_t Stack[AABB_TREE_STACK_SIZE];
+	uint32_t StackCount = 0;
+	Stack[StackCount++] = Tree->Root;
+	while(StackCount)
+	{
+		uint32_t Entry = Stack[--StackCount];
+		uint32_t NodeIndex = Entry & ~AABB_TREE_INSIDE_FLAG;
+		aabb_tree_node *Node = Tree->Nodes + NodeIndex;
+
+		uint32_t Inside = Entry & AABB_TREE_INSIDE_FLAG;
+		if(!Inside)
+		{
+			frustum_test Test = TestBoxFrustum(Frustum, 0.5f*(Node->Box.Min + Node->Box.Max), 0.5f*(Node->Box.Max - Node->Box.Min));
+			if(Test == FrustumTest_Outside)
+			{
+				continue;
+			}
+			Inside = (Test == FrustumTest_Inside) ? AABB_TREE_INSIDE_FLAG : 0;
+		}
+
+		if(IsLeaf(Node))
+		{
+			Assert(Result < MaxObjectCount);
+			Objects[Result++] = Node->Object;
+		}
+		else
+		{
+			Assert(StackCount + 2 <= AABB_TREE_STACK_SIZE);
+			Stack[StackCount++] = Node->Children[1] | Inside;
+			Stack[StackCount++] = Node->Children[0] | Inside;
+		}
+	}
+
+	return(Result);
+}
+
+static uint32_t
+QueryAABBTreeSphere(aabb_tree *Tree, v3 Center, real32 Radius, uint32_t *Objects, uint32_t MaxObjectCount)
+{
+	uint32_t Result = 0;
+	if(Tree->Root == AABB_TREE_NULL_NODE)
+	{
+		return(Result);
+	}
+
+	uint32_t Stack[AABB_TREE_STACK_SIZE];
+	uint32_t StackCount = 0;
+	Stack[StackCount++] = Tree->Root;
+	while(StackCount)
+	{
+		aabb_tree_node *Node = Tree->Nodes + Stack[--StackCount];
+		if(SphereIntersectsAABB(Node->Box, Center, Radius))
+		{
+			if(IsLeaf(Node))
+			{
+				Assert(Result < MaxObjectCount);
+				Objects[Result++] = Node->Object;
+			}
+			else
+			{
+				Assert(StackCount + 2 <= AABB_TREE_STACK_SIZE);
+				Stack[StackCount++] = Node->Children[1];
+				Stack[StackCount++] = Node->Children[0];
+			}
+		}
+	}
+
+	return(Result);
+}
+
+// NOTE(georgy): Called for every leaf the ray reaches before the closest hit so far. Returns where the ray hits
+// the object, or something >= MaxT if it misses, e.g. the object's exact bounds or triangles instead of the fat box.
+typedef real32 aabb_tree_raycast_function(uint32_t Object, v3 Origin, v3 Direction, real32 MaxT, void *UserData);
+
+// NOTE(georgy): Closest hit along Origin + T*Direction for T in [0, MaxT). Returns the object or AABB_TREE_NULL_NODE.
+static uint32_t
+RaycastAABBTree(aabb_tree *Tree, v3 Origin, v3 Direction, real32 MaxT, aabb_tree_raycast_function *Function, void *UserData, real32 *HitT = 0)
+{
+	uint32_t Result = AABB_TREE_NULL_NODE;
+	if(Tree->Root == AABB_TREE_NULL_NODE)
+	{
+		return(Result);
+	}
+
+	v3 InvDirection = V3(1.0f / Direction.x, 1.0f / Direction.y, 1.0f / Direction.z);
+	uint32_t Stack[AABB_TREE_STACK_SIZE];
+	uint32_t StackCount = 0;
+	Stack[StackCount++] = Tree->Root;
+	while(StackCount)
+	{
+		aabb_tree_node *Node = Tree->Nodes + Stack[--StackCount];
+		real32 T;
+		if(!RayIntersectsAABB(Node->Box, Origin, InvDirection, MaxT, &T))
+		{
+			continue;
+		}
+
+		if(IsLeaf(Node))
+		{
+			real32 ObjectT = Function(Node->Object, Origin, Direction, MaxT, UserData);
+			if(ObjectT < MaxT)
+			{
+				MaxT = ObjectT;
+				Result = Node->Object;
+			}
+		}
+		else
+		{
+			// NOTE(georgy): Nearer child on top, so its hits shorten the ray before the other child is tested
+			uint32_t Children[2] = {Node->Children[0], Node->Children[1]};
+			real32 T0, T1;
+			bool Hit0 = RayIntersectsAABB(Tree->Nodes[Children[0]].Box, Origin, InvDirection, MaxT, &T0);
+			bool Hit1 = RayIntersectsAABB(Tree->Nodes[Children[1]].Box, Origin, InvDirection, MaxT, &T1);
+			uint32_t Near = (!Hit1 || (Hit0 && (T0 <= T1))) ? 0 : 1;
+			Assert(StackCount + 2 <= AABB_TREE_STACK_SIZE);
+			if(Hit0 || Hit1)
+			{
+				if(Hit0 && Hit1)
+				{
+					Stack[StackCount++] = Children[1 - Near];
+				}
+				Stack[StackCount++] = Children[Near];
+			}
+		}
+	}
+
+	if(HitT)
+	{
+		*HitT = MaxT;
+	}
+	return(Result);
+}
+
+// NOTE(georgy): Sum of the inner nodes' areas relative to the root's, what SAH says a query costs (lower is better)
+static real32
+GetAABBTreeCost(aabb_tree *Tree)
+{
+	real32 Result = 0.0f;
+	if(Tree->Root != AABB_TREE_NULL_NODE)
+	{
+		real32 InnerArea = 0.0f;
+		for(uint32_t NodeIndex = 0; NodeIndex < Tree->MaxNodeCount; NodeIndex++)
+		{
+			aabb_tree_node *Node = Tree->Nodes + NodeIndex;
+			if((Node->Height > 0))
+			{
+				InnerArea += SurfaceArea(Node->Box);
+			}
+		}
+		real32 RootArea = SurfaceArea(Tree->Nodes[Tree->Root].Box);
+		Result = (RootArea > 0.0f) ? (InnerArea / RootArea) : 0.0f;
+	}
+
+	return(Result);
+}
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+//
+// NOTE(georgy): Heap allocation tracker.
+// Counts heap allocations and bytes per tag, both in total and per frame. The tag comes from the innermost
+// alloc_scope on the allocating thread. Scopes can have budgets; with ALLOC_TRACKER_ASSERT_BUDGETS
+// an allocation that takes any scope on the thread over its budget asserts right away, so the debugger
+// stops on the offending callstack.
+// Frees aren't counted: the tag would have to be the allocation's, and the debug CRT's hook doesn't give us the pointer
+// when it allocates, so there's nothing to remember it by. A realloc is one allocation of the new size.
+// This header replaces global operator new/delete (and malloc where we can), so include it in one translation unit only.
+//
+
+#ifndef ALLOC_TRACKER
+#define ALLOC_TRACKER 0
+#endif
+
+#ifndef ALLOC_TRACKER_ASSERT_BUDGETS
+#define ALLOC_TRACKER_ASSERT_BUDGETS 0
+#endif
+
+#define ALLOC_TRACKER_HISTORY_FRAMES 256
+
+enum alloc_tag
+{
+	AllocTag_Untagged,
+	AllocTag_Loading,
+	AllocTag_SceneDedup,
+	AllocTag_Frame,
+	AllocTag_Reference,
+
+	AllocTag_Count
+};
+
+static const char *AllocTagNames[AllocTag_Count] =
+{
+	"Untagged",
+	"Loading",
+	"SceneDedup",
+	"Frame",
+	"Reference",
+};
+
+struct alloc_tag_stats
+{
+	uint64_t TotalAllocations;
+	uint64_t TotalBytes;
+
+	uint64_t LastFrameAllocations;
+	uint64_t LastFrameBytes;
+	uint64_t PeakFrameAllocations;
+	uint64_t PeakFrameBytes;
+};
+
+#if ALLOC_TRACKER
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#define ALLOC_TRACKER_MALLOC_HOOK 1
+#elif defined(__GLIBC__)
+#define ALLOC_TRACKER_MALLOC_HOOK 1
+#else
+#define ALLOC_TRACKER_MALLOC_HOOK 0
+#endif
+
+struct alloc_tag_counters
+{
+	std::atomic<uint64_t> TotalAllocations;
+	std::atomic<uint64_t> TotalBytes;
+
+	std::atomic<uint64_t> FrameAllocations;
+	std::atomic<uint64_t> FrameBytes;
+};
+
+struct alloc_frame_record
+{
+	uint64_t Allocations[AllocTag_Count];
+	uint64_t Bytes[AllocTag_Count];
+};
+
+struct alloc_tracker
+{
+	alloc_tag_counters Tags[AllocTag_Count];
+
+	// NOTE(georgy): Only touched by the thread that calls AllocTrackerEndFrame
+	uint64_t FrameIndex;
+	uint64_t PeakFrameAllocations[AllocTag_Count];
+	uint64_t PeakFrameBytes[AllocTag_Count];
+	alloc_frame_record History[ALLOC_TRACKER_HISTORY_FRAMES];
+};
+
+// NOTE(georgy): Zero-initialized before any constructor runs, so allocations made during static initialization are fine
+static alloc_tracker GlobalAllocTracker;
+
+struct alloc_scope
+{
+	alloc_scope *Parent;
+	alloc_tag Tag;
+
+	uint64_t MaxAllocations;
+	uint64_t MaxBytes;
+	uint64_t Allocations;
+	uint64_t Bytes;
+
+	alloc_scope(alloc_tag Tag, uint64_t MaxAllocations = UINT64_MAX, uint64_t MaxBytes = UINT64_MAX);
+	~alloc_scope();
+};
+
+static thread_local alloc_scope *CurrentAllocScope;
+
+inline
+alloc_scope::alloc_scope(alloc_tag TagInit, uint64_t MaxAllocationsInit, uint64_t MaxBytesInit)
+{
+	Parent = CurrentAllocScope;
+	Tag = TagInit;
+	MaxAllocations = MaxAllocationsInit;
+	MaxBytes = MaxBytesInit;
+	Allocations = 0;
+	Bytes = 0;
+
+	CurrentAllocScope = this;
+}
+
+inline
+alloc_scope::~alloc_scope()
+{
+	Assert(CurrentAllocScope == this);
+	CurrentAllocScope = Parent;
+}
+
+static void
+RecordAllocation(size_t Size)
+{
+	alloc_scope *Scope = CurrentAllocScope;
+	alloc_tag Tag = Scope ? Scope->Tag : AllocTag_Untagged;
+
+	alloc_tag_counters *Counters = GlobalAllocTracker.Tags + Tag;
+	Counters->TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+	Counters->TotalBytes.fetch_add(Size, std::memory_order_relaxed);
+	Counters->FrameAllocations.fetch_add(1, std::memory_order_relaxed);
+	Counters->FrameBytes.fetch_add(Size, std::memory_order_relaxed);
+
+	// NOTE(georgy): Allocations count against every enclosing scope's budget, not only the innermost one
+	for(; Scope; Scope = Scope->Parent)
+	{
+		Scope->Allocations++;
+		Scope->Bytes += Size;
+#if ALLOC_TRACKER_ASSERT_BUDGETS
+		Assert(Scope->Allocations <= Scope->MaxAllocations);
+		Assert(Scope->Bytes <= Scope->MaxBytes);
+#endif
+	}
+}
+
+//
+// NOTE(georgy): Hooks
+//
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+// NOTE(georgy): Debug CRT calls us for every malloc/realloc/free, including the ones operator new makes. Only allocations count.
+static int
+AllocTrackerCRTHook(int AllocType, void *UserData, size_t Size, int BlockType, long RequestNumber, const unsigned char *Filename, int LineNumber)
+{
+	if((BlockType != _CRT_BLOCK) && ((AllocType == _HOOK_ALLOC) || (AllocType == _HOOK_REALLOC)))
+	{
+		RecordAllocation(Size);
+	}
+
+	return(TRUE);
+}
+#elif defined(__GLIBC__)
+// NOTE(georgy): glibc lets the executable interpose the allocator, we forward to the real one. free stays glibc's.
+extern "C" void *__libc_malloc(size_t Size);
+extern "C" void *__libc_calloc(size_t Count, size_t Size);
+extern "C" void *__libc_realloc(void *Pointer, size_t Size);
+
+extern "C" void *
+malloc(size_t Size) noexcept
+{
+	RecordAllocation(Size);
+	return(__libc_malloc(Size));
+}
+
+extern "C" void *
+calloc(size_t Count, size_t Size) noexcept
+{
+	RecordAllocation(Count*Size);
+	return(__libc_calloc(Count, Size));
+}
+
+extern "C" void *
+realloc(void *Pointer, size_t Size) noexcept
+{
+	RecordAllocation(Size);
+	return(__libc_realloc(Pointer, Size));
+}
+#endif
+
+static void *
+TrackedNew(size_t Size)
+{
+#if !ALLOC_TRACKER_MALLOC_HOOK
+	RecordAllocation(Size);
+#endif
+	void *Result = malloc(Size ? Size : 1);
+	if(!Result)
+	{
+		throw std::bad_alloc();
+	}
+	return(Result);
+}
+
+static void
+TrackedDelete(void *Pointer)
+{
+	free(Pointer);
+}
+
+void *operator new(size_t Size) { return(TrackedNew(Size)); }
+void *operator new[](size_t Size) { return(TrackedNew(Size)); }
+void *operator new(size_t Size, const std::nothrow_t &) noexcept { void *Result = 0; try { Result = TrackedNew(Size); } catch(...) {} return(Result); }
+void *operator new[](size_t Size, const std::nothrow_t &) noexcept { void *Result = 0; try { Result = TrackedNew(Size); } catch(...) {} return(Result); }
+void operator delete(void *Pointer) noexcept { TrackedDelete(Pointer); }
+void operator delete[](void *Pointer) noexcept { TrackedDelete(Pointer); }
+void operator delete(void *Pointer, size_t) noexcept { TrackedDelete(Pointer); }
+void operator delete[](void *Pointer, size_t) noexcept { TrackedDelete(Pointer); }
+void operator delete(void *Pointer, const std::nothrow_t &) noexcept { TrackedDelete(Pointer); }
+void operator delete[](void *Pointer, const std::nothrow_t &) noexcept { TrackedDelete(Pointer); }
+
+inline void
+InitializeAllocTracker(void)
+{
+#if defined(_MSC_VER) && defined(_DEBUG)
+	_CrtSetAllocHook(AllocTrackerCRTHook);
+#endif
+}
+
+// NOTE(georgy): Call once per frame from one thread. Allocations that race with it land in either frame.
+static void
+AllocTrackerEndFrame(void)
+{
+	alloc_frame_record *Record = GlobalAllocTracker.History + (GlobalAllocTracker.FrameIndex % ALLOC_TRACKER_HISTORY_FRAMES);
+	for(uint32_t Tag = 0; Tag < AllocTag_Count; Tag++)
+	{
+		alloc_tag_counters *Counters = GlobalAllocTracker.Tags + Tag;
+		uint64_t Allocations = Counters->FrameAllocations.exchange(0, std::memory_order_relaxed);
+		uint64_t Bytes = Counters->FrameBytes.exchange(0, std::memory_order_relaxed);
+
+		Record->Allocations[Tag] = Allocations;
+		Record->Bytes[Tag] = Bytes;
+
+		// NOTE(georgy): Frame 0 also contains everything that happened during loading, so it doesn't count for peaks
+		if(GlobalAllocTracker.FrameIndex > 0)
+		{
+			GlobalAllocTracker.PeakFrameAllocations[Tag] = (Allocations > GlobalAllocTracker.PeakFrameAllocations[Tag]) ? Allocations : GlobalAllocTracker.PeakFrameAllocations[Tag];
+			GlobalAllocTracker.PeakFrameBytes[Tag] = (Bytes > GlobalAllocTracker.PeakFrameBytes[Tag]) ? Bytes : GlobalAllocTracker.PeakFrameBytes[Tag];
+		}
+	}
+
+	GlobalAllocTracker.FrameIndex++;
+}
+
+static alloc_tag_stats
+GetAllocTagStats(alloc_tag Tag)
+{
+	alloc_tag_stats Result = {};
+
+	alloc_tag_counters *Counters = GlobalAllocTracker.Tags + Tag;
+	Result.TotalAllocations = Counters->TotalAllocations.load(std::memory_order_relaxed);
+	Result.TotalBytes = Counters->TotalBytes.load(std::memory_order_relaxed);
+	if(GlobalAllocTracker.FrameIndex > 0)
+	{
+		alloc_frame_record *LastRecord = GlobalAllocTracker.History + ((GlobalAllocTracker.FrameIndex - 1) % ALLOC_TRACKER_HISTORY_FRAMES);
+		Result.LastFrameAllocations = LastRecord->Allocations[Tag];
+		Result.LastFrameBytes = LastRecord->Bytes[Tag];
+	}
+	Result.PeakFrameAllocations = GlobalAllocTracker.PeakFrameAllocations[Tag];
+	Result.PeakFrameBytes = GlobalAllocTracker.PeakFrameBytes[Tag];
+
+	return(Result);
+}
+
+// NOTE(georgy): Per-frame counts for the last ALLOC_TRACKER_HISTORY_FRAMES frames, then the totals
+static bool
+DumpAllocTrackerCSV(const char *Filename)
+{
+	FILE *File = fopen(Filename, "w");
+	if(!File)
+	{
+		return(false);
+	}
+
+	fprintf(File, "Frame,Tag,Allocations,Bytes\n");
+	uint64_t FirstFrame = (GlobalAllocTracker.FrameIndex > ALLOC_TRACKER_HISTORY_FRAMES) ? (GlobalAllocTracker.FrameIndex - ALLOC_TRACKER_HISTORY_FRAMES) : 0;
+	for(uint64_t FrameIndex = FirstFrame; FrameIndex < GlobalAllocTracker.FrameIndex; FrameIndex++)
+	{
+		alloc_frame_record *Record = GlobalAllocTracker.History + (FrameIndex % ALLOC_TRACKER_HISTORY_FRAMES);
+		for(uint32_t Tag = 0; Tag < AllocTag_Count; Tag++)
+		{
+			fprintf(File, "%llu,%s,%llu,%llu\n", (unsigned long long)FrameIndex, AllocTagNames[Tag],
+					(unsigned long long)Record->Allocations[Tag], (unsigned long long)Record->Bytes[Tag]);
+		}
+	}
+
+	for(uint32_t Tag = 0; Tag < AllocTag_Count; Tag++)
+	{
+		alloc_tag_stats Stats = GetAllocTagStats((alloc_tag)Tag);
+		fprintf(File, "Total,%s,%llu,%llu\n", AllocTagNames[Tag], (unsigned long long)Stats.TotalAllocations, (unsigned long long)Stats.TotalBytes);
+	}
+
+	fclose(File);
+	return(true);
+}
+
+#else
+
+// NOTE(georgy): Tracker is compiled out, scopes still have to compile
+struct alloc_scope
+{
+	alloc_scope(alloc_tag Tag, uint64_t MaxAllocations = UINT64_MAX, uint64_t MaxBytes = UINT64_MAX) {}
+};
+
+inline void InitializeAllocTracker(void) {}
+inline void AllocTrackerEndFrame(void) {}
+inline alloc_tag_stats GetAllocTagStats(alloc_tag Tag) { alloc_tag_stats Result = {}; return(Result); }
+inline bool DumpAllocTrackerCSV(const char *Filename) { return(false); }
+
+#endif
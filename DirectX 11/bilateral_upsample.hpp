@@ -0,0 +1,97 @@
+#pragma once
+
+//
+// NOTE(georgy): Joint bilateral upsample of the RSM indirect illumination, DeferredPS.hlsl does exactly this per pixel.
+//
+// RSMPS.hlsl gathers at 1/Downsample of the screen resolution. Low resolution texel (X, Y) is computed for the full
+// resolution pixel (Downsample*X, Downsample*Y), so its depth and normal are just read from the G-buffer there.
+// A full resolution pixel takes the 4 low resolution texels around it with their bilinear weights,
+// times how close their depth and normal are to its own. Texels across a silhouette or a crease get ~0 weight,
+// and the indirect light doesn't bleed over edges like with plain bilinear filtering.
+// If no texel looks like the pixel (thin geometry that fell between the low resolution texels),
+// it takes the one closest in depth.
+//
+
+// NOTE(georgy): Width of the gaussian over the depth difference, relative to the pixel's depth
+#define BILATERAL_UPSAMPLE_DEPTH_SIGMA 0.02f
+#define BILATERAL_UPSAMPLE_NORMAL_POWER 16.0f
+#define BILATERAL_UPSAMPLE_MIN_WEIGHT 1e-4f
+
+inline real32
+GetBilateralUpsampleWeight(real32 Depth, v3 Normal, real32 TexelDepth, v3 TexelNormal)
+{
+	real32 DepthDifference = (TexelDepth - Depth) / (BILATERAL_UPSAMPLE_DEPTH_SIGMA*Depth);
+	real32 DepthWeight = expf(-DepthDifference*DepthDifference);
+	real32 NormalWeight = powf(fmaxf(Dot(Normal, TexelNormal), 0.0f), BILATERAL_UPSAMPLE_NORMAL_POWER);
+
+	real32 Result = DepthWeight*NormalWeight;
+	return(Result);
+}
+
+// NOTE(georgy): Depths and Normals are the full resolution G-buffer. Without DepthAware it's plain bilinear filtering.
+static v3
+BilateralUpsamplePixel(uint32_t X, uint32_t Y, uint32_t Width, real32 *Depths, v3 *Normals,
+					   v3 *LowColors, uint32_t LowWidth, uint32_t LowHeight, uint32_t Downsample, bool DepthAware = true)
+{
+	real32 Depth = Depths[Y*Width + X];
+	v3 Normal = Normals[Y*Width + X];
+
+	real32 LowX = (X + 0.5f) / Downsample - 0.5f;
+	real32 LowY = (Y + 0.5f) / Downsample - 0.5f;
+	int32_t BaseX = (int32_t)floorf(LowX);
+	int32_t BaseY = (int32_t)floorf(LowY);
+	real32 FractionX = LowX - BaseX;
+	real32 FractionY = LowY - BaseY;
+
+	v3 Sum = V3(0.0f, 0.0f, 0.0f);
+	real32 WeightSum = 0.0f;
+	v3 Closest = V3(0.0f, 0.0f, 0.0f);
+	real32 ClosestDepthDifference = FLT_MAX;
+	for(int32_t TapY = 0; TapY < 2; TapY++)
+	{
+		for(int32_t TapX = 0; TapX < 2; TapX++)
+		{
+			int32_t TexelX = BaseX + TapX;
+			int32_t TexelY = BaseY + TapY;
+			TexelX = (TexelX < 0) ? 0 : ((TexelX >= (int32_t)LowWidth) ? (int32_t)LowWidth - 1 : TexelX);
+			TexelY = (TexelY < 0) ? 0 : ((TexelY >= (int32_t)LowHeight) ? (int32_t)LowHeight - 1 : TexelY);
+
+			v3 Color = LowColors[TexelY*LowWidth + TexelX];
+			uint32_t Pixel = (Downsample*TexelY)*Width + Downsample*TexelX;
+
+			real32 Weight = (TapX ? FractionX : 1.0f - FractionX) * (TapY ? FractionY : 1.0f - FractionY);
+			if(DepthAware)
+			{
+				Weight *= GetBilateralUpsampleWeight(Depth, Normal, Depths[Pixel], Normals[Pixel]);
+			}
+			Sum += Weight*Color;
+			WeightSum += Weight;
+
+			real32 DepthDifference = fabsf(Depths[Pixel] - Depth);
+			if(DepthDifference < ClosestDepthDifference)
+			{
+				ClosestDepthDifference = DepthDifference;
+				Closest = Color;
+			}
+		}
+	}
+
+	v3 Result = (WeightSum > BILATERAL_UPSAMPLE_MIN_WEIGHT) ? (1.0f / WeightSum)*Sum : Closest;
+	return(Result);
+}
+
+// NOTE(georgy): LowWidth x LowHeight has to cover Width x Height, i.e. at least (Width + Downsample - 1) / Downsample
+static void
+BilateralUpsample(v3 *Dest, uint32_t Width, uint32_t Height, real32 *Depths, v3 *Normals,
+				  v3 *LowColors, uint32_t LowWidth, uint32_t LowHeight, uint32_t Downsample, bool DepthAware = true)
+{
+	Assert((Downsample*LowWidth >= Width) && (Downsample*LowHeight >= Height));
+
+	for(uint32_t Y = 0; Y < Height; Y++)
+	{
+		for(uint32_t X = 0; X < Width; X++)
+		{
+			Dest[Y*Width + X] = BilateralUpsamplePixel(X, Y, Width, Depths, Normals, LowColors, LowWidth, LowHeight, Downsample, DepthAware);
+		}
+	}
+}
@@ -0,0 +1,1611 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "graphics.hpp"
+
+//
+// NOTE(georgy): Command capture and replay.
+// The recorder sits between the renderer and a real graphics backend. It forwards every call and serializes
+// the ones made during the capture window into a binary stream. It also records every object created through
+// the device, so a capture can be replayed on its own against any backend, e.g. the null device in a tight loop.
+//
+// Stream: [u32 header: Type in the low 8 bits, payload size in the high 24][payload], payload is packed u32s
+// (handles are object IDs, 0 is null). Context calls use their graphics_call value as the type.
+//
+
+enum capture_command
+{
+	CaptureCommand_CreateBuffer = GraphicsCall_Count,
+	CaptureCommand_CreateTexture,
+	CaptureCommand_ImportTexture,
+	CaptureCommand_CreateVertexShader,
+	CaptureCommand_CreatePixelShader,
+	CaptureCommand_CreateInputLayout,
+	CaptureCommand_CreateDepthState,
+	CaptureCommand_CreateRasterState,
+	CaptureCommand_CreateBlendState,
+	CaptureCommand_CreateSampler,
+	CaptureCommand_CreateQuery,
+
+	CaptureCommand_Count
+};
+static_assert(CaptureCommand_Count <= 256, "Command type has to fit in 8 bits");
+
+#define CAPTURE_MAX_PAYLOAD_SIZE ((1 << 24) - 1)
+
+struct command_stream
+{
+	uint8_t *Base;
+	uint32_t Size;
+	uint32_t MaxSize;
+
+	bool Overflowed;
+};
+
+inline void
+InitializeCommandStream(command_stream *Stream, memory_arena *Arena, uint32_t MaxSize)
+{
+	Stream->Base = (uint8_t *)PushSize(Arena, MaxSize);
+	Stream->Size = 0;
+	Stream->MaxSize = MaxSize;
+	Stream->Overflowed = false;
+}
+
+inline void
+CaptureWrite(command_stream *Stream, const void *Data, uint32_t Size)
+{
+	if(Stream->Size + Size <= Stream->MaxSize)
+	{
+		memcpy(Stream->Base + Stream->Size, Data, Size);
+	}
+	else
+	{
+		Stream->Overflowed = true;
+	}
+	Stream->Size += Size;
+}
+
+inline void
+CaptureWriteU32(command_stream *Stream, uint32_t Value)
+{
+	CaptureWrite(Stream, &Value, sizeof(Value));
+}
+
+inline void
+CaptureWriteString(command_stream *Stream, const char *String)
+{
+	CaptureWrite(Stream, String, (uint32_t)strlen(String) + 1);
+}
+
+// NOTE(georgy): Returns where the header went, EndCaptureCommand patches the payload size in there
+inline uint32_t
+BeginCaptureCommand(command_stream *Stream, uint32_t Type)
+{
+	uint32_t Result = Stream->Size;
+	CaptureWriteU32(Stream, Type);
+	return(Result);
+}
+
+inline void
+EndCaptureCommand(command_stream *Stream, uint32_t HeaderOffset)
+{
+	if(Stream->Overflowed)
+	{
+		// NOTE(georgy): Drop the partial command, everything before it is still a valid stream
+		Stream->Size = HeaderOffset;
+	}
+	else
+	{
+		uint32_t PayloadSize = Stream->Size - HeaderOffset - sizeof(uint32_t);
+		Assert(PayloadSize <= CAPTURE_MAX_PAYLOAD_SIZE);
+
+		uint32_t Header;
+		memcpy(&Header, Stream->Base + HeaderOffset, sizeof(Header));
+		Header |= PayloadSize << 8;
+		memcpy(Stream->Base + HeaderOffset, &Header, sizeof(Header));
+	}
+}
+
+inline uint32_t
+CaptureReadU32(uint8_t **At)
+{
+	uint32_t Result;
+	memcpy(&Result, *At, sizeof(Result));
+	*At += sizeof(Result);
+	return(Result);
+}
+
+inline real32
+CaptureReadR32(uint8_t **At)
+{
+	real32 Result;
+	memcpy(&Result, *At, sizeof(Result));
+	*At += sizeof(Result);
+	return(Result);
+}
+
+// NOTE(georgy): Pipeline statistics go into the stream as pairs of u32s, low half first
+inline void
+CaptureWritePipelineStatistics(command_stream *Stream, gfx_pipeline_statistics *Statistics)
+{
+	uint64_t Values[3] = {Statistics->IAPrimitives, Statistics->VSInvocations, Statistics->PSInvocations};
+	for(uint32_t ValueIndex = 0; ValueIndex < ArrayCount(Values); ValueIndex++)
+	{
+		CaptureWriteU32(Stream, (uint32_t)Values[ValueIndex]);
+		CaptureWriteU32(Stream, (uint32_t)(Values[ValueIndex] >> 32));
+	}
+}
+
+inline const char *
+CaptureReadString(uint8_t **At)
+{
+	const char *Result = (const char *)*At;
+	*At += strlen(Result) + 1;
+	return(Result);
+}
+
+inline gfx_pipeline_statistics
+CaptureReadPipelineStatistics(uint8_t **At)
+{
+	uint64_t Values[3];
+	for(uint32_t ValueIndex = 0; ValueIndex < ArrayCount(Values); ValueIndex++)
+	{
+		uint64_t Low = CaptureReadU32(At);
+		uint64_t High = CaptureReadU32(At);
+		Values[ValueIndex] = Low | (High << 32);
+	}
+
+	gfx_pipeline_statistics Result;
+	Result.IAPrimitives = Values[0];
+	Result.VSInvocations = Values[1];
+	Result.PSInvocations = Values[2];
+	return(Result);
+}
+
+//
+// NOTE(georgy): Capture
+//
+
+struct capture
+{
+	uint32_t ObjectCount;
+	uint32_t FrameCount;
+
+	uint8_t *ResourceStream;
+	uint32_t ResourceStreamSize;
+	uint8_t *CommandStream;
+	uint32_t CommandStreamSize;
+};
+
+#define CAPTURE_FILE_MAGIC 0x50414347 // NOTE(georgy): "GCAP"
+#define CAPTURE_FILE_VERSION 5
+
+struct capture_file_header
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t ObjectCount;
+	uint32_t FrameCount;
+	uint32_t ResourceStreamSize;
+	uint32_t CommandStreamSize;
+};
+
+static bool
+WriteCaptureFile(capture *Capture, const char *Filename)
+{
+	bool Result = false;
+
+	FILE *File = fopen(Filename, "wb");
+	if(File)
+	{
+		capture_file_header Header;
+		Header.Magic = CAPTURE_FILE_MAGIC;
+		Header.Version = CAPTURE_FILE_VERSION;
+		Header.ObjectCount = Capture->ObjectCount;
+		Header.FrameCount = Capture->FrameCount;
+		Header.ResourceStreamSize = Capture->ResourceStreamSize;
+		Header.CommandStreamSize = Capture->CommandStreamSize;
+
+		Result = (fwrite(&Header, sizeof(Header), 1, File) == 1) &&
+				 (fwrite(Capture->ResourceStream, 1, Capture->ResourceStreamSize, File) == Capture->ResourceStreamSize) &&
+				 (fwrite(Capture->CommandStream, 1, Capture->CommandStreamSize, File) == Capture->CommandStreamSize);
+		fclose(File);
+	}
+
+	return(Result);
+}
+
+static bool
+ReadCaptureFile(capture *Capture, memory_arena *Arena, const char *Filename)
+{
+	bool Result = false;
+
+	FILE *File = fopen(Filename, "rb");
+	if(File)
+	{
+		capture_file_header Header;
+		if((fread(&Header, sizeof(Header), 1, File) == 1) &&
+		   (Header.Magic == CAPTURE_FILE_MAGIC) && (Header.Version == CAPTURE_FILE_VERSION))
+		{
+			Capture->ObjectCount = Header.ObjectCount;
+			Capture->FrameCount = Header.FrameCount;
+			Capture->ResourceStreamSize = Header.ResourceStreamSize;
+			Capture->CommandStreamSize = Header.CommandStreamSize;
+			Capture->ResourceStream = (uint8_t *)PushSize(Arena, Header.ResourceStreamSize);
+			Capture->CommandStream = (uint8_t *)PushSize(Arena, Header.CommandStreamSize);
+
+			Result = (fread(Capture->ResourceStream, 1, Header.ResourceStreamSize, File) == Header.ResourceStreamSize) &&
+					 (fread(Capture->CommandStream, 1, Header.CommandStreamSize, File) == Header.CommandStreamSize);
+		}
+		fclose(File);
+	}
+
+	return(Result);
+}
+
+//
+// NOTE(georgy): Recorder
+//
+
+// NOTE(georgy): What the recorder hands out instead of the backend's handles
+struct capture_object
+{
+	uint32_t ID;
+	void *Inner;
+
+	// NOTE(georgy): Buffers only, so Unmap knows what to record. Dynamic buffers keep a copy of what was written
+	// to them up to the end of the capture window, NO_OVERWRITE maps only record the bytes that changed.
+	uint32_t Size;
+	void *Mapped;
+	gfx_map MapType;
+	uint8_t *Shadow;
+	bool ShadowValid;
+};
+
+struct command_recorder
+{
+	graphics_device *InnerDevice;
+	graphics_context *InnerContext;
+	memory_arena *Arena;
+
+	uint32_t ObjectCount;
+	command_stream Resources;
+	command_stream Commands;
+
+	// NOTE(georgy): Only the render thread touches these
+	uint32_t FrameIndex;
+	uint32_t FirstCaptureFrame;
+	uint32_t CaptureFrameCount;
+	uint32_t CapturedFrameCount;
+};
+
+inline command_recorder *
+GetCommandRecorder(graphics_device *Device)
+{
+	command_recorder *Result = (command_recorder *)Device->Data;
+	return(Result);
+}
+
+inline command_recorder *
+GetCommandRecorder(graphics_context *Context)
+{
+	command_recorder *Result = (command_recorder *)Context->Data;
+	return(Result);
+}
+
+inline uint32_t
+CaptureID(void *Handle)
+{
+	uint32_t Result = Handle ? ((capture_object *)Handle)->ID : 0;
+	return(Result);
+}
+
+#define CaptureInner(type, Handle) ((Handle) ? (type *)((capture_object *)(Handle))->Inner : (type *)0)
+
+inline capture_object *
+NewCaptureObject(command_recorder *Recorder, void *Inner)
+{
+	capture_object *Result = PushStruct(Recorder->Arena, capture_object, true);
+	Result->ID = ++Recorder->ObjectCount;
+	Result->Inner = Inner;
+	return(Result);
+}
+
+inline bool
+IsCapturing(command_recorder *Recorder)
+{
+	bool Result = (Recorder->FrameIndex >= Recorder->FirstCaptureFrame) &&
+				  (Recorder->FrameIndex < Recorder->FirstCaptureFrame + Recorder->CaptureFrameCount) &&
+				  !Recorder->Commands.Overflowed;
+	return(Result);
+}
+
+static gfx_buffer *
+RecordCreateBuffer(graphics_device *Device, gfx_buffer_desc *Desc)
+{
+	command_recorder *Recorder = GetCommandRecorder(Device);
+	capture_object *Result = NewCaptureObject(Recorder, Recorder->InnerDevice->CreateBuffer(Recorder->InnerDevice, Desc));
+	Result->Size = Desc->Size;
+	if(Desc->Usage == GfxBufferUsage_Dynamic)
+	{
+		Result->Shadow = (uint8_t *)PushSize(Recorder->Arena, Desc->Size);
+	}
+
+	command_stream *Stream = &Recorder->Resources;
+	uint32_t Header = BeginCaptureCommand(Stream, CaptureCommand_CreateBuffer);
+	CaptureWriteU32(Stream, Result->ID);
+	CaptureWriteU32(Stream, Desc->Size);
+	CaptureWriteU32(Stream, Desc->Usage);
+	CaptureWriteU32(Stream, Desc->Bind);
+	CaptureWriteU32(Stream, Desc->InitialData ? 1 : 0);
+	if(Desc->InitialData)
+	{
+		CaptureWrite(Stream, Desc->InitialData, Desc->Size);
+	}
+	EndCaptureCommand(Stream, Header);
+
+	return((gfx_buffer *)Result);
+}
+
+inline void
+CaptureWriteTextureDesc(command_stream *Stream, texture_desc *Desc)
+{
+	CaptureWriteU32(Stream, Desc->Width);
+	CaptureWriteU32(Stream, Desc->Height);
+	CaptureWriteU32(Stream, Desc->Format);
+	CaptureWriteU32(Stream, Desc->BindFlags);
+	CaptureWriteU32(Stream, Desc->MipCount);
+}
+
+static gfx_texture *
+RecordCreateTexture(graphics_device *Device, texture_desc *Desc, const char *Name)
+{
+	command_recorder *Recorder = GetCommandRecorder(Device);
+	capture_object *Result = NewCaptureObject(Recorder, Recorder->InnerDevice->CreateTexture(Recorder->InnerDevice, Desc, Name));
+
+	command_stream *Stream = &Recorder->Resources;
+	uint32_t Header = BeginCaptureCommand(Stream, CaptureCommand_CreateTexture);
+	CaptureWriteU32(Stream, Result->ID);
+	CaptureWriteTextureDesc(Stream, Desc);
+	CaptureWriteString(Stream, Name);
+	EndCaptureCommand(Stream, Header);
+
+	return((gfx_texture *)Result);
+}
+
+static void
+RecordDestroyTexture(graphics_device *Device, gfx_texture *Texture)
+{
+	command_recorder *Recorder = GetCommandRecorder(Device);
+	Recorder->InnerDevice->DestroyTexture(Recorder->InnerDevice, CaptureInner(gfx_texture, Texture));
+}
+
+// NOTE(georgy): Textures the platform layer creates outside the device (the back buffer) have to be wrapped
+// before the renderer sees them. On replay they are created from Desc.
+static gfx_texture *
+CaptureImportTexture(command_recorder *Recorder, gfx_texture *Texture, texture_desc *Desc)
+{
+	capture_object *Result = NewCaptureObject(Recorder, Texture);
+
+	command_stream *Stream = &Recorder->Resources;
+	uint32_t Header = BeginCaptureCommand(Stream, CaptureCommand_ImportTexture);
+	CaptureWriteU32(Stream, Result->ID);
+	CaptureWriteTextureDesc(Stream, Desc);
+	EndCaptureCommand(Stream, Header);
+
+	return((gfx_texture *)Result);
+}
+
+static gfx_vertex_shader *
+RecordCreateVertexShader(graphics_device *Device, const char *Filename, const char *EntryPoint)
+{
+	command_recorder *Recorder = GetCommandRecorder(Device);
+	capture_object *Result = NewCaptureObject(Recorder, Recorder->InnerDevice->CreateVertexShader(Recorder->InnerDevice, Filename, EntryPoint));
+
+	command_stream *Stream = &Recorder->Resources;
+	uint32_t Header = BeginCaptureCommand(Stream, CaptureCommand_CreateVertexShader);
+	CaptureWriteU32(Stream, Result->ID);
+	CaptureWriteString(Stream, Filename);
+	CaptureWriteString(Stream, EntryPoint);
+	EndCaptureCommand(Stream, Header);
+
+	return((gfx_vertex_shader *)Result);
+}
+
+static gfx_pixel_shader *
+RecordCreatePixelShader(graphics_device *Device, const char *Filename, const char *EntryPoint)
+{
+	command_recorder *Recorder = GetCommandRecorder(Device);
+	capture_object *Result = NewCaptureObject(Recorder, Recorder->InnerDevice->CreatePixelShader(Recorder->InnerDevice, Filename, EntryPoint));
+
+	command_stream *Stream = &Recorder->Resources;
+	uint32_t Header = BeginCaptureCommand(Stream, CaptureCommand_CreatePixelShader);
+	CaptureWriteU32(Stream, Result->ID);
+	CaptureWriteString(Stream, Filename);
+	CaptureWriteString(Stream, EntryPoint);
+	EndCaptureCommand(Stream, Header);
+
+	return((gfx_pixel_shader *)Result);
+}
+
+static gfx_input_layout *
+RecordCreateInputLayout(graphics_device *Device, gfx_input_element *Elements, uint32_t ElementCount, gfx_vertex_shader *Shader)
+{
+	command_recorder *Recorder = GetCommandRecorder(Device);
+	capture_object *Result = NewCaptureObject(Recorder, Recorder->InnerDevice->CreateInputLayout(Recorder->InnerDevice, Elements, ElementCount,
+																								  CaptureInner(gfx_vertex_shader, Shader)));
+
+	command_stream *Stream = &Recorder->Resources;
+	uint32_t Header = BeginCaptureCommand(Stream, CaptureCommand_CreateInputLayout);
+	CaptureWriteU32(Stream, Result->ID);
+	CaptureWriteU32(Stream, CaptureID(Shader));
+	CaptureWriteU32(Stream, ElementCount);
+	for(uint32_t ElementIndex = 0; ElementIndex < ElementCount; ElementIndex++)
+	{
+		gfx_input_element *Element = Elements + ElementIndex;
+		CaptureWriteString(Stream, Element->SemanticName);
+		CaptureWriteU32(Stream, Element->SemanticIndex);
+		CaptureWriteU32(Stream, Element->Format);
+		CaptureWriteU32(Stream, Element->Slot);
+		CaptureWriteU32(Stream, Element->Offset);
+		CaptureWriteU32(Stream, Element->PerInstance);
+	}
+	EndCaptureCommand(Stream, Header);
+
+	return((gfx_input_layout *)Result);
+}
+
+// NOTE(georgy): State descs are plain values, they go into the stream as they are
+#define RECORD_CREATE_STATE(Name, type, desc_type) \
+static type * \
+RecordCreate##Name(graphics_device *Device, desc_type *Desc) \
+{ \
+	command_recorder *Recorder = GetCommandRecorder(Device); \
+	capture_object *Result = NewCaptureObject(Recorder, Recorder->InnerDevice->Create##Name(Recorder->InnerDevice, Desc)); \
+	\
+	command_stream *Stream = &Recorder->Resources; \
+	uint32_t Header = BeginCaptureCommand(Stream, CaptureCommand_Create##Name); \
+	CaptureWriteU32(Stream, Result->ID); \
+	CaptureWrite(Stream, Desc, sizeof(*Desc)); \
+	EndCaptureCommand(Stream, Header); \
+	\
+	return((type *)Result); \
+}
+
+RECORD_CREATE_STATE(DepthState, gfx_depth_state, gfx_depth_state_desc)
+RECORD_CREATE_STATE(RasterState, gfx_raster_state, gfx_raster_state_desc)
+RECORD_CREATE_STATE(BlendState, gfx_blend_state, gfx_blend_state_desc)
+RECORD_CREATE_STATE(Sampler, gfx_sampler, gfx_sampler_desc)
+#undef RECORD_CREATE_STATE
+
+static gfx_query *
+RecordCreateQuery(graphics_device *Device, const char *Name)
+{
+	command_recorder *Recorder = GetCommandRecorder(Device);
+	capture_object *Result = NewCaptureObject(Recorder, Recorder->InnerDevice->CreateQuery(Recorder->InnerDevice, Name));
+
+	command_stream *Stream = &Recorder->Resources;
+	uint32_t Header = BeginCaptureCommand(Stream, CaptureCommand_CreateQuery);
+	CaptureWriteU32(Stream, Result->ID);
+	CaptureWriteString(Stream, Name);
+	EndCaptureCommand(Stream, Header);
+
+	return((gfx_query *)Result);
+}
+
+// NOTE(georgy): Context. Each call is forwarded with unwrapped handles and, inside the capture window, recorded.
+
+#define BEGIN_RECORD(Name) \
+	command_recorder *Recorder = GetCommandRecorder(Context); \
+	command_stream *Stream = &Recorder->Commands; \
+	bool Capturing = IsCapturing(Recorder); \
+	uint32_t Header = Capturing ? BeginCaptureCommand(Stream, GraphicsCall_##Name) : 0
+#define END_RECORD() if(Capturing) EndCaptureCommand(Stream, Header)
+#define RecordU32(Value) if(Capturing) CaptureWriteU32(Stream, (uint32_t)(Value))
+#define RecordR32(Value) if(Capturing) { real32 Value_ = (Value); CaptureWrite(Stream, &Value_, sizeof(Value_)); }
+
+static void
+RecordRSSetViewports(graphics_context *Context, uint32_t Count, gfx_viewport *Viewports)
+{
+	BEGIN_RECORD(RSSetViewports);
+	RecordU32(Count);
+	if(Capturing) CaptureWrite(Stream, Viewports, Count*sizeof(gfx_viewport));
+	END_RECORD();
+
+	Recorder->InnerContext->RSSetViewports(Recorder->InnerContext, Count, Viewports);
+}
+
+static void
+RecordRSSetState(graphics_context *Context, gfx_raster_state *State)
+{
+	BEGIN_RECORD(RSSetState);
+	RecordU32(CaptureID(State));
+	END_RECORD();
+
+	Recorder->InnerContext->RSSetState(Recorder->InnerContext, CaptureInner(gfx_raster_state, State));
+}
+
+static void
+RecordOMSetRenderTargets(graphics_context *Context, uint32_t Count, gfx_texture **RenderTargets, gfx_texture *DepthStencil)
+{
+	BEGIN_RECORD(OMSetRenderTargets);
+	RecordU32(Count);
+	gfx_texture *InnerRenderTargets[GFX_MAX_BOUND_RESOURCES];
+	Assert(Count <= ArrayCount(InnerRenderTargets));
+	for(uint32_t TargetIndex = 0; TargetIndex < Count; TargetIndex++)
+	{
+		RecordU32(CaptureID(RenderTargets[TargetIndex]));
+		InnerRenderTargets[TargetIndex] = CaptureInner(gfx_texture, RenderTargets[TargetIndex]);
+	}
+	RecordU32(CaptureID(DepthStencil));
+	END_RECORD();
+
+	Recorder->InnerContext->OMSetRenderTargets(Recorder->InnerContext, Count, InnerRenderTargets, CaptureInner(gfx_texture, DepthStencil));
+}
+
+static void
+RecordOMSetDepthStencilState(graphics_context *Context, gfx_depth_state *State, uint32_t StencilRef)
+{
+	BEGIN_RECORD(OMSetDepthStencilState);
+	RecordU32(CaptureID(State));
+	RecordU32(StencilRef);
+	END_RECORD();
+
+	Recorder->InnerContext->OMSetDepthStencilState(Recorder->InnerContext, CaptureInner(gfx_depth_state, State), StencilRef);
+}
+
+static void
+RecordOMSetBlendState(graphics_context *Context, gfx_blend_state *State, const real32 *BlendFactor, uint32_t SampleMask)
+{
+	BEGIN_RECORD(OMSetBlendState);
+	RecordU32(CaptureID(State));
+	RecordU32(BlendFactor ? 1 : 0);
+	for(uint32_t I = 0; I < 4; I++)
+	{
+		RecordR32(BlendFactor ? BlendFactor[I] : 1.0f);
+	}
+	RecordU32(SampleMask);
+	END_RECORD();
+
+	Recorder->InnerContext->OMSetBlendState(Recorder->InnerContext, CaptureInner(gfx_blend_state, State), BlendFactor, SampleMask);
+}
+
+static void
+RecordClearRenderTargetView(graphics_context *Context, gfx_texture *RenderTarget, const real32 *Color)
+{
+	BEGIN_RECORD(ClearRenderTargetView);
+	RecordU32(CaptureID(RenderTarget));
+	for(uint32_t I = 0; I < 4; I++)
+	{
+		RecordR32(Color[I]);
+	}
+	END_RECORD();
+
+	Recorder->InnerContext->ClearRenderTargetView(Recorder->InnerContext, CaptureInner(gfx_texture, RenderTarget), Color);
+}
+
+static void
+RecordClearDepthStencilView(graphics_context *Context, gfx_texture *DepthStencil, uint32_t ClearFlags, real32 Depth, uint8_t Stencil)
+{
+	BEGIN_RECORD(ClearDepthStencilView);
+	RecordU32(CaptureID(DepthStencil));
+	RecordU32(ClearFlags);
+	RecordR32(Depth);
+	RecordU32(Stencil);
+	END_RECORD();
+
+	Recorder->InnerContext->ClearDepthStencilView(Recorder->InnerContext, CaptureInner(gfx_texture, DepthStencil), ClearFlags, Depth, Stencil);
+}
+
+static void
+RecordGenerateMips(graphics_context *Context, gfx_texture *Texture)
+{
+	BEGIN_RECORD(GenerateMips);
+	RecordU32(CaptureID(Texture));
+	END_RECORD();
+
+	Recorder->InnerContext->GenerateMips(Recorder->InnerContext, CaptureInner(gfx_texture, Texture));
+}
+
+static void
+RecordIASetInputLayout(graphics_context *Context, gfx_input_layout *Layout)
+{
+	BEGIN_RECORD(IASetInputLayout);
+	RecordU32(CaptureID(Layout));
+	END_RECORD();
+
+	Recorder->InnerContext->IASetInputLayout(Recorder->InnerContext, CaptureInner(gfx_input_layout, Layout));
+}
+
+static void
+RecordIASetPrimitiveTopology(graphics_context *Context, gfx_topology Topology)
+{
+	BEGIN_RECORD(IASetPrimitiveTopology);
+	RecordU32(Topology);
+	END_RECORD();
+
+	Recorder->InnerContext->IASetPrimitiveTopology(Recorder->InnerContext, Topology);
+}
+
+static void
+RecordIASetVertexBuffers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *Strides, uint32_t *Offsets)
+{
+	BEGIN_RECORD(IASetVertexBuffers);
+	RecordU32(Slot);
+	RecordU32(Count);
+	gfx_buffer *InnerBuffers[GFX_MAX_BOUND_RESOURCES];
+	Assert(Count <= ArrayCount(InnerBuffers));
+	for(uint32_t BufferIndex = 0; BufferIndex < Count; BufferIndex++)
+	{
+		RecordU32(CaptureID(Buffers[BufferIndex]));
+		RecordU32(Strides[BufferIndex]);
+		RecordU32(Offsets[BufferIndex]);
+		InnerBuffers[BufferIndex] = CaptureInner(gfx_buffer, Buffers[BufferIndex]);
+	}
+	END_RECORD();
+
+	Recorder->InnerContext->IASetVertexBuffers(Recorder->InnerContext, Slot, Count, InnerBuffers, Strides, Offsets);
+}
+
+static void
+RecordIASetIndexBuffer(graphics_context *Context, gfx_buffer *Buffer, gfx_index_format Format, uint32_t Offset)
+{
+	BEGIN_RECORD(IASetIndexBuffer);
+	RecordU32(CaptureID(Buffer));
+	RecordU32(Format);
+	RecordU32(Offset);
+	END_RECORD();
+
+	Recorder->InnerContext->IASetIndexBuffer(Recorder->InnerContext, CaptureInner(gfx_buffer, Buffer), Format, Offset);
+}
+
+static void
+RecordVSSetShader(graphics_context *Context, gfx_vertex_shader *Shader)
+{
+	BEGIN_RECORD(VSSetShader);
+	RecordU32(CaptureID(Shader));
+	END_RECORD();
+
+	Recorder->InnerContext->VSSetShader(Recorder->InnerContext, CaptureInner(gfx_vertex_shader, Shader));
+}
+
+static void
+RecordPSSetShader(graphics_context *Context, gfx_pixel_shader *Shader)
+{
+	BEGIN_RECORD(PSSetShader);
+	RecordU32(CaptureID(Shader));
+	END_RECORD();
+
+	Recorder->InnerContext->PSSetShader(Recorder->InnerContext, CaptureInner(gfx_pixel_shader, Shader));
+}
+
+// NOTE(georgy): All the (Slot, Count, Handles) calls look the same
+#define RECORD_SLOTTED_CALL(Name, type) \
+static void \
+Record##Name(graphics_context *Context, uint32_t Slot, uint32_t Count, type **Handles) \
+{ \
+	BEGIN_RECORD(Name); \
+	RecordU32(Slot); \
+	RecordU32(Count); \
+	type *InnerHandles[GFX_MAX_BOUND_RESOURCES]; \
+	Assert(Count <= ArrayCount(InnerHandles)); \
+	for(uint32_t HandleIndex = 0; HandleIndex < Count; HandleIndex++) \
+	{ \
+		RecordU32(CaptureID(Handles[HandleIndex])); \
+		InnerHandles[HandleIndex] = CaptureInner(type, Handles[HandleIndex]); \
+	} \
+	END_RECORD(); \
+	\
+	Recorder->InnerContext->Name(Recorder->InnerContext, Slot, Count, InnerHandles); \
+}
+
+RECORD_SLOTTED_CALL(VSSetConstantBuffers, gfx_buffer)
+RECORD_SLOTTED_CALL(PSSetConstantBuffers, gfx_buffer)
+RECORD_SLOTTED_CALL(PSSetShaderResources, gfx_texture)
+RECORD_SLOTTED_CALL(PSSetSamplers, gfx_sampler)
+#undef RECORD_SLOTTED_CALL
+
+#define RECORD_CONSTANT_RANGE_CALL(Name) \
+static void \
+Record##Name(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *FirstConstant, uint32_t *NumConstants) \
+{ \
+	BEGIN_RECORD(Name); \
+	RecordU32(Slot); \
+	RecordU32(Count); \
+	gfx_buffer *InnerBuffers[GFX_MAX_BOUND_RESOURCES]; \
+	Assert(Count <= ArrayCount(InnerBuffers)); \
+	for(uint32_t BufferIndex = 0; BufferIndex < Count; BufferIndex++) \
+	{ \
+		RecordU32(CaptureID(Buffers[BufferIndex])); \
+		RecordU32(FirstConstant[BufferIndex]); \
+		RecordU32(NumConstants[BufferIndex]); \
+		InnerBuffers[BufferIndex] = CaptureInner(gfx_buffer, Buffers[BufferIndex]); \
+	} \
+	END_RECORD(); \
+	\
+	Recorder->InnerContext->Name(Recorder->InnerContext, Slot, Count, InnerBuffers, FirstConstant, NumConstants); \
+}
+
+RECORD_CONSTANT_RANGE_CALL(VSSetConstantBuffers1)
+RECORD_CONSTANT_RANGE_CALL(PSSetConstantBuffers1)
+#undef RECORD_CONSTANT_RANGE_CALL
+
+static void *
+RecordMap(graphics_context *Context, gfx_buffer *Buffer, gfx_map MapType)
+{
+	BEGIN_RECORD(Map);
+	RecordU32(CaptureID(Buffer));
+	RecordU32(MapType);
+	END_RECORD();
+
+	capture_object *Object = (capture_object *)Buffer;
+	Object->Mapped = Recorder->InnerContext->Map(Recorder->InnerContext, CaptureInner(gfx_buffer, Buffer), MapType);
+	Object->MapType = MapType;
+	return(Object->Mapped);
+}
+
+// NOTE(georgy): What was written while the buffer was mapped goes into the stream with the Unmap, as (Offset, Size, bytes).
+// After a discard the whole buffer is recorded, after NO_OVERWRITE only the range that differs from the last recorded contents.
+static void
+RecordUnmap(graphics_context *Context, gfx_buffer *Buffer)
+{
+	capture_object *Object = (capture_object *)Buffer;
+
+	BEGIN_RECORD(Unmap);
+	uint32_t Offset = 0;
+	uint32_t Size = Object->Size;
+	bool CaptureDone = (Recorder->CapturedFrameCount == Recorder->CaptureFrameCount);
+	if(!CaptureDone && Object->Shadow)
+	{
+		uint8_t *Mapped = (uint8_t *)Object->Mapped;
+		if(Object->ShadowValid && (Object->MapType == GfxMap_WriteNoOverwrite))
+		{
+			while((Offset < Object->Size) && (Mapped[Offset] == Object->Shadow[Offset]))
+			{
+				Offset++;
+			}
+			uint32_t OnePastLast = Object->Size;
+			while((OnePastLast > Offset) && (Mapped[OnePastLast - 1] == Object->Shadow[OnePastLast - 1]))
+			{
+				OnePastLast--;
+			}
+			Size = OnePastLast - Offset;
+		}
+		memcpy(Object->Shadow + Offset, Mapped + Offset, Size);
+		Object->ShadowValid = true;
+	}
+	RecordU32(Object->ID);
+	RecordU32(Offset);
+	RecordU32(Size);
+	if(Capturing) CaptureWrite(Stream, (uint8_t *)Object->Mapped + Offset, Size);
+	END_RECORD();
+
+	Object->Mapped = 0;
+	Recorder->InnerContext->Unmap(Recorder->InnerContext, CaptureInner(gfx_buffer, Buffer));
+}
+
+static void
+RecordDraw(graphics_context *Context, uint32_t VertexCount, uint32_t StartVertex)
+{
+	BEGIN_RECORD(Draw);
+	RecordU32(VertexCount);
+	RecordU32(StartVertex);
+	END_RECORD();
+
+	Recorder->InnerContext->Draw(Recorder->InnerContext, VertexCount, StartVertex);
+}
+
+static void
+RecordDrawIndexed(graphics_context *Context, uint32_t IndexCount, uint32_t StartIndex, int32_t BaseVertex)
+{
+	BEGIN_RECORD(DrawIndexed);
+	RecordU32(IndexCount);
+	RecordU32(StartIndex);
+	RecordU32(BaseVertex);
+	END_RECORD();
+
+	Recorder->InnerContext->DrawIndexed(Recorder->InnerContext, IndexCount, StartIndex, BaseVertex);
+}
+
+static void
+RecordDrawIndexedInstanced(graphics_context *Context, uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndex, int32_t BaseVertex, uint32_t StartInstance)
+{
+	BEGIN_RECORD(DrawIndexedInstanced);
+	RecordU32(IndexCountPerInstance);
+	RecordU32(InstanceCount);
+	RecordU32(StartIndex);
+	RecordU32(BaseVertex);
+	RecordU32(StartInstance);
+	END_RECORD();
+
+	Recorder->InnerContext->DrawIndexedInstanced(Recorder->InnerContext, IndexCountPerInstance, InstanceCount, StartIndex, BaseVertex, StartInstance);
+}
+
+static void
+RecordBegin(graphics_context *Context, gfx_query *Query)
+{
+	BEGIN_RECORD(Begin);
+	RecordU32(CaptureID(Query));
+	END_RECORD();
+
+	Recorder->InnerContext->Begin(Recorder->InnerContext, CaptureInner(gfx_query, Query));
+}
+
+static void
+RecordEnd(graphics_context *Context, gfx_query *Query)
+{
+	BEGIN_RECORD(End);
+	RecordU32(CaptureID(Query));
+	END_RECORD();
+
+	Recorder->InnerContext->End(Recorder->InnerContext, CaptureInner(gfx_query, Query));
+}
+
+// NOTE(georgy): The results go into the stream too, that's how a capture knows what the GPU did with the work it measured
+static bool
+RecordGetData(graphics_context *Context, gfx_query *Query, gfx_pipeline_statistics *Statistics)
+{
+	command_recorder *Recorder = GetCommandRecorder(Context);
+	bool Result = Recorder->InnerContext->GetData(Recorder->InnerContext, CaptureInner(gfx_query, Query), Statistics);
+
+	if(IsCapturing(Recorder))
+	{
+		command_stream *Stream = &Recorder->Commands;
+		uint32_t Header = BeginCaptureCommand(Stream, GraphicsCall_GetData);
+		CaptureWriteU32(Stream, CaptureID(Query));
+		CaptureWriteU32(Stream, Result ? 1 : 0);
+		if(Result)
+		{
+			CaptureWritePipelineStatistics(Stream, Statistics);
+		}
+		EndCaptureCommand(Stream, Header);
+	}
+
+	return(Result);
+}
+
+static void
+RecordPresent(graphics_context *Context)
+{
+	BEGIN_RECORD(Present);
+	END_RECORD();
+
+	if(Capturing)
+	{
+		Recorder->CapturedFrameCount++;
+	}
+	Recorder->FrameIndex++;
+
+	Recorder->InnerContext->Present(Recorder->InnerContext);
+}
+
+#undef BEGIN_RECORD
+#undef END_RECORD
+#undef RecordU32
+#undef RecordR32
+
+// NOTE(georgy): Frames [FirstCaptureFrame, FirstCaptureFrame + CaptureFrameCount) get recorded.
+// Device and Context are what the renderer should use from now on.
+static void
+InitializeCommandRecorder(command_recorder *Recorder, memory_arena *Arena, uint32_t MaxStreamSize,
+						  graphics_device *InnerDevice, graphics_context *InnerContext,
+						  graphics_device *Device, graphics_context *Context,
+						  uint32_t FirstCaptureFrame, uint32_t CaptureFrameCount)
+{
+	*Recorder = {};
+	Recorder->InnerDevice = InnerDevice;
+	Recorder->InnerContext = InnerContext;
+	Recorder->Arena = Arena;
+	Recorder->FirstCaptureFrame = FirstCaptureFrame;
+	Recorder->CaptureFrameCount = CaptureFrameCount;
+	InitializeCommandStream(&Recorder->Resources, Arena, MaxStreamSize);
+	InitializeCommandStream(&Recorder->Commands, Arena, MaxStreamSize);
+
+	Device->CreateBuffer = RecordCreateBuffer;
+	Device->CreateTexture = RecordCreateTexture;
+	Device->DestroyTexture = RecordDestroyTexture;
+	Device->CreateVertexShader = RecordCreateVertexShader;
+	Device->CreatePixelShader = RecordCreatePixelShader;
+	Device->CreateInputLayout = RecordCreateInputLayout;
+	Device->CreateDepthState = RecordCreateDepthState;
+	Device->CreateRasterState = RecordCreateRasterState;
+	Device->CreateBlendState = RecordCreateBlendState;
+	Device->CreateSampler = RecordCreateSampler;
+	Device->CreateQuery = RecordCreateQuery;
+	Device->Data = Recorder;
+
+	Context->RSSetViewports = RecordRSSetViewports;
+	Context->RSSetState = RecordRSSetState;
+	Context->OMSetRenderTargets = RecordOMSetRenderTargets;
+	Context->OMSetDepthStencilState = RecordOMSetDepthStencilState;
+	Context->OMSetBlendState = RecordOMSetBlendState;
+	Context->ClearRenderTargetView = RecordClearRenderTargetView;
+	Context->ClearDepthStencilView = RecordClearDepthStencilView;
+	Context->GenerateMips = RecordGenerateMips;
+	Context->IASetInputLayout = RecordIASetInputLayout;
+	Context->IASetPrimitiveTopology = RecordIASetPrimitiveTopology;
+	Context->IASetVertexBuffers = RecordIASetVertexBuffers;
+	Context->IASetIndexBuffer = RecordIASetIndexBuffer;
+	Context->VSSetShader = RecordVSSetShader;
+	Context->PSSetShader = RecordPSSetShader;
+	Context->VSSetConstantBuffers = RecordVSSetConstantBuffers;
+	Context->PSSetConstantBuffers = RecordPSSetConstantBuffers;
+	Context->VSSetConstantBuffers1 = RecordVSSetConstantBuffers1;
+	Context->PSSetConstantBuffers1 = RecordPSSetConstantBuffers1;
+	Context->PSSetShaderResources = RecordPSSetShaderResources;
+	Context->PSSetSamplers = RecordPSSetSamplers;
+	Context->Map = RecordMap;
+	Context->Unmap = RecordUnmap;
+	Context->Draw = RecordDraw;
+	Context->DrawIndexed = RecordDrawIndexed;
+	Context->DrawIndexedInstanced = RecordDrawIndexedInstanced;
+	Context->Begin = RecordBegin;
+	Context->End = RecordEnd;
+	Context->GetData = RecordGetData;
+	Context->Present = RecordPresent;
+	Context->Data = Recorder;
+}
+
+// NOTE(georgy): Only valid after the capture window is over and the render thread is done with the recorder
+static capture
+GetRecordedCapture(command_recorder *Recorder)
+{
+	capture Result;
+	Result.ObjectCount = Recorder->ObjectCount;
+	Result.FrameCount = Recorder->CapturedFrameCount;
+	Result.ResourceStream = Recorder->Resources.Base;
+	Result.ResourceStreamSize = Recorder->Resources.Size;
+	Result.CommandStream = Recorder->Commands.Base;
+	Result.CommandStreamSize = Recorder->Commands.Size;
+	return(Result);
+}
+
+//
+// NOTE(georgy): Replayer
+//
+
+struct capture_replayer
+{
+	capture *Capture;
+
+	// NOTE(georgy): Indexed by object ID
+	void **Objects;
+	void **Mapped;
+};
+
+#define ReplayObject(Replayer, type, ID) ((type *)(Replayer)->Objects[ID])
+
+// NOTE(georgy): Creates every object in the capture on Device
+static void
+InitializeCaptureReplayer(capture_replayer *Replayer, capture *Capture, memory_arena *Arena, graphics_device *Device)
+{
+	Replayer->Capture = Capture;
+	Replayer->Objects = PushArray(Arena, Capture->ObjectCount + 1, void *, true);
+	Replayer->Mapped = PushArray(Arena, Capture->ObjectCount + 1, void *, true);
+
+	uint8_t *At = Capture->ResourceStream;
+	uint8_t *End = At + Capture->ResourceStreamSize;
+	while(At < End)
+	{
+		uint32_t Header = CaptureReadU32(&At);
+		uint8_t *Payload = At;
+		At += Header >> 8;
+
+		uint32_t ID = CaptureReadU32(&Payload);
+		Assert(ID <= Capture->ObjectCount);
+		switch(Header & 0xFF)
+		{
+			case CaptureCommand_CreateBuffer:
+			{
+				gfx_buffer_desc Desc;
+				Desc.Size = CaptureReadU32(&Payload);
+				Desc.Usage = (gfx_buffer_usage)CaptureReadU32(&Payload);
+				Desc.Bind = (gfx_buffer_bind)CaptureReadU32(&Payload);
+				Desc.InitialData = CaptureReadU32(&Payload) ? Payload : 0;
+				Replayer->Objects[ID] = Device->CreateBuffer(Device, &Desc);
+			} break;
+
+			case CaptureCommand_CreateTexture:
+			case CaptureCommand_ImportTexture:
+			{
+				texture_desc Desc;
+				Desc.Width = CaptureReadU32(&Payload);
+				Desc.Height = CaptureReadU32(&Payload);
+				Desc.Format = (texture_format)CaptureReadU32(&Payload);
+				Desc.BindFlags = CaptureReadU32(&Payload);
+				Desc.MipCount = CaptureReadU32(&Payload);
+				const char *Name = ((Header & 0xFF) == CaptureCommand_CreateTexture) ? CaptureReadString(&Payload) : "Imported";
+				Replayer->Objects[ID] = Device->CreateTexture(Device, &Desc, Name);
+			} break;
+
+			case CaptureCommand_CreateVertexShader:
+			{
+				const char *Filename = CaptureReadString(&Payload);
+				const char *EntryPoint = CaptureReadString(&Payload);
+				Replayer->Objects[ID] = Device->CreateVertexShader(Device, Filename, EntryPoint);
+			} break;
+
+			case CaptureCommand_CreatePixelShader:
+			{
+				const char *Filename = CaptureReadString(&Payload);
+				const char *EntryPoint = CaptureReadString(&Payload);
+				Replayer->Objects[ID] = Device->CreatePixelShader(Device, Filename, EntryPoint);
+			} break;
+
+			case CaptureCommand_CreateInputLayout:
+			{
+				gfx_vertex_shader *Shader = ReplayObject(Replayer, gfx_vertex_shader, CaptureReadU32(&Payload));
+				uint32_t ElementCount = CaptureReadU32(&Payload);
+				gfx_input_element Elements[GFX_MAX_BOUND_RESOURCES];
+				Assert(ElementCount <= ArrayCount(Elements));
+				for(uint32_t ElementIndex = 0; ElementIndex < ElementCount; ElementIndex++)
+				{
+					gfx_input_element *Element = Elements + ElementIndex;
+					Element->SemanticName = CaptureReadString(&Payload);
+					Element->SemanticIndex = CaptureReadU32(&Payload);
+					Element->Format = (gfx_vertex_format)CaptureReadU32(&Payload);
+					Element->Slot = CaptureReadU32(&Payload);
+					Element->Offset = CaptureReadU32(&Payload);
+					Element->PerInstance = CaptureReadU32(&Payload) != 0;
+				}
+				Replayer->Objects[ID] = Device->CreateInputLayout(Device, Elements, ElementCount, Shader);
+			} break;
+
+			case CaptureCommand_CreateDepthState:
+			{
+				gfx_depth_state_desc Desc;
+				memcpy(&Desc, Payload, sizeof(Desc));
+				Replayer->Objects[ID] = Device->CreateDepthState(Device, &Desc);
+			} break;
+
+			case CaptureCommand_CreateRasterState:
+			{
+				gfx_raster_state_desc Desc;
+				memcpy(&Desc, Payload, sizeof(Desc));
+				Replayer->Objects[ID] = Device->CreateRasterState(Device, &Desc);
+			} break;
+
+			case CaptureCommand_CreateBlendState:
+			{
+				gfx_blend_state_desc Desc;
+				memcpy(&Desc, Payload, sizeof(Desc));
+				Replayer->Objects[ID] = Device->CreateBlendState(Device, &Desc);
+			} break;
+
+			case CaptureCommand_CreateSampler:
+			{
+				gfx_sampler_desc Desc;
+				memcpy(&Desc, Payload, sizeof(Desc));
+				Replayer->Objects[ID] = Device->CreateSampler(Device, &Desc);
+			} break;
+
+			case CaptureCommand_CreateQuery:
+			{
+				const char *Name = CaptureReadString(&Payload);
+				Replayer->Objects[ID] = Device->CreateQuery(Device, Name);
+			} break;
+
+			default: Assert(!"Unknown resource command");
+		}
+	}
+}
+
+// NOTE(georgy): Reads Count handle IDs and turns them into the replay device's handles
+inline void
+ReplayHandles(capture_replayer *Replayer, uint8_t **Payload, uint32_t Count, void **Handles)
+{
+	Assert(Count <= GFX_MAX_BOUND_RESOURCES);
+	for(uint32_t HandleIndex = 0; HandleIndex < Count; HandleIndex++)
+	{
+		Handles[HandleIndex] = Replayer->Objects[CaptureReadU32(Payload)];
+	}
+}
+
+// NOTE(georgy): Executes every captured frame once
+static void
+ReplayCapture(capture_replayer *Replayer, graphics_context *Context)
+{
+	uint8_t *At = Replayer->Capture->CommandStream;
+	uint8_t *End = At + Replayer->Capture->CommandStreamSize;
+	while(At < End)
+	{
+		uint32_t Header = CaptureReadU32(&At);
+		uint8_t *Payload = At;
+		At += Header >> 8;
+
+		void *Handles[GFX_MAX_BOUND_RESOURCES];
+		switch(Header & 0xFF)
+		{
+			case GraphicsCall_RSSetViewports:
+			{
+				uint32_t Count = CaptureReadU32(&Payload);
+				gfx_viewport Viewports[GFX_MAX_BOUND_RESOURCES];
+				Assert(Count <= ArrayCount(Viewports));
+				memcpy(Viewports, Payload, Count*sizeof(gfx_viewport));
+				Context->RSSetViewports(Context, Count, Viewports);
+			} break;
+
+			case GraphicsCall_RSSetState:
+			{
+				Context->RSSetState(Context, ReplayObject(Replayer, gfx_raster_state, CaptureReadU32(&Payload)));
+			} break;
+
+			case GraphicsCall_OMSetRenderTargets:
+			{
+				uint32_t Count = CaptureReadU32(&Payload);
+				ReplayHandles(Replayer, &Payload, Count, Handles);
+				gfx_texture *DepthStencil = ReplayObject(Replayer, gfx_texture, CaptureReadU32(&Payload));
+				Context->OMSetRenderTargets(Context, Count, (gfx_texture **)Handles, DepthStencil);
+			} break;
+
+			case GraphicsCall_OMSetDepthStencilState:
+			{
+				gfx_depth_state *State = ReplayObject(Replayer, gfx_depth_state, CaptureReadU32(&Payload));
+				uint32_t StencilRef = CaptureReadU32(&Payload);
+				Context->OMSetDepthStencilState(Context, State, StencilRef);
+			} break;
+
+			case GraphicsCall_OMSetBlendState:
+			{
+				gfx_blend_state *State = ReplayObject(Replayer, gfx_blend_state, CaptureReadU32(&Payload));
+				bool HasBlendFactor = CaptureReadU32(&Payload) != 0;
+				real32 BlendFactor[4];
+				for(uint32_t I = 0; I < 4; I++)
+				{
+					BlendFactor[I] = CaptureReadR32(&Payload);
+				}
+				uint32_t SampleMask = CaptureReadU32(&Payload);
+				Context->OMSetBlendState(Context, State, HasBlendFactor ? BlendFactor : 0, SampleMask);
+			} break;
+
+			case GraphicsCall_ClearRenderTargetView:
+			{
+				gfx_texture *RenderTarget = ReplayObject(Replayer, gfx_texture, CaptureReadU32(&Payload));
+				real32 Color[4];
+				for(uint32_t I = 0; I < 4; I++)
+				{
+					Color[I] = CaptureReadR32(&Payload);
+				}
+				Context->ClearRenderTargetView(Context, RenderTarget, Color);
+			} break;
+
+			case GraphicsCall_ClearDepthStencilView:
+			{
+				gfx_texture *DepthStencil = ReplayObject(Replayer, gfx_texture, CaptureReadU32(&Payload));
+				uint32_t ClearFlags = CaptureReadU32(&Payload);
+				real32 Depth = CaptureReadR32(&Payload);
+				uint8_t Stencil = (uint8_t)CaptureReadU32(&Payload);
+				Context->ClearDepthStencilView(Context, DepthStencil, ClearFlags, Depth, Stencil);
+			} break;
+
+			case GraphicsCall_GenerateMips:
+			{
+				Context->GenerateMips(Context, ReplayObject(Replayer, gfx_texture, CaptureReadU32(&Payload)));
+			} break;
+
+			case GraphicsCall_IASetInputLayout:
+			{
+				Context->IASetInputLayout(Context, ReplayObject(Replayer, gfx_input_layout, CaptureReadU32(&Payload)));
+			} break;
+
+			case GraphicsCall_IASetPrimitiveTopology:
+			{
+				Context->IASetPrimitiveTopology(Context, (gfx_topology)CaptureReadU32(&Payload));
+			} break;
+
+			case GraphicsCall_IASetVertexBuffers:
+			{
+				uint32_t Slot = CaptureReadU32(&Payload);
+				uint32_t Count = CaptureReadU32(&Payload);
+				uint32_t Strides[GFX_MAX_BOUND_RESOURCES], Offsets[GFX_MAX_BOUND_RESOURCES];
+				Assert(Count <= ArrayCount(Strides));
+				for(uint32_t BufferIndex = 0; BufferIndex < Count; BufferIndex++)
+				{
+					Handles[BufferIndex] = Replayer->Objects[CaptureReadU32(&Payload)];
+					Strides[BufferIndex] = CaptureReadU32(&Payload);
+					Offsets[BufferIndex] = CaptureReadU32(&Payload);
+				}
+				Context->IASetVertexBuffers(Context, Slot, Count, (gfx_buffer **)Handles, Strides, Offsets);
+			} break;
+
+			case GraphicsCall_IASetIndexBuffer:
+			{
+				gfx_buffer *Buffer = ReplayObject(Replayer, gfx_buffer, CaptureReadU32(&Payload));
+				gfx_index_format Format = (gfx_index_format)CaptureReadU32(&Payload);
+				uint32_t Offset = CaptureReadU32(&Payload);
+				Context->IASetIndexBuffer(Context, Buffer, Format, Offset);
+			} break;
+
+			case GraphicsCall_VSSetShader:
+			{
+				Context->VSSetShader(Context, ReplayObject(Replayer, gfx_vertex_shader, CaptureReadU32(&Payload)));
+			} break;
+
+			case GraphicsCall_PSSetShader:
+			{
+				Context->PSSetShader(Context, ReplayObject(Replayer, gfx_pixel_shader, CaptureReadU32(&Payload)));
+			} break;
+
+			case GraphicsCall_VSSetConstantBuffers:
+			case GraphicsCall_PSSetConstantBuffers:
+			case GraphicsCall_PSSetShaderResources:
+			case GraphicsCall_PSSetSamplers:
+			{
+				uint32_t Slot = CaptureReadU32(&Payload);
+				uint32_t Count = CaptureReadU32(&Payload);
+				ReplayHandles(Replayer, &Payload, Count, Handles);
+				switch(Header & 0xFF)
+				{
+					case GraphicsCall_VSSetConstantBuffers: Context->VSSetConstantBuffers(Context, Slot, Count, (gfx_buffer **)Handles); break;
+					case GraphicsCall_PSSetConstantBuffers: Context->PSSetConstantBuffers(Context, Slot, Count, (gfx_buffer **)Handles); break;
+					case GraphicsCall_PSSetShaderResources: Context->PSSetShaderResources(Context, Slot, Count, (gfx_texture **)Handles); break;
+					case GraphicsCall_PSSetSamplers: Context->PSSetSamplers(Context, Slot, Count, (gfx_sampler **)Handles); break;
+				}
+			} break;
+
+			case GraphicsCall_VSSetConstantBuffers1:
+			case GraphicsCall_PSSetConstantBuffers1:
+			{
+				uint32_t Slot = CaptureReadU32(&Payload);
+				uint32_t Count = CaptureReadU32(&Payload);
+				uint32_t FirstConstant[GFX_MAX_BOUND_RESOURCES], NumConstants[GFX_MAX_BOUND_RESOURCES];
+				Assert(Count <= ArrayCount(FirstConstant));
+				for(uint32_t BufferIndex = 0; BufferIndex < Count; BufferIndex++)
+				{
+					Handles[BufferIndex] = Replayer->Objects[CaptureReadU32(&Payload)];
+					FirstConstant[BufferIndex] = CaptureReadU32(&Payload);
+					NumConstants[BufferIndex] = CaptureReadU32(&Payload);
+				}
+				if((Header & 0xFF) == GraphicsCall_VSSetConstantBuffers1)
+				{
+					Context->VSSetConstantBuffers1(Context, Slot, Count, (gfx_buffer **)Handles, FirstConstant, NumConstants);
+				}
+				else
+				{
+					Context->PSSetConstantBuffers1(Context, Slot, Count, (gfx_buffer **)Handles, FirstConstant, NumConstants);
+				}
+			} break;
+
+			case GraphicsCall_Map:
+			{
+				uint32_t ID = CaptureReadU32(&Payload);
+				gfx_map MapType = (gfx_map)CaptureReadU32(&Payload);
+				Replayer->Mapped[ID] = Context->Map(Context, ReplayObject(Replayer, gfx_buffer, ID), MapType);
+			} break;
+
+			case GraphicsCall_Unmap:
+			{
+				uint32_t ID = CaptureReadU32(&Payload);
+				uint32_t Offset = CaptureReadU32(&Payload);
+				uint32_t Size = CaptureReadU32(&Payload);
+				memcpy((uint8_t *)Replayer->Mapped[ID] + Offset, Payload, Size);
+				Context->Unmap(Context, ReplayObject(Replayer, gfx_buffer, ID));
+			} break;
+
+			case GraphicsCall_Draw:
+			{
+				uint32_t VertexCount = CaptureReadU32(&Payload);
+				uint32_t StartVertex = CaptureReadU32(&Payload);
+				Context->Draw(Context, VertexCount, StartVertex);
+			} break;
+
+			case GraphicsCall_DrawIndexed:
+			{
+				uint32_t IndexCount = CaptureReadU32(&Payload);
+				uint32_t StartIndex = CaptureReadU32(&Payload);
+				int32_t BaseVertex = (int32_t)CaptureReadU32(&Payload);
+				Context->DrawIndexed(Context, IndexCount, StartIndex, BaseVertex);
+			} break;
+
+			case GraphicsCall_DrawIndexedInstanced:
+			{
+				uint32_t IndexCountPerInstance = CaptureReadU32(&Payload);
+				uint32_t InstanceCount = CaptureReadU32(&Payload);
+				uint32_t StartIndex = CaptureReadU32(&Payload);
+				int32_t BaseVertex = (int32_t)CaptureReadU32(&Payload);
+				uint32_t StartInstance = CaptureReadU32(&Payload);
+				Context->DrawIndexedInstanced(Context, IndexCountPerInstance, InstanceCount, StartIndex, BaseVertex, StartInstance);
+			} break;
+
+			case GraphicsCall_Begin:
+			{
+				Context->Begin(Context, ReplayObject(Replayer, gfx_query, CaptureReadU32(&Payload)));
+			} break;
+
+			case GraphicsCall_End:
+			{
+				Context->End(Context, ReplayObject(Replayer, gfx_query, CaptureReadU32(&Payload)));
+			} break;
+
+			// NOTE(georgy): Asked again so the replay does the same work, what was recorded is the capture's answer
+			case GraphicsCall_GetData:
+			{
+				gfx_pipeline_statistics Statistics;
+				Context->GetData(Context, ReplayObject(Replayer, gfx_query, CaptureReadU32(&Payload)), &Statistics);
+			} break;
+
+			case GraphicsCall_Present:
+			{
+				Context->Present(Context);
+			} break;
+
+			default: Assert(!"Unknown context command");
+		}
+	}
+}
+
+//
+// NOTE(georgy): Capture analysis
+//
+
+#define CAPTURE_MAX_PASSES 32
+#define CAPTURE_MAX_QUERIES 256
+
+// NOTE(georgy): The work between a query's Begin and End, and what the query results said about it.
+// Queries with the same name are the same pass (one per frame in flight). A result only counts if its query
+// was issued inside the capture, the draws of those same frames are MeasuredDrawCount and MeasuredInstanceCount.
+struct capture_pass_stats
+{
+	const char *Name;
+	uint64_t DrawCount;
+	uint64_t InstanceCount;
+
+	uint64_t ResultCount;
+	uint64_t MeasuredDrawCount;
+	uint64_t MeasuredInstanceCount;
+	gfx_pipeline_statistics Statistics;
+};
+
+// NOTE(georgy): The work of a query's last Begin and End in the capture
+struct capture_query_work
+{
+	bool Issued;
+	uint64_t DrawCount;
+	uint64_t InstanceCount;
+};
+
+struct capture_stats
+{
+	uint32_t FrameCount;
+	uint64_t CommandBytes;
+	uint64_t UploadBytes;
+
+	uint64_t CallCounts[GraphicsCall_Count];
+	// NOTE(georgy): Calls that didn't change anything that was bound already
+	uint64_t RedundantCounts[GraphicsCall_Count];
+
+	uint32_t PassCount;
+	capture_pass_stats Passes[CAPTURE_MAX_PASSES];
+};
+
+// NOTE(georgy): Fills in the passes from the queries in the resource stream, and returns the pass of every query
+static uint32_t
+GetCapturePasses(capture *Capture, capture_stats *Stats, uint32_t *QueryIDs, uint32_t *QueryPasses)
+{
+	uint32_t QueryCount = 0;
+
+	uint8_t *At = Capture->ResourceStream;
+	uint8_t *End = At + Capture->ResourceStreamSize;
+	while(At < End)
+	{
+		uint32_t Header = CaptureReadU32(&At);
+		uint8_t *Payload = At;
+		At += Header >> 8;
+
+		if((Header & 0xFF) == CaptureCommand_CreateQuery)
+		{
+			uint32_t ID = CaptureReadU32(&Payload);
+			const char *Name = CaptureReadString(&Payload);
+
+			uint32_t Pass = 0;
+			while((Pass < Stats->PassCount) && strcmp(Stats->Passes[Pass].Name, Name))
+			{
+				Pass++;
+			}
+			if(Pass == Stats->PassCount)
+			{
+				Assert(Stats->PassCount < CAPTURE_MAX_PASSES);
+				Stats->Passes[Stats->PassCount++].Name = Name;
+			}
+
+			Assert(QueryCount < CAPTURE_MAX_QUERIES);
+			QueryIDs[QueryCount] = ID;
+			QueryPasses[QueryCount] = Pass;
+			QueryCount++;
+		}
+	}
+
+	return(QueryCount);
+}
+
+inline uint32_t
+GetCaptureQueryIndex(uint32_t QueryCount, uint32_t *QueryIDs, uint32_t ID)
+{
+	uint32_t Result = UINT32_MAX;
+	for(uint32_t QueryIndex = 0; QueryIndex < QueryCount; QueryIndex++)
+	{
+		if(QueryIDs[QueryIndex] == ID)
+		{
+			Result = QueryIndex;
+			break;
+		}
+	}
+	Assert(Result != UINT32_MAX);
+	return(Result);
+}
+
+#define CAPTURE_MAX_STATE_SIZE 128
+
+// NOTE(georgy): Walks the stream with a shadow copy of the pipeline state. Slotted calls are tracked per slot,
+// the rest by comparing the whole payload with the last one of the same call.
+// Draws between a query's Begin and End go to its pass, and so do the results of GetData for the queries issued in the capture.
+static void
+AnalyzeCapture(capture *Capture, capture_stats *Stats)
+{
+	*Stats = {};
+	Stats->FrameCount = Capture->FrameCount;
+	Stats->CommandBytes = Capture->CommandStreamSize;
+
+	uint32_t QueryIDs[CAPTURE_MAX_QUERIES];
+	uint32_t QueryPasses[CAPTURE_MAX_QUERIES];
+	uint32_t QueryCount = GetCapturePasses(Capture, Stats, QueryIDs, QueryPasses);
+	capture_query_work QueryWork[CAPTURE_MAX_QUERIES] = {};
+	capture_pass_stats *OpenPass = 0;
+	capture_query_work *OpenQuery = 0;
+
+	uint32_t SlotState[GraphicsCall_Count][GFX_MAX_BOUND_RESOURCES][3];
+	bool SlotValid[GraphicsCall_Count][GFX_MAX_BOUND_RESOURCES] = {};
+	uint8_t LastPayload[GraphicsCall_Count][CAPTURE_MAX_STATE_SIZE];
+	uint32_t LastPayloadSize[GraphicsCall_Count];
+	for(uint32_t Call = 0; Call < GraphicsCall_Count; Call++)
+	{
+		LastPayloadSize[Call] = UINT32_MAX;
+	}
+
+	uint8_t *At = Capture->CommandStream;
+	uint8_t *End = At + Capture->CommandStreamSize;
+	while(At < End)
+	{
+		uint32_t Header = CaptureReadU32(&At);
+		uint32_t Call = Header & 0xFF;
+		uint32_t PayloadSize = Header >> 8;
+		uint8_t *Payload = At;
+		At += PayloadSize;
+
+		if(Call >= GraphicsCall_Count)
+		{
+			Assert(!"Unknown context command");
+			continue;
+		}
+		Stats->CallCounts[Call]++;
+
+		bool Redundant = false;
+		switch(Call)
+		{
+			case GraphicsCall_IASetVertexBuffers:
+			case GraphicsCall_VSSetConstantBuffers:
+			case GraphicsCall_PSSetConstantBuffers:
+			case GraphicsCall_VSSetConstantBuffers1:
+			case GraphicsCall_PSSetConstantBuffers1:
+			case GraphicsCall_PSSetShaderResources:
+			case GraphicsCall_PSSetSamplers:
+			{
+				uint32_t Slot = CaptureReadU32(&Payload);
+				uint32_t Count = CaptureReadU32(&Payload);
+				uint32_t ValuesPerSlot = ((Call == GraphicsCall_IASetVertexBuffers) ||
+										  (Call == GraphicsCall_VSSetConstantBuffers1) ||
+										  (Call == GraphicsCall_PSSetConstantBuffers1)) ? 3 : 1;
+				Assert(Slot + Count <= GFX_MAX_BOUND_RESOURCES);
+
+				// NOTE(georgy): Ranged and whole constant buffer bindings go to the same slots, whole buffer is range 0, 0
+				uint32_t ShadowCall = Call;
+				ShadowCall = (Call == GraphicsCall_VSSetConstantBuffers1) ? GraphicsCall_VSSetConstantBuffers : ShadowCall;
+				ShadowCall = (Call == GraphicsCall_PSSetConstantBuffers1) ? GraphicsCall_PSSetConstantBuffers : ShadowCall;
+
+				Redundant = true;
+				for(uint32_t SlotIndex = Slot; SlotIndex < Slot + Count; SlotIndex++)
+				{
+					uint32_t Values[3] = {};
+					for(uint32_t ValueIndex = 0; ValueIndex < ValuesPerSlot; ValueIndex++)
+					{
+						Values[ValueIndex] = CaptureReadU32(&Payload);
+					}
+
+					if(!SlotValid[ShadowCall][SlotIndex] || memcmp(SlotState[ShadowCall][SlotIndex], Values, sizeof(Values)))
+					{
+						Redundant = false;
+						SlotValid[ShadowCall][SlotIndex] = true;
+						memcpy(SlotState[ShadowCall][SlotIndex], Values, sizeof(Values));
+					}
+				}
+			} break;
+
+			case GraphicsCall_RSSetViewports:
+			case GraphicsCall_RSSetState:
+			case GraphicsCall_OMSetRenderTargets:
+			case GraphicsCall_OMSetDepthStencilState:
+			case GraphicsCall_OMSetBlendState:
+			case GraphicsCall_IASetInputLayout:
+			case GraphicsCall_IASetPrimitiveTopology:
+			case GraphicsCall_IASetIndexBuffer:
+			case GraphicsCall_VSSetShader:
+			case GraphicsCall_PSSetShader:
+			{
+				Assert(PayloadSize <= CAPTURE_MAX_STATE_SIZE);
+				Redundant = (LastPayloadSize[Call] == PayloadSize) && !memcmp(LastPayload[Call], Payload, PayloadSize);
+				LastPayloadSize[Call] = PayloadSize;
+				memcpy(LastPayload[Call], Payload, PayloadSize);
+			} break;
+
+			case GraphicsCall_Unmap:
+			{
+				CaptureReadU32(&Payload);
+				CaptureReadU32(&Payload);
+				Stats->UploadBytes += CaptureReadU32(&Payload);
+			} break;
+
+			case GraphicsCall_Draw:
+			case GraphicsCall_DrawIndexed:
+			case GraphicsCall_DrawIndexedInstanced:
+			{
+				if(OpenPass)
+				{
+					uint32_t InstanceCount = 1;
+					if(Call == GraphicsCall_DrawIndexedInstanced)
+					{
+						CaptureReadU32(&Payload);
+						InstanceCount = CaptureReadU32(&Payload);
+					}
+					OpenPass->DrawCount++;
+					OpenPass->InstanceCount += InstanceCount;
+					OpenQuery->DrawCount++;
+					OpenQuery->InstanceCount += InstanceCount;
+				}
+			} break;
+
+			case GraphicsCall_Begin:
+			{
+				Assert(!OpenPass);
+				uint32_t QueryIndex = GetCaptureQueryIndex(QueryCount, QueryIDs, CaptureReadU32(&Payload));
+				OpenPass = Stats->Passes + QueryPasses[QueryIndex];
+				OpenQuery = QueryWork + QueryIndex;
+				OpenQuery->Issued = true;
+				OpenQuery->DrawCount = 0;
+				OpenQuery->InstanceCount = 0;
+			} break;
+
+			case GraphicsCall_End:
+			{
+				uint32_t QueryIndex = GetCaptureQueryIndex(QueryCount, QueryIDs, CaptureReadU32(&Payload));
+				Assert(OpenQuery == QueryWork + QueryIndex);
+				OpenPass = 0;
+				OpenQuery = 0;
+			} break;
+
+			case GraphicsCall_GetData:
+			{
+				uint32_t QueryIndex = GetCaptureQueryIndex(QueryCount, QueryIDs, CaptureReadU32(&Payload));
+				capture_pass_stats *Pass = Stats->Passes + QueryPasses[QueryIndex];
+				capture_query_work *Work = QueryWork + QueryIndex;
+
+				// NOTE(georgy): Results of queries issued before the capture started are for frames it doesn't have
+				if(CaptureReadU32(&Payload) && Work->Issued)
+				{
+					gfx_pipeline_statistics Statistics = CaptureReadPipelineStatistics(&Payload);
+					Pass->Statistics.IAPrimitives += Statistics.IAPrimitives;
+					Pass->Statistics.VSInvocations += Statistics.VSInvocations;
+					Pass->Statistics.PSInvocations += Statistics.PSInvocations;
+					Pass->MeasuredDrawCount += Work->DrawCount;
+					Pass->MeasuredInstanceCount += Work->InstanceCount;
+					Pass->ResultCount++;
+				}
+			} break;
+		}
+
+		if(Redundant)
+		{
+			Stats->RedundantCounts[Call]++;
+		}
+	}
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "graphics.hpp"
+
+//
+// NOTE(georgy): Constant ring. One big dynamic buffer that per-frame data gets suballocated from.
+// The renderer uses it for the per-instance vertex buffer: it's mapped once per frame with NO_OVERWRITE and each
+// allocation is read through its offset (IASetVertexBuffers, StartInstance), so there is no Map/Unmap per draw
+// and no driver renaming. A constant buffer ring would be bound by offset with VS/PSSetConstantBuffers1 instead,
+// which needs the driver to support constant buffer offsets.
+//
+// Head and Tail are byte positions that only ever grow, the offset in the buffer is Position % Size.
+// Head is where the next allocation goes, Tail is the start of the oldest data the GPU might still be reading.
+// Each frame leaves a fence with its end position. Once the caller says a frame is done on the GPU, Tail moves past it.
+// An allocation that doesn't fit before the end of the buffer skips to the start, the skipped bytes belong to that frame.
+//
+
+#define CONSTANT_RING_MAX_FRAMES_IN_FLIGHT 8
+
+struct constant_ring_fence
+{
+	uint64_t FrameIndex;
+	uint64_t End;
+};
+
+struct constant_ring
+{
+	gfx_buffer *Buffer;
+	uint32_t Size;
+
+	uint64_t Head;
+	uint64_t Tail;
+
+	uint64_t FrameIndex;
+	uint32_t FirstFence;
+	uint32_t FenceCount;
+	constant_ring_fence Fences[CONSTANT_RING_MAX_FRAMES_IN_FLIGHT];
+
+	uint8_t *Mapped;
+	bool WasMapped;
+
+	uint32_t WrapCount;
+	uint32_t FailedAllocationCount;
+	uint64_t PeakUsedSize;
+};
+
+// NOTE(georgy): Memory is 0 if the ring is full
+struct constant_allocation
+{
+	void *Memory;
+	uint32_t Offset;
+	uint32_t FirstConstant;
+	uint32_t NumConstants;
+};
+
+static void
+InitializeConstantRing(constant_ring *Ring, graphics_device *Device, uint32_t Size, gfx_buffer_bind Bind = GfxBufferBind_Constant)
+{
+	Assert((Size % GFX_CONSTANT_BUFFER_ALIGNMENT) == 0);
+
+	*Ring = {};
+	Ring->Size = Size;
+	gfx_buffer_desc RingDesc = BufferDesc(Size, GfxBufferUsage_Dynamic, Bind);
+	Ring->Buffer = Device->CreateBuffer(Device, &RingDesc);
+}
+
+// NOTE(georgy): Frames before CompletedFrameCount are done on the GPU, their constants can be overwritten
+static void
+RetireConstantRingFrames(constant_ring *Ring, uint64_t CompletedFrameCount)
+{
+	while(Ring->FenceCount && (Ring->Fences[Ring->FirstFence].FrameIndex < CompletedFrameCount))
+	{
+		Ring->Tail = Ring->Fences[Ring->FirstFence].End;
+		Ring->FirstFence = (Ring->FirstFence + 1) % CONSTANT_RING_MAX_FRAMES_IN_FLIGHT;
+		Ring->FenceCount--;
+	}
+}
+
+static void
+BeginConstantRingFrame(constant_ring *Ring, graphics_context *Context, uint64_t CompletedFrameCount)
+{
+	RetireConstantRingFrames(Ring, CompletedFrameCount);
+	Assert(Ring->FenceCount < CONSTANT_RING_MAX_FRAMES_IN_FLIGHT);
+
+	// NOTE(georgy): NO_OVERWRITE is only allowed after the buffer was discarded once
+	Ring->Mapped = (uint8_t *)Context->Map(Context, Ring->Buffer, Ring->WasMapped ? GfxMap_WriteNoOverwrite : GfxMap_WriteDiscard);
+	Ring->WasMapped = true;
+}
+
+static constant_allocation
+PushConstants(constant_ring *Ring, uint32_t Size)
+{
+	constant_allocation Result = {};
+
+	uint32_t AlignedSize = (Size + GFX_CONSTANT_BUFFER_ALIGNMENT - 1) & ~(GFX_CONSTANT_BUFFER_ALIGNMENT - 1);
+	uint64_t Start = Ring->Head;
+	uint32_t Offset = (uint32_t)(Start % Ring->Size);
+	bool Wraps = (Offset + AlignedSize > Ring->Size);
+	if(Wraps)
+	{
+		Start += Ring->Size - Offset;
+		Offset = 0;
+	}
+
+	uint64_t End = Start + AlignedSize;
+	if((AlignedSize <= Ring->Size) && (End - Ring->Tail <= Ring->Size))
+	{
+		Assert(Ring->Mapped);
+		Ring->Head = End;
+		Ring->WrapCount += Wraps ? 1 : 0;
+		Ring->PeakUsedSize = ((End - Ring->Tail) > Ring->PeakUsedSize) ? (End - Ring->Tail) : Ring->PeakUsedSize;
+
+		Result.Memory = Ring->Mapped + Offset;
+		Result.Offset = Offset;
+		Result.FirstConstant = Offset / GFX_CONSTANT_SIZE;
+		Result.NumConstants = AlignedSize / GFX_CONSTANT_SIZE;
+	}
+	else
+	{
+		Ring->FailedAllocationCount++;
+	}
+
+	return(Result);
+}
+
+#define PushConstantStruct(Ring, type) PushConstants(Ring, sizeof(type))
+
+static void
+EndConstantRingFrame(constant_ring *Ring, graphics_context *Context)
+{
+	Context->Unmap(Context, Ring->Buffer);
+	Ring->Mapped = 0;
+
+	constant_ring_fence *Fence = Ring->Fences + ((Ring->FirstFence + Ring->FenceCount) % CONSTANT_RING_MAX_FRAMES_IN_FLIGHT);
+	Fence->FrameIndex = Ring->FrameIndex++;
+	Fence->End = Ring->Head;
+	Ring->FenceCount++;
+}
+
+inline uint32_t
+GetConstantRingUsedSize(constant_ring *Ring)
+{
+	uint32_t Result = (uint32_t)(Ring->Head - Ring->Tail);
+	return(Result);
+}
@@ -0,0 +1,567 @@
+#pragma once
+
+#include "graphics.hpp"
+
+//
+// NOTE(georgy): D3D11 graphics backend. Buffers, shaders and states are the D3D11 objects themselves,
+// textures carry all their views, and vertex shaders keep their bytecode around for input layouts.
+//
+
+struct d3d11_graphics
+{
+	ID3D11Device *Device;
+	ID3D11DeviceContext *ImmediateContext;
+	ID3D11DeviceContext1 *ImmediateContext1;
+	IDXGISwapChain *SwapChain;
+	bool ConstantBufferOffsets;
+
+	memory_arena *Arena;
+};
+
+struct d3d_texture
+{
+	ID3D11Texture2D *Texture;
+	ID3D11RenderTargetView *RTV;
+	ID3D11DepthStencilView *DSV;
+	ID3D11ShaderResourceView *SRV;
+};
+
+struct d3d_vertex_shader
+{
+	ID3D11VertexShader *Shader;
+	ID3D10Blob *Bytecode;
+};
+
+inline d3d11_graphics *
+GetD3D11Graphics(graphics_device *Device)
+{
+	d3d11_graphics *Result = (d3d11_graphics *)Device->Data;
+	return(Result);
+}
+
+inline ID3D11DeviceContext *
+GetD3D11Context(graphics_context *Context)
+{
+	ID3D11DeviceContext *Result = ((d3d11_graphics *)Context->Data)->ImmediateContext;
+	return(Result);
+}
+
+static gfx_buffer *
+D3D11CreateBuffer(graphics_device *Device, gfx_buffer_desc *Desc)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+
+	D3D11_BUFFER_DESC BufferDescr;
+	BufferDescr.ByteWidth = Desc->Size;
+	BufferDescr.Usage = (Desc->Usage == GfxBufferUsage_Dynamic) ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_IMMUTABLE;
+	switch(Desc->Bind)
+	{
+		case GfxBufferBind_Vertex: BufferDescr.BindFlags = D3D11_BIND_VERTEX_BUFFER; break;
+		case GfxBufferBind_Index: BufferDescr.BindFlags = D3D11_BIND_INDEX_BUFFER; break;
+		case GfxBufferBind_Constant: BufferDescr.BindFlags = D3D11_BIND_CONSTANT_BUFFER; break;
+	}
+	BufferDescr.CPUAccessFlags = (Desc->Usage == GfxBufferUsage_Dynamic) ? D3D11_CPU_ACCESS_WRITE : 0;
+	BufferDescr.MiscFlags = 0;
+	BufferDescr.StructureByteStride = 0;
+
+	D3D11_SUBRESOURCE_DATA BufferInitData;
+	BufferInitData.pSysMem = Desc->InitialData;
+	BufferInitData.SysMemPitch = 0;
+	BufferInitData.SysMemSlicePitch = 0;
+
+	ID3D11Buffer *Result = 0;
+	D3D->Device->CreateBuffer(&BufferDescr, Desc->InitialData ? &BufferInitData : 0, &Result);
+	return((gfx_buffer *)Result);
+}
+
+static gfx_texture *
+D3D11CreateTexture(graphics_device *Device, texture_desc *Desc, const char *Name)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+	d3d_texture *Result = PushStruct(D3D->Arena, d3d_texture, true);
+
+	// NOTE(georgy): Depth formats are created typeless, so they can also be sampled
+	DXGI_FORMAT TextureFormat, ViewFormat, DepthViewFormat = DXGI_FORMAT_UNKNOWN;
+	switch(Desc->Format)
+	{
+		case TextureFormat_RGBA8: TextureFormat = ViewFormat = DXGI_FORMAT_R8G8B8A8_UNORM; break;
+		case TextureFormat_RGBA16F: TextureFormat = ViewFormat = DXGI_FORMAT_R16G16B16A16_FLOAT; break;
+		case TextureFormat_RGBA32F: TextureFormat = ViewFormat = DXGI_FORMAT_R32G32B32A32_FLOAT; break;
+		case TextureFormat_R32F: TextureFormat = ViewFormat = DXGI_FORMAT_R32_FLOAT; break;
+		case TextureFormat_Depth32:
+		{
+			TextureFormat = DXGI_FORMAT_R32_TYPELESS;
+			ViewFormat = DXGI_FORMAT_R32_FLOAT;
+			DepthViewFormat = DXGI_FORMAT_D32_FLOAT;
+		} break;
+		case TextureFormat_Depth24Stencil8:
+		{
+			TextureFormat = DXGI_FORMAT_R24G8_TYPELESS;
+			ViewFormat = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+			DepthViewFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+		} break;
+		default: TextureFormat = ViewFormat = DXGI_FORMAT_UNKNOWN; Assert(!"Unknown texture format");
+	}
+
+	D3D11_TEXTURE2D_DESC TextureDescr;
+	TextureDescr.Width = Desc->Width;
+	TextureDescr.Height = Desc->Height;
+	TextureDescr.MipLevels = Desc->MipCount;
+	TextureDescr.ArraySize = 1;
+	TextureDescr.Format = TextureFormat;
+	TextureDescr.SampleDesc.Count = 1;
+	TextureDescr.SampleDesc.Quality = 0;
+	TextureDescr.Usage = D3D11_USAGE_DEFAULT;
+	TextureDescr.BindFlags = 0;
+	TextureDescr.BindFlags |= (Desc->BindFlags & TextureBind_ShaderResource) ? D3D11_BIND_SHADER_RESOURCE : 0;
+	TextureDescr.BindFlags |= (Desc->BindFlags & TextureBind_RenderTarget) ? D3D11_BIND_RENDER_TARGET : 0;
+	TextureDescr.BindFlags |= (Desc->BindFlags & TextureBind_DepthStencil) ? D3D11_BIND_DEPTH_STENCIL : 0;
+	TextureDescr.CPUAccessFlags = 0;
+	TextureDescr.MiscFlags = (Desc->MipCount > 1) ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0;
+	D3D->Device->CreateTexture2D(&TextureDescr, 0, &Result->Texture);
+
+	if(Desc->BindFlags & TextureBind_RenderTarget)
+	{
+		D3D->Device->CreateRenderTargetView(Result->Texture, 0, &Result->RTV);
+	}
+	if(Desc->BindFlags & TextureBind_DepthStencil)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC DepthViewDescr;
+		DepthViewDescr.Format = DepthViewFormat;
+		DepthViewDescr.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		DepthViewDescr.Flags = 0;
+		DepthViewDescr.Texture2D.MipSlice = 0;
+		D3D->Device->CreateDepthStencilView(Result->Texture, &DepthViewDescr, &Result->DSV);
+	}
+	if(Desc->BindFlags & TextureBind_ShaderResource)
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC ResourceViewDescr;
+		ResourceViewDescr.Format = ViewFormat;
+		ResourceViewDescr.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		ResourceViewDescr.Texture2D.MipLevels = Desc->MipCount;
+		ResourceViewDescr.Texture2D.MostDetailedMip = 0;
+		D3D->Device->CreateShaderResourceView(Result->Texture, &ResourceViewDescr, &Result->SRV);
+	}
+
+	return((gfx_texture *)Result);
+}
+
+static void
+D3D11DestroyTexture(graphics_device *Device, gfx_texture *Texture)
+{
+	d3d_texture *D3DTexture = (d3d_texture *)Texture;
+	if(D3DTexture->SRV) D3DTexture->SRV->Release();
+	if(D3DTexture->DSV) D3DTexture->DSV->Release();
+	if(D3DTexture->RTV) D3DTexture->RTV->Release();
+	D3DTexture->Texture->Release();
+}
+
+static ID3D10Blob *
+D3D11CompileShader(const char *Filename, const char *EntryPoint, const char *Target)
+{
+	wchar_t WideFilename[256];
+	uint32_t CharIndex = 0;
+	for(; Filename[CharIndex] && (CharIndex < ArrayCount(WideFilename) - 1); CharIndex++)
+	{
+		WideFilename[CharIndex] = (wchar_t)Filename[CharIndex];
+	}
+	WideFilename[CharIndex] = 0;
+
+	ID3D10Blob *Result = 0;
+	ID3D10Blob *CompilationMessages = 0;
+	HRESULT Hr = D3DCompileFromFile(WideFilename, 0, 0, EntryPoint, Target, D3D10_SHADER_DEBUG | D3D10_SHADER_SKIP_OPTIMIZATION,
+									0, &Result, &CompilationMessages);
+	if(CompilationMessages)
+	{
+		MessageBox(0, (char *)CompilationMessages->GetBufferPointer(), 0, 0);
+		CompilationMessages->Release();
+	}
+	if(FAILED(Hr))
+	{
+		MessageBox(0, "D3D11CompileFromFile failed", 0, 0);
+	}
+
+	return(Result);
+}
+
+static gfx_vertex_shader *
+D3D11CreateVertexShader(graphics_device *Device, const char *Filename, const char *EntryPoint)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+	d3d_vertex_shader *Result = PushStruct(D3D->Arena, d3d_vertex_shader, true);
+
+	Result->Bytecode = D3D11CompileShader(Filename, EntryPoint, "vs_5_0");
+	if(Result->Bytecode)
+	{
+		D3D->Device->CreateVertexShader(Result->Bytecode->GetBufferPointer(), Result->Bytecode->GetBufferSize(), 0, &Result->Shader);
+	}
+
+	return((gfx_vertex_shader *)Result);
+}
+
+static gfx_pixel_shader *
+D3D11CreatePixelShader(graphics_device *Device, const char *Filename, const char *EntryPoint)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+
+	ID3D11PixelShader *Result = 0;
+	ID3D10Blob *Bytecode = D3D11CompileShader(Filename, EntryPoint, "ps_5_0");
+	if(Bytecode)
+	{
+		D3D->Device->CreatePixelShader(Bytecode->GetBufferPointer(), Bytecode->GetBufferSize(), 0, &Result);
+		Bytecode->Release();
+	}
+
+	return((gfx_pixel_shader *)Result);
+}
+
+static gfx_input_layout *
+D3D11CreateInputLayout(graphics_device *Device, gfx_input_element *Elements, uint32_t ElementCount, gfx_vertex_shader *Shader)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+	d3d_vertex_shader *VertexShader = (d3d_vertex_shader *)Shader;
+
+	D3D11_INPUT_ELEMENT_DESC InputLayoutDescription[GFX_MAX_BOUND_RESOURCES];
+	Assert(ElementCount <= ArrayCount(InputLayoutDescription));
+	for(uint32_t ElementIndex = 0; ElementIndex < ElementCount; ElementIndex++)
+	{
+		gfx_input_element *Element = Elements + ElementIndex;
+		D3D11_INPUT_ELEMENT_DESC *Descr = InputLayoutDescription + ElementIndex;
+
+		Descr->SemanticName = Element->SemanticName;
+		Descr->SemanticIndex = Element->SemanticIndex;
+		switch(Element->Format)
+		{
+			case GfxVertexFormat_Float2: Descr->Format = DXGI_FORMAT_R32G32_FLOAT; break;
+			case GfxVertexFormat_Float3: Descr->Format = DXGI_FORMAT_R32G32B32_FLOAT; break;
+			case GfxVertexFormat_Float4: Descr->Format = DXGI_FORMAT_R32G32B32A32_FLOAT; break;
+		}
+		Descr->InputSlot = Element->Slot;
+		Descr->AlignedByteOffset = Element->Offset;
+		Descr->InputSlotClass = Element->PerInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+		Descr->InstanceDataStepRate = Element->PerInstance ? 1 : 0;
+	}
+
+	ID3D11InputLayout *Result = 0;
+	D3D->Device->CreateInputLayout(InputLayoutDescription, ElementCount,
+								   VertexShader->Bytecode->GetBufferPointer(), VertexShader->Bytecode->GetBufferSize(), &Result);
+	return((gfx_input_layout *)Result);
+}
+
+inline D3D11_COMPARISON_FUNC
+D3D11ComparisonFunc(gfx_comparison Comparison)
+{
+	D3D11_COMPARISON_FUNC Result = D3D11_COMPARISON_NEVER;
+	switch(Comparison)
+	{
+		case GfxComparison_Never: Result = D3D11_COMPARISON_NEVER; break;
+		case GfxComparison_Less: Result = D3D11_COMPARISON_LESS; break;
+		case GfxComparison_LessEqual: Result = D3D11_COMPARISON_LESS_EQUAL; break;
+		case GfxComparison_Equal: Result = D3D11_COMPARISON_EQUAL; break;
+		case GfxComparison_Always: Result = D3D11_COMPARISON_ALWAYS; break;
+	}
+	return(Result);
+}
+
+static gfx_depth_state *
+D3D11CreateDepthState(graphics_device *Device, gfx_depth_state_desc *Desc)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+
+	D3D11_DEPTH_STENCIL_DESC DepthStencilStateDescr;
+	DepthStencilStateDescr.DepthEnable = Desc->DepthEnable;
+	DepthStencilStateDescr.DepthWriteMask = Desc->DepthWrite ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+	DepthStencilStateDescr.DepthFunc = D3D11ComparisonFunc(Desc->DepthFunc);
+	DepthStencilStateDescr.StencilEnable = false;
+	DepthStencilStateDescr.StencilReadMask = 0;
+	DepthStencilStateDescr.StencilWriteMask = 0;
+	DepthStencilStateDescr.FrontFace = {};
+	DepthStencilStateDescr.BackFace = {};
+
+	ID3D11DepthStencilState *Result = 0;
+	D3D->Device->CreateDepthStencilState(&DepthStencilStateDescr, &Result);
+	return((gfx_depth_state *)Result);
+}
+
+static gfx_raster_state *
+D3D11CreateRasterState(graphics_device *Device, gfx_raster_state_desc *Desc)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+
+	D3D11_RASTERIZER_DESC RasterizerStateDescr;
+	RasterizerStateDescr.FillMode = D3D11_FILL_SOLID;
+	switch(Desc->CullMode)
+	{
+		case GfxCullMode_None: RasterizerStateDescr.CullMode = D3D11_CULL_NONE; break;
+		case GfxCullMode_Front: RasterizerStateDescr.CullMode = D3D11_CULL_FRONT; break;
+		case GfxCullMode_Back: RasterizerStateDescr.CullMode = D3D11_CULL_BACK; break;
+	}
+	RasterizerStateDescr.FrontCounterClockwise = Desc->FrontCounterClockwise;
+	RasterizerStateDescr.DepthBias = Desc->DepthBias;
+	RasterizerStateDescr.DepthBiasClamp = 0;
+	RasterizerStateDescr.SlopeScaledDepthBias = Desc->SlopeScaledDepthBias;
+	RasterizerStateDescr.DepthClipEnable = TRUE;
+	RasterizerStateDescr.ScissorEnable = FALSE;
+	RasterizerStateDescr.MultisampleEnable = FALSE;
+	RasterizerStateDescr.AntialiasedLineEnable = FALSE;
+
+	ID3D11RasterizerState *Result = 0;
+	D3D->Device->CreateRasterizerState(&RasterizerStateDescr, &Result);
+	return((gfx_raster_state *)Result);
+}
+
+static gfx_blend_state *
+D3D11CreateBlendState(graphics_device *Device, gfx_blend_state_desc *Desc)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+
+	D3D11_BLEND_DESC BlendStateDescr = {};
+	BlendStateDescr.AlphaToCoverageEnable = FALSE;
+	BlendStateDescr.IndependentBlendEnable = FALSE;
+	BlendStateDescr.RenderTarget[0].BlendEnable = Desc->BlendEnable;
+	BlendStateDescr.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	BlendStateDescr.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	BlendStateDescr.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	BlendStateDescr.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	BlendStateDescr.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+	BlendStateDescr.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	BlendStateDescr.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+	ID3D11BlendState *Result = 0;
+	D3D->Device->CreateBlendState(&BlendStateDescr, &Result);
+	return((gfx_blend_state *)Result);
+}
+
+static gfx_sampler *
+D3D11CreateSampler(graphics_device *Device, gfx_sampler_desc *Desc)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+
+	D3D11_TEXTURE_ADDRESS_MODE AddressMode = (Desc->AddressMode == GfxAddressMode_Border) ? D3D11_TEXTURE_ADDRESS_BORDER : D3D11_TEXTURE_ADDRESS_CLAMP;
+
+	D3D11_SAMPLER_DESC SamplerDescr;
+	SamplerDescr.Filter = (Desc->Filter == GfxFilter_Linear) ? D3D11_FILTER_MIN_MAG_MIP_LINEAR : D3D11_FILTER_MIN_MAG_MIP_POINT;
+	SamplerDescr.AddressU = AddressMode;
+	SamplerDescr.AddressV = AddressMode;
+	SamplerDescr.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	SamplerDescr.MipLODBias = 0;
+	SamplerDescr.MaxAnisotropy = 1;
+	SamplerDescr.ComparisonFunc = D3D11ComparisonFunc(Desc->Comparison);
+	SamplerDescr.BorderColor[0] = SamplerDescr.BorderColor[1] = SamplerDescr.BorderColor[2] = SamplerDescr.BorderColor[3] = 0.0f;
+	SamplerDescr.MinLOD = -D3D11_FLOAT32_MAX;
+	SamplerDescr.MaxLOD = D3D11_FLOAT32_MAX;
+
+	ID3D11SamplerState *Result = 0;
+	D3D->Device->CreateSamplerState(&SamplerDescr, &Result);
+	return((gfx_sampler *)Result);
+}
+
+static gfx_query *
+D3D11CreateQuery(graphics_device *Device, const char *Name)
+{
+	d3d11_graphics *D3D = GetD3D11Graphics(Device);
+
+	D3D11_QUERY_DESC QueryDescr;
+	QueryDescr.Query = D3D11_QUERY_PIPELINE_STATISTICS;
+	QueryDescr.MiscFlags = 0;
+
+	ID3D11Query *Result = 0;
+	D3D->Device->CreateQuery(&QueryDescr, &Result);
+	return((gfx_query *)Result);
+}
+
+//
+// NOTE(georgy): Context
+//
+
+static void
+D3D11RSSetViewports(graphics_context *Context, uint32_t Count, gfx_viewport *Viewports)
+{
+	D3D11_VIEWPORT D3DViewports[GFX_MAX_BOUND_RESOURCES];
+	Assert(Count <= ArrayCount(D3DViewports));
+	for(uint32_t ViewportIndex = 0; ViewportIndex < Count; ViewportIndex++)
+	{
+		D3DViewports[ViewportIndex].TopLeftX = Viewports[ViewportIndex].TopLeftX;
+		D3DViewports[ViewportIndex].TopLeftY = Viewports[ViewportIndex].TopLeftY;
+		D3DViewports[ViewportIndex].Width = Viewports[ViewportIndex].Width;
+		D3DViewports[ViewportIndex].Height = Viewports[ViewportIndex].Height;
+		D3DViewports[ViewportIndex].MinDepth = Viewports[ViewportIndex].MinDepth;
+		D3DViewports[ViewportIndex].MaxDepth = Viewports[ViewportIndex].MaxDepth;
+	}
+	GetD3D11Context(Context)->RSSetViewports(Count, D3DViewports);
+}
+
+static void
+D3D11OMSetRenderTargets(graphics_context *Context, uint32_t Count, gfx_texture **RenderTargets, gfx_texture *DepthStencil)
+{
+	ID3D11RenderTargetView *RTVs[GFX_MAX_BOUND_RESOURCES];
+	Assert(Count <= ArrayCount(RTVs));
+	for(uint32_t TargetIndex = 0; TargetIndex < Count; TargetIndex++)
+	{
+		RTVs[TargetIndex] = RenderTargets[TargetIndex] ? ((d3d_texture *)RenderTargets[TargetIndex])->RTV : 0;
+	}
+	ID3D11DepthStencilView *DSV = DepthStencil ? ((d3d_texture *)DepthStencil)->DSV : 0;
+	GetD3D11Context(Context)->OMSetRenderTargets(Count, RTVs, DSV);
+}
+
+static void
+D3D11PSSetShaderResources(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_texture **Textures)
+{
+	ID3D11ShaderResourceView *SRVs[GFX_MAX_BOUND_RESOURCES];
+	Assert(Count <= ArrayCount(SRVs));
+	for(uint32_t TextureIndex = 0; TextureIndex < Count; TextureIndex++)
+	{
+		SRVs[TextureIndex] = Textures[TextureIndex] ? ((d3d_texture *)Textures[TextureIndex])->SRV : 0;
+	}
+	GetD3D11Context(Context)->PSSetShaderResources(Slot, Count, SRVs);
+}
+
+static void
+D3D11ClearRenderTargetView(graphics_context *Context, gfx_texture *RenderTarget, const real32 *Color)
+{
+	GetD3D11Context(Context)->ClearRenderTargetView(((d3d_texture *)RenderTarget)->RTV, Color);
+}
+
+static void
+D3D11ClearDepthStencilView(graphics_context *Context, gfx_texture *DepthStencil, uint32_t ClearFlags, real32 Depth, uint8_t Stencil)
+{
+	UINT D3DClearFlags = 0;
+	D3DClearFlags |= (ClearFlags & GfxClear_Depth) ? D3D11_CLEAR_DEPTH : 0;
+	D3DClearFlags |= (ClearFlags & GfxClear_Stencil) ? D3D11_CLEAR_STENCIL : 0;
+	GetD3D11Context(Context)->ClearDepthStencilView(((d3d_texture *)DepthStencil)->DSV, D3DClearFlags, Depth, Stencil);
+}
+
+static void
+D3D11GenerateMips(graphics_context *Context, gfx_texture *Texture)
+{
+	GetD3D11Context(Context)->GenerateMips(((d3d_texture *)Texture)->SRV);
+}
+
+static void
+D3D11IASetPrimitiveTopology(graphics_context *Context, gfx_topology Topology)
+{
+	GetD3D11Context(Context)->IASetPrimitiveTopology((Topology == GfxTopology_TriangleStrip) ? D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+static void
+D3D11IASetIndexBuffer(graphics_context *Context, gfx_buffer *Buffer, gfx_index_format Format, uint32_t Offset)
+{
+	GetD3D11Context(Context)->IASetIndexBuffer((ID3D11Buffer *)Buffer, (Format == GfxIndexFormat_U16) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, Offset);
+}
+
+static void *
+D3D11Map(graphics_context *Context, gfx_buffer *Buffer, gfx_map MapType)
+{
+	D3D11_MAPPED_SUBRESOURCE MappedResource = {};
+	GetD3D11Context(Context)->Map((ID3D11Buffer *)Buffer, 0, (MapType == GfxMap_WriteNoOverwrite) ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD, 0, &MappedResource);
+	return(MappedResource.pData);
+}
+
+static void D3D11RSSetState(graphics_context *Context, gfx_raster_state *State) { GetD3D11Context(Context)->RSSetState((ID3D11RasterizerState *)State); }
+static void D3D11OMSetDepthStencilState(graphics_context *Context, gfx_depth_state *State, uint32_t StencilRef) { GetD3D11Context(Context)->OMSetDepthStencilState((ID3D11DepthStencilState *)State, StencilRef); }
+static void D3D11OMSetBlendState(graphics_context *Context, gfx_blend_state *State, const real32 *BlendFactor, uint32_t SampleMask) { GetD3D11Context(Context)->OMSetBlendState((ID3D11BlendState *)State, BlendFactor, SampleMask); }
+static void D3D11IASetInputLayout(graphics_context *Context, gfx_input_layout *Layout) { GetD3D11Context(Context)->IASetInputLayout((ID3D11InputLayout *)Layout); }
+static void D3D11IASetVertexBuffers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *Strides, uint32_t *Offsets) { GetD3D11Context(Context)->IASetVertexBuffers(Slot, Count, (ID3D11Buffer **)Buffers, Strides, Offsets); }
+static void D3D11VSSetShader(graphics_context *Context, gfx_vertex_shader *Shader) { GetD3D11Context(Context)->VSSetShader(Shader ? ((d3d_vertex_shader *)Shader)->Shader : 0, 0, 0); }
+static void D3D11PSSetShader(graphics_context *Context, gfx_pixel_shader *Shader) { GetD3D11Context(Context)->PSSetShader((ID3D11PixelShader *)Shader, 0, 0); }
+static void D3D11VSSetConstantBuffers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers) { GetD3D11Context(Context)->VSSetConstantBuffers(Slot, Count, (ID3D11Buffer **)Buffers); }
+static void D3D11PSSetConstantBuffers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers) { GetD3D11Context(Context)->PSSetConstantBuffers(Slot, Count, (ID3D11Buffer **)Buffers); }
+
+static void
+D3D11VSSetConstantBuffers1(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *FirstConstant, uint32_t *NumConstants)
+{
+	d3d11_graphics *D3D = (d3d11_graphics *)Context->Data;
+	Assert(D3D->ConstantBufferOffsets);
+	D3D->ImmediateContext1->VSSetConstantBuffers1(Slot, Count, (ID3D11Buffer **)Buffers, FirstConstant, NumConstants);
+}
+
+static void
+D3D11PSSetConstantBuffers1(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *FirstConstant, uint32_t *NumConstants)
+{
+	d3d11_graphics *D3D = (d3d11_graphics *)Context->Data;
+	Assert(D3D->ConstantBufferOffsets);
+	D3D->ImmediateContext1->PSSetConstantBuffers1(Slot, Count, (ID3D11Buffer **)Buffers, FirstConstant, NumConstants);
+}
+
+static void D3D11PSSetSamplers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_sampler **Samplers) { GetD3D11Context(Context)->PSSetSamplers(Slot, Count, (ID3D11SamplerState **)Samplers); }
+static void D3D11Unmap(graphics_context *Context, gfx_buffer *Buffer) { GetD3D11Context(Context)->Unmap((ID3D11Buffer *)Buffer, 0); }
+static void D3D11Draw(graphics_context *Context, uint32_t VertexCount, uint32_t StartVertex) { GetD3D11Context(Context)->Draw(VertexCount, StartVertex); }
+static void D3D11DrawIndexed(graphics_context *Context, uint32_t IndexCount, uint32_t StartIndex, int32_t BaseVertex) { GetD3D11Context(Context)->DrawIndexed(IndexCount, StartIndex, BaseVertex); }
+static void D3D11DrawIndexedInstanced(graphics_context *Context, uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndex, int32_t BaseVertex, uint32_t StartInstance) { GetD3D11Context(Context)->DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndex, BaseVertex, StartInstance); }
+static void D3D11Begin(graphics_context *Context, gfx_query *Query) { GetD3D11Context(Context)->Begin((ID3D11Query *)Query); }
+static void D3D11End(graphics_context *Context, gfx_query *Query) { GetD3D11Context(Context)->End((ID3D11Query *)Query); }
+static void D3D11Present(graphics_context *Context) { ((d3d11_graphics *)Context->Data)->SwapChain->Present(0, 0); }
+
+static bool
+D3D11GetData(graphics_context *Context, gfx_query *Query, gfx_pipeline_statistics *Statistics)
+{
+	D3D11_QUERY_DATA_PIPELINE_STATISTICS Data;
+	bool Result = (GetD3D11Context(Context)->GetData((ID3D11Query *)Query, &Data, sizeof(Data), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK);
+	if(Result)
+	{
+		Statistics->IAPrimitives = Data.IAPrimitives;
+		Statistics->VSInvocations = Data.VSInvocations;
+		Statistics->PSInvocations = Data.PSInvocations;
+	}
+	return(Result);
+}
+
+// NOTE(georgy): Constant buffer offsets need the 11.1 context, and NO_OVERWRITE maps of constant buffers need
+// the driver to report MapNoOverwriteOnDynamicConstantBuffer. The renderer doesn't bind constant buffers by offset
+// (the ring only holds instance data, NO_OVERWRITE on vertex buffers is always there), so they're optional.
+static void
+InitializeD3D11Graphics(d3d11_graphics *D3D, graphics_device *Device, graphics_context *Context)
+{
+	D3D->ImmediateContext1 = 0;
+	D3D->ConstantBufferOffsets = false;
+	if(SUCCEEDED(D3D->ImmediateContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void **)&D3D->ImmediateContext1)))
+	{
+		D3D11_FEATURE_DATA_D3D11_OPTIONS Options = {};
+		D3D->Device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &Options, sizeof(Options));
+		D3D->ConstantBufferOffsets = Options.ConstantBufferOffsetting && Options.MapNoOverwriteOnDynamicConstantBuffer;
+	}
+
+	Device->CreateBuffer = D3D11CreateBuffer;
+	Device->CreateTexture = D3D11CreateTexture;
+	Device->DestroyTexture = D3D11DestroyTexture;
+	Device->CreateVertexShader = D3D11CreateVertexShader;
+	Device->CreatePixelShader = D3D11CreatePixelShader;
+	Device->CreateInputLayout = D3D11CreateInputLayout;
+	Device->CreateDepthState = D3D11CreateDepthState;
+	Device->CreateRasterState = D3D11CreateRasterState;
+	Device->CreateBlendState = D3D11CreateBlendState;
+	Device->CreateSampler = D3D11CreateSampler;
+	Device->CreateQuery = D3D11CreateQuery;
+	Device->Data = D3D;
+
+	Context->RSSetViewports = D3D11RSSetViewports;
+	Context->RSSetState = D3D11RSSetState;
+	Context->OMSetRenderTargets = D3D11OMSetRenderTargets;
+	Context->OMSetDepthStencilState = D3D11OMSetDepthStencilState;
+	Context->OMSetBlendState = D3D11OMSetBlendState;
+	Context->ClearRenderTargetView = D3D11ClearRenderTargetView;
+	Context->ClearDepthStencilView = D3D11ClearDepthStencilView;
+	Context->GenerateMips = D3D11GenerateMips;
+	Context->IASetInputLayout = D3D11IASetInputLayout;
+	Context->IASetPrimitiveTopology = D3D11IASetPrimitiveTopology;
+	Context->IASetVertexBuffers = D3D11IASetVertexBuffers;
+	Context->IASetIndexBuffer = D3D11IASetIndexBuffer;
+	Context->VSSetShader = D3D11VSSetShader;
+	Context->PSSetShader = D3D11PSSetShader;
+	Context->VSSetConstantBuffers = D3D11VSSetConstantBuffers;
+	Context->PSSetConstantBuffers = D3D11PSSetConstantBuffers;
+	Context->VSSetConstantBuffers1 = D3D11VSSetConstantBuffers1;
+	Context->PSSetConstantBuffers1 = D3D11PSSetConstantBuffers1;
+	Context->PSSetShaderResources = D3D11PSSetShaderResources;
+	Context->PSSetSamplers = D3D11PSSetSamplers;
+	Context->Map = D3D11Map;
+	Context->Unmap = D3D11Unmap;
+	Context->Draw = D3D11Draw;
+	Context->DrawIndexed = D3D11DrawIndexed;
+	Context->DrawIndexedInstanced = D3D11DrawIndexedInstanced;
+	Context->Begin = D3D11Begin;
+	Context->End = D3D11End;
+	Context->GetData = D3D11GetData;
+	Context->Present = D3D11Present;
+	Context->Data = D3D;
+}
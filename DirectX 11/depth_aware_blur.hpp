@@ -0,0 +1,94 @@
+#pragma once
+
+//
+// NOTE(georgy): Edge aware blur of the accumulated RSM indirect illumination, BlurPS.hlsl does exactly this per texel.
+//
+// A gaussian of 2*Radius + 1 taps, once horizontally and once vertically, so a texel costs O(Radius) instead of
+// O(Radius^2) for the whole kernel. Every tap's gaussian weight is scaled by how close its depth and normal are
+// to the center's, the same kind of weights as the bilateral upsample, so light doesn't bleed across silhouettes
+// and creases. The center tap always gets its full weight (background texels have no normal to compare).
+// Being bilateral the two passes together aren't exactly the 2D kernel, but close enough away from edges.
+//
+
+// NOTE(georgy): Width of the gaussian over the depth difference, relative to the center's depth
+#define DEPTH_AWARE_BLUR_DEPTH_SIGMA 0.02f
+#define DEPTH_AWARE_BLUR_NORMAL_POWER 16.0f
+#define DEPTH_AWARE_BLUR_MAX_RADIUS 8
+
+// NOTE(georgy): Same layout as the blur_constants cbuffer. Direction is (1, 0) or (0, 1).
+struct depth_aware_blur_constants
+{
+	int32_t Direction[2];
+	int32_t Radius;
+	real32 Sigma;
+};
+
+inline depth_aware_blur_constants
+DepthAwareBlurConstants(int32_t DirectionX, int32_t DirectionY, int32_t Radius)
+{
+	Assert((Radius > 0) && (Radius <= DEPTH_AWARE_BLUR_MAX_RADIUS));
+
+	depth_aware_blur_constants Result;
+	Result.Direction[0] = DirectionX;
+	Result.Direction[1] = DirectionY;
+	Result.Radius = Radius;
+	Result.Sigma = 0.5f*Radius;
+	return(Result);
+}
+
+inline real32
+GetDepthAwareBlurWeight(real32 Depth, v3 Normal, real32 TapDepth, v3 TapNormal)
+{
+	real32 DepthDifference = (TapDepth - Depth) / (DEPTH_AWARE_BLUR_DEPTH_SIGMA*Depth);
+	real32 DepthWeight = expf(-DepthDifference*DepthDifference);
+	real32 NormalWeight = powf(fmaxf(Dot(Normal, TapNormal), 0.0f), DEPTH_AWARE_BLUR_NORMAL_POWER);
+
+	real32 Result = DepthWeight*NormalWeight;
+	return(Result);
+}
+
+// NOTE(georgy): One direction. Depths and Normals are at the resolution of the image,
+// BlurPS.hlsl reads them from the G-buffer at the full resolution pixel of every texel.
+static void
+DepthAwareBlurPass(v3 *Dest, v3 *Source, real32 *Depths, v3 *Normals, uint32_t Width, uint32_t Height,
+				   depth_aware_blur_constants *Constants)
+{
+	for(int32_t Y = 0; Y < (int32_t)Height; Y++)
+	{
+		for(int32_t X = 0; X < (int32_t)Width; X++)
+		{
+			uint32_t Center = Y*Width + X;
+
+			v3 Sum = V3(0.0f, 0.0f, 0.0f);
+			real32 WeightSum = 0.0f;
+			for(int32_t Tap = -Constants->Radius; Tap <= Constants->Radius; Tap++)
+			{
+				int32_t TapX = X + Tap*Constants->Direction[0];
+				int32_t TapY = Y + Tap*Constants->Direction[1];
+				TapX = (TapX < 0) ? 0 : ((TapX >= (int32_t)Width) ? (int32_t)Width - 1 : TapX);
+				TapY = (TapY < 0) ? 0 : ((TapY >= (int32_t)Height) ? (int32_t)Height - 1 : TapY);
+				uint32_t Texel = TapY*Width + TapX;
+
+				real32 Weight = expf(-(real32)(Tap*Tap) / (2.0f*Constants->Sigma*Constants->Sigma));
+				if(Tap != 0)
+				{
+					Weight *= GetDepthAwareBlurWeight(Depths[Center], Normals[Center], Depths[Texel], Normals[Texel]);
+				}
+				Sum += Weight*Source[Texel];
+				WeightSum += Weight;
+			}
+
+			Dest[Center] = (1.0f / WeightSum)*Sum;
+		}
+	}
+}
+
+// NOTE(georgy): Both directions, Temp is the image after the horizontal one
+static void
+DepthAwareBlur(v3 *Dest, v3 *Temp, v3 *Source, real32 *Depths, v3 *Normals, uint32_t Width, uint32_t Height, int32_t Radius)
+{
+	depth_aware_blur_constants Horizontal = DepthAwareBlurConstants(1, 0, Radius);
+	depth_aware_blur_constants Vertical = DepthAwareBlurConstants(0, 1, Radius);
+	DepthAwareBlurPass(Temp, Source, Depths, Normals, Width, Height, &Horizontal);
+	DepthAwareBlurPass(Dest, Temp, Depths, Normals, Width, Height, &Vertical);
+}
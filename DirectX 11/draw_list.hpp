@@ -0,0 +1,279 @@
+#pragma once
+
+#include "job_system.hpp"
+
+//
+// NOTE(georgy): Draw list. Every draw is a 64 bit sort key and the index of whatever the caller needs to draw it.
+// The key packs, from the most significant bits down: pass, layer, shader, material, depth bucket, mesh.
+// Sorting the keys gives pass order first, then the layers of the pass in order (e.g. static casters before dynamic ones),
+// then draws grouped by the state that is expensive to change,
+// then front to back (smaller depth bucket first) inside the same state, and the same mesh next to each other
+// so neighbouring draws can be merged into one instanced draw.
+// For back to front the caller just flips the depth bucket (MaxBucket - Bucket).
+//
+// The list is sorted with an LSD radix sort, 8 bits per pass. Bytes that are the same in every key are skipped,
+// so unused fields (e.g. no materials yet) cost nothing. Each pass splits the list into blocks that are
+// histogrammed and scattered in parallel; the scatter is stable, which is what makes LSD work.
+//
+
+#define DRAW_KEY_MESH_BITS 19
+#define DRAW_KEY_DEPTH_BITS 16
+#define DRAW_KEY_MATERIAL_BITS 16
+#define DRAW_KEY_SHADER_BITS 8
+#define DRAW_KEY_LAYER_BITS 1
+#define DRAW_KEY_PASS_BITS 4
+
+#define DRAW_KEY_MESH_SHIFT 0
+#define DRAW_KEY_DEPTH_SHIFT (DRAW_KEY_MESH_SHIFT + DRAW_KEY_MESH_BITS)
+#define DRAW_KEY_MATERIAL_SHIFT (DRAW_KEY_DEPTH_SHIFT + DRAW_KEY_DEPTH_BITS)
+#define DRAW_KEY_SHADER_SHIFT (DRAW_KEY_MATERIAL_SHIFT + DRAW_KEY_MATERIAL_BITS)
+#define DRAW_KEY_LAYER_SHIFT (DRAW_KEY_SHADER_SHIFT + DRAW_KEY_SHADER_BITS)
+#define DRAW_KEY_PASS_SHIFT (DRAW_KEY_LAYER_SHIFT + DRAW_KEY_LAYER_BITS)
+static_assert(DRAW_KEY_PASS_SHIFT + DRAW_KEY_PASS_BITS == 64, "Draw key fields have to fill 64 bits");
+
+#define DrawKeyField(Key, Field) ((uint32_t)((Key) >> DRAW_KEY_##Field##_SHIFT) & ((1u << DRAW_KEY_##Field##_BITS) - 1))
+
+// NOTE(georgy): Everything but the depth bucket. Draws whose keys match under this mask can share state and be merged.
+#define DRAW_KEY_STATE_MASK (~(((1ull << DRAW_KEY_DEPTH_BITS) - 1) << DRAW_KEY_DEPTH_SHIFT))
+
+inline uint64_t
+DrawKey(uint32_t Pass, uint32_t Layer, uint32_t Shader, uint32_t Material, uint32_t DepthBucket, uint32_t Mesh)
+{
+	Assert(Pass < (1u << DRAW_KEY_PASS_BITS));
+	Assert(Layer < (1u << DRAW_KEY_LAYER_BITS));
+	Assert(Shader < (1u << DRAW_KEY_SHADER_BITS));
+	Assert(Material < (1u << DRAW_KEY_MATERIAL_BITS));
+	Assert(DepthBucket < (1u << DRAW_KEY_DEPTH_BITS));
+	Assert(Mesh < (1u << DRAW_KEY_MESH_BITS));
+
+	uint64_t Result = ((uint64_t)Pass << DRAW_KEY_PASS_SHIFT) |
+					  ((uint64_t)Layer << DRAW_KEY_LAYER_SHIFT) |
+					  ((uint64_t)Shader << DRAW_KEY_SHADER_SHIFT) |
+					  ((uint64_t)Material << DRAW_KEY_MATERIAL_SHIFT) |
+					  ((uint64_t)DepthBucket << DRAW_KEY_DEPTH_SHIFT) |
+					  ((uint64_t)Mesh << DRAW_KEY_MESH_SHIFT);
+	return(Result);
+}
+
+// NOTE(georgy): Depth in [MinDepth, MaxDepth] to one of BucketCount buckets, anything outside is clamped.
+// Fewer buckets means more draws with the same state end up next to each other.
+inline uint32_t
+QuantizeDrawDepth(real32 Depth, real32 MinDepth, real32 MaxDepth, uint32_t BucketCount)
+{
+	Assert((BucketCount > 0) && (BucketCount <= (1u << DRAW_KEY_DEPTH_BITS)));
+
+	real32 Range = MaxDepth - MinDepth;
+	real32 T = (Range > 0.0f) ? ((Depth - MinDepth) / Range) : 0.0f;
+	T = (T < 0.0f) ? 0.0f : ((T > 1.0f) ? 1.0f : T);
+	uint32_t Result = (uint32_t)(T*(BucketCount - 1) + 0.5f);
+	return(Result);
+}
+
+struct draw_item
+{
+	uint64_t Key;
+	uint32_t Index;
+};
+
+struct draw_list
+{
+	uint32_t Count;
+	uint32_t MaxCount;
+	draw_item *Items;
+
+	// NOTE(georgy): Same size as Items, the sort ping-pongs between the two
+	draw_item *SortBuffer;
+};
+
+static void
+InitializeDrawList(draw_list *List, draw_item *Items, draw_item *SortBuffer, uint32_t MaxCount)
+{
+	List->Count = 0;
+	List->MaxCount = MaxCount;
+	List->Items = Items;
+	List->SortBuffer = SortBuffer;
+}
+
+inline void
+ResetDrawList(draw_list *List)
+{
+	List->Count = 0;
+}
+
+inline void
+PushDraw(draw_list *List, uint64_t Key, uint32_t Index)
+{
+	Assert(List->Count < List->MaxCount);
+
+	draw_item *Item = List->Items + List->Count++;
+	Item->Key = Key;
+	Item->Index = Index;
+}
+
+//
+// NOTE(georgy): Parallel LSD radix sort
+//
+
+#define RADIX_SORT_MAX_BLOCKS 32
+#define RADIX_SORT_MIN_BLOCK_SIZE 8192
+
+// NOTE(georgy): Below this many draws the histograms cost more than the sort, insertion sort is used instead
+#define RADIX_SORT_MIN_COUNT 64
+
+struct radix_sort_pass
+{
+	draw_item *Source;
+	draw_item *Dest;
+	uint32_t Count;
+	uint32_t BlockSize;
+	uint32_t Shift;
+
+	// NOTE(georgy): Per block: key bits, then digit counts, then where the block writes each digit
+	uint64_t KeyAnd[RADIX_SORT_MAX_BLOCKS];
+	uint64_t KeyOr[RADIX_SORT_MAX_BLOCKS];
+	uint32_t Offsets[RADIX_SORT_MAX_BLOCKS][256];
+};
+
+inline void
+GetRadixSortBlockRange(radix_sort_pass *Pass, uint32_t Block, uint32_t *Start, uint32_t *OnePastEnd)
+{
+	*Start = Block*Pass->BlockSize;
+	*OnePastEnd = (*Start + Pass->BlockSize < Pass->Count) ? (*Start + Pass->BlockSize) : Pass->Count;
+}
+
+static void
+RadixSortKeyBits(uint32_t FirstBlock, uint32_t OnePastLastBlock, void *UserData)
+{
+	radix_sort_pass *Pass = (radix_sort_pass *)UserData;
+	for(uint32_t Block = FirstBlock; Block < OnePastLastBlock; Block++)
+	{
+		uint32_t Start, OnePastEnd;
+		GetRadixSortBlockRange(Pass, Block, &Start, &OnePastEnd);
+
+		uint64_t KeyAnd = UINT64_MAX, KeyOr = 0;
+		for(uint32_t I = Start; I < OnePastEnd; I++)
+		{
+			KeyAnd &= Pass->Source[I].Key;
+			KeyOr |= Pass->Source[I].Key;
+		}
+		Pass->KeyAnd[Block] = KeyAnd;
+		Pass->KeyOr[Block] = KeyOr;
+	}
+}
+
+static void
+RadixSortHistogram(uint32_t FirstBlock, uint32_t OnePastLastBlock, void *UserData)
+{
+	radix_sort_pass *Pass = (radix_sort_pass *)UserData;
+	for(uint32_t Block = FirstBlock; Block < OnePastLastBlock; Block++)
+	{
+		uint32_t Start, OnePastEnd;
+		GetRadixSortBlockRange(Pass, Block, &Start, &OnePastEnd);
+
+		uint32_t *Counts = Pass->Offsets[Block];
+		memset(Counts, 0, sizeof(Pass->Offsets[Block]));
+		for(uint32_t I = Start; I < OnePastEnd; I++)
+		{
+			Counts[(Pass->Source[I].Key >> Pass->Shift) & 0xFF]++;
+		}
+	}
+}
+
+static void
+RadixSortScatter(uint32_t FirstBlock, uint32_t OnePastLastBlock, void *UserData)
+{
+	radix_sort_pass *Pass = (radix_sort_pass *)UserData;
+	for(uint32_t Block = FirstBlock; Block < OnePastLastBlock; Block++)
+	{
+		uint32_t Start, OnePastEnd;
+		GetRadixSortBlockRange(Pass, Block, &Start, &OnePastEnd);
+
+		uint32_t *Offsets = Pass->Offsets[Block];
+		for(uint32_t I = Start; I < OnePastEnd; I++)
+		{
+			draw_item Item = Pass->Source[I];
+			Pass->Dest[Offsets[(Item.Key >> Pass->Shift) & 0xFF]++] = Item;
+		}
+	}
+}
+
+// NOTE(georgy): Stable, so draws with equal keys stay in the order they were pushed.
+// Returns how many of the 8 byte passes actually ran.
+static uint32_t
+SortDrawList(draw_list *List, job_system *JobSystem)
+{
+	uint32_t Result = 0;
+
+	if(List->Count < RADIX_SORT_MIN_COUNT)
+	{
+		for(uint32_t I = 1; I < List->Count; I++)
+		{
+			draw_item Item = List->Items[I];
+			uint32_t J = I;
+			while((J > 0) && (List->Items[J - 1].Key > Item.Key))
+			{
+				List->Items[J] = List->Items[J - 1];
+				J--;
+			}
+			List->Items[J] = Item;
+		}
+
+		return(Result);
+	}
+
+	radix_sort_pass Pass;
+	Pass.Source = List->Items;
+	Pass.Dest = List->SortBuffer;
+	Pass.Count = List->Count;
+	uint32_t BlockCount = (List->Count + RADIX_SORT_MIN_BLOCK_SIZE - 1) / RADIX_SORT_MIN_BLOCK_SIZE;
+	BlockCount = (BlockCount > RADIX_SORT_MAX_BLOCKS) ? RADIX_SORT_MAX_BLOCKS : BlockCount;
+	BlockCount = (BlockCount < 1) ? 1 : BlockCount;
+	Pass.BlockSize = (List->Count + BlockCount - 1) / BlockCount;
+	Pass.Shift = 0;
+
+	// NOTE(georgy): Bits that differ between any two keys, bytes without them are already sorted
+	ParallelFor(JobSystem, BlockCount, RadixSortKeyBits, &Pass);
+	uint64_t KeyAnd = UINT64_MAX, KeyOr = 0;
+	for(uint32_t Block = 0; Block < BlockCount; Block++)
+	{
+		KeyAnd &= Pass.KeyAnd[Block];
+		KeyOr |= Pass.KeyOr[Block];
+	}
+	uint64_t VaryingBits = KeyAnd ^ KeyOr;
+
+	for(Pass.Shift = 0; Pass.Shift < 64; Pass.Shift += 8)
+	{
+		if(((VaryingBits >> Pass.Shift) & 0xFF) == 0)
+		{
+			continue;
+		}
+
+		ParallelFor(JobSystem, BlockCount, RadixSortHistogram, &Pass);
+
+		// NOTE(georgy): Digit major, block minor: all of digit 0 from every block in block order, then digit 1...
+		uint32_t Offset = 0;
+		for(uint32_t Digit = 0; Digit < 256; Digit++)
+		{
+			for(uint32_t Block = 0; Block < BlockCount; Block++)
+			{
+				uint32_t Count = Pass.Offsets[Block][Digit];
+				Pass.Offsets[Block][Digit] = Offset;
+				Offset += Count;
+			}
+		}
+		Assert(Offset == List->Count);
+
+		ParallelFor(JobSystem, BlockCount, RadixSortScatter, &Pass);
+
+		draw_item *Temp = Pass.Source;
+		Pass.Source = Pass.Dest;
+		Pass.Dest = Temp;
+		Result++;
+	}
+
+	// NOTE(georgy): The sorted items are wherever the last pass wrote them, the list just points there
+	List->Items = Pass.Source;
+	List->SortBuffer = Pass.Dest;
+
+	return(Result);
+}
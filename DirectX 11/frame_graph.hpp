@@ -0,0 +1,462 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "graphics.hpp"
+
+//
+// NOTE(georgy): Frame graph.
+// Passes declare which textures they read and write; the graph then
+//  - culls passes whose outputs nobody reads (writing an imported texture or having side effects keeps a pass alive),
+//  - computes the lifetime of every transient texture as [first pass that uses it, last pass that uses it],
+//  - assigns transient textures to physical textures, so textures whose lifetimes don't overlap share one.
+// D3D11 has no placed resources, so "sharing memory" means handing the same physical texture to several
+// virtual textures with identical descriptions. The first writer of a texture must overwrite or clear all of it.
+// The graph only deals with texture descriptions and opaque handles, the actual textures come from a backend.
+//
+
+#define MAX_FRAME_GRAPH_PASSES 32
+#define MAX_FRAME_GRAPH_RESOURCES 64
+#define MAX_FRAME_GRAPH_PASS_RESOURCES 8
+#define FRAME_GRAPH_INVALID_INDEX UINT32_MAX
+
+struct frame_graph_backend
+{
+	void *(*CreateTexture)(frame_graph_backend *Backend, texture_desc *Desc, const char *Name);
+	void (*DestroyTexture)(frame_graph_backend *Backend, void *Texture);
+	void *Data;
+};
+
+struct frame_graph_resource
+{
+	const char *Name;
+	texture_desc Desc;
+	bool Imported;
+	void *ImportedTexture;
+
+	uint32_t Writer;
+	uint32_t RefCount;
+	uint32_t FirstPass, LastPass;
+	uint32_t PhysicalTexture;
+};
+
+struct frame_graph_pass
+{
+	const char *Name;
+	bool HasSideEffects;
+
+	uint32_t ReadCount;
+	uint32_t Reads[MAX_FRAME_GRAPH_PASS_RESOURCES];
+	uint32_t WriteCount;
+	uint32_t Writes[MAX_FRAME_GRAPH_PASS_RESOURCES];
+
+	uint32_t RefCount;
+	bool Culled;
+};
+
+struct frame_graph_physical_texture
+{
+	texture_desc Desc;
+	void *Texture;
+	uint32_t LastPass;
+};
+
+struct frame_graph_stats
+{
+	uint32_t CulledPassCount;
+	uint32_t TransientTextureCount;
+	uint32_t PhysicalTextureCount;
+
+	// NOTE(georgy): What the transient textures would take without aliasing, what they take with it,
+	// and the lower bound: the most memory that is actually live during any single pass
+	uint64_t UnaliasedBytes;
+	uint64_t AliasedBytes;
+	uint64_t PeakLiveBytes;
+
+	// NOTE(georgy): Imported textures outlive the frame and never alias, the frame's passes still use them
+	uint64_t ImportedBytes;
+};
+
+struct frame_graph
+{
+	frame_graph_backend *Backend;
+
+	uint32_t PassCount;
+	frame_graph_pass Passes[MAX_FRAME_GRAPH_PASSES];
+	uint32_t ResourceCount;
+	frame_graph_resource Resources[MAX_FRAME_GRAPH_RESOURCES];
+	uint32_t PhysicalTextureCount;
+	frame_graph_physical_texture PhysicalTextures[MAX_FRAME_GRAPH_RESOURCES];
+
+	bool Compiled;
+	frame_graph_stats Stats;
+};
+
+inline void
+InitializeFrameGraph(frame_graph *Graph, frame_graph_backend *Backend)
+{
+	Graph->Backend = Backend;
+	Graph->PassCount = 0;
+	Graph->ResourceCount = 0;
+	Graph->PhysicalTextureCount = 0;
+	Graph->Compiled = false;
+	Graph->Stats = {};
+}
+
+//
+// NOTE(georgy): Setup
+//
+
+inline uint32_t
+AddFrameGraphPass(frame_graph *Graph, const char *Name, bool HasSideEffects = false)
+{
+	Assert(!Graph->Compiled);
+	Assert(Graph->PassCount < MAX_FRAME_GRAPH_PASSES);
+
+	uint32_t Result = Graph->PassCount++;
+	frame_graph_pass *Pass = Graph->Passes + Result;
+	*Pass = {};
+	Pass->Name = Name;
+	Pass->HasSideEffects = HasSideEffects;
+
+	return(Result);
+}
+
+inline uint32_t
+AddFrameGraphResource_(frame_graph *Graph, const char *Name, texture_desc Desc, bool Imported, void *ImportedTexture)
+{
+	Assert(!Graph->Compiled);
+	Assert(Graph->ResourceCount < MAX_FRAME_GRAPH_RESOURCES);
+
+	uint32_t Result = Graph->ResourceCount++;
+	frame_graph_resource *Resource = Graph->Resources + Result;
+	*Resource = {};
+	Resource->Name = Name;
+	Resource->Desc = Desc;
+	Resource->Imported = Imported;
+	Resource->ImportedTexture = ImportedTexture;
+	Resource->Writer = FRAME_GRAPH_INVALID_INDEX;
+	Resource->PhysicalTexture = FRAME_GRAPH_INVALID_INDEX;
+
+	return(Result);
+}
+
+// NOTE(georgy): Transient texture, owned by the graph
+inline uint32_t
+CreateFrameGraphTexture(frame_graph *Graph, const char *Name, texture_desc Desc)
+{
+	uint32_t Result = AddFrameGraphResource_(Graph, Name, Desc, false, 0);
+	return(Result);
+}
+
+// NOTE(georgy): Texture that lives outside of the graph (e.g. the backbuffer). Its contents are visible outside, so passes writing it are never culled.
+inline uint32_t
+ImportFrameGraphTexture(frame_graph *Graph, const char *Name, texture_desc Desc, void *Texture)
+{
+	uint32_t Result = AddFrameGraphResource_(Graph, Name, Desc, true, Texture);
+	return(Result);
+}
+
+inline void
+FrameGraphRead(frame_graph *Graph, uint32_t PassIndex, uint32_t ResourceIndex)
+{
+	frame_graph_pass *Pass = Graph->Passes + PassIndex;
+	Assert(Pass->ReadCount < MAX_FRAME_GRAPH_PASS_RESOURCES);
+	Assert(ResourceIndex < Graph->ResourceCount);
+	Pass->Reads[Pass->ReadCount++] = ResourceIndex;
+}
+
+inline void
+FrameGraphWrite(frame_graph *Graph, uint32_t PassIndex, uint32_t ResourceIndex)
+{
+	frame_graph_pass *Pass = Graph->Passes + PassIndex;
+	frame_graph_resource *Resource = Graph->Resources + ResourceIndex;
+	Assert(Pass->WriteCount < MAX_FRAME_GRAPH_PASS_RESOURCES);
+	Assert(ResourceIndex < Graph->ResourceCount);
+
+	// NOTE(georgy): Resources aren't versioned, so there is exactly one writer per resource
+	Assert(Resource->Writer == FRAME_GRAPH_INVALID_INDEX);
+	Resource->Writer = PassIndex;
+	Pass->Writes[Pass->WriteCount++] = ResourceIndex;
+}
+
+//
+// NOTE(georgy): Compilation
+//
+
+// NOTE(georgy): Frees the physical textures, the graph can be compiled again afterwards (e.g. after a resize)
+inline void
+ReleaseFrameGraphTextures(frame_graph *Graph)
+{
+	for(uint32_t PhysicalIndex = 0; PhysicalIndex < Graph->PhysicalTextureCount; PhysicalIndex++)
+	{
+		Graph->Backend->DestroyTexture(Graph->Backend, Graph->PhysicalTextures[PhysicalIndex].Texture);
+	}
+	Graph->PhysicalTextureCount = 0;
+	Graph->Compiled = false;
+}
+
+static void
+CompileFrameGraph(frame_graph *Graph)
+{
+	Assert(!Graph->Compiled);
+	Graph->Stats = {};
+
+	// NOTE(georgy): Reference counts. A pass is referenced by its outputs, a resource by the passes that read it.
+	for(uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ResourceIndex++)
+	{
+		Graph->Resources[ResourceIndex].RefCount = 0;
+	}
+	for(uint32_t PassIndex = 0; PassIndex < Graph->PassCount; PassIndex++)
+	{
+		frame_graph_pass *Pass = Graph->Passes + PassIndex;
+		Pass->RefCount = Pass->WriteCount;
+		Pass->Culled = false;
+		for(uint32_t ReadIndex = 0; ReadIndex < Pass->ReadCount; ReadIndex++)
+		{
+			frame_graph_resource *Resource = Graph->Resources + Pass->Reads[ReadIndex];
+			Assert(Resource->Imported || (Resource->Writer != FRAME_GRAPH_INVALID_INDEX));
+			Resource->RefCount++;
+		}
+		for(uint32_t WriteIndex = 0; WriteIndex < Pass->WriteCount; WriteIndex++)
+		{
+			frame_graph_resource *Resource = Graph->Resources + Pass->Writes[WriteIndex];
+			if(Resource->Imported)
+			{
+				Pass->HasSideEffects = true;
+			}
+		}
+	}
+
+	// NOTE(georgy): Cull. Start from the unread transient resources and walk back through their writers.
+	uint32_t UnreferencedCount = 0;
+	uint32_t Unreferenced[MAX_FRAME_GRAPH_RESOURCES];
+	for(uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ResourceIndex++)
+	{
+		frame_graph_resource *Resource = Graph->Resources + ResourceIndex;
+		if(!Resource->Imported && (Resource->RefCount == 0))
+		{
+			Unreferenced[UnreferencedCount++] = ResourceIndex;
+		}
+	}
+	while(UnreferencedCount > 0)
+	{
+		frame_graph_resource *Resource = Graph->Resources + Unreferenced[--UnreferencedCount];
+		if(Resource->Writer == FRAME_GRAPH_INVALID_INDEX)
+		{
+			continue;
+		}
+
+		frame_graph_pass *Writer = Graph->Passes + Resource->Writer;
+		Assert(Writer->RefCount > 0);
+		if((--Writer->RefCount == 0) && !Writer->HasSideEffects)
+		{
+			Writer->Culled = true;
+			for(uint32_t ReadIndex = 0; ReadIndex < Writer->ReadCount; ReadIndex++)
+			{
+				frame_graph_resource *Read = Graph->Resources + Writer->Reads[ReadIndex];
+				if((--Read->RefCount == 0) && !Read->Imported)
+				{
+					Unreferenced[UnreferencedCount++] = Writer->Reads[ReadIndex];
+				}
+			}
+		}
+	}
+
+	// NOTE(georgy): Lifetimes, in terms of pass indices of the passes that survived culling
+	for(uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ResourceIndex++)
+	{
+		frame_graph_resource *Resource = Graph->Resources + ResourceIndex;
+		Resource->FirstPass = FRAME_GRAPH_INVALID_INDEX;
+		Resource->LastPass = 0;
+		Resource->PhysicalTexture = FRAME_GRAPH_INVALID_INDEX;
+	}
+	for(uint32_t PassIndex = 0; PassIndex < Graph->PassCount; PassIndex++)
+	{
+		frame_graph_pass *Pass = Graph->Passes + PassIndex;
+		if(Pass->Culled)
+		{
+			Graph->Stats.CulledPassCount++;
+			continue;
+		}
+
+		for(uint32_t I = 0; I < Pass->ReadCount + Pass->WriteCount; I++)
+		{
+			uint32_t ResourceIndex = (I < Pass->ReadCount) ? Pass->Reads[I] : Pass->Writes[I - Pass->ReadCount];
+			frame_graph_resource *Resource = Graph->Resources + ResourceIndex;
+			Resource->FirstPass = (PassIndex < Resource->FirstPass) ? PassIndex : Resource->FirstPass;
+			Resource->LastPass = (PassIndex > Resource->LastPass) ? PassIndex : Resource->LastPass;
+		}
+	}
+
+	// NOTE(georgy): Aliasing. Transient resources get a physical texture when they are first written.
+	// A physical texture can be taken over once the last pass that used it is strictly before the new owner's first pass,
+	// so inputs and outputs of the same pass never alias.
+	for(uint32_t PassIndex = 0; PassIndex < Graph->PassCount; PassIndex++)
+	{
+		frame_graph_pass *Pass = Graph->Passes + PassIndex;
+		if(Pass->Culled)
+		{
+			continue;
+		}
+
+		uint64_t LiveBytes = 0;
+		for(uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ResourceIndex++)
+		{
+			frame_graph_resource *Resource = Graph->Resources + ResourceIndex;
+			if(!Resource->Imported && (Resource->FirstPass <= PassIndex) && (PassIndex <= Resource->LastPass))
+			{
+				LiveBytes += GetTextureSize(&Resource->Desc);
+			}
+		}
+		Graph->Stats.PeakLiveBytes = (LiveBytes > Graph->Stats.PeakLiveBytes) ? LiveBytes : Graph->Stats.PeakLiveBytes;
+
+		for(uint32_t WriteIndex = 0; WriteIndex < Pass->WriteCount; WriteIndex++)
+		{
+			frame_graph_resource *Resource = Graph->Resources + Pass->Writes[WriteIndex];
+			if(Resource->Imported || (Resource->FirstPass != PassIndex))
+			{
+				continue;
+			}
+
+			uint32_t PhysicalIndex = FRAME_GRAPH_INVALID_INDEX;
+			for(uint32_t CandidateIndex = 0; CandidateIndex < Graph->PhysicalTextureCount; CandidateIndex++)
+			{
+				frame_graph_physical_texture *Candidate = Graph->PhysicalTextures + CandidateIndex;
+				if((Candidate->LastPass < PassIndex) && TextureDescsMatch(&Candidate->Desc, &Resource->Desc))
+				{
+					PhysicalIndex = CandidateIndex;
+					break;
+				}
+			}
+
+			if(PhysicalIndex == FRAME_GRAPH_INVALID_INDEX)
+			{
+				Assert(Graph->PhysicalTextureCount < MAX_FRAME_GRAPH_RESOURCES);
+				PhysicalIndex = Graph->PhysicalTextureCount++;
+				frame_graph_physical_texture *Physical = Graph->PhysicalTextures + PhysicalIndex;
+				Physical->Desc = Resource->Desc;
+				Physical->Texture = Graph->Backend->CreateTexture(Graph->Backend, &Resource->Desc, Resource->Name);
+				Graph->Stats.AliasedBytes += GetTextureSize(&Resource->Desc);
+			}
+
+			Graph->PhysicalTextures[PhysicalIndex].LastPass = Resource->LastPass;
+			Resource->PhysicalTexture = PhysicalIndex;
+
+			Graph->Stats.TransientTextureCount++;
+			Graph->Stats.UnaliasedBytes += GetTextureSize(&Resource->Desc);
+		}
+	}
+	Graph->Stats.PhysicalTextureCount = Graph->PhysicalTextureCount;
+
+	for(uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ResourceIndex++)
+	{
+		frame_graph_resource *Resource = Graph->Resources + ResourceIndex;
+		if(Resource->Imported && (Resource->FirstPass != FRAME_GRAPH_INVALID_INDEX))
+		{
+			Graph->Stats.ImportedBytes += GetTextureSize(&Resource->Desc);
+		}
+	}
+
+	Graph->Compiled = true;
+}
+
+//
+// NOTE(georgy): Execution
+//
+
+inline bool
+IsFrameGraphPassActive(frame_graph *Graph, uint32_t PassIndex)
+{
+	Assert(Graph->Compiled);
+	bool Result = !Graph->Passes[PassIndex].Culled;
+	return(Result);
+}
+
+// NOTE(georgy): Backend handle for the resource. Returns 0 for resources that were culled away.
+inline void *
+GetFrameGraphTexture(frame_graph *Graph, uint32_t ResourceIndex)
+{
+	Assert(Graph->Compiled);
+
+	void *Result = 0;
+	frame_graph_resource *Resource = Graph->Resources + ResourceIndex;
+	if(Resource->Imported)
+	{
+		Result = Resource->ImportedTexture;
+	}
+	else if(Resource->PhysicalTexture != FRAME_GRAPH_INVALID_INDEX)
+	{
+		Result = Graph->PhysicalTextures[Resource->PhysicalTexture].Texture;
+	}
+
+	return(Result);
+}
+
+//
+// NOTE(georgy): Null backend. Doesn't create anything, just keeps track of what would have been allocated.
+//
+
+struct null_frame_graph_backend
+{
+	uint32_t CreatedTextureCount;
+	uint32_t LiveTextureCount;
+	uint64_t CreatedBytes;
+};
+
+static void *
+NullFrameGraphCreateTexture(frame_graph_backend *Backend, texture_desc *Desc, const char *Name)
+{
+	null_frame_graph_backend *Null = (null_frame_graph_backend *)Backend->Data;
+	Null->CreatedTextureCount++;
+	Null->LiveTextureCount++;
+	Null->CreatedBytes += GetTextureSize(Desc);
+
+	// NOTE(georgy): Handles only have to be unique and non-zero
+	void *Result = (void *)(uintptr_t)Null->CreatedTextureCount;
+	return(Result);
+}
+
+static void
+NullFrameGraphDestroyTexture(frame_graph_backend *Backend, void *Texture)
+{
+	null_frame_graph_backend *Null = (null_frame_graph_backend *)Backend->Data;
+	Assert(Null->LiveTextureCount > 0);
+	Null->LiveTextureCount--;
+}
+
+inline void
+InitializeNullFrameGraphBackend(frame_graph_backend *Backend, null_frame_graph_backend *Null)
+{
+	*Null = {};
+	Backend->CreateTexture = NullFrameGraphCreateTexture;
+	Backend->DestroyTexture = NullFrameGraphDestroyTexture;
+	Backend->Data = Null;
+}
+
+//
+// NOTE(georgy): Graphics device backend, physical textures are real textures of the device
+//
+
+static void *
+GraphicsDeviceCreateTexture(frame_graph_backend *Backend, texture_desc *Desc, const char *Name)
+{
+	graphics_device *Device = (graphics_device *)Backend->Data;
+	void *Result = Device->CreateTexture(Device, Desc, Name);
+	return(Result);
+}
+
+static void
+GraphicsDeviceDestroyTexture(frame_graph_backend *Backend, void *Texture)
+{
+	graphics_device *Device = (graphics_device *)Backend->Data;
+	Device->DestroyTexture(Device, (gfx_texture *)Texture);
+}
+
+inline void
+InitializeGraphicsDeviceFrameGraphBackend(frame_graph_backend *Backend, graphics_device *Device)
+{
+	Backend->CreateTexture = GraphicsDeviceCreateTexture;
+	Backend->DestroyTexture = GraphicsDeviceDestroyTexture;
+	Backend->Data = Device;
+}
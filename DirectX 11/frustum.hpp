@@ -0,0 +1,100 @@
+#pragma once
+
+//
+// NOTE(georgy): View frustum for culling. The planes come straight out of the view-projection matrix,
+// a point is inside if it's on the positive side of all of them (D3D clip space, 0 <= z <= w).
+// Planes aren't normalized, the box test only needs the sign.
+//
+// The 6 planes are stored as structure of arrays and padded to 8, so a box is tested against 4 planes at a time.
+// The padding planes are 0x + 0y + 0z + 1 and everything is inside them.
+//
+
+#define FRUSTUM_PLANE_COUNT 6
+
+struct frustum
+{
+	alignas(16) real32 NormalX[8];
+	alignas(16) real32 NormalY[8];
+	alignas(16) real32 NormalZ[8];
+	alignas(16) real32 Distance[8];
+};
+
+inline void
+SetFrustumPlane(frustum *Frustum, uint32_t Plane, v4 Equation)
+{
+	Frustum->NormalX[Plane] = Equation.x;
+	Frustum->NormalY[Plane] = Equation.y;
+	Frustum->NormalZ[Plane] = Equation.z;
+	Frustum->Distance[Plane] = Equation.w;
+}
+
+static frustum
+MakeFrustum(mat4 ViewProjection)
+{
+	frustum Result;
+
+	// NOTE(georgy): Row vectors, so clip = (x, y, z, 1) * M and clip.x is the dot product with M's first column
+	real32 *E = ViewProjection.Elements;
+	v4 X = V4(E[0], E[1], E[2], E[3]);
+	v4 Y = V4(E[4], E[5], E[6], E[7]);
+	v4 Z = V4(E[8], E[9], E[10], E[11]);
+	v4 W = V4(E[12], E[13], E[14], E[15]);
+
+	// NOTE(georgy): Left, right, bottom, top, near (z >= 0), far
+	SetFrustumPlane(&Result, 0, W + X);
+	SetFrustumPlane(&Result, 1, W - X);
+	SetFrustumPlane(&Result, 2, W + Y);
+	SetFrustumPlane(&Result, 3, W - Y);
+	SetFrustumPlane(&Result, 4, Z);
+	SetFrustumPlane(&Result, 5, W - Z);
+	for(uint32_t Plane = FRUSTUM_PLANE_COUNT; Plane < 8; Plane++)
+	{
+		SetFrustumPlane(&Result, Plane, V4(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+
+	return(Result);
+}
+
+enum frustum_test
+{
+	FrustumTest_Outside,
+	FrustumTest_Intersects,
+	FrustumTest_Inside,
+};
+
+// NOTE(georgy): Box as center and half extent. Conservative: a box that is outside the frustum
+// but not completely behind any single plane (near the corners) counts as intersecting.
+inline frustum_test
+TestBoxFrustum(frustum *Frustum, v3 Center, v3 Extent)
+{
+	__m128 SignMask = _mm_set1_ps(-0.0f);
+	__m128 CX = _mm_set1_ps(Center.x), CY = _mm_set1_ps(Center.y), CZ = _mm_set1_ps(Center.z);
+	__m128 EX = _mm_set1_ps(Extent.x), EY = _mm_set1_ps(Extent.y), EZ = _mm_set1_ps(Extent.z);
+
+	int Outside = 0, Straddles = 0;
+	for(uint32_t Plane = 0; Plane < 8; Plane += 4)
+	{
+		__m128 NX = _mm_load_ps(Frustum->NormalX + Plane);
+		__m128 NY = _mm_load_ps(Frustum->NormalY + Plane);
+		__m128 NZ = _mm_load_ps(Frustum->NormalZ + Plane);
+		__m128 D = _mm_load_ps(Frustum->Distance + Plane);
+
+		// NOTE(georgy): Signed distance of the center and the box's projected radius. The box is outside if
+		// the distance plus the radius is negative, and partly behind the plane if the distance minus the radius is.
+		__m128 Distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(NX, CX), _mm_mul_ps(NY, CY)), _mm_add_ps(_mm_mul_ps(NZ, CZ), D));
+		__m128 Radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(SignMask, NX), EX), _mm_mul_ps(_mm_andnot_ps(SignMask, NY), EY)),
+								   _mm_mul_ps(_mm_andnot_ps(SignMask, NZ), EZ));
+		Outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(Distance, Radius), _mm_setzero_ps()));
+		Straddles |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(Distance, Radius), _mm_setzero_ps()));
+	}
+
+	frustum_test Result = Outside ? FrustumTest_Outside : (Straddles ? FrustumTest_Intersects : FrustumTest_Inside);
+	return(Result);
+}
+
+inline bool
+IsBoxInFrustum(frustum *Frustum, v3 Center, v3 Extent)
+{
+	bool Result = (TestBoxFrustum(Frustum, Center, Extent) != FrustumTest_Outside);
+	return(Result);
+}
@@ -0,0 +1,483 @@
+#pragma once
+
+#include "platform.hpp"
+#include "renderer.hpp"
+#include "scene.hpp"
+#include "aabb_tree.hpp"
+#include "triangle_bvh.hpp"
+#include "path_tracer.hpp"
+
+//
+// NOTE(georgy): Portable game side of the frame: camera update from game_input, the scene and filling the frame packet.
+//
+
+#define GAME_MAX_SCENE_OBJECTS MAX_FRAME_PACKET_OBJECTS
+#define GAME_SCENE_TREE_MARGIN 0.1f
+#define GAME_PICK_DISTANCE 100.0f
+
+// NOTE(georgy): The directional light looks from here at the origin
+#define GAME_SUN_POSITION V3(3.0f, 3.0f, -3.0f)
+// NOTE(georgy): The shadow cascades cover the camera frustum up to here, nothing is shadowed further away
+#define GAME_SHADOW_DISTANCE 20.0f
+// NOTE(georgy): Size of the sun's tile in the RSM atlas. The RSM covers a fixed 5x5 area, it doesn't depend on the screen.
+#define GAME_RSM_SIZE 512
+// NOTE(georgy): Shadow atlas key of the sun, its cascades are ShadowAtlasKey(GAME_SUN_LIGHT, Cascade)
+#define GAME_SUN_LIGHT 0
+
+// NOTE(georgy): Path traced reference images. One bounce, the indirect light RSM approximates.
+#define GAME_REFERENCE_SAMPLES 256
+#define GAME_REFERENCE_BOUNCES 1
+
+struct game_state
+{
+	v3 CameraPos;
+	real32 CameraPitch;
+	real32 CameraHead;
+	v3 CameraFront;
+	v3 CameraRight;
+	v3 CameraUp;
+
+	real32 MouseSensitivity;
+	real32 FoV;
+	real32 NearDistance, FarDistance;
+	real32 AspectRatio;
+	uint32_t ScreenHeight;
+
+	v4 FrustumFarCornersWorldSpace[4];
+
+	scene Scene;
+
+	// NOTE(georgy): Broadphase over the world bounds of the objects that have a mesh, SceneTreeLeaves is per scene object
+	aabb_tree SceneTree;
+	uint32_t *SceneTreeLeaves;
+
+	// NOTE(georgy): Where the static casters that moved since the last packet were and are, for the light caches (shadow_cache.hpp)
+	aabb *MovedCasterBoxes;
+	uint32_t MovedCasterCount;
+
+	// NOTE(georgy): Tiles of the lights. Sizes of the renderer's atlases, the renderer only gets the rectangles in the packet.
+	shadow_atlas ShadowAtlas;
+	shadow_atlas RSMAtlas;
+
+	// NOTE(georgy): Triangles of the meshes that have them on the CPU, for exact ray queries. 0 for meshes that don't.
+	triangle_bvh *MeshBVHs[RenderMesh_Count];
+
+	// NOTE(georgy): Object under the cursor at the last click, SCENE_NO_PARENT if none. PickedTriangle is BVH_NO_TRIANGLE if the mesh has no BVH.
+	uint32_t PickedObject;
+	uint32_t PickedTriangle;
+};
+
+// NOTE(georgy): Local bounds of the render meshes. The bunny's are a rough box around the model until models carry their own.
+static void
+GetRenderMeshBounds(render_mesh Mesh, v3 *Center, v3 *Extent)
+{
+	switch(Mesh)
+	{
+		case RenderMesh_Bunny: *Center = V3(0.0f, 0.5f, 0.0f); *Extent = V3(1.0f, 1.0f, 1.0f); break;
+		case RenderMesh_Quad: *Center = V3(0.0f, 0.0f, 0.0f); *Extent = V3(1.0f, 1.0f, 0.0f); break;
+		default: Assert(0);
+	}
+}
+
+static uint32_t
+AddSceneMesh(scene *Scene, uint32_t Parent, render_mesh Mesh, mat4 LocalTransform, v3 Color, bool Dynamic = false)
+{
+	v3 BoundsCenter, BoundsExtent;
+	GetRenderMeshBounds(Mesh, &BoundsCenter, &BoundsExtent);
+	uint32_t Result = AddSceneObject(Scene, Parent, LocalTransform, Mesh, Color, BoundsCenter, BoundsExtent, Dynamic);
+	return(Result);
+}
+
+inline aabb
+GetSceneWorldBounds(scene *Scene, uint32_t Object)
+{
+	scene_bounds *Bounds = &Scene->WorldBounds;
+	v3 Center = V3(Bounds->CenterX[Object], Bounds->CenterY[Object], Bounds->CenterZ[Object]);
+	v3 Extent = V3(Bounds->ExtentX[Object], Bounds->ExtentY[Object], Bounds->ExtentZ[Object]);
+	aabb Result = AABBFromCenterExtent(Center, Extent);
+	return(Result);
+}
+
+// NOTE(georgy): When there's no room left the box grows the last one, some light views get rebuilt for nothing
+inline void
+AddMovedCasterBox(game_state *Game, aabb Box)
+{
+	if(Game->MovedCasterCount < GAME_MAX_SCENE_OBJECTS)
+	{
+		Game->MovedCasterBoxes[Game->MovedCasterCount++] = Box;
+	}
+	else
+	{
+		Game->MovedCasterBoxes[GAME_MAX_SCENE_OBJECTS - 1] = Union(Game->MovedCasterBoxes[GAME_MAX_SCENE_OBJECTS - 1], Box);
+	}
+}
+
+// NOTE(georgy): Only the objects the last UpdateSceneTransforms moved, most of them stay inside their fat leaves.
+// A static caster that moved counts where its old fat leaf was too, that's where its shadow has to go away from.
+static void
+UpdateSceneTree(game_state *Game)
+{
+	scene *Scene = &Game->Scene;
+	for(uint32_t I = 0; I < Scene->ChangedCount; I++)
+	{
+		uint32_t Object = Scene->ChangedObjects[I];
+		if(Scene->Meshes[Object] != SCENE_NO_MESH)
+		{
+			aabb Box = GetSceneWorldBounds(Scene, Object);
+			aabb MovedBox = Box;
+			if(Game->SceneTreeLeaves[Object] == AABB_TREE_NULL_NODE)
+			{
+				Game->SceneTreeLeaves[Object] = AddAABBTreeObject(&Game->SceneTree, Object, Box);
+			}
+			else
+			{
+				MovedBox = Union(Game->SceneTree.Nodes[Game->SceneTreeLeaves[Object]].Box, Box);
+				MoveAABBTreeObject(&Game->SceneTree, Game->SceneTreeLeaves[Object], Box);
+			}
+
+			if(!Scene->Dynamic[Object])
+			{
+				AddMovedCasterBox(Game, MovedBox);
+			}
+		}
+	}
+}
+
+struct scene_raycast
+{
+	game_state *Game;
+
+	// NOTE(georgy): Triangle of the closest hit so far
+	uint32_t Triangle;
+};
+
+// NOTE(georgy): Meshes with a BVH are hit tested against their triangles in the object's local space
+// (T is the same there, the direction isn't normalized). The others against the object's own world bounds.
+static real32
+RaycastSceneObject(uint32_t Object, v3 Origin, v3 Direction, real32 MaxT, void *UserData)
+{
+	scene_raycast *Raycast = (scene_raycast *)UserData;
+	scene *Scene = &Raycast->Game->Scene;
+	real32 Result = MaxT;
+
+	triangle_bvh *BVH = Raycast->Game->MeshBVHs[Scene->Meshes[Object]];
+	if(BVH)
+	{
+		mat4 WorldToLocal = InverseAffine(Scene->WorldTransforms[Object]);
+		v3 LocalOrigin = (V4(Origin, 1.0f) * WorldToLocal).xyz;
+		v3 LocalDirection = (V4(Direction, 0.0f) * WorldToLocal).xyz;
+		bvh_hit Hit = IntersectTriangleBVH(BVH, LocalOrigin, LocalDirection, MaxT);
+		if(Hit.Triangle != BVH_NO_TRIANGLE)
+		{
+			Result = Hit.T;
+			Raycast->Triangle = Hit.Triangle;
+		}
+	}
+	else
+	{
+		v3 InvDirection = V3(1.0f / Direction.x, 1.0f / Direction.y, 1.0f / Direction.z);
+		real32 T;
+		if(RayIntersectsAABB(GetSceneWorldBounds(Scene, Object), Origin, InvDirection, MaxT, &T))
+		{
+			Result = T;
+			Raycast->Triangle = BVH_NO_TRIANGLE;
+		}
+	}
+
+	return(Result);
+}
+
+static uint32_t
+PickSceneObject(game_state *Game, v3 Origin, v3 Direction, real32 MaxDistance, uint32_t *Triangle)
+{
+	scene_raycast Raycast = {Game, BVH_NO_TRIANGLE};
+	uint32_t Result = RaycastAABBTree(&Game->SceneTree, Origin, Direction, MaxDistance, RaycastSceneObject, &Raycast);
+	Result = (Result == AABB_TREE_NULL_NODE) ? SCENE_NO_PARENT : Result;
+	*Triangle = (Result == SCENE_NO_PARENT) ? BVH_NO_TRIANGLE : Raycast.Triangle;
+	return(Result);
+}
+
+// NOTE(georgy): Camera ray through the cursor. Without a window size (headless) it's the ray through the middle of the screen.
+static void
+GetCursorRay(game_state *Game, game_input *Input, v3 *Origin, v3 *Direction)
+{
+	real32 X = 0.0f, Y = 0.0f;
+	if((Input->WindowWidth > 0) && (Input->WindowHeight > 0))
+	{
+		X = 2.0f*(Input->CursorX + 0.5f) / Input->WindowWidth - 1.0f;
+		Y = 1.0f - 2.0f*(Input->CursorY + 0.5f) / Input->WindowHeight;
+	}
+
+	real32 TanHalfFoV = tanf(0.5f*DEG2RAD(Game->FoV));
+	*Origin = Game->CameraPos;
+	*Direction = Game->CameraFront + (X*TanHalfFoV*Game->AspectRatio)*Game->CameraRight + (Y*TanHalfFoV)*Game->CameraUp;
+}
+
+// NOTE(georgy): Objects with this mesh take their bounds from the BVH, the rough ones from GetRenderMeshBounds may not contain the model
+static void
+SetRenderMeshBVH(game_state *Game, render_mesh Mesh, triangle_bvh *BVH)
+{
+	Game->MeshBVHs[Mesh] = BVH;
+
+	scene *Scene = &Game->Scene;
+	for(uint32_t Object = 0; Object < Scene->Count; Object++)
+	{
+		if(Scene->Meshes[Object] == (uint32_t)Mesh)
+		{
+			Scene->LocalBoundsCenters[Object] = 0.5f*(BVH->Bounds.Min + BVH->Bounds.Max);
+			Scene->LocalBoundsExtents[Object] = 0.5f*(BVH->Bounds.Max - BVH->Bounds.Min);
+			Scene->Dirty[Object] = 1;
+		}
+	}
+	UpdateSceneTransforms(Scene, Platform.JobSystem);
+	UpdateSceneTree(Game);
+}
+
+// NOTE(georgy): Path traces what the camera sees into Name_direct.pfm, Name_indirect.pfm (compare with the RSM output)
+// and Name.pfm (both together). Everything is pushed onto TempArena and gone when this returns.
+inline bool
+RenderGameReference(game_state *Game, memory_arena *TempArena, uint32_t Width, uint32_t Height, const char *Name)
+{
+	temporary_memory TempMem = BeginTemporaryMemory(TempArena);
+
+	path_tracer_scene PathTracer;
+	BuildPathTracerScene(&PathTracer, TempArena, TempArena, &Game->Scene, Game->MeshBVHs, GAME_SUN_POSITION, Platform.JobSystem);
+
+	path_tracer_camera Camera;
+	Camera.Position = Game->CameraPos;
+	Camera.Front = Game->CameraFront;
+	Camera.Right = Game->CameraRight;
+	Camera.Up = Game->CameraUp;
+	Camera.TanHalfFoV = tanf(0.5f*DEG2RAD(Game->FoV));
+	Camera.AspectRatio = Game->AspectRatio;
+
+	path_tracer_image Image;
+	InitializePathTracerImage(&Image, TempArena, Width, Height);
+	RenderPathTracerImage(&PathTracer, &Camera, &Image, GAME_REFERENCE_SAMPLES, GAME_REFERENCE_BOUNCES, 0, TempArena, Platform.JobSystem);
+
+	v3 *Final = PushArray(TempArena, Width*Height, v3);
+	for(uint32_t Pixel = 0; Pixel < Width*Height; Pixel++)
+	{
+		Final[Pixel] = Image.Direct[Pixel] + Hadamard(Image.Albedo[Pixel], Image.Indirect[Pixel]);
+	}
+
+	char Filename[256];
+	snprintf(Filename, sizeof(Filename), "%s_direct.pfm", Name);
+	bool Result = WritePFM(Filename, Image.Direct, Width, Height);
+	snprintf(Filename, sizeof(Filename), "%s_indirect.pfm", Name);
+	Result = WritePFM(Filename, Image.Indirect, Width, Height) && Result;
+	snprintf(Filename, sizeof(Filename), "%s.pfm", Name);
+	Result = WritePFM(Filename, Final, Width, Height) && Result;
+
+	char Buffer[256];
+	snprintf(Buffer, sizeof(Buffer), "Reference %s: %ux%u, %u samples per pixel, %u bounces%s\n", Name, Width, Height,
+			 Image.SampleCount, GAME_REFERENCE_BOUNCES, Result ? "" : ", couldn't write the images");
+	Platform.DebugOutput(Buffer);
+
+	EndTemporaryMemory(TempMem);
+	return(Result);
+}
+
+// NOTE(georgy): The scene's arrays are pushed onto Arena, it has to live as long as the game state
+static void
+InitializeGame(game_state *Game, uint32_t ScreenWidth, uint32_t ScreenHeight, memory_arena *Arena)
+{
+	Game->CameraPos = V3(0.0f, 1.0f, -3.0f);// V3(0.581630588f, 1.0f, -2.52652550f);
+	Game->CameraPitch = 0.0f;
+	Game->CameraHead = 0.0f;
+	Game->CameraFront = V3(sinf(DEG2RAD(Game->CameraHead))*cosf(DEG2RAD(Game->CameraPitch)), sinf(-DEG2RAD(Game->CameraPitch)), cosf(DEG2RAD(Game->CameraHead))*cosf(DEG2RAD(Game->CameraPitch)));
+	Game->CameraRight = Normalize(Cross(V3(0.0f, 1.0f, 0.0f), Game->CameraFront));
+	Game->CameraUp = Cross(Game->CameraFront, Game->CameraRight);
+	Game->MouseSensitivity = 0.3f;
+	Game->FoV = 45.0f;
+	Game->NearDistance = 0.1f; Game->FarDistance = 100.0f;
+	Game->AspectRatio = (real32)ScreenWidth / (real32)ScreenHeight;
+	Game->ScreenHeight = ScreenHeight;
+
+	real32 Top = tanf(0.5f*DEG2RAD(Game->FoV)) * Game->FarDistance;
+	real32 Right = Top * Game->AspectRatio;
+
+	v3 CameraPos = Game->CameraPos;
+	v3 CameraFront = Game->CameraFront;
+	v3 CameraRight = Game->CameraRight;
+	v3 CameraUp = Game->CameraUp;
+	real32 FarDistance = Game->FarDistance;
+	Game->FrustumFarCornersWorldSpace[0] = V4(CameraPos, 0.0f) + V4(CameraFront*FarDistance - CameraRight*Right + CameraUp*Top, 1.0f);
+	Game->FrustumFarCornersWorldSpace[1] = V4(CameraPos, 0.0f) + V4(CameraFront*FarDistance - CameraRight*Right - CameraUp*Top, 1.0f);
+	Game->FrustumFarCornersWorldSpace[2] = V4(CameraPos, 0.0f) + V4(CameraFront*FarDistance + CameraRight*Right + CameraUp*Top, 1.0f);
+	Game->FrustumFarCornersWorldSpace[3] = V4(CameraPos, 0.0f) + V4(CameraFront*FarDistance + CameraRight*Right - CameraUp*Top, 1.0f);
+	for(int I = 0; I < 4; I++)
+	{
+		Game->FrustumFarCornersWorldSpace[I] = Game->FrustumFarCornersWorldSpace[I] * LookAt(CameraPos, CameraPos + CameraFront);
+		Game->FrustumFarCornersWorldSpace[I].w = FarDistance;
+	}
+
+	scene *Scene = &Game->Scene;
+	InitializeScene(Scene, Arena, GAME_MAX_SCENE_OBJECTS);
+	AddSceneMesh(Scene, SCENE_NO_PARENT, RenderMesh_Bunny, Identity(), 5.0f*V3(0.35f, 0.35f, 0.35f));
+	AddSceneMesh(Scene, SCENE_NO_PARENT, RenderMesh_Quad, Translate(V3(0.0f, 1.0f, 1.0f)), 5.0f*V3(0.0f, 0.0f, 0.75f));
+	AddSceneMesh(Scene, SCENE_NO_PARENT, RenderMesh_Quad, Rotate(90.0f, V3(0.0f, 1.0f, 0.0f)) * Translate(V3(-1.0f, 1.0f, 0.0f)), 5.0f*V3(0.75f, 0.0f, 0.0f));
+	AddSceneMesh(Scene, SCENE_NO_PARENT, RenderMesh_Quad, Rotate(-90.0f, V3(1.0f, 0.0, 0.0f)), 5.0f*V3(0.0f, 0.75f, 0.0f));
+	UpdateSceneTransforms(Scene, Platform.JobSystem);
+
+	InitializeAABBTree(&Game->SceneTree, Arena, GAME_MAX_SCENE_OBJECTS, GAME_SCENE_TREE_MARGIN);
+	Game->SceneTreeLeaves = PushArray(Arena, GAME_MAX_SCENE_OBJECTS, uint32_t);
+	memset(Game->SceneTreeLeaves, 0xFF, GAME_MAX_SCENE_OBJECTS*sizeof(uint32_t));
+	Game->MovedCasterBoxes = PushArray(Arena, GAME_MAX_SCENE_OBJECTS, aabb);
+	Game->MovedCasterCount = 0;
+	UpdateSceneTree(Game);
+	for(uint32_t Mesh = 0; Mesh < RenderMesh_Count; Mesh++)
+	{
+		Game->MeshBVHs[Mesh] = 0;
+	}
+	Game->PickedObject = SCENE_NO_PARENT;
+	Game->PickedTriangle = BVH_NO_TRIANGLE;
+
+	InitializeShadowAtlas(&Game->ShadowAtlas, Arena, RENDERER_SHADOW_ATLAS_SIZE);
+	InitializeShadowAtlas(&Game->RSMAtlas, Arena, RENDERER_RSM_ATLAS_SIZE);
+}
+
+static void
+UpdateGame(game_state *Game, game_input *Input, real32 DeltaTime)
+{
+	Game->CameraRight = Normalize(Cross(V3(0.0f, 1.0f, 0.0f), Game->CameraFront));
+	Game->CameraUp = Cross(Game->CameraFront, Game->CameraRight);
+	if(Input->MoveForward.EndedDown)
+	{
+		Game->CameraPos += 10.0f*Game->CameraFront*DeltaTime;
+	}
+	if(Input->MoveBack.EndedDown)
+	{
+		Game->CameraPos -= 10.0f*Game->CameraFront*DeltaTime;
+	}
+	if(Input->MoveLeft.EndedDown)
+	{
+		Game->CameraPos -= 10.0f*Game->CameraRight*DeltaTime;
+	}
+	if(Input->MoveRight.EndedDown)
+	{
+		Game->CameraPos += 10.0f*Game->CameraRight*DeltaTime;
+	}
+
+	Game->CameraHead += Game->MouseSensitivity*Input->DeltaMouseX;
+	Game->CameraPitch += Game->MouseSensitivity*Input->DeltaMouseY;
+	Game->CameraPitch = (Game->CameraPitch > 89.0f) ? 89.0f : Game->CameraPitch;
+	Game->CameraPitch = (Game->CameraPitch < -89.0f) ? -89.0f : Game->CameraPitch;
+
+	Game->CameraFront = V3(sinf(DEG2RAD(Game->CameraHead))*cosf(DEG2RAD(Game->CameraPitch)), sinf(-DEG2RAD(Game->CameraPitch)), cosf(DEG2RAD(Game->CameraHead))*cosf(DEG2RAD(Game->CameraPitch)));
+
+	UpdateSceneTransforms(&Game->Scene, Platform.JobSystem);
+	UpdateSceneTree(Game);
+
+	if(Input->Pick.EndedDown && Input->Pick.HalfTransitionCount)
+	{
+		v3 PickOrigin, PickDirection;
+		GetCursorRay(Game, Input, &PickOrigin, &PickDirection);
+		Game->PickedObject = PickSceneObject(Game, PickOrigin, PickDirection, GAME_PICK_DISTANCE, &Game->PickedTriangle);
+	}
+}
+
+// NOTE(georgy): Cascades of the sun for the camera, in their tiles of the shadow atlas.
+// Every light with shadows would ask the atlas for its own tiles like this.
+static void
+BuildSunShadowCascades(game_state *Game, mat4 CameraView, mat4 LightView, shadow_cascades *Cascades)
+{
+	// NOTE(georgy): Everything in the scene tree can cast a shadow into a cascade
+	aabb CasterBounds = {V3(0.0f, 0.0f, 0.0f), V3(0.0f, 0.0f, 0.0f)};
+	if(Game->SceneTree.Root != AABB_TREE_NULL_NODE)
+	{
+		CasterBounds = Game->SceneTree.Nodes[Game->SceneTree.Root].Box;
+	}
+	real32 ShadowDistance = fminf(GAME_SHADOW_DISTANCE, Game->FarDistance);
+
+	uint32_t Resolutions[SHADOW_CASCADE_COUNT];
+	real32 PixelAngle = 2.0f*tanf(0.5f*DEG2RAD(Game->FoV)) / Game->ScreenHeight;
+	GetShadowCascadeResolutions(Game->FrustumFarCornersWorldSpace, Game->NearDistance, ShadowDistance, PixelAngle, Resolutions);
+
+	shadow_atlas_request Requests[SHADOW_CASCADE_COUNT];
+	shadow_atlas_rect Tiles[SHADOW_CASCADE_COUNT];
+	for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+	{
+		Requests[Cascade] = {ShadowAtlasKey(GAME_SUN_LIGHT, Cascade), Resolutions[Cascade]};
+	}
+	UpdateShadowAtlas(&Game->ShadowAtlas, Requests, SHADOW_CASCADE_COUNT, Tiles);
+
+	BuildShadowCascades(Cascades, Game->FrustumFarCornersWorldSpace, CameraView, Game->NearDistance, ShadowDistance,
+						LightView, CasterBounds, Tiles, Game->ShadowAtlas.Size);
+}
+
+// NOTE(georgy): Frame arena must already be reset for this frame, the packet's arrays are pushed onto it
+static void
+FillFramePacket(game_state *Game, frame_packet *Packet, memory_arena *FrameArena)
+{
+	Packet->Quit = false;
+	Packet->CameraWorldPos = Game->CameraPos;
+	Packet->CameraView = LookAt(Game->CameraPos, Game->CameraPos + Game->CameraFront);
+	Packet->CameraProjection = Perspective(Game->FoV, Game->AspectRatio, Game->NearDistance, Game->FarDistance);
+	for(int I = 0; I < 4; I++)
+	{
+		Packet->FrustumFarCornersWorldSpace[I] = Game->FrustumFarCornersWorldSpace[I];
+	}
+	Packet->LightView = LookAt(GAME_SUN_POSITION, V3(0.0f, 0.0f, 0.0f));
+	Packet->LightProjection = Orthographic(-2.5f, 2.5f, -2.5f, 2.5f, 3.5f, 10.0f);
+
+	shadow_atlas_request RSMRequest = {ShadowAtlasKey(GAME_SUN_LIGHT, 0), GAME_RSM_SIZE};
+	UpdateShadowAtlas(&Game->RSMAtlas, &RSMRequest, 1, &Packet->RSMTile);
+	Assert(Packet->RSMTile.Size > 0);
+	BuildSunShadowCascades(Game, Packet->CameraView, Packet->LightView, &Packet->ShadowCascades);
+
+	// NOTE(georgy): The light views go first, the passes after them read what they render
+	Packet->ViewCount = 0;
+	AddRenderView(Packet, RenderPass_ShadowMap, Packet->LightView, Packet->LightProjection);
+	for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+	{
+		AddRenderView(Packet, RenderPass_ShadowCascade, Packet->LightView, Packet->ShadowCascades.Cascades[Cascade].Projection);
+	}
+	AddRenderView(Packet, RenderPass_GBuffer, Packet->CameraView, Packet->CameraProjection);
+
+	// NOTE(georgy): The renderer redraws the static casters of a light view only when one of them moved inside of it
+	for(uint32_t View = 0; View < Packet->ViewCount; View++)
+	{
+		render_view *RenderView = Packet->Views + View;
+		if(RenderView->Pass != RenderPass_GBuffer)
+		{
+			frustum Frustum = MakeFrustum(RenderView->View * RenderView->Projection);
+			for(uint32_t Moved = 0; (Moved < Game->MovedCasterCount) && !RenderView->StaticCastersMoved; Moved++)
+			{
+				aabb Box = Game->MovedCasterBoxes[Moved];
+				RenderView->StaticCastersMoved = IsBoxInFrustum(&Frustum, 0.5f*(Box.Min + Box.Max), 0.5f*(Box.Max - Box.Min));
+			}
+		}
+	}
+	Game->MovedCasterCount = 0;
+
+	Packet->ObjectCount = 0;
+	Packet->MaxObjectCount = MAX_FRAME_PACKET_OBJECTS;
+	Packet->Objects = PushArray(FrameArena, Packet->MaxObjectCount, render_object);
+
+	// NOTE(georgy): Broadphase: only objects whose tree leaves touch some view's frustum go into the packet.
+	// Marking and then walking the scene in order keeps the packet in scene order no matter what the tree does.
+	// The renderer still culls every object against every view with its tight bounds.
+	scene *Scene = &Game->Scene;
+	uint8_t *Marked = PushArray(FrameArena, Scene->Count, uint8_t, true);
+	uint32_t *Visible = PushArray(FrameArena, Game->SceneTree.LeafCount + 1, uint32_t);
+	for(uint32_t View = 0; View < Packet->ViewCount; View++)
+	{
+		frustum Frustum = MakeFrustum(Packet->Views[View].View * Packet->Views[View].Projection);
+		uint32_t VisibleCount = QueryAABBTreeFrustum(&Game->SceneTree, &Frustum, Visible, Game->SceneTree.LeafCount);
+		for(uint32_t I = 0; I < VisibleCount; I++)
+		{
+			Marked[Visible[I]] = 1;
+		}
+	}
+
+	for(uint32_t Object = 0; Object < Scene->Count; Object++)
+	{
+		if(Marked[Object])
+		{
+			aabb Box = GetSceneWorldBounds(Scene, Object);
+			PushRenderObject(Packet, (render_mesh)Scene->Meshes[Object], Scene->WorldTransforms[Object], Scene->Colors[Object],
+							 0.5f*(Box.Min + Box.Max), 0.5f*(Box.Max - Box.Min), Scene->Dynamic[Object]);
+		}
+	}
+}
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <stdint.h>
+
+//
+// NOTE(georgy): Thin graphics interface between the renderer and a backend.
+// graphics_device creates resources, graphics_context submits work. The context mirrors the part of
+// ID3D11DeviceContext that the renderer uses, call for call and with the same names, so the D3D11 backend
+// is a straight forward translation and other backends (null device, recorder, state filter) see exactly what D3D11 would see.
+// Resources are opaque handles, each backend decides what they point to.
+//
+
+struct gfx_buffer;
+struct gfx_texture;
+struct gfx_vertex_shader;
+struct gfx_pixel_shader;
+struct gfx_input_layout;
+struct gfx_depth_state;
+struct gfx_raster_state;
+struct gfx_blend_state;
+struct gfx_sampler;
+struct gfx_query;
+
+#define GFX_MAX_BOUND_RESOURCES 16
+
+//
+// NOTE(georgy): Textures
+//
+
+enum texture_format
+{
+	TextureFormat_RGBA8,
+	TextureFormat_RGBA16F,
+	TextureFormat_RGBA32F,
+	TextureFormat_R32F,
+	TextureFormat_Depth32,
+	TextureFormat_Depth24Stencil8,
+
+	TextureFormat_Count
+};
+
+enum texture_bind_flags
+{
+	TextureBind_ShaderResource = 0x1,
+	TextureBind_RenderTarget = 0x2,
+	TextureBind_DepthStencil = 0x4,
+};
+
+// NOTE(georgy): Render targets and depth stencils are always mip 0. Mips below it are filled by GenerateMips,
+// so a texture with more than one has to be a render target and a shader resource.
+struct texture_desc
+{
+	uint32_t Width, Height;
+	texture_format Format;
+	uint32_t BindFlags;
+	uint32_t MipCount;
+};
+
+inline texture_desc
+TextureDesc(uint32_t Width, uint32_t Height, texture_format Format, uint32_t BindFlags, uint32_t MipCount = 1)
+{
+	texture_desc Result;
+	Result.Width = Width;
+	Result.Height = Height;
+	Result.Format = Format;
+	Result.BindFlags = BindFlags;
+	Result.MipCount = MipCount;
+	return(Result);
+}
+
+inline bool
+TextureDescsMatch(texture_desc *A, texture_desc *B)
+{
+	bool Result = (A->Width == B->Width) && (A->Height == B->Height) &&
+				  (A->Format == B->Format) && (A->BindFlags == B->BindFlags) && (A->MipCount == B->MipCount);
+	return(Result);
+}
+
+inline uint64_t
+GetTextureSize(texture_desc *Desc)
+{
+	uint32_t BytesPerPixel = 0;
+	switch(Desc->Format)
+	{
+		case TextureFormat_RGBA8: BytesPerPixel = 4; break;
+		case TextureFormat_RGBA16F: BytesPerPixel = 8; break;
+		case TextureFormat_RGBA32F: BytesPerPixel = 16; break;
+		case TextureFormat_R32F: BytesPerPixel = 4; break;
+		case TextureFormat_Depth32: BytesPerPixel = 4; break;
+		case TextureFormat_Depth24Stencil8: BytesPerPixel = 4; break;
+		default: Assert(!"Unknown texture format");
+	}
+
+	uint64_t Result = 0;
+	for(uint32_t Mip = 0; Mip < Desc->MipCount; Mip++)
+	{
+		uint32_t Width = (Desc->Width >> Mip) ? (Desc->Width >> Mip) : 1;
+		uint32_t Height = (Desc->Height >> Mip) ? (Desc->Height >> Mip) : 1;
+		Result += (uint64_t)Width*Height*BytesPerPixel;
+	}
+	return(Result);
+}
+
+//
+// NOTE(georgy): Buffers
+//
+
+enum gfx_buffer_usage
+{
+	GfxBufferUsage_Immutable,
+	GfxBufferUsage_Dynamic,
+};
+
+enum gfx_buffer_bind
+{
+	GfxBufferBind_Vertex,
+	GfxBufferBind_Index,
+	GfxBufferBind_Constant,
+};
+
+struct gfx_buffer_desc
+{
+	uint32_t Size;
+	gfx_buffer_usage Usage;
+	gfx_buffer_bind Bind;
+	void *InitialData;
+};
+
+inline gfx_buffer_desc
+BufferDesc(uint32_t Size, gfx_buffer_usage Usage, gfx_buffer_bind Bind, void *InitialData = 0)
+{
+	gfx_buffer_desc Result;
+	Result.Size = Size;
+	Result.Usage = Usage;
+	Result.Bind = Bind;
+	Result.InitialData = InitialData;
+	return(Result);
+}
+
+enum gfx_map
+{
+	GfxMap_WriteDiscard,
+	GfxMap_WriteNoOverwrite,
+};
+
+// NOTE(georgy): Constant buffer ranges (VS/PSSetConstantBuffers1) are in 16 byte constants, and have to start
+// at a multiple of 16 constants, i.e. every range starts at a 256 byte boundary
+#define GFX_CONSTANT_SIZE 16
+#define GFX_CONSTANT_BUFFER_ALIGNMENT 256
+
+//
+// NOTE(georgy): Input assembly
+//
+
+enum gfx_vertex_format
+{
+	GfxVertexFormat_Float2,
+	GfxVertexFormat_Float3,
+	GfxVertexFormat_Float4,
+};
+
+struct gfx_input_element
+{
+	const char *SemanticName;
+	uint32_t SemanticIndex;
+	gfx_vertex_format Format;
+	uint32_t Slot;
+	uint32_t Offset;
+	bool PerInstance;
+};
+
+enum gfx_topology
+{
+	GfxTopology_TriangleList,
+	GfxTopology_TriangleStrip,
+};
+
+enum gfx_index_format
+{
+	GfxIndexFormat_U16,
+	GfxIndexFormat_U32,
+};
+
+//
+// NOTE(georgy): Fixed function state
+//
+
+enum gfx_comparison
+{
+	GfxComparison_Never,
+	GfxComparison_Less,
+	GfxComparison_LessEqual,
+	GfxComparison_Equal,
+	GfxComparison_Always,
+};
+
+struct gfx_depth_state_desc
+{
+	bool DepthEnable;
+	bool DepthWrite;
+	gfx_comparison DepthFunc;
+};
+
+enum gfx_cull_mode
+{
+	GfxCullMode_None,
+	GfxCullMode_Front,
+	GfxCullMode_Back,
+};
+
+struct gfx_raster_state_desc
+{
+	gfx_cull_mode CullMode;
+	bool FrontCounterClockwise;
+	int32_t DepthBias;
+	real32 SlopeScaledDepthBias;
+};
+
+struct gfx_blend_state_desc
+{
+	bool BlendEnable;
+};
+
+enum gfx_filter
+{
+	GfxFilter_Point,
+	GfxFilter_Linear,
+};
+
+enum gfx_address_mode
+{
+	GfxAddressMode_Clamp,
+	GfxAddressMode_Border,
+};
+
+struct gfx_sampler_desc
+{
+	gfx_filter Filter;
+	gfx_address_mode AddressMode;
+	gfx_comparison Comparison;
+};
+
+enum gfx_clear_flags
+{
+	GfxClear_Depth = 0x1,
+	GfxClear_Stencil = 0x2,
+};
+
+struct gfx_viewport
+{
+	real32 TopLeftX, TopLeftY;
+	real32 Width, Height;
+	real32 MinDepth, MaxDepth;
+};
+
+//
+// NOTE(georgy): Queries
+//
+
+// NOTE(georgy): What a pipeline statistics query counted between its Begin and End, the part of
+// D3D11_QUERY_DATA_PIPELINE_STATISTICS we look at. PSInvocations is the number of pixels that were shaded.
+struct gfx_pipeline_statistics
+{
+	uint64_t IAPrimitives;
+	uint64_t VSInvocations;
+	uint64_t PSInvocations;
+};
+
+//
+// NOTE(georgy): Device
+//
+
+struct graphics_device
+{
+	gfx_buffer *(*CreateBuffer)(graphics_device *Device, gfx_buffer_desc *Desc);
+	gfx_texture *(*CreateTexture)(graphics_device *Device, texture_desc *Desc, const char *Name);
+	void (*DestroyTexture)(graphics_device *Device, gfx_texture *Texture);
+	gfx_vertex_shader *(*CreateVertexShader)(graphics_device *Device, const char *Filename, const char *EntryPoint);
+	gfx_pixel_shader *(*CreatePixelShader)(graphics_device *Device, const char *Filename, const char *EntryPoint);
+	gfx_input_layout *(*CreateInputLayout)(graphics_device *Device, gfx_input_element *Elements, uint32_t ElementCount, gfx_vertex_shader *Shader);
+	gfx_depth_state *(*CreateDepthState)(graphics_device *Device, gfx_depth_state_desc *Desc);
+	gfx_raster_state *(*CreateRasterState)(graphics_device *Device, gfx_raster_state_desc *Desc);
+	gfx_blend_state *(*CreateBlendState)(graphics_device *Device, gfx_blend_state_desc *Desc);
+	gfx_sampler *(*CreateSampler)(graphics_device *Device, gfx_sampler_desc *Desc);
+	// NOTE(georgy): Pipeline statistics query. Name is what captures show for the work it measures.
+	gfx_query *(*CreateQuery)(graphics_device *Device, const char *Name);
+
+	void *Data;
+};
+
+//
+// NOTE(georgy): Context
+//
+
+#define GRAPHICS_CALL_LIST(X) \
+	X(RSSetViewports) \
+	X(RSSetState) \
+	X(OMSetRenderTargets) \
+	X(OMSetDepthStencilState) \
+	X(OMSetBlendState) \
+	X(ClearRenderTargetView) \
+	X(ClearDepthStencilView) \
+	X(GenerateMips) \
+	X(IASetInputLayout) \
+	X(IASetPrimitiveTopology) \
+	X(IASetVertexBuffers) \
+	X(IASetIndexBuffer) \
+	X(VSSetShader) \
+	X(PSSetShader) \
+	X(VSSetConstantBuffers) \
+	X(PSSetConstantBuffers) \
+	X(VSSetConstantBuffers1) \
+	X(PSSetConstantBuffers1) \
+	X(PSSetShaderResources) \
+	X(PSSetSamplers) \
+	X(Map) \
+	X(Unmap) \
+	X(Draw) \
+	X(DrawIndexed) \
+	X(DrawIndexedInstanced) \
+	X(Begin) \
+	X(End) \
+	X(GetData) \
+	X(Present)
+
+#define GRAPHICS_CALL_ENUM(Name) GraphicsCall_##Name,
+enum graphics_call
+{
+	GRAPHICS_CALL_LIST(GRAPHICS_CALL_ENUM)
+
+	GraphicsCall_Count
+};
+#undef GRAPHICS_CALL_ENUM
+
+#define GRAPHICS_CALL_NAME(Name) #Name,
+static const char *GraphicsCallNames[GraphicsCall_Count] =
+{
+	GRAPHICS_CALL_LIST(GRAPHICS_CALL_NAME)
+};
+#undef GRAPHICS_CALL_NAME
+
+struct graphics_context
+{
+	void (*RSSetViewports)(graphics_context *Context, uint32_t Count, gfx_viewport *Viewports);
+	void (*RSSetState)(graphics_context *Context, gfx_raster_state *State);
+	void (*OMSetRenderTargets)(graphics_context *Context, uint32_t Count, gfx_texture **RenderTargets, gfx_texture *DepthStencil);
+	void (*OMSetDepthStencilState)(graphics_context *Context, gfx_depth_state *State, uint32_t StencilRef);
+	void (*OMSetBlendState)(graphics_context *Context, gfx_blend_state *State, const real32 *BlendFactor, uint32_t SampleMask);
+	void (*ClearRenderTargetView)(graphics_context *Context, gfx_texture *RenderTarget, const real32 *Color);
+	void (*ClearDepthStencilView)(graphics_context *Context, gfx_texture *DepthStencil, uint32_t ClearFlags, real32 Depth, uint8_t Stencil);
+	// NOTE(georgy): Every mip below the first from the one above it, the texture can't be bound as a render target
+	void (*GenerateMips)(graphics_context *Context, gfx_texture *Texture);
+	void (*IASetInputLayout)(graphics_context *Context, gfx_input_layout *Layout);
+	void (*IASetPrimitiveTopology)(graphics_context *Context, gfx_topology Topology);
+	void (*IASetVertexBuffers)(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *Strides, uint32_t *Offsets);
+	void (*IASetIndexBuffer)(graphics_context *Context, gfx_buffer *Buffer, gfx_index_format Format, uint32_t Offset);
+	void (*VSSetShader)(graphics_context *Context, gfx_vertex_shader *Shader);
+	void (*PSSetShader)(graphics_context *Context, gfx_pixel_shader *Shader);
+	void (*VSSetConstantBuffers)(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers);
+	void (*PSSetConstantBuffers)(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers);
+	void (*VSSetConstantBuffers1)(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *FirstConstant, uint32_t *NumConstants);
+	void (*PSSetConstantBuffers1)(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *FirstConstant, uint32_t *NumConstants);
+	void (*PSSetShaderResources)(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_texture **Textures);
+	void (*PSSetSamplers)(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_sampler **Samplers);
+	void *(*Map)(graphics_context *Context, gfx_buffer *Buffer, gfx_map MapType);
+	void (*Unmap)(graphics_context *Context, gfx_buffer *Buffer);
+	void (*Draw)(graphics_context *Context, uint32_t VertexCount, uint32_t StartVertex);
+	void (*DrawIndexed)(graphics_context *Context, uint32_t IndexCount, uint32_t StartIndex, int32_t BaseVertex);
+	void (*DrawIndexedInstanced)(graphics_context *Context, uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndex, int32_t BaseVertex, uint32_t StartInstance);
+	// NOTE(georgy): GetData doesn't wait for the GPU, it returns false if the results aren't there yet
+	void (*Begin)(graphics_context *Context, gfx_query *Query);
+	void (*End)(graphics_context *Context, gfx_query *Query);
+	bool (*GetData)(graphics_context *Context, gfx_query *Query, gfx_pipeline_statistics *Statistics);
+	void (*Present)(graphics_context *Context);
+
+	void *Data;
+};
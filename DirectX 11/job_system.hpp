@@ -0,0 +1,445 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <new>
+
+//
+// NOTE(georgy): Work-stealing job system.
+// Every thread that takes part (workers, the main thread and any thread that registers itself)
+// owns a job pool and a Chase-Lev deque. The owner pushes and pops at the bottom of its deque,
+// idle threads steal from the top of someone else's. Jobs form a parent/child tree: a job is
+// finished only when it and all of its children are finished, so waiting on a parent waits on
+// the whole subtree. Waiting threads keep executing jobs instead of blocking, that's why waiting
+// on the main thread can't deadlock even if there are no worker threads at all.
+//
+
+#define JOB_SYSTEM_MAX_THREADS 64
+#define JOB_SYSTEM_MAX_JOBS_PER_THREAD 4096 // NOTE(georgy): Must be a power of 2
+
+struct job;
+typedef void job_function(job *Job, void *Data);
+
+// NOTE(georgy): Jobs are aligned to a cache line so threads that work on neighbouring jobs don't fight over it
+struct alignas(64) job
+{
+	job_function *Function;
+	job *Parent;
+	std::atomic<int32_t> UnfinishedJobs;
+
+	// NOTE(georgy): Small payloads are copied right into the job, so most jobs don't need any extra memory.
+	// Payloads hold pointers, so the data starts on an 8 byte boundary.
+	alignas(8) uint8_t Data[64 - 3*8];
+};
+static_assert(sizeof(job) == 64, "A job has to be exactly one cache line");
+
+struct job_queue
+{
+	std::atomic<int64_t> Top;
+	uint8_t Pad0[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<int64_t> Bottom;
+	uint8_t Pad1[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<job *> Entries[JOB_SYSTEM_MAX_JOBS_PER_THREAD];
+};
+
+struct job_thread_context
+{
+	job_queue Queue;
+	job *JobPool;
+	uint8_t *JobPoolMemory; // NOTE(georgy): What JobPool was cut from, new[] doesn't align to 64 before C++17
+	uint32_t AllocatedJobs;
+	uint32_t RandomState;
+};
+
+struct job_system
+{
+	uint32_t ThreadCount; // NOTE(georgy): Workers + main thread + registered threads
+	uint32_t WorkerThreadCount;
+	std::atomic<uint32_t> RegisteredThreadCount;
+	std::atomic<bool> Running;
+
+	job_thread_context *Threads;
+	std::thread *WorkerThreads;
+
+	std::mutex SleepMutex;
+	std::condition_variable SleepCondition;
+};
+
+// NOTE(georgy): Index of the calling thread inside the job system, -1 if it isn't part of it
+static thread_local int32_t JobSystemThreadIndex = -1;
+
+//
+// NOTE(georgy): Chase-Lev deque
+//
+
+static void
+PushJob(job_queue *Queue, job *Job)
+{
+	int64_t Bottom = Queue->Bottom.load(std::memory_order_relaxed);
+	// NOTE(georgy): A full deque would overwrite the oldest entry, which thieves can still take
+	Assert((Bottom - Queue->Top.load(std::memory_order_relaxed)) < JOB_SYSTEM_MAX_JOBS_PER_THREAD);
+	Queue->Entries[Bottom & (JOB_SYSTEM_MAX_JOBS_PER_THREAD - 1)].store(Job, std::memory_order_relaxed);
+	Queue->Bottom.store(Bottom + 1, std::memory_order_release);
+}
+
+static job *
+PopJob(job_queue *Queue)
+{
+	int64_t Bottom = Queue->Bottom.load(std::memory_order_relaxed) - 1;
+	Queue->Bottom.store(Bottom, std::memory_order_seq_cst);
+	int64_t Top = Queue->Top.load(std::memory_order_seq_cst);
+
+	job *Result = 0;
+	if(Top <= Bottom)
+	{
+		Result = Queue->Entries[Bottom & (JOB_SYSTEM_MAX_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+		if(Top == Bottom)
+		{
+			// NOTE(georgy): This is the last job in the queue, race with the thieves for it
+			if(!Queue->Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				Result = 0;
+			}
+			Queue->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+		}
+	}
+	else
+	{
+		Queue->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+	}
+
+	return(Result);
+}
+
+static job *
+StealJob(job_queue *Queue)
+{
+	int64_t Top = Queue->Top.load(std::memory_order_seq_cst);
+	int64_t Bottom = Queue->Bottom.load(std::memory_order_seq_cst);
+
+	job *Result = 0;
+	if(Top < Bottom)
+	{
+		Result = Queue->Entries[Top & (JOB_SYSTEM_MAX_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+		if(!Queue->Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			Result = 0;
+		}
+	}
+
+	return(Result);
+}
+
+//
+// NOTE(georgy): Jobs
+//
+
+inline job_thread_context *
+GetThreadContext(job_system *JobSystem)
+{
+	Assert((JobSystemThreadIndex >= 0) && ((uint32_t)JobSystemThreadIndex < JobSystem->ThreadCount));
+	job_thread_context *Result = JobSystem->Threads + JobSystemThreadIndex;
+	return(Result);
+}
+
+inline bool
+IsJobFinished(job *Job)
+{
+	bool Result = (Job->UnfinishedJobs.load(std::memory_order_acquire) == 0);
+	return(Result);
+}
+
+static job *
+AllocateJob(job_system *JobSystem)
+{
+	// NOTE(georgy): Ring buffer per thread. By the time we wrap around the job that used the slot
+	// is long finished, as long as a single frame doesn't have more than JOB_SYSTEM_MAX_JOBS_PER_THREAD jobs in flight.
+	job_thread_context *Context = GetThreadContext(JobSystem);
+	job *Result = Context->JobPool + (Context->AllocatedJobs++ & (JOB_SYSTEM_MAX_JOBS_PER_THREAD - 1));
+	Assert(IsJobFinished(Result));
+	return(Result);
+}
+
+static job *
+CreateJob(job_system *JobSystem, job_function *Function, void *Data = 0, size_t DataSize = 0)
+{
+	Assert(DataSize <= sizeof(((job *)0)->Data));
+
+	job *Result = AllocateJob(JobSystem);
+	Result->Function = Function;
+	Result->Parent = 0;
+	Result->UnfinishedJobs.store(1, std::memory_order_relaxed);
+	if(DataSize)
+	{
+		memcpy(Result->Data, Data, DataSize);
+	}
+
+	return(Result);
+}
+
+static job *
+CreateChildJob(job_system *JobSystem, job *Parent, job_function *Function, void *Data = 0, size_t DataSize = 0)
+{
+	Parent->UnfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+
+	job *Result = CreateJob(JobSystem, Function, Data, DataSize);
+	Result->Parent = Parent;
+
+	return(Result);
+}
+
+static void
+RunJob(job_system *JobSystem, job *Job)
+{
+	job_thread_context *Context = GetThreadContext(JobSystem);
+	PushJob(&Context->Queue, Job);
+	JobSystem->SleepCondition.notify_one();
+}
+
+static void
+FinishJob(job *Job)
+{
+	// NOTE(georgy): Once the count hits zero the owner can recycle the job, so Parent has to be read before
+	job *Parent = Job->Parent;
+	int32_t UnfinishedJobs = Job->UnfinishedJobs.fetch_sub(1, std::memory_order_acq_rel) - 1;
+	if((UnfinishedJobs == 0) && Parent)
+	{
+		FinishJob(Parent);
+	}
+}
+
+static void
+ExecuteJob(job *Job)
+{
+	Job->Function(Job, Job->Data);
+	FinishJob(Job);
+}
+
+static job *
+GetJob(job_system *JobSystem)
+{
+	job_thread_context *Context = GetThreadContext(JobSystem);
+
+	job *Result = PopJob(&Context->Queue);
+	if(!Result)
+	{
+		// NOTE(georgy): Our own queue is empty, try to steal starting from a random victim
+		uint32_t ThreadCount = JobSystem->RegisteredThreadCount.load(std::memory_order_acquire);
+		Context->RandomState ^= Context->RandomState << 13;
+		Context->RandomState ^= Context->RandomState >> 17;
+		Context->RandomState ^= Context->RandomState << 5;
+		uint32_t FirstVictim = Context->RandomState % ThreadCount;
+		for(uint32_t I = 0; (I < ThreadCount) && !Result; I++)
+		{
+			uint32_t VictimIndex = (FirstVictim + I) % ThreadCount;
+			if(VictimIndex != (uint32_t)JobSystemThreadIndex)
+			{
+				Result = StealJob(&JobSystem->Threads[VictimIndex].Queue);
+			}
+		}
+	}
+
+	return(Result);
+}
+
+// NOTE(georgy): The calling thread executes other jobs while it waits, so it's safe to call it from anywhere
+static void
+WaitForJob(job_system *JobSystem, job *Job)
+{
+	while(!IsJobFinished(Job))
+	{
+		job *NextJob = GetJob(JobSystem);
+		if(NextJob)
+		{
+			ExecuteJob(NextJob);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+static void
+JobSystemWorkerThread(job_system *JobSystem, uint32_t ThreadIndex)
+{
+	JobSystemThreadIndex = ThreadIndex;
+
+	uint32_t IdleIterations = 0;
+	while(JobSystem->Running.load(std::memory_order_acquire))
+	{
+		job *Job = GetJob(JobSystem);
+		if(Job)
+		{
+			ExecuteJob(Job);
+			IdleIterations = 0;
+		}
+		else if(++IdleIterations < 64)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			// NOTE(georgy): Nothing to do for a while, go to sleep. The timeout covers wakeups
+			// that were signalled between the failed steal and the wait.
+			std::unique_lock<std::mutex> Lock(JobSystem->SleepMutex);
+			JobSystem->SleepCondition.wait_for(Lock, std::chrono::milliseconds(1));
+		}
+	}
+}
+
+// NOTE(georgy): WorkerThreadCount == UINT32_MAX means one worker per core except the calling (main) thread
+static void
+InitializeJobSystem(job_system *JobSystem, uint32_t WorkerThreadCount = UINT32_MAX, uint32_t ExtraThreadCount = 1)
+{
+	if(WorkerThreadCount == UINT32_MAX)
+	{
+		uint32_t CoreCount = std::thread::hardware_concurrency();
+		WorkerThreadCount = (CoreCount > 1) ? (CoreCount - 1) : 0;
+	}
+	Assert((1 + WorkerThreadCount + ExtraThreadCount) <= JOB_SYSTEM_MAX_THREADS);
+
+	JobSystem->WorkerThreadCount = WorkerThreadCount;
+	JobSystem->ThreadCount = 1 + WorkerThreadCount + ExtraThreadCount;
+	JobSystem->RegisteredThreadCount.store(1 + WorkerThreadCount, std::memory_order_relaxed);
+	JobSystem->Running.store(true, std::memory_order_relaxed);
+
+	JobSystem->Threads = new job_thread_context[JobSystem->ThreadCount];
+	for(uint32_t ThreadIndex = 0; ThreadIndex < JobSystem->ThreadCount; ThreadIndex++)
+	{
+		job_thread_context *Context = JobSystem->Threads + ThreadIndex;
+		Context->Queue.Top.store(0, std::memory_order_relaxed);
+		Context->Queue.Bottom.store(0, std::memory_order_relaxed);
+		// NOTE(georgy): Unused jobs count as finished, AllocateJob checks that the slot it recycles is
+		Context->JobPoolMemory = new uint8_t[JOB_SYSTEM_MAX_JOBS_PER_THREAD*sizeof(job) + alignof(job) - 1];
+		Context->JobPool = (job *)(((uintptr_t)Context->JobPoolMemory + alignof(job) - 1) & ~(uintptr_t)(alignof(job) - 1));
+		for(uint32_t JobIndex = 0; JobIndex < JOB_SYSTEM_MAX_JOBS_PER_THREAD; JobIndex++)
+		{
+			new(Context->JobPool + JobIndex) job();
+		}
+		Context->AllocatedJobs = 0;
+		Context->RandomState = 0x9E3779B9u * (ThreadIndex + 1);
+	}
+
+	// NOTE(georgy): The calling thread is always thread 0
+	JobSystemThreadIndex = 0;
+
+	JobSystem->WorkerThreads = new std::thread[WorkerThreadCount];
+	for(uint32_t WorkerIndex = 0; WorkerIndex < WorkerThreadCount; WorkerIndex++)
+	{
+		JobSystem->WorkerThreads[WorkerIndex] = std::thread(JobSystemWorkerThread, JobSystem, WorkerIndex + 1);
+	}
+}
+
+// NOTE(georgy): Lets a thread that isn't a worker (e.g. a render thread) create, run and wait for jobs
+static void
+RegisterJobSystemThread(job_system *JobSystem)
+{
+	Assert(JobSystemThreadIndex == -1);
+
+	uint32_t ThreadIndex = JobSystem->RegisteredThreadCount.fetch_add(1, std::memory_order_acq_rel);
+	Assert(ThreadIndex < JobSystem->ThreadCount);
+	JobSystemThreadIndex = ThreadIndex;
+}
+
+static void
+ShutdownJobSystem(job_system *JobSystem)
+{
+	JobSystem->Running.store(false, std::memory_order_release);
+	JobSystem->SleepCondition.notify_all();
+	for(uint32_t WorkerIndex = 0; WorkerIndex < JobSystem->WorkerThreadCount; WorkerIndex++)
+	{
+		JobSystem->WorkerThreads[WorkerIndex].join();
+	}
+
+	for(uint32_t ThreadIndex = 0; ThreadIndex < JobSystem->ThreadCount; ThreadIndex++)
+	{
+		delete[] JobSystem->Threads[ThreadIndex].JobPoolMemory;
+	}
+	delete[] JobSystem->Threads;
+	delete[] JobSystem->WorkerThreads;
+}
+
+//
+// NOTE(georgy): ParallelFor
+//
+
+typedef void parallel_for_function(uint32_t Start, uint32_t OnePastEnd, void *UserData);
+
+struct parallel_for_job_data
+{
+	job_system *JobSystem;
+	parallel_for_function *Function;
+	void *UserData;
+	uint32_t Start;
+	uint32_t OnePastEnd;
+	uint32_t GrainSize;
+};
+
+static void
+ParallelForJob(job *Job, void *Data)
+{
+	parallel_for_job_data *JobData = (parallel_for_job_data *)Data;
+
+	// NOTE(georgy): Split the range in halves until it's not bigger than the grain size.
+	// Halves go to our own queue, so idle threads steal the biggest pieces first.
+	uint32_t Count = JobData->OnePastEnd - JobData->Start;
+	if(Count > JobData->GrainSize)
+	{
+		uint32_t Middle = JobData->Start + Count/2;
+
+		parallel_for_job_data LeftData = *JobData;
+		LeftData.OnePastEnd = Middle;
+		parallel_for_job_data RightData = *JobData;
+		RightData.Start = Middle;
+
+		job *Left = CreateChildJob(JobData->JobSystem, Job, ParallelForJob, &LeftData, sizeof(LeftData));
+		RunJob(JobData->JobSystem, Left);
+		job *Right = CreateChildJob(JobData->JobSystem, Job, ParallelForJob, &RightData, sizeof(RightData));
+		RunJob(JobData->JobSystem, Right);
+	}
+	else
+	{
+		JobData->Function(JobData->Start, JobData->OnePastEnd, JobData->UserData);
+	}
+}
+
+// NOTE(georgy): The grain size adapts to the amount of work and the thread count: we aim for ~8 pieces per thread
+// so stealing can balance uneven work, but never go below MinGrainSize so tiny items don't drown in overhead.
+static void
+ParallelFor(job_system *JobSystem, uint32_t Count, parallel_for_function *Function, void *UserData, uint32_t MinGrainSize = 1)
+{
+	if(Count == 0)
+	{
+		return;
+	}
+
+	uint32_t ActiveThreadCount = JobSystem->WorkerThreadCount + 1;
+	uint32_t GrainSize = Count / (8*ActiveThreadCount);
+	GrainSize = (GrainSize < MinGrainSize) ? MinGrainSize : GrainSize;
+	GrainSize = (GrainSize < 1) ? 1 : GrainSize;
+
+	if((ActiveThreadCount == 1) || (Count <= GrainSize))
+	{
+		Function(0, Count, UserData);
+	}
+	else
+	{
+		parallel_for_job_data Data;
+		Data.JobSystem = JobSystem;
+		Data.Function = Function;
+		Data.UserData = UserData;
+		Data.Start = 0;
+		Data.OnePastEnd = Count;
+		Data.GrainSize = GrainSize;
+
+		job *Root = CreateJob(JobSystem, ParallelForJob, &Data, sizeof(Data));
+		RunJob(JobSystem, Root);
+		WaitForJob(JobSystem, Root);
+	}
+}
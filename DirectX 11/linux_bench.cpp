@@ -0,0 +1,4428 @@
+// NOTE(georgy): CPU-side benchmarks that don't need Windows or a GPU.
+// Build: g++ -O2 -std=c++14 -pthread -I"../Directx 11" linux_bench.cpp -o linux_bench
+// Usage: linux_bench [benchmark name...], runs everything if no names are given
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+#include "math.hpp"
+
+#define Assert(Expression) if(!(Expression)) { *(int *)0 = 0; }
+#define ArrayCount(Array) (sizeof(Array)/sizeof((Array)[0]))
+
+#include "job_system.hpp"
+#include "spsc_queue.hpp"
+#include "memory_arena.hpp"
+
+#define ALLOC_TRACKER 1
+#define ALLOC_TRACKER_ASSERT_BUDGETS 1
+#include "alloc_tracker.hpp"
+#include "frame_graph.hpp"
+#include "renderer_frame_graph.hpp"
+#include "null_graphics.hpp"
+#include "command_capture.hpp"
+#include "state_filter.hpp"
+#include "game.hpp"
+
+global_variable job_system GlobalJobSystem;
+global_variable renderer GlobalRenderer;
+
+inline real64
+GetSeconds(void)
+{
+	real64 Result = std::chrono::duration<real64>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+	return(Result);
+}
+
+//
+// NOTE(georgy): Job system
+//
+
+struct job_bench_data
+{
+	real32 *Values;
+	uint32_t IterationsPerItem;
+};
+
+static void
+JobBenchWork(uint32_t Start, uint32_t OnePastEnd, void *UserData)
+{
+	job_bench_data *Data = (job_bench_data *)UserData;
+	for(uint32_t I = Start; I < OnePastEnd; I++)
+	{
+		// NOTE(georgy): Uneven amount of work per item, so stealing actually has something to balance
+		real32 Value = (real32)I;
+		uint32_t Iterations = Data->IterationsPerItem + (I % 7)*Data->IterationsPerItem;
+		for(uint32_t Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Value = sqrtf(Value + 1.0f);
+		}
+		Data->Values[I] = Value;
+	}
+}
+
+static void
+BenchJobSystem(void)
+{
+	uint32_t Counts[] = {1000, 100000, 1000000};
+	for(uint32_t CountIndex = 0; CountIndex < ArrayCount(Counts); CountIndex++)
+	{
+		uint32_t Count = Counts[CountIndex];
+
+		job_bench_data Data;
+		Data.Values = new real32[Count];
+		Data.IterationsPerItem = 16;
+
+		real64 Start = GetSeconds();
+		JobBenchWork(0, Count, &Data);
+		real64 SerialTime = GetSeconds() - Start;
+
+		const uint32_t Runs = 10;
+		Start = GetSeconds();
+		for(uint32_t Run = 0; Run < Runs; Run++)
+		{
+			ParallelFor(&GlobalJobSystem, Count, JobBenchWork, &Data);
+		}
+		real64 ParallelTime = (GetSeconds() - Start) / Runs;
+
+		printf("jobs: %8u items  serial %8.3fms  ParallelFor %8.3fms  speedup %.2fx (%u threads)\n",
+			   Count, 1000.0*SerialTime, 1000.0*ParallelTime, SerialTime / ParallelTime, GlobalJobSystem.WorkerThreadCount + 1);
+
+		delete[] Data.Values;
+	}
+}
+
+//
+// NOTE(georgy): SPSC queue
+//
+
+// NOTE(georgy): Roughly the size of a real frame packet, with a checksum so torn reads are caught
+struct bench_packet
+{
+	uint64_t Sequence;
+	uint64_t Checksum;
+	real32 Payload[256];
+};
+
+static void
+BenchSPSCQueue(void)
+{
+	const uint64_t PacketCount = 2000000;
+	spsc_queue<bench_packet, 2> *Queue = new spsc_queue<bench_packet, 2>;
+	InitializeQueue(Queue);
+
+	real64 Start = GetSeconds();
+	std::thread Consumer([Queue, PacketCount]()
+	{
+		for(uint64_t Expected = 0; Expected < PacketCount; Expected++)
+		{
+			bench_packet *Packet;
+			while(!(Packet = BeginPop(Queue)))
+			{
+				std::this_thread::yield();
+			}
+
+			uint64_t Checksum = Packet->Sequence;
+			for(uint32_t I = 0; I < ArrayCount(Packet->Payload); I++)
+			{
+				Checksum = 31*Checksum + (uint64_t)Packet->Payload[I];
+			}
+			Assert(Packet->Sequence == Expected);
+			Assert(Packet->Checksum == Checksum);
+
+			EndPop(Queue);
+		}
+	});
+
+	uint32_t MaxQueueDepth = 0;
+	for(uint64_t Sequence = 0; Sequence < PacketCount; Sequence++)
+	{
+		bench_packet *Packet;
+		while(!(Packet = BeginPush(Queue)))
+		{
+			std::this_thread::yield();
+		}
+
+		uint32_t QueueDepth = Queue->WriteIndex.load(std::memory_order_relaxed) - Queue->ReadIndex.load(std::memory_order_relaxed);
+		MaxQueueDepth = (QueueDepth > MaxQueueDepth) ? QueueDepth : MaxQueueDepth;
+
+		Packet->Sequence = Sequence;
+		uint64_t Checksum = Sequence;
+		for(uint32_t I = 0; I < ArrayCount(Packet->Payload); I++)
+		{
+			Packet->Payload[I] = (real32)((Sequence + I) & 0xFF);
+			Checksum = 31*Checksum + (uint64_t)Packet->Payload[I];
+		}
+		Packet->Checksum = Checksum;
+
+		EndPush(Queue);
+	}
+	Consumer.join();
+	real64 Elapsed = GetSeconds() - Start;
+
+	printf("spsc: %llu packets of %u bytes handed off in %.3fs (%.2f M/s), max depth %u, all in order\n",
+		   (unsigned long long)PacketCount, (uint32_t)sizeof(bench_packet), Elapsed, PacketCount / Elapsed / 1000000.0, MaxQueueDepth);
+
+	delete Queue;
+}
+
+//
+// NOTE(georgy): Allocation tracker
+//
+
+struct alloc_bench_object
+{
+	mat4 Model;
+	v3 Color;
+};
+
+struct alloc_bench_packet
+{
+	uint32_t ObjectCount;
+	alloc_bench_object *Objects;
+};
+
+static void
+AllocBenchWork(uint32_t Start, uint32_t OnePastEnd, void *UserData)
+{
+	alloc_bench_packet *Packet = (alloc_bench_packet *)UserData;
+	for(uint32_t I = Start; I < OnePastEnd; I++)
+	{
+		Packet->Objects[I].Model = Translate(V3((real32)I, 0.0f, 0.0f));
+		Packet->Objects[I].Color = V3(1.0f, 1.0f, 1.0f);
+	}
+}
+
+// NOTE(georgy): Same frame structure as the game loop: a packet handed to a consumer thread,
+// filled from a frame arena with ParallelFor. Every frame runs under a zero-allocation budget.
+static void
+BenchAllocTracker(void)
+{
+	const uint32_t FrameCount = 1000;
+	const uint32_t ObjectCount = 4096;
+
+	size_t FrameMemorySize = ObjectCount*sizeof(alloc_bench_object) + 64*1024;
+	void *Memory = malloc(FRAME_ARENA_COUNT*FrameMemorySize);
+	memory_arena Arena;
+	InitializeArena(&Arena, FRAME_ARENA_COUNT*FrameMemorySize, Memory);
+	frame_arenas FrameArenas;
+	InitializeFrameArenas(&FrameArenas, &Arena, FrameMemorySize);
+
+	spsc_queue<alloc_bench_packet, 2> *Queue = new spsc_queue<alloc_bench_packet, 2>;
+	InitializeQueue(Queue);
+
+	std::thread Consumer([Queue, FrameCount]()
+	{
+		for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+		{
+			alloc_bench_packet *Packet;
+			while(!(Packet = BeginPop(Queue)))
+			{
+				std::this_thread::yield();
+			}
+
+			alloc_scope FrameScope(AllocTag_Frame, 0, 0);
+			real32 Sum = 0.0f;
+			for(uint32_t I = 0; I < Packet->ObjectCount; I++)
+			{
+				Sum += Packet->Objects[I].Model.a41;
+			}
+			Assert(Sum > 0.0f);
+
+			EndPop(Queue);
+		}
+	});
+
+	for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+	{
+		alloc_scope FrameScope(AllocTag_Frame, 0, 0);
+
+		alloc_bench_packet *Packet;
+		while(!(Packet = BeginPush(Queue)))
+		{
+			std::this_thread::yield();
+		}
+
+		memory_arena *FrameArena = BeginFrameArena(&FrameArenas);
+		Packet->ObjectCount = ObjectCount;
+		Packet->Objects = PushArray(FrameArena, ObjectCount, alloc_bench_object);
+		ParallelFor(&GlobalJobSystem, ObjectCount, AllocBenchWork, Packet, 64);
+
+		EndPush(Queue);
+
+		AllocTrackerEndFrame();
+	}
+	Consumer.join();
+
+	for(uint32_t Tag = 0; Tag < AllocTag_Count; Tag++)
+	{
+		alloc_tag_stats Stats = GetAllocTagStats((alloc_tag)Tag);
+		printf("alloc: %-10s total %8llu allocs %10llu bytes  peak frame %llu allocs %llu bytes\n", AllocTagNames[Tag],
+			   (unsigned long long)Stats.TotalAllocations, (unsigned long long)Stats.TotalBytes,
+			   (unsigned long long)Stats.PeakFrameAllocations, (unsigned long long)Stats.PeakFrameBytes);
+	}
+	Assert(GetAllocTagStats(AllocTag_Frame).TotalAllocations == 0);
+	printf("alloc: %u frames without a heap allocation\n", FrameCount);
+
+	if(DumpAllocTrackerCSV("alloc_stats.csv"))
+	{
+		printf("alloc: per-frame counts written to alloc_stats.csv\n");
+	}
+
+	delete Queue;
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Frame graph
+//
+
+static void
+PrintFrameGraph(frame_graph *Graph)
+{
+	for(uint32_t PassIndex = 0; PassIndex < Graph->PassCount; PassIndex++)
+	{
+		frame_graph_pass *Pass = Graph->Passes + PassIndex;
+		printf("framegraph:   pass %-10s %s\n", Pass->Name, Pass->Culled ? "culled" : "");
+	}
+	for(uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ResourceIndex++)
+	{
+		frame_graph_resource *Resource = Graph->Resources + ResourceIndex;
+		if(!Resource->Imported)
+		{
+			if(Resource->PhysicalTexture != FRAME_GRAPH_INVALID_INDEX)
+			{
+				printf("framegraph:   %-26s passes %u-%u  physical %u\n", Resource->Name, Resource->FirstPass, Resource->LastPass, Resource->PhysicalTexture);
+			}
+			else
+			{
+				printf("framegraph:   %-26s not allocated\n", Resource->Name);
+			}
+		}
+	}
+
+	frame_graph_stats *Stats = &Graph->Stats;
+	printf("framegraph: %u transient textures in %u physical, %.2fMB instead of %.2fMB (saved %.2fMB, lower bound %.2fMB), %.2fMB imported, %u passes culled\n",
+		   Stats->TransientTextureCount, Stats->PhysicalTextureCount,
+		   Stats->AliasedBytes / (1024.0*1024.0), Stats->UnaliasedBytes / (1024.0*1024.0),
+		   (Stats->UnaliasedBytes - Stats->AliasedBytes) / (1024.0*1024.0), Stats->PeakLiveBytes / (1024.0*1024.0),
+		   Stats->ImportedBytes / (1024.0*1024.0), Stats->CulledPassCount);
+}
+
+// NOTE(georgy): Stand-ins for the renderer's temporal history textures, imported like the back buffer
+global_variable void *BenchRSMHistory[2] = {(void *)2, (void *)3};
+// NOTE(georgy): And for its light maps, they're kept from frame to frame for the light caches
+global_variable void *BenchLightMaps[RendererLightMap_Count] = {(void *)4, (void *)5, (void *)6, (void *)7, (void *)8};
+// NOTE(georgy): And its filtered shadow cascades
+global_variable void *BenchShadowMomentsTexture = (void *)9;
+
+static void
+BenchFrameGraph(void)
+{
+	frame_graph_backend Backend;
+	null_frame_graph_backend NullBackend;
+
+	// NOTE(georgy): The renderer's graph, as main.cpp builds it
+	{
+		InitializeNullFrameGraphBackend(&Backend, &NullBackend);
+		frame_graph *Graph = new frame_graph;
+		renderer_frame_graph Renderer;
+		InitializeFrameGraph(Graph, &Backend);
+		DeclareRendererFrameGraph(Graph, &Renderer, 960, 540, (void *)1, BenchRSMHistory, BenchLightMaps, BenchShadowMomentsTexture, true);
+		CompileFrameGraph(Graph);
+
+		printf("framegraph: renderer at 960x540\n");
+		PrintFrameGraph(Graph);
+
+		// NOTE(georgy): Indirect illumination is gathered and blurred at low resolution. The gather is dead once
+		// temporal accumulation has read it, so the horizontal blur takes its texture.
+		frame_graph_resource *Indirect = Graph->Resources + Renderer.RSMIndirectIllum;
+		Assert(Graph->Stats.CulledPassCount == 0);
+		Assert(Graph->Stats.AliasedBytes < Graph->Stats.UnaliasedBytes);
+		Assert(Graph->Stats.PeakLiveBytes <= Graph->Stats.AliasedBytes);
+		Assert((Indirect->Desc.Width == 960 / RENDERER_RSM_DOWNSAMPLE) && (Indirect->Desc.Height == 540 / RENDERER_RSM_DOWNSAMPLE));
+		Assert(GetFrameGraphTexture(Graph, Renderer.RSMBlurHorizontal) == GetFrameGraphTexture(Graph, Renderer.RSMIndirectIllum));
+		Assert(GetFrameGraphTexture(Graph, Renderer.RSMAccumulated) == BenchRSMHistory[1]);
+		Assert(GetFrameGraphTexture(Graph, Renderer.ShadowMoments) == BenchShadowMomentsTexture);
+
+		// NOTE(georgy): The light maps are imported for the light caches. As transients they'd have nothing to alias with.
+		for(uint32_t Map = 0; Map < RendererLightMap_Count; Map++)
+		{
+			texture_desc LightMapDesc = GetRendererLightMapDesc((renderer_light_map)Map);
+			for(uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ResourceIndex++)
+			{
+				frame_graph_resource *Resource = Graph->Resources + ResourceIndex;
+				Assert(Resource->Imported || !TextureDescsMatch(&Resource->Desc, &LightMapDesc));
+			}
+		}
+		Assert(NullBackend.CreatedTextureCount == Graph->Stats.PhysicalTextureCount);
+
+		ReleaseFrameGraphTextures(Graph);
+		Assert(NullBackend.LiveTextureCount == 0);
+		delete Graph;
+	}
+
+	// NOTE(georgy): Debug visualization chain nobody looks at: both passes go, and their textures are never allocated
+	{
+		InitializeNullFrameGraphBackend(&Backend, &NullBackend);
+		frame_graph *Graph = new frame_graph;
+		renderer_frame_graph Renderer;
+		InitializeFrameGraph(Graph, &Backend);
+		DeclareRendererFrameGraph(Graph, &Renderer, 960, 540, (void *)1, BenchRSMHistory, BenchLightMaps, BenchShadowMomentsTexture, true);
+
+		uint32_t DebugNormalsPass = AddFrameGraphPass(Graph, "DebugNormals");
+		uint32_t DebugNormals = CreateFrameGraphTexture(Graph, "DebugNormals", TextureDesc(960, 540, TextureFormat_RGBA8, TextureBind_RenderTarget | TextureBind_ShaderResource));
+		FrameGraphRead(Graph, DebugNormalsPass, Renderer.Normals);
+		FrameGraphWrite(Graph, DebugNormalsPass, DebugNormals);
+
+		uint32_t DebugComposePass = AddFrameGraphPass(Graph, "DebugCompose");
+		uint32_t DebugOutput = CreateFrameGraphTexture(Graph, "DebugOutput", TextureDesc(960, 540, TextureFormat_RGBA8, TextureBind_RenderTarget));
+		FrameGraphRead(Graph, DebugComposePass, DebugNormals);
+		FrameGraphWrite(Graph, DebugComposePass, DebugOutput);
+
+		CompileFrameGraph(Graph);
+
+		printf("framegraph: renderer with an unused debug chain\n");
+		PrintFrameGraph(Graph);
+
+		Assert(!IsFrameGraphPassActive(Graph, DebugNormalsPass));
+		Assert(!IsFrameGraphPassActive(Graph, DebugComposePass));
+		Assert(IsFrameGraphPassActive(Graph, Renderer.GBufferPass));
+		Assert(GetFrameGraphTexture(Graph, DebugNormals) == 0);
+		Assert(GetFrameGraphTexture(Graph, DebugOutput) == 0);
+
+		ReleaseFrameGraphTextures(Graph);
+		delete Graph;
+	}
+
+	// NOTE(georgy): Solver cost, the graph gets recompiled on every resize
+	{
+		InitializeNullFrameGraphBackend(&Backend, &NullBackend);
+		frame_graph *Graph = new frame_graph;
+		renderer_frame_graph Renderer;
+
+		const uint32_t Runs = 100000;
+		real64 Start = GetSeconds();
+		for(uint32_t Run = 0; Run < Runs; Run++)
+		{
+			InitializeFrameGraph(Graph, &Backend);
+			DeclareRendererFrameGraph(Graph, &Renderer, 960, 540, (void *)1, BenchRSMHistory, BenchLightMaps, BenchShadowMomentsTexture, true);
+			CompileFrameGraph(Graph);
+			ReleaseFrameGraphTextures(Graph);
+		}
+		real64 Elapsed = GetSeconds() - Start;
+		printf("framegraph: declare + compile %.2fus\n", 1000000.0*Elapsed / Runs);
+
+		delete Graph;
+	}
+}
+
+//
+// NOTE(georgy): Headless frame
+//
+
+static void
+LinuxDebugOutput(const char *Text)
+{
+	printf("%s", Text);
+}
+
+// NOTE(georgy): bunny.obj isn't in the repo, a UV sphere stands in for it
+static void
+GenerateSphere(std::vector<vertex> &VertexArray, std::vector<uint32_t> &IndexArray, uint32_t Stacks, uint32_t Slices)
+{
+	for(uint32_t Stack = 0; Stack <= Stacks; Stack++)
+	{
+		real32 Phi = PI*(real32)Stack / Stacks;
+		for(uint32_t Slice = 0; Slice <= Slices; Slice++)
+		{
+			real32 Theta = 2.0f*PI*(real32)Slice / Slices;
+
+			vertex Vertex;
+			Vertex.Normal = V3(sinf(Phi)*cosf(Theta), cosf(Phi), sinf(Phi)*sinf(Theta));
+			Vertex.Pos = 0.5f*Vertex.Normal;
+			VertexArray.push_back(Vertex);
+		}
+	}
+
+	for(uint32_t Stack = 0; Stack < Stacks; Stack++)
+	{
+		for(uint32_t Slice = 0; Slice < Slices; Slice++)
+		{
+			uint32_t A = Stack*(Slices + 1) + Slice;
+			uint32_t B = A + Slices + 1;
+			IndexArray.push_back(A); IndexArray.push_back(B); IndexArray.push_back(A + 1);
+			IndexArray.push_back(A + 1); IndexArray.push_back(B); IndexArray.push_back(B + 1);
+		}
+	}
+}
+
+// NOTE(georgy): The whole frame loop from main.cpp (game thread, frame packets, render thread, frame graph)
+// on top of the null graphics backend. Measures CPU cost per frame and what the renderer asks the API to do.
+static void
+BenchFrame(void)
+{
+	const uint32_t FrameCount = 10000;
+	const uint32_t Width = 960, Height = 540;
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GraphicsMemorySize = 16*1024*1024;
+	size_t FrameMemorySize = 1024*1024;
+	size_t GameMemorySize = 2*1024*1024;
+	size_t TotalMemorySize = GraphicsMemorySize + FRAME_ARENA_COUNT*FrameMemorySize + GameMemorySize;
+	void *Memory = malloc(TotalMemorySize);
+	memory_arena PermanentArena;
+	InitializeArena(&PermanentArena, TotalMemorySize, Memory);
+	memory_arena GraphicsArena;
+	SubArena(&GraphicsArena, &PermanentArena, GraphicsMemorySize);
+	frame_arenas FrameArenas;
+	InitializeFrameArenas(&FrameArenas, &PermanentArena, FrameMemorySize);
+	memory_arena GameArena;
+	SubArena(&GameArena, &PermanentArena, GameMemorySize);
+
+	null_graphics NullGraphics;
+	graphics_device GraphicsDevice;
+	graphics_context GraphicsContext;
+	InitializeNullGraphics(&NullGraphics, &GraphicsArena, &GraphicsDevice, &GraphicsContext);
+
+	texture_desc BackBufferDesc = TextureDesc(Width, Height, TextureFormat_RGBA8, TextureBind_RenderTarget);
+	gfx_texture *BackBuffer = GraphicsDevice.CreateTexture(&GraphicsDevice, &BackBufferDesc, "BackBuffer");
+
+	renderer *Renderer = &GlobalRenderer;
+	InitializeRenderer(Renderer, &GraphicsDevice, Width, Height, BackBuffer, RendererQuality_High);
+
+	std::vector<vertex> SphereVertexArray;
+	std::vector<uint32_t> SphereIndexArray;
+	GenerateSphere(SphereVertexArray, SphereIndexArray, 32, 64);
+	mesh SphereMesh = {0, (uint32_t)SphereIndexArray.size(), 0};
+	Renderer->BunnyModel.Meshes.push_back(SphereMesh);
+	UploadModel(&GraphicsDevice, &Renderer->BunnyModel, &SphereVertexArray[0], (uint32_t)SphereVertexArray.size(), &SphereIndexArray[0]);
+
+	game_state GameState;
+	InitializeGame(&GameState, Width, Height, &GameArena);
+
+	frame_packet_queue *Queue = new frame_packet_queue;
+	InitializeQueue(Queue);
+	std::thread RenderThread([&]()
+	{
+		RegisterJobSystemThread(&GlobalJobSystem);
+		RunRenderer(Renderer, &GraphicsContext, Queue);
+	});
+
+	real64 Start = GetSeconds();
+	game_input GameInput = {};
+	for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+	{
+		alloc_scope FrameScope(AllocTag_Frame, 0, 0);
+
+		// NOTE(georgy): Scripted input: walk forward for a while, then look around
+		GameInput.MoveForward.EndedDown = (FrameIndex < FrameCount/4);
+		GameInput.DeltaMouseX = (FrameIndex >= FrameCount/4) ? 1 : 0;
+		GameInput.DeltaMouseY = 0;
+		UpdateGame(&GameState, &GameInput, 0.0001f);
+
+		frame_packet *Packet;
+		while(!(Packet = BeginPush(Queue)))
+		{
+			std::this_thread::yield();
+		}
+
+		memory_arena *FrameArena = BeginFrameArena(&FrameArenas);
+		FillFramePacket(&GameState, Packet, FrameArena);
+
+		EndPush(Queue);
+
+		AllocTrackerEndFrame();
+	}
+
+	frame_packet *QuitPacket;
+	while(!(QuitPacket = BeginPush(Queue)))
+	{
+		std::this_thread::yield();
+	}
+	QuitPacket->Quit = true;
+	EndPush(Queue);
+
+	RenderThread.join();
+	real64 Elapsed = GetSeconds() - Start;
+
+	// NOTE(georgy): Picking only happens on a click, then it's whatever the cursor ray hits
+	Assert(GameState.PickedObject == SCENE_NO_PARENT);
+	GameInput.Pick.EndedDown = true;
+	GameInput.Pick.HalfTransitionCount = 1;
+	UpdateGame(&GameState, &GameInput, 0.0001f);
+	v3 PickOrigin, PickDirection;
+	GetCursorRay(&GameState, &GameInput, &PickOrigin, &PickDirection);
+	uint32_t ExpectedTriangle;
+	Assert(GameState.PickedObject == PickSceneObject(&GameState, PickOrigin, PickDirection, GAME_PICK_DISTANCE, &ExpectedTriangle));
+	Assert(GameState.PickedTriangle == ExpectedTriangle);
+
+	uint64_t TotalCalls = 0;
+	for(uint32_t Call = 0; Call < GraphicsCall_Count; Call++)
+	{
+		TotalCalls += NullGraphics.CallCounts[Call];
+	}
+	Assert(NullGraphics.CallCounts[GraphicsCall_Present] == FrameCount);
+
+	printf("frame: %u frames, %.2fus/frame, %.1f API calls/frame, %.0f indices and %.0f vertices/frame\n",
+		   FrameCount, 1000000.0*Elapsed / FrameCount, (real64)TotalCalls / FrameCount,
+		   (real64)NullGraphics.IndexCount / FrameCount, (real64)NullGraphics.VertexCount / FrameCount);
+	for(uint32_t Call = 0; Call < GraphicsCall_Count; Call++)
+	{
+		printf("frame:   %-24s %6.1f/frame\n", GraphicsCallNames[Call], (real64)NullGraphics.CallCounts[Call] / FrameCount);
+	}
+
+	delete Queue;
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Instancing
+//
+
+// NOTE(georgy): Thousands of props with the meshes mixed up in the packet. They have to end up as a few
+// instanced draws per pass (one per mesh and depth bucket at most), with every instance in the batch of its own mesh.
+static void
+BenchInstancing(void)
+{
+	const uint32_t FrameCount = 1000;
+	const uint32_t ObjectCount = 4000;
+	static_assert(ObjectCount < MAX_FRAME_PACKET_OBJECTS, "Props have to fit in a frame packet");
+	const uint32_t Width = 960, Height = 540;
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GraphicsMemorySize = 16*1024*1024;
+	size_t FrameMemorySize = MAX_FRAME_PACKET_OBJECTS*sizeof(render_object) + 64*1024;
+	size_t GameMemorySize = 2*1024*1024;
+	size_t TotalMemorySize = GraphicsMemorySize + FrameMemorySize + GameMemorySize;
+	void *Memory = malloc(TotalMemorySize);
+	memory_arena PermanentArena;
+	InitializeArena(&PermanentArena, TotalMemorySize, Memory);
+	memory_arena GraphicsArena, FrameArena;
+	SubArena(&GraphicsArena, &PermanentArena, GraphicsMemorySize);
+	SubArena(&FrameArena, &PermanentArena, FrameMemorySize);
+	memory_arena GameArena;
+	SubArena(&GameArena, &PermanentArena, GameMemorySize);
+
+	null_graphics NullGraphics;
+	graphics_device GraphicsDevice;
+	graphics_context GraphicsContext;
+	InitializeNullGraphics(&NullGraphics, &GraphicsArena, &GraphicsDevice, &GraphicsContext);
+
+	texture_desc BackBufferDesc = TextureDesc(Width, Height, TextureFormat_RGBA8, TextureBind_RenderTarget);
+	gfx_texture *BackBuffer = GraphicsDevice.CreateTexture(&GraphicsDevice, &BackBufferDesc, "BackBuffer");
+
+	// NOTE(georgy): Low tier, without the depth prepass every batch is drawn exactly once
+	renderer *Renderer = &GlobalRenderer;
+	InitializeRenderer(Renderer, &GraphicsDevice, Width, Height, BackBuffer, RendererQuality_Low);
+
+	std::vector<vertex> SphereVertexArray;
+	std::vector<uint32_t> SphereIndexArray;
+	GenerateSphere(SphereVertexArray, SphereIndexArray, 8, 16);
+	mesh SphereMesh = {0, (uint32_t)SphereIndexArray.size(), 0};
+	Renderer->BunnyModel.Meshes.clear();
+	Renderer->BunnyModel.Meshes.push_back(SphereMesh);
+	UploadModel(&GraphicsDevice, &Renderer->BunnyModel, &SphereVertexArray[0], (uint32_t)SphereVertexArray.size(), &SphereIndexArray[0]);
+
+	game_state GameState;
+	InitializeGame(&GameState, Width, Height, &GameArena);
+
+	frame_packet Packet;
+	real64 RenderSeconds = 0.0;
+	uint64_t BatchCount = 0;
+	uint64_t ViewVisibleCounts[MAX_RENDER_VIEWS] = {};
+	std::vector<bool> Seen, Visible;
+	for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+	{
+		ResetArena(&FrameArena);
+		FillFramePacket(&GameState, &Packet, &FrameArena);
+		Packet.ObjectCount = 0;
+		for(uint32_t ObjectIndex = 0; ObjectIndex < ObjectCount; ObjectIndex++)
+		{
+			// NOTE(georgy): Every third object is a sphere, the color says which mesh it is and where it was in the packet.
+			// They're dynamic, so the light views draw them every frame instead of keeping them in their caches.
+			render_mesh Mesh = ((ObjectIndex % 3) == 0) ? RenderMesh_Bunny : RenderMesh_Quad;
+			v3 Position = V3((real32)(ObjectIndex % 64) - 32.0f, 0.0f, (real32)(ObjectIndex / 64) - 8.0f);
+			v3 BoundsExtent = (Mesh == RenderMesh_Bunny) ? V3(0.5f, 0.5f, 0.5f) : V3(1.0f, 1.0f, 0.0f);
+			PushRenderObject(&Packet, Mesh, Translate(Position), V3((real32)Mesh, (real32)ObjectIndex, 0.0f), Position, BoundsExtent, true);
+		}
+
+		real64 Start = GetSeconds();
+		RenderScenePasses(Renderer, &GraphicsContext, &Packet);
+		RenderPostPasses(Renderer, &GraphicsContext);
+		RenderSeconds += GetSeconds() - Start;
+
+		// NOTE(georgy): Every visible object once per view, every instance in a batch of its own mesh,
+		// and front to back (by depth bucket) inside a batch
+		Assert(Renderer->BatchCount <= Packet.ViewCount*RenderMesh_Count*RENDERER_DEPTH_BUCKET_COUNT);
+		BatchCount += Renderer->BatchCount;
+		instance_data *Instances = (instance_data *)(((null_buffer *)Renderer->InstanceRing.Buffer)->Memory + Renderer->Instances.Offset);
+		for(uint32_t View = 0; View < Packet.ViewCount; View++)
+		{
+			mat4 *ViewMatrix = &Packet.Views[View].View;
+			mat4 ViewProjection = Packet.Views[View].View * Packet.Views[View].Projection;
+
+			// NOTE(georgy): Reference culling: an object is culled if all 8 corners of its box are outside the same clip plane
+			Visible.assign(ObjectCount, false);
+			real32 MinDepth = FLT_MAX, MaxDepth = -FLT_MAX;
+			uint32_t VisibleCount = 0;
+			for(uint32_t ObjectIndex = 0; ObjectIndex < ObjectCount; ObjectIndex++)
+			{
+				render_object *Object = Packet.Objects + ObjectIndex;
+				uint32_t OutsideAll = 0x3F;
+				for(uint32_t Corner = 0; Corner < 8; Corner++)
+				{
+					v3 C = Object->BoundsCenter, E = Object->BoundsExtent;
+					v4 P = V4(C.x + ((Corner & 1) ? E.x : -E.x), C.y + ((Corner & 2) ? E.y : -E.y), C.z + ((Corner & 4) ? E.z : -E.z), 1.0f) * ViewProjection;
+					uint32_t Outside = ((P.x < -P.w) ? 1 : 0) | ((P.x > P.w) ? 2 : 0) | ((P.y < -P.w) ? 4 : 0) |
+									   ((P.y > P.w) ? 8 : 0) | ((P.z < 0.0f) ? 16 : 0) | ((P.z > P.w) ? 32 : 0);
+					OutsideAll &= Outside;
+				}
+				if(!OutsideAll)
+				{
+					Visible[ObjectIndex] = true;
+					VisibleCount++;
+					real32 Depth = GetViewDepth(ViewMatrix, &Object->Model);
+					MinDepth = (Depth < MinDepth) ? Depth : MinDepth;
+					MaxDepth = (Depth > MaxDepth) ? Depth : MaxDepth;
+				}
+			}
+			Assert(Renderer->ViewVisibleCounts[View] == VisibleCount);
+			Assert((VisibleCount > 0) && (VisibleCount < ObjectCount));
+			ViewVisibleCounts[View] += VisibleCount;
+
+			Seen.assign(ObjectCount, false);
+			for(uint32_t BatchIndex = Renderer->ViewFirstBatch[View]; BatchIndex < Renderer->ViewFirstBatch[View + 1]; BatchIndex++)
+			{
+				instance_batch *Batch = Renderer->Batches + BatchIndex;
+				Assert(Batch->View == View);
+				uint32_t LastDepthBucket = 0;
+				for(uint32_t InstanceIndex = Batch->FirstInstance; InstanceIndex < Batch->FirstInstance + Batch->InstanceCount; InstanceIndex++)
+				{
+					instance_data *Instance = Instances + InstanceIndex;
+					uint32_t ObjectIndex = (uint32_t)Instance->Color.y;
+					Assert(Instance->Color.x == (real32)Batch->Mesh);
+					Assert(Visible[ObjectIndex] && !Seen[ObjectIndex]);
+					Seen[ObjectIndex] = true;
+
+					uint32_t DepthBucket = QuantizeDrawDepth(GetViewDepth(ViewMatrix, &Instance->Model), MinDepth, MaxDepth, RENDERER_DEPTH_BUCKET_COUNT);
+					Assert(DepthBucket >= LastDepthBucket);
+					LastDepthBucket = DepthBucket;
+				}
+			}
+			Assert(Seen == Visible);
+		}
+	}
+
+	uint64_t TotalCalls = 0;
+	for(uint32_t Call = 0; Call < GraphicsCall_Count; Call++)
+	{
+		TotalCalls += NullGraphics.CallCounts[Call];
+	}
+	// NOTE(georgy): Both meshes have one part, so one instanced draw per batch
+	uint64_t VisibleCount = 0;
+	uint64_t CascadeVisibleCount = 0;
+	for(uint32_t View = 0; View < Packet.ViewCount; View++)
+	{
+		VisibleCount += ViewVisibleCounts[View];
+		CascadeVisibleCount += (Packet.Views[View].Pass == RenderPass_ShadowCascade) ? ViewVisibleCounts[View] : 0;
+	}
+	Assert(NullGraphics.CallCounts[GraphicsCall_DrawIndexedInstanced] == BatchCount);
+	Assert(NullGraphics.InstanceCount == VisibleCount);
+	Assert(Renderer->InstanceRing.FailedAllocationCount == 0);
+
+	printf("instancing: %u objects, %u frames, %.2fus/frame to cull and submit, %.1f API calls/frame, %.1f instanced draws/frame, %.0f instances/frame\n",
+		   ObjectCount, FrameCount, 1000000.0*RenderSeconds / FrameCount, (real64)TotalCalls / FrameCount,
+		   (real64)NullGraphics.CallCounts[GraphicsCall_DrawIndexedInstanced] / FrameCount, (real64)NullGraphics.InstanceCount / FrameCount);
+	printf("instancing: %.0f visible in the light view, %.0f in the shadow cascades, %.0f in the camera view\n",
+		   (real64)ViewVisibleCounts[0] / FrameCount, (real64)CascadeVisibleCount / FrameCount, (real64)ViewVisibleCounts[Packet.ViewCount - 1] / FrameCount);
+
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Draw list sort
+//
+
+inline bool
+DrawItemKeyLess(const draw_item &A, const draw_item &B)
+{
+	bool Result = (A.Key < B.Key);
+	return(Result);
+}
+
+// NOTE(georgy): 1M draws with keys spread like a big scene would have them. Checks that the radix sort is
+// ordered, stable and a permutation, and compares it with std::stable_sort and with itself on one thread.
+static void
+BenchDrawSort(void)
+{
+	const uint32_t DrawCount = 1024*1024;
+	const uint32_t RunCount = 10;
+
+	size_t MemorySize = 4*DrawCount*sizeof(draw_item);
+	void *Memory = malloc(MemorySize);
+	memory_arena Arena;
+	InitializeArena(&Arena, MemorySize, Memory);
+	draw_item *Unsorted = PushArray(&Arena, DrawCount, draw_item);
+	draw_item *Reference = PushArray(&Arena, DrawCount, draw_item);
+	draw_item *Items = PushArray(&Arena, DrawCount, draw_item);
+	draw_item *SortBuffer = PushArray(&Arena, DrawCount, draw_item);
+
+	uint32_t RandomState = 0x12345678;
+	for(uint32_t DrawIndex = 0; DrawIndex < DrawCount; DrawIndex++)
+	{
+		uint32_t Random[5];
+		for(uint32_t I = 0; I < ArrayCount(Random); I++)
+		{
+			RandomState ^= RandomState << 13;
+			RandomState ^= RandomState >> 17;
+			RandomState ^= RandomState << 5;
+			Random[I] = RandomState;
+		}
+
+		// NOTE(georgy): 2 passes, 16 shaders, 512 materials, all depth buckets, 4096 meshes
+		Unsorted[DrawIndex].Key = DrawKey(Random[0] % 2, 0, Random[1] % 16, Random[2] % 512, Random[3] & 0xFFFF, Random[4] % 4096);
+		Unsorted[DrawIndex].Index = DrawIndex;
+	}
+
+	memcpy(Reference, Unsorted, DrawCount*sizeof(draw_item));
+	real64 Start = GetSeconds();
+	std::stable_sort(Reference, Reference + DrawCount, DrawItemKeyLess);
+	real64 StdSortTime = GetSeconds() - Start;
+
+	// NOTE(georgy): ParallelFor runs everything on the calling thread when there are no workers
+	job_system SingleThread = {};
+	SingleThread.WorkerThreadCount = 0;
+
+	real64 SerialTime = 0.0, ParallelTime = 0.0;
+	uint32_t PassCount = 0;
+	for(uint32_t Run = 0; Run < 2*RunCount; Run++)
+	{
+		bool Parallel = (Run % 2) != 0;
+
+		draw_list List;
+		InitializeDrawList(&List, Items, SortBuffer, DrawCount);
+		memcpy(List.Items, Unsorted, DrawCount*sizeof(draw_item));
+		List.Count = DrawCount;
+
+		Start = GetSeconds();
+		PassCount = SortDrawList(&List, Parallel ? &GlobalJobSystem : &SingleThread);
+		real64 Elapsed = GetSeconds() - Start;
+		*(Parallel ? &ParallelTime : &SerialTime) += Elapsed;
+
+		// NOTE(georgy): Stable sort of the same input has exactly one answer
+		Assert(!memcmp(List.Items, Reference, DrawCount*sizeof(draw_item)));
+	}
+	SerialTime /= RunCount;
+	ParallelTime /= RunCount;
+
+	// NOTE(georgy): Keys where the top bytes never change (one pass, one shader) skip those radix passes
+	draw_list List;
+	InitializeDrawList(&List, Items, SortBuffer, DrawCount);
+	for(uint32_t DrawIndex = 0; DrawIndex < DrawCount; DrawIndex++)
+	{
+		PushDraw(&List, DrawKey(0, 0, 0, 0, Unsorted[DrawIndex].Key & 0xFFFF, 0), DrawIndex);
+	}
+	Start = GetSeconds();
+	uint32_t NarrowPassCount = SortDrawList(&List, &GlobalJobSystem);
+	real64 NarrowTime = GetSeconds() - Start;
+	for(uint32_t DrawIndex = 1; DrawIndex < DrawCount; DrawIndex++)
+	{
+		Assert((List.Items[DrawIndex - 1].Key < List.Items[DrawIndex].Key) ||
+			   ((List.Items[DrawIndex - 1].Key == List.Items[DrawIndex].Key) && (List.Items[DrawIndex - 1].Index < List.Items[DrawIndex].Index)));
+	}
+
+	printf("drawsort: %u draws, std::stable_sort %.2fms, radix %u passes %.2fms on 1 thread, %.2fms on %u threads (%.1fx)\n",
+		   DrawCount, 1000.0*StdSortTime, PassCount, 1000.0*SerialTime, 1000.0*ParallelTime,
+		   GlobalJobSystem.WorkerThreadCount + 1, SerialTime / ParallelTime);
+	printf("drawsort: depth only keys, %u passes %.2fms\n", NarrowPassCount, 1000.0*NarrowTime);
+
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Command capture and replay
+//
+
+// NOTE(georgy): Records a few frames of the renderer, round-trips them through a file and replays them
+// on a fresh null device. Replay is just the submission cost, no game update, no culling, no frame packets.
+static void
+BenchCapture(void)
+{
+	const uint32_t WarmupFrameCount = 4;
+	const uint32_t CaptureFrameCount = 16;
+	const uint32_t ReplayCount = 10000;
+	const uint32_t Width = 960, Height = 540;
+	const char *CaptureFilename = "bench_capture.gcap";
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GraphicsMemorySize = 16*1024*1024;
+	size_t CaptureMemorySize = 32*1024*1024;
+	size_t FrameMemorySize = 1024*1024;
+	size_t GameMemorySize = 2*1024*1024;
+	size_t TotalMemorySize = 2*GraphicsMemorySize + 2*CaptureMemorySize + FrameMemorySize + GameMemorySize;
+	void *Memory = malloc(TotalMemorySize);
+	memory_arena PermanentArena;
+	InitializeArena(&PermanentArena, TotalMemorySize, Memory);
+	memory_arena GraphicsArena, CaptureArena, ReplayGraphicsArena, ReplayArena, FrameArena;
+	SubArena(&GraphicsArena, &PermanentArena, GraphicsMemorySize);
+	SubArena(&CaptureArena, &PermanentArena, CaptureMemorySize);
+	SubArena(&ReplayGraphicsArena, &PermanentArena, GraphicsMemorySize);
+	SubArena(&ReplayArena, &PermanentArena, CaptureMemorySize);
+	SubArena(&FrameArena, &PermanentArena, FrameMemorySize);
+	memory_arena GameArena;
+	SubArena(&GameArena, &PermanentArena, GameMemorySize);
+
+	null_graphics NullGraphics;
+	graphics_device NullDevice;
+	graphics_context NullContext;
+	InitializeNullGraphics(&NullGraphics, &GraphicsArena, &NullDevice, &NullContext);
+
+	command_recorder Recorder;
+	graphics_device GraphicsDevice;
+	graphics_context GraphicsContext;
+	InitializeCommandRecorder(&Recorder, &CaptureArena, 4*1024*1024, &NullDevice, &NullContext,
+							  &GraphicsDevice, &GraphicsContext, WarmupFrameCount, CaptureFrameCount);
+
+	texture_desc BackBufferDesc = TextureDesc(Width, Height, TextureFormat_RGBA8, TextureBind_RenderTarget);
+	gfx_texture *BackBuffer = CaptureImportTexture(&Recorder, NullDevice.CreateTexture(&NullDevice, &BackBufferDesc, "BackBuffer"), &BackBufferDesc);
+
+	renderer *Renderer = &GlobalRenderer;
+	InitializeRenderer(Renderer, &GraphicsDevice, Width, Height, BackBuffer, RendererQuality_High);
+
+	std::vector<vertex> SphereVertexArray;
+	std::vector<uint32_t> SphereIndexArray;
+	GenerateSphere(SphereVertexArray, SphereIndexArray, 32, 64);
+	mesh SphereMesh = {0, (uint32_t)SphereIndexArray.size(), 0};
+	Renderer->BunnyModel.Meshes.clear();
+	Renderer->BunnyModel.Meshes.push_back(SphereMesh);
+	UploadModel(&GraphicsDevice, &Renderer->BunnyModel, &SphereVertexArray[0], (uint32_t)SphereVertexArray.size(), &SphereIndexArray[0]);
+
+	game_state GameState;
+	InitializeGame(&GameState, Width, Height, &GameArena);
+
+	// NOTE(georgy): Game and renderer on one thread, the queue only hands the packet over
+	frame_packet_queue *Queue = new frame_packet_queue;
+	InitializeQueue(Queue);
+	game_input GameInput = {};
+	for(uint32_t FrameIndex = 0; FrameIndex < WarmupFrameCount + CaptureFrameCount; FrameIndex++)
+	{
+		GameInput.DeltaMouseX = 1;
+		UpdateGame(&GameState, &GameInput, 0.0001f);
+
+		frame_packet *Packet = BeginPush(Queue);
+		ResetArena(&FrameArena);
+		FillFramePacket(&GameState, Packet, &FrameArena);
+		EndPush(Queue);
+
+		Packet = BeginPop(Queue);
+		RenderScenePasses(Renderer, &GraphicsContext, Packet);
+		EndPop(Queue);
+		RenderPostPasses(Renderer, &GraphicsContext);
+	}
+	delete Queue;
+
+	Assert(!Recorder.Resources.Overflowed && !Recorder.Commands.Overflowed);
+	Assert(Recorder.CapturedFrameCount == CaptureFrameCount);
+
+	capture Recorded = GetRecordedCapture(&Recorder);
+	bool Written = WriteCaptureFile(&Recorded, CaptureFilename);
+	Assert(Written);
+
+	capture Capture;
+	bool Read = ReadCaptureFile(&Capture, &ReplayArena, CaptureFilename);
+	Assert(Read);
+	remove(CaptureFilename);
+	Assert((Capture.CommandStreamSize == Recorded.CommandStreamSize) &&
+		   !memcmp(Capture.CommandStream, Recorded.CommandStream, Capture.CommandStreamSize));
+
+	null_graphics ReplayGraphics;
+	graphics_device ReplayDevice;
+	graphics_context ReplayContext;
+	InitializeNullGraphics(&ReplayGraphics, &ReplayGraphicsArena, &ReplayDevice, &ReplayContext);
+
+	capture_replayer Replayer;
+	InitializeCaptureReplayer(&Replayer, &Capture, &ReplayArena, &ReplayDevice);
+	Assert(ReplayGraphics.CreatedObjectCount == Capture.ObjectCount);
+
+	real64 Start = GetSeconds();
+	for(uint32_t ReplayIndex = 0; ReplayIndex < ReplayCount; ReplayIndex++)
+	{
+		ReplayCapture(&Replayer, &ReplayContext);
+	}
+	real64 Elapsed = GetSeconds() - Start;
+
+	capture_stats Stats;
+	AnalyzeCapture(&Capture, &Stats);
+
+	uint64_t TotalCalls = 0, TotalRedundant = 0;
+	for(uint32_t Call = 0; Call < GraphicsCall_Count; Call++)
+	{
+		Assert(ReplayGraphics.CallCounts[Call] == Stats.CallCounts[Call]*ReplayCount);
+		TotalCalls += Stats.CallCounts[Call];
+		TotalRedundant += Stats.RedundantCounts[Call];
+	}
+
+	uint64_t ReplayedFrameCount = (uint64_t)ReplayCount*Capture.FrameCount;
+	printf("capture: %u objects, %u frames, %.0f bytes/frame of commands, %.0f bytes/frame uploaded\n",
+		   Capture.ObjectCount, Capture.FrameCount, (real64)Stats.CommandBytes / Stats.FrameCount, (real64)Stats.UploadBytes / Stats.FrameCount);
+	printf("capture: replay %.2fus/frame, %.1fM calls/s\n",
+		   1000000.0*Elapsed / ReplayedFrameCount, (real64)TotalCalls*ReplayCount / Elapsed / 1000000.0);
+	printf("capture: %.1f calls/frame, %.1f redundant\n",
+		   (real64)TotalCalls / Stats.FrameCount, (real64)TotalRedundant / Stats.FrameCount);
+	for(uint32_t Call = 0; Call < GraphicsCall_Count; Call++)
+	{
+		printf("capture:   %-24s %6.1f/frame %6.1f redundant\n", GraphicsCallNames[Call],
+			   (real64)Stats.CallCounts[Call] / Stats.FrameCount, (real64)Stats.RedundantCounts[Call] / Stats.FrameCount);
+	}
+
+	// NOTE(georgy): Per pass, from the queries the renderer wraps its passes in. Results come back RENDERER_QUERY_LATENCY
+	// frames late, only those of the frames in the capture count, and they're averaged with the draws of the same frames.
+	printf("capture: %u passes\n", Stats.PassCount);
+	for(uint32_t PassIndex = 0; PassIndex < Stats.PassCount; PassIndex++)
+	{
+		capture_pass_stats *Pass = Stats.Passes + PassIndex;
+		real64 ResultCount = Pass->ResultCount ? (real64)Pass->ResultCount : 1.0;
+		printf("capture:   %-16s %5.1f draws/frame %7.1f instances/frame, %5llu results %9.0f primitives %9.0f VS invocations %9.0f PS invocations\n",
+			   Pass->Name, Pass->MeasuredDrawCount / ResultCount, Pass->MeasuredInstanceCount / ResultCount,
+			   (unsigned long long)Pass->ResultCount, Pass->Statistics.IAPrimitives / ResultCount,
+			   Pass->Statistics.VSInvocations / ResultCount, Pass->Statistics.PSInvocations / ResultCount);
+		Assert(Pass->ResultCount == Capture.FrameCount - RENDERER_QUERY_LATENCY);
+
+		// NOTE(georgy): A pass that drew nothing in the frames its results are for can't have done any work
+		if(Pass->MeasuredDrawCount == 0)
+		{
+			Assert((Pass->Statistics.IAPrimitives == 0) && (Pass->Statistics.VSInvocations == 0) && (Pass->Statistics.PSInvocations == 0));
+		}
+	}
+	Assert(Stats.PassCount == Renderer->FrameGraph.PassCount);
+
+	// NOTE(georgy): The prepass draws exactly what the G-buffer pass draws
+	capture_pass_stats *DepthPrepass = Stats.Passes + Renderer->Graph.DepthPrepass;
+	capture_pass_stats *GBufferPass = Stats.Passes + Renderer->Graph.GBufferPass;
+	Assert(!strcmp(DepthPrepass->Name, "DepthPrepass") && !strcmp(GBufferPass->Name, "GBuffer"));
+	Assert((DepthPrepass->DrawCount == GBufferPass->DrawCount) && (DepthPrepass->InstanceCount == GBufferPass->InstanceCount));
+	Assert(DepthPrepass->Statistics.IAPrimitives == GBufferPass->Statistics.IAPrimitives);
+
+	free(Memory);
+}
+
+//
+// NOTE(georgy): State filter
+//
+
+// NOTE(georgy): Mock context: the null backend's counters plus the range every slotted call reached it with
+struct mock_slotted_call
+{
+	uint32_t Slot;
+	uint32_t Count;
+};
+
+global_variable mock_slotted_call MockLastSlottedCall[GraphicsCall_Count];
+
+#define MOCK_SLOTTED_CALL(Name, type) \
+static void \
+Mock##Name(graphics_context *Context, uint32_t Slot, uint32_t Count, type **Handles) \
+{ \
+	GetNullGraphics(Context)->CallCounts[GraphicsCall_##Name]++; \
+	MockLastSlottedCall[GraphicsCall_##Name].Slot = Slot; \
+	MockLastSlottedCall[GraphicsCall_##Name].Count = Count; \
+}
+
+MOCK_SLOTTED_CALL(VSSetConstantBuffers, gfx_buffer)
+MOCK_SLOTTED_CALL(PSSetShaderResources, gfx_texture)
+#undef MOCK_SLOTTED_CALL
+
+static void
+MockIASetVertexBuffers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *Strides, uint32_t *Offsets)
+{
+	GetNullGraphics(Context)->CallCounts[GraphicsCall_IASetVertexBuffers]++;
+	MockLastSlottedCall[GraphicsCall_IASetVertexBuffers].Slot = Slot;
+	MockLastSlottedCall[GraphicsCall_IASetVertexBuffers].Count = Count;
+}
+
+static void
+BenchStateFilter(void)
+{
+	const uint32_t FrameCount = 10000;
+	const uint32_t Width = 960, Height = 540;
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GraphicsMemorySize = 16*1024*1024;
+	size_t FrameMemorySize = 1024*1024;
+	size_t GameMemorySize = 2*1024*1024;
+	size_t TotalMemorySize = 2*GraphicsMemorySize + FrameMemorySize + GameMemorySize;
+	void *Memory = malloc(TotalMemorySize);
+	memory_arena PermanentArena;
+	InitializeArena(&PermanentArena, TotalMemorySize, Memory);
+	memory_arena MockArena, GraphicsArena, FrameArena;
+	SubArena(&MockArena, &PermanentArena, GraphicsMemorySize);
+	SubArena(&GraphicsArena, &PermanentArena, GraphicsMemorySize);
+	SubArena(&FrameArena, &PermanentArena, FrameMemorySize);
+	memory_arena GameArena;
+	SubArena(&GameArena, &PermanentArena, GameMemorySize);
+
+	// NOTE(georgy): What exactly gets through to the mock
+	{
+		null_graphics Mock;
+		graphics_device MockDevice;
+		graphics_context MockContext;
+		InitializeNullGraphics(&Mock, &MockArena, &MockDevice, &MockContext);
+		MockContext.VSSetConstantBuffers = MockVSSetConstantBuffers;
+		MockContext.PSSetShaderResources = MockPSSetShaderResources;
+		MockContext.IASetVertexBuffers = MockIASetVertexBuffers;
+
+		state_filter Filter;
+		graphics_context Context;
+		InitializeStateFilter(&Filter, &MockContext, &Context);
+
+		gfx_buffer_desc ConstantDesc = BufferDesc(64, GfxBufferUsage_Dynamic, GfxBufferBind_Constant);
+		gfx_buffer *BufferA = MockDevice.CreateBuffer(&MockDevice, &ConstantDesc);
+		gfx_buffer *BufferB = MockDevice.CreateBuffer(&MockDevice, &ConstantDesc);
+		texture_desc Desc = TextureDesc(64, 64, TextureFormat_RGBA8, TextureBind_RenderTarget | TextureBind_ShaderResource);
+		gfx_texture *TextureA = MockDevice.CreateTexture(&MockDevice, &Desc, "A");
+		gfx_texture *TextureB = MockDevice.CreateTexture(&MockDevice, &Desc, "B");
+		gfx_texture *TextureC = MockDevice.CreateTexture(&MockDevice, &Desc, "C");
+
+		// NOTE(georgy): Same constant buffer twice
+		Context.VSSetConstantBuffers(&Context, 0, 1, &BufferA);
+		Context.VSSetConstantBuffers(&Context, 0, 1, &BufferA);
+		Assert(Mock.CallCounts[GraphicsCall_VSSetConstantBuffers] == 1);
+		Assert(Filter.Filtered[GraphicsCall_VSSetConstantBuffers] == 1);
+		Context.VSSetConstantBuffers(&Context, 0, 1, &BufferB);
+		Assert(Mock.CallCounts[GraphicsCall_VSSetConstantBuffers] == 2);
+
+		// NOTE(georgy): Only the slot that changed goes through
+		gfx_texture *Textures[3] = {TextureA, TextureB, TextureC};
+		Context.PSSetShaderResources(&Context, 0, 3, Textures);
+		Textures[1] = TextureA;
+		Context.PSSetShaderResources(&Context, 0, 3, Textures);
+		Assert(Mock.CallCounts[GraphicsCall_PSSetShaderResources] == 2);
+		Assert((MockLastSlottedCall[GraphicsCall_PSSetShaderResources].Slot == 1) &&
+			   (MockLastSlottedCall[GraphicsCall_PSSetShaderResources].Count == 1));
+
+		// NOTE(georgy): A shader resource that becomes a render target gets unbound by D3D11, so binding it again must go through
+		Context.OMSetRenderTargets(&Context, 1, &TextureC, 0);
+		Context.OMSetRenderTargets(&Context, 1, &TextureB, 0);
+		Context.PSSetShaderResources(&Context, 2, 1, &TextureC);
+		Assert(Mock.CallCounts[GraphicsCall_PSSetShaderResources] == 3);
+		Assert(Mock.CallCounts[GraphicsCall_OMSetRenderTargets] == 2);
+
+		// NOTE(georgy): ... and one that is bound while it's still a render target gets null instead
+		Context.PSSetShaderResources(&Context, 3, 1, &TextureB);
+		Context.OMSetRenderTargets(&Context, 1, &TextureA, 0);
+		Context.PSSetShaderResources(&Context, 3, 1, &TextureB);
+		Assert(Mock.CallCounts[GraphicsCall_PSSetShaderResources] == 5);
+
+		// NOTE(georgy): Present unbinds the back buffer
+		Context.OMSetRenderTargets(&Context, 1, &TextureA, 0);
+		Assert(Mock.CallCounts[GraphicsCall_OMSetRenderTargets] == 3);
+		Context.Present(&Context);
+		Context.OMSetRenderTargets(&Context, 1, &TextureA, 0);
+		Assert(Mock.CallCounts[GraphicsCall_OMSetRenderTargets] == 4);
+
+		// NOTE(georgy): Same vertex buffer at a different offset is a different binding
+		uint32_t Stride = 12, Offset = 0;
+		Context.IASetVertexBuffers(&Context, 0, 1, &BufferA, &Stride, &Offset);
+		Context.IASetVertexBuffers(&Context, 0, 1, &BufferA, &Stride, &Offset);
+		Offset = 48;
+		Context.IASetVertexBuffers(&Context, 0, 1, &BufferA, &Stride, &Offset);
+		Assert(Mock.CallCounts[GraphicsCall_IASetVertexBuffers] == 2);
+
+		// NOTE(georgy): Null blend factor is the same as all ones
+		real32 Ones[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+		Context.OMSetBlendState(&Context, 0, 0, 0xFFFFFFFF);
+		Context.OMSetBlendState(&Context, 0, Ones, 0xFFFFFFFF);
+		Assert(Mock.CallCounts[GraphicsCall_OMSetBlendState] == 1);
+
+		// NOTE(georgy): Draws always go through, and whatever got issued is exactly what the mock saw
+		Context.Draw(&Context, 3, 0);
+		Context.Draw(&Context, 3, 0);
+		Assert(Mock.CallCounts[GraphicsCall_Draw] == 2);
+		for(uint32_t Call = 0; Call < GraphicsCall_Count; Call++)
+		{
+			Assert(Filter.Issued[Call] == Mock.CallCounts[Call]);
+		}
+
+		printf("statefilter: mock checks passed\n");
+	}
+
+	// NOTE(georgy): The renderer's frame through the filter
+	null_graphics NullGraphics;
+	graphics_device GraphicsDevice;
+	graphics_context NullContext;
+	InitializeNullGraphics(&NullGraphics, &GraphicsArena, &GraphicsDevice, &NullContext);
+
+	state_filter Filter;
+	graphics_context GraphicsContext;
+	InitializeStateFilter(&Filter, &NullContext, &GraphicsContext);
+
+	texture_desc BackBufferDesc = TextureDesc(Width, Height, TextureFormat_RGBA8, TextureBind_RenderTarget);
+	gfx_texture *BackBuffer = GraphicsDevice.CreateTexture(&GraphicsDevice, &BackBufferDesc, "BackBuffer");
+
+	renderer *Renderer = &GlobalRenderer;
+	InitializeRenderer(Renderer, &GraphicsDevice, Width, Height, BackBuffer, RendererQuality_High);
+
+	std::vector<vertex> SphereVertexArray;
+	std::vector<uint32_t> SphereIndexArray;
+	GenerateSphere(SphereVertexArray, SphereIndexArray, 32, 64);
+	mesh SphereMesh = {0, (uint32_t)SphereIndexArray.size(), 0};
+	Renderer->BunnyModel.Meshes.clear();
+	Renderer->BunnyModel.Meshes.push_back(SphereMesh);
+	UploadModel(&GraphicsDevice, &Renderer->BunnyModel, &SphereVertexArray[0], (uint32_t)SphereVertexArray.size(), &SphereIndexArray[0]);
+
+	game_state GameState;
+	InitializeGame(&GameState, Width, Height, &GameArena);
+
+	frame_packet_queue *Queue = new frame_packet_queue;
+	InitializeQueue(Queue);
+	game_input GameInput = {};
+	real64 Start = GetSeconds();
+	for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+	{
+		GameInput.DeltaMouseX = 1;
+		UpdateGame(&GameState, &GameInput, 0.0001f);
+
+		frame_packet *Packet = BeginPush(Queue);
+		ResetArena(&FrameArena);
+		FillFramePacket(&GameState, Packet, &FrameArena);
+		EndPush(Queue);
+
+		Packet = BeginPop(Queue);
+		RenderScenePasses(Renderer, &GraphicsContext, Packet);
+		EndPop(Queue);
+		RenderPostPasses(Renderer, &GraphicsContext);
+	}
+	real64 Elapsed = GetSeconds() - Start;
+	delete Queue;
+
+	uint64_t TotalIssued = 0, TotalFiltered = 0;
+	for(uint32_t Call = 0; Call < GraphicsCall_Count; Call++)
+	{
+		Assert(Filter.Issued[Call] == NullGraphics.CallCounts[Call]);
+		TotalIssued += Filter.Issued[Call];
+		TotalFiltered += Filter.Filtered[Call];
+	}
+
+	printf("statefilter: %u frames, %.2fus/frame, %.1f calls/frame issued, %.1f filtered\n",
+		   FrameCount, 1000000.0*Elapsed / FrameCount, (real64)TotalIssued / FrameCount, (real64)TotalFiltered / FrameCount);
+	for(uint32_t Call = 0; Call < GraphicsCall_Count; Call++)
+	{
+		printf("statefilter:   %-24s %6.1f/frame issued %6.1f filtered\n", GraphicsCallNames[Call],
+			   (real64)Filter.Issued[Call] / FrameCount, (real64)Filter.Filtered[Call] / FrameCount);
+	}
+
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Constant ring
+//
+
+static void
+BenchConstantRing(void)
+{
+	const uint32_t FrameCount = 100000;
+	const uint32_t ObjectsPerFrame = 64;
+	const uint32_t FramesInFlight = 3;
+
+	size_t GraphicsMemorySize = 4*1024*1024;
+	void *Memory = malloc(GraphicsMemorySize);
+	memory_arena GraphicsArena;
+	InitializeArena(&GraphicsArena, GraphicsMemorySize, Memory);
+
+	null_graphics NullGraphics;
+	graphics_device Device;
+	graphics_context Context;
+	InitializeNullGraphics(&NullGraphics, &GraphicsArena, &Device, &Context);
+
+	// NOTE(georgy): Allocations are 256 byte aligned and addressed in 16 byte constants
+	{
+		constant_ring Ring;
+		InitializeConstantRing(&Ring, &Device, 4*GFX_CONSTANT_BUFFER_ALIGNMENT);
+		BeginConstantRingFrame(&Ring, &Context, 0);
+		Assert(NullGraphics.CallCounts[GraphicsCall_Map] == 1);
+		constant_allocation A = PushConstants(&Ring, 80);
+		constant_allocation B = PushConstants(&Ring, 256);
+		constant_allocation C = PushConstants(&Ring, 257);
+		Assert(A.Memory && (A.FirstConstant == 0) && (A.NumConstants == 16));
+		Assert(B.Memory && (B.FirstConstant == 16) && (B.NumConstants == 16));
+		Assert(C.Memory && (C.FirstConstant == 32) && (C.NumConstants == 32));
+		Assert((uint8_t *)B.Memory - (uint8_t *)A.Memory == 256);
+
+		// NOTE(georgy): Full, and nothing retires while the frame is in flight
+		constant_allocation D = PushConstants(&Ring, 16);
+		Assert(!D.Memory && (Ring.FailedAllocationCount == 1));
+		EndConstantRingFrame(&Ring, &Context);
+		BeginConstantRingFrame(&Ring, &Context, 0);
+		D = PushConstants(&Ring, 16);
+		Assert(!D.Memory && (Ring.FailedAllocationCount == 2));
+		EndConstantRingFrame(&Ring, &Context);
+
+		// NOTE(georgy): Frame 0 is done, its space comes back
+		BeginConstantRingFrame(&Ring, &Context, 1);
+		Assert(GetConstantRingUsedSize(&Ring) == 0);
+		D = PushConstants(&Ring, 2*GFX_CONSTANT_BUFFER_ALIGNMENT);
+		Assert(D.Memory && (D.FirstConstant == 0) && (D.NumConstants == 32));
+		constant_allocation E = PushConstants(&Ring, GFX_CONSTANT_BUFFER_ALIGNMENT);
+		Assert(E.Memory && (E.FirstConstant == 32));
+		EndConstantRingFrame(&Ring, &Context);
+
+		// NOTE(georgy): Frame 2 still holds the first half, so the second half is all there is
+		BeginConstantRingFrame(&Ring, &Context, 2);
+		constant_allocation F = PushConstants(&Ring, GFX_CONSTANT_BUFFER_ALIGNMENT);
+		constant_allocation G = PushConstants(&Ring, GFX_CONSTANT_BUFFER_ALIGNMENT);
+		Assert(F.Memory && (F.FirstConstant == 48) && !G.Memory);
+		EndConstantRingFrame(&Ring, &Context);
+		BeginConstantRingFrame(&Ring, &Context, 3);
+		G = PushConstants(&Ring, GFX_CONSTANT_BUFFER_ALIGNMENT);
+		Assert(G.Memory && (G.FirstConstant == 0));
+		constant_allocation H = PushConstants(&Ring, 2*GFX_CONSTANT_BUFFER_ALIGNMENT);
+		Assert(H.Memory && (H.FirstConstant == 16));
+		EndConstantRingFrame(&Ring, &Context);
+
+		// NOTE(georgy): An allocation that doesn't fit before the end of the buffer skips to the start
+		BeginConstantRingFrame(&Ring, &Context, 5);
+		Assert(Ring.WrapCount == 0);
+		constant_allocation I = PushConstants(&Ring, 2*GFX_CONSTANT_BUFFER_ALIGNMENT);
+		Assert(I.Memory && (I.FirstConstant == 0) && (Ring.WrapCount == 1));
+		Assert(GetConstantRingUsedSize(&Ring) == 3*GFX_CONSTANT_BUFFER_ALIGNMENT);
+		EndConstantRingFrame(&Ring, &Context);
+
+		printf("constring: allocation checks passed\n");
+	}
+
+	// NOTE(georgy): Steady state with the GPU FramesInFlight frames behind, the ring has room for FramesInFlight + 1 frames like the renderer's
+	const uint32_t MaxObjectSize = 3*GFX_CONSTANT_BUFFER_ALIGNMENT;
+	constant_ring Ring;
+	InitializeConstantRing(&Ring, &Device, (FramesInFlight + 1)*ObjectsPerFrame*MaxObjectSize + GFX_CONSTANT_BUFFER_ALIGNMENT);
+	uint32_t MapCountBefore = NullGraphics.CallCounts[GraphicsCall_Map];
+	real64 Start = GetSeconds();
+	for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+	{
+		uint64_t CompletedFrameCount = (FrameIndex > FramesInFlight) ? (FrameIndex - FramesInFlight) : 0;
+		BeginConstantRingFrame(&Ring, &Context, CompletedFrameCount);
+		for(uint32_t ObjectIndex = 0; ObjectIndex < ObjectsPerFrame; ObjectIndex++)
+		{
+			// NOTE(georgy): Different sizes, and the ring is one slot bigger, so the frames don't line up with the end of the buffer
+			constant_allocation Allocation = PushConstants(&Ring, MaxObjectSize - 176 - GFX_CONSTANT_BUFFER_ALIGNMENT*((FrameIndex + ObjectIndex*ObjectIndex) % 3));
+			Assert(Allocation.Memory);
+			*(uint32_t *)Allocation.Memory = FrameIndex;
+		}
+		EndConstantRingFrame(&Ring, &Context);
+	}
+	real64 Elapsed = GetSeconds() - Start;
+	Assert(Ring.FailedAllocationCount == 0);
+	Assert(NullGraphics.CallCounts[GraphicsCall_Map] - MapCountBefore == FrameCount);
+
+	printf("constring: %u frames x %u objects, %.1fns/allocation, %u wraps, peak %llu of %u bytes, 0 failed\n",
+		   FrameCount, ObjectsPerFrame, 1000000000.0*Elapsed / (FrameCount*ObjectsPerFrame),
+		   Ring.WrapCount, (unsigned long long)Ring.PeakUsedSize, Ring.Size);
+
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Scene
+//
+
+inline uint32_t
+SceneBenchRandom(uint32_t *State)
+{
+	*State ^= *State << 13;
+	*State ^= *State >> 17;
+	*State ^= *State << 5;
+	return(*State);
+}
+
+inline real32
+SceneBenchRandomUnilateral(uint32_t *State)
+{
+	real32 Result = (SceneBenchRandom(State) & 0xFFFFFF) / (real32)0xFFFFFF;
+	return(Result);
+}
+
+inline bool
+SceneBenchClose(real32 A, real32 B)
+{
+	bool Result = fabsf(A - B) <= 1e-3f*(1.0f + fabsf(B));
+	return(Result);
+}
+
+// NOTE(georgy): Checks the world transforms against the scalar operator* and the world bounds against the 8 transformed corners
+static void
+CheckSceneTransforms(scene *Scene, mat4 *ReferenceWorld)
+{
+	for(uint32_t Object = 0; Object < Scene->Count; Object++)
+	{
+		uint32_t Parent = Scene->Parents[Object];
+		ReferenceWorld[Object] = (Parent == SCENE_NO_PARENT) ? Scene->LocalTransforms[Object] : (Scene->LocalTransforms[Object] * ReferenceWorld[Parent]);
+		for(uint32_t I = 0; I < 16; I++)
+		{
+			Assert(SceneBenchClose(Scene->WorldTransforms[Object].Elements[I], ReferenceWorld[Object].Elements[I]));
+		}
+
+		v3 C = Scene->LocalBoundsCenters[Object];
+		v3 E = Scene->LocalBoundsExtents[Object];
+		v3 Min = V3(FLT_MAX, FLT_MAX, FLT_MAX);
+		v3 Max = V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for(uint32_t Corner = 0; Corner < 8; Corner++)
+		{
+			v4 P = V4(C.x + ((Corner & 1) ? E.x : -E.x), C.y + ((Corner & 2) ? E.y : -E.y), C.z + ((Corner & 4) ? E.z : -E.z), 1.0f);
+			P = P * ReferenceWorld[Object];
+			Min = V3(fminf(Min.x, P.x), fminf(Min.y, P.y), fminf(Min.z, P.z));
+			Max = V3(fmaxf(Max.x, P.x), fmaxf(Max.y, P.y), fmaxf(Max.z, P.z));
+		}
+		scene_bounds *Bounds = &Scene->WorldBounds;
+		Assert(SceneBenchClose(Bounds->CenterX[Object] - Bounds->ExtentX[Object], Min.x) && SceneBenchClose(Bounds->CenterX[Object] + Bounds->ExtentX[Object], Max.x));
+		Assert(SceneBenchClose(Bounds->CenterY[Object] - Bounds->ExtentY[Object], Min.y) && SceneBenchClose(Bounds->CenterY[Object] + Bounds->ExtentY[Object], Max.y));
+		Assert(SceneBenchClose(Bounds->CenterZ[Object] - Bounds->ExtentZ[Object], Min.z) && SceneBenchClose(Bounds->CenterZ[Object] + Bounds->ExtentZ[Object], Max.z));
+	}
+}
+
+static void
+BenchScene(void)
+{
+	const uint32_t ObjectCount = 100000;
+	const uint32_t ObjectsPerRoot = 100;
+	const uint32_t RunCount = 100;
+
+	size_t MemorySize = ObjectCount*(3*sizeof(mat4) + 256);
+	void *Memory = malloc(MemorySize);
+	memory_arena Arena;
+	InitializeArena(&Arena, MemorySize, Memory);
+	scene Scene;
+	InitializeScene(&Scene, &Arena, ObjectCount);
+	mat4 *ReferenceWorld = PushArray(&Arena, ObjectCount, mat4);
+	uint8_t *ReferenceDirty = PushArray(&Arena, ObjectCount, uint8_t);
+
+	// NOTE(georgy): A forest of 1000 trees, every object hangs off a random earlier object of its tree, so depths vary from 1 to ~20
+	uint32_t RandomState = 0x12345678;
+	for(uint32_t Object = 0; Object < ObjectCount; Object++)
+	{
+		uint32_t TreeStart = Object - (Object % ObjectsPerRoot);
+		uint32_t Parent = (Object == TreeStart) ? SCENE_NO_PARENT : (TreeStart + SceneBenchRandom(&RandomState) % (Object - TreeStart));
+		v3 Axis = V3(SceneBenchRandomUnilateral(&RandomState) - 0.5f, SceneBenchRandomUnilateral(&RandomState) - 0.5f, 1.0f);
+		v3 Offset = V3(SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState));
+		mat4 Local = Scale(V3(0.9f, 1.0f, 1.1f)) * Rotate(360.0f*SceneBenchRandomUnilateral(&RandomState), Axis) * Translate(Offset);
+		v3 BoundsExtent = V3(0.1f, 0.2f, 0.3f) + V3(SceneBenchRandomUnilateral(&RandomState), 0.0f, 0.0f);
+		AddSceneObject(&Scene, Parent, Local, Object % 2, V3(1.0f, 1.0f, 1.0f), V3(0.0f, 0.5f, 0.0f), BoundsExtent);
+	}
+
+	// NOTE(georgy): ParallelFor runs everything on the calling thread when there are no workers.
+	// The parallel path is checked with a fixed number of workers, so it runs even on a single core machine.
+	job_system SingleThread = {};
+	SingleThread.WorkerThreadCount = 0;
+	job_system Workers;
+	InitializeJobSystem(&Workers, 3, 0);
+
+	uint32_t ChangedCount = UpdateSceneTransforms(&Scene, &SingleThread);
+	Assert(ChangedCount == ObjectCount);
+	CheckSceneTransforms(&Scene, ReferenceWorld);
+
+	// NOTE(georgy): What the same update costs with the scalar operator*, transforms only
+	real64 Start = GetSeconds();
+	for(uint32_t Object = 0; Object < ObjectCount; Object++)
+	{
+		uint32_t Parent = Scene.Parents[Object];
+		ReferenceWorld[Object] = (Parent == SCENE_NO_PARENT) ? Scene.LocalTransforms[Object] : (Scene.LocalTransforms[Object] * ReferenceWorld[Parent]);
+	}
+	real64 ScalarTime = GetSeconds() - Start;
+
+	// NOTE(georgy): Nothing changed, nothing gets recomputed
+	Start = GetSeconds();
+	for(uint32_t Run = 0; Run < RunCount; Run++)
+	{
+		ChangedCount = UpdateSceneTransforms(&Scene, &SingleThread);
+		Assert(ChangedCount == 0);
+	}
+	real64 CleanTime = (GetSeconds() - Start) / RunCount;
+
+	// NOTE(georgy): Every object dirty
+	real64 SerialTime = 0.0, ParallelTime = 0.0;
+	for(uint32_t Run = 0; Run < 2*RunCount; Run++)
+	{
+		bool Parallel = (Run % 2) != 0;
+		memset(Scene.Dirty, 1, ObjectCount);
+		memset(Scene.WorldTransforms, 0, ObjectCount*sizeof(mat4));
+		Start = GetSeconds();
+		ChangedCount = UpdateSceneTransforms(&Scene, Parallel ? &Workers : &SingleThread);
+		*(Parallel ? &ParallelTime : &SerialTime) += GetSeconds() - Start;
+		Assert(ChangedCount == ObjectCount);
+	}
+	SerialTime /= RunCount;
+	ParallelTime /= RunCount;
+	CheckSceneTransforms(&Scene, ReferenceWorld);
+
+	// NOTE(georgy): 1% of the objects move, their subtrees have to follow and nothing else can change
+	real64 PartialTime = 0.0;
+	uint32_t PartialChangedCount = 0;
+	for(uint32_t Run = 0; Run < RunCount; Run++)
+	{
+		bool Parallel = (Run % 2) != 0;
+		memset(ReferenceDirty, 0, ObjectCount);
+		for(uint32_t I = 0; I < ObjectCount / 100; I++)
+		{
+			uint32_t Object = SceneBenchRandom(&RandomState) % ObjectCount;
+			SetLocalTransform(&Scene, Object, Scene.LocalTransforms[Object] * Translate(V3(0.0f, 0.01f, 0.0f)));
+			ReferenceDirty[Object] = 1;
+		}
+		uint32_t ExpectedCount = 0;
+		for(uint32_t Object = 0; Object < ObjectCount; Object++)
+		{
+			uint32_t Parent = Scene.Parents[Object];
+			ReferenceDirty[Object] |= (Parent != SCENE_NO_PARENT) ? ReferenceDirty[Parent] : 0;
+			ExpectedCount += ReferenceDirty[Object];
+		}
+
+		Start = GetSeconds();
+		ChangedCount = UpdateSceneTransforms(&Scene, Parallel ? &Workers : &SingleThread);
+		PartialTime += GetSeconds() - Start;
+		PartialChangedCount += ChangedCount;
+
+		Assert(ChangedCount == ExpectedCount);
+		for(uint32_t I = 0; I < ChangedCount; I++)
+		{
+			Assert(ReferenceDirty[Scene.ChangedObjects[I]]);
+			Assert((I == 0) || (Scene.ChangedObjects[I - 1] < Scene.ChangedObjects[I]));
+		}
+		CheckSceneTransforms(&Scene, ReferenceWorld);
+	}
+	PartialTime /= RunCount;
+
+	ShutdownJobSystem(&Workers);
+
+	printf("scene: %u objects, full update %.3fms on 1 thread, %.3fms on %u threads, scalar operator* %.3fms\n",
+		   ObjectCount, 1000.0*SerialTime, 1000.0*ParallelTime, Workers.WorkerThreadCount + 1, 1000.0*ScalarTime);
+	printf("scene: 1%% moved -> %.0f changed %.3fms, clean update %.3fms\n",
+		   (real64)PartialChangedCount / RunCount, 1000.0*PartialTime, 1000.0*CleanTime);
+
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Dynamic AABB tree against brute force culling
+//
+
+struct aabb_tree_bench_ray
+{
+	aabb *Boxes;
+};
+
+static real32
+AABBTreeBenchRaycast(uint32_t Object, v3 Origin, v3 Direction, real32 MaxT, void *UserData)
+{
+	aabb_tree_bench_ray *Ray = (aabb_tree_bench_ray *)UserData;
+	v3 InvDirection = V3(1.0f / Direction.x, 1.0f / Direction.y, 1.0f / Direction.z);
+	real32 T;
+	real32 Result = RayIntersectsAABB(Ray->Boxes[Object], Origin, InvDirection, MaxT, &T) ? T : MaxT;
+	return(Result);
+}
+
+static void
+BenchAABBTreeCount(uint32_t ObjectCount)
+{
+	const uint32_t QueryCount = 64;
+	const real32 Margin = 0.1f;
+
+	size_t MemorySize = 2*ObjectCount*sizeof(aabb_tree_node) + ObjectCount*(2*sizeof(aabb) + 3*sizeof(uint32_t) + sizeof(uint8_t)) + 1024;
+	void *Memory = malloc(MemorySize);
+	memory_arena Arena;
+	InitializeArena(&Arena, MemorySize, Memory);
+	aabb_tree Tree;
+	InitializeAABBTree(&Tree, &Arena, ObjectCount, Margin);
+	aabb *Boxes = PushArray(&Arena, ObjectCount, aabb);
+	aabb *FatBoxes = PushArray(&Arena, ObjectCount, aabb);
+	uint32_t *Leaves = PushArray(&Arena, ObjectCount, uint32_t);
+	uint32_t *Found = PushArray(&Arena, ObjectCount, uint32_t);
+	uint32_t *Expected = PushArray(&Arena, ObjectCount, uint32_t);
+	uint8_t *Marked = PushArray(&Arena, ObjectCount, uint8_t, true);
+
+	// NOTE(georgy): Same density for every count, the world grows with the object count
+	real32 WorldSize = 2.0f*cbrtf((real32)ObjectCount);
+	uint32_t RandomState = 0x2468ACE1;
+	for(uint32_t Object = 0; Object < ObjectCount; Object++)
+	{
+		v3 Center = WorldSize*V3(SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState));
+		v3 Extent = V3(0.1f, 0.1f, 0.1f) + 0.5f*V3(SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState));
+		Boxes[Object] = AABBFromCenterExtent(Center, Extent);
+	}
+
+	real64 Start = GetSeconds();
+	for(uint32_t Object = 0; Object < ObjectCount; Object++)
+	{
+		Leaves[Object] = AddAABBTreeObject(&Tree, Object, Boxes[Object]);
+	}
+	real64 BuildTime = GetSeconds() - Start;
+	Assert(Tree.LeafCount == ObjectCount);
+	Assert(Tree.NodeCount == 2*ObjectCount - 1);
+	for(uint32_t Object = 0; Object < ObjectCount; Object++)
+	{
+		FatBoxes[Object] = Tree.Nodes[Leaves[Object]].Box;
+	}
+
+	// NOTE(georgy): Random cameras inside the world looking in random directions, far plane at a quarter of the world
+	real64 TreeFrustumTime = 0.0, BruteFrustumTime = 0.0;
+	uint64_t TreeFrustumCount = 0, BruteFrustumCount = 0;
+	for(uint32_t Query = 0; Query < QueryCount; Query++)
+	{
+		v3 Eye = WorldSize*V3(SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState));
+		v3 Direction = V3(SceneBenchRandomUnilateral(&RandomState) - 0.5f, 0.2f*(SceneBenchRandomUnilateral(&RandomState) - 0.5f), SceneBenchRandomUnilateral(&RandomState) - 0.5f);
+		frustum Frustum = MakeFrustum(LookAt(Eye, Eye + Direction) * Perspective(45.0f, 16.0f / 9.0f, 0.1f, 0.25f*WorldSize));
+
+		Start = GetSeconds();
+		uint32_t FoundCount = QueryAABBTreeFrustum(&Tree, &Frustum, Found, ObjectCount);
+		TreeFrustumTime += GetSeconds() - Start;
+
+		Start = GetSeconds();
+		uint32_t ExpectedCount = 0;
+		for(uint32_t Object = 0; Object < ObjectCount; Object++)
+		{
+			aabb Box = Boxes[Object];
+			Expected[ExpectedCount] = Object;
+			ExpectedCount += IsBoxInFrustum(&Frustum, 0.5f*(Box.Min + Box.Max), 0.5f*(Box.Max - Box.Min));
+		}
+		BruteFrustumTime += GetSeconds() - Start;
+
+		// NOTE(georgy): The tree finds everything brute force does, and only objects whose fat box touches the frustum
+		for(uint32_t I = 0; I < FoundCount; I++)
+		{
+			aabb Box = FatBoxes[Found[I]];
+			Assert(!Marked[Found[I]]);
+			Assert(IsBoxInFrustum(&Frustum, 0.5f*(Box.Min + Box.Max), 0.5f*(Box.Max - Box.Min) + V3(1e-3f, 1e-3f, 1e-3f)));
+			Marked[Found[I]] = 1;
+		}
+		for(uint32_t I = 0; I < ExpectedCount; I++)
+		{
+			Assert(Marked[Expected[I]]);
+		}
+		for(uint32_t I = 0; I < FoundCount; I++)
+		{
+			Marked[Found[I]] = 0;
+		}
+
+		TreeFrustumCount += FoundCount;
+		BruteFrustumCount += ExpectedCount;
+	}
+
+	// NOTE(georgy): Spheres match brute force over the fat boxes exactly, a parent always contains its children
+	real64 TreeSphereTime = 0.0, BruteSphereTime = 0.0;
+	uint64_t SphereCount = 0;
+	for(uint32_t Query = 0; Query < QueryCount; Query++)
+	{
+		v3 Center = WorldSize*V3(SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState));
+		real32 Radius = 5.0f;
+
+		Start = GetSeconds();
+		uint32_t FoundCount = QueryAABBTreeSphere(&Tree, Center, Radius, Found, ObjectCount);
+		TreeSphereTime += GetSeconds() - Start;
+
+		Start = GetSeconds();
+		uint32_t ExpectedCount = 0;
+		for(uint32_t Object = 0; Object < ObjectCount; Object++)
+		{
+			Expected[ExpectedCount] = Object;
+			ExpectedCount += SphereIntersectsAABB(FatBoxes[Object], Center, Radius);
+		}
+		BruteSphereTime += GetSeconds() - Start;
+
+		Assert(FoundCount == ExpectedCount);
+		std::sort(Found, Found + FoundCount);
+		Assert(memcmp(Found, Expected, FoundCount*sizeof(uint32_t)) == 0);
+		SphereCount += FoundCount;
+	}
+
+	// NOTE(georgy): Rays hit the tight boxes through the callback, the closest hit has to be the same as brute force
+	aabb_tree_bench_ray Ray = {Boxes};
+	real64 TreeRayTime = 0.0, BruteRayTime = 0.0;
+	uint32_t RayHitCount = 0;
+	for(uint32_t Query = 0; Query < QueryCount; Query++)
+	{
+		v3 Origin = WorldSize*V3(SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState));
+		v3 Direction = Normalize(V3(SceneBenchRandomUnilateral(&RandomState) - 0.5f, SceneBenchRandomUnilateral(&RandomState) - 0.5f, SceneBenchRandomUnilateral(&RandomState) - 0.5f));
+		real32 MaxT = WorldSize;
+
+		Start = GetSeconds();
+		real32 HitT;
+		uint32_t Hit = RaycastAABBTree(&Tree, Origin, Direction, MaxT, AABBTreeBenchRaycast, &Ray, &HitT);
+		TreeRayTime += GetSeconds() - Start;
+
+		Start = GetSeconds();
+		uint32_t ExpectedHit = AABB_TREE_NULL_NODE;
+		real32 ExpectedT = MaxT;
+		for(uint32_t Object = 0; Object < ObjectCount; Object++)
+		{
+			real32 T = AABBTreeBenchRaycast(Object, Origin, Direction, ExpectedT, &Ray);
+			if(T < ExpectedT)
+			{
+				ExpectedT = T;
+				ExpectedHit = Object;
+			}
+		}
+		BruteRayTime += GetSeconds() - Start;
+
+		Assert((Hit == ExpectedHit) || (HitT == ExpectedT));
+		RayHitCount += (Hit != AABB_TREE_NULL_NODE);
+	}
+
+	// NOTE(georgy): The same 10% of the objects move every frame, only the ones that leave their fat boxes get reinserted
+	uint32_t MovedCount = ObjectCount / 10;
+	uint32_t FrameCount = 10;
+	uint32_t ReinsertCount = 0;
+	uint64_t RotationsBefore = Tree.RotationCount;
+	Start = GetSeconds();
+	for(uint32_t Frame = 0; Frame < FrameCount; Frame++)
+	{
+		for(uint32_t I = 0; I < MovedCount; I++)
+		{
+			uint32_t Object = I*10;
+			v3 Offset = 0.05f*V3(SceneBenchRandomUnilateral(&RandomState) - 0.5f, SceneBenchRandomUnilateral(&RandomState) - 0.5f, 1.0f);
+			Boxes[Object].Min += Offset;
+			Boxes[Object].Max += Offset;
+			ReinsertCount += MoveAABBTreeObject(&Tree, Leaves[Object], Boxes[Object]);
+		}
+	}
+	real64 MoveTime = (GetSeconds() - Start) / FrameCount;
+	uint64_t MoveRotationCount = Tree.RotationCount - RotationsBefore;
+	for(uint32_t Object = 0; Object < ObjectCount; Object++)
+	{
+		Assert(Contains(Tree.Nodes[Leaves[Object]].Box, Boxes[Object]));
+		Assert(Tree.Nodes[Leaves[Object]].Object == Object);
+	}
+
+	// NOTE(georgy): Removing half and adding them back leaves the pool exactly as full as before
+	for(uint32_t Object = 0; Object < ObjectCount; Object += 2)
+	{
+		RemoveAABBTreeObject(&Tree, Leaves[Object]);
+	}
+	Assert(Tree.LeafCount == ObjectCount - (ObjectCount + 1) / 2);
+	for(uint32_t Object = 0; Object < ObjectCount; Object += 2)
+	{
+		Leaves[Object] = AddAABBTreeObject(&Tree, Object, Boxes[Object]);
+	}
+	Assert(Tree.NodeCount == 2*ObjectCount - 1);
+	uint32_t SphereCheckCount = QueryAABBTreeSphere(&Tree, V3(0.0f, 0.0f, 0.0f), 2.0f*WorldSize, Found, ObjectCount);
+	Assert(SphereCheckCount == ObjectCount);
+
+	printf("aabbtree: %7u objects, build %.1fms, height %d, SAH cost %.1f, %llu rotations\n",
+		   ObjectCount, 1000.0*BuildTime, Tree.Nodes[Tree.Root].Height, GetAABBTreeCost(&Tree), (unsigned long long)Tree.RotationCount);
+	printf("aabbtree: %7u objects, frustum %.3fms vs brute force %.3fms (%.0f found, %.0f exact), sphere %.4fms vs %.3fms (%.1f found)\n",
+		   ObjectCount, 1000.0*TreeFrustumTime / QueryCount, 1000.0*BruteFrustumTime / QueryCount,
+		   (real64)TreeFrustumCount / QueryCount, (real64)BruteFrustumCount / QueryCount,
+		   1000.0*TreeSphereTime / QueryCount, 1000.0*BruteSphereTime / QueryCount, (real64)SphereCount / QueryCount);
+	printf("aabbtree: %7u objects, ray %.4fms vs %.3fms (%u/%u hit), %u moved per frame %.3fms, %.1f%% reinserted, %llu rotations\n",
+		   ObjectCount, 1000.0*TreeRayTime / QueryCount, 1000.0*BruteRayTime / QueryCount, RayHitCount, QueryCount,
+		   MovedCount, 1000.0*MoveTime, 100.0*ReinsertCount / (MovedCount*FrameCount), (unsigned long long)MoveRotationCount);
+
+	free(Memory);
+}
+
+static void
+BenchAABBTree(void)
+{
+	BenchAABBTreeCount(10000);
+	BenchAABBTreeCount(100000);
+	BenchAABBTreeCount(1000000);
+}
+
+//
+// NOTE(georgy): Triangle BVH
+//
+
+// NOTE(georgy): Plain scalar Moller-Trumbore, what the BVH results are checked against
+static real32
+IntersectTriangleReference(v3 Origin, v3 Direction, v3 P0, v3 P1, v3 P2, real32 MaxT)
+{
+	real32 Result = MaxT;
+	v3 Edge1 = P1 - P0;
+	v3 Edge2 = P2 - P0;
+	v3 P = Cross(Direction, Edge2);
+	real32 Det = Dot(Edge1, P);
+	if(Det != 0.0f)
+	{
+		real32 InvDet = 1.0f / Det;
+		v3 S = Origin - P0;
+		real32 U = Dot(S, P)*InvDet;
+		v3 Q = Cross(S, Edge1);
+		real32 V = Dot(Direction, Q)*InvDet;
+		real32 T = Dot(Edge2, Q)*InvDet;
+		if((U >= 0.0f) && (V >= 0.0f) && (U + V <= 1.0f) && (T > 0.0f) && (T < MaxT))
+		{
+			Result = T;
+		}
+	}
+	return(Result);
+}
+
+static void
+BenchTriangleBVH(void)
+{
+	const uint32_t ImageSize = 512;
+	const uint32_t CheckRayCount = 256;
+
+	// NOTE(georgy): Stand-in for the bunny scene: a bumpy sphere with ~150k triangles (degenerate ones at the poles included) on a floor
+	std::vector<vertex> VertexArray;
+	std::vector<uint32_t> IndexArray;
+	GenerateSphere(VertexArray, IndexArray, 192, 384);
+	for(uint32_t I = 0; I < VertexArray.size(); I++)
+	{
+		v3 N = VertexArray[I].Normal;
+		VertexArray[I].Pos = (0.5f + 0.05f*sinf(12.0f*N.x)*sinf(12.0f*N.y)*sinf(12.0f*N.z))*N + V3(0.0f, 0.5f, 0.0f);
+	}
+	uint32_t FloorStart = (uint32_t)VertexArray.size();
+	v3 FloorCorners[4] = {V3(-5.0f, 0.0f, -5.0f), V3(5.0f, 0.0f, -5.0f), V3(5.0f, 0.0f, 5.0f), V3(-5.0f, 0.0f, 5.0f)};
+	for(uint32_t I = 0; I < 4; I++)
+	{
+		vertex Vertex = {FloorCorners[I], V3(0.0f, 1.0f, 0.0f)};
+		VertexArray.push_back(Vertex);
+	}
+	uint32_t FloorIndices[6] = {0, 1, 2, 0, 2, 3};
+	for(uint32_t I = 0; I < 6; I++)
+	{
+		IndexArray.push_back(FloorStart + FloorIndices[I]);
+	}
+	uint32_t TriangleCount = (uint32_t)IndexArray.size() / 3;
+
+	size_t TempMemorySize = (size_t)TriangleCount*512 + 1024*1024;
+	size_t MemorySize = 2*(size_t)TriangleCount*(sizeof(bvh4_node) + sizeof(bvh_triangle_block)) + 1024;
+	void *TempMemory = malloc(TempMemorySize);
+	void *Memory = malloc(MemorySize);
+	memory_arena TempArena, Arena;
+	InitializeArena(&TempArena, TempMemorySize, TempMemory);
+	InitializeArena(&Arena, MemorySize, Memory);
+
+	job_system SingleThread = {};
+	SingleThread.WorkerThreadCount = 0;
+	job_system Workers;
+	InitializeJobSystem(&Workers, 3, 0);
+
+	// NOTE(georgy): The parallel build has to give exactly the same tree as the serial one
+	triangle_bvh SerialBVH, BVH;
+	real64 Start = GetSeconds();
+	BuildTriangleBVH(&SerialBVH, &Arena, &TempArena, &VertexArray[0].Pos, sizeof(vertex), &IndexArray[0], TriangleCount, &SingleThread);
+	real64 SerialBuildTime = GetSeconds() - Start;
+	Start = GetSeconds();
+	BuildTriangleBVH(&BVH, &Arena, &TempArena, &VertexArray[0].Pos, sizeof(vertex), &IndexArray[0], TriangleCount, &Workers);
+	real64 ParallelBuildTime = GetSeconds() - Start;
+	ShutdownJobSystem(&Workers);
+	Assert(TempArena.Used == 0);
+	Assert((SerialBVH.NodeCount == BVH.NodeCount) && (SerialBVH.BlockCount == BVH.BlockCount));
+	Assert(memcmp(SerialBVH.Nodes, BVH.Nodes, BVH.NodeCount*sizeof(bvh4_node)) == 0);
+	Assert(memcmp(SerialBVH.Blocks, BVH.Blocks, BVH.BlockCount*sizeof(bvh_triangle_block)) == 0);
+
+	// NOTE(georgy): Every triangle is in exactly one block
+	uint8_t *Seen = (uint8_t *)calloc(TriangleCount, 1);
+	uint32_t UsedLanes = 0;
+	for(uint32_t Block = 0; Block < BVH.BlockCount; Block++)
+	{
+		for(uint32_t Lane = 0; Lane < 4; Lane++)
+		{
+			uint32_t Triangle = BVH.Blocks[Block].Triangles[Lane];
+			if(Triangle != BVH_NO_TRIANGLE)
+			{
+				Assert(!Seen[Triangle]);
+				Seen[Triangle] = 1;
+				UsedLanes++;
+			}
+		}
+	}
+	Assert(UsedLanes == TriangleCount);
+	free(Seen);
+
+	// NOTE(georgy): Camera rays, row by row for single rays and 2x2 pixel quads for packets
+	uint32_t RayCount = ImageSize*ImageSize;
+	v3 Eye = V3(0.3f, 1.2f, -2.0f);
+	v3 Front = Normalize(V3(0.0f, 0.5f, 0.0f) - Eye);
+	v3 Right = Normalize(Cross(V3(0.0f, 1.0f, 0.0f), Front));
+	v3 Up = Cross(Front, Right);
+	v3 *Directions = (v3 *)malloc(RayCount*sizeof(v3));
+	for(uint32_t Y = 0; Y < ImageSize; Y++)
+	{
+		for(uint32_t X = 0; X < ImageSize; X++)
+		{
+			real32 U = (2.0f*(X + 0.5f) / ImageSize - 1.0f)*0.5f;
+			real32 V = (1.0f - 2.0f*(Y + 0.5f) / ImageSize)*0.5f;
+			Directions[Y*ImageSize + X] = Front + U*Right + V*Up;
+		}
+	}
+	const real32 MaxT = 100.0f;
+	v3 LightDirection = Normalize(V3(0.4f, 1.0f, -0.3f));
+
+	bvh_hit *Hits = (bvh_hit *)malloc(RayCount*sizeof(bvh_hit));
+	Start = GetSeconds();
+	for(uint32_t Ray = 0; Ray < RayCount; Ray++)
+	{
+		Hits[Ray] = IntersectTriangleBVH(&BVH, Eye, Directions[Ray], MaxT);
+	}
+	real64 ClosestTime = GetSeconds() - Start;
+
+	uint32_t HitCount = 0;
+	for(uint32_t Ray = 0; Ray < RayCount; Ray++)
+	{
+		HitCount += (Hits[Ray].Triangle != BVH_NO_TRIANGLE);
+	}
+
+	// NOTE(georgy): Shadow rays from the hit points, slightly off the surface
+	v3 *ShadowOrigins = (v3 *)malloc(RayCount*sizeof(v3));
+	for(uint32_t Ray = 0; Ray < RayCount; Ray++)
+	{
+		ShadowOrigins[Ray] = Eye + (Hits[Ray].T*0.999f)*Directions[Ray];
+	}
+	uint8_t *Occluded = (uint8_t *)malloc(RayCount);
+	Start = GetSeconds();
+	for(uint32_t Ray = 0; Ray < RayCount; Ray++)
+	{
+		Occluded[Ray] = (Hits[Ray].Triangle != BVH_NO_TRIANGLE) && OccludedTriangleBVH(&BVH, ShadowOrigins[Ray], LightDirection, MaxT);
+	}
+	real64 AnyTime = GetSeconds() - Start;
+
+	uint32_t OccludedCount = 0;
+	for(uint32_t Ray = 0; Ray < RayCount; Ray++)
+	{
+		OccludedCount += Occluded[Ray];
+		if(Hits[Ray].Triangle != BVH_NO_TRIANGLE)
+		{
+			bvh_hit ShadowHit = IntersectTriangleBVH(&BVH, ShadowOrigins[Ray], LightDirection, MaxT);
+			Assert(Occluded[Ray] == (ShadowHit.Triangle != BVH_NO_TRIANGLE));
+		}
+	}
+
+	// NOTE(georgy): Packets have to find the same closest T and the same occlusion as single rays
+	real64 PacketClosestTime = 0.0, PacketAnyTime = 0.0;
+	for(uint32_t Y = 0; Y < ImageSize; Y += 2)
+	{
+		for(uint32_t X = 0; X < ImageSize; X += 2)
+		{
+			uint32_t Rays[4] = {Y*ImageSize + X, Y*ImageSize + X + 1, (Y + 1)*ImageSize + X, (Y + 1)*ImageSize + X + 1};
+			bvh_ray_packet Packet;
+			for(uint32_t Lane = 0; Lane < 4; Lane++)
+			{
+				v3 D = Directions[Rays[Lane]];
+				Packet.OriginX[Lane] = Eye.x; Packet.OriginY[Lane] = Eye.y; Packet.OriginZ[Lane] = Eye.z;
+				Packet.DirectionX[Lane] = D.x; Packet.DirectionY[Lane] = D.y; Packet.DirectionZ[Lane] = D.z;
+				Packet.MaxT[Lane] = MaxT;
+			}
+			Start = GetSeconds();
+			IntersectTriangleBVHPacket(&BVH, &Packet);
+			PacketClosestTime += GetSeconds() - Start;
+			for(uint32_t Lane = 0; Lane < 4; Lane++)
+			{
+				bvh_hit *Hit = Hits + Rays[Lane];
+				Assert((Packet.Triangles[Lane] == BVH_NO_TRIANGLE) == (Hit->Triangle == BVH_NO_TRIANGLE));
+				Assert(Packet.T[Lane] == Hit->T);
+			}
+
+			for(uint32_t Lane = 0; Lane < 4; Lane++)
+			{
+				v3 O = ShadowOrigins[Rays[Lane]];
+				Packet.OriginX[Lane] = O.x; Packet.OriginY[Lane] = O.y; Packet.OriginZ[Lane] = O.z;
+				Packet.DirectionX[Lane] = LightDirection.x; Packet.DirectionY[Lane] = LightDirection.y; Packet.DirectionZ[Lane] = LightDirection.z;
+				Packet.MaxT[Lane] = (Hits[Rays[Lane]].Triangle != BVH_NO_TRIANGLE) ? MaxT : 0.0f;
+			}
+			Start = GetSeconds();
+			OccludedTriangleBVHPacket(&BVH, &Packet);
+			PacketAnyTime += GetSeconds() - Start;
+			for(uint32_t Lane = 0; Lane < 4; Lane++)
+			{
+				Assert((Packet.T[Lane] < 0.0f) == (Occluded[Rays[Lane]] != 0));
+			}
+		}
+	}
+
+	// NOTE(georgy): A few rays against every triangle
+	uint32_t RandomState = 0x13579BDF;
+	for(uint32_t Check = 0; Check < CheckRayCount; Check++)
+	{
+		uint32_t Ray = SceneBenchRandom(&RandomState) % RayCount;
+		real32 ExpectedT = MaxT;
+		uint32_t ExpectedTriangle = BVH_NO_TRIANGLE;
+		for(uint32_t Triangle = 0; Triangle < TriangleCount; Triangle++)
+		{
+			real32 T = IntersectTriangleReference(Eye, Directions[Ray], VertexArray[IndexArray[3*Triangle]].Pos,
+												  VertexArray[IndexArray[3*Triangle + 1]].Pos, VertexArray[IndexArray[3*Triangle + 2]].Pos, ExpectedT);
+			if(T < ExpectedT)
+			{
+				ExpectedT = T;
+				ExpectedTriangle = Triangle;
+			}
+		}
+		Assert((Hits[Ray].Triangle == BVH_NO_TRIANGLE) == (ExpectedTriangle == BVH_NO_TRIANGLE));
+		Assert(fabsf(Hits[Ray].T - ExpectedT) <= 1e-4f*ExpectedT);
+	}
+
+	printf("bvh: %u triangles, %u BVH4 nodes, %u blocks (%.1f triangles per block), build %.1fms serial, %.1fms on 4 threads\n",
+		   TriangleCount, BVH.NodeCount, BVH.BlockCount, (real64)TriangleCount / BVH.BlockCount, 1000.0*SerialBuildTime, 1000.0*ParallelBuildTime);
+	printf("bvh: %u camera rays (%u hit), closest hit %.2f Mrays/s single, %.2f Mrays/s packets\n",
+		   RayCount, HitCount, RayCount / ClosestTime * 1e-6, RayCount / PacketClosestTime * 1e-6);
+	printf("bvh: %u shadow rays (%u occluded), any hit %.2f Mrays/s single, %.2f Mrays/s packets\n",
+		   HitCount, OccludedCount, HitCount / AnyTime * 1e-6, HitCount / PacketAnyTime * 1e-6);
+
+	free(Directions);
+	free(Hits);
+	free(ShadowOrigins);
+	free(Occluded);
+	free(Memory);
+	free(TempMemory);
+}
+
+//
+// NOTE(georgy): Path tracer
+//
+
+// NOTE(georgy): The game's scene, with a bumpy sphere sitting on the floor standing in for the bunny
+static void
+InitializeBenchPathTracerScene(game_state *GameState, triangle_bvh *BunnyBVH, triangle_bvh *QuadBVH, path_tracer_scene *PathTracer,
+							   uint32_t Width, uint32_t Height, memory_arena *GameArena, memory_arena *TempArena)
+{
+	std::vector<vertex> VertexArray;
+	std::vector<uint32_t> IndexArray;
+	GenerateSphere(VertexArray, IndexArray, 64, 128);
+	for(uint32_t I = 0; I < VertexArray.size(); I++)
+	{
+		v3 N = VertexArray[I].Normal;
+		VertexArray[I].Pos = (0.5f + 0.05f*sinf(12.0f*N.x)*sinf(12.0f*N.y)*sinf(12.0f*N.z))*N + V3(0.0f, 0.5f, 0.0f);
+	}
+	BuildTriangleBVH(BunnyBVH, GameArena, TempArena, &VertexArray[0].Pos, sizeof(vertex), &IndexArray[0], (uint32_t)IndexArray.size() / 3, &GlobalJobSystem);
+	BuildTriangleBVH(QuadBVH, GameArena, TempArena, &QuadVertices[0].Pos, sizeof(vertex), QuadIndices, ArrayCount(QuadIndices) / 3, &GlobalJobSystem);
+
+	InitializeGame(GameState, Width, Height, GameArena);
+	SetRenderMeshBVH(GameState, RenderMesh_Bunny, BunnyBVH);
+	SetRenderMeshBVH(GameState, RenderMesh_Quad, QuadBVH);
+
+	BuildPathTracerScene(PathTracer, GameArena, TempArena, &GameState->Scene, GameState->MeshBVHs, GAME_SUN_POSITION, &GlobalJobSystem);
+}
+
+static void
+BenchPathTracer(void)
+{
+	const uint32_t Width = 256, Height = 144;
+	const uint32_t ReferenceSamples = 256;
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GameMemorySize = 16*1024*1024;
+	size_t TempMemorySize = 64*1024*1024;
+	void *GameMemory = malloc(GameMemorySize);
+	void *TempMemory = malloc(TempMemorySize);
+	memory_arena GameArena, TempArena;
+	InitializeArena(&GameArena, GameMemorySize, GameMemory);
+	InitializeArena(&TempArena, TempMemorySize, TempMemory);
+
+	game_state GameState;
+	triangle_bvh BunnyBVH, QuadBVH;
+	path_tracer_scene PathTracer;
+	InitializeBenchPathTracerScene(&GameState, &BunnyBVH, &QuadBVH, &PathTracer, Width, Height, &GameArena, &TempArena);
+	Assert(PathTracer.BVH.TriangleCount == BunnyBVH.TriangleCount + 3*QuadBVH.TriangleCount);
+
+	path_tracer_camera Camera;
+	Camera.Position = GameState.CameraPos;
+	Camera.Front = GameState.CameraFront;
+	Camera.Right = GameState.CameraRight;
+	Camera.Up = GameState.CameraUp;
+	Camera.TanHalfFoV = tanf(0.5f*DEG2RAD(GameState.FoV));
+	Camera.AspectRatio = GameState.AspectRatio;
+
+	// NOTE(georgy): Tiles can be rendered on any thread in any order, the image has to be the same
+	job_system SingleThread = {};
+	SingleThread.WorkerThreadCount = 0;
+	job_system Workers;
+	InitializeJobSystem(&Workers, 3, 0);
+	path_tracer_image SerialImage, ParallelImage;
+	InitializePathTracerImage(&SerialImage, &TempArena, Width, Height);
+	InitializePathTracerImage(&ParallelImage, &TempArena, Width, Height);
+	RenderPathTracerImage(&PathTracer, &Camera, &SerialImage, 4, GAME_REFERENCE_BOUNCES, 1, &TempArena, &SingleThread);
+	RenderPathTracerImage(&PathTracer, &Camera, &ParallelImage, 4, GAME_REFERENCE_BOUNCES, 1, &TempArena, &Workers);
+	ShutdownJobSystem(&Workers);
+	Assert(memcmp(SerialImage.Direct, ParallelImage.Direct, Width*Height*sizeof(v3)) == 0);
+	Assert(memcmp(SerialImage.Indirect, ParallelImage.Indirect, Width*Height*sizeof(v3)) == 0);
+
+	path_tracer_image Reference;
+	InitializePathTracerImage(&Reference, &TempArena, Width, Height);
+	real64 Start = GetSeconds();
+	uint64_t RayCount = RenderPathTracerImage(&PathTracer, &Camera, &Reference, ReferenceSamples, GAME_REFERENCE_BOUNCES, 0, &TempArena, &GlobalJobSystem);
+	real64 ReferenceTime = GetSeconds() - Start;
+
+	// NOTE(georgy): Most of the pixels that see the scene get some bounced light, the corner between the quads gets lots
+	uint32_t HitCount = 0, IndirectCount = 0;
+	for(uint32_t Pixel = 0; Pixel < Width*Height; Pixel++)
+	{
+		v3 Albedo = Reference.Albedo[Pixel];
+		v3 Indirect = Reference.Indirect[Pixel];
+		Assert((Indirect.x >= 0.0f) && (Indirect.y >= 0.0f) && (Indirect.z >= 0.0f));
+		Assert(Indirect.x + Indirect.y + Indirect.z < 1e3f);
+		HitCount += (Albedo.x + Albedo.y + Albedo.z) > 0.0f;
+		IndirectCount += (Indirect.x + Indirect.y + Indirect.z) > 0.0f;
+	}
+	Assert(IndirectCount > HitCount/2);
+
+	// NOTE(georgy): Monte Carlo error goes down as 1/sqrt(samples), each 4x the samples should about halve it
+	printf("pathtrace: %u triangles, %ux%u at %u samples per pixel in %.2fs (%.2f Mrays/s), %u of %u pixels on the scene get indirect light\n",
+		   PathTracer.BVH.TriangleCount, Width, Height, ReferenceSamples, ReferenceTime, RayCount / ReferenceTime * 1e-6,
+		   IndirectCount, HitCount);
+	real32 LastError = FLT_MAX;
+	for(uint32_t Samples = 4; Samples <= ReferenceSamples/4; Samples *= 4)
+	{
+		path_tracer_image Image;
+		InitializePathTracerImage(&Image, &TempArena, Width, Height);
+		RenderPathTracerImage(&PathTracer, &Camera, &Image, Samples, GAME_REFERENCE_BOUNCES, Samples, &TempArena, &GlobalJobSystem);
+		real32 Error = GetImageRMSE(Image.Indirect, Reference.Indirect, Width*Height);
+		printf("pathtrace: %3u samples per pixel, indirect RMSE %.4f against the reference\n", Samples, Error);
+		Assert(Error < LastError);
+		LastError = Error;
+	}
+
+	free(GameMemory);
+	free(TempMemory);
+}
+
+//
+// NOTE(georgy): RSM sample sets. CalculateRSM from RSMPS.hlsl on the CPU, over an RSM and a G-buffer ray traced
+// from the game's scene, against the exact sum over every RSM texel the gather disk covers.
+//
+
+#define BENCH_RSM_SIZE 128
+#define BENCH_RSM_RADIUS 0.3f
+
+struct bench_rsm_texel
+{
+	v3 Position;
+	v3 Normal;
+	v3 Flux;
+};
+
+struct bench_rsm_receiver
+{
+	bool Valid;
+	v3 Position;
+	v3 Normal;
+	v2 UV;
+	real32 LinearDepth;
+};
+
+inline v3
+GetBenchRSMBounce(bench_rsm_texel *Texel, bench_rsm_receiver *Receiver)
+{
+	v3 Result = V3(0.0f, 0.0f, 0.0f);
+	v3 ToTexel = Texel->Position - Receiver->Position;
+	real32 DistanceSq = LengthSq(ToTexel);
+	if((DistanceSq > 1e-12f) && (LengthSq(Texel->Flux) > 0.0f))
+	{
+		v3 Direction = (1.0f / sqrtf(DistanceSq))*ToTexel;
+		real32 CosTexel = Dot(Texel->Normal, -Direction);
+		real32 CosReceiver = Dot(Receiver->Normal, Direction);
+		if((CosTexel > 0.0f) && (CosReceiver > 0.0f))
+		{
+			Result = (CosTexel*CosReceiver / (DistanceSq*DistanceSq))*Texel->Flux;
+		}
+	}
+	return(Result);
+}
+
+inline bench_rsm_texel *
+GetBenchRSMTexel(bench_rsm_texel *RSM, v2 UV)
+{
+	bench_rsm_texel *Result = 0;
+	if((UV.x >= 0.0f) && (UV.x < 1.0f) && (UV.y >= 0.0f) && (UV.y < 1.0f))
+	{
+		Result = RSM + (uint32_t)(UV.y*BENCH_RSM_SIZE)*BENCH_RSM_SIZE + (uint32_t)(UV.x*BENCH_RSM_SIZE);
+	}
+	return(Result);
+}
+
+// NOTE(georgy): Same as the shader, except that the RSM is point sampled
+static v3
+GatherBenchRSM(bench_rsm_texel *RSM, bench_rsm_receiver *Receiver, v4 *Samples, uint32_t SampleCount, v2 Rotation)
+{
+	v3 Result = V3(0.0f, 0.0f, 0.0f);
+	for(uint32_t I = 0; I < SampleCount; I++)
+	{
+		v4 S = Samples[I];
+		v2 Offset = V2(S.x*Rotation.x + S.y*Rotation.y, S.x*Rotation.y - S.y*Rotation.x);
+		bench_rsm_texel *Texel = GetBenchRSMTexel(RSM, Receiver->UV + BENCH_RSM_RADIUS*Offset);
+		if(Texel)
+		{
+			Result += S.z*GetBenchRSMBounce(Texel, Receiver);
+		}
+	}
+	return(Result);
+}
+
+// NOTE(georgy): What the samples estimate: every texel of the annulus, weighted by its area in the unit disk
+static v3
+IntegrateBenchRSM(bench_rsm_texel *RSM, bench_rsm_receiver *Receiver)
+{
+	v3 Result = V3(0.0f, 0.0f, 0.0f);
+	real32 TexelArea = 1.0f / (BENCH_RSM_SIZE*BENCH_RSM_RADIUS*BENCH_RSM_SIZE*BENCH_RSM_RADIUS);
+	int32_t CenterX = (int32_t)(Receiver->UV.x*BENCH_RSM_SIZE), CenterY = (int32_t)(Receiver->UV.y*BENCH_RSM_SIZE);
+	int32_t Radius = (int32_t)(BENCH_RSM_RADIUS*BENCH_RSM_SIZE) + 2;
+	for(int32_t Y = CenterY - Radius; Y <= CenterY + Radius; Y++)
+	{
+		for(int32_t X = CenterX - Radius; X <= CenterX + Radius; X++)
+		{
+			if((X < 0) || (Y < 0) || (X >= BENCH_RSM_SIZE) || (Y >= BENCH_RSM_SIZE))
+			{
+				continue;
+			}
+
+			v2 TexelUV = V2((X + 0.5f) / BENCH_RSM_SIZE, (Y + 0.5f) / BENCH_RSM_SIZE);
+			real32 R = Length(TexelUV - Receiver->UV) / BENCH_RSM_RADIUS;
+			if((R >= RSM_MIN_SAMPLE_RADIUS) && (R <= 1.0f))
+			{
+				Result += TexelArea*GetBenchRSMBounce(RSM + Y*BENCH_RSM_SIZE + X, Receiver);
+			}
+		}
+	}
+	Result *= RSM_INDIRECT_SCALE;
+	return(Result);
+}
+
+// NOTE(georgy): The 4x4 box BlurPS.hlsl did before the depth aware blur, from -2 to +1
+static void
+BlurBenchRSM(v3 *Source, v3 *Dest, uint32_t Width, uint32_t Height)
+{
+	for(uint32_t Y = 0; Y < Height; Y++)
+	{
+		for(uint32_t X = 0; X < Width; X++)
+		{
+			v3 Sum = V3(0.0f, 0.0f, 0.0f);
+			for(int32_t OY = -2; OY <= 1; OY++)
+			{
+				for(int32_t OX = -2; OX <= 1; OX++)
+				{
+					int32_t SX = (int32_t)X + OX, SY = (int32_t)Y + OY;
+					SX = (SX < 0) ? 0 : ((SX >= (int32_t)Width) ? (int32_t)Width - 1 : SX);
+					SY = (SY < 0) ? 0 : ((SY >= (int32_t)Height) ? (int32_t)Height - 1 : SY);
+					Sum += Source[SY*Width + SX];
+				}
+			}
+			Dest[Y*Width + X] = (1.0f / 16.0f)*Sum;
+		}
+	}
+}
+
+// NOTE(georgy): The RSM, rays along the light's direction through its texels. Flux is what ShadowMapPS writes.
+static bench_rsm_texel *
+BuildBenchRSM(path_tracer_scene *PathTracer, memory_arena *Arena)
+{
+	mat4 LightToWorld = InverseAffine(LookAt(GAME_SUN_POSITION, V3(0.0f, 0.0f, 0.0f)));
+	v3 LightDirection = Normalize(-GAME_SUN_POSITION);
+	bench_rsm_texel *Result = PushArray(Arena, BENCH_RSM_SIZE*BENCH_RSM_SIZE, bench_rsm_texel, true);
+	for(uint32_t Y = 0; Y < BENCH_RSM_SIZE; Y++)
+	{
+		for(uint32_t X = 0; X < BENCH_RSM_SIZE; X++)
+		{
+			real32 NDCX = 2.0f*(X + 0.5f) / BENCH_RSM_SIZE - 1.0f;
+			real32 NDCY = 1.0f - 2.0f*(Y + 0.5f) / BENCH_RSM_SIZE;
+			v3 Origin = (V4(2.5f*NDCX, 2.5f*NDCY, 0.0f, 1.0f) * LightToWorld).xyz;
+			bvh_hit Hit = IntersectTriangleBVH(&PathTracer->BVH, Origin, LightDirection, FLT_MAX);
+			if(Hit.Triangle != BVH_NO_TRIANGLE)
+			{
+				bench_rsm_texel *Texel = Result + Y*BENCH_RSM_SIZE + X;
+				v3 Normal = PathTracer->Normals[Hit.Triangle];
+				Texel->Position = Origin + Hit.T*LightDirection;
+				Texel->Normal = (Dot(Normal, LightDirection) > 0.0f) ? -Normal : Normal;
+				Texel->Flux = 0.1f*PathTracer->Colors[Hit.Triangle];
+			}
+		}
+	}
+	return(Result);
+}
+
+// NOTE(georgy): G-buffer from the camera, and the exact gather of every pixel unless Reference is 0
+static void
+BuildBenchRSMReceivers(game_state *GameState, path_tracer_scene *PathTracer, bench_rsm_texel *RSM,
+					   bench_rsm_receiver *Receivers, v3 *Reference, uint32_t Width, uint32_t Height)
+{
+	mat4 LightViewProjection = LookAt(GAME_SUN_POSITION, V3(0.0f, 0.0f, 0.0f)) * Orthographic(-2.5f, 2.5f, -2.5f, 2.5f, 3.5f, 10.0f);
+	real32 TanHalfFoV = tanf(0.5f*DEG2RAD(GameState->FoV));
+	for(uint32_t Y = 0; Y < Height; Y++)
+	{
+		for(uint32_t X = 0; X < Width; X++)
+		{
+			real32 PX = 2.0f*(X + 0.5f) / Width - 1.0f;
+			real32 PY = 1.0f - 2.0f*(Y + 0.5f) / Height;
+			v3 Direction = GameState->CameraFront + (PX*TanHalfFoV*GameState->AspectRatio)*GameState->CameraRight + (PY*TanHalfFoV)*GameState->CameraUp;
+			bvh_hit Hit = IntersectTriangleBVH(&PathTracer->BVH, GameState->CameraPos, Direction, FLT_MAX);
+			bench_rsm_receiver *Receiver = Receivers + Y*Width + X;
+			if(Reference)
+			{
+				Reference[Y*Width + X] = V3(0.0f, 0.0f, 0.0f);
+			}
+			if(Hit.Triangle != BVH_NO_TRIANGLE)
+			{
+				v3 Normal = PathTracer->Normals[Hit.Triangle];
+				Receiver->Valid = true;
+				Receiver->Position = GameState->CameraPos + Hit.T*Direction;
+				Receiver->Normal = (Dot(Normal, Direction) > 0.0f) ? -Normal : Normal;
+				v4 LightClip = V4(Receiver->Position, 1.0f) * LightViewProjection;
+				Receiver->UV = V2(0.5f*LightClip.x + 0.5f, -0.5f*LightClip.y + 0.5f);
+				// NOTE(georgy): Direction is 1 along CameraFront, so T is the view space Z
+				Receiver->LinearDepth = Hit.T / GameState->FarDistance;
+				if(Reference)
+				{
+					Reference[Y*Width + X] = IntegrateBenchRSM(RSM, Receiver);
+				}
+			}
+			else
+			{
+				// NOTE(georgy): What the G-buffer is cleared to
+				Receiver->Valid = false;
+				Receiver->Normal = V3(0.0f, 0.0f, 0.0f);
+				Receiver->LinearDepth = 1.0f;
+			}
+		}
+	}
+}
+
+// NOTE(georgy): RMS error over the pixels that see the scene, after the tone mapping in DeferredPS.hlsl and in 8 bit levels.
+// The 1/distance^4 in the gather goes through the roof where two surfaces meet, and without tone mapping
+// those few pixels would be all the error there is.
+inline v3
+ToneMapBenchRSM(v3 Color)
+{
+	v3 Result = V3(Color.x / (Color.x + 1.0f), Color.y / (Color.y + 1.0f), Color.z / (Color.z + 1.0f));
+	return(Result);
+}
+
+static real32
+GetBenchRSMError(v3 *Image, v3 *Reference, bench_rsm_receiver *Receivers, uint32_t PixelCount)
+{
+	real64 ErrorSum = 0.0;
+	uint32_t Count = 0;
+	for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+	{
+		if(Receivers[Pixel].Valid)
+		{
+			v3 Difference = ToneMapBenchRSM(Image[Pixel]) - ToneMapBenchRSM(Reference[Pixel]);
+			ErrorSum += Dot(Difference, Difference) / 3.0;
+			Count++;
+		}
+	}
+	real32 Result = (real32)(255.0*sqrt(ErrorSum / Count));
+	return(Result);
+}
+
+static void
+BenchRSMSamples(void)
+{
+	const uint32_t Width = 128, Height = 72;
+	const uint32_t PixelCount = Width*Height;
+	const uint32_t SampleCounts[] = {4, 8, 16, 32, 64};
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GameMemorySize = 16*1024*1024;
+	size_t TempMemorySize = 64*1024*1024;
+	void *GameMemory = malloc(GameMemorySize);
+	void *TempMemory = malloc(TempMemorySize);
+	memory_arena GameArena, TempArena;
+	InitializeArena(&GameArena, GameMemorySize, GameMemory);
+	InitializeArena(&TempArena, TempMemorySize, TempMemory);
+
+	game_state GameState;
+	triangle_bvh BunnyBVH, QuadBVH;
+	path_tracer_scene PathTracer;
+	InitializeBenchPathTracerScene(&GameState, &BunnyBVH, &QuadBVH, &PathTracer, Width, Height, &GameArena, &TempArena);
+
+	bench_rsm_texel *RSM = BuildBenchRSM(&PathTracer, &TempArena);
+	bench_rsm_receiver *Receivers = PushArray(&TempArena, PixelCount, bench_rsm_receiver, true);
+	v3 *Reference = PushArray(&TempArena, PixelCount, v3, true);
+	BuildBenchRSMReceivers(&GameState, &PathTracer, RSM, Receivers, Reference, Width, Height);
+
+	// NOTE(georgy): Per pixel rotations: the renderer's original 4x4 tile of random ones, and blue noise tiles
+	v2 WhiteNoise[16];
+	std::uniform_real_distribution<float> RandomFloats(0.0f, 1.0f);
+	std::default_random_engine Generator;
+	for(uint32_t I = 0; I < ArrayCount(WhiteNoise); I++)
+	{
+		real32 Angle = 2.0f*PI*RandomFloats(Generator);
+		WhiteNoise[I] = V2(cosf(Angle), sinf(Angle));
+	}
+	const uint32_t BlueNoiseSizes[2] = {4, RSM_MAX_NOISE_SIZE};
+	rsm_noise_constants *BlueNoise = PushArray(&TempArena, 2, rsm_noise_constants);
+	real64 Start = GetSeconds();
+	GenerateRSMNoise(&BlueNoise[0], BlueNoiseSizes[0]);
+	GenerateRSMNoise(&BlueNoise[1], BlueNoiseSizes[1]);
+	real64 BlueNoiseTime = GetSeconds() - Start;
+
+	// NOTE(georgy): A 4x4 blue noise tile has every one of its 16 rotations exactly once
+	uint8_t SeenRotations[16] = {};
+	for(uint32_t I = 0; I < 16; I++)
+	{
+		real32 *Rotation = (real32 *)BlueNoise[0].Rotations + 2*I;
+		real32 Angle = atan2f(Rotation[1], Rotation[0]);
+		uint32_t Slot = (uint32_t)(16.0f*(Angle < 0.0f ? Angle + 2.0f*PI : Angle) / (2.0f*PI));
+		Assert(Slot < 16);
+		SeenRotations[Slot]++;
+	}
+	for(uint32_t I = 0; I < 16; I++)
+	{
+		Assert(SeenRotations[I] == 1);
+	}
+
+	printf("rsmsamples: %ux%u RSM, %ux%u pixels, blue noise %ux%u and %ux%u in %.1fms. RMS error against the exact gather, in 8 bit levels after tone mapping:\n",
+		   BENCH_RSM_SIZE, BENCH_RSM_SIZE, Width, Height, BlueNoiseSizes[0], BlueNoiseSizes[0], BlueNoiseSizes[1], BlueNoiseSizes[1], 1000.0*BlueNoiseTime);
+	printf("rsmsamples: %-8s %7s | %-17s | %-17s | %-17s\n", "", "", "white 4x4", "blue 4x4", "blue 32x32");
+	printf("rsmsamples: %-8s %7s | %8s %8s | %8s %8s | %8s %8s\n", "pattern", "samples", "raw", "blurred", "raw", "blurred", "raw", "blurred");
+
+	v3 *Image = PushArray(&TempArena, PixelCount, v3);
+	v3 *Blurred = PushArray(&TempArena, PixelCount, v3);
+	real32 Errors[RSMSamplePattern_Count][ArrayCount(SampleCounts)][3][2];
+	for(uint32_t Pattern = 0; Pattern < RSMSamplePattern_Count; Pattern++)
+	{
+		for(uint32_t CountIndex = 0; CountIndex < ArrayCount(SampleCounts); CountIndex++)
+		{
+			v4 Samples[RSM_MAX_SAMPLE_COUNT];
+			GenerateRSMSamples(Samples, SampleCounts[CountIndex], (rsm_sample_pattern)Pattern);
+
+			for(uint32_t Noise = 0; Noise < 3; Noise++)
+			{
+				for(uint32_t Y = 0; Y < Height; Y++)
+				{
+					for(uint32_t X = 0; X < Width; X++)
+					{
+						v2 Rotation;
+						if(Noise == 0)
+						{
+							Rotation = WhiteNoise[(Y % 4)*4 + (X % 4)];
+						}
+						else
+						{
+							uint32_t Size = BlueNoiseSizes[Noise - 1];
+							real32 *Rotations = (real32 *)BlueNoise[Noise - 1].Rotations + 2*((Y % Size)*Size + (X % Size));
+							Rotation = V2(Rotations[0], Rotations[1]);
+						}
+
+						uint32_t Pixel = Y*Width + X;
+						Image[Pixel] = Receivers[Pixel].Valid ? GatherBenchRSM(RSM, Receivers + Pixel, Samples, SampleCounts[CountIndex], Rotation) : V3(0.0f, 0.0f, 0.0f);
+					}
+				}
+				BlurBenchRSM(Image, Blurred, Width, Height);
+				Errors[Pattern][CountIndex][Noise][0] = GetBenchRSMError(Image, Reference, Receivers, PixelCount);
+				Errors[Pattern][CountIndex][Noise][1] = GetBenchRSMError(Blurred, Reference, Receivers, PixelCount);
+			}
+
+			real32 (*E)[2] = Errors[Pattern][CountIndex];
+			printf("rsmsamples: %-8s %7u | %8.2f %8.2f | %8.2f %8.2f | %8.2f %8.2f\n", RSMSamplePatternNames[Pattern], SampleCounts[CountIndex],
+				   E[0][0], E[0][1], E[1][0], E[1][1], E[2][0], E[2][1]);
+		}
+	}
+
+	// NOTE(georgy): The renderer's pattern, with its 4x4 blue noise, beats the original and the random set at the same number of samples
+	for(uint32_t CountIndex = 0; CountIndex < ArrayCount(SampleCounts); CountIndex++)
+	{
+		if((SampleCounts[CountIndex] == RENDERER_RSM_SAMPLE_COUNT) || (SampleCounts[CountIndex] == 2*RENDERER_RSM_SAMPLE_COUNT))
+		{
+			for(uint32_t Blurred = 0; Blurred < 2; Blurred++)
+			{
+				real32 Error = Errors[RENDERER_RSM_SAMPLE_PATTERN][CountIndex][1][Blurred];
+				Assert(Error < Errors[RSMSamplePattern_Original][CountIndex][1][Blurred]);
+				Assert(Error < Errors[RSMSamplePattern_Random][CountIndex][1][Blurred]);
+			}
+		}
+	}
+
+	free(GameMemory);
+	free(TempMemory);
+}
+
+//
+// NOTE(georgy): Upsampling of the low resolution RSM gather. The exact gather at the pixels RSMPS.hlsl computes,
+// brought back to full resolution with the reference of DeferredPS.hlsl's upsample, against the exact gather of every pixel.
+//
+
+static void
+BenchRSMUpsample(void)
+{
+	const uint32_t Width = 192, Height = 108;
+	const uint32_t PixelCount = Width*Height;
+	const uint32_t Downsamples[] = {2, 4};
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GameMemorySize = 16*1024*1024;
+	size_t TempMemorySize = 64*1024*1024;
+	void *GameMemory = malloc(GameMemorySize);
+	void *TempMemory = malloc(TempMemorySize);
+	memory_arena GameArena, TempArena;
+	InitializeArena(&GameArena, GameMemorySize, GameMemory);
+	InitializeArena(&TempArena, TempMemorySize, TempMemory);
+
+	game_state GameState;
+	triangle_bvh BunnyBVH, QuadBVH;
+	path_tracer_scene PathTracer;
+	InitializeBenchPathTracerScene(&GameState, &BunnyBVH, &QuadBVH, &PathTracer, Width, Height, &GameArena, &TempArena);
+
+	bench_rsm_texel *RSM = BuildBenchRSM(&PathTracer, &TempArena);
+	bench_rsm_receiver *Receivers = PushArray(&TempArena, PixelCount, bench_rsm_receiver, true);
+	v3 *Reference = PushArray(&TempArena, PixelCount, v3, true);
+	BuildBenchRSMReceivers(&GameState, &PathTracer, RSM, Receivers, Reference, Width, Height);
+
+	real32 *Depths = PushArray(&TempArena, PixelCount, real32);
+	v3 *Normals = PushArray(&TempArena, PixelCount, v3);
+	for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+	{
+		Depths[Pixel] = Receivers[Pixel].LinearDepth;
+		Normals[Pixel] = Receivers[Pixel].Normal;
+	}
+
+	// NOTE(georgy): Edge pixels have a neighbour on another surface, that's where the upsample can go wrong
+	bench_rsm_receiver *EdgeReceivers = PushArray(&TempArena, PixelCount, bench_rsm_receiver, true);
+	uint32_t EdgeCount = 0;
+	for(int32_t Y = 0; Y < (int32_t)Height; Y++)
+	{
+		for(int32_t X = 0; X < (int32_t)Width; X++)
+		{
+			bench_rsm_receiver *Receiver = Receivers + Y*Width + X;
+			bool Edge = false;
+			for(int32_t NeighbourY = Y - 1; NeighbourY <= Y + 1; NeighbourY++)
+			{
+				for(int32_t NeighbourX = X - 1; NeighbourX <= X + 1; NeighbourX++)
+				{
+					if((NeighbourX >= 0) && (NeighbourY >= 0) && (NeighbourX < (int32_t)Width) && (NeighbourY < (int32_t)Height))
+					{
+						bench_rsm_receiver *Neighbour = Receivers + NeighbourY*Width + NeighbourX;
+						Edge = Edge || (Neighbour->Valid != Receiver->Valid) ||
+									   (fabsf(Neighbour->LinearDepth - Receiver->LinearDepth) > 0.1f*Receiver->LinearDepth) ||
+									   (Dot(Neighbour->Normal, Receiver->Normal) < 0.9f);
+					}
+				}
+			}
+			EdgeReceivers[Y*Width + X] = *Receiver;
+			EdgeReceivers[Y*Width + X].Valid = Receiver->Valid && Edge;
+			EdgeCount += EdgeReceivers[Y*Width + X].Valid;
+		}
+	}
+
+	printf("rsmupsample: %ux%u pixels, %u on edges. RMS error against the exact gather at every pixel, in 8 bit levels after tone mapping:\n",
+		   Width, Height, EdgeCount);
+	printf("rsmupsample: %-10s | %-17s | %-17s | %-17s\n", "", "nearest", "bilinear", "bilateral");
+	printf("rsmupsample: %-10s | %8s %8s | %8s %8s | %8s %8s\n", "resolution", "all", "edges", "all", "edges", "all", "edges");
+
+	v3 *Upsampled = PushArray(&TempArena, PixelCount, v3);
+	v3 *Bilinear = PushArray(&TempArena, PixelCount, v3);
+	for(uint32_t DownsampleIndex = 0; DownsampleIndex < ArrayCount(Downsamples); DownsampleIndex++)
+	{
+		uint32_t Downsample = Downsamples[DownsampleIndex];
+		uint32_t LowWidth = (Width + Downsample - 1) / Downsample;
+		uint32_t LowHeight = (Height + Downsample - 1) / Downsample;
+
+		temporary_memory LowMemory = BeginTemporaryMemory(&TempArena);
+		v3 *LowColors = PushArray(&TempArena, LowWidth*LowHeight, v3);
+
+		// NOTE(georgy): A constant comes out unchanged, whatever the weights and wherever the fallback kicks in
+		for(uint32_t Texel = 0; Texel < LowWidth*LowHeight; Texel++)
+		{
+			LowColors[Texel] = V3(0.25f, 0.5f, 1.0f);
+		}
+		BilateralUpsample(Upsampled, Width, Height, Depths, Normals, LowColors, LowWidth, LowHeight, Downsample);
+		for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+		{
+			Assert(LengthSq(Upsampled[Pixel] - V3(0.25f, 0.5f, 1.0f)) < 1e-10f);
+		}
+
+		for(uint32_t LowY = 0; LowY < LowHeight; LowY++)
+		{
+			for(uint32_t LowX = 0; LowX < LowWidth; LowX++)
+			{
+				LowColors[LowY*LowWidth + LowX] = Reference[(Downsample*LowY)*Width + Downsample*LowX];
+			}
+		}
+
+		// NOTE(georgy): On a single plane facing the camera the guides agree everywhere and it's plain bilinear filtering
+		{
+			temporary_memory FlatMemory = BeginTemporaryMemory(&TempArena);
+			real32 *FlatDepths = PushArray(&TempArena, PixelCount, real32);
+			v3 *FlatNormals = PushArray(&TempArena, PixelCount, v3);
+			for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+			{
+				FlatDepths[Pixel] = 0.5f;
+				FlatNormals[Pixel] = V3(0.0f, 0.0f, -1.0f);
+			}
+			BilateralUpsample(Upsampled, Width, Height, FlatDepths, FlatNormals, LowColors, LowWidth, LowHeight, Downsample);
+			BilateralUpsample(Bilinear, Width, Height, FlatDepths, FlatNormals, LowColors, LowWidth, LowHeight, Downsample, false);
+			for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+			{
+				Assert(LengthSq(Upsampled[Pixel] - Bilinear[Pixel]) <= 1e-10f*(1.0f + LengthSq(Bilinear[Pixel])));
+			}
+			EndTemporaryMemory(FlatMemory);
+		}
+
+		real32 Errors[3][2];
+		for(uint32_t Y = 0; Y < Height; Y++)
+		{
+			for(uint32_t X = 0; X < Width; X++)
+			{
+				Upsampled[Y*Width + X] = LowColors[(Y / Downsample)*LowWidth + X / Downsample];
+			}
+		}
+		Errors[0][0] = GetBenchRSMError(Upsampled, Reference, Receivers, PixelCount);
+		Errors[0][1] = GetBenchRSMError(Upsampled, Reference, EdgeReceivers, PixelCount);
+
+		BilateralUpsample(Bilinear, Width, Height, Depths, Normals, LowColors, LowWidth, LowHeight, Downsample, false);
+		Errors[1][0] = GetBenchRSMError(Bilinear, Reference, Receivers, PixelCount);
+		Errors[1][1] = GetBenchRSMError(Bilinear, Reference, EdgeReceivers, PixelCount);
+
+		BilateralUpsample(Upsampled, Width, Height, Depths, Normals, LowColors, LowWidth, LowHeight, Downsample);
+		Errors[2][0] = GetBenchRSMError(Upsampled, Reference, Receivers, PixelCount);
+		Errors[2][1] = GetBenchRSMError(Upsampled, Reference, EdgeReceivers, PixelCount);
+
+		char Resolution[32];
+		snprintf(Resolution, sizeof(Resolution), "1/%u %ux%u", Downsample, LowWidth, LowHeight);
+		printf("rsmupsample: %-10s | %8.2f %8.2f | %8.2f %8.2f | %8.2f %8.2f\n", Resolution,
+			   Errors[0][0], Errors[0][1], Errors[1][0], Errors[1][1], Errors[2][0], Errors[2][1]);
+
+		Assert(Errors[2][1] < Errors[1][1]);
+
+		EndTemporaryMemory(LowMemory);
+	}
+
+	free(GameMemory);
+	free(TempMemory);
+}
+
+// NOTE(georgy): The gather and TemporalPS.hlsl's resolve over a few frames, simulated at the gather's resolution
+// (the full resolution doesn't change anything here)
+struct bench_temporal
+{
+	uint32_t Width, Height;
+	bench_rsm_texel *RSM;
+	rsm_noise_constants *Noise;
+
+	// NOTE(georgy): Of the last frame. Reference is its exact gather, Image its gather and Accumulated the resolved one.
+	bench_rsm_receiver *Receivers;
+	v3 *Reference;
+	v3 *Image;
+	v3 *Accumulated;
+
+	real32 *Depths;
+	temporal_history Histories[2];
+};
+
+static void
+InitializeBenchTemporal(bench_temporal *Temporal, path_tracer_scene *PathTracer, uint32_t Width, uint32_t Height, memory_arena *Arena)
+{
+	uint32_t PixelCount = Width*Height;
+	Temporal->Width = Width;
+	Temporal->Height = Height;
+	Temporal->RSM = BuildBenchRSM(PathTracer, Arena);
+	Temporal->Noise = PushStruct(Arena, rsm_noise_constants);
+	GenerateRSMNoise(Temporal->Noise, 4);
+
+	Temporal->Receivers = PushArray(Arena, PixelCount, bench_rsm_receiver, true);
+	Temporal->Reference = PushArray(Arena, PixelCount, v3);
+	Temporal->Image = PushArray(Arena, PixelCount, v3);
+	Temporal->Accumulated = 0;
+	Temporal->Depths = PushArray(Arena, PixelCount, real32);
+	for(uint32_t HistoryIndex = 0; HistoryIndex < 2; HistoryIndex++)
+	{
+		Temporal->Histories[HistoryIndex].Colors = PushArray(Arena, PixelCount, v3);
+		Temporal->Histories[HistoryIndex].LinearDepths = PushArray(Arena, PixelCount, real32);
+		Temporal->Histories[HistoryIndex].Width = Width;
+		Temporal->Histories[HistoryIndex].Height = Height;
+	}
+}
+
+// NOTE(georgy): The camera strafes right by CameraSpeed every frame, and is back where it started afterwards
+static void
+RunBenchTemporal(bench_temporal *Temporal, game_state *GameState, path_tracer_scene *PathTracer,
+				 uint32_t SampleCount, real32 CameraSpeed, uint32_t FrameCount)
+{
+	uint32_t Width = Temporal->Width, Height = Temporal->Height;
+	bench_rsm_receiver *Receivers = Temporal->Receivers;
+	v3 *Image = Temporal->Image;
+	real32 *Depths = Temporal->Depths;
+	mat4 Projection = Perspective(GameState->FoV, GameState->AspectRatio, GameState->NearDistance, GameState->FarDistance);
+	real32 TanHalfFoV = tanf(0.5f*DEG2RAD(GameState->FoV));
+
+	v4 Samples[RSM_MAX_SAMPLE_COUNT];
+	GenerateRSMSamples(Samples, SampleCount, RENDERER_RSM_SAMPLE_PATTERN);
+
+	v3 StartCameraPos = GameState->CameraPos;
+	mat4 PrevViewProjection = Identity();
+	for(uint32_t Frame = 0; Frame < FrameCount; Frame++)
+	{
+		bool LastFrame = (Frame == FrameCount - 1);
+		GameState->CameraPos = StartCameraPos + (CameraSpeed*Frame)*GameState->CameraRight;
+		BuildBenchRSMReceivers(GameState, PathTracer, Temporal->RSM, Receivers, LastFrame ? Temporal->Reference : 0, Width, Height);
+
+		real32 FrameAngle = GetRSMFrameRotation(Frame);
+		v2 FrameRotation = V2(cosf(FrameAngle), sinf(FrameAngle));
+		for(uint32_t Y = 0; Y < Height; Y++)
+		{
+			for(uint32_t X = 0; X < Width; X++)
+			{
+				uint32_t Pixel = Y*Width + X;
+				real32 *NoiseRotation = (real32 *)Temporal->Noise->Rotations + 2*((Y % 4)*4 + (X % 4));
+				v2 Rotation = V2(NoiseRotation[0]*FrameRotation.x - NoiseRotation[1]*FrameRotation.y,
+								 NoiseRotation[1]*FrameRotation.x + NoiseRotation[0]*FrameRotation.y);
+				Image[Pixel] = Receivers[Pixel].Valid ? GatherBenchRSM(Temporal->RSM, Receivers + Pixel, Samples, SampleCount, Rotation) : V3(0.0f, 0.0f, 0.0f);
+				Depths[Pixel] = Receivers[Pixel].LinearDepth;
+			}
+		}
+
+		temporal_history Current = {Image, Depths, Width, Height};
+		temporal_history *History = Temporal->Histories + (Frame & 1);
+		temporal_history *PrevHistory = Temporal->Histories + ((Frame + 1) & 1);
+		mat4 View = LookAt(GameState->CameraPos, GameState->CameraPos + GameState->CameraFront);
+		mat4 ViewToPrevClip = GetViewToPrevClip(View, PrevViewProjection);
+		for(uint32_t Y = 0; Y < Height; Y++)
+		{
+			for(uint32_t X = 0; X < Width; X++)
+			{
+				uint32_t Pixel = Y*Width + X;
+				v3 ViewPos = (V4(Receivers[Pixel].Position, 1.0f) * View).xyz;
+				if(!Receivers[Pixel].Valid)
+				{
+					// NOTE(georgy): Background, at the far plane like the cleared LinearDepth says
+					real32 PX = 2.0f*(X + 0.5f) / Width - 1.0f;
+					real32 PY = 1.0f - 2.0f*(Y + 0.5f) / Height;
+					ViewPos = GameState->FarDistance*V3(PX*TanHalfFoV*GameState->AspectRatio, PY*TanHalfFoV, 1.0f);
+				}
+				History->Colors[Pixel] = ResolveTemporalTexel(X, Y, &Current, PrevHistory, ViewPos, ViewToPrevClip,
+															   GameState->FarDistance, Width, Height, 1, Frame > 0);
+				History->LinearDepths[Pixel] = Depths[Pixel];
+			}
+		}
+		PrevViewProjection = View*Projection;
+		Temporal->Accumulated = History->Colors;
+	}
+	GameState->CameraPos = StartCameraPos;
+}
+
+//
+// NOTE(georgy): Temporal accumulation of the RSM gather. Checks the reprojection and the per frame rotations,
+// then runs the gather and TemporalPS.hlsl's resolve for a few frames with a still and a moving camera.
+//
+
+static void
+BenchTemporal(void)
+{
+	// NOTE(georgy): Simulated at the gather's resolution, the full resolution doesn't change anything here
+	const uint32_t Width = 96, Height = 54;
+	const uint32_t PixelCount = Width*Height;
+	const uint32_t FrameCount = 32;
+	const uint32_t SampleCounts[] = {4, 8, 16};
+	const real32 CameraSpeeds[] = {0.0f, 0.01f};
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GameMemorySize = 16*1024*1024;
+	size_t TempMemorySize = 64*1024*1024;
+	void *GameMemory = malloc(GameMemorySize);
+	void *TempMemory = malloc(TempMemorySize);
+	memory_arena GameArena, TempArena;
+	InitializeArena(&GameArena, GameMemorySize, GameMemory);
+	InitializeArena(&TempArena, TempMemorySize, TempMemory);
+
+	game_state GameState;
+	triangle_bvh BunnyBVH, QuadBVH;
+	path_tracer_scene PathTracer;
+	InitializeBenchPathTracerScene(&GameState, &BunnyBVH, &QuadBVH, &PathTracer, Width, Height, &GameArena, &TempArena);
+	mat4 Projection = Perspective(GameState.FoV, GameState.AspectRatio, GameState.NearDistance, GameState.FarDistance);
+
+	// NOTE(georgy): Reprojection. A still camera maps every pixel to itself, a moving one to where the previous
+	// view-projection puts the same world position.
+	{
+		bench_rsm_receiver *Receivers = PushArray(&TempArena, PixelCount, bench_rsm_receiver, true);
+		BuildBenchRSMReceivers(&GameState, &PathTracer, 0, Receivers, 0, Width, Height);
+
+		mat4 View = LookAt(GameState.CameraPos, GameState.CameraPos + GameState.CameraFront);
+		v3 PrevCameraPos = GameState.CameraPos - 0.1f*GameState.CameraRight + 0.05f*GameState.CameraUp;
+		mat4 PrevViewProjection = LookAt(PrevCameraPos, PrevCameraPos + Normalize(GameState.CameraFront + 0.1f*GameState.CameraRight)) * Projection;
+		mat4 ViewToSameClip = GetViewToPrevClip(View, View*Projection);
+		mat4 ViewToPrevClip = GetViewToPrevClip(View, PrevViewProjection);
+		real32 MaxStillError = 0.0f, MaxMovingError = 0.0f;
+		for(uint32_t Y = 0; Y < Height; Y++)
+		{
+			for(uint32_t X = 0; X < Width; X++)
+			{
+				bench_rsm_receiver *Receiver = Receivers + Y*Width + X;
+				if(Receiver->Valid)
+				{
+					v3 ViewPos = (V4(Receiver->Position, 1.0f) * View).xyz;
+
+					temporal_reprojection Still = ReprojectToPrevFrame(ViewPos, ViewToSameClip, GameState.FarDistance);
+					v2 PixelUV = V2((X + 0.5f) / Width, (Y + 0.5f) / Height);
+					MaxStillError = fmaxf(MaxStillError, fmaxf(fabsf(Still.UV.x - PixelUV.x), fabsf(Still.UV.y - PixelUV.y)));
+					MaxStillError = fmaxf(MaxStillError, fabsf(Still.LinearDepth - Receiver->LinearDepth));
+
+					temporal_reprojection Moving = ReprojectToPrevFrame(ViewPos, ViewToPrevClip, GameState.FarDistance);
+					v4 PrevClip = V4(Receiver->Position, 1.0f) * PrevViewProjection;
+					v2 PrevUV = V2(0.5f*PrevClip.x / PrevClip.w + 0.5f, -0.5f*PrevClip.y / PrevClip.w + 0.5f);
+					MaxMovingError = fmaxf(MaxMovingError, fmaxf(fabsf(Moving.UV.x - PrevUV.x), fabsf(Moving.UV.y - PrevUV.y)));
+					MaxMovingError = fmaxf(MaxMovingError, fabsf(Moving.LinearDepth - PrevClip.w / GameState.FarDistance));
+				}
+			}
+		}
+		printf("temporal: reprojection max error %g with a still camera, %g with a moving one\n", MaxStillError, MaxMovingError);
+		Assert(MaxStillError < 1e-4f);
+		Assert(MaxMovingError < 1e-4f);
+	}
+
+	// NOTE(georgy): Frame rotations. The first N of them split the circle into gaps no wider than 2.7/N of it
+	// (three gap theorem: golden ratio steps leave at most three gap sizes).
+	for(uint32_t N = 2; N <= 64; N++)
+	{
+		real32 Angles[64];
+		for(uint32_t Frame = 0; Frame < N; Frame++)
+		{
+			Angles[Frame] = GetRSMFrameRotation(Frame) / (2.0f*PI);
+			Assert((Angles[Frame] >= 0.0f) && (Angles[Frame] < 1.0f));
+		}
+		std::sort(Angles, Angles + N);
+		real32 MaxGap = 1.0f - Angles[N - 1] + Angles[0];
+		for(uint32_t Frame = 1; Frame < N; Frame++)
+		{
+			MaxGap = fmaxf(MaxGap, Angles[Frame] - Angles[Frame - 1]);
+		}
+		Assert(MaxGap < 2.7f / N);
+	}
+
+	// NOTE(georgy): Accumulation against the exact gather of the last frame, with the renderer's samples and 4x4 blue noise
+	bench_temporal Temporal;
+	InitializeBenchTemporal(&Temporal, &PathTracer, Width, Height, &TempArena);
+	v3 *Blurred = PushArray(&TempArena, PixelCount, v3);
+
+	printf("temporal: %ux%u pixels, %u frames. RMS error of the last frame against the exact gather, in 8 bit levels after tone mapping:\n",
+		   Width, Height, FrameCount);
+	printf("temporal: %-7s %7s | %-17s | %-17s\n", "", "", "one frame", "accumulated");
+	printf("temporal: %-7s %7s | %8s %8s | %8s %8s\n", "camera", "samples", "raw", "blurred", "raw", "blurred");
+
+	for(uint32_t SpeedIndex = 0; SpeedIndex < ArrayCount(CameraSpeeds); SpeedIndex++)
+	{
+		for(uint32_t CountIndex = 0; CountIndex < ArrayCount(SampleCounts); CountIndex++)
+		{
+			RunBenchTemporal(&Temporal, &GameState, &PathTracer, SampleCounts[CountIndex], CameraSpeeds[SpeedIndex], FrameCount);
+
+			real32 Errors[2][2];
+			BlurBenchRSM(Temporal.Image, Blurred, Width, Height);
+			Errors[0][0] = GetBenchRSMError(Temporal.Image, Temporal.Reference, Temporal.Receivers, PixelCount);
+			Errors[0][1] = GetBenchRSMError(Blurred, Temporal.Reference, Temporal.Receivers, PixelCount);
+			BlurBenchRSM(Temporal.Accumulated, Blurred, Width, Height);
+			Errors[1][0] = GetBenchRSMError(Temporal.Accumulated, Temporal.Reference, Temporal.Receivers, PixelCount);
+			Errors[1][1] = GetBenchRSMError(Blurred, Temporal.Reference, Temporal.Receivers, PixelCount);
+
+			printf("temporal: %-7s %7u | %8.2f %8.2f | %8.2f %8.2f\n", (CameraSpeeds[SpeedIndex] > 0.0f) ? "moving" : "still", SampleCounts[CountIndex],
+				   Errors[0][0], Errors[0][1], Errors[1][0], Errors[1][1]);
+			Assert(Errors[1][0] < Errors[0][0]);
+		}
+	}
+
+	free(GameMemory);
+	free(TempMemory);
+}
+
+//
+// NOTE(georgy): Depth aware blur of the RSM indirect illumination. Checks the separable kernel on synthetic images,
+// then compares it with the 4x4 box BlurPS.hlsl had before, on a gather of the bunny scene and on the accumulated one.
+//
+
+// NOTE(georgy): Max relative difference of two images
+static real32
+GetBenchBlurDifference(v3 *A, v3 *B, uint32_t PixelCount)
+{
+	real32 Result = 0.0f;
+	for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+	{
+		v3 Difference = A[Pixel] - B[Pixel];
+		real32 Scale = fmaxf(fmaxf(fabsf(B[Pixel].x), fabsf(B[Pixel].y)), fmaxf(fabsf(B[Pixel].z), 1e-3f));
+		Result = fmaxf(Result, fmaxf(fmaxf(fabsf(Difference.x), fabsf(Difference.y)), fabsf(Difference.z)) / Scale);
+	}
+	return(Result);
+}
+
+static void
+BenchBlur(void)
+{
+	const uint32_t Width = 96, Height = 54;
+	const uint32_t PixelCount = Width*Height;
+	const uint32_t FrameCount = 32;
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GameMemorySize = 16*1024*1024;
+	size_t TempMemorySize = 64*1024*1024;
+	void *GameMemory = malloc(GameMemorySize);
+	void *TempMemory = malloc(TempMemorySize);
+	memory_arena GameArena, TempArena;
+	InitializeArena(&GameArena, GameMemorySize, GameMemory);
+	InitializeArena(&TempArena, TempMemorySize, TempMemory);
+
+	v3 *Source = PushArray(&TempArena, PixelCount, v3);
+	v3 *Temp = PushArray(&TempArena, PixelCount, v3);
+	v3 *Blurred = PushArray(&TempArena, PixelCount, v3);
+	real32 *Depths = PushArray(&TempArena, PixelCount, real32);
+	v3 *Normals = PushArray(&TempArena, PixelCount, v3);
+
+	// NOTE(georgy): A constant image stays the same whatever the guides are, every texel's weights add up to one
+	{
+		uint32_t RandomState = 1234;
+		for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+		{
+			Source[Pixel] = V3(0.25f, 0.5f, 1.0f);
+			Depths[Pixel] = 0.05f + 0.9f*SceneBenchRandomUnilateral(&RandomState);
+			Normals[Pixel] = Normalize(V3(SceneBenchRandomUnilateral(&RandomState) - 0.5f, SceneBenchRandomUnilateral(&RandomState) - 0.5f, -1.0f));
+		}
+		real32 MaxDifference = 0.0f;
+		for(int32_t Radius = 1; Radius <= DEPTH_AWARE_BLUR_MAX_RADIUS; Radius++)
+		{
+			DepthAwareBlur(Blurred, Temp, Source, Depths, Normals, Width, Height, Radius);
+			MaxDifference = fmaxf(MaxDifference, GetBenchBlurDifference(Blurred, Source, PixelCount));
+		}
+		printf("blur: constant image with random guides, max relative change %g\n", MaxDifference);
+		Assert(MaxDifference < 1e-5f);
+	}
+
+	// NOTE(georgy): With flat guides it is the 2D gaussian, the two passes are exactly the separable kernel
+	{
+		uint32_t RandomState = 4321;
+		for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+		{
+			Source[Pixel] = V3(SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState));
+			Depths[Pixel] = 0.5f;
+			Normals[Pixel] = V3(0.0f, 0.0f, -1.0f);
+		}
+		real32 MaxDifference = 0.0f;
+		for(int32_t Radius = 1; Radius <= DEPTH_AWARE_BLUR_MAX_RADIUS; Radius++)
+		{
+			DepthAwareBlur(Blurred, Temp, Source, Depths, Normals, Width, Height, Radius);
+
+			real32 Sigma = DepthAwareBlurConstants(1, 0, Radius).Sigma;
+			for(int32_t Y = Radius; Y < (int32_t)Height - Radius; Y++)
+			{
+				for(int32_t X = Radius; X < (int32_t)Width - Radius; X++)
+				{
+					v3 Sum = V3(0.0f, 0.0f, 0.0f);
+					real32 WeightSum = 0.0f;
+					for(int32_t TapY = -Radius; TapY <= Radius; TapY++)
+					{
+						for(int32_t TapX = -Radius; TapX <= Radius; TapX++)
+						{
+							real32 Weight = expf(-(real32)(TapX*TapX + TapY*TapY) / (2.0f*Sigma*Sigma));
+							Sum += Weight*Source[(Y + TapY)*Width + X + TapX];
+							WeightSum += Weight;
+						}
+					}
+					v3 Gaussian = (1.0f / WeightSum)*Sum;
+					MaxDifference = fmaxf(MaxDifference, GetBenchBlurDifference(Blurred + Y*Width + X, &Gaussian, 1));
+				}
+			}
+		}
+		printf("blur: flat guides against the 2D gaussian, max relative difference %g\n", MaxDifference);
+		Assert(MaxDifference < 1e-4f);
+	}
+
+	// NOTE(georgy): Two planes meeting at a vertical depth step and a horizontal crease. Nothing crosses either of them,
+	// while the box mixes them for two texels on each side.
+	{
+		v3 Colors[3] = {V3(1.0f, 0.0f, 0.0f), V3(0.0f, 1.0f, 0.0f), V3(0.0f, 0.0f, 1.0f)};
+		uint32_t *Regions = PushArray(&TempArena, PixelCount, uint32_t);
+		for(uint32_t Y = 0; Y < Height; Y++)
+		{
+			for(uint32_t X = 0; X < Width; X++)
+			{
+				uint32_t Pixel = Y*Width + X;
+				Regions[Pixel] = (X < Width / 2) ? 0 : ((Y < Height / 2) ? 1 : 2);
+				Source[Pixel] = Colors[Regions[Pixel]];
+				Depths[Pixel] = (Regions[Pixel] == 0) ? 0.2f : 0.5f;
+				Normals[Pixel] = (Regions[Pixel] == 2) ? V3(0.0f, 1.0f, 0.0f) : V3(0.0f, 0.0f, -1.0f);
+			}
+		}
+
+		real32 MaxBleed = 0.0f;
+		for(int32_t Radius = 1; Radius <= DEPTH_AWARE_BLUR_MAX_RADIUS; Radius++)
+		{
+			DepthAwareBlur(Blurred, Temp, Source, Depths, Normals, Width, Height, Radius);
+			for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+			{
+				v3 Bleed = Blurred[Pixel] - Colors[Regions[Pixel]];
+				MaxBleed = fmaxf(MaxBleed, fmaxf(fmaxf(fabsf(Bleed.x), fabsf(Bleed.y)), fabsf(Bleed.z)));
+			}
+		}
+
+		BlurBenchRSM(Source, Blurred, Width, Height);
+		real32 BoxBleed = 0.0f;
+		for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+		{
+			v3 Bleed = Blurred[Pixel] - Colors[Regions[Pixel]];
+			BoxBleed = fmaxf(BoxBleed, fmaxf(fmaxf(fabsf(Bleed.x), fabsf(Bleed.y)), fabsf(Bleed.z)));
+		}
+		printf("blur: depth step and crease, max bleed %g (box %g)\n", MaxBleed, BoxBleed);
+		Assert(MaxBleed < 1e-3f);
+		Assert(BoxBleed > 0.5f);
+	}
+
+	// NOTE(georgy): The renderer's gather of the bunny scene, one frame and accumulated over FrameCount frames
+	game_state GameState;
+	triangle_bvh BunnyBVH, QuadBVH;
+	path_tracer_scene PathTracer;
+	InitializeBenchPathTracerScene(&GameState, &BunnyBVH, &QuadBVH, &PathTracer, Width, Height, &GameArena, &TempArena);
+
+	bench_temporal Temporal;
+	InitializeBenchTemporal(&Temporal, &PathTracer, Width, Height, &TempArena);
+	RunBenchTemporal(&Temporal, &GameState, &PathTracer, RENDERER_RSM_SAMPLE_COUNT, 0.0f, FrameCount);
+
+	bench_rsm_receiver *Receivers = Temporal.Receivers;
+	for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+	{
+		Depths[Pixel] = Receivers[Pixel].LinearDepth;
+		Normals[Pixel] = Receivers[Pixel].Normal;
+	}
+
+	// NOTE(georgy): Receivers near an edge, where a 5x5 neighbourhood has a different surface or the background
+	bench_rsm_receiver *EdgeReceivers = PushArray(&TempArena, PixelCount, bench_rsm_receiver, true);
+	for(int32_t Y = 0; Y < (int32_t)Height; Y++)
+	{
+		for(int32_t X = 0; X < (int32_t)Width; X++)
+		{
+			uint32_t Pixel = Y*Width + X;
+			bool Edge = false;
+			for(int32_t NY = Y - 2; NY <= Y + 2; NY++)
+			{
+				for(int32_t NX = X - 2; NX <= X + 2; NX++)
+				{
+					if((NX >= 0) && (NY >= 0) && (NX < (int32_t)Width) && (NY < (int32_t)Height))
+					{
+						uint32_t Neighbour = NY*Width + NX;
+						Edge = Edge || (GetDepthAwareBlurWeight(Depths[Pixel], Normals[Pixel], Depths[Neighbour], Normals[Neighbour]) < 0.5f);
+					}
+				}
+			}
+			EdgeReceivers[Pixel] = Receivers[Pixel];
+			EdgeReceivers[Pixel].Valid = Receivers[Pixel].Valid && Edge;
+		}
+	}
+
+	printf("blur: %ux%u pixels, %u samples. RMS error against the exact gather in 8 bit levels after tone mapping, all receivers / near edges:\n",
+		   Width, Height, RENDERER_RSM_SAMPLE_COUNT);
+	printf("blur: %-12s %5s | %-15s | %-15s\n", "", "taps", "one frame", "accumulated");
+
+	v3 *Images[2] = {Temporal.Image, Temporal.Accumulated};
+	real32 Errors[2 + DEPTH_AWARE_BLUR_MAX_RADIUS][2][2];
+	for(uint32_t Filter = 0; Filter < 6; Filter++)
+	{
+		char FilterName[32];
+		uint32_t TapCount;
+		if(Filter == 0)
+		{
+			snprintf(FilterName, sizeof(FilterName), "none");
+			TapCount = 1;
+		}
+		else if(Filter == 1)
+		{
+			snprintf(FilterName, sizeof(FilterName), "box 4x4");
+			TapCount = 16;
+		}
+		else
+		{
+			snprintf(FilterName, sizeof(FilterName), "aware r=%u", Filter - 1);
+			TapCount = 2*(2*(Filter - 1) + 1);
+		}
+
+		for(uint32_t ImageIndex = 0; ImageIndex < 2; ImageIndex++)
+		{
+			v3 *Image = Images[ImageIndex];
+			if(Filter == 0)
+			{
+				memcpy(Blurred, Image, PixelCount*sizeof(v3));
+			}
+			else if(Filter == 1)
+			{
+				BlurBenchRSM(Image, Blurred, Width, Height);
+			}
+			else
+			{
+				DepthAwareBlur(Blurred, Temp, Image, Depths, Normals, Width, Height, Filter - 1);
+			}
+			Errors[Filter][ImageIndex][0] = GetBenchRSMError(Blurred, Temporal.Reference, Receivers, PixelCount);
+			Errors[Filter][ImageIndex][1] = GetBenchRSMError(Blurred, Temporal.Reference, EdgeReceivers, PixelCount);
+		}
+
+		printf("blur: %-12s %5u | %6.2f / %6.2f | %6.2f / %6.2f\n", FilterName, TapCount,
+			   Errors[Filter][0][0], Errors[Filter][0][1], Errors[Filter][1][0], Errors[Filter][1][1]);
+	}
+
+	// NOTE(georgy): The blur runs after accumulation, where the renderer's radius has to beat both no blur and the box.
+	// On a single frame a wide box still wins, it averages more noise away than it smears over edges.
+	uint32_t RendererFilter = 1 + RENDERER_RSM_BLUR_RADIUS;
+	Assert(Errors[RendererFilter][1][0] < Errors[0][1][0]);
+	Assert(Errors[RendererFilter][1][0] < Errors[1][1][0]);
+	Assert(Errors[RendererFilter][1][1] < Errors[1][1][1]);
+
+	free(GameMemory);
+	free(TempMemory);
+}
+
+//
+// NOTE(georgy): Depth prepass
+//
+
+// NOTE(georgy): Software z-buffer for the renderer's G-buffer draws. A fragment that passes the depth test is a pixel shader
+// invocation (GBufferPS doesn't write depth, so the test happens before it), that's what the null backend can't count.
+struct bench_raster
+{
+	uint32_t Width, Height;
+	real32 *Depths;
+	bool DepthEqual;
+
+	uint64_t VertexCount;
+	uint64_t RasterizedCount;
+	uint64_t PassedCount;
+};
+
+// NOTE(georgy): Of the two triangles sharing an edge, the one it goes up (or right) in owns the pixel centers exactly on it
+inline bool
+IsInsideBenchRasterEdge(real32 Edge, real32 EdgeX, real32 EdgeY)
+{
+	bool Result = (Edge > 0.0f) || ((Edge == 0.0f) && ((EdgeY > 0.0f) || ((EdgeY == 0.0f) && (EdgeX > 0.0f))));
+	return(Result);
+}
+
+// NOTE(georgy): Vertices are in pixels, Z is the depth buffer value. Culling is off in the renderer, so both windings are drawn.
+static void
+BenchRasterTriangle(bench_raster *Raster, v3 A, v3 B, v3 C)
+{
+	real32 Area = (B.x - A.x)*(C.y - A.y) - (B.y - A.y)*(C.x - A.x);
+	if(Area < 0.0f)
+	{
+		v3 Temp = B;
+		B = C;
+		C = Temp;
+		Area = -Area;
+	}
+
+	if(Area > 0.0f)
+	{
+		int32_t MinX = (int32_t)floorf(fminf(A.x, fminf(B.x, C.x)));
+		int32_t MinY = (int32_t)floorf(fminf(A.y, fminf(B.y, C.y)));
+		int32_t MaxX = (int32_t)ceilf(fmaxf(A.x, fmaxf(B.x, C.x)));
+		int32_t MaxY = (int32_t)ceilf(fmaxf(A.y, fmaxf(B.y, C.y)));
+		MinX = (MinX < 0) ? 0 : MinX;
+		MinY = (MinY < 0) ? 0 : MinY;
+		MaxX = (MaxX >= (int32_t)Raster->Width) ? (int32_t)Raster->Width - 1 : MaxX;
+		MaxY = (MaxY >= (int32_t)Raster->Height) ? (int32_t)Raster->Height - 1 : MaxY;
+
+		for(int32_t Y = MinY; Y <= MaxY; Y++)
+		{
+			for(int32_t X = MinX; X <= MaxX; X++)
+			{
+				real32 PX = X + 0.5f;
+				real32 PY = Y + 0.5f;
+				real32 EdgeA = (C.x - B.x)*(PY - B.y) - (C.y - B.y)*(PX - B.x);
+				real32 EdgeB = (A.x - C.x)*(PY - C.y) - (A.y - C.y)*(PX - C.x);
+				real32 EdgeC = (B.x - A.x)*(PY - A.y) - (B.y - A.y)*(PX - A.x);
+				if(IsInsideBenchRasterEdge(EdgeA, C.x - B.x, C.y - B.y) &&
+				   IsInsideBenchRasterEdge(EdgeB, A.x - C.x, A.y - C.y) &&
+				   IsInsideBenchRasterEdge(EdgeC, B.x - A.x, B.y - A.y))
+				{
+					real32 Z = (EdgeA*A.z + EdgeB*B.z + EdgeC*C.z) / Area;
+					real32 *Depth = Raster->Depths + Y*Raster->Width + X;
+
+					Raster->RasterizedCount++;
+					if(Raster->DepthEqual ? (Z == *Depth) : (Z < *Depth))
+					{
+						Raster->PassedCount++;
+						*Depth = Z;
+					}
+				}
+			}
+		}
+	}
+}
+
+// NOTE(georgy): Clipped against the near plane (Z >= 0 in clip space), the screen bounds take care of the rest
+static void
+BenchRasterClipTriangle(bench_raster *Raster, v4 *Clip)
+{
+	v4 Polygon[4];
+	uint32_t Count = 0;
+	for(uint32_t Vertex = 0; Vertex < 3; Vertex++)
+	{
+		v4 P = Clip[Vertex];
+		v4 Q = Clip[(Vertex + 1) % 3];
+		if(P.z >= 0.0f)
+		{
+			Polygon[Count++] = P;
+		}
+		if((P.z >= 0.0f) != (Q.z >= 0.0f))
+		{
+			Polygon[Count++] = P + (P.z / (P.z - Q.z))*(Q - P);
+		}
+	}
+
+	v3 Screen[4];
+	for(uint32_t Vertex = 0; Vertex < Count; Vertex++)
+	{
+		v4 P = Polygon[Vertex];
+		Screen[Vertex] = V3((0.5f*P.x / P.w + 0.5f)*Raster->Width, (-0.5f*P.y / P.w + 0.5f)*Raster->Height, P.z / P.w);
+	}
+	for(uint32_t Vertex = 2; Vertex < Count; Vertex++)
+	{
+		BenchRasterTriangle(Raster, Screen[0], Screen[Vertex - 1], Screen[Vertex]);
+	}
+}
+
+struct bench_raster_mesh
+{
+	vertex *Vertices;
+	uint32_t *Indices;
+	uint32_t IndexCount;
+};
+
+// NOTE(georgy): The G-buffer views' batches and instances exactly as the renderer wrote them for the null backend,
+// or everything the other way around (back to front)
+static void
+BenchRasterGBufferViews(bench_raster *Raster, renderer *Renderer, bench_raster_mesh *Meshes, bool Reverse)
+{
+	instance_data *Instances = (instance_data *)(((null_buffer *)Renderer->InstanceRing.Buffer)->Memory + Renderer->Instances.Offset);
+	for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+	{
+		if(Renderer->Views[View].Pass == RenderPass_GBuffer)
+		{
+			mat4 ViewProjection = Renderer->Views[View].View * Renderer->Views[View].Projection;
+			uint32_t FirstBatch = Renderer->ViewFirstBatch[View];
+			uint32_t BatchCount = Renderer->ViewFirstBatch[View + 1] - FirstBatch;
+			for(uint32_t BatchStep = 0; BatchStep < BatchCount; BatchStep++)
+			{
+				instance_batch *Batch = Renderer->Batches + FirstBatch + (Reverse ? (BatchCount - 1 - BatchStep) : BatchStep);
+				bench_raster_mesh *Mesh = Meshes + Batch->Mesh;
+				for(uint32_t InstanceStep = 0; InstanceStep < Batch->InstanceCount; InstanceStep++)
+				{
+					instance_data *Instance = Instances + Batch->FirstInstance + (Reverse ? (Batch->InstanceCount - 1 - InstanceStep) : InstanceStep);
+					mat4 ModelViewProjection = Instance->Model * ViewProjection;
+					Raster->VertexCount += Mesh->IndexCount;
+					for(uint32_t Index = 0; Index < Mesh->IndexCount; Index += 3)
+					{
+						v4 Clip[3];
+						for(uint32_t Vertex = 0; Vertex < 3; Vertex++)
+						{
+							Clip[Vertex] = V4(Mesh->Vertices[Mesh->Indices[Index + Vertex]].Pos, 1.0f) * ModelViewProjection;
+						}
+						BenchRasterClipTriangle(Raster, Clip);
+					}
+				}
+			}
+		}
+	}
+}
+
+struct bench_prepass_counts
+{
+	uint64_t FrameCount;
+	uint64_t CoveredPixels;
+	uint64_t Vertices;
+	uint64_t Rasterized;
+	// NOTE(georgy): Pixel shader invocations of the G-buffer pass
+	uint64_t ShadedBackToFront;
+	uint64_t ShadedWithoutPrepass;
+	uint64_t ShadedWithPrepass;
+};
+
+inline void
+ClearBenchRaster(bench_raster *Raster, bool DepthEqual)
+{
+	if(!DepthEqual)
+	{
+		for(uint32_t Pixel = 0; Pixel < Raster->Width*Raster->Height; Pixel++)
+		{
+			Raster->Depths[Pixel] = 1.0f;
+		}
+	}
+	Raster->DepthEqual = DepthEqual;
+	Raster->VertexCount = 0;
+	Raster->RasterizedCount = 0;
+	Raster->PassedCount = 0;
+}
+
+// NOTE(georgy): The frame the renderer just drew, without the prepass (depth test less), and with it (the same draws
+// fill the depth buffer first, then the G-buffer pass only shades where its depth is equal)
+static void
+CountBenchPrepassFrame(bench_raster *Raster, renderer *Renderer, bench_raster_mesh *Meshes, bench_prepass_counts *Counts)
+{
+	ClearBenchRaster(Raster, false);
+	BenchRasterGBufferViews(Raster, Renderer, Meshes, true);
+	Counts->ShadedBackToFront += Raster->PassedCount;
+
+	ClearBenchRaster(Raster, false);
+	BenchRasterGBufferViews(Raster, Renderer, Meshes, false);
+	Counts->ShadedWithoutPrepass += Raster->PassedCount;
+	Counts->Vertices += Raster->VertexCount;
+	Counts->Rasterized += Raster->RasterizedCount;
+
+	uint64_t CoveredPixels = 0;
+	for(uint32_t Pixel = 0; Pixel < Raster->Width*Raster->Height; Pixel++)
+	{
+		CoveredPixels += (Raster->Depths[Pixel] < 1.0f) ? 1 : 0;
+	}
+	Counts->CoveredPixels += CoveredPixels;
+
+	ClearBenchRaster(Raster, true);
+	BenchRasterGBufferViews(Raster, Renderer, Meshes, false);
+	Counts->ShadedWithPrepass += Raster->PassedCount;
+	Counts->FrameCount++;
+
+	// NOTE(georgy): Every covered pixel once. Where two surfaces meet at exactly the same depth both are shaded, the same as on the GPU.
+	Assert((Raster->PassedCount >= CoveredPixels) && (Raster->PassedCount - CoveredPixels <= CoveredPixels / 1000));
+}
+
+// NOTE(georgy): The prepass transforms the G-buffer pass' vertices once more
+static void
+PrintBenchPrepassCounts(const char *Scene, bench_prepass_counts *Counts)
+{
+	real64 Covered = (real64)Counts->CoveredPixels;
+	printf("prepass: %-6s %4.1f%% of the pixels covered, %.2f fragments/pixel rasterized, shaded back to front %.2f, "
+		   "front to back %.2f, with the prepass %.2f (%.0f%% saved for %.0f more vertices/frame)\n",
+		   Scene, 100.0*Covered / ((real64)Counts->FrameCount*960*540), Counts->Rasterized / Covered,
+		   Counts->ShadedBackToFront / Covered, Counts->ShadedWithoutPrepass / Covered, Counts->ShadedWithPrepass / Covered,
+		   100.0*(1.0 - (real64)Counts->ShadedWithPrepass / Counts->ShadedWithoutPrepass), (real64)Counts->Vertices / Counts->FrameCount);
+}
+
+// NOTE(georgy): Checks that the low tier draws the G-buffer the way it always did and the high tier puts a depth only pass
+// with the same draws in front of it, then counts the pixel shader invocations the prepass saves on the game scene
+// and on rows of props behind each other
+static void
+BenchDepthPrepass(void)
+{
+	const uint32_t FrameCount = 64;
+	const uint32_t Width = 960, Height = 540;
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GraphicsMemorySize = 16*1024*1024;
+	size_t FrameMemorySize = MAX_FRAME_PACKET_OBJECTS*sizeof(render_object) + 64*1024;
+	size_t GameMemorySize = 2*1024*1024;
+	size_t TotalMemorySize = GraphicsMemorySize + FrameMemorySize + GameMemorySize;
+	void *Memory = malloc(TotalMemorySize);
+	memory_arena PermanentArena;
+	InitializeArena(&PermanentArena, TotalMemorySize, Memory);
+	memory_arena GraphicsArena, FrameArena, GameArena;
+	SubArena(&GraphicsArena, &PermanentArena, GraphicsMemorySize);
+	SubArena(&FrameArena, &PermanentArena, FrameMemorySize);
+	SubArena(&GameArena, &PermanentArena, GameMemorySize);
+
+	std::vector<vertex> SphereVertexArray;
+	std::vector<uint32_t> SphereIndexArray;
+	GenerateSphere(SphereVertexArray, SphereIndexArray, 32, 64);
+	mesh SphereMesh = {0, (uint32_t)SphereIndexArray.size(), 0};
+
+	bench_raster_mesh Meshes[RenderMesh_Count];
+	Meshes[RenderMesh_Bunny] = {&SphereVertexArray[0], &SphereIndexArray[0], (uint32_t)SphereIndexArray.size()};
+	Meshes[RenderMesh_Quad] = {QuadVertices, QuadIndices, ArrayCount(QuadIndices)};
+
+	bench_raster Raster = {};
+	Raster.Width = Width;
+	Raster.Height = Height;
+	Raster.Depths = (real32 *)malloc(Width*Height*sizeof(real32));
+
+	uint64_t CallCounts[2][GraphicsCall_Count];
+	gfx_pipeline_statistics GBufferStatistics[2];
+	gfx_pipeline_statistics PrepassStatistics = {};
+	bench_prepass_counts GameCounts = {};
+	bench_prepass_counts PropsCounts = {};
+	renderer *Renderer = &GlobalRenderer;
+	for(uint32_t Tier = 0; Tier < 2; Tier++)
+	{
+		renderer_quality Quality = (Tier == 0) ? RendererQuality_Low : RendererQuality_High;
+
+		ResetArena(&GraphicsArena);
+		null_graphics NullGraphics;
+		graphics_device GraphicsDevice;
+		graphics_context GraphicsContext;
+		InitializeNullGraphics(&NullGraphics, &GraphicsArena, &GraphicsDevice, &GraphicsContext);
+
+		texture_desc BackBufferDesc = TextureDesc(Width, Height, TextureFormat_RGBA8, TextureBind_RenderTarget);
+		gfx_texture *BackBuffer = GraphicsDevice.CreateTexture(&GraphicsDevice, &BackBufferDesc, "BackBuffer");
+		InitializeRenderer(Renderer, &GraphicsDevice, Width, Height, BackBuffer, Quality);
+		Renderer->BunnyModel.Meshes.clear();
+		Renderer->BunnyModel.Meshes.push_back(SphereMesh);
+		UploadModel(&GraphicsDevice, &Renderer->BunnyModel, &SphereVertexArray[0], (uint32_t)SphereVertexArray.size(), &SphereIndexArray[0]);
+
+		frame_graph *Graph = &Renderer->FrameGraph;
+		if(Renderer->Settings.DepthPrepass)
+		{
+			Assert(Graph->PassCount == 10);
+			Assert(IsFrameGraphPassActive(Graph, Renderer->Graph.DepthPrepass));
+			Assert(Graph->Resources[Renderer->Graph.Depth].Writer == Renderer->Graph.DepthPrepass);
+		}
+		else
+		{
+			Assert(Graph->PassCount == 8);
+			Assert(Renderer->Graph.DepthPrepass == FRAME_GRAPH_INVALID_INDEX);
+			Assert(Renderer->Graph.ShadowMomentsPass == FRAME_GRAPH_INVALID_INDEX);
+			Assert(Graph->Resources[Renderer->Graph.Depth].Writer == Renderer->Graph.GBufferPass);
+		}
+
+		ResetArena(&GameArena);
+		game_state GameState;
+		InitializeGame(&GameState, Width, Height, &GameArena);
+
+		// NOTE(georgy): Looking around the game scene
+		frame_packet Packet;
+		game_input GameInput = {};
+		for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+		{
+			GameInput.DeltaMouseX = ((FrameIndex / 16) & 1) ? -4 : 4;
+			UpdateGame(&GameState, &GameInput, 0.0001f);
+
+			ResetArena(&FrameArena);
+			FillFramePacket(&GameState, &Packet, &FrameArena);
+			RenderScenePasses(Renderer, &GraphicsContext, &Packet);
+			RenderPostPasses(Renderer, &GraphicsContext);
+
+			if(Renderer->Settings.DepthPrepass)
+			{
+				CountBenchPrepassFrame(&Raster, Renderer, Meshes, &GameCounts);
+			}
+		}
+		memcpy(CallCounts[Tier], NullGraphics.CallCounts, sizeof(CallCounts[Tier]));
+		GBufferStatistics[Tier] = Renderer->PassStatistics[Renderer->Graph.GBufferPass];
+		Assert(Renderer->PassStatisticsFrames[Renderer->Graph.GBufferPass] == Renderer->FrameIndex - 1 - RENDERER_QUERY_LATENCY);
+		if(Renderer->Settings.DepthPrepass)
+		{
+			PrepassStatistics = Renderer->PassStatistics[Renderer->Graph.DepthPrepass];
+			Assert(Renderer->PassStatisticsFrames[Renderer->Graph.DepthPrepass] == Renderer->PassStatisticsFrames[Renderer->Graph.GBufferPass]);
+		}
+
+		// NOTE(georgy): Rows of quads and spheres, one behind the other down the view. They move every frame, so they're dynamic.
+		if(Renderer->Settings.DepthPrepass)
+		{
+			for(uint32_t FrameIndex = 0; FrameIndex < 4; FrameIndex++)
+			{
+				ResetArena(&FrameArena);
+				FillFramePacket(&GameState, &Packet, &FrameArena);
+				Packet.ObjectCount = 0;
+				for(uint32_t ObjectIndex = 0; ObjectIndex < 512; ObjectIndex++)
+				{
+					render_mesh Mesh = ((ObjectIndex % 3) == 0) ? RenderMesh_Bunny : RenderMesh_Quad;
+					v3 Position = V3(2.5f*(real32)(ObjectIndex % 8) - 8.75f + 0.25f*FrameIndex, 1.0f, 0.5f*(real32)(ObjectIndex / 8));
+					v3 BoundsExtent = (Mesh == RenderMesh_Bunny) ? V3(0.5f, 0.5f, 0.5f) : V3(1.0f, 1.0f, 0.0f);
+					PushRenderObject(&Packet, Mesh, Translate(Position), V3(1.0f, 1.0f, 1.0f), Position, BoundsExtent, true);
+				}
+				RenderScenePasses(Renderer, &GraphicsContext, &Packet);
+				RenderPostPasses(Renderer, &GraphicsContext);
+
+				CountBenchPrepassFrame(&Raster, Renderer, Meshes, &PropsCounts);
+			}
+		}
+	}
+
+	// NOTE(georgy): The high tier does the G-buffer draws once more, and clears depth as often (in the prepass instead).
+	// It has one more pass for the shadow moments too.
+	printf("prepass: low tier %.1f instanced draws/frame, high tier %.1f\n",
+		   (real64)CallCounts[0][GraphicsCall_DrawIndexedInstanced] / FrameCount, (real64)CallCounts[1][GraphicsCall_DrawIndexedInstanced] / FrameCount);
+	Assert(CallCounts[0][GraphicsCall_ClearDepthStencilView] == CallCounts[1][GraphicsCall_ClearDepthStencilView]);
+	Assert(CallCounts[1][GraphicsCall_Begin] == CallCounts[0][GraphicsCall_Begin] + 2*FrameCount);
+	Assert(CallCounts[1][GraphicsCall_DrawIndexedInstanced] > CallCounts[0][GraphicsCall_DrawIndexedInstanced]);
+
+	// NOTE(georgy): Pass statistics came back through the queries, the prepass has exactly the G-buffer pass' vertex work
+	Assert(GBufferStatistics[0].VSInvocations > 0);
+	Assert(GBufferStatistics[1].VSInvocations == GBufferStatistics[0].VSInvocations);
+	Assert(PrepassStatistics.VSInvocations == GBufferStatistics[1].VSInvocations);
+	Assert(PrepassStatistics.IAPrimitives == GBufferStatistics[1].IAPrimitives);
+
+	PrintBenchPrepassCounts("game", &GameCounts);
+	PrintBenchPrepassCounts("props", &PropsCounts);
+	Assert(GameCounts.ShadedWithPrepass <= GameCounts.ShadedWithoutPrepass);
+	Assert(PropsCounts.ShadedWithPrepass < PropsCounts.ShadedWithoutPrepass);
+	Assert(PropsCounts.ShadedWithoutPrepass < PropsCounts.ShadedBackToFront);
+
+	free(Raster.Depths);
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Shadow cascades
+//
+
+// NOTE(georgy): World position at view space depth Depth, U and V (0 to 1) across the frustum like the far corners are
+inline v3
+GetBenchFrustumPoint(v4 *FarCorners, mat4 CameraView, real32 U, real32 V, real32 Depth)
+{
+	v3 Top = FarCorners[0].xyz + U*(FarCorners[2].xyz - FarCorners[0].xyz);
+	v3 Bottom = FarCorners[1].xyz + U*(FarCorners[3].xyz - FarCorners[1].xyz);
+	v3 ViewPos = (Depth / FarCorners[0].w)*(Top + V*(Bottom - Top));
+	v3 Result = (V4(ViewPos, 1.0f) * InverseAffine(CameraView)).xyz;
+	return(Result);
+}
+
+inline mat4
+GetBenchCascadeCamera(v3 Position, real32 Head, real32 Pitch)
+{
+	v3 Front = V3(sinf(DEG2RAD(Head))*cosf(DEG2RAD(Pitch)), sinf(-DEG2RAD(Pitch)), cosf(DEG2RAD(Head))*cosf(DEG2RAD(Pitch)));
+	mat4 Result = LookAt(Position, Position + Front);
+	return(Result);
+}
+
+// NOTE(georgy): Where a world position is in the cascade's texels, without snapping the same cascade would start at the slice's Min
+inline v2
+GetBenchCascadeTexel(shadow_cascades *Cascades, uint32_t Cascade, v3 WorldPos)
+{
+	v3 AtlasPos = GetShadowCascadeAtlasPos(Cascades, Cascade, WorldPos);
+	shadow_atlas_rect Tile = Cascades->Cascades[Cascade].Tile;
+	v2 Result = V2(AtlasPos.x*Cascades->AtlasSize - Tile.X, AtlasPos.y*Cascades->AtlasSize - Tile.Y);
+	return(Result);
+}
+
+// NOTE(georgy): X texel of the same cascade if it started exactly at the slice's light space Min
+inline real32
+GetBenchUnsnappedTexel(shadow_cascades *Cascades, uint32_t Cascade, v4 *FarCorners, mat4 CameraView, v3 WorldPos)
+{
+	shadow_cascade *Fit = Cascades->Cascades + Cascade;
+	v3 Corners[8];
+	GetFrustumSliceCorners(FarCorners, CameraView, Fit->SplitNear, Fit->SplitFar, Corners);
+	real32 MinX = FLT_MAX;
+	for(uint32_t Corner = 0; Corner < 8; Corner++)
+	{
+		MinX = fminf(MinX, (V4(Corners[Corner], 1.0f) * Cascades->LightView).x);
+	}
+
+	real32 Result = ((V4(WorldPos, 1.0f) * Cascades->LightView).x - MinX) / Fit->TexelSize;
+	return(Result);
+}
+
+inline real32
+GetBenchTexelFraction(real32 Texel)
+{
+	real32 Result = Texel - floorf(Texel);
+	return(Result);
+}
+
+static void
+BenchShadowCascades(void)
+{
+	// NOTE(georgy): The window's size, the fixed shadow map had its resolution
+	const uint32_t Width = 960, Height = 540;
+	const uint32_t PoseCount = 2000;
+	const uint32_t PointCount = 64;
+	const uint32_t FrameCount = 1000;
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GameMemorySize = 16*1024*1024;
+	void *GameMemory = malloc(GameMemorySize);
+	memory_arena GameArena;
+	InitializeArena(&GameArena, GameMemorySize, GameMemory);
+
+	game_state GameState;
+	InitializeGame(&GameState, Width, Height, &GameArena);
+	v4 *FarCorners = GameState.FrustumFarCornersWorldSpace;
+	real32 Near = GameState.NearDistance;
+	real32 ShadowDistance = fminf(GAME_SHADOW_DISTANCE, GameState.FarDistance);
+	aabb CasterBounds = GameState.SceneTree.Nodes[GameState.SceneTree.Root].Box;
+	mat4 LightView = LookAt(GAME_SUN_POSITION, V3(0.0f, 0.0f, 0.0f));
+
+	// NOTE(georgy): Splits. Lambda 0 is evenly spaced, 1 has the same ratio between neighbours, and a blend is between the two.
+	real32 Uniform[SHADOW_CASCADE_COUNT + 1], Logarithmic[SHADOW_CASCADE_COUNT + 1], Splits[SHADOW_CASCADE_COUNT + 1];
+	GetShadowCascadeSplits(Near, ShadowDistance, SHADOW_CASCADE_COUNT, 0.0f, Uniform);
+	GetShadowCascadeSplits(Near, ShadowDistance, SHADOW_CASCADE_COUNT, 1.0f, Logarithmic);
+	GetShadowCascadeSplits(Near, ShadowDistance, SHADOW_CASCADE_COUNT, SHADOW_CASCADE_SPLIT_LAMBDA, Splits);
+	for(uint32_t Split = 0; Split <= SHADOW_CASCADE_COUNT; Split++)
+	{
+		Assert(SceneBenchClose(Uniform[Split], Near + (ShadowDistance - Near)*Split / SHADOW_CASCADE_COUNT));
+		Assert(SceneBenchClose(Logarithmic[Split], Near*powf(ShadowDistance / Near, (real32)Split / SHADOW_CASCADE_COUNT)));
+		Assert((Logarithmic[Split] <= Splits[Split] + 1e-5f) && (Splits[Split] <= Uniform[Split] + 1e-5f));
+		if(Split > 0)
+		{
+			Assert(SceneBenchClose(Logarithmic[Split] / Logarithmic[Split - 1], Logarithmic[1] / Logarithmic[0]));
+			Assert(Splits[Split] > Splits[Split - 1]);
+		}
+	}
+	Assert((Splits[0] == Near) && (Splits[SHADOW_CASCADE_COUNT] == ShadowDistance));
+	printf("cascades: splits");
+	for(uint32_t Split = 0; Split <= SHADOW_CASCADE_COUNT; Split++)
+	{
+		printf(" %.2f", Splits[Split]);
+	}
+	printf(" (lambda %.2f, uniform %.2f apart, logarithmic x%.2f)\n", SHADOW_CASCADE_SPLIT_LAMBDA, Uniform[1] - Uniform[0], Logarithmic[1] / Logarithmic[0]);
+
+	// NOTE(georgy): Fit, from random camera positions and directions. Every point of a slice is in its cascade's part of
+	// the atlas (and the shader picks that cascade for it), the casters are in front of the near plane, and the cascade
+	// is not much bigger than the slice.
+	uint32_t RandomState = 0x13579BDF;
+	real64 Utilization[SHADOW_CASCADE_COUNT] = {};
+	real32 MinUtilization = 1.0f;
+	real32 MinUtilizationExpected = 1.0f;
+	for(uint32_t Pose = 0; Pose < PoseCount; Pose++)
+	{
+		v3 Position = V3(10.0f*SceneBenchRandomUnilateral(&RandomState) - 5.0f, 5.0f*SceneBenchRandomUnilateral(&RandomState),
+						 10.0f*SceneBenchRandomUnilateral(&RandomState) - 5.0f);
+		mat4 CameraView = GetBenchCascadeCamera(Position, 360.0f*SceneBenchRandomUnilateral(&RandomState), 178.0f*SceneBenchRandomUnilateral(&RandomState) - 89.0f);
+
+		shadow_cascades Cascades;
+		BuildSunShadowCascades(&GameState, CameraView, LightView, &Cascades);
+		for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+		{
+			shadow_cascade *Fit = Cascades.Cascades + Cascade;
+			Assert((Fit->SplitNear == Splits[Cascade]) && (Fit->SplitFar == Splits[Cascade + 1]));
+
+			v3 Corners[8];
+			GetFrustumSliceCorners(FarCorners, CameraView, Fit->SplitNear, Fit->SplitFar, Corners);
+			v2 Min = V2(FLT_MAX, FLT_MAX), Max = V2(-FLT_MAX, -FLT_MAX);
+			for(uint32_t Corner = 0; Corner < 8; Corner++)
+			{
+				v2 Texel = GetBenchCascadeTexel(&Cascades, Cascade, Corners[Corner]);
+				real32 Depth = GetShadowCascadeAtlasPos(&Cascades, Cascade, Corners[Corner]).z;
+				Assert((Texel.x >= -1e-3f) && (Texel.x <= Fit->Tile.Size + 1e-3f) && (Texel.y >= -1e-3f) && (Texel.y <= Fit->Tile.Size + 1e-3f));
+				Assert((Depth >= -1e-4f) && (Depth <= 1.0f + 1e-4f));
+				Min = V2(fminf(Min.x, Texel.x), fminf(Min.y, Texel.y));
+				Max = V2(fmaxf(Max.x, Texel.x), fmaxf(Max.y, Texel.y));
+			}
+			real32 Used = fmaxf(Max.x - Min.x, Max.y - Min.y) / Fit->Tile.Size;
+			Utilization[Cascade] += Used;
+			MinUtilization = fminf(MinUtilization, Used);
+			MinUtilizationExpected = fminf(MinUtilizationExpected, 1.0f / (1.0f + 2.0f / (1 << SHADOW_CASCADE_SIZE_STEPS)) - 2.0f / Fit->Tile.Size);
+
+			for(uint32_t Corner = 0; Corner < 8; Corner++)
+			{
+				v3 P = V3((Corner & 1) ? CasterBounds.Max.x : CasterBounds.Min.x,
+						  (Corner & 2) ? CasterBounds.Max.y : CasterBounds.Min.y,
+						  (Corner & 4) ? CasterBounds.Max.z : CasterBounds.Min.z);
+				Assert(GetShadowCascadeAtlasPos(&Cascades, Cascade, P).z >= -1e-4f);
+			}
+
+			for(uint32_t Point = 0; Point < PointCount; Point++)
+			{
+				real32 T = 0.001f + 0.998f*SceneBenchRandomUnilateral(&RandomState);
+				real32 Depth = Fit->SplitNear + T*(Fit->SplitFar - Fit->SplitNear);
+				v3 WorldPos = GetBenchFrustumPoint(FarCorners, CameraView, SceneBenchRandomUnilateral(&RandomState), SceneBenchRandomUnilateral(&RandomState), Depth);
+				Assert(GetShadowCascadeIndex(&Cascades, Depth) == Cascade);
+
+				v3 AtlasPos = GetShadowCascadeAtlasPos(&Cascades, Cascade, WorldPos);
+				v4 Rect = GetShadowAtlasUVRect(Fit->Tile, Cascades.AtlasSize);
+				Assert((AtlasPos.x >= Rect.x) && (AtlasPos.x <= Rect.x + Rect.z) && (AtlasPos.y >= Rect.y) && (AtlasPos.y <= Rect.y + Rect.z));
+				Assert((AtlasPos.z >= 0.0f) && (AtlasPos.z <= 1.0f));
+			}
+		}
+		Assert(GetShadowCascadeIndex(&Cascades, ShadowDistance + 1.0f) == SHADOW_CASCADE_COUNT);
+	}
+	// NOTE(georgy): Rounding adds less than a step, which is at most 2/2^SHADOW_CASCADE_SIZE_STEPS of the size, and snapping a texel
+	Assert(MinUtilization >= MinUtilizationExpected);
+	printf("cascades: %u camera poses, every slice inside its cascade, %.1f%% of the cascade used at least (", PoseCount, 100.0f*MinUtilization);
+	for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+	{
+		printf("%s%.1f%%", Cascade ? " " : "", 100.0*Utilization[Cascade] / PoseCount);
+	}
+	printf(" on average)\n");
+
+	// NOTE(georgy): Snapping. The camera moves without turning, so a fixed world position has to stay at the same spot
+	// inside its texel in every cascade. Without snapping it'd move with the slice's bounds.
+	{
+		real32 Head = 20.0f, Pitch = 15.0f;
+		v3 Position = V3(0.0f, 1.0f, -3.0f);
+		v3 Probe = V3(0.3f, 0.2f, 0.5f);
+
+		shadow_cascades Prev;
+		BuildSunShadowCascades(&GameState, GetBenchCascadeCamera(Position, Head, Pitch), LightView, &Prev);
+		uint32_t SizeChangeCount = 0;
+		uint32_t CompareCount = 0;
+		real32 MaxSnappedDrift = 0.0f;
+		real64 UnsnappedDrift = 0.0;
+		real32 PrevUnsnappedTexel[SHADOW_CASCADE_COUNT];
+		for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+		{
+			PrevUnsnappedTexel[Cascade] = GetBenchUnsnappedTexel(&Prev, Cascade, FarCorners, GetBenchCascadeCamera(Position, Head, Pitch), Probe);
+		}
+		for(uint32_t Frame = 0; Frame < FrameCount; Frame++)
+		{
+			Position += 0.01f*V3(SceneBenchRandomUnilateral(&RandomState) - 0.5f, SceneBenchRandomUnilateral(&RandomState) - 0.5f, SceneBenchRandomUnilateral(&RandomState) - 0.5f);
+			mat4 CameraView = GetBenchCascadeCamera(Position, Head, Pitch);
+
+			shadow_cascades Cascades;
+			BuildSunShadowCascades(&GameState, CameraView, LightView, &Cascades);
+			for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+			{
+				if(Cascades.Cascades[Cascade].TexelSize != Prev.Cascades[Cascade].TexelSize)
+				{
+					PrevUnsnappedTexel[Cascade] = GetBenchUnsnappedTexel(&Cascades, Cascade, FarCorners, CameraView, Probe);
+					SizeChangeCount++;
+					continue;
+				}
+
+				v2 Texel = GetBenchCascadeTexel(&Cascades, Cascade, Probe);
+				v2 PrevTexel = GetBenchCascadeTexel(&Prev, Cascade, Probe);
+				real32 Drift = fabsf(GetBenchTexelFraction(Texel.x - PrevTexel.x + 0.5f) - 0.5f) + fabsf(GetBenchTexelFraction(Texel.y - PrevTexel.y + 0.5f) - 0.5f);
+				MaxSnappedDrift = fmaxf(MaxSnappedDrift, Drift);
+
+				real32 UnsnappedTexel = GetBenchUnsnappedTexel(&Cascades, Cascade, FarCorners, CameraView, Probe);
+				UnsnappedDrift += fabsf(GetBenchTexelFraction(UnsnappedTexel - PrevUnsnappedTexel[Cascade] + 0.5f) - 0.5f);
+				PrevUnsnappedTexel[Cascade] = UnsnappedTexel;
+				CompareCount++;
+			}
+			Prev = Cascades;
+		}
+		Assert(MaxSnappedDrift < 0.01f);
+		Assert(SizeChangeCount <= FrameCount*SHADOW_CASCADE_COUNT / 100);
+		printf("cascades: %u frames of camera movement, snapped texels drift by %.4f texels at most, unsnapped would by %.3f on average, %u size changes\n",
+			   FrameCount, MaxSnappedDrift, UnsnappedDrift / CompareCount, SizeChangeCount);
+	}
+
+	// NOTE(georgy): Texel sizes from the game's camera, against the fixed shadow map that covered 5x5 units with the window's pixels
+	{
+		shadow_cascades Cascades;
+		mat4 CameraView = GetBenchCascadeCamera(GameState.CameraPos, GameState.CameraHead, GameState.CameraPitch);
+		BuildSunShadowCascades(&GameState, CameraView, LightView, &Cascades);
+		printf("cascades: game camera, texels of");
+		for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+		{
+			printf(" %.4f (%u^2 tile)", Cascades.Cascades[Cascade].TexelSize, Cascades.Cascades[Cascade].Tile.Size);
+		}
+		printf(" units, the fixed shadow map's were %.4f x %.4f\n", 5.0f / Width, 5.0f / Height);
+	}
+
+	free(GameMemory);
+}
+
+// NOTE(georgy): Every tile is inside the atlas, a power of two no bigger than it wanted, and no two tiles overlap.
+// Returns the area in use, Coverage is one byte per SHADOW_ATLAS_MIN_TILE_SIZE square of the atlas.
+static uint32_t
+CheckBenchShadowAtlas(shadow_atlas *Atlas, uint8_t *Coverage)
+{
+	uint32_t Cells = Atlas->Size / SHADOW_ATLAS_MIN_TILE_SIZE;
+	memset(Coverage, 0, Cells*Cells);
+
+	uint32_t Result = 0;
+	for(uint32_t TileIndex = 0; TileIndex < Atlas->TileCount; TileIndex++)
+	{
+		shadow_atlas_tile *Tile = Atlas->Tiles + TileIndex;
+		shadow_atlas_rect Rect = Tile->Rect;
+		if(Tile->Node == SHADOW_ATLAS_NO_NODE)
+		{
+			Assert(Rect.Size == 0);
+			continue;
+		}
+
+		Assert(IsPowerOfTwo(Rect.Size) && (Rect.Size >= SHADOW_ATLAS_MIN_TILE_SIZE) && (Rect.Size <= Tile->Wanted));
+		Assert((Rect.X % Rect.Size == 0) && (Rect.Y % Rect.Size == 0));
+		Assert((Rect.X + Rect.Size <= Atlas->Size) && (Rect.Y + Rect.Size <= Atlas->Size));
+		for(uint32_t Y = Rect.Y / SHADOW_ATLAS_MIN_TILE_SIZE; Y < (Rect.Y + Rect.Size) / SHADOW_ATLAS_MIN_TILE_SIZE; Y++)
+		{
+			for(uint32_t X = Rect.X / SHADOW_ATLAS_MIN_TILE_SIZE; X < (Rect.X + Rect.Size) / SHADOW_ATLAS_MIN_TILE_SIZE; X++)
+			{
+				Assert(!Coverage[Y*Cells + X]);
+				Coverage[Y*Cells + X] = 1;
+			}
+		}
+		Result += Rect.Size*Rect.Size;
+	}
+	return(Result);
+}
+
+static void
+BenchShadowAtlas(void)
+{
+	const uint32_t AtlasSize = 2048;
+	const uint32_t MaxLights = 16;
+	const uint32_t FrameCount = 20000;
+	const uint32_t FillCount = 2000;
+
+	size_t MemorySize = 1024*1024;
+	void *Memory = malloc(MemorySize);
+	memory_arena Arena;
+	InitializeArena(&Arena, MemorySize, Memory);
+
+	uint32_t Cells = AtlasSize / SHADOW_ATLAS_MIN_TILE_SIZE;
+	uint8_t *Coverage = PushArray(&Arena, Cells*Cells, uint8_t);
+	uint32_t RandomState = 0x2468ACE1;
+
+	// NOTE(georgy): Node rects. Level 0 is the atlas, and every node's quarters split it in four.
+	shadow_atlas Atlas;
+	InitializeShadowAtlas(&Atlas, &Arena, AtlasSize);
+	Assert(Atlas.LevelCount == 6);
+	Assert(GetShadowAtlasNodeRect(&Atlas, 0, 0).Size == AtlasSize);
+	for(uint32_t Quarter = 0; Quarter < 4; Quarter++)
+	{
+		shadow_atlas_rect Rect = GetShadowAtlasNodeRect(&Atlas, 2, 4*3 + Quarter);
+		Assert((Rect.Size == AtlasSize / 4) && (Rect.X == AtlasSize / 2 + ((Quarter & 1) ? AtlasSize / 4 : 0)) &&
+			   (Rect.Y == AtlasSize / 2 + ((Quarter & 2) ? AtlasSize / 4 : 0)));
+	}
+
+	// NOTE(georgy): Fill. On a fresh atlas requests placed largest first all fit as long as their total area does.
+	for(uint32_t Fill = 0; Fill < FillCount; Fill++)
+	{
+		shadow_atlas_request Requests[SHADOW_ATLAS_MAX_TILES];
+		shadow_atlas_rect Rects[SHADOW_ATLAS_MAX_TILES];
+		uint32_t RequestCount = 0;
+		uint32_t Area = 0;
+		while(RequestCount < SHADOW_ATLAS_MAX_TILES)
+		{
+			uint32_t Size = SHADOW_ATLAS_MIN_TILE_SIZE << (SceneBenchRandom(&RandomState) % 5);
+			if(Area + Size*Size > AtlasSize*AtlasSize)
+			{
+				break;
+			}
+			Requests[RequestCount] = {ShadowAtlasKey(RequestCount, 0), Size};
+			RequestCount++;
+			Area += Size*Size;
+		}
+
+		temporary_memory FillMemory = BeginTemporaryMemory(&Arena);
+		InitializeShadowAtlas(&Atlas, &Arena, AtlasSize);
+		UpdateShadowAtlas(&Atlas, Requests, RequestCount, Rects);
+		Assert((Atlas.ReducedCount == 0) && (Atlas.FailedCount == 0));
+		Assert(CheckBenchShadowAtlas(&Atlas, Coverage) == Area);
+		for(uint32_t Request = 0; Request < RequestCount; Request++)
+		{
+			Assert(Rects[Request].Size == Requests[Request].Size);
+		}
+
+		// NOTE(georgy): Nothing asked for, so everything merges back into the whole atlas
+		UpdateShadowAtlas(&Atlas, Requests, 0, Rects);
+		Assert((Atlas.TileCount == 0) && (Atlas.Nodes[0] == ShadowAtlasNode_Free));
+		EndTemporaryMemory(FillMemory);
+	}
+	printf("shadowatlas: %u fresh fills up to the whole atlas, placed largest first nothing got less than it asked for\n", FillCount);
+
+	// NOTE(georgy): Churn. Lights come and go and change their cascades' sizes, the tiles of the others stay where they are.
+	// A request that gets less than it wanted while the free area would have fit it is fragmentation.
+	struct bench_light
+	{
+		bool Active;
+		uint32_t CascadeCount;
+		uint32_t Sizes[4];
+	};
+	bench_light Lights[MaxLights] = {};
+	InitializeShadowAtlas(&Atlas, &Arena, AtlasSize);
+
+	uint64_t RequestTotal = 0;
+	uint64_t FragmentedCount = 0;
+	uint64_t MovedCount = 0;
+	real64 AreaUsed = 0.0;
+	real64 Start = GetSeconds();
+	for(uint32_t Frame = 0; Frame < FrameCount; Frame++)
+	{
+		uint32_t LightIndex = SceneBenchRandom(&RandomState) % MaxLights;
+		bench_light *Light = Lights + LightIndex;
+		uint32_t Change = SceneBenchRandom(&RandomState) % 4;
+		if(!Light->Active || (Change == 0))
+		{
+			Light->Active = !Light->Active;
+			Light->CascadeCount = 1 + SceneBenchRandom(&RandomState) % 4;
+			for(uint32_t Cascade = 0; Cascade < 4; Cascade++)
+			{
+				Light->Sizes[Cascade] = SHADOW_ATLAS_MIN_TILE_SIZE << (SceneBenchRandom(&RandomState) % 4);
+			}
+		}
+		else if(Change == 1)
+		{
+			uint32_t Cascade = SceneBenchRandom(&RandomState) % Light->CascadeCount;
+			Light->Sizes[Cascade] = SHADOW_ATLAS_MIN_TILE_SIZE << (SceneBenchRandom(&RandomState) % 4);
+		}
+
+		shadow_atlas_request Requests[SHADOW_ATLAS_MAX_TILES];
+		shadow_atlas_rect Rects[SHADOW_ATLAS_MAX_TILES];
+		uint32_t RequestCount = 0;
+		for(uint32_t Index = 0; Index < MaxLights; Index++)
+		{
+			for(uint32_t Cascade = 0; Lights[Index].Active && (Cascade < Lights[Index].CascadeCount); Cascade++)
+			{
+				Requests[RequestCount++] = {ShadowAtlasKey(Index, Cascade), Lights[Index].Sizes[Cascade]};
+			}
+		}
+
+		shadow_atlas_tile Prev[SHADOW_ATLAS_MAX_TILES];
+		uint32_t PrevCount = Atlas.TileCount;
+		memcpy(Prev, Atlas.Tiles, sizeof(Prev[0])*PrevCount);
+		uint64_t ReducedBefore = Atlas.ReducedCount + Atlas.FailedCount;
+
+		UpdateShadowAtlas(&Atlas, Requests, RequestCount, Rects);
+		uint32_t Area = CheckBenchShadowAtlas(&Atlas, Coverage);
+		AreaUsed += (real64)Area / (AtlasSize*AtlasSize);
+		RequestTotal += RequestCount;
+
+		// NOTE(georgy): A tile that still gets what it wanted is where it was
+		for(uint32_t Index = 0; Index < PrevCount; Index++)
+		{
+			shadow_atlas_tile *Tile = FindShadowAtlasTile(&Atlas, Prev[Index].Key);
+			if(Tile && (Tile->Wanted == Prev[Index].Wanted) && (Prev[Index].Rect.Size == Prev[Index].Wanted))
+			{
+				Assert((Tile->Rect.X == Prev[Index].Rect.X) && (Tile->Rect.Y == Prev[Index].Rect.Y) && (Tile->Rect.Size == Prev[Index].Rect.Size));
+			}
+			else if(Tile && (Tile->Rect.Size != Prev[Index].Rect.Size))
+			{
+				MovedCount++;
+			}
+		}
+
+		uint64_t Reduced = Atlas.ReducedCount + Atlas.FailedCount - ReducedBefore;
+		if(Reduced > 0)
+		{
+			uint32_t WantedArea = 0;
+			for(uint32_t Request = 0; Request < RequestCount; Request++)
+			{
+				WantedArea += Requests[Request].Size*Requests[Request].Size;
+			}
+			FragmentedCount += (WantedArea <= AtlasSize*AtlasSize) ? Reduced : 0;
+		}
+	}
+	real64 Elapsed = GetSeconds() - Start;
+
+	// NOTE(georgy): Whatever is left frees back into the whole atlas
+	UpdateShadowAtlas(&Atlas, 0, 0, 0);
+	Assert((Atlas.TileCount == 0) && (Atlas.Nodes[0] == ShadowAtlasNode_Free));
+	Assert(Atlas.PlacedCount == Atlas.FreedCount);
+
+	printf("shadowatlas: %u frames of churn, %.1f requests and %.1f%% of the atlas in use on average, %.3f us per update\n",
+		   FrameCount, (real64)RequestTotal / FrameCount, 100.0*AreaUsed / FrameCount, 1e6*Elapsed / FrameCount);
+	printf("shadowatlas: %llu placed, %llu got a smaller tile, %llu none, %llu of those with enough free area (fragmentation), %llu resized\n",
+		   (unsigned long long)Atlas.PlacedCount, (unsigned long long)Atlas.ReducedCount, (unsigned long long)Atlas.FailedCount,
+		   (unsigned long long)FragmentedCount, (unsigned long long)MovedCount);
+
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Light caches
+//
+
+struct bench_shadow_cache_counts
+{
+	uint64_t Frames;
+	uint64_t Actions[ShadowCache_Count];
+	uint64_t LightDraws;
+	uint64_t UncachedLightDraws;
+};
+
+// NOTE(georgy): One game frame through the low tier. Without the prepass only the G-buffer view draws besides the light
+// views, so the rest of the instanced draws are the light views'. Without the caches every light view would draw all its batches.
+static void
+RunBenchShadowCacheFrame(renderer *Renderer, graphics_context *Context, null_graphics *NullGraphics, game_state *GameState,
+						 memory_arena *FrameArena, bench_shadow_cache_counts *Counts)
+{
+	game_input GameInput = {};
+	UpdateGame(GameState, &GameInput, 0.0001f);
+
+	frame_packet Packet;
+	ResetArena(FrameArena);
+	FillFramePacket(GameState, &Packet, FrameArena);
+
+	uint64_t DrawsBefore = NullGraphics->CallCounts[GraphicsCall_DrawIndexedInstanced];
+	RenderScenePasses(Renderer, Context, &Packet);
+
+	// NOTE(georgy): The G-buffer draws come last. Reused light views set no state, the G-buffer pass can't count on theirs.
+	Assert(NullGraphics->DrawDepthState == Renderer->DepthStencilState);
+	Assert(NullGraphics->DrawInputLayout == Renderer->InputLayout);
+
+	RenderPostPasses(Renderer, Context);
+	uint64_t Draws = NullGraphics->CallCounts[GraphicsCall_DrawIndexedInstanced] - DrawsBefore;
+
+	uint64_t ExpectedLightDraws = 0;
+	for(uint32_t View = 0; View < Packet.ViewCount; View++)
+	{
+		uint32_t BatchCount = Renderer->ViewFirstBatch[View + 1] - Renderer->ViewFirstBatch[View];
+		uint32_t DynamicCount = Renderer->ViewFirstBatch[View + 1] - Renderer->ViewFirstDynamicBatch[View];
+		if(Packet.Views[View].Pass == RenderPass_GBuffer)
+		{
+			Draws -= BatchCount;
+			continue;
+		}
+
+		shadow_cache_action Action = Renderer->LightViewCaches[View].Action;
+		Counts->Actions[Action]++;
+		Counts->UncachedLightDraws += BatchCount;
+		ExpectedLightDraws += (Action == ShadowCache_Rebuild) ? BatchCount : ((Action == ShadowCache_Composite) ? DynamicCount : 0);
+	}
+	Assert(Draws == ExpectedLightDraws);
+	Counts->LightDraws += Draws;
+	Counts->Frames++;
+}
+
+static void
+PrintBenchShadowCacheCounts(const char *Name, bench_shadow_cache_counts *Counts)
+{
+	printf("shadowcache: %-8s %.2f light draws/frame instead of %.2f, light views reused %llu, composited %llu, rebuilt %llu\n",
+		   Name, (real64)Counts->LightDraws / Counts->Frames, (real64)Counts->UncachedLightDraws / Counts->Frames,
+		   (unsigned long long)Counts->Actions[ShadowCache_Reuse], (unsigned long long)Counts->Actions[ShadowCache_Composite],
+		   (unsigned long long)Counts->Actions[ShadowCache_Rebuild]);
+}
+
+static void
+BenchShadowCache(void)
+{
+	const uint32_t FrameCount = 64;
+	const uint32_t Width = 960, Height = 540;
+
+	// NOTE(georgy): The decisions on their own
+	{
+		shadow_cache_view Cache;
+		InvalidateShadowCacheView(&Cache);
+		mat4 ViewProjection = LookAt(V3(0.0f, 5.0f, -5.0f), V3(0.0f, 0.0f, 0.0f)) * Orthographic(-2.5f, 2.5f, -2.5f, 2.5f, 1.0f, 10.0f);
+		mat4 OtherViewProjection = ViewProjection * Translate(V3(0.001f, 0.0f, 0.0f));
+		shadow_atlas_rect Tile = {0, 0, 512};
+		shadow_atlas_rect OtherTile = {512, 0, 512};
+
+		Assert(UpdateShadowCacheView(&Cache, ViewProjection, Tile, false, false) == ShadowCache_Rebuild);
+		Assert(UpdateShadowCacheView(&Cache, ViewProjection, Tile, false, false) == ShadowCache_Reuse);
+		Assert(UpdateShadowCacheView(&Cache, ViewProjection, Tile, true, false) == ShadowCache_Rebuild);
+		Assert(UpdateShadowCacheView(&Cache, ViewProjection, OtherTile, false, false) == ShadowCache_Rebuild);
+		Assert(UpdateShadowCacheView(&Cache, OtherViewProjection, OtherTile, false, false) == ShadowCache_Rebuild);
+		Assert(UpdateShadowCacheView(&Cache, OtherViewProjection, OtherTile, false, true) == ShadowCache_Composite);
+		Assert(UpdateShadowCacheView(&Cache, OtherViewProjection, OtherTile, false, true) == ShadowCache_Composite);
+
+		// NOTE(georgy): The frame after the dynamic casters left still has to erase them
+		Assert(UpdateShadowCacheView(&Cache, OtherViewProjection, OtherTile, false, false) == ShadowCache_Composite);
+		Assert(UpdateShadowCacheView(&Cache, OtherViewProjection, OtherTile, false, false) == ShadowCache_Reuse);
+
+		InvalidateShadowCacheView(&Cache);
+		Assert(UpdateShadowCacheView(&Cache, OtherViewProjection, OtherTile, false, false) == ShadowCache_Rebuild);
+	}
+
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	size_t GraphicsMemorySize = 16*1024*1024;
+	size_t FrameMemorySize = 1024*1024;
+	size_t GameMemorySize = 2*1024*1024;
+	size_t TotalMemorySize = GraphicsMemorySize + FrameMemorySize + GameMemorySize;
+	void *Memory = malloc(TotalMemorySize);
+	memory_arena PermanentArena;
+	InitializeArena(&PermanentArena, TotalMemorySize, Memory);
+	memory_arena GraphicsArena, FrameArena, GameArena;
+	SubArena(&GraphicsArena, &PermanentArena, GraphicsMemorySize);
+	SubArena(&FrameArena, &PermanentArena, FrameMemorySize);
+	SubArena(&GameArena, &PermanentArena, GameMemorySize);
+
+	null_graphics NullGraphics;
+	graphics_device GraphicsDevice;
+	graphics_context GraphicsContext;
+	InitializeNullGraphics(&NullGraphics, &GraphicsArena, &GraphicsDevice, &GraphicsContext);
+
+	texture_desc BackBufferDesc = TextureDesc(Width, Height, TextureFormat_RGBA8, TextureBind_RenderTarget);
+	gfx_texture *BackBuffer = GraphicsDevice.CreateTexture(&GraphicsDevice, &BackBufferDesc, "BackBuffer");
+
+	renderer *Renderer = &GlobalRenderer;
+	InitializeRenderer(Renderer, &GraphicsDevice, Width, Height, BackBuffer, RendererQuality_Low);
+
+	std::vector<vertex> SphereVertexArray;
+	std::vector<uint32_t> SphereIndexArray;
+	GenerateSphere(SphereVertexArray, SphereIndexArray, 8, 16);
+	mesh SphereMesh = {0, (uint32_t)SphereIndexArray.size(), 0};
+	Renderer->BunnyModel.Meshes.clear();
+	Renderer->BunnyModel.Meshes.push_back(SphereMesh);
+	UploadModel(&GraphicsDevice, &Renderer->BunnyModel, &SphereVertexArray[0], (uint32_t)SphereVertexArray.size(), &SphereIndexArray[0]);
+
+	game_state GameState;
+	InitializeGame(&GameState, Width, Height, &GameArena);
+	scene *Scene = &GameState.Scene;
+
+	// NOTE(georgy): Nothing moves. The first frame draws every light view, after that they're all kept.
+	bench_shadow_cache_counts StaticCounts = {};
+	for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+	{
+		bench_shadow_cache_counts *Counts = &StaticCounts;
+		bench_shadow_cache_counts FirstCounts = {};
+		if(FrameIndex == 0)
+		{
+			Counts = &FirstCounts;
+		}
+		RunBenchShadowCacheFrame(Renderer, &GraphicsContext, &NullGraphics, &GameState, &FrameArena, Counts);
+		if(FrameIndex == 0)
+		{
+			Assert(FirstCounts.Actions[ShadowCache_Rebuild] == 1 + SHADOW_CASCADE_COUNT);
+			Assert(FirstCounts.LightDraws == FirstCounts.UncachedLightDraws);
+		}
+	}
+	Assert(StaticCounts.Actions[ShadowCache_Reuse] == (FrameCount - 1)*(1 + SHADOW_CASCADE_COUNT));
+	Assert(StaticCounts.LightDraws == 0);
+
+	// NOTE(georgy): The light passes' statistics are of a frame that reused every view, they did nothing
+	uint32_t LightPasses[] = {Renderer->Graph.ShadowMapPass, Renderer->Graph.ShadowCascadesPass};
+	for(uint32_t PassIndex = 0; PassIndex < ArrayCount(LightPasses); PassIndex++)
+	{
+		gfx_pipeline_statistics *Statistics = Renderer->PassStatistics + LightPasses[PassIndex];
+		Assert(Renderer->PassStatisticsFrames[LightPasses[PassIndex]] == Renderer->FrameIndex - 1 - RENDERER_QUERY_LATENCY);
+		Assert((Statistics->IAPrimitives == 0) && (Statistics->VSInvocations == 0));
+	}
+
+	// NOTE(georgy): The bunny (a static caster) slides around, the light views it's in get rebuilt and only those.
+	// Once it stops the views are kept again.
+	bench_shadow_cache_counts MovingCounts = {};
+	mat4 BunnyTransform = Scene->LocalTransforms[0];
+	for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+	{
+		SetLocalTransform(Scene, 0, BunnyTransform * Translate(V3(0.01f*FrameIndex, 0.0f, 0.0f)));
+		RunBenchShadowCacheFrame(Renderer, &GraphicsContext, &NullGraphics, &GameState, &FrameArena, &MovingCounts);
+		Assert(Renderer->LightViewCaches[0].Action == ShadowCache_Rebuild);
+	}
+	Assert(MovingCounts.LightDraws > 0);
+	Assert(MovingCounts.Actions[ShadowCache_Composite] == 0);
+
+	bench_shadow_cache_counts StoppedCounts = {};
+	for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+	{
+		RunBenchShadowCacheFrame(Renderer, &GraphicsContext, &NullGraphics, &GameState, &FrameArena, &StoppedCounts);
+	}
+	Assert(StoppedCounts.LightDraws == 0);
+
+	// NOTE(georgy): A dynamic sphere flies around the scene. The views it's in keep their static casters and only draw it.
+	uint32_t Ball = AddSceneMesh(Scene, SCENE_NO_PARENT, RenderMesh_Bunny, Translate(V3(0.0f, 1.5f, 0.0f)), V3(1.0f, 1.0f, 1.0f), true);
+	bench_shadow_cache_counts DynamicCounts = {};
+	for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+	{
+		real32 Angle = 0.1f*FrameIndex;
+		SetLocalTransform(Scene, Ball, Scale(0.25f) * Translate(V3(cosf(Angle), 1.5f, sinf(Angle))));
+		RunBenchShadowCacheFrame(Renderer, &GraphicsContext, &NullGraphics, &GameState, &FrameArena, &DynamicCounts);
+		Assert(Renderer->LightViewCaches[0].Action == ShadowCache_Composite);
+	}
+	Assert(DynamicCounts.Actions[ShadowCache_Rebuild] == 0);
+	Assert((DynamicCounts.LightDraws > 0) && (DynamicCounts.LightDraws < DynamicCounts.UncachedLightDraws));
+
+	PrintBenchShadowCacheCounts("static", &StaticCounts);
+	PrintBenchShadowCacheCounts("moving", &MovingCounts);
+	PrintBenchShadowCacheCounts("stopped", &StoppedCounts);
+	PrintBenchShadowCacheCounts("dynamic", &DynamicCounts);
+
+	uint64_t LightDraws = StaticCounts.LightDraws + MovingCounts.LightDraws + StoppedCounts.LightDraws + DynamicCounts.LightDraws;
+	uint64_t UncachedLightDraws = StaticCounts.UncachedLightDraws + MovingCounts.UncachedLightDraws + StoppedCounts.UncachedLightDraws + DynamicCounts.UncachedLightDraws;
+	printf("shadowcache: %llu light draws instead of %llu over all %u frames (%.1f%% saved)\n",
+		   (unsigned long long)LightDraws, (unsigned long long)UncachedLightDraws, 4*FrameCount - 1,
+		   100.0*(1.0 - (real64)LightDraws / UncachedLightDraws));
+
+	free(Memory);
+}
+
+//
+// NOTE(georgy): Prefiltered shadow moments
+//
+
+// NOTE(georgy): What the blurred moments stand for, the depth tests over the blur's footprint weighted like the blur
+static real32
+GetBenchShadowFilteredPCF(real32 *Depths, uint32_t Size, int32_t X, int32_t Y, real32 ReceiverDepth)
+{
+	real32 Sum = 0.0f;
+	real32 WeightSum = 0.0f;
+	for(int32_t TapY = -SHADOW_MOMENTS_BLUR_RADIUS; TapY <= SHADOW_MOMENTS_BLUR_RADIUS; TapY++)
+	{
+		for(int32_t TapX = -SHADOW_MOMENTS_BLUR_RADIUS; TapX <= SHADOW_MOMENTS_BLUR_RADIUS; TapX++)
+		{
+			int32_t SampleX = (X + TapX < 0) ? 0 : ((X + TapX >= (int32_t)Size) ? (int32_t)Size - 1 : X + TapX);
+			int32_t SampleY = (Y + TapY < 0) ? 0 : ((Y + TapY >= (int32_t)Size) ? (int32_t)Size - 1 : Y + TapY);
+			real32 Weight = GetShadowMomentsBlurWeight(TapX)*GetShadowMomentsBlurWeight(TapY);
+			Sum += Weight*((ReceiverDepth <= Depths[SampleY*Size + SampleX]) ? 1.0f : 0.0f);
+			WeightSum += Weight;
+		}
+	}
+
+	real32 Result = Sum / WeightSum;
+	return(Result);
+}
+
+// NOTE(georgy): Plain variance shadow maps, the moments of the depth itself, no warp and no bleeding reduction
+static real32
+GetBenchVarianceVisibility(real32 *Depths, uint32_t Size, int32_t X, int32_t Y, real32 ReceiverDepth)
+{
+	real32 Mean = 0.0f, MeanSquared = 0.0f;
+	real32 WeightSum = 0.0f;
+	for(int32_t TapY = -SHADOW_MOMENTS_BLUR_RADIUS; TapY <= SHADOW_MOMENTS_BLUR_RADIUS; TapY++)
+	{
+		for(int32_t TapX = -SHADOW_MOMENTS_BLUR_RADIUS; TapX <= SHADOW_MOMENTS_BLUR_RADIUS; TapX++)
+		{
+			int32_t SampleX = (X + TapX < 0) ? 0 : ((X + TapX >= (int32_t)Size) ? (int32_t)Size - 1 : X + TapX);
+			int32_t SampleY = (Y + TapY < 0) ? 0 : ((Y + TapY >= (int32_t)Size) ? (int32_t)Size - 1 : Y + TapY);
+			real32 Weight = GetShadowMomentsBlurWeight(TapX)*GetShadowMomentsBlurWeight(TapY);
+			real32 Depth = Depths[SampleY*Size + SampleX];
+			Mean += Weight*Depth;
+			MeanSquared += Weight*Depth*Depth;
+			WeightSum += Weight;
+		}
+	}
+
+	real32 Result = GetChebyshevUpperBound(Mean / WeightSum, MeanSquared / WeightSum, ReceiverDepth, 0.00001f);
+	return(Result);
+}
+
+static void
+BenchShadowMoments(void)
+{
+	const uint32_t Size = 128;
+	std::vector<real32> Depths(Size*Size);
+	std::vector<v4> Temp(Size*Size);
+	std::vector<v4> Moments(Size*Size);
+
+	// NOTE(georgy): Unfiltered, a receiver is lit where it's the occluder and shadowed well behind it
+	Assert(GetShadowMomentsVisibility(EncodeShadowMoments(0.4f), 0.4f) > 0.99f);
+	Assert(GetShadowMomentsVisibility(EncodeShadowMoments(0.4f), 0.3f) == 1.0f);
+	Assert(GetShadowMomentsVisibility(EncodeShadowMoments(0.4f), 0.5f) == 0.0f);
+
+	// NOTE(georgy): A shadow edge, an occluder over the left half of the tile and nothing (cleared depth) over the right.
+	// The blurred moments are fetched once per texel, the depth tests they stand for take 25.
+	{
+		for(uint32_t Y = 0; Y < Size; Y++)
+		{
+			for(uint32_t X = 0; X < Size; X++)
+			{
+				Depths[Y*Size + X] = (X < Size / 2) ? 0.3f : 1.0f;
+			}
+		}
+		FilterShadowMoments(&Moments[0], &Temp[0], &Depths[0], Size);
+
+		real32 ReceiverDepth = 0.5f;
+		real32 MaxError = 0.0f, HardMaxError = 0.0f;
+		uint32_t PenumbraTexels = 0;
+		for(int32_t Y = 0; Y < (int32_t)Size; Y++)
+		{
+			for(int32_t X = 0; X < (int32_t)Size; X++)
+			{
+				real32 Reference = GetBenchShadowFilteredPCF(&Depths[0], Size, X, Y, ReceiverDepth);
+				real32 Visibility = GetShadowMomentsVisibility(Moments[Y*Size + X], ReceiverDepth);
+				real32 Hard = (ReceiverDepth <= Depths[Y*Size + X]) ? 1.0f : 0.0f;
+				MaxError = fmaxf(MaxError, fabsf(Visibility - Reference));
+				HardMaxError = fmaxf(HardMaxError, fabsf(Hard - Reference));
+				PenumbraTexels += ((Visibility > 0.0f) && (Visibility < 1.0f)) ? 1 : 0;
+			}
+		}
+		printf("shadowmoments: edge, 1 fetch against %d depth tests, max error %.3f (one hard test %.3f), %.1f penumbra texels/row\n",
+			   (2*SHADOW_MOMENTS_BLUR_RADIUS + 1)*(2*SHADOW_MOMENTS_BLUR_RADIUS + 1), MaxError, HardMaxError, (real64)PenumbraTexels / Size);
+		Assert(MaxError < HardMaxError);
+		Assert(PenumbraTexels >= Size);
+	}
+
+	// NOTE(georgy): Two occluders overlapping, one above the other, over a receiver well behind both. Nothing should be
+	// lit, plain variance shadow maps let light through around the upper occluder's edge.
+	{
+		for(uint32_t Y = 0; Y < Size; Y++)
+		{
+			for(uint32_t X = 0; X < Size; X++)
+			{
+				Depths[Y*Size + X] = (X < Size / 2) ? 0.1f : 0.4f;
+			}
+		}
+		FilterShadowMoments(&Moments[0], &Temp[0], &Depths[0], Size);
+
+		real32 ReceiverDepth = 0.6f;
+		real32 MaxBleeding = 0.0f, VarianceMaxBleeding = 0.0f;
+		for(int32_t Y = 0; Y < (int32_t)Size; Y++)
+		{
+			for(int32_t X = 0; X < (int32_t)Size; X++)
+			{
+				MaxBleeding = fmaxf(MaxBleeding, GetShadowMomentsVisibility(Moments[Y*Size + X], ReceiverDepth));
+				VarianceMaxBleeding = fmaxf(VarianceMaxBleeding, GetBenchVarianceVisibility(&Depths[0], Size, X, Y, ReceiverDepth));
+			}
+		}
+		printf("shadowmoments: overlapping occluders, light let through %.3f (variance shadow maps %.3f)\n", MaxBleeding, VarianceMaxBleeding);
+		Assert(MaxBleeding < 0.01f);
+		Assert(VarianceMaxBleeding > 0.1f);
+	}
+
+	// NOTE(georgy): Far away, a pixel covers 4x4 texels. Blocks of occluders, the reference tests every texel under the
+	// pixel. The mip gets it with one trilinear fetch, the unfiltered map with one test at the pixel's center.
+	{
+		for(uint32_t Y = 0; Y < Size; Y++)
+		{
+			for(uint32_t X = 0; X < Size; X++)
+			{
+				uint32_t Block = ((X / 6)*7919 + (Y / 6)*104729) % 5;
+				Depths[Y*Size + X] = (Block < 2) ? 0.3f + 0.05f*Block : 1.0f;
+			}
+		}
+		FilterShadowMoments(&Moments[0], &Temp[0], &Depths[0], Size);
+
+		std::vector<v4> MipMemory(Size*Size);
+		v4 *Mips[SHADOW_MOMENTS_MIP_COUNT];
+		Mips[0] = &Moments[0];
+		v4 *NextMip = &MipMemory[0];
+		for(uint32_t Mip = 1; Mip < SHADOW_MOMENTS_MIP_COUNT; Mip++)
+		{
+			Mips[Mip] = NextMip;
+			DownsampleShadowMoments(Mips[Mip], Mips[Mip - 1], Size >> (Mip - 1));
+			NextMip += (Size >> Mip)*(Size >> Mip);
+		}
+
+		// NOTE(georgy): Every mip is the average of the one above, so the last one is the tile's average
+		v4 Average = V4(0.0f, 0.0f, 0.0f, 0.0f);
+		for(uint32_t Texel = 0; Texel < Size*Size; Texel++)
+		{
+			Average += Moments[Texel];
+		}
+		Average = (1.0f / (Size*Size))*Average;
+		v4 *Last = Mips[SHADOW_MOMENTS_MIP_COUNT - 1];
+		Assert(fabsf(Last[0].x - Average.x) <= 0.001f*Average.x);
+
+		const uint32_t Footprint = 4;
+		real32 Lod = GetShadowMomentsLod((real32)Footprint);
+		real32 ReceiverDepth = 0.5f;
+		real32 ErrorSum = 0.0f, HardErrorSum = 0.0f;
+		uint32_t PixelCount = Size / Footprint;
+		for(uint32_t PixelY = 0; PixelY < PixelCount; PixelY++)
+		{
+			for(uint32_t PixelX = 0; PixelX < PixelCount; PixelX++)
+			{
+				real32 Reference = 0.0f;
+				for(uint32_t Y = 0; Y < Footprint; Y++)
+				{
+					for(uint32_t X = 0; X < Footprint; X++)
+					{
+						Reference += (ReceiverDepth <= Depths[(PixelY*Footprint + Y)*Size + PixelX*Footprint + X]) ? 1.0f : 0.0f;
+					}
+				}
+				Reference /= (real32)(Footprint*Footprint);
+
+				real32 U = (PixelX + 0.5f) / PixelCount;
+				real32 V = (PixelY + 0.5f) / PixelCount;
+				real32 Visibility = GetShadowMomentsVisibility(SampleShadowMoments(Mips, Size, U, V, Lod), ReceiverDepth);
+				uint32_t CenterX = PixelX*Footprint + Footprint / 2, CenterY = PixelY*Footprint + Footprint / 2;
+				real32 Hard = (ReceiverDepth <= Depths[CenterY*Size + CenterX]) ? 1.0f : 0.0f;
+				ErrorSum += fabsf(Visibility - Reference);
+				HardErrorSum += fabsf(Hard - Reference);
+			}
+		}
+		real32 Error = ErrorSum / (PixelCount*PixelCount);
+		real32 HardError = HardErrorSum / (PixelCount*PixelCount);
+		printf("shadowmoments: %ux%u texels per pixel, mip %.1f, mean error %.3f against %.3f unfiltered\n",
+			   Footprint, Footprint, Lod, Error, HardError);
+		Assert(Lod == 2.0f);
+		Assert(Error < HardError);
+	}
+
+	// NOTE(georgy): The renderer, the high tier filters the cascades that changed and nothing else
+	Platform.DebugOutput = LinuxDebugOutput;
+
+	const uint32_t FrameCount = 64;
+	const uint32_t Width = 960, Height = 540;
+	size_t GraphicsMemorySize = 16*1024*1024;
+	size_t FrameMemorySize = 1024*1024;
+	size_t GameMemorySize = 2*1024*1024;
+	size_t TotalMemorySize = GraphicsMemorySize + FrameMemorySize + GameMemorySize;
+	void *Memory = malloc(TotalMemorySize);
+	memory_arena PermanentArena;
+	InitializeArena(&PermanentArena, TotalMemorySize, Memory);
+	memory_arena GraphicsArena, FrameArena, GameArena;
+	SubArena(&GraphicsArena, &PermanentArena, GraphicsMemorySize);
+	SubArena(&FrameArena, &PermanentArena, FrameMemorySize);
+	SubArena(&GameArena, &PermanentArena, GameMemorySize);
+
+	std::vector<vertex> SphereVertexArray;
+	std::vector<uint32_t> SphereIndexArray;
+	GenerateSphere(SphereVertexArray, SphereIndexArray, 8, 16);
+	mesh SphereMesh = {0, (uint32_t)SphereIndexArray.size(), 0};
+
+	renderer *Renderer = &GlobalRenderer;
+	for(uint32_t Tier = 0; Tier < 2; Tier++)
+	{
+		renderer_quality Quality = Tier ? RendererQuality_High : RendererQuality_Low;
+
+		ResetArena(&GraphicsArena);
+		null_graphics NullGraphics;
+		graphics_device GraphicsDevice;
+		graphics_context GraphicsContext;
+		InitializeNullGraphics(&NullGraphics, &GraphicsArena, &GraphicsDevice, &GraphicsContext);
+
+		texture_desc BackBufferDesc = TextureDesc(Width, Height, TextureFormat_RGBA8, TextureBind_RenderTarget);
+		gfx_texture *BackBuffer = GraphicsDevice.CreateTexture(&GraphicsDevice, &BackBufferDesc, "BackBuffer");
+		InitializeRenderer(Renderer, &GraphicsDevice, Width, Height, BackBuffer, Quality);
+		Renderer->BunnyModel.Meshes.clear();
+		Renderer->BunnyModel.Meshes.push_back(SphereMesh);
+		UploadModel(&GraphicsDevice, &Renderer->BunnyModel, &SphereVertexArray[0], (uint32_t)SphereVertexArray.size(), &SphereIndexArray[0]);
+
+		ResetArena(&GameArena);
+		game_state GameState;
+		InitializeGame(&GameState, Width, Height, &GameArena);
+
+		// NOTE(georgy): Still for half of the frames, then turning
+		frame_packet Packet;
+		game_input GameInput = {};
+		uint32_t ChangedFrames = 0, FilteredCascades = 0;
+		for(uint32_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++)
+		{
+			GameInput.DeltaMouseX = (FrameIndex < FrameCount / 2) ? 0 : 4;
+			UpdateGame(&GameState, &GameInput, 0.0001f);
+
+			ResetArena(&FrameArena);
+			FillFramePacket(&GameState, &Packet, &FrameArena);
+			RenderScenePasses(Renderer, &GraphicsContext, &Packet);
+			RenderPostPasses(Renderer, &GraphicsContext);
+
+			uint32_t Changed = 0;
+			for(uint32_t View = 0; View < Packet.ViewCount; View++)
+			{
+				if(Packet.Views[View].Pass == RenderPass_ShadowCascade)
+				{
+					Changed += (Renderer->LightViewCaches[View].Action != ShadowCache_Reuse) ? 1 : 0;
+				}
+			}
+			ChangedFrames += Changed ? 1 : 0;
+			FilteredCascades += Changed;
+		}
+
+		uint64_t GenerateMipsCount = NullGraphics.CallCounts[GraphicsCall_GenerateMips];
+		if(Renderer->Settings.ShadowMoments)
+		{
+			Assert(IsFrameGraphPassActive(&Renderer->FrameGraph, Renderer->Graph.ShadowMomentsPass));
+			Assert(GenerateMipsCount == ChangedFrames);
+			Assert(ChangedFrames < FrameCount);
+			printf("shadowmoments: high tier, %u of %u frames filtered %.2f cascades on average, the others reused the moments\n",
+				   ChangedFrames, FrameCount, (real64)FilteredCascades / ChangedFrames);
+		}
+		else
+		{
+			Assert(Renderer->Graph.ShadowMomentsPass == FRAME_GRAPH_INVALID_INDEX);
+			Assert(Renderer->ShadowMoments == 0);
+			Assert(GenerateMipsCount == 0);
+		}
+	}
+
+	free(Memory);
+}
+
+struct bench
+{
+	const char *Name;
+	void (*Function)(void);
+};
+
+int
+main(int ArgCount, char **Args)
+{
+	bench Benches[] =
+	{
+		{"jobs", BenchJobSystem},
+		{"spsc", BenchSPSCQueue},
+		{"alloc", BenchAllocTracker},
+		{"framegraph", BenchFrameGraph},
+		{"frame", BenchFrame},
+		{"instancing", BenchInstancing},
+		{"drawsort", BenchDrawSort},
+		{"capture", BenchCapture},
+		{"statefilter", BenchStateFilter},
+		{"constring", BenchConstantRing},
+		{"scene", BenchScene},
+		{"aabbtree", BenchAABBTree},
+		{"bvh", BenchTriangleBVH},
+		{"pathtrace", BenchPathTracer},
+		{"rsmsamples", BenchRSMSamples},
+		{"rsmupsample", BenchRSMUpsample},
+		{"temporal", BenchTemporal},
+		{"blur", BenchBlur},
+		{"prepass", BenchDepthPrepass},
+		{"cascades", BenchShadowCascades},
+		{"shadowatlas", BenchShadowAtlas},
+		{"shadowcache", BenchShadowCache},
+		{"shadowmoments", BenchShadowMoments},
+	};
+
+	InitializeJobSystem(&GlobalJobSystem);
+	Platform.JobSystem = &GlobalJobSystem;
+
+	for(uint32_t BenchIndex = 0; BenchIndex < ArrayCount(Benches); BenchIndex++)
+	{
+		bool ShouldRun = (ArgCount <= 1);
+		for(int ArgIndex = 1; ArgIndex < ArgCount; ArgIndex++)
+		{
+			ShouldRun = ShouldRun || (strcmp(Args[ArgIndex], Benches[BenchIndex].Name) == 0);
+		}
+
+		if(ShouldRun)
+		{
+			Benches[BenchIndex].Function();
+		}
+	}
+
+	ShutdownJobSystem(&GlobalJobSystem);
+
+	return(0);
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+//
+// NOTE(georgy): Linear (bump) allocator. Memory is handed out by bumping Used and
+// freed all at once, either by resetting the whole arena or by ending a temporary memory scope.
+//
+
+struct memory_arena
+{
+	size_t Size;
+	uint8_t *Base;
+	size_t Used;
+
+	uint32_t TempCount;
+};
+
+inline void
+InitializeArena(memory_arena *Arena, size_t Size, void *Base)
+{
+	Arena->Size = Size;
+	Arena->Base = (uint8_t *)Base;
+	Arena->Used = 0;
+	Arena->TempCount = 0;
+}
+
+inline size_t
+GetAlignmentOffset(memory_arena *Arena, size_t Alignment)
+{
+	size_t ResultPointer = (size_t)Arena->Base + Arena->Used;
+	size_t AlignmentMask = Alignment - 1;
+
+	size_t AlignmentOffset = 0;
+	if(ResultPointer & AlignmentMask)
+	{
+		AlignmentOffset = Alignment - (ResultPointer & AlignmentMask);
+	}
+
+	return(AlignmentOffset);
+}
+
+#define PushStruct(Arena, type, ...) (type *)PushSize_(Arena, sizeof(type), alignof(type), ## __VA_ARGS__)
+#define PushArray(Arena, Count, type, ...) (type *)PushSize_(Arena, (Count)*sizeof(type), alignof(type), ## __VA_ARGS__)
+#define PushSize(Arena, Size, ...) PushSize_(Arena, Size, 16, ## __VA_ARGS__)
+
+inline void *
+PushSize_(memory_arena *Arena, size_t SizeInit, size_t Alignment, bool Clear = false)
+{
+	size_t AlignmentOffset = GetAlignmentOffset(Arena, Alignment);
+	size_t Size = SizeInit + AlignmentOffset;
+
+	Assert((Arena->Used + Size) <= Arena->Size);
+	void *Result = Arena->Base + Arena->Used + AlignmentOffset;
+	Arena->Used += Size;
+
+	if(Clear)
+	{
+		memset(Result, 0, SizeInit);
+	}
+
+	return(Result);
+}
+
+inline void
+ResetArena(memory_arena *Arena)
+{
+	Assert(Arena->TempCount == 0);
+	Arena->Used = 0;
+}
+
+inline void
+SubArena(memory_arena *Result, memory_arena *Arena, size_t Size, size_t Alignment = 16)
+{
+	Result->Size = Size;
+	Result->Base = (uint8_t *)PushSize_(Arena, Size, Alignment);
+	Result->Used = 0;
+	Result->TempCount = 0;
+}
+
+//
+// NOTE(georgy): Temporary memory. Everything pushed between Begin and End is freed by End,
+// scopes can nest but must be ended in reverse order.
+//
+
+struct temporary_memory
+{
+	memory_arena *Arena;
+	size_t Used;
+};
+
+inline temporary_memory
+BeginTemporaryMemory(memory_arena *Arena)
+{
+	temporary_memory Result;
+
+	Result.Arena = Arena;
+	Result.Used = Arena->Used;
+
+	Arena->TempCount++;
+
+	return(Result);
+}
+
+inline void
+EndTemporaryMemory(temporary_memory TempMem)
+{
+	memory_arena *Arena = TempMem.Arena;
+	Assert(Arena->Used >= TempMem.Used);
+	Assert(Arena->TempCount > 0);
+	Arena->Used = TempMem.Used;
+	Arena->TempCount--;
+}
+
+// NOTE(georgy): Same thing for code with several exits, ends the temporary memory when it goes out of scope
+struct scoped_temporary_memory
+{
+	temporary_memory TempMem;
+
+	scoped_temporary_memory(memory_arena *Arena) : TempMem(BeginTemporaryMemory(Arena)) {}
+	~scoped_temporary_memory() { EndTemporaryMemory(TempMem); }
+};
+
+//
+// NOTE(georgy): Per-frame arenas. Transient CPU data of a frame (draw lists, culling results,
+// constant staging) lives in the frame's arena and is freed in bulk when the arena comes around again.
+// There has to be an arena for every frame that can be in flight at once: the one the game thread
+// is filling plus the ones that are still queued for or being read by the render thread.
+//
+
+#define FRAME_ARENA_COUNT 3
+
+struct frame_arenas
+{
+	memory_arena Arenas[FRAME_ARENA_COUNT];
+	uint32_t FrameIndex;
+};
+
+inline void
+InitializeFrameArenas(frame_arenas *FrameArenas, memory_arena *Arena, size_t SizePerFrame)
+{
+	for(uint32_t ArenaIndex = 0; ArenaIndex < FRAME_ARENA_COUNT; ArenaIndex++)
+	{
+		SubArena(FrameArenas->Arenas + ArenaIndex, Arena, SizePerFrame);
+	}
+	FrameArenas->FrameIndex = 0;
+}
+
+// NOTE(georgy): Must only be called once the frame that used this arena FRAME_ARENA_COUNT frames ago is retired
+inline memory_arena *
+BeginFrameArena(frame_arenas *FrameArenas)
+{
+	memory_arena *Result = FrameArenas->Arenas + (FrameArenas->FrameIndex++ % FRAME_ARENA_COUNT);
+	ResetArena(Result);
+	return(Result);
+}
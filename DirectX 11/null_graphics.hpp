@@ -0,0 +1,316 @@
+#pragma once
+
+#include "graphics.hpp"
+
+//
+// NOTE(georgy): Null graphics backend. Creates handles without a GPU behind them and records how many
+// times each context call was made, so the whole frame can run headless. Dynamic buffers get real memory,
+// so code that maps them writes somewhere. Queries count what is known without rasterizing:
+// primitives and vertices, never any shaded pixels.
+//
+
+struct null_graphics
+{
+	memory_arena *Arena;
+	uint32_t CreatedObjectCount;
+
+	uint64_t CallCounts[GraphicsCall_Count];
+	uint64_t IndexCount;
+	uint64_t VertexCount;
+	uint64_t InstanceCount;
+
+	gfx_topology Topology;
+	gfx_depth_state *DepthState;
+	gfx_input_layout *InputLayout;
+	gfx_pipeline_statistics Statistics;
+
+	// NOTE(georgy): What the last instanced draw ran with
+	gfx_depth_state *DrawDepthState;
+	gfx_input_layout *DrawInputLayout;
+};
+
+struct null_buffer
+{
+	gfx_buffer_desc Desc;
+	uint8_t *Memory;
+};
+
+struct null_texture
+{
+	texture_desc Desc;
+};
+
+// NOTE(georgy): Statistics at Begin, and the difference at End
+struct null_query
+{
+	gfx_pipeline_statistics Begin;
+	gfx_pipeline_statistics Result;
+	bool Ended;
+};
+
+// NOTE(georgy): Everything else only needs a unique address
+struct null_object
+{
+	uint32_t ID;
+};
+
+inline null_graphics *
+GetNullGraphics(graphics_device *Device)
+{
+	null_graphics *Result = (null_graphics *)Device->Data;
+	return(Result);
+}
+
+inline null_graphics *
+GetNullGraphics(graphics_context *Context)
+{
+	null_graphics *Result = (null_graphics *)Context->Data;
+	return(Result);
+}
+
+inline void *
+NullCreateObject(graphics_device *Device)
+{
+	null_graphics *Null = GetNullGraphics(Device);
+	null_object *Result = PushStruct(Null->Arena, null_object);
+	Result->ID = ++Null->CreatedObjectCount;
+	return(Result);
+}
+
+static gfx_buffer *
+NullCreateBuffer(graphics_device *Device, gfx_buffer_desc *Desc)
+{
+	null_graphics *Null = GetNullGraphics(Device);
+	null_buffer *Result = PushStruct(Null->Arena, null_buffer);
+	Result->Desc = *Desc;
+	Result->Memory = (Desc->Usage == GfxBufferUsage_Dynamic) ? (uint8_t *)PushSize(Null->Arena, Desc->Size, true) : 0;
+	Null->CreatedObjectCount++;
+	return((gfx_buffer *)Result);
+}
+
+static gfx_texture *
+NullCreateTexture(graphics_device *Device, texture_desc *Desc, const char *Name)
+{
+	null_graphics *Null = GetNullGraphics(Device);
+	null_texture *Result = PushStruct(Null->Arena, null_texture);
+	Result->Desc = *Desc;
+	Null->CreatedObjectCount++;
+	return((gfx_texture *)Result);
+}
+
+static void NullDestroyTexture(graphics_device *Device, gfx_texture *Texture) {}
+
+static gfx_query *
+NullCreateQuery(graphics_device *Device, const char *Name)
+{
+	null_graphics *Null = GetNullGraphics(Device);
+	null_query *Result = PushStruct(Null->Arena, null_query, true);
+	Null->CreatedObjectCount++;
+	return((gfx_query *)Result);
+}
+
+static gfx_vertex_shader *NullCreateVertexShader(graphics_device *Device, const char *Filename, const char *EntryPoint) { return((gfx_vertex_shader *)NullCreateObject(Device)); }
+static gfx_pixel_shader *NullCreatePixelShader(graphics_device *Device, const char *Filename, const char *EntryPoint) { return((gfx_pixel_shader *)NullCreateObject(Device)); }
+static gfx_input_layout *NullCreateInputLayout(graphics_device *Device, gfx_input_element *Elements, uint32_t ElementCount, gfx_vertex_shader *Shader) { return((gfx_input_layout *)NullCreateObject(Device)); }
+static gfx_depth_state *NullCreateDepthState(graphics_device *Device, gfx_depth_state_desc *Desc) { return((gfx_depth_state *)NullCreateObject(Device)); }
+static gfx_raster_state *NullCreateRasterState(graphics_device *Device, gfx_raster_state_desc *Desc) { return((gfx_raster_state *)NullCreateObject(Device)); }
+static gfx_blend_state *NullCreateBlendState(graphics_device *Device, gfx_blend_state_desc *Desc) { return((gfx_blend_state *)NullCreateObject(Device)); }
+static gfx_sampler *NullCreateSampler(graphics_device *Device, gfx_sampler_desc *Desc) { return((gfx_sampler *)NullCreateObject(Device)); }
+
+#define NullCountCall(Context, Name) GetNullGraphics(Context)->CallCounts[GraphicsCall_##Name]++
+
+static void NullRSSetViewports(graphics_context *Context, uint32_t Count, gfx_viewport *Viewports) { NullCountCall(Context, RSSetViewports); }
+static void NullRSSetState(graphics_context *Context, gfx_raster_state *State) { NullCountCall(Context, RSSetState); }
+static void NullOMSetRenderTargets(graphics_context *Context, uint32_t Count, gfx_texture **RenderTargets, gfx_texture *DepthStencil) { NullCountCall(Context, OMSetRenderTargets); }
+static void NullOMSetBlendState(graphics_context *Context, gfx_blend_state *State, const real32 *BlendFactor, uint32_t SampleMask) { NullCountCall(Context, OMSetBlendState); }
+static void NullClearRenderTargetView(graphics_context *Context, gfx_texture *RenderTarget, const real32 *Color) { NullCountCall(Context, ClearRenderTargetView); }
+static void NullClearDepthStencilView(graphics_context *Context, gfx_texture *DepthStencil, uint32_t ClearFlags, real32 Depth, uint8_t Stencil) { NullCountCall(Context, ClearDepthStencilView); }
+static void NullGenerateMips(graphics_context *Context, gfx_texture *Texture) { NullCountCall(Context, GenerateMips); }
+static void NullIASetVertexBuffers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *Strides, uint32_t *Offsets) { NullCountCall(Context, IASetVertexBuffers); }
+static void NullIASetIndexBuffer(graphics_context *Context, gfx_buffer *Buffer, gfx_index_format Format, uint32_t Offset) { NullCountCall(Context, IASetIndexBuffer); }
+static void NullVSSetShader(graphics_context *Context, gfx_vertex_shader *Shader) { NullCountCall(Context, VSSetShader); }
+static void NullPSSetShader(graphics_context *Context, gfx_pixel_shader *Shader) { NullCountCall(Context, PSSetShader); }
+static void NullVSSetConstantBuffers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers) { NullCountCall(Context, VSSetConstantBuffers); }
+static void NullPSSetConstantBuffers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers) { NullCountCall(Context, PSSetConstantBuffers); }
+static void NullPSSetShaderResources(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_texture **Textures) { NullCountCall(Context, PSSetShaderResources); }
+static void NullPSSetSamplers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_sampler **Samplers) { NullCountCall(Context, PSSetSamplers); }
+static void NullUnmap(graphics_context *Context, gfx_buffer *Buffer) { NullCountCall(Context, Unmap); }
+static void NullPresent(graphics_context *Context) { NullCountCall(Context, Present); }
+
+static void
+NullOMSetDepthStencilState(graphics_context *Context, gfx_depth_state *State, uint32_t StencilRef)
+{
+	NullCountCall(Context, OMSetDepthStencilState);
+	GetNullGraphics(Context)->DepthState = State;
+}
+
+static void
+NullIASetInputLayout(graphics_context *Context, gfx_input_layout *Layout)
+{
+	NullCountCall(Context, IASetInputLayout);
+	GetNullGraphics(Context)->InputLayout = Layout;
+}
+
+static void
+NullIASetPrimitiveTopology(graphics_context *Context, gfx_topology Topology)
+{
+	NullCountCall(Context, IASetPrimitiveTopology);
+	GetNullGraphics(Context)->Topology = Topology;
+}
+
+static void *
+NullMap(graphics_context *Context, gfx_buffer *Buffer, gfx_map MapType)
+{
+	NullCountCall(Context, Map);
+
+	null_buffer *NullBuffer = (null_buffer *)Buffer;
+	Assert(NullBuffer->Memory);
+	return(NullBuffer->Memory);
+}
+
+// NOTE(georgy): Same rules as D3D11.1, so misuse shows up without a GPU
+static void
+NullCheckConstantRanges(uint32_t Count, gfx_buffer **Buffers, uint32_t *FirstConstant, uint32_t *NumConstants)
+{
+	for(uint32_t BufferIndex = 0; BufferIndex < Count; BufferIndex++)
+	{
+		null_buffer *NullBuffer = (null_buffer *)Buffers[BufferIndex];
+		Assert((FirstConstant[BufferIndex] % (GFX_CONSTANT_BUFFER_ALIGNMENT / GFX_CONSTANT_SIZE)) == 0);
+		Assert((NumConstants[BufferIndex] % (GFX_CONSTANT_BUFFER_ALIGNMENT / GFX_CONSTANT_SIZE)) == 0);
+		Assert(!NullBuffer || ((FirstConstant[BufferIndex] + NumConstants[BufferIndex])*GFX_CONSTANT_SIZE <= NullBuffer->Desc.Size));
+	}
+}
+
+static void
+NullVSSetConstantBuffers1(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *FirstConstant, uint32_t *NumConstants)
+{
+	NullCountCall(Context, VSSetConstantBuffers1);
+	NullCheckConstantRanges(Count, Buffers, FirstConstant, NumConstants);
+}
+
+static void
+NullPSSetConstantBuffers1(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *FirstConstant, uint32_t *NumConstants)
+{
+	NullCountCall(Context, PSSetConstantBuffers1);
+	NullCheckConstantRanges(Count, Buffers, FirstConstant, NumConstants);
+}
+
+// NOTE(georgy): Every vertex is shaded once, there is no post transform cache
+static void
+NullCountPrimitives(null_graphics *Null, uint32_t VertexCount, uint32_t InstanceCount)
+{
+	uint32_t PrimitiveCount = (Null->Topology == GfxTopology_TriangleStrip) ? ((VertexCount >= 2) ? VertexCount - 2 : 0) : VertexCount / 3;
+	Null->Statistics.IAPrimitives += (uint64_t)PrimitiveCount*InstanceCount;
+	Null->Statistics.VSInvocations += (uint64_t)VertexCount*InstanceCount;
+}
+
+static void
+NullDraw(graphics_context *Context, uint32_t VertexCount, uint32_t StartVertex)
+{
+	NullCountCall(Context, Draw);
+	GetNullGraphics(Context)->VertexCount += VertexCount;
+	NullCountPrimitives(GetNullGraphics(Context), VertexCount, 1);
+}
+
+static void
+NullDrawIndexed(graphics_context *Context, uint32_t IndexCount, uint32_t StartIndex, int32_t BaseVertex)
+{
+	NullCountCall(Context, DrawIndexed);
+	GetNullGraphics(Context)->IndexCount += IndexCount;
+	NullCountPrimitives(GetNullGraphics(Context), IndexCount, 1);
+}
+
+static void
+NullDrawIndexedInstanced(graphics_context *Context, uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndex, int32_t BaseVertex, uint32_t StartInstance)
+{
+	NullCountCall(Context, DrawIndexedInstanced);
+	GetNullGraphics(Context)->DrawDepthState = GetNullGraphics(Context)->DepthState;
+	GetNullGraphics(Context)->DrawInputLayout = GetNullGraphics(Context)->InputLayout;
+	GetNullGraphics(Context)->IndexCount += (uint64_t)IndexCountPerInstance*InstanceCount;
+	GetNullGraphics(Context)->InstanceCount += InstanceCount;
+	NullCountPrimitives(GetNullGraphics(Context), IndexCountPerInstance, InstanceCount);
+}
+
+static void
+NullBegin(graphics_context *Context, gfx_query *Query)
+{
+	NullCountCall(Context, Begin);
+	null_query *NullQuery = (null_query *)Query;
+	NullQuery->Begin = GetNullGraphics(Context)->Statistics;
+	NullQuery->Ended = false;
+}
+
+static void
+NullEnd(graphics_context *Context, gfx_query *Query)
+{
+	NullCountCall(Context, End);
+	null_query *NullQuery = (null_query *)Query;
+	gfx_pipeline_statistics *Statistics = &GetNullGraphics(Context)->Statistics;
+	NullQuery->Result.IAPrimitives = Statistics->IAPrimitives - NullQuery->Begin.IAPrimitives;
+	NullQuery->Result.VSInvocations = Statistics->VSInvocations - NullQuery->Begin.VSInvocations;
+	NullQuery->Result.PSInvocations = 0;
+	NullQuery->Ended = true;
+}
+
+static bool
+NullGetData(graphics_context *Context, gfx_query *Query, gfx_pipeline_statistics *Statistics)
+{
+	NullCountCall(Context, GetData);
+	null_query *NullQuery = (null_query *)Query;
+	if(NullQuery->Ended)
+	{
+		*Statistics = NullQuery->Result;
+	}
+	return(NullQuery->Ended);
+}
+
+static void
+InitializeNullGraphics(null_graphics *Null, memory_arena *Arena, graphics_device *Device, graphics_context *Context)
+{
+	*Null = {};
+	Null->Arena = Arena;
+
+	Device->CreateBuffer = NullCreateBuffer;
+	Device->CreateTexture = NullCreateTexture;
+	Device->DestroyTexture = NullDestroyTexture;
+	Device->CreateVertexShader = NullCreateVertexShader;
+	Device->CreatePixelShader = NullCreatePixelShader;
+	Device->CreateInputLayout = NullCreateInputLayout;
+	Device->CreateDepthState = NullCreateDepthState;
+	Device->CreateRasterState = NullCreateRasterState;
+	Device->CreateBlendState = NullCreateBlendState;
+	Device->CreateSampler = NullCreateSampler;
+	Device->CreateQuery = NullCreateQuery;
+	Device->Data = Null;
+
+	Context->RSSetViewports = NullRSSetViewports;
+	Context->RSSetState = NullRSSetState;
+	Context->OMSetRenderTargets = NullOMSetRenderTargets;
+	Context->OMSetDepthStencilState = NullOMSetDepthStencilState;
+	Context->OMSetBlendState = NullOMSetBlendState;
+	Context->ClearRenderTargetView = NullClearRenderTargetView;
+	Context->ClearDepthStencilView = NullClearDepthStencilView;
+	Context->GenerateMips = NullGenerateMips;
+	Context->IASetInputLayout = NullIASetInputLayout;
+	Context->IASetPrimitiveTopology = NullIASetPrimitiveTopology;
+	Context->IASetVertexBuffers = NullIASetVertexBuffers;
+	Context->IASetIndexBuffer = NullIASetIndexBuffer;
+	Context->VSSetShader = NullVSSetShader;
+	Context->PSSetShader = NullPSSetShader;
+	Context->VSSetConstantBuffers = NullVSSetConstantBuffers;
+	Context->PSSetConstantBuffers = NullPSSetConstantBuffers;
+	Context->VSSetConstantBuffers1 = NullVSSetConstantBuffers1;
+	Context->PSSetConstantBuffers1 = NullPSSetConstantBuffers1;
+	Context->PSSetShaderResources = NullPSSetShaderResources;
+	Context->PSSetSamplers = NullPSSetSamplers;
+	Context->Map = NullMap;
+	Context->Unmap = NullUnmap;
+	Context->Draw = NullDraw;
+	Context->DrawIndexed = NullDrawIndexed;
+	Context->DrawIndexedInstanced = NullDrawIndexedInstanced;
+	Context->Begin = NullBegin;
+	Context->End = NullEnd;
+	Context->GetData = NullGetData;
+	Context->Present = NullPresent;
+	Context->Data = Null;
+}
@@ -0,0 +1,494 @@
+#pragma once
+
+#include "memory_arena.hpp"
+#include "job_system.hpp"
+#include "scene.hpp"
+#include "triangle_bvh.hpp"
+
+#include <stdio.h>
+
+//
+// NOTE(georgy): Offline CPU path tracer, the ground truth the real-time lighting (RSM indirect light in particular)
+// is compared against.
+//
+// All the scene's mesh triangles are transformed to world space and put into one triangle BVH.
+// Surfaces are lambertian with the object's color and the only light is the directional sun, in the same units
+// as the deferred shader: a surface facing the sun reflects Color * dot(N, ToSun). There is no sky, rays that miss are black.
+//
+// The image is split into tiles that are rendered in parallel. Every pixel's samples are traced 4 paths at a time:
+// camera rays and their shadow rays go through the BVH as 4 ray packets, the scattered rays after a bounce one at a time.
+//
+// Per pixel it keeps three things:
+//  - Albedo: color of the surface seen through the pixel
+//  - Direct: sun light reflected by that surface
+//  - Indirect: light arriving at that surface from other surfaces, as the radiance a white surface would reflect.
+//    This is what CalculateRSM approximates (the G-buffer pass adds it without the surface's color).
+// A physically based image is Direct + Albedo*Indirect.
+//
+// Colors in the scene are above 1, so every bounce adds energy and the sum over all bounces doesn't converge.
+// MaxBounces = 1 is exactly the one bounce RSM tries to capture.
+//
+
+#define PATH_TRACER_TILE_SIZE 16
+
+// NOTE(georgy): Secondary rays start this far off the surface, along its normal
+#define PATH_TRACER_RAY_OFFSET 1e-4f
+
+struct path_tracer_scene
+{
+	triangle_bvh BVH;
+
+	// NOTE(georgy): Per world triangle, normals are unit length geometric normals
+	v3 *Normals;
+	v3 *Colors;
+
+	// NOTE(georgy): Unit vector towards the sun
+	v3 ToSun;
+};
+
+struct path_tracer_camera
+{
+	v3 Position;
+	v3 Front, Right, Up;
+	real32 TanHalfFoV;
+	real32 AspectRatio;
+};
+
+// NOTE(georgy): Running means over all the samples so far, row major, top row first
+struct path_tracer_image
+{
+	uint32_t Width, Height;
+	uint32_t SampleCount;
+
+	v3 *Albedo;
+	v3 *Direct;
+	v3 *Indirect;
+};
+
+// NOTE(georgy): Only objects whose mesh has a BVH end up in the path tracer's scene, their triangles are read back from it.
+// The world BVH goes to Arena, everything else used for building it to TempArena.
+static void
+BuildPathTracerScene(path_tracer_scene *PathTracer, memory_arena *Arena, memory_arena *TempArena, scene *Scene,
+					 triangle_bvh **MeshBVHs, v3 ToSun, job_system *JobSystem)
+{
+	temporary_memory TempMem = BeginTemporaryMemory(TempArena);
+
+	uint32_t TriangleCount = 0;
+	for(uint32_t Object = 0; Object < Scene->Count; Object++)
+	{
+		if((Scene->Meshes[Object] != SCENE_NO_MESH) && MeshBVHs[Scene->Meshes[Object]])
+		{
+			TriangleCount += MeshBVHs[Scene->Meshes[Object]]->TriangleCount;
+		}
+	}
+	Assert(TriangleCount > 0);
+
+	v3 *Positions = PushArray(TempArena, 3*TriangleCount, v3);
+	uint32_t *Indices = PushArray(TempArena, 3*TriangleCount, uint32_t);
+	PathTracer->Normals = PushArray(Arena, TriangleCount, v3);
+	PathTracer->Colors = PushArray(Arena, TriangleCount, v3);
+	PathTracer->ToSun = Normalize(ToSun);
+
+	uint32_t Triangle = 0;
+	for(uint32_t Object = 0; Object < Scene->Count; Object++)
+	{
+		triangle_bvh *MeshBVH = (Scene->Meshes[Object] != SCENE_NO_MESH) ? MeshBVHs[Scene->Meshes[Object]] : 0;
+		if(!MeshBVH)
+		{
+			continue;
+		}
+
+		mat4 World = Scene->WorldTransforms[Object];
+		for(uint32_t BlockIndex = 0; BlockIndex < MeshBVH->BlockCount; BlockIndex++)
+		{
+			bvh_triangle_block *Block = MeshBVH->Blocks + BlockIndex;
+			for(uint32_t Lane = 0; (Lane < 4) && (Block->Triangles[Lane] != BVH_NO_TRIANGLE); Lane++)
+			{
+				v3 P0 = V3(Block->V0X[Lane], Block->V0Y[Lane], Block->V0Z[Lane]);
+				v3 P1 = P0 + V3(Block->Edge1X[Lane], Block->Edge1Y[Lane], Block->Edge1Z[Lane]);
+				v3 P2 = P0 + V3(Block->Edge2X[Lane], Block->Edge2Y[Lane], Block->Edge2Z[Lane]);
+				P0 = (V4(P0, 1.0f) * World).xyz;
+				P1 = (V4(P1, 1.0f) * World).xyz;
+				P2 = (V4(P2, 1.0f) * World).xyz;
+
+				Positions[3*Triangle + 0] = P0;
+				Positions[3*Triangle + 1] = P1;
+				Positions[3*Triangle + 2] = P2;
+				Indices[3*Triangle + 0] = 3*Triangle + 0;
+				Indices[3*Triangle + 1] = 3*Triangle + 1;
+				Indices[3*Triangle + 2] = 3*Triangle + 2;
+
+				v3 Normal = Cross(P1 - P0, P2 - P0);
+				real32 NormalLength = Length(Normal);
+				PathTracer->Normals[Triangle] = (NormalLength > 0.0f) ? ((1.0f / NormalLength)*Normal) : V3(0.0f, 1.0f, 0.0f);
+				PathTracer->Colors[Triangle] = Scene->Colors[Object];
+				Triangle++;
+			}
+		}
+	}
+	Assert(Triangle == TriangleCount);
+
+	BuildTriangleBVH(&PathTracer->BVH, Arena, TempArena, Positions, sizeof(v3), Indices, TriangleCount, JobSystem);
+
+	EndTemporaryMemory(TempMem);
+}
+
+static void
+InitializePathTracerImage(path_tracer_image *Image, memory_arena *Arena, uint32_t Width, uint32_t Height)
+{
+	Image->Width = Width;
+	Image->Height = Height;
+	Image->SampleCount = 0;
+	Image->Albedo = PushArray(Arena, Width*Height, v3, true);
+	Image->Direct = PushArray(Arena, Width*Height, v3, true);
+	Image->Indirect = PushArray(Arena, Width*Height, v3, true);
+}
+
+//
+// NOTE(georgy): Random numbers. Every pixel and pass gets its own hashed seed, so the image doesn't depend on
+// which thread rendered which tile.
+//
+
+inline uint32_t
+HashPathTracerSeed(uint32_t Value)
+{
+	// NOTE(georgy): PCG hash
+	uint32_t State = Value*747796405u + 2891336453u;
+	uint32_t Word = ((State >> ((State >> 28u) + 4u)) ^ State)*277803737u;
+	uint32_t Result = (Word >> 22u) ^ Word;
+	return(Result);
+}
+
+// NOTE(georgy): xorshift32, uniform in [0, 1)
+inline real32
+RandomUnilateral(uint32_t *State)
+{
+	uint32_t X = *State;
+	X ^= X << 13;
+	X ^= X >> 17;
+	X ^= X << 5;
+	*State = X;
+	real32 Result = (real32)(X >> 8) * (1.0f / 16777216.0f);
+	return(Result);
+}
+
+// NOTE(georgy): Cosine weighted direction around the unit normal N. With a lambertian surface the cosine
+// and the pdf cancel, so the path's weight just gets multiplied by the color.
+static v3
+SampleCosineHemisphere(v3 N, real32 U1, real32 U2)
+{
+	// NOTE(georgy): Orthonormal basis without branches on the normal's direction (Duff et al.)
+	real32 Sign = copysignf(1.0f, N.z);
+	real32 A = -1.0f / (Sign + N.z);
+	real32 B = N.x*N.y*A;
+	v3 T = V3(1.0f + Sign*N.x*N.x*A, Sign*B, -Sign*N.x);
+	v3 Bitangent = V3(B, Sign + N.y*N.y*A, -N.y);
+
+	real32 R = sqrtf(U1);
+	real32 Phi = 2.0f*PI*U2;
+	v3 Result = (R*cosf(Phi))*T + (R*sinf(Phi))*Bitangent + sqrtf(1.0f - U1)*N;
+	return(Result);
+}
+
+//
+// NOTE(georgy): Rendering
+//
+
+struct path_tracer_render
+{
+	path_tracer_scene *Scene;
+	path_tracer_camera *Camera;
+	path_tracer_image *Image;
+	uint32_t SamplesPerPixel;
+	uint32_t MaxBounces;
+	uint32_t Seed;
+
+	uint32_t TileCountX;
+	uint64_t *TileRayCounts;
+};
+
+inline uint32_t
+CountPathTracerLanes(uint32_t Mask)
+{
+	uint32_t Result = (Mask & 1) + ((Mask >> 1) & 1) + ((Mask >> 2) & 1) + ((Mask >> 3) & 1);
+	return(Result);
+}
+
+inline void
+SetPathTracerRay(bvh_ray_packet *Packet, uint32_t Lane, v3 Origin, v3 Direction, real32 MaxT)
+{
+	Packet->OriginX[Lane] = Origin.x;
+	Packet->OriginY[Lane] = Origin.y;
+	Packet->OriginZ[Lane] = Origin.z;
+	Packet->DirectionX[Lane] = Direction.x;
+	Packet->DirectionY[Lane] = Direction.y;
+	Packet->DirectionZ[Lane] = Direction.z;
+	Packet->MaxT[Lane] = MaxT;
+}
+
+// NOTE(georgy): The 4 camera rays of a pixel and their shadow rays go the same way and are traced as a packet.
+// After a bounce they go all over the place, and a packet would visit every node any of them needs,
+// so from there on the rays are traced one at a time (still SIMD over the 4 children of a node).
+static void
+IntersectPathTracerRays(path_tracer_scene *Scene, bvh_ray_packet *Rays, uint32_t ActiveMask, bool Coherent)
+{
+	if(Coherent)
+	{
+		IntersectTriangleBVHPacket(&Scene->BVH, Rays);
+	}
+	else
+	{
+		for(uint32_t Lane = 0; Lane < 4; Lane++)
+		{
+			Rays->Triangles[Lane] = BVH_NO_TRIANGLE;
+			if(ActiveMask & (1 << Lane))
+			{
+				bvh_hit Hit = IntersectTriangleBVH(&Scene->BVH, V3(Rays->OriginX[Lane], Rays->OriginY[Lane], Rays->OriginZ[Lane]),
+												   V3(Rays->DirectionX[Lane], Rays->DirectionY[Lane], Rays->DirectionZ[Lane]), Rays->MaxT[Lane]);
+				Rays->T[Lane] = Hit.T;
+				Rays->Triangles[Lane] = Hit.Triangle;
+			}
+		}
+	}
+}
+
+// NOTE(georgy): Same as the packet version, occluded rays get T = -1
+static void
+OccludedPathTracerRays(path_tracer_scene *Scene, bvh_ray_packet *Rays, uint32_t ActiveMask, bool Coherent)
+{
+	if(Coherent)
+	{
+		OccludedTriangleBVHPacket(&Scene->BVH, Rays);
+	}
+	else
+	{
+		for(uint32_t Lane = 0; Lane < 4; Lane++)
+		{
+			Rays->T[Lane] = Rays->MaxT[Lane];
+			if((ActiveMask & (1 << Lane)) &&
+			   OccludedTriangleBVH(&Scene->BVH, V3(Rays->OriginX[Lane], Rays->OriginY[Lane], Rays->OriginZ[Lane]),
+								   V3(Rays->DirectionX[Lane], Rays->DirectionY[Lane], Rays->DirectionZ[Lane]), Rays->MaxT[Lane]))
+			{
+				Rays->T[Lane] = -1.0f;
+			}
+		}
+	}
+}
+
+// NOTE(georgy): 4 paths through pixel (X, Y). Adds the sums of the lanes that are Active to the pixel's sums
+// and returns the number of rays traced.
+static uint32_t
+TracePathTracerPaths(path_tracer_render *Render, uint32_t X, uint32_t Y, uint32_t ActiveMask, uint32_t *RandomState,
+					 v3 *AlbedoSum, v3 *DirectSum, v3 *IndirectSum)
+{
+	path_tracer_scene *Scene = Render->Scene;
+	path_tracer_camera *Camera = Render->Camera;
+	path_tracer_image *Image = Render->Image;
+	uint32_t Result = 0;
+
+	bvh_ray_packet Rays;
+	for(uint32_t Lane = 0; Lane < 4; Lane++)
+	{
+		real32 PX = 2.0f*(X + RandomUnilateral(RandomState)) / Image->Width - 1.0f;
+		real32 PY = 1.0f - 2.0f*(Y + RandomUnilateral(RandomState)) / Image->Height;
+		v3 Direction = Camera->Front + (PX*Camera->TanHalfFoV*Camera->AspectRatio)*Camera->Right + (PY*Camera->TanHalfFoV)*Camera->Up;
+		SetPathTracerRay(&Rays, Lane, Camera->Position, Direction, (ActiveMask & (1 << Lane)) ? FLT_MAX : 0.0f);
+	}
+
+	v3 Throughput[4] = {V3(1.0f, 1.0f, 1.0f), V3(1.0f, 1.0f, 1.0f), V3(1.0f, 1.0f, 1.0f), V3(1.0f, 1.0f, 1.0f)};
+	for(uint32_t Bounce = 0; (Bounce <= Render->MaxBounces) && ActiveMask; Bounce++)
+	{
+		IntersectPathTracerRays(Scene, &Rays, ActiveMask, Bounce == 0);
+		Result += CountPathTracerLanes(ActiveMask);
+
+		v3 HitPoints[4], Normals[4], Colors[4];
+		real32 SunCosines[4];
+		bvh_ray_packet ShadowRays;
+		uint32_t ShadowMask = 0;
+		for(uint32_t Lane = 0; Lane < 4; Lane++)
+		{
+			SetPathTracerRay(&ShadowRays, Lane, V3(0.0f, 0.0f, 0.0f), Scene->ToSun, 0.0f);
+			if(!(ActiveMask & (1 << Lane)))
+			{
+				continue;
+			}
+			if(Rays.Triangles[Lane] == BVH_NO_TRIANGLE)
+			{
+				ActiveMask &= ~(1 << Lane);
+				continue;
+			}
+
+			// NOTE(georgy): Surfaces are two sided, the normal is flipped to the side the ray came from
+			uint32_t Triangle = Rays.Triangles[Lane];
+			v3 Direction = V3(Rays.DirectionX[Lane], Rays.DirectionY[Lane], Rays.DirectionZ[Lane]);
+			v3 Normal = Scene->Normals[Triangle];
+			Normal = (Dot(Normal, Direction) > 0.0f) ? -Normal : Normal;
+			HitPoints[Lane] = V3(Rays.OriginX[Lane], Rays.OriginY[Lane], Rays.OriginZ[Lane]) + Rays.T[Lane]*Direction + PATH_TRACER_RAY_OFFSET*Normal;
+			Normals[Lane] = Normal;
+			Colors[Lane] = Scene->Colors[Triangle];
+			SunCosines[Lane] = Dot(Normal, Scene->ToSun);
+			if(Bounce == 0)
+			{
+				*AlbedoSum += Colors[Lane];
+			}
+			if(SunCosines[Lane] > 0.0f)
+			{
+				SetPathTracerRay(&ShadowRays, Lane, HitPoints[Lane], Scene->ToSun, FLT_MAX);
+				ShadowMask |= (1 << Lane);
+			}
+		}
+
+		if(ShadowMask)
+		{
+			OccludedPathTracerRays(Scene, &ShadowRays, ShadowMask, Bounce == 0);
+			Result += CountPathTracerLanes(ShadowMask);
+			for(uint32_t Lane = 0; Lane < 4; Lane++)
+			{
+				if((ShadowMask & (1 << Lane)) && (ShadowRays.T[Lane] > 0.0f))
+				{
+					v3 Light = SunCosines[Lane]*Hadamard(Throughput[Lane], Colors[Lane]);
+					if(Bounce == 0)
+					{
+						*DirectSum += Light;
+					}
+					else
+					{
+						*IndirectSum += Light;
+					}
+				}
+			}
+		}
+
+		for(uint32_t Lane = 0; Lane < 4; Lane++)
+		{
+			if(ActiveMask & (1 << Lane))
+			{
+				// NOTE(georgy): Indirect is what arrives at the first surface, its own color isn't part of it
+				Throughput[Lane] = (Bounce == 0) ? Throughput[Lane] : Hadamard(Throughput[Lane], Colors[Lane]);
+				v3 Direction = SampleCosineHemisphere(Normals[Lane], RandomUnilateral(RandomState), RandomUnilateral(RandomState));
+				SetPathTracerRay(&Rays, Lane, HitPoints[Lane], Direction, FLT_MAX);
+			}
+			else
+			{
+				Rays.MaxT[Lane] = 0.0f;
+			}
+		}
+	}
+
+	return(Result);
+}
+
+static void
+RenderPathTracerTiles(uint32_t FirstTile, uint32_t OnePastLastTile, void *UserData)
+{
+	path_tracer_render *Render = (path_tracer_render *)UserData;
+	path_tracer_image *Image = Render->Image;
+	real32 OldWeight = (real32)Image->SampleCount / (Image->SampleCount + Render->SamplesPerPixel);
+	real32 NewWeight = 1.0f / (Image->SampleCount + Render->SamplesPerPixel);
+
+	for(uint32_t Tile = FirstTile; Tile < OnePastLastTile; Tile++)
+	{
+		uint32_t MinX = (Tile % Render->TileCountX)*PATH_TRACER_TILE_SIZE;
+		uint32_t MinY = (Tile / Render->TileCountX)*PATH_TRACER_TILE_SIZE;
+		uint32_t OnePastMaxX = (MinX + PATH_TRACER_TILE_SIZE < Image->Width) ? (MinX + PATH_TRACER_TILE_SIZE) : Image->Width;
+		uint32_t OnePastMaxY = (MinY + PATH_TRACER_TILE_SIZE < Image->Height) ? (MinY + PATH_TRACER_TILE_SIZE) : Image->Height;
+
+		uint64_t RayCount = 0;
+		for(uint32_t Y = MinY; Y < OnePastMaxY; Y++)
+		{
+			for(uint32_t X = MinX; X < OnePastMaxX; X++)
+			{
+				uint32_t Pixel = Y*Image->Width + X;
+				uint32_t RandomState = HashPathTracerSeed(HashPathTracerSeed(Pixel ^ HashPathTracerSeed(Render->Seed)) + Image->SampleCount);
+				RandomState = RandomState ? RandomState : 1;
+
+				v3 AlbedoSum = V3(0.0f, 0.0f, 0.0f), DirectSum = V3(0.0f, 0.0f, 0.0f), IndirectSum = V3(0.0f, 0.0f, 0.0f);
+				for(uint32_t Sample = 0; Sample < Render->SamplesPerPixel; Sample += 4)
+				{
+					uint32_t LaneCount = ((Render->SamplesPerPixel - Sample) < 4) ? (Render->SamplesPerPixel - Sample) : 4;
+					RayCount += TracePathTracerPaths(Render, X, Y, (1 << LaneCount) - 1, &RandomState, &AlbedoSum, &DirectSum, &IndirectSum);
+				}
+
+				Image->Albedo[Pixel] = OldWeight*Image->Albedo[Pixel] + NewWeight*AlbedoSum;
+				Image->Direct[Pixel] = OldWeight*Image->Direct[Pixel] + NewWeight*DirectSum;
+				Image->Indirect[Pixel] = OldWeight*Image->Indirect[Pixel] + NewWeight*IndirectSum;
+			}
+		}
+		Render->TileRayCounts[Tile] = RayCount;
+	}
+}
+
+// NOTE(georgy): Adds SamplesPerPixel more samples to every pixel of the image, so a reference can be refined
+// a pass at a time. Seed only has to differ between images that should have independent noise.
+// Returns the number of rays traced.
+static uint64_t
+RenderPathTracerImage(path_tracer_scene *Scene, path_tracer_camera *Camera, path_tracer_image *Image, uint32_t SamplesPerPixel,
+					  uint32_t MaxBounces, uint32_t Seed, memory_arena *TempArena, job_system *JobSystem)
+{
+	temporary_memory TempMem = BeginTemporaryMemory(TempArena);
+
+	path_tracer_render Render;
+	Render.Scene = Scene;
+	Render.Camera = Camera;
+	Render.Image = Image;
+	Render.SamplesPerPixel = SamplesPerPixel;
+	Render.MaxBounces = MaxBounces;
+	Render.Seed = Seed;
+	Render.TileCountX = (Image->Width + PATH_TRACER_TILE_SIZE - 1) / PATH_TRACER_TILE_SIZE;
+	uint32_t TileCountY = (Image->Height + PATH_TRACER_TILE_SIZE - 1) / PATH_TRACER_TILE_SIZE;
+	uint32_t TileCount = Render.TileCountX*TileCountY;
+	Render.TileRayCounts = PushArray(TempArena, TileCount, uint64_t);
+
+	ParallelFor(JobSystem, TileCount, RenderPathTracerTiles, &Render);
+	Image->SampleCount += SamplesPerPixel;
+
+	uint64_t Result = 0;
+	for(uint32_t Tile = 0; Tile < TileCount; Tile++)
+	{
+		Result += Render.TileRayCounts[Tile];
+	}
+
+	EndTemporaryMemory(TempMem);
+	return(Result);
+}
+
+//
+// NOTE(georgy): Comparing and saving images
+//
+
+// NOTE(georgy): Root mean square difference over all pixels and channels
+static real32
+GetImageRMSE(v3 *A, v3 *B, uint32_t PixelCount)
+{
+	real64 Sum = 0.0;
+	for(uint32_t Pixel = 0; Pixel < PixelCount; Pixel++)
+	{
+		v3 Difference = A[Pixel] - B[Pixel];
+		Sum += Dot(Difference, Difference);
+	}
+	real32 Result = (real32)sqrt(Sum / (3.0*PixelCount));
+	return(Result);
+}
+
+// NOTE(georgy): Portable float map, linear values, so an image can be compared with a real-time capture exactly.
+// PFM rows go bottom to top.
+static bool
+WritePFM(const char *Filename, v3 *Pixels, uint32_t Width, uint32_t Height)
+{
+	FILE *File = fopen(Filename, "wb");
+	if(!File)
+	{
+		return(false);
+	}
+
+	fprintf(File, "PF\n%u %u\n-1.0\n", Width, Height);
+	bool Result = true;
+	for(uint32_t Row = 0; Row < Height; Row++)
+	{
+		v3 *Line = Pixels + (Height - 1 - Row)*Width;
+		Result = Result && (fwrite(Line, sizeof(v3), Width, File) == Width);
+	}
+	fclose(File);
+
+	return(Result);
+}
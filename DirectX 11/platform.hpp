@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+//
+// NOTE(georgy): What the platform layer hands to the portable game and renderer code, and the few services it provides back.
+// Win32 lives in main.cpp; headless runs (linux_bench.cpp) fill this in themselves.
+//
+
+struct game_button_state
+{
+	uint32_t HalfTransitionCount;
+	bool EndedDown;
+};
+
+struct game_input
+{
+	int32_t MouseX, MouseY;
+	int32_t DeltaMouseX, DeltaMouseY;
+
+	// NOTE(georgy): Cursor position in the window's client area and the client area's size, in pixels
+	int32_t CursorX, CursorY;
+	int32_t WindowWidth, WindowHeight;
+
+	union
+	{
+		game_button_state Buttons[6];
+		struct
+		{
+			game_button_state MoveForward;
+			game_button_state MoveBack;
+			game_button_state MoveLeft;
+			game_button_state MoveRight;
+			game_button_state RenderReference;
+			game_button_state Pick; // NOTE(georgy): Left mouse button
+		};
+	};
+};
+
+typedef void platform_debug_output(const char *Text);
+
+struct job_system;
+
+struct platform_api
+{
+	platform_debug_output *DebugOutput;
+	job_system *JobSystem;
+};
+
+global_variable platform_api Platform;
@@ -0,0 +1,1433 @@
+#pragma once
+
+#include <vector>
+
+#include "platform.hpp"
+#include "graphics.hpp"
+#include "frame_graph.hpp"
+#include "shadow_cascades.hpp"
+#include "shadow_cache.hpp"
+#include "renderer_frame_graph.hpp"
+#include "spsc_queue.hpp"
+#include "constant_ring.hpp"
+#include "draw_list.hpp"
+#include "frustum.hpp"
+#include "rsm_samples.hpp"
+#include "bilateral_upsample.hpp"
+#include "temporal_accumulation.hpp"
+#include "depth_aware_blur.hpp"
+
+//
+// NOTE(georgy): Portable renderer core. Talks to the GPU only through graphics_device/graphics_context,
+// so the same frame runs on D3D11 and on the null backend.
+//
+
+// NOTE(georgy): Constant buffer layout, it has to match the cbuffers in the shaders. Uploaded once per frame.
+struct frame_constants
+{
+	mat4 CameraProjection;
+	mat4 CameraView;
+	mat4 LightProjection;
+	mat4 LightView;
+
+	v4 WorldVectorsToFarCorners[4];
+	v4 CameraWorldPos;
+
+	mat4 ViewToPrevClip;
+	v2 RSMFrameRotation;
+	real32 HistoryValid;
+	real32 Pad;
+
+	// NOTE(georgy): Light view and projection of every cascade, the camera's view space Z each one ends at and its depth bias
+	mat4 CascadeViewProjections[SHADOW_CASCADE_COUNT];
+	v4 CascadeSplits;
+	v4 CascadeBiases;
+
+	// NOTE(georgy): Tiles of the shadow and RSM atlases, UV of the corner in XY and the size in Z
+	v4 CascadeAtlasRects[SHADOW_CASCADE_COUNT];
+	v4 RSMAtlasRect;
+};
+static_assert(SHADOW_CASCADE_COUNT == 4, "Cascade splits and biases are uploaded as a v4");
+
+// NOTE(georgy): Per-instance vertex data (slot 1 of InputLayout), it has to match the instance inputs of the object shaders
+struct instance_data
+{
+	mat4 Model;
+	v3 Color;
+	real32 Pad;
+};
+
+struct vertex
+{
+	v3 Pos;
+	v3 Normal;
+};
+
+struct mesh
+{
+	uint32_t IndexOffset;
+	uint32_t IndexCount;
+
+	gfx_buffer *IndexBuffer;
+};
+
+struct model
+{
+	std::vector<mesh> Meshes;
+
+	gfx_buffer *VertexBuffer;
+};
+
+// NOTE(georgy): Meshes must already have their index ranges, this creates the GPU buffers for them
+static void
+UploadModel(graphics_device *Device, model *Model, vertex *Vertices, uint32_t VertexCount, uint32_t *Indices)
+{
+	gfx_buffer_desc VertexBufferDescr = BufferDesc(sizeof(vertex)*VertexCount, GfxBufferUsage_Immutable, GfxBufferBind_Vertex, Vertices);
+	Model->VertexBuffer = Device->CreateBuffer(Device, &VertexBufferDescr);
+	for(uint32_t MeshIndex = 0; MeshIndex < Model->Meshes.size(); MeshIndex++)
+	{
+		mesh *Mesh = &Model->Meshes[MeshIndex];
+
+		gfx_buffer_desc IndexBufferDescr = BufferDesc(sizeof(uint32_t)*Mesh->IndexCount, GfxBufferUsage_Immutable, GfxBufferBind_Index, Indices + Mesh->IndexOffset);
+		Mesh->IndexBuffer = Device->CreateBuffer(Device, &IndexBufferDescr);
+	}
+}
+
+//
+// NOTE(georgy): Frame packets
+//
+
+enum render_mesh
+{
+	RenderMesh_Bunny,
+	RenderMesh_Quad,
+
+	RenderMesh_Count
+};
+
+// NOTE(georgy): Bounds are the world space AABB of the object, as center and half extent.
+// Dynamic objects are drawn over the cached static layer of the light maps every frame.
+struct render_object
+{
+	mat4 Model;
+	v3 Color;
+	render_mesh Mesh;
+	v3 BoundsCenter;
+	v3 BoundsExtent;
+	bool Dynamic;
+};
+
+// NOTE(georgy): Layer field of the draw keys, a view draws its static objects before its dynamic ones
+enum render_layer
+{
+	RenderLayer_Static,
+	RenderLayer_Dynamic,
+
+	RenderLayer_Count
+};
+
+// NOTE(georgy): Passes that draw the objects of the frame packet. Every view belongs to one of them.
+enum render_pass
+{
+	RenderPass_ShadowMap,
+	RenderPass_ShadowCascade,
+	RenderPass_GBuffer,
+
+	RenderPass_Count
+};
+
+// NOTE(georgy): A point of view the scene is drawn from. Every view is culled against its own frustum and gets its own draws,
+// so another shadow cascade or light is just another view. Views are drawn in the order they are in the packet.
+// The RSM's light view, the shadow cascades and the camera.
+#define MAX_RENDER_VIEWS (SHADOW_CASCADE_COUNT + 2)
+struct render_view
+{
+	render_pass Pass;
+	mat4 View;
+	mat4 Projection;
+
+	// NOTE(georgy): A static object moved inside the view since the last packet, the view's static layer is stale
+	bool StaticCastersMoved;
+};
+
+// NOTE(georgy): Everything the render thread needs to draw a frame.
+// The game thread fills it and doesn't touch it anymore after it's pushed to the queue.
+// Arrays point into the frame arena of the frame the packet belongs to.
+#define MAX_FRAME_PACKET_OBJECTS 4096
+struct frame_packet
+{
+	bool Quit;
+
+	v3 CameraWorldPos;
+	mat4 CameraView;
+	mat4 CameraProjection;
+	v4 FrustumFarCornersWorldSpace[4];
+
+	mat4 LightView;
+	mat4 LightProjection;
+	shadow_atlas_rect RSMTile;
+	shadow_cascades ShadowCascades;
+
+	uint32_t ViewCount;
+	render_view Views[MAX_RENDER_VIEWS];
+
+	uint32_t ObjectCount;
+	uint32_t MaxObjectCount;
+	render_object *Objects;
+};
+
+inline void
+AddRenderView(frame_packet *Packet, render_pass Pass, mat4 View, mat4 Projection)
+{
+	Assert(Packet->ViewCount < MAX_RENDER_VIEWS);
+
+	render_view *RenderView = Packet->Views + Packet->ViewCount++;
+	RenderView->Pass = Pass;
+	RenderView->View = View;
+	RenderView->Projection = Projection;
+	RenderView->StaticCastersMoved = false;
+}
+
+inline void
+PushRenderObject(frame_packet *Packet, render_mesh Mesh, mat4 Model, v3 Color, v3 BoundsCenter, v3 BoundsExtent, bool Dynamic = false)
+{
+	Assert(Packet->ObjectCount < Packet->MaxObjectCount);
+
+	render_object *Object = Packet->Objects + Packet->ObjectCount++;
+	Object->Model = Model;
+	Object->Color = Color;
+	Object->Mesh = Mesh;
+	Object->BoundsCenter = BoundsCenter;
+	Object->BoundsExtent = BoundsExtent;
+	Object->Dynamic = Dynamic;
+}
+
+// NOTE(georgy): Double-buffered: the game thread fills one packet while the render thread submits the other.
+// Each frame in flight also needs its own frame arena.
+#define FRAME_PACKET_COUNT 2
+static_assert(FRAME_ARENA_COUNT > FRAME_PACKET_COUNT, "Frame arenas must outlive the frame packets that point into them");
+typedef spsc_queue<frame_packet, FRAME_PACKET_COUNT> frame_packet_queue;
+
+// NOTE(georgy): DXGI lets the CPU get at most 3 frames ahead of the GPU (default maximum frame latency), Present blocks after that.
+// So when we start frame N, frames before N - 3 are done and their instance data can be overwritten.
+#define RENDERER_MAX_FRAMES_IN_FLIGHT 3
+static_assert(RENDERER_MAX_FRAMES_IN_FLIGHT < CONSTANT_RING_MAX_FRAMES_IN_FLIGHT, "Instance ring has to track every frame in flight");
+
+// NOTE(georgy): At most a draw per object and view. The view index is the pass field of the draw keys,
+// so draws come out of the sort in view order.
+#define RENDERER_MAX_DRAWS (MAX_RENDER_VIEWS*MAX_FRAME_PACKET_OBJECTS)
+static_assert(MAX_RENDER_VIEWS <= (1 << DRAW_KEY_PASS_BITS), "View index has to fit in the pass field of the draw keys");
+static_assert(MAX_RENDER_VIEWS <= 8, "View masks are 8 bits");
+
+// NOTE(georgy): Culling splits the packet's objects into blocks, every block is tested against all views by one job
+#define RENDERER_CULL_BLOCK_SIZE 256
+#define RENDERER_MAX_CULL_BLOCKS ((MAX_FRAME_PACKET_OBJECTS + RENDERER_CULL_BLOCK_SIZE - 1) / RENDERER_CULL_BLOCK_SIZE)
+
+// NOTE(georgy): Front to back inside the same state. Few buckets, so draws of the same mesh stay together and instancing still works.
+#define RENDERER_DEPTH_BUCKET_COUNT 16
+
+// NOTE(georgy): 8 R2 samples per frame, rotated by 4x4 blue noise and a new angle every frame.
+// With the 4x4 blue noise R2 has the smallest error of the patterns at 8 and 16 samples (linux_bench rsmsamples,
+// raw 16.3 and 9.6 against 16.4 and 12.3 for the original set and 18.6 and 15.5 for random ones).
+// Accumulated over frames that is closer to the exact gather than 16 samples blurred in one frame (linux_bench temporal).
+// The noise tile is about the size of the blur, so a blurred pixel averages most of the 16 rotations.
+#define RENDERER_RSM_SAMPLE_COUNT 8
+#define RENDERER_RSM_SAMPLE_PATTERN RSMSamplePattern_R2
+#define RENDERER_RSM_NOISE_SIZE 4
+// NOTE(georgy): Of the depth aware blur after accumulation, 3 taps per direction. Smallest error against the exact gather
+// of radii 1 to 4 (linux_bench blur), wider ones blur away more detail than noise is left.
+#define RENDERER_RSM_BLUR_RADIUS 1
+
+// NOTE(georgy): Pipeline statistics of a pass are read back this many frames after they were asked for,
+// by then the GPU is done with them and GetData doesn't have to wait
+#define RENDERER_QUERY_LATENCY (RENDERER_MAX_FRAMES_IN_FLIGHT + 1)
+#define RENDERER_NO_QUERY_FRAME UINT64_MAX
+
+// NOTE(georgy): Instance data is one allocation per frame, one instance per draw. Enough for every frame in flight
+// and the frame being written, plus one more frame for what gets skipped when an allocation wraps.
+#define RENDERER_INSTANCE_FRAME_SIZE ((RENDERER_MAX_DRAWS*sizeof(instance_data) + GFX_CONSTANT_BUFFER_ALIGNMENT - 1) & ~(GFX_CONSTANT_BUFFER_ALIGNMENT - 1))
+#define RENDERER_INSTANCE_RING_SIZE ((RENDERER_MAX_FRAMES_IN_FLIGHT + 2)*RENDERER_INSTANCE_FRAME_SIZE)
+
+// NOTE(georgy): Neighbouring draws in the sorted list with the same state, drawn with one instanced draw per part of the mesh
+struct instance_batch
+{
+	uint32_t View;
+	render_layer Layer;
+	render_mesh Mesh;
+	uint32_t FirstInstance;
+	uint32_t InstanceCount;
+};
+
+//
+// NOTE(georgy): Quality tiers
+//
+
+enum renderer_quality
+{
+	RendererQuality_Low,
+	RendererQuality_High,
+};
+
+struct renderer_settings
+{
+	// NOTE(georgy): Depth only pass before the G-buffer, which then shades every pixel once (only where its depth is equal).
+	// Draws are already front to back, so it saves ~1% of the G-buffer pixel shader on the game scene and ~20% on rows
+	// of props (linux_bench prepass), for the G-buffer's vertex work once more. That's why it's off on the low tier.
+	bool DepthPrepass;
+
+	// NOTE(georgy): Cascades looked up through their filtered moments (shadow_moments.hpp), one trilinear fetch with soft
+	// edges instead of one hard compare. Costs a 2048^2 RGBA32F atlas with mips and a blur of every cascade that changed.
+	bool ShadowMoments;
+};
+
+inline renderer_settings
+GetRendererSettings(renderer_quality Quality)
+{
+	renderer_settings Result = {};
+	Result.DepthPrepass = (Quality >= RendererQuality_High);
+	Result.ShadowMoments = (Quality >= RendererQuality_High);
+	return(Result);
+}
+
+//
+// NOTE(georgy): Renderer
+//
+
+static const real32 ClearColorBlack[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+static const real32 ClearColorWhite[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+struct renderer
+{
+	uint32_t Width, Height;
+	renderer_settings Settings;
+
+	frame_graph_backend FrameGraphBackend;
+	frame_graph FrameGraph;
+	renderer_frame_graph Graph;
+
+	gfx_texture *ShadowMap;
+	gfx_texture *ShadowAtlas;
+	gfx_texture *RSMWorldPos;
+	gfx_texture *RSMNormals;
+	gfx_texture *Flux;
+	gfx_texture *Normals;
+	gfx_texture *RSMIndirectIllum;
+	gfx_texture *Color;
+	gfx_texture *LinearDepth;
+	gfx_texture *Depth;
+	gfx_texture *RSMBlurHorizontal;
+	gfx_texture *RSMIndirectIllumAfterBlur;
+	gfx_texture *ShadowMomentsBlur;
+	gfx_texture *BackBuffer;
+
+	// NOTE(georgy): 0 without the moments filter. Kept from frame to frame, only the cascades that changed are filtered again.
+	gfx_texture *ShadowMoments;
+
+	// NOTE(georgy): Temporal accumulation writes RSMHistory[FrameIndex & 1] and reads the other one
+	uint64_t FrameIndex;
+	gfx_texture *RSMHistory[2];
+	mat4 PrevViewProjection;
+
+	gfx_vertex_shader *FullScreenQuadVS;
+	gfx_vertex_shader *DeferredVS;
+	gfx_pixel_shader *DeferredPS;
+	gfx_vertex_shader *ShadowMapVS;
+	gfx_pixel_shader *ShadowMapPS;
+	gfx_vertex_shader *ShadowCascadeVS;
+	gfx_vertex_shader *GBufferVS;
+	gfx_pixel_shader *GBufferPS;
+	gfx_pixel_shader *RSMPS;
+	gfx_pixel_shader *TemporalPS;
+	gfx_pixel_shader *BlurPS;
+	gfx_pixel_shader *ShadowMomentsHorizontalPS;
+	gfx_pixel_shader *ShadowMomentsVerticalPS;
+	gfx_pixel_shader *ShadowCacheCopyPS;
+	gfx_pixel_shader *ShadowCacheClearPS;
+
+	gfx_input_layout *InputLayout;
+	gfx_input_layout *FullScreenQuadInputLayout;
+
+	gfx_raster_state *RasterizerState;
+	gfx_depth_state *DepthStencilState;
+	gfx_depth_state *DepthEqualState;
+	gfx_depth_state *DepthAlwaysState;
+	gfx_depth_state *DepthOverwriteState;
+	gfx_blend_state *BlendState;
+
+	gfx_sampler *SamplerState;
+	gfx_sampler *PointSamplerState;
+	gfx_sampler *ShadowMapSamplerState;
+	gfx_sampler *ShadowMomentsSamplerState;
+
+	gfx_buffer *FullScreenQuadVertexBuffer;
+	gfx_buffer *FrameConstantsBuffer;
+	gfx_buffer *RSMSamplesBuffer;
+	gfx_buffer *RSMNoiseBuffer;
+	// NOTE(georgy): Horizontal and vertical pass of the blur
+	gfx_buffer *BlurConstantsBuffer[2];
+	// NOTE(georgy): One per cascade, tells ShadowCascadeVS which of the cascades it draws
+	gfx_buffer *CascadeConstantsBuffer[SHADOW_CASCADE_COUNT];
+
+	// NOTE(georgy): Views of the current packet. Bit V of an object's view mask is set if it's visible in view V.
+	uint32_t ViewCount;
+	render_view Views[MAX_RENDER_VIEWS];
+	uint32_t ViewVisibleCounts[MAX_RENDER_VIEWS];
+	uint8_t ViewMasks[MAX_FRAME_PACKET_OBJECTS];
+
+	// NOTE(georgy): Draws of the current packet, sorted by key. Instance data is written in the same order,
+	// so every batch is a range of instances. No batches if the instance data didn't fit in the ring.
+	draw_list DrawList;
+	draw_item DrawItems[RENDERER_MAX_DRAWS];
+	draw_item DrawSortBuffer[RENDERER_MAX_DRAWS];
+
+	constant_ring InstanceRing;
+	constant_allocation Instances;
+	uint32_t BatchCount;
+	instance_batch Batches[RENDERER_MAX_DRAWS];
+	uint32_t ViewFirstBatch[MAX_RENDER_VIEWS + 1];
+	uint32_t ViewFirstDynamicBatch[MAX_RENDER_VIEWS];
+
+	// NOTE(georgy): The light maps and their static layers, indexed by renderer_light_map. LightViewCaches are per view
+	// of the packet, what the view's tile has in it. The views of the packets have to come in the same order every frame.
+	gfx_texture *LightMaps[RendererLightMap_Count];
+	gfx_texture *StaticLightMaps[RendererLightMap_Count];
+	shadow_cache_view LightViewCaches[MAX_RENDER_VIEWS];
+
+	// NOTE(georgy): A query per frame graph pass for every frame the results are waited for, and the frame each one
+	// was issued in (RENDERER_NO_QUERY_FRAME before its first use). PassStatistics are the last results that came back,
+	// PassStatisticsFrames the frames they are for.
+	gfx_query *PassQueries[MAX_FRAME_GRAPH_PASSES][RENDERER_QUERY_LATENCY];
+	uint64_t PassQueryFrames[MAX_FRAME_GRAPH_PASSES][RENDERER_QUERY_LATENCY];
+	gfx_pipeline_statistics PassStatistics[MAX_FRAME_GRAPH_PASSES];
+	uint64_t PassStatisticsFrames[MAX_FRAME_GRAPH_PASSES];
+
+	model BunnyModel;
+	model QuadModel;
+};
+
+inline model *
+GetRenderMeshModel(renderer *Renderer, render_mesh Mesh)
+{
+	model *Result = 0;
+	switch(Mesh)
+	{
+		case RenderMesh_Bunny: Result = &Renderer->BunnyModel; break;
+		case RenderMesh_Quad: Result = &Renderer->QuadModel; break;
+		default: Assert(!"Unknown render mesh");
+	}
+	return(Result);
+}
+
+// NOTE(georgy): Also used on the CPU, for the quad's triangle BVH
+global_variable vertex QuadVertices[] =
+{
+	{V3(-1.0f, -1.0f, 0.0f), V3(0.0f, 0.0f, -1.0f)},
+	{V3(1.0f, -1.0f, 0.0f), V3(0.0f, 0.0f, -1.0f)},
+	{V3(-1.0f, 1.0f, 0.0f), V3(0.0f, 0.0f, -1.0f)},
+	{V3(1.0f, 1.0f, 0.0f), V3(0.0f, 0.0f, -1.0f)}
+};
+global_variable uint32_t QuadIndices[] = {0, 1, 2, 2, 1, 3};
+
+static void
+InitializeRenderer(renderer *Renderer, graphics_device *Device, uint32_t Width, uint32_t Height, gfx_texture *BackBuffer,
+				   renderer_quality Quality)
+{
+	Renderer->Width = Width;
+	Renderer->Height = Height;
+	Renderer->Settings = GetRendererSettings(Quality);
+
+	// NOTE(georgy): Render targets. They all come from the frame graph, which shares textures between the ones
+	// that are never alive at the same time (e.g. blurred indirect illumination reuses the texture of the gather).
+	frame_graph *FrameGraph = &Renderer->FrameGraph;
+	renderer_frame_graph *Graph = &Renderer->Graph;
+	Renderer->ShadowMoments = 0;
+	if(Renderer->Settings.ShadowMoments)
+	{
+		texture_desc ShadowMomentsDesc = GetRendererShadowMomentsDesc();
+		Renderer->ShadowMoments = Device->CreateTexture(Device, &ShadowMomentsDesc, "ShadowMoments");
+	}
+	texture_desc RSMHistoryDesc = TextureDesc((Width + RENDERER_RSM_DOWNSAMPLE - 1) / RENDERER_RSM_DOWNSAMPLE, (Height + RENDERER_RSM_DOWNSAMPLE - 1) / RENDERER_RSM_DOWNSAMPLE,
+											  TextureFormat_RGBA16F, TextureBind_RenderTarget | TextureBind_ShaderResource);
+	Renderer->RSMHistory[0] = Device->CreateTexture(Device, &RSMHistoryDesc, "RSMHistory0");
+	Renderer->RSMHistory[1] = Device->CreateTexture(Device, &RSMHistoryDesc, "RSMHistory1");
+	Renderer->FrameIndex = 0;
+	for(uint32_t Map = 0; Map < RendererLightMap_Count; Map++)
+	{
+		texture_desc LightMapDesc = GetRendererLightMapDesc((renderer_light_map)Map);
+		Renderer->LightMaps[Map] = Device->CreateTexture(Device, &LightMapDesc, RendererLightMapNames[Map]);
+		Renderer->StaticLightMaps[Map] = Device->CreateTexture(Device, &LightMapDesc, RendererStaticLightMapNames[Map]);
+	}
+	for(uint32_t View = 0; View < MAX_RENDER_VIEWS; View++)
+	{
+		InvalidateShadowCacheView(Renderer->LightViewCaches + View);
+	}
+	InitializeGraphicsDeviceFrameGraphBackend(&Renderer->FrameGraphBackend, Device);
+	InitializeFrameGraph(FrameGraph, &Renderer->FrameGraphBackend);
+	DeclareRendererFrameGraph(FrameGraph, Graph, Width, Height, BackBuffer, (void **)Renderer->RSMHistory, (void **)Renderer->LightMaps,
+							  Renderer->ShadowMoments, Renderer->Settings.DepthPrepass);
+	CompileFrameGraph(FrameGraph);
+
+	// NOTE(georgy): Queries are named after their pass, that's how a capture tells which pass did what
+	for(uint32_t Pass = 0; Pass < FrameGraph->PassCount; Pass++)
+	{
+		for(uint32_t Slot = 0; Slot < RENDERER_QUERY_LATENCY; Slot++)
+		{
+			Renderer->PassQueries[Pass][Slot] = Device->CreateQuery(Device, FrameGraph->Passes[Pass].Name);
+			Renderer->PassQueryFrames[Pass][Slot] = RENDERER_NO_QUERY_FRAME;
+		}
+		Renderer->PassStatistics[Pass] = {};
+		Renderer->PassStatisticsFrames[Pass] = RENDERER_NO_QUERY_FRAME;
+	}
+
+	Renderer->ShadowMap = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->ShadowMap);
+	Renderer->ShadowAtlas = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->ShadowAtlas);
+	Renderer->RSMWorldPos = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->RSMWorldPos);
+	Renderer->RSMNormals = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->RSMNormals);
+	Renderer->Flux = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->Flux);
+	Renderer->Normals = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->Normals);
+	Renderer->RSMIndirectIllum = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->RSMIndirectIllum);
+	Renderer->Color = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->Color);
+	Renderer->LinearDepth = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->LinearDepth);
+	Renderer->Depth = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->Depth);
+	Renderer->RSMBlurHorizontal = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->RSMBlurHorizontal);
+	Renderer->RSMIndirectIllumAfterBlur = (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->RSMIndirectIllumAfterBlur);
+	Renderer->ShadowMomentsBlur = Renderer->ShadowMoments ? (gfx_texture *)GetFrameGraphTexture(FrameGraph, Graph->ShadowMomentsBlur) : 0;
+	Renderer->BackBuffer = BackBuffer;
+
+	char FrameGraphInfo[256];
+	snprintf(FrameGraphInfo, sizeof(FrameGraphInfo), "Frame graph: %u transient textures in %u physical, %.2fMB instead of %.2fMB\n",
+			 FrameGraph->Stats.TransientTextureCount, FrameGraph->Stats.PhysicalTextureCount,
+			 FrameGraph->Stats.AliasedBytes / (1024.0*1024.0), FrameGraph->Stats.UnaliasedBytes / (1024.0*1024.0));
+	Platform.DebugOutput(FrameGraphInfo);
+
+	// NOTE(georgy): Samples and per pixel rotations for the RSM gather
+	rsm_sample_constants RSMSamples = {};
+	RSMSamples.SampleCount = RENDERER_RSM_SAMPLE_COUNT;
+	RSMSamples.NoiseSize = RENDERER_RSM_NOISE_SIZE;
+	GenerateRSMSamples(RSMSamples.Samples, RSMSamples.SampleCount, RENDERER_RSM_SAMPLE_PATTERN);
+
+	rsm_noise_constants RSMNoise = {};
+	GenerateRSMNoise(&RSMNoise, RSMSamples.NoiseSize);
+
+	// NOTE(georgy): Shaders
+	Renderer->FullScreenQuadVS = Device->CreateVertexShader(Device, "shaders/FullScreenQuadVS.hlsl", "VS");
+	Renderer->DeferredVS = Device->CreateVertexShader(Device, "shaders/DeferredVS.hlsl", "VS");
+	Renderer->DeferredPS = Device->CreatePixelShader(Device, "shaders/DeferredPS.hlsl", "PS");
+	Renderer->ShadowMapVS = Device->CreateVertexShader(Device, "shaders/ShadowMapVS.hlsl", "VS");
+	Renderer->ShadowMapPS = Device->CreatePixelShader(Device, "shaders/ShadowMapPS.hlsl", "PS");
+	Renderer->ShadowCascadeVS = Device->CreateVertexShader(Device, "shaders/ShadowCascadeVS.hlsl", "VS");
+	Renderer->GBufferVS = Device->CreateVertexShader(Device, "shaders/GBufferVS.hlsl", "VS");
+	Renderer->GBufferPS = Device->CreatePixelShader(Device, "shaders/GBufferPS.hlsl", Renderer->Settings.ShadowMoments ? "MomentsPS" : "PS");
+	Renderer->RSMPS = Device->CreatePixelShader(Device, "shaders/RSMPS.hlsl", "PS");
+	Renderer->TemporalPS = Device->CreatePixelShader(Device, "shaders/TemporalPS.hlsl", "PS");
+	Renderer->BlurPS = Device->CreatePixelShader(Device, "shaders/BlurPS.hlsl", "PS");
+	Renderer->ShadowMomentsHorizontalPS = Device->CreatePixelShader(Device, "shaders/ShadowMomentsPS.hlsl", "HorizontalPS");
+	Renderer->ShadowMomentsVerticalPS = Device->CreatePixelShader(Device, "shaders/ShadowMomentsPS.hlsl", "VerticalPS");
+	Renderer->ShadowCacheCopyPS = Device->CreatePixelShader(Device, "shaders/ShadowCachePS.hlsl", "CopyPS");
+	Renderer->ShadowCacheClearPS = Device->CreatePixelShader(Device, "shaders/ShadowCachePS.hlsl", "ClearPS");
+
+	// NOTE(georgy): Fixed function state
+	gfx_raster_state_desc RasterizerStateDescr = {};
+	RasterizerStateDescr.CullMode = GfxCullMode_None;
+	RasterizerStateDescr.FrontCounterClockwise = true;
+	Renderer->RasterizerState = Device->CreateRasterState(Device, &RasterizerStateDescr);
+
+	gfx_depth_state_desc DepthStencilStateDescr = {};
+	DepthStencilStateDescr.DepthEnable = true;
+	DepthStencilStateDescr.DepthWrite = true;
+	DepthStencilStateDescr.DepthFunc = GfxComparison_Less;
+	Renderer->DepthStencilState = Device->CreateDepthState(Device, &DepthStencilStateDescr);
+
+	// NOTE(georgy): After the depth prepass. Only the closest surface has the same depth, and it's already written.
+	gfx_depth_state_desc DepthEqualStateDescr = {};
+	DepthEqualStateDescr.DepthEnable = true;
+	DepthEqualStateDescr.DepthWrite = false;
+	DepthEqualStateDescr.DepthFunc = GfxComparison_Equal;
+	Renderer->DepthEqualState = Device->CreateDepthState(Device, &DepthEqualStateDescr);
+
+	gfx_depth_state_desc DepthAlwaysStateDescr = {};
+	DepthAlwaysStateDescr.DepthEnable = false;
+	DepthAlwaysStateDescr.DepthWrite = true;
+	DepthAlwaysStateDescr.DepthFunc = GfxComparison_Less;
+	Renderer->DepthAlwaysState = Device->CreateDepthState(Device, &DepthAlwaysStateDescr);
+
+	// NOTE(georgy): Whatever the pixel shader says the depth is, copying and clearing tiles of the light maps
+	gfx_depth_state_desc DepthOverwriteStateDescr = {};
+	DepthOverwriteStateDescr.DepthEnable = true;
+	DepthOverwriteStateDescr.DepthWrite = true;
+	DepthOverwriteStateDescr.DepthFunc = GfxComparison_Always;
+	Renderer->DepthOverwriteState = Device->CreateDepthState(Device, &DepthOverwriteStateDescr);
+
+	gfx_blend_state_desc BlendStateDescr = {};
+	BlendStateDescr.BlendEnable = false;
+	Renderer->BlendState = Device->CreateBlendState(Device, &BlendStateDescr);
+
+	gfx_sampler_desc SamplerDescr = {GfxFilter_Linear, GfxAddressMode_Border, GfxComparison_Never};
+	Renderer->SamplerState = Device->CreateSampler(Device, &SamplerDescr);
+	gfx_sampler_desc PointSamplerDescr = {GfxFilter_Point, GfxAddressMode_Border, GfxComparison_Never};
+	Renderer->PointSamplerState = Device->CreateSampler(Device, &PointSamplerDescr);
+	gfx_sampler_desc ShadowMapSamplerDescr = {GfxFilter_Point, GfxAddressMode_Clamp, GfxComparison_Never};
+	Renderer->ShadowMapSamplerState = Device->CreateSampler(Device, &ShadowMapSamplerDescr);
+	gfx_sampler_desc ShadowMomentsSamplerDescr = {GfxFilter_Linear, GfxAddressMode_Clamp, GfxComparison_Never};
+	Renderer->ShadowMomentsSamplerState = Device->CreateSampler(Device, &ShadowMomentsSamplerDescr);
+
+	// NOTE(georgy): Quad model. Indexed triangle list like every other model, so it goes through the same instanced draws
+	mesh QuadMesh = {0, ArrayCount(QuadIndices), 0};
+	Renderer->QuadModel.Meshes.clear();
+	Renderer->QuadModel.Meshes.push_back(QuadMesh);
+	UploadModel(Device, &Renderer->QuadModel, QuadVertices, ArrayCount(QuadVertices), QuadIndices);
+
+	// NOTE(georgy): Create vertex buffer for a full screen quad
+	v3 FullScreenQuadVertices[] =
+	{
+		V3(-1.0f, 1.0f, 0.0f),
+		V3(-1.0f, -1.0f, 0.0f),
+		V3(1.0f, 1.0f, 0.0f),
+		V3(1.0f, -1.0f, 0.0f)
+	};
+	gfx_buffer_desc FullScreenQuadVertexBufferDescr = BufferDesc(sizeof(FullScreenQuadVertices), GfxBufferUsage_Immutable, GfxBufferBind_Vertex, FullScreenQuadVertices);
+	Renderer->FullScreenQuadVertexBuffer = Device->CreateBuffer(Device, &FullScreenQuadVertexBufferDescr);
+
+	// NOTE(georgy): Create input layouts
+	gfx_input_element InputLayoutDescription[] =
+	{
+		{"POSITION", 0, GfxVertexFormat_Float3, 0, 0, false},
+		{"NORMAL", 0, GfxVertexFormat_Float3, 0, 3*sizeof(float), false},
+		{"MODEL", 0, GfxVertexFormat_Float4, 1, 0, true},
+		{"MODEL", 1, GfxVertexFormat_Float4, 1, 4*sizeof(float), true},
+		{"MODEL", 2, GfxVertexFormat_Float4, 1, 8*sizeof(float), true},
+		{"MODEL", 3, GfxVertexFormat_Float4, 1, 12*sizeof(float), true},
+		{"COLOR", 0, GfxVertexFormat_Float3, 1, 16*sizeof(float), true},
+	};
+	Renderer->InputLayout = Device->CreateInputLayout(Device, InputLayoutDescription, ArrayCount(InputLayoutDescription), Renderer->GBufferVS);
+
+	gfx_input_element FullScreenQuadInputLayoutDescription[] =
+	{
+		{"POSITION", 0, GfxVertexFormat_Float3, 0, 0, false},
+	};
+	Renderer->FullScreenQuadInputLayout = Device->CreateInputLayout(Device, FullScreenQuadInputLayoutDescription, ArrayCount(FullScreenQuadInputLayoutDescription), Renderer->FullScreenQuadVS);
+
+	// NOTE(georgy): Constant buffers
+	gfx_buffer_desc FrameConstantsBufferDescr = BufferDesc(sizeof(frame_constants), GfxBufferUsage_Dynamic, GfxBufferBind_Constant);
+	Renderer->FrameConstantsBuffer = Device->CreateBuffer(Device, &FrameConstantsBufferDescr);
+	gfx_buffer_desc RSMSamplesBufferDescr = BufferDesc(sizeof(RSMSamples), GfxBufferUsage_Immutable, GfxBufferBind_Constant, &RSMSamples);
+	Renderer->RSMSamplesBuffer = Device->CreateBuffer(Device, &RSMSamplesBufferDescr);
+	gfx_buffer_desc RSMNoiseBufferDescr = BufferDesc(sizeof(RSMNoise), GfxBufferUsage_Immutable, GfxBufferBind_Constant, &RSMNoise);
+	Renderer->RSMNoiseBuffer = Device->CreateBuffer(Device, &RSMNoiseBufferDescr);
+	for(uint32_t Direction = 0; Direction < 2; Direction++)
+	{
+		depth_aware_blur_constants BlurConstants = DepthAwareBlurConstants((Direction == 0) ? 1 : 0, (Direction == 1) ? 1 : 0, RENDERER_RSM_BLUR_RADIUS);
+		gfx_buffer_desc BlurConstantsBufferDescr = BufferDesc(sizeof(BlurConstants), GfxBufferUsage_Immutable, GfxBufferBind_Constant, &BlurConstants);
+		Renderer->BlurConstantsBuffer[Direction] = Device->CreateBuffer(Device, &BlurConstantsBufferDescr);
+	}
+	for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+	{
+		shadow_cascade_constants CascadeConstants = {Cascade};
+		gfx_buffer_desc CascadeConstantsBufferDescr = BufferDesc(sizeof(CascadeConstants), GfxBufferUsage_Immutable, GfxBufferBind_Constant, &CascadeConstants);
+		Renderer->CascadeConstantsBuffer[Cascade] = Device->CreateBuffer(Device, &CascadeConstantsBufferDescr);
+	}
+
+	InitializeConstantRing(&Renderer->InstanceRing, Device, RENDERER_INSTANCE_RING_SIZE, GfxBufferBind_Vertex);
+	InitializeDrawList(&Renderer->DrawList, Renderer->DrawItems, Renderer->DrawSortBuffer, RENDERER_MAX_DRAWS);
+}
+
+// NOTE(georgy): View space Z of the object's origin
+inline real32
+GetViewDepth(mat4 *View, mat4 *Model)
+{
+	real32 Result = Model->a41*View->a13 + Model->a42*View->a23 + Model->a43*View->a33 + View->a43;
+	return(Result);
+}
+
+//
+// NOTE(georgy): View culling. One walk over the packet's objects tests every object against every view, in parallel
+// over blocks of objects. The first walk counts what each block sees per view, the counts give every block and view
+// its own range of the draw list, and the second walk writes the draws there. Nothing is shared between the blocks.
+//
+
+struct view_cull_job
+{
+	renderer *Renderer;
+	frame_packet *Packet;
+	frustum Frustums[MAX_RENDER_VIEWS];
+
+	// NOTE(georgy): Per block and view: first the visible object count, then where the block's draws for the view go
+	uint32_t BlockDrawOffsets[RENDERER_MAX_CULL_BLOCKS][MAX_RENDER_VIEWS];
+	real32 BlockMinDepth[RENDERER_MAX_CULL_BLOCKS][MAX_RENDER_VIEWS];
+	real32 BlockMaxDepth[RENDERER_MAX_CULL_BLOCKS][MAX_RENDER_VIEWS];
+
+	real32 MinDepth[MAX_RENDER_VIEWS];
+	real32 MaxDepth[MAX_RENDER_VIEWS];
+};
+
+inline void
+GetCullBlockRange(frame_packet *Packet, uint32_t Block, uint32_t *Start, uint32_t *OnePastEnd)
+{
+	*Start = Block*RENDERER_CULL_BLOCK_SIZE;
+	*OnePastEnd = (*Start + RENDERER_CULL_BLOCK_SIZE < Packet->ObjectCount) ? (*Start + RENDERER_CULL_BLOCK_SIZE) : Packet->ObjectCount;
+}
+
+static void
+CullViewBlocks(uint32_t FirstBlock, uint32_t OnePastLastBlock, void *UserData)
+{
+	view_cull_job *Job = (view_cull_job *)UserData;
+	renderer *Renderer = Job->Renderer;
+	for(uint32_t Block = FirstBlock; Block < OnePastLastBlock; Block++)
+	{
+		uint32_t *VisibleCounts = Job->BlockDrawOffsets[Block];
+		real32 *MinDepth = Job->BlockMinDepth[Block];
+		real32 *MaxDepth = Job->BlockMaxDepth[Block];
+		for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+		{
+			VisibleCounts[View] = 0;
+			MinDepth[View] = FLT_MAX;
+			MaxDepth[View] = -FLT_MAX;
+		}
+
+		uint32_t Start, OnePastEnd;
+		GetCullBlockRange(Job->Packet, Block, &Start, &OnePastEnd);
+		for(uint32_t ObjectIndex = Start; ObjectIndex < OnePastEnd; ObjectIndex++)
+		{
+			render_object *Object = Job->Packet->Objects + ObjectIndex;
+
+			uint8_t ViewMask = 0;
+			for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+			{
+				if(IsBoxInFrustum(Job->Frustums + View, Object->BoundsCenter, Object->BoundsExtent))
+				{
+					ViewMask |= (1 << View);
+					VisibleCounts[View]++;
+
+					real32 Depth = GetViewDepth(&Renderer->Views[View].View, &Object->Model);
+					MinDepth[View] = (Depth < MinDepth[View]) ? Depth : MinDepth[View];
+					MaxDepth[View] = (Depth > MaxDepth[View]) ? Depth : MaxDepth[View];
+				}
+			}
+			Renderer->ViewMasks[ObjectIndex] = ViewMask;
+		}
+	}
+}
+
+// NOTE(georgy): A draw per object and view it's visible in, front to back from that view's point of view.
+// Every object uses the same shaders and there are no materials yet, so those key fields are 0.
+// Dynamic objects go after the static ones of the view, the light passes draw them separately.
+static void
+PushViewDrawBlocks(uint32_t FirstBlock, uint32_t OnePastLastBlock, void *UserData)
+{
+	view_cull_job *Job = (view_cull_job *)UserData;
+	renderer *Renderer = Job->Renderer;
+	draw_item *Items = Renderer->DrawList.Items;
+	for(uint32_t Block = FirstBlock; Block < OnePastLastBlock; Block++)
+	{
+		uint32_t *DrawOffsets = Job->BlockDrawOffsets[Block];
+
+		uint32_t Start, OnePastEnd;
+		GetCullBlockRange(Job->Packet, Block, &Start, &OnePastEnd);
+		for(uint32_t ObjectIndex = Start; ObjectIndex < OnePastEnd; ObjectIndex++)
+		{
+			render_object *Object = Job->Packet->Objects + ObjectIndex;
+			uint8_t ViewMask = Renderer->ViewMasks[ObjectIndex];
+			for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+			{
+				if(ViewMask & (1 << View))
+				{
+					real32 Depth = GetViewDepth(&Renderer->Views[View].View, &Object->Model);
+					uint32_t DepthBucket = QuantizeDrawDepth(Depth, Job->MinDepth[View], Job->MaxDepth[View], RENDERER_DEPTH_BUCKET_COUNT);
+
+					draw_item *Draw = Items + DrawOffsets[View]++;
+					uint32_t Layer = Object->Dynamic ? RenderLayer_Dynamic : RenderLayer_Static;
+					Draw->Key = DrawKey(View, Layer, 0, 0, DepthBucket, Object->Mesh);
+					Draw->Index = ObjectIndex;
+				}
+			}
+		}
+	}
+}
+
+// NOTE(georgy): Fills the draw list with the visible draws of every view of the packet, unsorted
+static void
+CullViews(renderer *Renderer, frame_packet *Packet, job_system *JobSystem)
+{
+	Assert(Packet->ObjectCount <= MAX_FRAME_PACKET_OBJECTS);
+
+	Renderer->ViewCount = Packet->ViewCount;
+	view_cull_job Job;
+	Job.Renderer = Renderer;
+	Job.Packet = Packet;
+	for(uint32_t View = 0; View < Packet->ViewCount; View++)
+	{
+		Renderer->Views[View] = Packet->Views[View];
+		Job.Frustums[View] = MakeFrustum(Packet->Views[View].View * Packet->Views[View].Projection);
+	}
+
+	uint32_t BlockCount = (Packet->ObjectCount + RENDERER_CULL_BLOCK_SIZE - 1) / RENDERER_CULL_BLOCK_SIZE;
+	ParallelFor(JobSystem, BlockCount, CullViewBlocks, &Job);
+
+	// NOTE(georgy): View major, block minor, so every view's draws are one range filled by the blocks in order
+	uint32_t DrawCount = 0;
+	for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+	{
+		Renderer->ViewVisibleCounts[View] = 0;
+		Job.MinDepth[View] = FLT_MAX;
+		Job.MaxDepth[View] = -FLT_MAX;
+		for(uint32_t Block = 0; Block < BlockCount; Block++)
+		{
+			uint32_t VisibleCount = Job.BlockDrawOffsets[Block][View];
+			Job.BlockDrawOffsets[Block][View] = DrawCount;
+			DrawCount += VisibleCount;
+			Renderer->ViewVisibleCounts[View] += VisibleCount;
+
+			Job.MinDepth[View] = (Job.BlockMinDepth[Block][View] < Job.MinDepth[View]) ? Job.BlockMinDepth[Block][View] : Job.MinDepth[View];
+			Job.MaxDepth[View] = (Job.BlockMaxDepth[Block][View] > Job.MaxDepth[View]) ? Job.BlockMaxDepth[Block][View] : Job.MaxDepth[View];
+		}
+	}
+
+	draw_list *DrawList = &Renderer->DrawList;
+	ResetDrawList(DrawList);
+	Assert(DrawCount <= DrawList->MaxCount);
+	ParallelFor(JobSystem, BlockCount, PushViewDrawBlocks, &Job);
+	DrawList->Count = DrawCount;
+}
+
+// NOTE(georgy): Decides what every light view does with its tile this frame. The RSM's views use the RSM tile,
+// the cascades' views their cascade's tile in order.
+static void
+UpdateLightViewCaches(renderer *Renderer, frame_packet *Packet)
+{
+	uint32_t Cascade = 0;
+	for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+	{
+		render_view *RenderView = Renderer->Views + View;
+		shadow_cache_view *Cache = Renderer->LightViewCaches + View;
+		if((RenderView->Pass != RenderPass_ShadowMap) && (RenderView->Pass != RenderPass_ShadowCascade))
+		{
+			InvalidateShadowCacheView(Cache);
+			continue;
+		}
+
+		shadow_atlas_rect Tile = (RenderView->Pass == RenderPass_ShadowMap) ? Packet->RSMTile : Packet->ShadowCascades.Cascades[Cascade++].Tile;
+		bool HasDynamic = (Renderer->ViewFirstDynamicBatch[View] < Renderer->ViewFirstBatch[View + 1]);
+		UpdateShadowCacheView(Cache, RenderView->View*RenderView->Projection, Tile, RenderView->StaticCastersMoved, HasDynamic);
+
+		// NOTE(georgy): Nothing gets drawn when the instance data didn't fit, the tile has to be drawn again next frame
+		if(!Renderer->Instances.Memory)
+		{
+			InvalidateShadowCacheView(Cache);
+		}
+	}
+}
+
+// NOTE(georgy): Everything the passes need from the packet goes to the GPU here, once per frame
+static void
+UploadFrameData(renderer *Renderer, graphics_context *Context, frame_packet *Packet)
+{
+	frame_constants *FrameConstants = (frame_constants *)Context->Map(Context, Renderer->FrameConstantsBuffer, GfxMap_WriteDiscard);
+	FrameConstants->CameraProjection = Packet->CameraProjection;
+	FrameConstants->CameraView = Packet->CameraView;
+	FrameConstants->LightProjection = Packet->LightProjection;
+	FrameConstants->LightView = Packet->LightView;
+	for(int I = 0; I < 4; I++)
+	{
+		FrameConstants->WorldVectorsToFarCorners[I] = Packet->FrustumFarCornersWorldSpace[I];
+	}
+	FrameConstants->CameraWorldPos = V4(Packet->CameraWorldPos, 1.0f);
+	FrameConstants->ViewToPrevClip = GetViewToPrevClip(Packet->CameraView, Renderer->PrevViewProjection);
+	real32 RSMFrameRotation = GetRSMFrameRotation(Renderer->FrameIndex);
+	FrameConstants->RSMFrameRotation = V2(cosf(RSMFrameRotation), sinf(RSMFrameRotation));
+	FrameConstants->HistoryValid = (Renderer->FrameIndex > 0) ? 1.0f : 0.0f;
+	FrameConstants->RSMAtlasRect = GetShadowAtlasUVRect(Packet->RSMTile, RENDERER_RSM_ATLAS_SIZE);
+	shadow_cascades *Cascades = &Packet->ShadowCascades;
+	for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+	{
+		FrameConstants->CascadeViewProjections[Cascade] = Cascades->LightView*Cascades->Cascades[Cascade].Projection;
+		FrameConstants->CascadeSplits.E[Cascade] = Cascades->Cascades[Cascade].SplitFar;
+		FrameConstants->CascadeBiases.E[Cascade] = Cascades->Cascades[Cascade].DepthBias;
+		FrameConstants->CascadeAtlasRects[Cascade] = GetShadowAtlasUVRect(Cascades->Cascades[Cascade].Tile, RENDERER_SHADOW_ATLAS_SIZE);
+	}
+	Renderer->PrevViewProjection = Packet->CameraView*Packet->CameraProjection;
+	Context->Unmap(Context, Renderer->FrameConstantsBuffer);
+
+	draw_list *DrawList = &Renderer->DrawList;
+	CullViews(Renderer, Packet, Platform.JobSystem);
+	SortDrawList(DrawList, Platform.JobSystem);
+
+	// NOTE(georgy): Instance data is the same in every view, but it's written per draw so each view gets its own order
+	constant_ring *Ring = &Renderer->InstanceRing;
+	uint64_t CompletedFrameCount = (Ring->FrameIndex > RENDERER_MAX_FRAMES_IN_FLIGHT) ? (Ring->FrameIndex - RENDERER_MAX_FRAMES_IN_FLIGHT) : 0;
+	BeginConstantRingFrame(Ring, Context, CompletedFrameCount);
+	Renderer->Instances = PushConstants(Ring, DrawList->Count*sizeof(instance_data));
+	Renderer->BatchCount = 0;
+	if(Renderer->Instances.Memory)
+	{
+		instance_data *Instances = (instance_data *)Renderer->Instances.Memory;
+		instance_batch *Batch = 0;
+		uint64_t BatchState = 0;
+		for(uint32_t DrawIndex = 0; DrawIndex < DrawList->Count; DrawIndex++)
+		{
+			draw_item *Draw = DrawList->Items + DrawIndex;
+			render_object *Object = Packet->Objects + Draw->Index;
+
+			// NOTE(georgy): Neighbouring draws with the same state merge, even if they are in different depth buckets
+			uint64_t State = Draw->Key & DRAW_KEY_STATE_MASK;
+			if(!Batch || (State != BatchState))
+			{
+				Batch = Renderer->Batches + Renderer->BatchCount++;
+				Batch->View = DrawKeyField(Draw->Key, PASS);
+				Batch->Layer = (render_layer)DrawKeyField(Draw->Key, LAYER);
+				Batch->Mesh = (render_mesh)DrawKeyField(Draw->Key, MESH);
+				Batch->FirstInstance = DrawIndex;
+				Batch->InstanceCount = 0;
+				BatchState = State;
+			}
+			Batch->InstanceCount++;
+
+			instance_data *Instance = Instances + DrawIndex;
+			Instance->Model = Object->Model;
+			Instance->Color = Object->Color;
+		}
+	}
+	EndConstantRingFrame(Ring, Context);
+
+	// NOTE(georgy): Batches are sorted by view and then layer, so each view is a range of them and so are its layers
+	uint32_t BatchIndex = 0;
+	for(uint32_t View = 0; View <= MAX_RENDER_VIEWS; View++)
+	{
+		while((BatchIndex < Renderer->BatchCount) && (Renderer->Batches[BatchIndex].View < View))
+		{
+			BatchIndex++;
+		}
+		Renderer->ViewFirstBatch[View] = BatchIndex;
+		if(View < MAX_RENDER_VIEWS)
+		{
+			uint32_t DynamicIndex = BatchIndex;
+			while((DynamicIndex < Renderer->BatchCount) && (Renderer->Batches[DynamicIndex].View == View) &&
+				  (Renderer->Batches[DynamicIndex].Layer == RenderLayer_Static))
+			{
+				DynamicIndex++;
+			}
+			Renderer->ViewFirstDynamicBatch[View] = DynamicIndex;
+		}
+	}
+	UpdateLightViewCaches(Renderer, Packet);
+}
+
+// NOTE(georgy): One DrawIndexedInstanced per part of the mesh of every batch in the range. Instances are fetched from
+// the frame's instance data starting at the batch's first instance.
+static void
+DrawInstanceBatchRange(renderer *Renderer, graphics_context *Context, uint32_t FirstBatch, uint32_t OnePastLastBatch)
+{
+	Context->IASetPrimitiveTopology(Context, GfxTopology_TriangleList);
+
+	uint32_t Strides[2] = {sizeof(vertex), sizeof(instance_data)};
+	uint32_t Offsets[2] = {0, Renderer->Instances.Offset};
+	for(uint32_t BatchIndex = FirstBatch; BatchIndex < OnePastLastBatch; BatchIndex++)
+	{
+		instance_batch *Batch = Renderer->Batches + BatchIndex;
+		model *Model = GetRenderMeshModel(Renderer, Batch->Mesh);
+
+		gfx_buffer *VertexBuffers[2] = {Model->VertexBuffer, Renderer->InstanceRing.Buffer};
+		Context->IASetVertexBuffers(Context, 0, 2, VertexBuffers, Strides, Offsets);
+		for(uint32_t MeshIndex = 0; MeshIndex < Model->Meshes.size(); MeshIndex++)
+		{
+			mesh *Mesh = &Model->Meshes[MeshIndex];
+
+			Context->IASetIndexBuffer(Context, Mesh->IndexBuffer, GfxIndexFormat_U32, 0);
+			Context->DrawIndexedInstanced(Context, Mesh->IndexCount, Batch->InstanceCount, 0, 0, Batch->FirstInstance);
+		}
+	}
+}
+
+inline void
+DrawInstanceBatches(renderer *Renderer, graphics_context *Context, uint32_t View)
+{
+	DrawInstanceBatchRange(Renderer, Context, Renderer->ViewFirstBatch[View], Renderer->ViewFirstBatch[View + 1]);
+}
+
+inline void
+DrawInstanceLayer(renderer *Renderer, graphics_context *Context, uint32_t View, render_layer Layer)
+{
+	if(Layer == RenderLayer_Static)
+	{
+		DrawInstanceBatchRange(Renderer, Context, Renderer->ViewFirstBatch[View], Renderer->ViewFirstDynamicBatch[View]);
+	}
+	else
+	{
+		DrawInstanceBatchRange(Renderer, Context, Renderer->ViewFirstDynamicBatch[View], Renderer->ViewFirstBatch[View + 1]);
+	}
+}
+
+// NOTE(georgy): Every view of the pass draws into whatever the pass has bound
+static void
+DrawPassViews(renderer *Renderer, graphics_context *Context, render_pass Pass)
+{
+	for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+	{
+		if(Renderer->Views[View].Pass == Pass)
+		{
+			DrawInstanceBatches(Renderer, Context, View);
+		}
+	}
+}
+
+//
+// NOTE(georgy): Cached light views (shadow_cache.hpp)
+//
+
+// NOTE(georgy): A quad over the viewport, the pixel shader writes the depth and whatever targets are bound
+static void
+DrawShadowCacheQuad(renderer *Renderer, graphics_context *Context, gfx_pixel_shader *PixelShader)
+{
+	Context->IASetInputLayout(Context, Renderer->FullScreenQuadInputLayout);
+	Context->VSSetShader(Context, Renderer->FullScreenQuadVS);
+	Context->PSSetShader(Context, PixelShader);
+	Context->OMSetDepthStencilState(Context, Renderer->DepthOverwriteState, 0);
+
+	uint32_t Stride = sizeof(v3), Offset = 0;
+	Context->IASetVertexBuffers(Context, 0, 1, &Renderer->FullScreenQuadVertexBuffer, &Stride, &Offset);
+	Context->IASetPrimitiveTopology(Context, GfxTopology_TriangleStrip);
+
+	Context->Draw(Context, 4, 0);
+}
+
+// NOTE(georgy): One light view into its tile of Maps, the depth map first and then the color targets.
+// VertexShader and PixelShader draw the casters, the caller sets up their constants.
+static void
+DrawCachedLightView(renderer *Renderer, graphics_context *Context, uint32_t View, renderer_light_map *Maps, uint32_t MapCount,
+					gfx_vertex_shader *VertexShader, gfx_pixel_shader *PixelShader)
+{
+	Assert((MapCount > 0) && (MapCount <= RendererLightMap_Count));
+
+	shadow_cache_view *Cache = Renderer->LightViewCaches + View;
+	if(Cache->Action == ShadowCache_Reuse)
+	{
+		return;
+	}
+
+	gfx_texture *Targets[RendererLightMap_Count];
+	gfx_texture *StaticTargets[RendererLightMap_Count];
+	for(uint32_t Map = 0; Map < MapCount; Map++)
+	{
+		Targets[Map] = Renderer->LightMaps[Maps[Map]];
+		StaticTargets[Map] = Renderer->StaticLightMaps[Maps[Map]];
+	}
+
+	gfx_viewport TileViewPort = {(real32)Cache->Tile.X, (real32)Cache->Tile.Y, (real32)Cache->Tile.Size, (real32)Cache->Tile.Size, 0.0f, 1.0f};
+	Context->RSSetViewports(Context, 1, &TileViewPort);
+
+	if(Cache->Action == ShadowCache_Rebuild)
+	{
+		Context->OMSetRenderTargets(Context, MapCount - 1, StaticTargets + 1, StaticTargets[0]);
+		DrawShadowCacheQuad(Renderer, Context, Renderer->ShadowCacheClearPS);
+
+		Context->IASetInputLayout(Context, Renderer->InputLayout);
+		Context->VSSetShader(Context, VertexShader);
+		Context->PSSetShader(Context, PixelShader);
+		Context->OMSetDepthStencilState(Context, Renderer->DepthStencilState, 0);
+		DrawInstanceLayer(Renderer, Context, View, RenderLayer_Static);
+	}
+
+	gfx_texture *NullTextures[RendererLightMap_Count] = {};
+	Context->OMSetRenderTargets(Context, MapCount - 1, Targets + 1, Targets[0]);
+	Context->PSSetShaderResources(Context, 0, MapCount, StaticTargets);
+	DrawShadowCacheQuad(Renderer, Context, Renderer->ShadowCacheCopyPS);
+	Context->PSSetShaderResources(Context, 0, MapCount, NullTextures);
+
+	Context->IASetInputLayout(Context, Renderer->InputLayout);
+	Context->VSSetShader(Context, VertexShader);
+	Context->PSSetShader(Context, PixelShader);
+	Context->OMSetDepthStencilState(Context, Renderer->DepthStencilState, 0);
+	DrawInstanceLayer(Renderer, Context, View, RenderLayer_Dynamic);
+}
+
+// NOTE(georgy): Every active pass is measured with its own query. The query of this frame's slot was last used
+// RENDERER_QUERY_LATENCY or more frames ago (the pass can skip frames), its results are picked up right before
+// it's used again and go with the frame it was issued in.
+inline bool
+BeginRendererPass(renderer *Renderer, graphics_context *Context, uint32_t Pass)
+{
+	bool Result = IsFrameGraphPassActive(&Renderer->FrameGraph, Pass);
+	if(Result)
+	{
+		uint32_t Slot = Renderer->FrameIndex % RENDERER_QUERY_LATENCY;
+		gfx_query *Query = Renderer->PassQueries[Pass][Slot];
+		uint64_t IssuedFrame = Renderer->PassQueryFrames[Pass][Slot];
+		if((IssuedFrame != RENDERER_NO_QUERY_FRAME) && Context->GetData(Context, Query, Renderer->PassStatistics + Pass))
+		{
+			Renderer->PassStatisticsFrames[Pass] = IssuedFrame;
+		}
+		Context->Begin(Context, Query);
+		Renderer->PassQueryFrames[Pass][Slot] = Renderer->FrameIndex;
+	}
+	return(Result);
+}
+
+inline void
+EndRendererPass(renderer *Renderer, graphics_context *Context, uint32_t Pass)
+{
+	Context->End(Context, Renderer->PassQueries[Pass][Renderer->FrameIndex % RENDERER_QUERY_LATENCY]);
+}
+
+// NOTE(georgy): Passes that need the frame packet. After this returns the packet can be given back to the game thread.
+static void
+RenderScenePasses(renderer *Renderer, graphics_context *Context, frame_packet *Packet)
+{
+	UploadFrameData(Renderer, Context, Packet);
+
+	gfx_viewport ViewPort = {0.0f, 0.0f, (real32)Renderer->Width, (real32)Renderer->Height, 0.0f, 1.0f};
+	Context->RSSetViewports(Context, 1, &ViewPort);
+
+	// NOTE(georgy): Render to shadow map, only the parts of the light views that changed
+	if(BeginRendererPass(Renderer, Context, Renderer->Graph.ShadowMapPass))
+	{
+		Context->RSSetState(Context, Renderer->RasterizerState);
+		Context->OMSetBlendState(Context, Renderer->BlendState, 0, 0xFFFFFFFF);
+
+		Context->VSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+
+		renderer_light_map RSMMaps[] = {RendererLightMap_ShadowMap, RendererLightMap_RSMWorldPos, RendererLightMap_RSMNormals, RendererLightMap_Flux};
+		for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+		{
+			if(Renderer->Views[View].Pass == RenderPass_ShadowMap)
+			{
+				DrawCachedLightView(Renderer, Context, View, RSMMaps, ArrayCount(RSMMaps), Renderer->ShadowMapVS, Renderer->ShadowMapPS);
+			}
+		}
+		Context->RSSetViewports(Context, 1, &ViewPort);
+
+		EndRendererPass(Renderer, Context, Renderer->Graph.ShadowMapPass);
+	}
+
+
+	// NOTE(georgy): Render the shadow cascades, each into its tile of the atlas
+	if(BeginRendererPass(Renderer, Context, Renderer->Graph.ShadowCascadesPass))
+	{
+		Context->RSSetState(Context, Renderer->RasterizerState);
+		Context->OMSetBlendState(Context, Renderer->BlendState, 0, 0xFFFFFFFF);
+
+		Context->VSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+
+		renderer_light_map CascadeMaps[] = {RendererLightMap_ShadowAtlas};
+		uint32_t Cascade = 0;
+		for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+		{
+			if(Renderer->Views[View].Pass == RenderPass_ShadowCascade)
+			{
+				Assert(Cascade < SHADOW_CASCADE_COUNT);
+				Context->VSSetConstantBuffers(Context, 2, 1, &Renderer->CascadeConstantsBuffer[Cascade]);
+
+				DrawCachedLightView(Renderer, Context, View, CascadeMaps, ArrayCount(CascadeMaps), Renderer->ShadowCascadeVS, 0);
+				Cascade++;
+			}
+		}
+		Context->RSSetViewports(Context, 1, &ViewPort);
+
+		EndRendererPass(Renderer, Context, Renderer->Graph.ShadowCascadesPass);
+	}
+
+
+	// NOTE(georgy): Moments of the cascades that were drawn this frame, the others are still what they were
+	if(Renderer->Settings.ShadowMoments && BeginRendererPass(Renderer, Context, Renderer->Graph.ShadowMomentsPass))
+	{
+		Context->IASetInputLayout(Context, Renderer->FullScreenQuadInputLayout);
+		Context->VSSetShader(Context, Renderer->FullScreenQuadVS);
+		Context->OMSetDepthStencilState(Context, Renderer->DepthAlwaysState, 0);
+
+		Context->PSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+
+		uint32_t Stride = sizeof(v3), Offset = 0;
+		Context->IASetVertexBuffers(Context, 0, 1, &Renderer->FullScreenQuadVertexBuffer, &Stride, &Offset);
+		Context->IASetPrimitiveTopology(Context, GfxTopology_TriangleStrip);
+
+		gfx_texture *NullTextures[] = {0, 0};
+		uint32_t FilteredCount = 0;
+		uint32_t Cascade = 0;
+		for(uint32_t View = 0; View < Renderer->ViewCount; View++)
+		{
+			if(Renderer->Views[View].Pass == RenderPass_ShadowCascade)
+			{
+				shadow_cache_view *Cache = Renderer->LightViewCaches + View;
+				if(Cache->Action != ShadowCache_Reuse)
+				{
+					Context->PSSetConstantBuffers(Context, 2, 1, &Renderer->CascadeConstantsBuffer[Cascade]);
+
+					gfx_viewport BlurViewPort = {0.0f, 0.0f, (real32)Cache->Tile.Size, (real32)Cache->Tile.Size, 0.0f, 1.0f};
+					gfx_texture *HorizontalTextures[] = {Renderer->ShadowAtlas, 0};
+					Context->RSSetViewports(Context, 1, &BlurViewPort);
+					Context->OMSetRenderTargets(Context, 1, &Renderer->ShadowMomentsBlur, 0);
+					Context->PSSetShaderResources(Context, 0, ArrayCount(HorizontalTextures), HorizontalTextures);
+					Context->PSSetShader(Context, Renderer->ShadowMomentsHorizontalPS);
+					Context->Draw(Context, 4, 0);
+
+					gfx_viewport TileViewPort = {(real32)Cache->Tile.X, (real32)Cache->Tile.Y, (real32)Cache->Tile.Size, (real32)Cache->Tile.Size, 0.0f, 1.0f};
+					Context->RSSetViewports(Context, 1, &TileViewPort);
+					Context->PSSetShaderResources(Context, 0, ArrayCount(NullTextures), NullTextures);
+					Context->OMSetRenderTargets(Context, 1, &Renderer->ShadowMoments, 0);
+					Context->PSSetShaderResources(Context, 0, 1, &Renderer->ShadowMomentsBlur);
+					Context->PSSetShader(Context, Renderer->ShadowMomentsVerticalPS);
+					Context->Draw(Context, 4, 0);
+
+					Context->PSSetShaderResources(Context, 0, ArrayCount(NullTextures), NullTextures);
+					FilteredCount++;
+				}
+				Cascade++;
+			}
+		}
+
+		if(FilteredCount)
+		{
+			Context->OMSetRenderTargets(Context, 0, 0, 0);
+			Context->GenerateMips(Context, Renderer->ShadowMoments);
+		}
+		Context->RSSetViewports(Context, 1, &ViewPort);
+		Context->IASetInputLayout(Context, Renderer->InputLayout);
+
+		EndRendererPass(Renderer, Context, Renderer->Graph.ShadowMomentsPass);
+	}
+
+
+	// NOTE(georgy): Depth only, same views and draws as the G-buffer pass
+	if(Renderer->Settings.DepthPrepass && BeginRendererPass(Renderer, Context, Renderer->Graph.DepthPrepass))
+	{
+		Context->OMSetRenderTargets(Context, 0, 0, Renderer->Depth);
+		Context->ClearDepthStencilView(Context, Renderer->Depth, GfxClear_Depth|GfxClear_Stencil, 1.0f, 0);
+
+		// NOTE(georgy): Cached light views leave the state of the last frame's post passes bound
+		Context->IASetInputLayout(Context, Renderer->InputLayout);
+		Context->OMSetDepthStencilState(Context, Renderer->DepthStencilState, 0);
+
+		Context->VSSetShader(Context, Renderer->GBufferVS);
+		Context->PSSetShader(Context, 0);
+
+		Context->VSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+
+		DrawPassViews(Renderer, Context, RenderPass_GBuffer);
+
+		EndRendererPass(Renderer, Context, Renderer->Graph.DepthPrepass);
+	}
+
+
+	// NOTE(georgy): Render to GBuffer
+	if(BeginRendererPass(Renderer, Context, Renderer->Graph.GBufferPass))
+	{
+		gfx_texture *GBuffer[] = {Renderer->Normals, Renderer->Color, Renderer->LinearDepth};
+		Context->OMSetRenderTargets(Context, ArrayCount(GBuffer), GBuffer, Renderer->Depth);
+		Context->ClearRenderTargetView(Context, Renderer->Normals, ClearColorBlack);
+		Context->ClearRenderTargetView(Context, Renderer->Color, ClearColorBlack);
+		Context->ClearRenderTargetView(Context, Renderer->LinearDepth, ClearColorWhite);
+		if(Renderer->Settings.DepthPrepass)
+		{
+			Context->OMSetDepthStencilState(Context, Renderer->DepthEqualState, 0);
+		}
+		else
+		{
+			Context->ClearDepthStencilView(Context, Renderer->Depth, GfxClear_Depth|GfxClear_Stencil, 1.0f, 0);
+			Context->OMSetDepthStencilState(Context, Renderer->DepthStencilState, 0);
+		}
+
+		Context->IASetInputLayout(Context, Renderer->InputLayout);
+		Context->VSSetShader(Context, Renderer->GBufferVS);
+		Context->PSSetShader(Context, Renderer->GBufferPS);
+
+		if(Renderer->Settings.ShadowMoments)
+		{
+			Context->PSSetShaderResources(Context, 1, 1, &Renderer->ShadowMoments);
+			Context->PSSetSamplers(Context, 2, 1, &Renderer->ShadowMomentsSamplerState);
+		}
+		else
+		{
+			Context->PSSetShaderResources(Context, 0, 1, &Renderer->ShadowAtlas);
+			Context->PSSetSamplers(Context, 1, 1, &Renderer->ShadowMapSamplerState);
+		}
+
+		Context->VSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+		Context->PSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+
+		DrawPassViews(Renderer, Context, RenderPass_GBuffer);
+
+		EndRendererPass(Renderer, Context, Renderer->Graph.GBufferPass);
+	}
+}
+
+// NOTE(georgy): Full screen passes and present, they only need what the scene passes left in the render targets
+static void
+RenderPostPasses(renderer *Renderer, graphics_context *Context)
+{
+	uint32_t Stride, Offset;
+
+	gfx_texture *NullTextures[] = {0, 0, 0, 0, 0};
+	Context->PSSetShaderResources(Context, 0, 4, NullTextures);
+
+	gfx_viewport ViewPort = {0.0f, 0.0f, (real32)Renderer->Width, (real32)Renderer->Height, 0.0f, 1.0f};
+	gfx_viewport LowViewPort = {0.0f, 0.0f, (real32)((Renderer->Width + RENDERER_RSM_DOWNSAMPLE - 1) / RENDERER_RSM_DOWNSAMPLE),
+								(real32)((Renderer->Height + RENDERER_RSM_DOWNSAMPLE - 1) / RENDERER_RSM_DOWNSAMPLE), 0.0f, 1.0f};
+
+
+	// NOTE(georgy): Gather RSM indirect illumination at low resolution
+	if(BeginRendererPass(Renderer, Context, Renderer->Graph.RSMPass))
+	{
+		Context->RSSetViewports(Context, 1, &LowViewPort);
+		Context->OMSetRenderTargets(Context, 1, &Renderer->RSMIndirectIllum, 0);
+		Context->ClearRenderTargetView(Context, Renderer->RSMIndirectIllum, ClearColorBlack);
+
+		Context->IASetInputLayout(Context, Renderer->FullScreenQuadInputLayout);
+		Context->VSSetShader(Context, Renderer->FullScreenQuadVS);
+		Context->PSSetShader(Context, Renderer->RSMPS);
+
+		Context->PSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+		Context->PSSetConstantBuffers(Context, 3, 1, &Renderer->RSMSamplesBuffer);
+		Context->PSSetConstantBuffers(Context, 4, 1, &Renderer->RSMNoiseBuffer);
+
+		Context->OMSetDepthStencilState(Context, Renderer->DepthAlwaysState, 0);
+
+		Stride = sizeof(v3); Offset = 0;
+		Context->IASetVertexBuffers(Context, 0, 1, &Renderer->FullScreenQuadVertexBuffer, &Stride, &Offset);
+		Context->IASetPrimitiveTopology(Context, GfxTopology_TriangleStrip);
+
+		Context->PSSetShaderResources(Context, 0, 1, &Renderer->Normals);
+		Context->PSSetShaderResources(Context, 1, 1, &Renderer->LinearDepth);
+		Context->PSSetShaderResources(Context, 2, 1, &Renderer->RSMWorldPos);
+		Context->PSSetShaderResources(Context, 3, 1, &Renderer->RSMNormals);
+		Context->PSSetShaderResources(Context, 4, 1, &Renderer->Flux);
+		Context->PSSetSamplers(Context, 0, 1, &Renderer->SamplerState);
+
+		Context->Draw(Context, 4, 0);
+
+		Context->PSSetShaderResources(Context, 0, 5, NullTextures);
+
+		EndRendererPass(Renderer, Context, Renderer->Graph.RSMPass);
+	}
+
+
+	// NOTE(georgy): Accumulate RSM indirect illumination over frames
+	gfx_texture *RSMHistory = Renderer->RSMHistory[(Renderer->FrameIndex + 1) & 1];
+	gfx_texture *RSMAccumulated = Renderer->RSMHistory[Renderer->FrameIndex & 1];
+	if(BeginRendererPass(Renderer, Context, Renderer->Graph.TemporalPass))
+	{
+		Context->RSSetViewports(Context, 1, &LowViewPort);
+		Context->OMSetRenderTargets(Context, 1, &RSMAccumulated, 0);
+
+		Context->IASetInputLayout(Context, Renderer->FullScreenQuadInputLayout);
+		Context->VSSetShader(Context, Renderer->FullScreenQuadVS);
+		Context->PSSetShader(Context, Renderer->TemporalPS);
+
+		Context->PSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+
+		Context->OMSetDepthStencilState(Context, Renderer->DepthAlwaysState, 0);
+
+		Stride = sizeof(v3); Offset = 0;
+		Context->IASetVertexBuffers(Context, 0, 1, &Renderer->FullScreenQuadVertexBuffer, &Stride, &Offset);
+		Context->IASetPrimitiveTopology(Context, GfxTopology_TriangleStrip);
+
+		Context->PSSetShaderResources(Context, 0, 1, &Renderer->RSMIndirectIllum);
+		Context->PSSetShaderResources(Context, 1, 1, &RSMHistory);
+		Context->PSSetShaderResources(Context, 2, 1, &Renderer->LinearDepth);
+
+		Context->Draw(Context, 4, 0);
+
+		Context->PSSetShaderResources(Context, 0, 3, NullTextures);
+
+		EndRendererPass(Renderer, Context, Renderer->Graph.TemporalPass);
+	}
+
+
+	// NOTE(georgy): Depth aware blur of the accumulated RSM indirect illumination, horizontally then vertically
+	gfx_texture *BlurSources[2] = {RSMAccumulated, Renderer->RSMBlurHorizontal};
+	gfx_texture *BlurTargets[2] = {Renderer->RSMBlurHorizontal, Renderer->RSMIndirectIllumAfterBlur};
+	uint32_t BlurPasses[2] = {Renderer->Graph.BlurHorizontalPass, Renderer->Graph.BlurVerticalPass};
+	for(uint32_t Direction = 0; Direction < 2; Direction++)
+	{
+		if(BeginRendererPass(Renderer, Context, BlurPasses[Direction]))
+		{
+			Context->RSSetViewports(Context, 1, &LowViewPort);
+			Context->OMSetRenderTargets(Context, 1, &BlurTargets[Direction], 0);
+
+			Context->IASetInputLayout(Context, Renderer->FullScreenQuadInputLayout);
+			Context->VSSetShader(Context, Renderer->FullScreenQuadVS);
+			Context->PSSetShader(Context, Renderer->BlurPS);
+
+			Context->PSSetConstantBuffers(Context, 1, 1, &Renderer->BlurConstantsBuffer[Direction]);
+
+			Context->OMSetDepthStencilState(Context, Renderer->DepthAlwaysState, 0);
+
+			Stride = sizeof(v3); Offset = 0;
+			Context->IASetVertexBuffers(Context, 0, 1, &Renderer->FullScreenQuadVertexBuffer, &Stride, &Offset);
+			Context->IASetPrimitiveTopology(Context, GfxTopology_TriangleStrip);
+
+			Context->PSSetShaderResources(Context, 0, 1, &BlurSources[Direction]);
+			Context->PSSetShaderResources(Context, 1, 1, &Renderer->Normals);
+			Context->PSSetShaderResources(Context, 2, 1, &Renderer->LinearDepth);
+
+			Context->Draw(Context, 4, 0);
+
+			Context->PSSetShaderResources(Context, 0, 3, NullTextures);
+
+			EndRendererPass(Renderer, Context, BlurPasses[Direction]);
+		}
+	}
+
+
+	// NOTE(georgy): Render to backbuffer
+	if(BeginRendererPass(Renderer, Context, Renderer->Graph.DeferredPass))
+	{
+		Context->RSSetViewports(Context, 1, &ViewPort);
+		Context->OMSetRenderTargets(Context, 1, &Renderer->BackBuffer, 0);
+		Context->ClearRenderTargetView(Context, Renderer->BackBuffer, ClearColorBlack);
+
+		Context->IASetInputLayout(Context, Renderer->FullScreenQuadInputLayout);
+		Context->VSSetShader(Context, Renderer->DeferredVS);
+		Context->PSSetShader(Context, Renderer->DeferredPS);
+
+		Context->VSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+		Context->PSSetConstantBuffers(Context, 0, 1, &Renderer->FrameConstantsBuffer);
+
+		Context->OMSetDepthStencilState(Context, Renderer->DepthAlwaysState, 0);
+
+		Stride = sizeof(v3); Offset = 0;
+		Context->IASetVertexBuffers(Context, 0, 1, &Renderer->FullScreenQuadVertexBuffer, &Stride, &Offset);
+		Context->IASetPrimitiveTopology(Context, GfxTopology_TriangleStrip);
+
+		Context->PSSetShaderResources(Context, 0, 1, &Renderer->Normals);
+		Context->PSSetShaderResources(Context, 1, 1, &Renderer->RSMIndirectIllumAfterBlur);
+		Context->PSSetShaderResources(Context, 2, 1, &Renderer->Color);
+		Context->PSSetShaderResources(Context, 3, 1, &Renderer->LinearDepth);
+		Context->PSSetSamplers(Context, 0, 1, &Renderer->PointSamplerState);
+
+		Context->Draw(Context, 4, 0);
+
+		Context->PSSetShaderResources(Context, 0, 4, NullTextures);
+
+		EndRendererPass(Renderer, Context, Renderer->Graph.DeferredPass);
+	}
+
+	Context->Present(Context);
+	Renderer->FrameIndex++;
+}
+
+// NOTE(georgy): Render thread body. Renders every packet it gets until it pops a Quit packet.
+static void
+RunRenderer(renderer *Renderer, graphics_context *Context, frame_packet_queue *Queue)
+{
+	for(;;)
+	{
+		frame_packet *Packet;
+		while(!(Packet = BeginPop(Queue)))
+		{
+			std::this_thread::yield();
+		}
+
+		if(Packet->Quit)
+		{
+			EndPop(Queue);
+			break;
+		}
+
+		alloc_scope FrameScope(AllocTag_Frame, 0, 0);
+
+		RenderScenePasses(Renderer, Context, Packet);
+
+		// NOTE(georgy): The packet isn't needed anymore, let the game thread start filling the next one
+		EndPop(Queue);
+
+		RenderPostPasses(Renderer, Context);
+	}
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "shadow_cascades.hpp"
+#include "shadow_moments.hpp"
+
+//
+// NOTE(georgy): Passes and textures of our renderer, declared once so the D3D11 build
+// and the null-backend bench compile exactly the same graph.
+//
+
+// NOTE(georgy): RSM indirect illumination is gathered and blurred at 1/RENDERER_RSM_DOWNSAMPLE of the resolution,
+// and upsampled in the deferred pass. Has to match RSM_DOWNSAMPLE in RSMPS.hlsl and DeferredPS.hlsl.
+#define RENDERER_RSM_DOWNSAMPLE 2
+
+// NOTE(georgy): Lights get tiles of these (shadow_atlas.hpp), whatever the size of the window.
+// The shadow atlas has the shadow cascades, the RSM atlas the reflective shadow maps.
+#define RENDERER_SHADOW_ATLAS_SIZE 2048
+#define RENDERER_RSM_ATLAS_SIZE 1024
+
+// NOTE(georgy): Textures the light passes render into. They outlive the frame, a light view that didn't change
+// keeps last frame's tile (shadow_cache.hpp), so the renderer creates them and the graph imports them.
+// Nothing else has their sizes and formats, so as transients they wouldn't alias either. The caches cost their static
+// layers (as much memory again, outside of the graph), aliasing saves the same as before.
+enum renderer_light_map
+{
+	RendererLightMap_ShadowMap,
+	RendererLightMap_RSMWorldPos,
+	RendererLightMap_RSMNormals,
+	RendererLightMap_Flux,
+	RendererLightMap_ShadowAtlas,
+
+	RendererLightMap_Count
+};
+
+global_variable const char *RendererLightMapNames[RendererLightMap_Count] = {"ShadowMap", "RSMWorldPos", "RSMNormals", "Flux", "ShadowAtlas"};
+global_variable const char *RendererStaticLightMapNames[RendererLightMap_Count] = {"StaticShadowMap", "StaticRSMWorldPos", "StaticRSMNormals", "StaticFlux", "StaticShadowAtlas"};
+
+inline texture_desc
+GetRendererLightMapDesc(renderer_light_map Map)
+{
+	uint32_t ColorBind = TextureBind_RenderTarget | TextureBind_ShaderResource;
+	uint32_t DepthBind = TextureBind_DepthStencil | TextureBind_ShaderResource;
+
+	texture_desc Result = {};
+	switch(Map)
+	{
+		case RendererLightMap_ShadowMap: Result = TextureDesc(RENDERER_RSM_ATLAS_SIZE, RENDERER_RSM_ATLAS_SIZE, TextureFormat_Depth32, DepthBind); break;
+		case RendererLightMap_RSMWorldPos:
+		case RendererLightMap_RSMNormals:
+		case RendererLightMap_Flux: Result = TextureDesc(RENDERER_RSM_ATLAS_SIZE, RENDERER_RSM_ATLAS_SIZE, TextureFormat_RGBA16F, ColorBind); break;
+		case RendererLightMap_ShadowAtlas: Result = TextureDesc(RENDERER_SHADOW_ATLAS_SIZE, RENDERER_SHADOW_ATLAS_SIZE, TextureFormat_Depth32, DepthBind); break;
+		default: Assert(!"Unknown light map");
+	}
+	return(Result);
+}
+
+// NOTE(georgy): Filtered moments of the shadow atlas, they're only filtered again where a cascade changed
+inline texture_desc
+GetRendererShadowMomentsDesc(void)
+{
+	texture_desc Result = TextureDesc(RENDERER_SHADOW_ATLAS_SIZE, RENDERER_SHADOW_ATLAS_SIZE, TextureFormat_RGBA32F,
+									  TextureBind_RenderTarget | TextureBind_ShaderResource, SHADOW_MOMENTS_MIP_COUNT);
+	return(Result);
+}
+
+struct renderer_frame_graph
+{
+	uint32_t ShadowMapPass;
+	uint32_t ShadowCascadesPass;
+	uint32_t ShadowMomentsPass;
+	uint32_t DepthPrepass;
+	uint32_t GBufferPass;
+	uint32_t RSMPass;
+	uint32_t TemporalPass;
+	uint32_t BlurHorizontalPass;
+	uint32_t BlurVerticalPass;
+	uint32_t DeferredPass;
+
+	uint32_t ShadowMap;
+	uint32_t RSMWorldPos;
+	uint32_t RSMNormals;
+	uint32_t Flux;
+	uint32_t ShadowAtlas;
+	uint32_t ShadowMomentsBlur;
+	uint32_t ShadowMoments;
+
+	uint32_t Normals;
+	uint32_t RSMIndirectIllum;
+	uint32_t Color;
+	uint32_t LinearDepth;
+	uint32_t Depth;
+
+	uint32_t RSMHistory;
+	uint32_t RSMAccumulated;
+	uint32_t RSMBlurHorizontal;
+	uint32_t RSMIndirectIllumAfterBlur;
+
+	uint32_t BackBuffer;
+};
+
+// NOTE(georgy): RSMHistory are the two textures temporal accumulation ping-pongs between, they outlive the frame.
+// The graph only needs them for the dependencies, the renderer picks which one is read and which one written every frame.
+// LightMaps are the renderer's textures of every renderer_light_map.
+// ShadowMoments is the renderer's moments atlas, 0 without the moments filter (then ShadowMomentsPass is an invalid pass).
+// With DepthPrepass the depth buffer is filled by its own pass before the G-buffer one, otherwise DepthPrepass is an invalid pass.
+static void
+DeclareRendererFrameGraph(frame_graph *Graph, renderer_frame_graph *Renderer, uint32_t Width, uint32_t Height, void *BackBuffer, void **RSMHistory,
+						  void **LightMaps, void *ShadowMoments, bool DepthPrepass)
+{
+	uint32_t ColorBind = TextureBind_RenderTarget | TextureBind_ShaderResource;
+
+	Renderer->BackBuffer = ImportFrameGraphTexture(Graph, "BackBuffer", TextureDesc(Width, Height, TextureFormat_RGBA8, TextureBind_RenderTarget), BackBuffer);
+
+	Renderer->ShadowMapPass = AddFrameGraphPass(Graph, "ShadowMap");
+	uint32_t *LightMapResources[RendererLightMap_Count] = {&Renderer->ShadowMap, &Renderer->RSMWorldPos, &Renderer->RSMNormals, &Renderer->Flux, &Renderer->ShadowAtlas};
+	for(uint32_t Map = 0; Map < RendererLightMap_Count; Map++)
+	{
+		*LightMapResources[Map] = ImportFrameGraphTexture(Graph, RendererLightMapNames[Map], GetRendererLightMapDesc((renderer_light_map)Map), LightMaps[Map]);
+	}
+	FrameGraphWrite(Graph, Renderer->ShadowMapPass, Renderer->ShadowMap);
+	FrameGraphWrite(Graph, Renderer->ShadowMapPass, Renderer->RSMWorldPos);
+	FrameGraphWrite(Graph, Renderer->ShadowMapPass, Renderer->RSMNormals);
+	FrameGraphWrite(Graph, Renderer->ShadowMapPass, Renderer->Flux);
+
+	// NOTE(georgy): Sun shadows. The shadow map above is only the RSM's depth now, the G-buffer pass reads the cascades.
+	Renderer->ShadowCascadesPass = AddFrameGraphPass(Graph, "ShadowCascades");
+	FrameGraphWrite(Graph, Renderer->ShadowCascadesPass, Renderer->ShadowAtlas);
+
+	// NOTE(georgy): The cascades that changed into moments, blurred. The blur's horizontal pass goes to the corner of
+	// ShadowMomentsBlur, big enough for the biggest cascade.
+	Renderer->ShadowMomentsPass = FRAME_GRAPH_INVALID_INDEX;
+	Renderer->ShadowMomentsBlur = FRAME_GRAPH_INVALID_INDEX;
+	Renderer->ShadowMoments = FRAME_GRAPH_INVALID_INDEX;
+	if(ShadowMoments)
+	{
+		Renderer->ShadowMomentsPass = AddFrameGraphPass(Graph, "ShadowMoments");
+		Renderer->ShadowMomentsBlur = CreateFrameGraphTexture(Graph, "ShadowMomentsBlur", TextureDesc(SHADOW_CASCADE_MAX_SIZE, SHADOW_CASCADE_MAX_SIZE, TextureFormat_RGBA32F, ColorBind));
+		Renderer->ShadowMoments = ImportFrameGraphTexture(Graph, "ShadowMoments", GetRendererShadowMomentsDesc(), ShadowMoments);
+		FrameGraphRead(Graph, Renderer->ShadowMomentsPass, Renderer->ShadowAtlas);
+		FrameGraphWrite(Graph, Renderer->ShadowMomentsPass, Renderer->ShadowMomentsBlur);
+		FrameGraphWrite(Graph, Renderer->ShadowMomentsPass, Renderer->ShadowMoments);
+	}
+
+	// NOTE(georgy): Depth only, so the G-buffer pass shades every pixel once
+	Renderer->DepthPrepass = FRAME_GRAPH_INVALID_INDEX;
+	Renderer->Depth = CreateFrameGraphTexture(Graph, "Depth", TextureDesc(Width, Height, TextureFormat_Depth24Stencil8, TextureBind_DepthStencil));
+	if(DepthPrepass)
+	{
+		Renderer->DepthPrepass = AddFrameGraphPass(Graph, "DepthPrepass");
+		FrameGraphWrite(Graph, Renderer->DepthPrepass, Renderer->Depth);
+	}
+
+	// NOTE(georgy): GBuffer pass also computes the shadow factor, it goes to the W of Color
+	Renderer->GBufferPass = AddFrameGraphPass(Graph, "GBuffer");
+	Renderer->Normals = CreateFrameGraphTexture(Graph, "Normals", TextureDesc(Width, Height, TextureFormat_RGBA16F, ColorBind));
+	Renderer->Color = CreateFrameGraphTexture(Graph, "Color", TextureDesc(Width, Height, TextureFormat_RGBA16F, ColorBind));
+	Renderer->LinearDepth = CreateFrameGraphTexture(Graph, "LinearDepth", TextureDesc(Width, Height, TextureFormat_R32F, ColorBind));
+	FrameGraphRead(Graph, Renderer->GBufferPass, ShadowMoments ? Renderer->ShadowMoments : Renderer->ShadowAtlas);
+	FrameGraphWrite(Graph, Renderer->GBufferPass, Renderer->Normals);
+	FrameGraphWrite(Graph, Renderer->GBufferPass, Renderer->Color);
+	FrameGraphWrite(Graph, Renderer->GBufferPass, Renderer->LinearDepth);
+	if(DepthPrepass)
+	{
+		FrameGraphRead(Graph, Renderer->GBufferPass, Renderer->Depth);
+	}
+	else
+	{
+		FrameGraphWrite(Graph, Renderer->GBufferPass, Renderer->Depth);
+	}
+
+	// NOTE(georgy): RSM gather, once per visible surface instead of once per rasterized fragment
+	uint32_t LowWidth = (Width + RENDERER_RSM_DOWNSAMPLE - 1) / RENDERER_RSM_DOWNSAMPLE;
+	uint32_t LowHeight = (Height + RENDERER_RSM_DOWNSAMPLE - 1) / RENDERER_RSM_DOWNSAMPLE;
+	Renderer->RSMPass = AddFrameGraphPass(Graph, "RSM");
+	Renderer->RSMIndirectIllum = CreateFrameGraphTexture(Graph, "RSMIndirectIllum", TextureDesc(LowWidth, LowHeight, TextureFormat_RGBA16F, ColorBind));
+	FrameGraphRead(Graph, Renderer->RSMPass, Renderer->RSMWorldPos);
+	FrameGraphRead(Graph, Renderer->RSMPass, Renderer->RSMNormals);
+	FrameGraphRead(Graph, Renderer->RSMPass, Renderer->Flux);
+	FrameGraphRead(Graph, Renderer->RSMPass, Renderer->Normals);
+	FrameGraphRead(Graph, Renderer->RSMPass, Renderer->LinearDepth);
+	FrameGraphWrite(Graph, Renderer->RSMPass, Renderer->RSMIndirectIllum);
+
+	// NOTE(georgy): Temporal accumulation, last frame's history reprojected and blended with this frame's gather
+	Renderer->TemporalPass = AddFrameGraphPass(Graph, "Temporal");
+	Renderer->RSMHistory = ImportFrameGraphTexture(Graph, "RSMHistory", TextureDesc(LowWidth, LowHeight, TextureFormat_RGBA16F, ColorBind), RSMHistory[0]);
+	Renderer->RSMAccumulated = ImportFrameGraphTexture(Graph, "RSMAccumulated", TextureDesc(LowWidth, LowHeight, TextureFormat_RGBA16F, ColorBind), RSMHistory[1]);
+	FrameGraphRead(Graph, Renderer->TemporalPass, Renderer->RSMIndirectIllum);
+	FrameGraphRead(Graph, Renderer->TemporalPass, Renderer->RSMHistory);
+	FrameGraphRead(Graph, Renderer->TemporalPass, Renderer->LinearDepth);
+	FrameGraphWrite(Graph, Renderer->TemporalPass, Renderer->RSMAccumulated);
+
+	// NOTE(georgy): Separable depth aware blur, guided by the G-buffer's normals and depth
+	Renderer->BlurHorizontalPass = AddFrameGraphPass(Graph, "BlurHorizontal");
+	Renderer->RSMBlurHorizontal = CreateFrameGraphTexture(Graph, "RSMBlurHorizontal", TextureDesc(LowWidth, LowHeight, TextureFormat_RGBA16F, ColorBind));
+	FrameGraphRead(Graph, Renderer->BlurHorizontalPass, Renderer->RSMAccumulated);
+	FrameGraphRead(Graph, Renderer->BlurHorizontalPass, Renderer->Normals);
+	FrameGraphRead(Graph, Renderer->BlurHorizontalPass, Renderer->LinearDepth);
+	FrameGraphWrite(Graph, Renderer->BlurHorizontalPass, Renderer->RSMBlurHorizontal);
+
+	Renderer->BlurVerticalPass = AddFrameGraphPass(Graph, "BlurVertical");
+	Renderer->RSMIndirectIllumAfterBlur = CreateFrameGraphTexture(Graph, "RSMIndirectIllumAfterBlur", TextureDesc(LowWidth, LowHeight, TextureFormat_RGBA16F, ColorBind));
+	FrameGraphRead(Graph, Renderer->BlurVerticalPass, Renderer->RSMBlurHorizontal);
+	FrameGraphRead(Graph, Renderer->BlurVerticalPass, Renderer->Normals);
+	FrameGraphRead(Graph, Renderer->BlurVerticalPass, Renderer->LinearDepth);
+	FrameGraphWrite(Graph, Renderer->BlurVerticalPass, Renderer->RSMIndirectIllumAfterBlur);
+
+	Renderer->DeferredPass = AddFrameGraphPass(Graph, "Deferred");
+	FrameGraphRead(Graph, Renderer->DeferredPass, Renderer->Normals);
+	FrameGraphRead(Graph, Renderer->DeferredPass, Renderer->RSMIndirectIllumAfterBlur);
+	FrameGraphRead(Graph, Renderer->DeferredPass, Renderer->Color);
+	FrameGraphRead(Graph, Renderer->DeferredPass, Renderer->LinearDepth);
+	FrameGraphWrite(Graph, Renderer->DeferredPass, Renderer->BackBuffer);
+}
@@ -0,0 +1,388 @@
+#pragma once
+
+#include <random>
+
+#include "memory_arena.hpp"
+
+//
+// NOTE(georgy): Sample sets for the RSM gather in GBufferPS.hlsl.
+//
+// A sample is an offset in the unit disk around the pixel's position in the RSM (scaled by the gather radius
+// in the shader) and the weight its texel gets. Samples are generated as points in the unit square and warped
+// onto the annulus RSM_MIN_SAMPLE_RADIUS <= r <= 1, with r growing with the square of the first coordinate.
+// That puts more samples close to the center, where the 1/distance^4 falloff makes the RSM texels count the most,
+// and the weight of each sample is 1/(Count * density) so the sum estimates the same integral no matter how many
+// samples there are. Uniform in radius didn't concentrate enough: at 16 samples Sobol came out worse than
+// the original set (linux_bench rsmsamples), a cubic or quartic warp is no better than the square.
+//
+// The square can be filled with plain random points, Poisson disk (best candidate), Sobol or R2 points.
+// The last three are spread a lot more evenly than random points, so fewer of them give the same error.
+// The original set (random directions, radius growing quadratically with the index, radius^2 weights) is kept
+// for comparison.
+//
+// Per pixel the set is rotated by an angle from a tiled noise texture. The noise is blue noise made with
+// void and cluster, so neighbouring pixels get rotations far apart and the blur after the gather
+// averages them out.
+//
+
+// NOTE(georgy): These have to match the rsm_samples and rsm_noise cbuffers in GBufferPS.hlsl
+#define RSM_MAX_SAMPLE_COUNT 64
+#define RSM_MAX_NOISE_SIZE 32
+
+#define RSM_MIN_SAMPLE_RADIUS 0.1f
+
+// NOTE(georgy): About what the original 64 samples' weights (radius^2 / 8) added up to per unit of the annulus' area,
+// so the indirect light keeps its brightness. linux_bench's exact gather is scaled by it too, so the other patterns are unbiased
+// estimates of it and only the original set (which has its own weights) is off by however far the 0.6 is from exact.
+#define RSM_INDIRECT_SCALE 0.6f
+
+// NOTE(georgy): Width of the gaussian that void and cluster uses to find clusters and voids, in texels
+#define BLUE_NOISE_SIGMA 1.5f
+
+enum rsm_sample_pattern
+{
+	RSMSamplePattern_Original,
+	RSMSamplePattern_Random,
+	RSMSamplePattern_PoissonDisk,
+	RSMSamplePattern_Sobol,
+	RSMSamplePattern_R2,
+
+	RSMSamplePattern_Count
+};
+
+static const char *RSMSamplePatternNames[RSMSamplePattern_Count] =
+{
+	"original",
+	"random",
+	"poisson",
+	"sobol",
+	"r2",
+};
+
+// NOTE(georgy): Same layout as the rsm_samples cbuffer. Samples are (x, y, weight, 0).
+struct rsm_sample_constants
+{
+	v4 Samples[RSM_MAX_SAMPLE_COUNT];
+	uint32_t SampleCount;
+	uint32_t NoiseSize;
+	uint32_t Pad[2];
+};
+
+// NOTE(georgy): Same layout as the rsm_noise cbuffer. Rotations as (cos, sin), two per element, row major.
+struct rsm_noise_constants
+{
+	v4 Rotations[RSM_MAX_NOISE_SIZE*RSM_MAX_NOISE_SIZE/2];
+};
+
+inline v4
+MakeRSMSample(real32 U, real32 V, uint32_t Count)
+{
+	real32 Radius = RSM_MIN_SAMPLE_RADIUS + (1.0f - RSM_MIN_SAMPLE_RADIUS)*U*U;
+	real32 Angle = 2.0f*PI*V;
+
+	// NOTE(georgy): dr/dU = 2*U*(1 - MinRadius), so the density of the warped points is
+	// 1 / (2*pi*r * 2*U*(1 - MinRadius)) per unit of area
+	real32 Weight = RSM_INDIRECT_SCALE*2.0f*PI*Radius*2.0f*U*(1.0f - RSM_MIN_SAMPLE_RADIUS) / Count;
+	v4 Result = V4(Radius*cosf(Angle), Radius*sinf(Angle), Weight, 0.0f);
+	return(Result);
+}
+
+inline real32
+RadicalInverseBase2(uint32_t Index)
+{
+	Index = (Index << 16) | (Index >> 16);
+	Index = ((Index & 0x00FF00FF) << 8) | ((Index & 0xFF00FF00) >> 8);
+	Index = ((Index & 0x0F0F0F0F) << 4) | ((Index & 0xF0F0F0F0) >> 4);
+	Index = ((Index & 0x33333333) << 2) | ((Index & 0xCCCCCCCC) >> 2);
+	Index = ((Index & 0x55555555) << 1) | ((Index & 0xAAAAAAAA) >> 1);
+	real32 Result = (real32)(Index >> 8) * (1.0f / 16777216.0f);
+	return(Result);
+}
+
+// NOTE(georgy): Second dimension of the Sobol sequence, the first one is RadicalInverseBase2
+inline real32
+SobolSecondDimension(uint32_t Index)
+{
+	uint32_t Bits = 0;
+	for(uint32_t V = 1u << 31; Index; Index >>= 1, V ^= V >> 1)
+	{
+		if(Index & 1)
+		{
+			Bits ^= V;
+		}
+	}
+	real32 Result = (real32)(Bits >> 8) * (1.0f / 16777216.0f);
+	return(Result);
+}
+
+inline real32
+WrapUnit(real32 Value)
+{
+	real32 Result = Value - floorf(Value);
+	return(Result);
+}
+
+// NOTE(georgy): Distance between points of the unit square that wraps around, so Poisson disk points
+// don't bunch up along the edges (the warp glues the angle's edges together anyway)
+inline real32
+ToroidalDistanceSq(v2 A, v2 B)
+{
+	real32 DX = fabsf(A.x - B.x), DY = fabsf(A.y - B.y);
+	DX = (DX > 0.5f) ? (1.0f - DX) : DX;
+	DY = (DY > 0.5f) ? (1.0f - DY) : DY;
+	real32 Result = DX*DX + DY*DY;
+	return(Result);
+}
+
+// NOTE(georgy): Count samples, at most RSM_MAX_SAMPLE_COUNT. Seed only matters for the patterns that use random numbers
+// (Sobol gets a random digital shift from it).
+static void
+GenerateRSMSamples(v4 *Samples, uint32_t Count, rsm_sample_pattern Pattern, uint32_t Seed = 0)
+{
+	Assert((Count > 0) && (Count <= RSM_MAX_SAMPLE_COUNT));
+
+	std::uniform_real_distribution<float> RandomFloats(0.0f, 1.0f);
+	std::default_random_engine Generator(Seed);
+	switch(Pattern)
+	{
+		case RSMSamplePattern_Original:
+		{
+			for(uint32_t I = 0; I < Count; I++)
+			{
+				v4 Sample;
+				Sample.x = 2.0f*RandomFloats(Generator) - 1.0f;
+				Sample.y = 2.0f*RandomFloats(Generator) - 1.0f;
+				Sample.z = Sample.w = 0.0f;
+				Sample.Normalize();
+
+				float Scale = (float)I / Count;
+				Scale = Lerp(0.1f, 1.0f, Scale*Scale);
+				Sample *= Scale;
+
+				// NOTE(georgy): The shader used to divide the sum of 64 of these by 8
+				Sample.z = (Sample.x*Sample.x + Sample.y*Sample.y) * (64.0f / 8.0f) / Count;
+				Samples[I] = Sample;
+			}
+		} break;
+
+		case RSMSamplePattern_Random:
+		{
+			for(uint32_t I = 0; I < Count; I++)
+			{
+				real32 U = RandomFloats(Generator);
+				real32 V = RandomFloats(Generator);
+				Samples[I] = MakeRSMSample(U, V, Count);
+			}
+		} break;
+
+		case RSMSamplePattern_PoissonDisk:
+		{
+			// NOTE(georgy): Mitchell's best candidate: of a few random candidates, take the one farthest from
+			// all the points so far. More candidates for later points, the same as the number of points so far.
+			v2 Points[RSM_MAX_SAMPLE_COUNT];
+			for(uint32_t I = 0; I < Count; I++)
+			{
+				real32 BestDistanceSq = -1.0f;
+				uint32_t CandidateCount = (I > 0) ? 4*I : 1;
+				for(uint32_t Candidate = 0; Candidate < CandidateCount; Candidate++)
+				{
+					v2 P = V2(RandomFloats(Generator), RandomFloats(Generator));
+					real32 DistanceSq = FLT_MAX;
+					for(uint32_t J = 0; J < I; J++)
+					{
+						real32 D = ToroidalDistanceSq(P, Points[J]);
+						DistanceSq = (D < DistanceSq) ? D : DistanceSq;
+					}
+					if(DistanceSq > BestDistanceSq)
+					{
+						BestDistanceSq = DistanceSq;
+						Points[I] = P;
+					}
+				}
+				Samples[I] = MakeRSMSample(Points[I].x, Points[I].y, Count);
+			}
+		} break;
+
+		case RSMSamplePattern_Sobol:
+		{
+			uint32_t ShiftU = Generator(), ShiftV = Generator();
+			ShiftU = Seed ? ShiftU : 0;
+			ShiftV = Seed ? ShiftV : 0;
+			for(uint32_t I = 0; I < Count; I++)
+			{
+				// NOTE(georgy): Half a cell in, so no sample sits exactly on the inner edge of the annulus
+				real32 U = WrapUnit(RadicalInverseBase2(I) + (ShiftU >> 8)*(1.0f / 16777216.0f) + 0.5f / Count);
+				real32 V = WrapUnit(SobolSecondDimension(I) + (ShiftV >> 8)*(1.0f / 16777216.0f) + 0.5f / Count);
+				Samples[I] = MakeRSMSample(U, V, Count);
+			}
+		} break;
+
+		case RSMSamplePattern_R2:
+		{
+			// NOTE(georgy): Roberts' R2 sequence, steps by the inverse powers of the plastic number
+			real32 G = 1.32471795724474602596f;
+			real32 A1 = 1.0f / G, A2 = 1.0f / (G*G);
+			real32 Offset = Seed ? RandomFloats(Generator) : 0.5f;
+			for(uint32_t I = 0; I < Count; I++)
+			{
+				real32 U = WrapUnit(Offset + A1*(I + 1));
+				real32 V = WrapUnit(Offset + A2*(I + 1));
+				Samples[I] = MakeRSMSample(U, V, Count);
+			}
+		} break;
+
+		default: Assert(!"Unknown RSM sample pattern");
+	}
+}
+
+//
+// NOTE(georgy): Blue noise, void and cluster (Ulichney 1993). Every texel gets a rank 0..Size*Size-1, and the texels
+// with rank below any threshold form an evenly spread pattern. Everything wraps around, so the texture tiles.
+//
+
+struct blue_noise_state
+{
+	uint32_t Size;
+	real32 *Kernel;
+	real32 *Energy;
+	uint8_t *Pattern;
+};
+
+// NOTE(georgy): Adds (or with Sign = -1 removes) the gaussian around texel Index to every texel's energy
+static void
+SplatBlueNoiseEnergy(blue_noise_state *State, uint32_t Index, real32 Sign)
+{
+	uint32_t Size = State->Size;
+	uint32_t X0 = Index % Size, Y0 = Index / Size;
+	for(uint32_t Y = 0; Y < Size; Y++)
+	{
+		uint32_t DY = (Y + Size - Y0) % Size;
+		for(uint32_t X = 0; X < Size; X++)
+		{
+			uint32_t DX = (X + Size - X0) % Size;
+			State->Energy[Y*Size + X] += Sign*State->Kernel[DY*Size + DX];
+		}
+	}
+}
+
+// NOTE(georgy): The tightest cluster is the set texel with the most energy, the largest void the empty one with the least
+static uint32_t
+FindBlueNoiseTexel(blue_noise_state *State, uint8_t Value, bool Cluster)
+{
+	uint32_t Result = 0;
+	real32 Best = Cluster ? -FLT_MAX : FLT_MAX;
+	for(uint32_t Index = 0; Index < State->Size*State->Size; Index++)
+	{
+		real32 Energy = State->Energy[Index];
+		if((State->Pattern[Index] == Value) && (Cluster ? (Energy > Best) : (Energy < Best)))
+		{
+			Best = Energy;
+			Result = Index;
+		}
+	}
+	return(Result);
+}
+
+static void
+GenerateBlueNoise(uint32_t *Ranks, uint32_t Size, memory_arena *TempArena, uint32_t Seed = 0)
+{
+	temporary_memory TempMem = BeginTemporaryMemory(TempArena);
+
+	uint32_t Count = Size*Size;
+	blue_noise_state State;
+	State.Size = Size;
+	State.Kernel = PushArray(TempArena, Count, real32);
+	State.Energy = PushArray(TempArena, Count, real32, true);
+	State.Pattern = PushArray(TempArena, Count, uint8_t, true);
+	real32 *PrototypeEnergy = PushArray(TempArena, Count, real32);
+	uint8_t *PrototypePattern = PushArray(TempArena, Count, uint8_t);
+
+	for(uint32_t Y = 0; Y < Size; Y++)
+	{
+		for(uint32_t X = 0; X < Size; X++)
+		{
+			real32 DX = (real32)((X <= Size/2) ? X : (Size - X));
+			real32 DY = (real32)((Y <= Size/2) ? Y : (Size - Y));
+			State.Kernel[Y*Size + X] = expf(-(DX*DX + DY*DY) / (2.0f*BLUE_NOISE_SIGMA*BLUE_NOISE_SIGMA));
+		}
+	}
+
+	// NOTE(georgy): Initial pattern: a tenth of the texels at random, then keep moving the tightest cluster
+	// into the largest void until the texel that would move is the one that was just moved
+	std::default_random_engine Generator(Seed);
+	uint32_t InitialCount = (Count / 10) ? (Count / 10) : 1;
+	for(uint32_t I = 0; I < InitialCount; )
+	{
+		uint32_t Index = Generator() % Count;
+		if(!State.Pattern[Index])
+		{
+			State.Pattern[Index] = 1;
+			SplatBlueNoiseEnergy(&State, Index, 1.0f);
+			I++;
+		}
+	}
+	for(;;)
+	{
+		uint32_t Cluster = FindBlueNoiseTexel(&State, 1, true);
+		State.Pattern[Cluster] = 0;
+		SplatBlueNoiseEnergy(&State, Cluster, -1.0f);
+
+		uint32_t Void = FindBlueNoiseTexel(&State, 0, false);
+		State.Pattern[Void] = 1;
+		SplatBlueNoiseEnergy(&State, Void, 1.0f);
+		if(Void == Cluster)
+		{
+			break;
+		}
+	}
+	memcpy(PrototypeEnergy, State.Energy, Count*sizeof(real32));
+	memcpy(PrototypePattern, State.Pattern, Count*sizeof(uint8_t));
+
+	// NOTE(georgy): Ranks below the initial count: take the tightest clusters out one by one
+	for(uint32_t Rank = InitialCount; Rank-- > 0; )
+	{
+		uint32_t Cluster = FindBlueNoiseTexel(&State, 1, true);
+		State.Pattern[Cluster] = 0;
+		SplatBlueNoiseEnergy(&State, Cluster, -1.0f);
+		Ranks[Cluster] = Rank;
+	}
+
+	// NOTE(georgy): The rest: fill the largest voids one by one. Past half full the original algorithm
+	// looks for the tightest cluster of empty texels instead, but the energy of the empty texels is the kernel's sum
+	// minus the energy of the set ones, so that is the same texel.
+	memcpy(State.Energy, PrototypeEnergy, Count*sizeof(real32));
+	memcpy(State.Pattern, PrototypePattern, Count*sizeof(uint8_t));
+	for(uint32_t Rank = InitialCount; Rank < Count; Rank++)
+	{
+		uint32_t Void = FindBlueNoiseTexel(&State, 0, false);
+		State.Pattern[Void] = 1;
+		SplatBlueNoiseEnergy(&State, Void, 1.0f);
+		Ranks[Void] = Rank;
+	}
+
+	EndTemporaryMemory(TempMem);
+}
+
+// NOTE(georgy): Rotations evenly spaced around the circle, in the order of the texels' blue noise ranks.
+// The scratch memory for the largest tile is small enough for the stack.
+static void
+GenerateRSMNoise(rsm_noise_constants *Noise, uint32_t Size, uint32_t Seed = 0)
+{
+	Assert((Size > 0) && (Size <= RSM_MAX_NOISE_SIZE) && ((Size*Size % 2) == 0));
+
+	uint8_t Scratch[20*RSM_MAX_NOISE_SIZE*RSM_MAX_NOISE_SIZE + 256];
+	memory_arena TempArena;
+	InitializeArena(&TempArena, sizeof(Scratch), Scratch);
+
+	uint32_t Count = Size*Size;
+	uint32_t *Ranks = PushArray(&TempArena, Count, uint32_t);
+	GenerateBlueNoise(Ranks, Size, &TempArena, Seed);
+
+	real32 *Rotations = (real32 *)Noise->Rotations;
+	for(uint32_t Index = 0; Index < Count; Index++)
+	{
+		real32 Angle = 2.0f*PI*(Ranks[Index] + 0.5f) / Count;
+		Rotations[2*Index + 0] = cosf(Angle);
+		Rotations[2*Index + 1] = sinf(Angle);
+	}
+}
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "memory_arena.hpp"
+#include "job_system.hpp"
+
+//
+// NOTE(georgy): Scene. Objects are stored as structure of arrays, one array per field, all indexed by the object index,
+// so a pass that only needs e.g. world bounds doesn't pull transforms and colors through the cache.
+//
+// Every object has a parent (or SCENE_NO_PARENT) and the parent always has a smaller index than its children.
+// That way one walk over the arrays in index order visits every parent before its children.
+//
+// World = Local * ParentWorld (row vectors, same as the rest of the math). Setting a local transform only marks
+// the object dirty. UpdateSceneTransforms walks the dirty flags once: an object gets a new world transform if it
+// or its parent changed in this update, so only the changed subtrees are recomputed.
+// The changed objects are gathered into a list first and then multiplied and refitted in batches with SSE,
+// the list is also what systems that care about moved objects (bounds trees etc.) read afterwards.
+//
+// With worker threads the changed objects are also bucketed by depth in the hierarchy. Objects at the same depth
+// never depend on each other, so each depth is one ParallelFor, and depth N+1 starts once depth N is written.
+//
+
+#define SCENE_NO_PARENT 0xFFFFFFFF
+#define SCENE_NO_MESH 0xFFFFFFFF
+#define SCENE_MAX_DEPTH 64
+
+// NOTE(georgy): Fewer changed objects than this aren't worth waking the workers for
+#define SCENE_PARALLEL_MIN_COUNT 4096
+#define SCENE_UPDATE_MIN_GRAIN_SIZE 1024
+
+// NOTE(georgy): World space AABBs as center and half extent, one array per component
+struct scene_bounds
+{
+	real32 *CenterX;
+	real32 *CenterY;
+	real32 *CenterZ;
+	real32 *ExtentX;
+	real32 *ExtentY;
+	real32 *ExtentZ;
+};
+
+struct scene
+{
+	uint32_t Count;
+	uint32_t MaxCount;
+
+	uint32_t *Parents;
+	uint8_t *Depths;
+	mat4 *LocalTransforms;
+	mat4 *WorldTransforms;
+	uint32_t *Meshes;
+	v3 *Colors;
+
+	// NOTE(georgy): Set for objects that are expected to move, their shadows aren't cached (shadow_cache.hpp).
+	// Children of a dynamic object are dynamic too.
+	uint8_t *Dynamic;
+
+	// NOTE(georgy): In the object's own space, the world bounds are refitted from these with the world transform
+	v3 *LocalBoundsCenters;
+	v3 *LocalBoundsExtents;
+	scene_bounds WorldBounds;
+
+	// NOTE(georgy): Set when the local transform changes. During the update it also gets set for every
+	// object whose parent changed, and it's cleared once the new world transforms are written.
+	uint8_t *Dirty;
+
+	// NOTE(georgy): Objects that got a new world transform in the last update, in index order
+	uint32_t ChangedCount;
+	uint32_t *ChangedObjects;
+
+	// NOTE(georgy): ChangedObjects sorted by depth, only filled when the update runs in parallel
+	uint32_t *DepthOrder;
+};
+
+static void
+InitializeScene(scene *Scene, memory_arena *Arena, uint32_t MaxCount)
+{
+	*Scene = {};
+	Scene->MaxCount = MaxCount;
+
+	Scene->Parents = PushArray(Arena, MaxCount, uint32_t);
+	Scene->Depths = PushArray(Arena, MaxCount, uint8_t);
+	// NOTE(georgy): 16 byte aligned so the SSE loads don't have to be unaligned
+	Scene->LocalTransforms = (mat4 *)PushSize(Arena, MaxCount*sizeof(mat4));
+	Scene->WorldTransforms = (mat4 *)PushSize(Arena, MaxCount*sizeof(mat4));
+	Scene->Meshes = PushArray(Arena, MaxCount, uint32_t);
+	Scene->Colors = PushArray(Arena, MaxCount, v3);
+	Scene->Dynamic = PushArray(Arena, MaxCount, uint8_t);
+	Scene->LocalBoundsCenters = PushArray(Arena, MaxCount, v3);
+	Scene->LocalBoundsExtents = PushArray(Arena, MaxCount, v3);
+	Scene->WorldBounds.CenterX = PushArray(Arena, MaxCount, real32);
+	Scene->WorldBounds.CenterY = PushArray(Arena, MaxCount, real32);
+	Scene->WorldBounds.CenterZ = PushArray(Arena, MaxCount, real32);
+	Scene->WorldBounds.ExtentX = PushArray(Arena, MaxCount, real32);
+	Scene->WorldBounds.ExtentY = PushArray(Arena, MaxCount, real32);
+	Scene->WorldBounds.ExtentZ = PushArray(Arena, MaxCount, real32);
+	Scene->Dirty = PushArray(Arena, MaxCount, uint8_t, true);
+	Scene->ChangedObjects = PushArray(Arena, MaxCount, uint32_t);
+	Scene->DepthOrder = PushArray(Arena, MaxCount, uint32_t);
+}
+
+// NOTE(georgy): Parent has to be added before its children. Mesh is a render_mesh or SCENE_NO_MESH for pure transform nodes.
+static uint32_t
+AddSceneObject(scene *Scene, uint32_t Parent, mat4 LocalTransform, uint32_t Mesh = SCENE_NO_MESH, v3 Color = V3(0.0f, 0.0f, 0.0f),
+			   v3 BoundsCenter = V3(0.0f, 0.0f, 0.0f), v3 BoundsExtent = V3(0.0f, 0.0f, 0.0f), bool Dynamic = false)
+{
+	Assert(Scene->Count < Scene->MaxCount);
+	Assert((Parent == SCENE_NO_PARENT) || (Parent < Scene->Count));
+
+	uint32_t Result = Scene->Count++;
+	Scene->Parents[Result] = Parent;
+	Scene->Depths[Result] = (Parent == SCENE_NO_PARENT) ? 0 : (Scene->Depths[Parent] + 1);
+	Assert(Scene->Depths[Result] < SCENE_MAX_DEPTH);
+	Scene->LocalTransforms[Result] = LocalTransform;
+	Scene->WorldTransforms[Result] = Identity();
+	Scene->Meshes[Result] = Mesh;
+	Scene->Colors[Result] = Color;
+	Scene->Dynamic[Result] = (Dynamic || ((Parent != SCENE_NO_PARENT) && Scene->Dynamic[Parent])) ? 1 : 0;
+	Scene->LocalBoundsCenters[Result] = BoundsCenter;
+	Scene->LocalBoundsExtents[Result] = BoundsExtent;
+	Scene->Dirty[Result] = 1;
+
+	return(Result);
+}
+
+inline void
+SetLocalTransform(scene *Scene, uint32_t Object, mat4 LocalTransform)
+{
+	Assert(Object < Scene->Count);
+	Scene->LocalTransforms[Object] = LocalTransform;
+	Scene->Dirty[Object] = 1;
+}
+
+//
+// NOTE(georgy): Transform update
+//
+
+// NOTE(georgy): mat4 is stored column by column, so column J of A*B is A's columns weighted by column J of B
+inline void
+MultiplyTransformsSSE(__m128 *Columns, mat4 *A, mat4 *B)
+{
+	__m128 A0 = _mm_load_ps(A->Elements + 0);
+	__m128 A1 = _mm_load_ps(A->Elements + 4);
+	__m128 A2 = _mm_load_ps(A->Elements + 8);
+	__m128 A3 = _mm_load_ps(A->Elements + 12);
+	for(uint32_t J = 0; J < 4; J++)
+	{
+		__m128 BColumn = _mm_load_ps(B->Elements + J*4);
+		__m128 Column = _mm_mul_ps(A0, _mm_shuffle_ps(BColumn, BColumn, _MM_SHUFFLE(0, 0, 0, 0)));
+		Column = _mm_add_ps(Column, _mm_mul_ps(A1, _mm_shuffle_ps(BColumn, BColumn, _MM_SHUFFLE(1, 1, 1, 1))));
+		Column = _mm_add_ps(Column, _mm_mul_ps(A2, _mm_shuffle_ps(BColumn, BColumn, _MM_SHUFFLE(2, 2, 2, 2))));
+		Column = _mm_add_ps(Column, _mm_mul_ps(A3, _mm_shuffle_ps(BColumn, BColumn, _MM_SHUFFLE(3, 3, 3, 3))));
+		Columns[J] = Column;
+	}
+}
+
+// NOTE(georgy): Every object's parent has to be done already, either earlier in Objects or in an earlier batch
+static void
+UpdateSceneTransformBatch(scene *Scene, uint32_t *Objects, uint32_t Count)
+{
+	// NOTE(georgy): Roots are multiplied by identity instead of taking a different path
+	alignas(16) mat4 RootParent = Identity();
+	__m128 SignMask = _mm_set1_ps(-0.0f);
+
+	// NOTE(georgy): Locals, otherwise every SSE store makes the compiler reload them from the scene
+	uint32_t *Parents = Scene->Parents;
+	mat4 *LocalTransforms = Scene->LocalTransforms;
+	mat4 *WorldTransforms = Scene->WorldTransforms;
+	v3 *LocalBoundsCenters = Scene->LocalBoundsCenters;
+	v3 *LocalBoundsExtents = Scene->LocalBoundsExtents;
+	scene_bounds Bounds = Scene->WorldBounds;
+
+	for(uint32_t I = 0; I < Count; I++)
+	{
+		uint32_t Object = Objects[I];
+		uint32_t Parent = Parents[Object];
+		mat4 *ParentWorld = (Parent == SCENE_NO_PARENT) ? &RootParent : (WorldTransforms + Parent);
+
+		__m128 Columns[4];
+		MultiplyTransformsSSE(Columns, LocalTransforms + Object, ParentWorld);
+		real32 *World = WorldTransforms[Object].Elements;
+		_mm_store_ps(World + 0, Columns[0]);
+		_mm_store_ps(World + 4, Columns[1]);
+		_mm_store_ps(World + 8, Columns[2]);
+		_mm_store_ps(World + 12, Columns[3]);
+
+		// NOTE(georgy): Columns to rows, a point is x*Row0 + y*Row1 + z*Row2 + Row3.
+		// The box's half extent along each world axis is |Row| weighted by the local half extent.
+		_MM_TRANSPOSE4_PS(Columns[0], Columns[1], Columns[2], Columns[3]);
+		v3 C = LocalBoundsCenters[Object];
+		v3 E = LocalBoundsExtents[Object];
+		__m128 Center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Columns[0], _mm_set1_ps(C.x)), _mm_mul_ps(Columns[1], _mm_set1_ps(C.y))),
+								   _mm_add_ps(_mm_mul_ps(Columns[2], _mm_set1_ps(C.z)), Columns[3]));
+		__m128 Extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(SignMask, Columns[0]), _mm_set1_ps(E.x)),
+											  _mm_mul_ps(_mm_andnot_ps(SignMask, Columns[1]), _mm_set1_ps(E.y))),
+								   _mm_mul_ps(_mm_andnot_ps(SignMask, Columns[2]), _mm_set1_ps(E.z)));
+
+		alignas(16) real32 CenterLanes[4];
+		alignas(16) real32 ExtentLanes[4];
+		_mm_store_ps(CenterLanes, Center);
+		_mm_store_ps(ExtentLanes, Extent);
+		Bounds.CenterX[Object] = CenterLanes[0];
+		Bounds.CenterY[Object] = CenterLanes[1];
+		Bounds.CenterZ[Object] = CenterLanes[2];
+		Bounds.ExtentX[Object] = ExtentLanes[0];
+		Bounds.ExtentY[Object] = ExtentLanes[1];
+		Bounds.ExtentZ[Object] = ExtentLanes[2];
+	}
+}
+
+struct scene_update_job
+{
+	scene *Scene;
+	uint32_t *Objects;
+};
+
+static void
+UpdateSceneTransformRange(uint32_t Start, uint32_t OnePastEnd, void *UserData)
+{
+	scene_update_job *Job = (scene_update_job *)UserData;
+	UpdateSceneTransformBatch(Job->Scene, Job->Objects + Start, OnePastEnd - Start);
+}
+
+// NOTE(georgy): Returns how many objects got a new world transform, they are listed in ChangedObjects
+static uint32_t
+UpdateSceneTransforms(scene *Scene, job_system *JobSystem)
+{
+	// NOTE(georgy): Propagate the dirty flags down. Parents come first, so the parent's flag is final by the time the child reads it.
+	uint8_t *Dirty = Scene->Dirty;
+	uint32_t *Parents = Scene->Parents;
+	uint32_t *ChangedObjects = Scene->ChangedObjects;
+	uint32_t ChangedCount = 0;
+	for(uint32_t Object = 0; Object < Scene->Count; Object++)
+	{
+		uint32_t Parent = Parents[Object];
+		uint8_t ObjectDirty = Dirty[Object] | ((Parent != SCENE_NO_PARENT) ? Dirty[Parent] : 0);
+		Dirty[Object] = ObjectDirty;
+		ChangedObjects[ChangedCount] = Object;
+		ChangedCount += ObjectDirty;
+	}
+	Scene->ChangedCount = ChangedCount;
+
+	if((JobSystem->WorkerThreadCount == 0) || (ChangedCount < SCENE_PARALLEL_MIN_COUNT))
+	{
+		// NOTE(georgy): Index order already has every parent before its children
+		UpdateSceneTransformBatch(Scene, ChangedObjects, ChangedCount);
+	}
+	else
+	{
+		uint8_t *Depths = Scene->Depths;
+		uint32_t DepthCounts[SCENE_MAX_DEPTH] = {};
+		for(uint32_t I = 0; I < ChangedCount; I++)
+		{
+			DepthCounts[Depths[ChangedObjects[I]]]++;
+		}
+
+		uint32_t DepthStarts[SCENE_MAX_DEPTH + 1];
+		DepthStarts[0] = 0;
+		for(uint32_t Depth = 0; Depth < SCENE_MAX_DEPTH; Depth++)
+		{
+			DepthStarts[Depth + 1] = DepthStarts[Depth] + DepthCounts[Depth];
+		}
+
+		uint32_t Offsets[SCENE_MAX_DEPTH];
+		memcpy(Offsets, DepthStarts, sizeof(Offsets));
+		for(uint32_t I = 0; I < ChangedCount; I++)
+		{
+			uint32_t Object = ChangedObjects[I];
+			Scene->DepthOrder[Offsets[Depths[Object]]++] = Object;
+		}
+
+		scene_update_job Job = {Scene, 0};
+		for(uint32_t Depth = 0; Depth < SCENE_MAX_DEPTH; Depth++)
+		{
+			if(DepthCounts[Depth])
+			{
+				Job.Objects = Scene->DepthOrder + DepthStarts[Depth];
+				ParallelFor(JobSystem, DepthCounts[Depth], UpdateSceneTransformRange, &Job, SCENE_UPDATE_MIN_GRAIN_SIZE);
+			}
+		}
+	}
+
+	for(uint32_t I = 0; I < ChangedCount; I++)
+	{
+		Dirty[ChangedObjects[I]] = 0;
+	}
+
+	return(ChangedCount);
+}
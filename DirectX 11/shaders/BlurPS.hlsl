@@ -1,10 +1,21 @@
+// NOTE(georgy): Has to match RENDERER_RSM_DOWNSAMPLE
+#define RSM_DOWNSAMPLE 2
+
+// NOTE(georgy): Have to match depth_aware_blur.hpp
+#define DEPTH_AWARE_BLUR_DEPTH_SIGMA 0.02
+#define DEPTH_AWARE_BLUR_NORMAL_POWER 16.0
+#define DEPTH_AWARE_BLUR_MAX_RADIUS 8
+
 Texture2D Texture : register(t0);
+Texture2D NormalsTexture : register(t1);
+Texture2D LinearDepthTexture : register(t2);
 
-SamplerState Sampler
+// NOTE(georgy): One per direction, the layout has to match depth_aware_blur_constants
+cbuffer blur_constants : register(b1)
 {
-    Filter = MIN_MAG_MIP_LINEAR;
-    AddressU = Clamp;
-    AddressV = Clamp;
+    int2 BlurDirection;
+    int BlurRadius;
+    float BlurSigma;
 };
 
 struct vs_output
@@ -13,23 +24,46 @@ struct vs_output
     float2 TexCoords : TEXCOORD;
 };
 
+float GetDepthAwareBlurWeight(float Depth, float3 Normal, float TapDepth, float3 TapNormal)
+{
+    float DepthDifference = (TapDepth - Depth) / (DEPTH_AWARE_BLUR_DEPTH_SIGMA*Depth);
+    float DepthWeight = exp(-DepthDifference*DepthDifference);
+    float NormalWeight = pow(max(dot(Normal, TapNormal), 0.0), DEPTH_AWARE_BLUR_NORMAL_POWER);
+
+    float Result = DepthWeight*NormalWeight;
+    return(Result);
+}
+
+// NOTE(georgy): The same as DepthAwareBlurPass. Low resolution texel (X, Y) is the full resolution pixel
+// (RSM_DOWNSAMPLE*X, RSM_DOWNSAMPLE*Y), that's where its depth and normal are. W keeps the center's linear depth.
 float4 PS(vs_output Input) : SV_TARGET
 {
-    float TextureWidth;
-    float TextureHeight;
-    Texture.GetDimensions(TextureWidth, TextureHeight);
-    float2 TexelSize = 1.0 / float2(TextureWidth, TextureHeight);
+    int2 Texel = (int2)Input.Pos.xy;
+    float Width, Height;
+    Texture.GetDimensions(Width, Height);
+    int2 MaxTexel = int2(Width, Height) - 1;
+
+    float4 Center = Texture.Load(int3(Texel, 0));
+    float3 Normal = NormalsTexture.Load(int3(RSM_DOWNSAMPLE*Texel, 0)).xyz;
+    float Depth = LinearDepthTexture.Load(int3(RSM_DOWNSAMPLE*Texel, 0)).r;
 
-    float4 FinalColor = float4(0.0, 0.0, 0.0, 0.0);
-    for(int X = -2; X <= 1; X++)
+    float3 Sum = Center.xyz;
+    float WeightSum = 1.0;
+    [loop]
+    for(int Tap = 1; Tap <= min(BlurRadius, DEPTH_AWARE_BLUR_MAX_RADIUS); Tap++)
     {
-        for(int Y = -2; Y <= 1; Y++)
+        float Gaussian = exp(-(float)(Tap*Tap) / (2.0*BlurSigma*BlurSigma));
+        for(int Side = -1; Side <= 1; Side += 2)
         {
-            FinalColor.xyz += Texture.Sample(Sampler, Input.TexCoords + TexelSize*float2(X, Y)).xyz;
+            int2 TapTexel = clamp(Texel + Side*Tap*BlurDirection, int2(0, 0), MaxTexel);
+            float3 TapNormal = NormalsTexture.Load(int3(RSM_DOWNSAMPLE*TapTexel, 0)).xyz;
+            float TapDepth = LinearDepthTexture.Load(int3(RSM_DOWNSAMPLE*TapTexel, 0)).r;
+
+            float Weight = Gaussian*GetDepthAwareBlurWeight(Depth, Normal, TapDepth, TapNormal);
+            Sum += Weight*Texture.Load(int3(TapTexel, 0)).xyz;
+            WeightSum += Weight;
         }
     }
 
-    FinalColor *= (1.0 / 16.0);
-    FinalColor.w = Texture.Sample(Sampler, Input.TexCoords).w;
-    return(FinalColor);
-}
\ No newline at end of file
+    return(float4(Sum / WeightSum, Center.w));
+}
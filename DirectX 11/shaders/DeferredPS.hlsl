@@ -1,3 +1,14 @@
+// NOTE(georgy): Has to match SHADOW_CASCADE_COUNT
+#define SHADOW_CASCADE_COUNT 4
+
+// NOTE(georgy): Has to match RENDERER_RSM_DOWNSAMPLE
+#define RSM_DOWNSAMPLE 2
+
+// NOTE(georgy): Has to match bilateral_upsample.hpp
+#define BILATERAL_UPSAMPLE_DEPTH_SIGMA 0.02
+#define BILATERAL_UPSAMPLE_NORMAL_POWER 16.0
+#define BILATERAL_UPSAMPLE_MIN_WEIGHT 1e-4
+
 Texture2D NormalsTexture : register(t0);
 Texture2D RSMIndirectIllumTexture : register(t1);
 Texture2D ColorTexture : register(t2);
@@ -6,17 +17,26 @@ Texture2D WorldPosTexture : register(t4);
 
 SamplerState DefaultSampler : register(s0);
 
-cbuffer camera_info : register(b0)
+cbuffer frame_constants : register(b0)
 {
+    float4x4 CameraProjection;
+    float4x4 CameraView;
+    float4x4 LightProjection;
+    float4x4 LightView;
     float4 WorldVectorsToFarCorners[4]; // NOTE(georgy): W of these vectors contain FarPlane distance
     float4 CameraWorldPos;
-};
 
-cbuffer matrix_buffer : register(b1)
-{
-    float4x4 Projection;
-    float4x4 View;
-    float4x4 Model;
+    float4x4 ViewToPrevClip;
+    float2 RSMFrameRotation;
+    float HistoryValid;
+    float Pad;
+
+    float4x4 CascadeViewProjections[SHADOW_CASCADE_COUNT];
+    float4 CascadeSplits; // NOTE(georgy): View space Z each cascade ends at
+    float4 CascadeBiases;
+
+    float4 CascadeAtlasRects[SHADOW_CASCADE_COUNT]; // NOTE(georgy): UV of the tile's corner in XY, its size in Z
+    float4 RSMAtlasRect;
 };
 
 struct vs_output
@@ -28,7 +48,7 @@ struct vs_output
 
 float CalculateScreenSpaceShadows(float3 ViewPos, float3 ToLightDir)
 {
-    float3 ToLightDirView = normalize(mul(float4(ToLightDir, 0.0), View).xyz);
+    float3 ToLightDirView = normalize(mul(float4(ToLightDir, 0.0), CameraView).xyz);
 
     const uint StepCount = 12;
     const float RayMaxDistance = 0.05f;
@@ -41,7 +61,7 @@ float CalculateScreenSpaceShadows(float3 ViewPos, float3 ToLightDir)
     {
         RayPos += RayStep;
 
-        float4 RayUV = mul(float4(RayPos, 1.0), Projection);
+        float4 RayUV = mul(float4(RayPos, 1.0), CameraProjection);
         RayUV.xyz /= RayUV.w;
         RayUV.xy = float2(0.5f, -0.5f)*RayUV.xy + float2(0.5, 0.5);
 
@@ -61,22 +81,65 @@ float CalculateScreenSpaceShadows(float3 ViewPos, float3 ToLightDir)
     return(1.0f - SSShadowsFactor);
 }
 
+// NOTE(georgy): Joint bilateral upsample of the low resolution indirect illumination, the same as BilateralUpsamplePixel
+float3 UpsampleIndirectIllum(float2 ScreenSpaceP, float Depth, float3 Normal)
+{
+    float LowWidth, LowHeight;
+    RSMIndirectIllumTexture.GetDimensions(LowWidth, LowHeight);
+    int2 LowMax = int2(LowWidth, LowHeight) - 1;
+
+    float2 LowP = ScreenSpaceP / RSM_DOWNSAMPLE - 0.5;
+    int2 Base = (int2)floor(LowP);
+    float2 Fraction = LowP - Base;
+
+    float3 Sum = float3(0.0, 0.0, 0.0);
+    float WeightSum = 0.0;
+    float3 Closest = float3(0.0, 0.0, 0.0);
+    float ClosestDepthDifference = 3.402823466e+38;
+    for(int TapY = 0; TapY < 2; TapY++)
+    {
+        for(int TapX = 0; TapX < 2; TapX++)
+        {
+            int2 Texel = clamp(Base + int2(TapX, TapY), int2(0, 0), LowMax);
+            int3 Pixel = int3(RSM_DOWNSAMPLE*Texel, 0);
+
+            float3 Color = RSMIndirectIllumTexture.Load(int3(Texel, 0)).xyz;
+            float TexelDepth = LinearDepthTexture.Load(Pixel).r;
+            float3 TexelNormal = NormalsTexture.Load(Pixel).xyz;
+
+            float DepthDifference = (TexelDepth - Depth) / (BILATERAL_UPSAMPLE_DEPTH_SIGMA*Depth);
+            float Weight = (TapX ? Fraction.x : 1.0 - Fraction.x) * (TapY ? Fraction.y : 1.0 - Fraction.y);
+            Weight *= exp(-DepthDifference*DepthDifference) * pow(max(dot(Normal, TexelNormal), 0.0), BILATERAL_UPSAMPLE_NORMAL_POWER);
+            Sum += Weight*Color;
+            WeightSum += Weight;
+
+            if(abs(TexelDepth - Depth) < ClosestDepthDifference)
+            {
+                ClosestDepthDifference = abs(TexelDepth - Depth);
+                Closest = Color;
+            }
+        }
+    }
+
+    float3 Result = (WeightSum > BILATERAL_UPSAMPLE_MIN_WEIGHT) ? Sum / WeightSum : Closest;
+    return(Result);
+}
+
 float4 PS(vs_output Input) : SV_TARGET
 {
     float4 FragColor = float4(0.0, 0.0, 0.0, 0.0);
 
     float3 SunDir = normalize(float3(-1.0, -1.0, 1.0));
     float3 Normal = NormalsTexture.Sample(DefaultSampler, Input.TexCoords).xyz;
-    
-    float4 RSMIndirectIllum = RSMIndirectIllumTexture.Sample(DefaultSampler, Input.TexCoords);
-    float ShadowFactor = RSMIndirectIllum.w;
+    float4 Color = ColorTexture.Sample(DefaultSampler, Input.TexCoords);
+    float ShadowFactor = Color.w;
 
     float LinearDepth = LinearDepthTexture.Sample(DefaultSampler, Input.TexCoords).r;
     float3 ViewPos = LinearDepth*Input.CameraVec.xyz;
     float SSShadowsFactor = CalculateScreenSpaceShadows(ViewPos, -SunDir);
 
-    float3 Ambient = RSMIndirectIllum.xyz;
-    float3 DiffuseColor = SSShadowsFactor * ShadowFactor * max(dot(Normal, -SunDir), 0.0) * ColorTexture.Sample(DefaultSampler, Input.TexCoords).xyz;
+    float3 Ambient = UpsampleIndirectIllum(Input.Pos.xy, LinearDepth, Normal);
+    float3 DiffuseColor = SSShadowsFactor * ShadowFactor * max(dot(Normal, -SunDir), 0.0) * Color.xyz;
 
     float3 FinalColor = Ambient + DiffuseColor;
     float3 ColorAfterToneMapping = FinalColor / (FinalColor + 1.0);
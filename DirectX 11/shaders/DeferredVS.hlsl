@@ -1,3 +1,6 @@
+// NOTE(georgy): Has to match SHADOW_CASCADE_COUNT
+#define SHADOW_CASCADE_COUNT 4
+
 struct vs_input
 {
     float3 Pos : POSITION;
@@ -10,10 +13,26 @@ struct vs_output
     float4 CameraVec : TEXCOORD1;
 };
 
-cbuffer camera_info : register(b0)
+cbuffer frame_constants : register(b0)
 {
+    float4x4 CameraProjection;
+    float4x4 CameraView;
+    float4x4 LightProjection;
+    float4x4 LightView;
     float4 WorldVectorsToFarCorners[4]; // NOTE(georgy): W of these vectors contain FarPlane distance
     float4 CameraWorldPos;
+
+    float4x4 ViewToPrevClip;
+    float2 RSMFrameRotation;
+    float HistoryValid;
+    float Pad;
+
+    float4x4 CascadeViewProjections[SHADOW_CASCADE_COUNT];
+    float4 CascadeSplits; // NOTE(georgy): View space Z each cascade ends at
+    float4 CascadeBiases;
+
+    float4 CascadeAtlasRects[SHADOW_CASCADE_COUNT]; // NOTE(georgy): UV of the tile's corner in XY, its size in Z
+    float4 RSMAtlasRect;
 };
 
 vs_output VS(vs_input Input, uint ID: SV_VertexID)
@@ -1,114 +1,173 @@
+// NOTE(georgy): Has to match SHADOW_CASCADE_COUNT
+#define SHADOW_CASCADE_COUNT 4
+
+// NOTE(georgy): Has to match RENDERER_SHADOW_ATLAS_SIZE
+#define SHADOW_ATLAS_SIZE 2048
+
+// NOTE(georgy): Have to match shadow_moments.hpp
+#define SHADOW_MOMENTS_POSITIVE_EXPONENT 40.0
+#define SHADOW_MOMENTS_NEGATIVE_EXPONENT 5.0
+#define SHADOW_MOMENTS_VARIANCE_BIAS 0.0001
+#define SHADOW_MOMENTS_LIGHT_BLEEDING 0.1
+#define SHADOW_MOMENTS_MIP_COUNT 8
+
 struct vs_output
 {
     float4 Pos : SV_POSITION;
     float4 WorldPos : POSITION;
     float3 WorldNormal : NORMAL;
+    nointerpolation float3 Color : COLOR;
 };
 
-cbuffer color_info : register(b1)
-{
-    float3 Color;
-};
-
-cbuffer light_matrix : register(b2)
+cbuffer frame_constants : register(b0)
 {
+    float4x4 CameraProjection;
+    float4x4 CameraView;
     float4x4 LightProjection;
     float4x4 LightView;
-};
+    float4 WorldVectorsToFarCorners[4]; // NOTE(georgy): W of these vectors contain FarPlane distance
+    float4 CameraWorldPos;
 
-cbuffer rsm_samples : register(b3)
-{
-    float2 RSMSamples[64];
-};
+    float4x4 ViewToPrevClip;
+    float2 RSMFrameRotation;
+    float HistoryValid;
+    float Pad;
 
-cbuffer rsm_noise : register(b4)
-{
-    float2 RSMNoise[16];
-};
+    float4x4 CascadeViewProjections[SHADOW_CASCADE_COUNT];
+    float4 CascadeSplits; // NOTE(georgy): View space Z each cascade ends at
+    float4 CascadeBiases;
 
-cbuffer camera_info : register(b5)
-{
-    float4 WorldVectorsToFarCorners[4]; // NOTE(georgy): W of these vectors contain FarPlane distance
-    float4 CameraWorldPos;
+    float4 CascadeAtlasRects[SHADOW_CASCADE_COUNT]; // NOTE(georgy): UV of the tile's corner in XY, its size in Z
+    float4 RSMAtlasRect;
 };
 
-Texture2D ShadowMap : register(t0);
-Texture2D WorldPosTexture : register(t1);
-Texture2D WorldNormalsTexture : register(t2);
-Texture2D FluxTexture : register(t3);
+// NOTE(georgy): Every cascade is a tile of it
+Texture2D ShadowAtlas : register(t0);
+// NOTE(georgy): And of this one, with the moments filter (shadow_moments.hpp)
+Texture2D ShadowMoments : register(t1);
 
-SamplerState DefaultSampler : register(s0);
 SamplerState ShadowMapSampler : register(s1);
+SamplerState ShadowMomentsSampler : register(s2);
+
+// NOTE(georgy): The same as GetShadowCascadeIndex
+uint GetShadowCascade(float ViewSpaceZ)
+{
+    uint Result = 0;
+    [unroll]
+    for(uint I = 0; I < SHADOW_CASCADE_COUNT; I++)
+    {
+        Result += (ViewSpaceZ > CascadeSplits[I]) ? 1 : 0;
+    }
+    return(Result);
+}
 
-float CalculateShadow(float3 FragWorldPos)
+// NOTE(georgy): The same as GetShadowCascadeAtlasPos. Nothing past the last cascade is shadowed.
+float CalculateShadow(float3 FragWorldPos, float ViewSpaceZ)
 {
-    float4 LightClipSpace = mul(mul(float4(FragWorldPos, 1.0), LightView), LightProjection);
-    float3 LightNDC = LightClipSpace.xyz / LightClipSpace.w;
-    float2 UV = float2(0.5, -0.5)*LightNDC.xy + float2(0.5, 0.5);
+    uint Cascade = GetShadowCascade(ViewSpaceZ);
 
-    float ShadowMapDepth = ShadowMap.Sample(ShadowMapSampler, UV).x;
+    float ShadowFactor = 1.0;
+    if(Cascade < SHADOW_CASCADE_COUNT)
+    {
+        float4 LightClipSpace = mul(float4(FragWorldPos, 1.0), CascadeViewProjections[Cascade]);
+        float2 UV = float2(0.5, -0.5)*LightClipSpace.xy + float2(0.5, 0.5);
+        UV = CascadeAtlasRects[Cascade].xy + UV*CascadeAtlasRects[Cascade].z;
 
-    float Bias = 0.075;
-    float ShadowFactor = ((LightNDC.z - Bias) > ShadowMapDepth) ? 0.0 : 1.0;
+        float ShadowMapDepth = ShadowAtlas.Sample(ShadowMapSampler, UV).x;
+        ShadowFactor = ((LightClipSpace.z - CascadeBiases[Cascade]) > ShadowMapDepth) ? 0.0 : 1.0;
+    }
 
     return(ShadowFactor);
 }
 
-float3 CalculateRSM(float3 FragWorldPos, float3 FragWorldNormal, float2 ScreenSpaceP)
+float GetChebyshevUpperBound(float2 Moments, float T, float MinVariance)
 {
-    float4 LightClipSpace = mul(mul(float4(FragWorldPos, 1.0), LightView), LightProjection);
-    float3 LightNDC = LightClipSpace.xyz / LightClipSpace.w;
-    float2 UV = float2(0.5, -0.5)*LightNDC.xy + float2(0.5, 0.5);
-
-    uint2 PixelIndex = (uint2)ScreenSpaceP;
-    uint XI = PixelIndex.x % 4;
-    uint YI = PixelIndex.y % 4;
-    float2 RandomVec = RSMNoise[YI*4 + XI];
-    float2x2 NoiseMatrix = float2x2(RandomVec, float2(RandomVec.y, -RandomVec.x));
-
-    const float MaxRadius = 0.3;
-    float3 IndirectIllumination = float3(0.0, 0.0, 0.0);
-    for(int I = 0; I < 64; I++)
+    float Result = 1.0;
+    if(T > Moments.x)
     {
-        float2 SampleUV = UV + MaxRadius*mul(RSMSamples[I], NoiseMatrix);
+        float Variance = max(Moments.y - Moments.x*Moments.x, MinVariance);
+        float Difference = T - Moments.x;
+        Result = Variance / (Variance + Difference*Difference);
+    }
+    return(Result);
+}
 
-        float3 WorldPos = WorldPosTexture.Sample(DefaultSampler, SampleUV).xyz;
-        float3 WorldNormal = WorldNormalsTexture.Sample(DefaultSampler, SampleUV).xyz;
-        float3 Flux = FluxTexture.Sample(DefaultSampler, SampleUV).xyz;
+// NOTE(georgy): The same as GetShadowMomentsVisibility
+float GetShadowMomentsVisibility(float4 Moments, float Depth)
+{
+    float Centered = 2.0*saturate(Depth) - 1.0;
+    float2 Warped = float2(exp(SHADOW_MOMENTS_POSITIVE_EXPONENT*Centered), -exp(-SHADOW_MOMENTS_NEGATIVE_EXPONENT*Centered));
+    float2 Bias = SHADOW_MOMENTS_VARIANCE_BIAS*float2(SHADOW_MOMENTS_POSITIVE_EXPONENT, SHADOW_MOMENTS_NEGATIVE_EXPONENT)*Warped;
+
+    float Positive = GetChebyshevUpperBound(Moments.xy, Warped.x, Bias.x*Bias.x);
+    float Negative = GetChebyshevUpperBound(Moments.zw, Warped.y, Bias.y*Bias.y);
 
-        float3 IndirectBounce = Flux * max(dot(WorldNormal, normalize(FragWorldPos - WorldPos)), 0.0) * 
-                                       max(dot(FragWorldNormal, normalize(WorldPos - FragWorldPos)), 0.0) /
-                                       pow(length(WorldPos - FragWorldPos), 4);
-        IndirectBounce *= dot(RSMSamples[I].xy, RSMSamples[I].xy);
+    float Result = saturate((min(Positive, Negative) - SHADOW_MOMENTS_LIGHT_BLEEDING) / (1.0 - SHADOW_MOMENTS_LIGHT_BLEEDING));
+    return(Result);
+}
+
+// NOTE(georgy): Like CalculateShadow, with one trilinear fetch of the filtered moments. The mip is GetShadowMomentsLod of
+// the texels the pixel's world space footprint covers in its cascade, the position stays half a texel of that mip inside
+// the tile. The derivatives are taken before the cascade branch, pixels of a quad can be in different cascades.
+float CalculateShadowMoments(float3 FragWorldPos, float ViewSpaceZ)
+{
+    float3 WorldPosDX = ddx(FragWorldPos);
+    float3 WorldPosDY = ddy(FragWorldPos);
+    uint Cascade = GetShadowCascade(ViewSpaceZ);
 
-        IndirectIllumination += IndirectBounce;
+    float ShadowFactor = 1.0;
+    if(Cascade < SHADOW_CASCADE_COUNT)
+    {
+        float4x4 ViewProjection = CascadeViewProjections[Cascade];
+        float4 Rect = CascadeAtlasRects[Cascade];
+        float TileSize = Rect.z*SHADOW_ATLAS_SIZE;
+
+        float4 LightClipSpace = mul(float4(FragWorldPos, 1.0), ViewProjection);
+        float2 UV = float2(0.5, -0.5)*LightClipSpace.xy + float2(0.5, 0.5);
+        float2 UVDX = float2(0.5, -0.5)*mul(float4(WorldPosDX, 0.0), ViewProjection).xy;
+        float2 UVDY = float2(0.5, -0.5)*mul(float4(WorldPosDY, 0.0), ViewProjection).xy;
+        float TexelsPerPixel = TileSize*max(length(UVDX), length(UVDY));
+        float Lod = min(log2(max(TexelsPerPixel, 1.0)), SHADOW_MOMENTS_MIP_COUNT - 1);
+
+        float Inset = 0.5*exp2(ceil(Lod)) / TileSize;
+        UV = Rect.xy + clamp(UV, Inset, 1.0 - Inset)*Rect.z;
+
+        float4 Moments = ShadowMoments.SampleLevel(ShadowMomentsSampler, UV, Lod);
+        ShadowFactor = GetShadowMomentsVisibility(Moments, LightClipSpace.z - CascadeBiases[Cascade]);
     }
 
-    IndirectIllumination = IndirectIllumination / 8.0;
-    return(IndirectIllumination);
+    return(ShadowFactor);
 }
 
 struct gbuffer_output
 {
     float4 Normal : SV_TARGET0;
-    float4 RSMIndirectIllum : SV_TARGET1;
-    float4 Color : SV_TARGET2;
-    float4 LinearDepth : SV_TARGET3;
+    float4 Color : SV_TARGET1;
+    float4 LinearDepth : SV_TARGET2;
 };
 
-gbuffer_output PS(vs_output Input, float4 ScreenSpacePos : SV_Position)
+gbuffer_output WriteGBuffer(vs_output Input, float ShadowFactor)
 {
     gbuffer_output Output;
 
     Output.Normal = float4(normalize(Input.WorldNormal), 0.0);
-    
-    Output.RSMIndirectIllum.xyz = CalculateRSM(Input.WorldPos.xyz, Input.WorldNormal, ScreenSpacePos.xy);
-    Output.RSMIndirectIllum.w = CalculateShadow(Input.WorldPos.xyz);
-    Output.Color = float4(Color, 1.0);
+    Output.Color = float4(Input.Color, ShadowFactor);
 
-    float ViewSpaceZ = Input.WorldPos.w;
     float FarPlane = WorldVectorsToFarCorners[0].w;
-    Output.LinearDepth = ViewSpaceZ / FarPlane;
+    Output.LinearDepth = Input.WorldPos.w / FarPlane;
+
+    return(Output);
+}
 
+gbuffer_output PS(vs_output Input)
+{
+    gbuffer_output Output = WriteGBuffer(Input, CalculateShadow(Input.WorldPos.xyz, Input.WorldPos.w));
+    return(Output);
+}
+
+// NOTE(georgy): With the moments filter
+gbuffer_output MomentsPS(vs_output Input)
+{
+    gbuffer_output Output = WriteGBuffer(Input, CalculateShadowMoments(Input.WorldPos.xyz, Input.WorldPos.w));
     return(Output);
 }
\ No newline at end of file
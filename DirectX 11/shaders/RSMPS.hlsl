@@ -0,0 +1,123 @@
+// NOTE(georgy): Has to match SHADOW_CASCADE_COUNT
+#define SHADOW_CASCADE_COUNT 4
+
+// NOTE(georgy): Has to match RENDERER_RSM_DOWNSAMPLE
+#define RSM_DOWNSAMPLE 2
+
+Texture2D NormalsTexture : register(t0);
+Texture2D LinearDepthTexture : register(t1);
+Texture2D WorldPosTexture : register(t2);
+Texture2D WorldNormalsTexture : register(t3);
+Texture2D FluxTexture : register(t4);
+
+SamplerState DefaultSampler : register(s0);
+
+cbuffer frame_constants : register(b0)
+{
+    float4x4 CameraProjection;
+    float4x4 CameraView;
+    float4x4 LightProjection;
+    float4x4 LightView;
+    float4 WorldVectorsToFarCorners[4]; // NOTE(georgy): W of these vectors contain FarPlane distance
+    float4 CameraWorldPos;
+
+    float4x4 ViewToPrevClip;
+    float2 RSMFrameRotation;
+    float HistoryValid;
+    float Pad;
+
+    float4x4 CascadeViewProjections[SHADOW_CASCADE_COUNT];
+    float4 CascadeSplits; // NOTE(georgy): View space Z each cascade ends at
+    float4 CascadeBiases;
+
+    float4 CascadeAtlasRects[SHADOW_CASCADE_COUNT]; // NOTE(georgy): UV of the tile's corner in XY, its size in Z
+    float4 RSMAtlasRect;
+};
+
+// NOTE(georgy): Filled once by InitializeRenderer (rsm_samples.hpp), the layouts have to match rsm_sample_constants and rsm_noise_constants
+cbuffer rsm_samples : register(b3)
+{
+    float4 RSMSamples[64]; // NOTE(georgy): Offset in XY, weight in Z
+    uint RSMSampleCount;
+    uint RSMNoiseSize;
+};
+
+cbuffer rsm_noise : register(b4)
+{
+    float4 RSMNoise[512]; // NOTE(georgy): Two rotations (cos, sin) per element
+};
+
+struct vs_output
+{
+    float4 Pos : SV_POSITION;
+    float2 TexCoords : TEXCOORD;
+};
+
+float3 CalculateRSM(float3 FragWorldPos, float3 FragWorldNormal, float2 ScreenSpaceP)
+{
+    float4 LightClipSpace = mul(mul(float4(FragWorldPos, 1.0), LightView), LightProjection);
+    float3 LightNDC = LightClipSpace.xyz / LightClipSpace.w;
+    float2 UV = float2(0.5, -0.5)*LightNDC.xy + float2(0.5, 0.5);
+
+    uint2 PixelIndex = (uint2)ScreenSpaceP;
+    uint XI = PixelIndex.x % RSMNoiseSize;
+    uint YI = PixelIndex.y % RSMNoiseSize;
+    uint NoiseIndex = YI*RSMNoiseSize + XI;
+    float4 RandomVecs = RSMNoise[NoiseIndex / 2];
+    float2 RandomVec = (NoiseIndex & 1) ? RandomVecs.zw : RandomVecs.xy;
+    RandomVec = float2(RandomVec.x*RSMFrameRotation.x - RandomVec.y*RSMFrameRotation.y,
+                       RandomVec.y*RSMFrameRotation.x + RandomVec.x*RSMFrameRotation.y);
+    float2x2 NoiseMatrix = float2x2(RandomVec, float2(RandomVec.y, -RandomVec.x));
+
+    const float MaxRadius = 0.3;
+    float3 IndirectIllumination = float3(0.0, 0.0, 0.0);
+    for(uint I = 0; I < RSMSampleCount; I++)
+    {
+        float2 SampleUV = UV + MaxRadius*mul(RSMSamples[I].xy, NoiseMatrix);
+        if(any(SampleUV < 0.0) || any(SampleUV > 1.0))
+        {
+            continue;
+        }
+        SampleUV = RSMAtlasRect.xy + SampleUV*RSMAtlasRect.z;
+
+        float3 WorldPos = WorldPosTexture.SampleLevel(DefaultSampler, SampleUV, 0).xyz;
+        float3 WorldNormal = WorldNormalsTexture.SampleLevel(DefaultSampler, SampleUV, 0).xyz;
+        float3 Flux = FluxTexture.SampleLevel(DefaultSampler, SampleUV, 0).xyz;
+
+        float3 IndirectBounce = Flux * max(dot(WorldNormal, normalize(FragWorldPos - WorldPos)), 0.0) *
+                                       max(dot(FragWorldNormal, normalize(WorldPos - FragWorldPos)), 0.0) /
+                                       pow(length(WorldPos - FragWorldPos), 4);
+        IndirectBounce *= RSMSamples[I].z;
+
+        IndirectIllumination += IndirectBounce;
+    }
+
+    return(IndirectIllumination);
+}
+
+// NOTE(georgy): Low resolution texel (X, Y) gathers for the full resolution pixel (RSM_DOWNSAMPLE*X, RSM_DOWNSAMPLE*Y),
+// DeferredPS reads that pixel's depth and normal back when it upsamples
+float4 PS(vs_output Input) : SV_TARGET
+{
+    int3 Pixel = int3(RSM_DOWNSAMPLE*(int2)Input.Pos.xy, 0);
+    float3 Normal = NormalsTexture.Load(Pixel).xyz;
+    float LinearDepth = LinearDepthTexture.Load(Pixel).r;
+
+    float3 IndirectIllumination = float3(0.0, 0.0, 0.0);
+    if(dot(Normal, Normal) > 0.0)
+    {
+        float Width, Height;
+        LinearDepthTexture.GetDimensions(Width, Height);
+        float2 UV = (Pixel.xy + 0.5) / float2(Width, Height);
+
+        // NOTE(georgy): Corners are top left, bottom left, top right, bottom right like the full screen quad's vertices.
+        // They are in view space, CameraView's rotation takes them back to world space.
+        float3 CameraVec = lerp(lerp(WorldVectorsToFarCorners[0].xyz, WorldVectorsToFarCorners[2].xyz, UV.x),
+                                lerp(WorldVectorsToFarCorners[1].xyz, WorldVectorsToFarCorners[3].xyz, UV.x), UV.y);
+        float3 WorldPos = CameraWorldPos.xyz + LinearDepth*mul((float3x3)CameraView, CameraVec);
+
+        IndirectIllumination = CalculateRSM(WorldPos, Normal, Input.Pos.xy);
+    }
+
+    return(float4(IndirectIllumination, LinearDepth));
+}
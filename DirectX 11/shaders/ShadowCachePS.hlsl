@@ -0,0 +1,46 @@
+// NOTE(georgy): Static layers of the light maps (shadow_cache.hpp), in the order DrawCachedLightView binds them.
+// The cascades only have the depth.
+Texture2D StaticDepthTexture : register(t0);
+Texture2D StaticWorldPosTexture : register(t1);
+Texture2D StaticNormalsTexture : register(t2);
+Texture2D StaticFluxTexture : register(t3);
+
+struct vs_output
+{
+    float4 Pos : SV_POSITION;
+    float2 TexCoords : TEXCOORD;
+};
+
+struct ps_output
+{
+    float4 WorldPos : SV_TARGET0;
+    float4 Normal : SV_TARGET1;
+    float4 Flux : SV_TARGET2;
+    float Depth : SV_DEPTH;
+};
+
+// NOTE(georgy): Static layer and tile have the same layout, so the texel is the same one
+ps_output CopyPS(vs_output Input)
+{
+    int3 Texel = int3((int2)Input.Pos.xy, 0);
+
+    ps_output Output;
+    Output.WorldPos = StaticWorldPosTexture.Load(Texel);
+    Output.Normal = StaticNormalsTexture.Load(Texel);
+    Output.Flux = StaticFluxTexture.Load(Texel);
+    Output.Depth = StaticDepthTexture.Load(Texel).r;
+
+    return(Output);
+}
+
+// NOTE(georgy): What clearing the whole light maps used to write, only inside the tile
+ps_output ClearPS(vs_output Input)
+{
+    ps_output Output;
+    Output.WorldPos = float4(0.0, 0.0, 0.0, 1.0);
+    Output.Normal = float4(0.0, 0.0, 0.0, 1.0);
+    Output.Flux = float4(0.0, 0.0, 0.0, 1.0);
+    Output.Depth = 1.0;
+
+    return(Output);
+}
@@ -3,6 +3,7 @@ struct vs_output
     float4 Pos : SV_POSITION;
     float3 WorldPos : POSITION;
     float3 WorldNormal : NORMAL;
+    nointerpolation float3 Color : COLOR;
 };
 
 struct ps_output
@@ -12,18 +13,13 @@ struct ps_output
     float3 Flux : SV_TARGET2;
 };
 
-cbuffer color_info : register(b1)
-{
-    float3 Color;
-};
-
 ps_output PS(vs_output Input)
 {
     ps_output Output;
 
     Output.WorldPos = Input.WorldPos;
     Output.WorldNormal = normalize(Input.WorldNormal);
-    Output.Flux = 0.1*Color;
+    Output.Flux = 0.1*Input.Color;
     
     return(Output);
 }
\ No newline at end of file
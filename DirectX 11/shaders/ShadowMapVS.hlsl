@@ -1,14 +1,40 @@
-cbuffer matrix_buffer : register(b0)
+// NOTE(georgy): Has to match SHADOW_CASCADE_COUNT
+#define SHADOW_CASCADE_COUNT 4
+
+cbuffer frame_constants : register(b0)
 {
-    float4x4 Projection;
-    float4x4 View;
-    float4x4 Model;
+    float4x4 CameraProjection;
+    float4x4 CameraView;
+    float4x4 LightProjection;
+    float4x4 LightView;
+    float4 WorldVectorsToFarCorners[4]; // NOTE(georgy): W of these vectors contain FarPlane distance
+    float4 CameraWorldPos;
+
+    float4x4 ViewToPrevClip;
+    float2 RSMFrameRotation;
+    float HistoryValid;
+    float Pad;
+
+    float4x4 CascadeViewProjections[SHADOW_CASCADE_COUNT];
+    float4 CascadeSplits; // NOTE(georgy): View space Z each cascade ends at
+    float4 CascadeBiases;
+
+    float4 CascadeAtlasRects[SHADOW_CASCADE_COUNT]; // NOTE(georgy): UV of the tile's corner in XY, its size in Z
+    float4 RSMAtlasRect;
 };
 
 struct vs_input
 {
     float3 Pos : POSITION;
     float3 Normal : NORMAL;
+
+    // NOTE(georgy): Per instance. The model matrix comes in as its columns,
+    // the same memory layout as a column major float4x4 in a cbuffer.
+    float4 Model0 : MODEL0;
+    float4 Model1 : MODEL1;
+    float4 Model2 : MODEL2;
+    float4 Model3 : MODEL3;
+    float3 Color : COLOR;
 };
 
 struct vs_output
@@ -16,17 +42,21 @@ struct vs_output
     float4 Pos : SV_POSITION;
     float3 WorldPos : POSITION;
     float3 WorldNormal : NORMAL;
+    nointerpolation float3 Color : COLOR;
 };
 
 vs_output VS(vs_input Input)
 {
     vs_output Output;
 
+    float4x4 Model = transpose(float4x4(Input.Model0, Input.Model1, Input.Model2, Input.Model3));
+
     float4 ModelP = mul(float4(Input.Pos, 1.0), Model);
-    float4 ViewP = mul(ModelP, View);
-    Output.Pos = mul(ViewP, Projection);
+    float4 ViewP = mul(ModelP, LightView);
+    Output.Pos = mul(ViewP, LightProjection);
     Output.WorldPos = (float3)ModelP;
     Output.WorldNormal = normalize(mul(Input.Normal, (float3x3)Model));
+    Output.Color = Input.Color;
 
     return(Output);
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+// NOTE(georgy): Has to match SHADOW_CASCADE_COUNT
+#define SHADOW_CASCADE_COUNT 4
+
+// NOTE(georgy): Has to match RENDERER_SHADOW_ATLAS_SIZE
+#define SHADOW_ATLAS_SIZE 2048
+
+// NOTE(georgy): Have to match shadow_moments.hpp
+#define SHADOW_MOMENTS_POSITIVE_EXPONENT 40.0
+#define SHADOW_MOMENTS_NEGATIVE_EXPONENT 5.0
+#define SHADOW_MOMENTS_BLUR_RADIUS 2
+#define SHADOW_MOMENTS_BLUR_SIGMA 1.0
+
+// NOTE(georgy): The shadow atlas for the horizontal pass, what the horizontal pass gave for the vertical one
+Texture2D Texture : register(t0);
+
+cbuffer frame_constants : register(b0)
+{
+    float4x4 CameraProjection;
+    float4x4 CameraView;
+    float4x4 LightProjection;
+    float4x4 LightView;
+    float4 WorldVectorsToFarCorners[4]; // NOTE(georgy): W of these vectors contain FarPlane distance
+    float4 CameraWorldPos;
+
+    float4x4 ViewToPrevClip;
+    float2 RSMFrameRotation;
+    float HistoryValid;
+    float Pad;
+
+    float4x4 CascadeViewProjections[SHADOW_CASCADE_COUNT];
+    float4 CascadeSplits; // NOTE(georgy): View space Z each cascade ends at
+    float4 CascadeBiases;
+
+    float4 CascadeAtlasRects[SHADOW_CASCADE_COUNT]; // NOTE(georgy): UV of the tile's corner in XY, its size in Z
+    float4 RSMAtlasRect;
+};
+
+// NOTE(georgy): One per cascade, the layout has to match shadow_cascade_constants
+cbuffer shadow_cascade_constants : register(b2)
+{
+    uint CascadeIndex;
+};
+
+struct vs_output
+{
+    float4 Pos : SV_POSITION;
+    float2 TexCoords : TEXCOORD;
+};
+
+float4 EncodeShadowMoments(float Depth)
+{
+    float Centered = 2.0*Depth - 1.0;
+    float2 Warped = float2(exp(SHADOW_MOMENTS_POSITIVE_EXPONENT*Centered), -exp(-SHADOW_MOMENTS_NEGATIVE_EXPONENT*Centered));
+
+    float4 Result = float4(Warped.x, Warped.x*Warped.x, Warped.y, Warped.y*Warped.y);
+    return(Result);
+}
+
+// NOTE(georgy): Corner and size of the cascade's tile in texels of the atlas
+int3 GetCascadeTile()
+{
+    float4 Rect = CascadeAtlasRects[CascadeIndex];
+    int3 Result = int3(round(Rect.xy*SHADOW_ATLAS_SIZE), round(Rect.z*SHADOW_ATLAS_SIZE));
+    return(Result);
+}
+
+// NOTE(georgy): The same as FilterShadowMomentsHorizontal. Renders to the corner of the blur texture, texel (X, Y) is
+// (X, Y) of the tile.
+float4 HorizontalPS(vs_output Input) : SV_TARGET
+{
+    int3 Tile = GetCascadeTile();
+    int2 Texel = (int2)Input.Pos.xy;
+
+    float4 Sum = float4(0.0, 0.0, 0.0, 0.0);
+    float WeightSum = 0.0;
+    [unroll]
+    for(int Tap = -SHADOW_MOMENTS_BLUR_RADIUS; Tap <= SHADOW_MOMENTS_BLUR_RADIUS; Tap++)
+    {
+        int TapX = clamp(Texel.x + Tap, 0, Tile.z - 1);
+        float Weight = exp(-(float)(Tap*Tap) / (2.0*SHADOW_MOMENTS_BLUR_SIGMA*SHADOW_MOMENTS_BLUR_SIGMA));
+        Sum += Weight*EncodeShadowMoments(Texture.Load(int3(Tile.xy + int2(TapX, Texel.y), 0)).r);
+        WeightSum += Weight;
+    }
+
+    return(Sum / WeightSum);
+}
+
+// NOTE(georgy): The same as FilterShadowMomentsVertical. Renders to the cascade's tile of the moments atlas.
+float4 VerticalPS(vs_output Input) : SV_TARGET
+{
+    int3 Tile = GetCascadeTile();
+    int2 Texel = (int2)Input.Pos.xy - Tile.xy;
+
+    float4 Sum = float4(0.0, 0.0, 0.0, 0.0);
+    float WeightSum = 0.0;
+    [unroll]
+    for(int Tap = -SHADOW_MOMENTS_BLUR_RADIUS; Tap <= SHADOW_MOMENTS_BLUR_RADIUS; Tap++)
+    {
+        int TapY = clamp(Texel.y + Tap, 0, Tile.z - 1);
+        float Weight = exp(-(float)(Tap*Tap) / (2.0*SHADOW_MOMENTS_BLUR_SIGMA*SHADOW_MOMENTS_BLUR_SIGMA));
+        Sum += Weight*Texture.Load(int3(Texel.x, TapY, 0));
+        WeightSum += Weight;
+    }
+
+    return(Sum / WeightSum);
+}
@@ -0,0 +1,114 @@
+// NOTE(georgy): Has to match SHADOW_CASCADE_COUNT
+#define SHADOW_CASCADE_COUNT 4
+
+// NOTE(georgy): Has to match RENDERER_RSM_DOWNSAMPLE
+#define RSM_DOWNSAMPLE 2
+
+// NOTE(georgy): Have to match temporal_accumulation.hpp
+#define TEMPORAL_BLEND_FACTOR 0.1
+#define TEMPORAL_DEPTH_TOLERANCE 0.05
+#define TEMPORAL_MIN_HISTORY_WEIGHT 0.01
+
+Texture2D RSMIndirectIllumTexture : register(t0);
+Texture2D RSMHistoryTexture : register(t1);
+Texture2D LinearDepthTexture : register(t2);
+
+cbuffer frame_constants : register(b0)
+{
+    float4x4 CameraProjection;
+    float4x4 CameraView;
+    float4x4 LightProjection;
+    float4x4 LightView;
+    float4 WorldVectorsToFarCorners[4]; // NOTE(georgy): W of these vectors contain FarPlane distance
+    float4 CameraWorldPos;
+
+    float4x4 ViewToPrevClip;
+    float2 RSMFrameRotation;
+    float HistoryValid;
+    float Pad;
+
+    float4x4 CascadeViewProjections[SHADOW_CASCADE_COUNT];
+    float4 CascadeSplits; // NOTE(georgy): View space Z each cascade ends at
+    float4 CascadeBiases;
+
+    float4 CascadeAtlasRects[SHADOW_CASCADE_COUNT]; // NOTE(georgy): UV of the tile's corner in XY, its size in Z
+    float4 RSMAtlasRect;
+};
+
+struct vs_output
+{
+    float4 Pos : SV_POSITION;
+    float2 TexCoords : TEXCOORD;
+};
+
+// NOTE(georgy): The same as ResolveTemporalTexel. History keeps the linear depth of its texels in W.
+float4 PS(vs_output Input) : SV_TARGET
+{
+    int2 Texel = (int2)Input.Pos.xy;
+    int3 Pixel = int3(RSM_DOWNSAMPLE*Texel, 0);
+    float LinearDepth = LinearDepthTexture.Load(Pixel).r;
+    float3 Color = RSMIndirectIllumTexture.Load(int3(Texel, 0)).xyz;
+
+    float3 Result = Color;
+    if(HistoryValid > 0.0)
+    {
+        float Width, Height;
+        LinearDepthTexture.GetDimensions(Width, Height);
+        float LowWidth, LowHeight;
+        RSMHistoryTexture.GetDimensions(LowWidth, LowHeight);
+        float2 UV = (Pixel.xy + 0.5) / float2(Width, Height);
+
+        float3 CameraVec = lerp(lerp(WorldVectorsToFarCorners[0].xyz, WorldVectorsToFarCorners[2].xyz, UV.x),
+                                lerp(WorldVectorsToFarCorners[1].xyz, WorldVectorsToFarCorners[3].xyz, UV.x), UV.y);
+        float4 PrevClip = mul(float4(LinearDepth*CameraVec, 1.0), ViewToPrevClip);
+        float2 PrevUV = float2(0.5, -0.5)*PrevClip.xy / PrevClip.w + float2(0.5, 0.5);
+        float PrevLinearDepth = PrevClip.w / WorldVectorsToFarCorners[0].w;
+
+        float2 HistoryP = (PrevUV*float2(Width, Height) - 0.5) / RSM_DOWNSAMPLE;
+        int2 Base = (int2)floor(HistoryP);
+        float2 Fraction = HistoryP - Base;
+
+        float3 HistoryColor = float3(0.0, 0.0, 0.0);
+        float WeightSum = 0.0;
+        for(int TapY = 0; TapY < 2; TapY++)
+        {
+            for(int TapX = 0; TapX < 2; TapX++)
+            {
+                int2 HistoryTexel = Base + int2(TapX, TapY);
+                if(all(HistoryTexel >= 0) && (HistoryTexel.x < (int)LowWidth) && (HistoryTexel.y < (int)LowHeight))
+                {
+                    float4 History = RSMHistoryTexture.Load(int3(HistoryTexel, 0));
+                    if(abs(History.w - PrevLinearDepth) < TEMPORAL_DEPTH_TOLERANCE*PrevLinearDepth)
+                    {
+                        float Weight = (TapX ? Fraction.x : 1.0 - Fraction.x) * (TapY ? Fraction.y : 1.0 - Fraction.y);
+                        HistoryColor += Weight*History.xyz;
+                        WeightSum += Weight;
+                    }
+                }
+            }
+        }
+
+        if(WeightSum > TEMPORAL_MIN_HISTORY_WEIGHT)
+        {
+            HistoryColor /= WeightSum;
+
+            int2 LowMax = int2(LowWidth, LowHeight) - 1;
+            float3 Min = Color;
+            float3 Max = Color;
+            for(int Y = -1; Y <= 1; Y++)
+            {
+                for(int X = -1; X <= 1; X++)
+                {
+                    float3 Neighbour = RSMIndirectIllumTexture.Load(int3(clamp(Texel + int2(X, Y), int2(0, 0), LowMax), 0)).xyz;
+                    Min = min(Min, Neighbour);
+                    Max = max(Max, Neighbour);
+                }
+            }
+            HistoryColor = clamp(HistoryColor, Min, Max);
+
+            Result = lerp(HistoryColor, Color, TEMPORAL_BLEND_FACTOR);
+        }
+    }
+
+    return(float4(Result, LinearDepth));
+}
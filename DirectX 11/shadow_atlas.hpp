@@ -0,0 +1,335 @@
+#pragma once
+
+#include "memory_arena.hpp"
+
+//
+// NOTE(georgy): Shadow atlas allocator. Square power of two tiles of a square power of two texture, as a quadtree:
+// every node is a free tile, a tile in use or split into its four quarters. A tile comes from the smallest free node
+// that fits, split down to the size that was asked for, and a freed tile merges back with its siblings once all four
+// are free. Power of two tiles never straddle quarters, so a fresh atlas fits any requests placed largest first
+// as long as their total area fits (linux_bench shadowatlas).
+//
+// Tiles belong to keys (a light and one of its cascades) and stay where they are from frame to frame. UpdateShadowAtlas
+// takes the frame's requests, frees the tiles of keys that are gone or want another size and places the new ones.
+// When the atlas is too full a request gets a smaller tile, down to SHADOW_ATLAS_MIN_TILE_SIZE, or none.
+//
+// Only the CPU knows about it, the renderer gets the rectangles.
+//
+
+#define SHADOW_ATLAS_MIN_TILE_SIZE 64
+#define SHADOW_ATLAS_MAX_LEVELS 8
+#define SHADOW_ATLAS_MAX_TILES 64
+#define SHADOW_ATLAS_NO_NODE 0xFFFFFFFF
+
+enum shadow_atlas_node_state
+{
+	ShadowAtlasNode_Free,
+	ShadowAtlasNode_Split,
+	ShadowAtlasNode_Used,
+};
+
+// NOTE(georgy): In texels. Size is 0 if there's no tile.
+struct shadow_atlas_rect
+{
+	uint32_t X, Y;
+	uint32_t Size;
+};
+
+struct shadow_atlas_request
+{
+	uint32_t Key;
+	uint32_t Size;
+};
+
+struct shadow_atlas_tile
+{
+	uint32_t Key;
+	uint32_t Wanted;
+
+	// NOTE(georgy): Level and index of the node inside it, Node is SHADOW_ATLAS_NO_NODE if the request didn't fit at all
+	uint32_t Level;
+	uint32_t Node;
+	shadow_atlas_rect Rect;
+};
+
+struct shadow_atlas
+{
+	uint32_t Size;
+
+	// NOTE(georgy): Level 0 is the whole atlas, level LevelCount - 1 has tiles of SHADOW_ATLAS_MIN_TILE_SIZE.
+	// Nodes of a level are in Morton order, node I's quarters are 4*I to 4*I + 3 of the next level.
+	uint32_t LevelCount;
+	uint8_t *Nodes;
+
+	uint32_t TileCount;
+	shadow_atlas_tile Tiles[SHADOW_ATLAS_MAX_TILES];
+
+	uint64_t PlacedCount;
+	uint64_t FreedCount;
+	uint64_t ReducedCount;
+	uint64_t FailedCount;
+};
+
+inline uint32_t
+ShadowAtlasKey(uint32_t Light, uint32_t Cascade)
+{
+	uint32_t Result = (Light << 8) | Cascade;
+	return(Result);
+}
+
+inline bool
+IsPowerOfTwo(uint32_t Value)
+{
+	bool Result = (Value != 0) && ((Value & (Value - 1)) == 0);
+	return(Result);
+}
+
+inline uint32_t
+GetShadowAtlasLevelFirstNode(uint32_t Level)
+{
+	uint32_t Result = ((1u << (2*Level)) - 1) / 3;
+	return(Result);
+}
+
+inline uint32_t
+GetShadowAtlasLevelSize(shadow_atlas *Atlas, uint32_t Level)
+{
+	uint32_t Result = Atlas->Size >> Level;
+	return(Result);
+}
+
+static void
+InitializeShadowAtlas(shadow_atlas *Atlas, memory_arena *Arena, uint32_t Size)
+{
+	Assert(IsPowerOfTwo(Size) && (Size >= SHADOW_ATLAS_MIN_TILE_SIZE));
+
+	*Atlas = {};
+	Atlas->Size = Size;
+	while((Size >> Atlas->LevelCount) >= SHADOW_ATLAS_MIN_TILE_SIZE)
+	{
+		Atlas->LevelCount++;
+	}
+	Assert(Atlas->LevelCount <= SHADOW_ATLAS_MAX_LEVELS);
+	Atlas->Nodes = PushArray(Arena, GetShadowAtlasLevelFirstNode(Atlas->LevelCount), uint8_t, true);
+}
+
+inline shadow_atlas_rect
+GetShadowAtlasNodeRect(shadow_atlas *Atlas, uint32_t Level, uint32_t Node)
+{
+	shadow_atlas_rect Result = {0, 0, GetShadowAtlasLevelSize(Atlas, Level)};
+	for(uint32_t Parent = 0; Parent < Level; Parent++)
+	{
+		uint32_t Quarter = (Node >> (2*(Level - 1 - Parent))) & 3;
+		uint32_t QuarterSize = GetShadowAtlasLevelSize(Atlas, Parent + 1);
+		Result.X += (Quarter & 1) ? QuarterSize : 0;
+		Result.Y += (Quarter & 2) ? QuarterSize : 0;
+	}
+	return(Result);
+}
+
+// NOTE(georgy): Takes the smallest free node at Level or above and splits it down to Level
+static uint32_t
+AllocateShadowAtlasNode(shadow_atlas *Atlas, uint32_t Level)
+{
+	uint32_t BestLevel = 0;
+	uint32_t BestNode = SHADOW_ATLAS_NO_NODE;
+
+	uint32_t StackLevels[4*SHADOW_ATLAS_MAX_LEVELS];
+	uint32_t StackNodes[4*SHADOW_ATLAS_MAX_LEVELS];
+	uint32_t StackCount = 0;
+	StackLevels[StackCount] = 0;
+	StackNodes[StackCount++] = 0;
+	while(StackCount > 0)
+	{
+		StackCount--;
+		uint32_t NodeLevel = StackLevels[StackCount];
+		uint32_t Node = StackNodes[StackCount];
+		uint8_t State = Atlas->Nodes[GetShadowAtlasLevelFirstNode(NodeLevel) + Node];
+		if(State == ShadowAtlasNode_Free)
+		{
+			if((BestNode == SHADOW_ATLAS_NO_NODE) || (NodeLevel > BestLevel))
+			{
+				BestLevel = NodeLevel;
+				BestNode = Node;
+				if(BestLevel == Level)
+				{
+					break;
+				}
+			}
+		}
+		else if((State == ShadowAtlasNode_Split) && (NodeLevel < Level))
+		{
+			for(uint32_t Quarter = 0; Quarter < 4; Quarter++)
+			{
+				StackLevels[StackCount] = NodeLevel + 1;
+				StackNodes[StackCount++] = 4*Node + (3 - Quarter);
+			}
+		}
+	}
+
+	if(BestNode != SHADOW_ATLAS_NO_NODE)
+	{
+		// NOTE(georgy): Whatever is under a free node is free, so the other quarters are ready to be used
+		while(BestLevel < Level)
+		{
+			Atlas->Nodes[GetShadowAtlasLevelFirstNode(BestLevel) + BestNode] = ShadowAtlasNode_Split;
+			BestLevel++;
+			BestNode = 4*BestNode;
+		}
+		Atlas->Nodes[GetShadowAtlasLevelFirstNode(BestLevel) + BestNode] = ShadowAtlasNode_Used;
+	}
+
+	return(BestNode);
+}
+
+static void
+FreeShadowAtlasNode(shadow_atlas *Atlas, uint32_t Level, uint32_t Node)
+{
+	Assert(Atlas->Nodes[GetShadowAtlasLevelFirstNode(Level) + Node] == ShadowAtlasNode_Used);
+
+	Atlas->Nodes[GetShadowAtlasLevelFirstNode(Level) + Node] = ShadowAtlasNode_Free;
+	while(Level > 0)
+	{
+		uint8_t *Quarters = Atlas->Nodes + GetShadowAtlasLevelFirstNode(Level) + (Node & ~3u);
+		if((Quarters[0] != ShadowAtlasNode_Free) || (Quarters[1] != ShadowAtlasNode_Free) ||
+		   (Quarters[2] != ShadowAtlasNode_Free) || (Quarters[3] != ShadowAtlasNode_Free))
+		{
+			break;
+		}
+
+		Level--;
+		Node /= 4;
+		Atlas->Nodes[GetShadowAtlasLevelFirstNode(Level) + Node] = ShadowAtlasNode_Free;
+	}
+}
+
+inline shadow_atlas_tile *
+FindShadowAtlasTile(shadow_atlas *Atlas, uint32_t Key)
+{
+	shadow_atlas_tile *Result = 0;
+	for(uint32_t TileIndex = 0; TileIndex < Atlas->TileCount; TileIndex++)
+	{
+		if(Atlas->Tiles[TileIndex].Key == Key)
+		{
+			Result = Atlas->Tiles + TileIndex;
+			break;
+		}
+	}
+	return(Result);
+}
+
+static void
+RemoveShadowAtlasTile(shadow_atlas *Atlas, uint32_t TileIndex)
+{
+	shadow_atlas_tile *Tile = Atlas->Tiles + TileIndex;
+	if(Tile->Node != SHADOW_ATLAS_NO_NODE)
+	{
+		FreeShadowAtlasNode(Atlas, Tile->Level, Tile->Node);
+		Atlas->FreedCount++;
+	}
+	*Tile = Atlas->Tiles[--Atlas->TileCount];
+}
+
+// NOTE(georgy): Wanted has to be a power of two. The tile is the biggest one up to that size that still fits.
+static void
+PlaceShadowAtlasTile(shadow_atlas *Atlas, uint32_t Key, uint32_t Wanted)
+{
+	Assert(IsPowerOfTwo(Wanted) && (Atlas->TileCount < SHADOW_ATLAS_MAX_TILES));
+
+	shadow_atlas_tile *Tile = Atlas->Tiles + Atlas->TileCount++;
+	Tile->Key = Key;
+	Tile->Wanted = Wanted;
+	Tile->Node = SHADOW_ATLAS_NO_NODE;
+	Tile->Rect = {0, 0, 0};
+
+	uint32_t Level = 0;
+	while((Level + 1 < Atlas->LevelCount) && (GetShadowAtlasLevelSize(Atlas, Level) > Wanted))
+	{
+		Level++;
+	}
+	for(; Level < Atlas->LevelCount; Level++)
+	{
+		Tile->Node = AllocateShadowAtlasNode(Atlas, Level);
+		if(Tile->Node != SHADOW_ATLAS_NO_NODE)
+		{
+			Tile->Level = Level;
+			Tile->Rect = GetShadowAtlasNodeRect(Atlas, Level, Tile->Node);
+			Atlas->PlacedCount++;
+			Atlas->ReducedCount += (Tile->Rect.Size < Wanted) ? 1 : 0;
+			break;
+		}
+	}
+	Atlas->FailedCount += (Tile->Node == SHADOW_ATLAS_NO_NODE) ? 1 : 0;
+}
+
+// NOTE(georgy): Rects get the tile of every request. Tiles that are kept don't move. If any tile was freed,
+// the ones that got less than they wanted are placed again, there may be room for them now.
+static void
+UpdateShadowAtlas(shadow_atlas *Atlas, shadow_atlas_request *Requests, uint32_t RequestCount, shadow_atlas_rect *Rects)
+{
+	Assert(RequestCount <= SHADOW_ATLAS_MAX_TILES);
+
+	bool Freed = false;
+	for(uint32_t TileIndex = Atlas->TileCount; TileIndex-- > 0;)
+	{
+		shadow_atlas_tile *Tile = Atlas->Tiles + TileIndex;
+		bool Keep = false;
+		for(uint32_t Request = 0; Request < RequestCount; Request++)
+		{
+			if(Requests[Request].Key == Tile->Key)
+			{
+				Keep = (Requests[Request].Size == Tile->Wanted);
+				break;
+			}
+		}
+		if(!Keep)
+		{
+			Freed = Freed || (Tile->Node != SHADOW_ATLAS_NO_NODE);
+			RemoveShadowAtlasTile(Atlas, TileIndex);
+		}
+	}
+	if(Freed)
+	{
+		for(uint32_t TileIndex = Atlas->TileCount; TileIndex-- > 0;)
+		{
+			if(Atlas->Tiles[TileIndex].Rect.Size < Atlas->Tiles[TileIndex].Wanted)
+			{
+				RemoveShadowAtlasTile(Atlas, TileIndex);
+			}
+		}
+	}
+
+	// NOTE(georgy): New tiles largest first, a smaller tile can't take a quarter a bigger one needed
+	uint32_t Order[SHADOW_ATLAS_MAX_TILES];
+	uint32_t NewCount = 0;
+	for(uint32_t Request = 0; Request < RequestCount; Request++)
+	{
+		if(!FindShadowAtlasTile(Atlas, Requests[Request].Key))
+		{
+			uint32_t Insert = NewCount++;
+			while((Insert > 0) && (Requests[Order[Insert - 1]].Size < Requests[Request].Size))
+			{
+				Order[Insert] = Order[Insert - 1];
+				Insert--;
+			}
+			Order[Insert] = Request;
+		}
+	}
+	for(uint32_t New = 0; New < NewCount; New++)
+	{
+		PlaceShadowAtlasTile(Atlas, Requests[Order[New]].Key, Requests[Order[New]].Size);
+	}
+
+	for(uint32_t Request = 0; Request < RequestCount; Request++)
+	{
+		Rects[Request] = FindShadowAtlasTile(Atlas, Requests[Request].Key)->Rect;
+	}
+}
+
+// NOTE(georgy): Corner and size of the tile in UV of the atlas, how the shaders find a tile
+inline v4
+GetShadowAtlasUVRect(shadow_atlas_rect Rect, uint32_t AtlasSize)
+{
+	v4 Result = V4((real32)Rect.X / AtlasSize, (real32)Rect.Y / AtlasSize, (real32)Rect.Size / AtlasSize, 0.0f);
+	return(Result);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "shadow_atlas.hpp"
+
+//
+// NOTE(georgy): Light map caching. The sun and most of the casters don't move, so most frames a light view would
+// render exactly what its tile already has. Every light map has a static layer, a texture with the same layout that
+// only has the static casters in it. Every frame a light view's tile is
+//  - left alone if the view and its tile are the same as last frame, no static caster moved inside the view
+//    and it has no dynamic casters, now or last frame (those have to be erased),
+//  - otherwise the static layer is copied over the tile and the dynamic casters are drawn on top,
+//  - and before that the static layer is rendered again if the view or its tile changed or a static caster moved inside.
+// Only the game knows what moved, it tells the renderer per view (render_view::StaticCastersMoved). A moved caster
+// counts where it was and where it is now.
+//
+
+enum shadow_cache_action
+{
+	ShadowCache_Reuse,
+	ShadowCache_Composite,
+	ShadowCache_Rebuild,
+
+	ShadowCache_Count
+};
+
+// NOTE(georgy): What the tile of a view has in it, one per view of the packet
+struct shadow_cache_view
+{
+	bool Valid;
+	mat4 ViewProjection;
+	shadow_atlas_rect Tile;
+	bool HasDynamic;
+
+	// NOTE(georgy): What the last update decided
+	shadow_cache_action Action;
+};
+
+inline void
+InvalidateShadowCacheView(shadow_cache_view *Cache)
+{
+	Cache->Valid = false;
+	Cache->HasDynamic = false;
+}
+
+static shadow_cache_action
+UpdateShadowCacheView(shadow_cache_view *Cache, mat4 ViewProjection, shadow_atlas_rect Tile, bool StaticCastersMoved, bool HasDynamic)
+{
+	bool SameView = Cache->Valid && (memcmp(&Cache->ViewProjection, &ViewProjection, sizeof(mat4)) == 0) &&
+					(Cache->Tile.X == Tile.X) && (Cache->Tile.Y == Tile.Y) && (Cache->Tile.Size == Tile.Size);
+
+	shadow_cache_action Result = ShadowCache_Rebuild;
+	if(SameView && !StaticCastersMoved)
+	{
+		Result = (HasDynamic || Cache->HasDynamic) ? ShadowCache_Composite : ShadowCache_Reuse;
+	}
+
+	Cache->Valid = true;
+	Cache->ViewProjection = ViewProjection;
+	Cache->Tile = Tile;
+	Cache->HasDynamic = HasDynamic;
+	Cache->Action = Result;
+	return(Result);
+}
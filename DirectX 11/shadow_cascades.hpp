@@ -0,0 +1,226 @@
+#pragma once
+
+#include "aabb.hpp"
+#include "shadow_atlas.hpp"
+
+//
+// NOTE(georgy): Cascaded shadow maps for the sun, GBufferPS.hlsl picks the cascade and finds it in the atlas exactly like this.
+//
+// The camera frustum, up to the shadow distance, is cut into slices at distances between logarithmic splits (the same
+// texels per screen pixel at every distance) and uniform ones (which don't spend a whole cascade on the first few
+// centimeters after the near plane), blended by Lambda. Every cascade is an orthographic projection along the light
+// fitted to the light space bounds of its slice's corners. The corners are the view space far corners of the frustum
+// (FrustumFarCornersWorldSpace) scaled down to the slice's near and far distance.
+//
+// The fit follows the camera, so its bounds are snapped to whole texels of the cascade: a world position stays at the
+// same spot inside its texel from frame to frame, and shadow edges don't crawl when the camera moves. The size is
+// rounded up too, so it only changes when the slice's footprint really does (the camera turns), not from float noise.
+//
+// Every cascade is a tile of the shadow atlas (shadow_atlas.hpp). Its size is picked so the cascade's texels are about
+// as big as the screen's pixels in the middle of its slice.
+//
+
+// NOTE(georgy): Has to match SHADOW_CASCADE_COUNT in GBufferPS.hlsl and ShadowCascadeVS.hlsl. The splits go to the GPU as a v4.
+#define SHADOW_CASCADE_COUNT 4
+#define SHADOW_CASCADE_MIN_SIZE 128
+#define SHADOW_CASCADE_MAX_SIZE 1024
+// NOTE(georgy): 0 is uniform splits, 1 logarithmic
+#define SHADOW_CASCADE_SPLIT_LAMBDA 0.75f
+// NOTE(georgy): In texels of the cascade, so the bias is about the same on screen in every cascade
+#define SHADOW_CASCADE_BIAS_TEXELS 2.0f
+// NOTE(georgy): Sizes are rounded up to a multiple of 1/2^SHADOW_CASCADE_SIZE_STEPS of their power of two
+#define SHADOW_CASCADE_SIZE_STEPS 5
+// NOTE(georgy): The near plane is pulled back to a multiple of this (world units)
+#define SHADOW_CASCADE_NEAR_STEP 1.0f
+
+struct shadow_cascade
+{
+	// NOTE(georgy): Applied after the light's view
+	mat4 Projection;
+
+	// NOTE(georgy): View space Z range of the camera the cascade covers
+	real32 SplitNear, SplitFar;
+
+	// NOTE(georgy): World units per texel, and the depth bias in the projection's depth (0 to 1)
+	real32 TexelSize;
+	real32 DepthBias;
+
+	shadow_atlas_rect Tile;
+};
+
+struct shadow_cascades
+{
+	mat4 LightView;
+	uint32_t AtlasSize;
+	shadow_cascade Cascades[SHADOW_CASCADE_COUNT];
+};
+
+// NOTE(georgy): Same layout as the shadow_cascade_constants cbuffer, one per cascade
+struct shadow_cascade_constants
+{
+	uint32_t Index;
+	uint32_t Pad[3];
+};
+
+// NOTE(georgy): Splits[0] is Near and Splits[CascadeCount] is Far, cascade I covers Splits[I] to Splits[I + 1]
+static void
+GetShadowCascadeSplits(real32 Near, real32 Far, uint32_t CascadeCount, real32 Lambda, real32 *Splits)
+{
+	Assert((Near > 0.0f) && (Far > Near));
+
+	for(uint32_t Split = 0; Split <= CascadeCount; Split++)
+	{
+		real32 T = (real32)Split / CascadeCount;
+		real32 Logarithmic = Near*powf(Far / Near, T);
+		real32 Uniform = Near + (Far - Near)*T;
+		Splits[Split] = Lambda*Logarithmic + (1.0f - Lambda)*Uniform;
+	}
+
+	// NOTE(georgy): Exactly, powf doesn't have to give them back
+	Splits[0] = Near;
+	Splits[CascadeCount] = Far;
+}
+
+// NOTE(georgy): FarCorners are in view space with the far distance in W, like FrustumFarCornersWorldSpace.
+// Corners 0-3 end up on the slice's near plane and 4-7 on its far plane, in world space.
+static void
+GetFrustumSliceCorners(v4 *FarCorners, mat4 CameraView, real32 SliceNear, real32 SliceFar, v3 *Corners)
+{
+	mat4 ViewToWorld = InverseAffine(CameraView);
+	for(uint32_t Corner = 0; Corner < 4; Corner++)
+	{
+		v3 FarCorner = FarCorners[Corner].xyz;
+		real32 FarDistance = FarCorners[Corner].w;
+		Corners[Corner] = (V4((SliceNear / FarDistance)*FarCorner, 1.0f) * ViewToWorld).xyz;
+		Corners[Corner + 4] = (V4((SliceFar / FarDistance)*FarCorner, 1.0f) * ViewToWorld).xyz;
+	}
+}
+
+// NOTE(georgy): Resolution that makes a cascade's texels about as big as a screen pixel at the slice's middle distance
+// (by ratio, the slices are about logarithmic). It goes by the slice's diameter, which doesn't change when the camera
+// turns, so the resolution only changes with the screen and the splits. PixelAngle is a screen pixel's size at distance 1.
+static void
+GetShadowCascadeResolutions(v4 *FarCorners, real32 Near, real32 ShadowDistance, real32 PixelAngle, uint32_t *Resolutions)
+{
+	real32 Splits[SHADOW_CASCADE_COUNT + 1];
+	GetShadowCascadeSplits(Near, ShadowDistance, SHADOW_CASCADE_COUNT, SHADOW_CASCADE_SPLIT_LAMBDA, Splits);
+	for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+	{
+		v3 Corners[8];
+		GetFrustumSliceCorners(FarCorners, Identity(), Splits[Cascade], Splits[Cascade + 1], Corners);
+		real32 Diameter = 0.0f;
+		for(uint32_t A = 0; A < 8; A++)
+		{
+			for(uint32_t B = A + 1; B < 8; B++)
+			{
+				Diameter = fmaxf(Diameter, Length(Corners[A] - Corners[B]));
+			}
+		}
+
+		real32 PixelSize = sqrtf(Splits[Cascade]*Splits[Cascade + 1])*PixelAngle;
+		real32 Resolution = exp2f(roundf(log2f(Diameter / PixelSize)));
+		Resolution = fminf(fmaxf(Resolution, (real32)SHADOW_CASCADE_MIN_SIZE), (real32)SHADOW_CASCADE_MAX_SIZE);
+		Resolutions[Cascade] = (uint32_t)Resolution;
+	}
+}
+
+inline real32
+QuantizeShadowCascadeSize(real32 Size)
+{
+	real32 Step = exp2f(ceilf(log2f(Size)) - SHADOW_CASCADE_SIZE_STEPS);
+	real32 Result = ceilf(Size / Step)*Step;
+	return(Result);
+}
+
+// NOTE(georgy): Corners are the slice's 8 world space corners. Everything that casts a shadow into the slice has to be
+// in the depth range too, even when it's far outside of the slice towards the light, so the near plane is pulled back
+// to CasterBounds (world space, around all casters), in whole steps: the bounds change whenever a caster moves, the
+// cascade shouldn't (its tile would have to be drawn again, shadow_cache.hpp). Resolution is the cascade's size in texels.
+static shadow_cascade
+FitShadowCascade(v3 *Corners, mat4 LightView, aabb CasterBounds, uint32_t Resolution)
+{
+	v3 Min = V3(FLT_MAX, FLT_MAX, FLT_MAX);
+	v3 Max = V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for(uint32_t Corner = 0; Corner < 8; Corner++)
+	{
+		v3 P = (V4(Corners[Corner], 1.0f) * LightView).xyz;
+		Min = V3(fminf(Min.x, P.x), fminf(Min.y, P.y), fminf(Min.z, P.z));
+		Max = V3(fmaxf(Max.x, P.x), fmaxf(Max.y, P.y), fmaxf(Max.z, P.z));
+	}
+
+	real32 Near = Min.z;
+	for(uint32_t Corner = 0; Corner < 8; Corner++)
+	{
+		v3 P = V3((Corner & 1) ? CasterBounds.Max.x : CasterBounds.Min.x,
+				  (Corner & 2) ? CasterBounds.Max.y : CasterBounds.Min.y,
+				  (Corner & 4) ? CasterBounds.Max.z : CasterBounds.Min.z);
+		Near = fminf(Near, (V4(P, 1.0f) * LightView).z);
+	}
+	Near = floorf(Near / SHADOW_CASCADE_NEAR_STEP)*SHADOW_CASCADE_NEAR_STEP;
+	real32 Far = Max.z;
+
+	// NOTE(georgy): Square texels. One texel of the resolution is left for snapping: the snapped bounds start
+	// less than a texel before Min, so they still end after Max.
+	real32 Size = QuantizeShadowCascadeSize(fmaxf(Max.x - Min.x, Max.y - Min.y));
+	real32 TexelSize = Size / (Resolution - 1);
+	real32 Left = floorf(Min.x / TexelSize)*TexelSize;
+	real32 Bottom = floorf(Min.y / TexelSize)*TexelSize;
+	real32 Width = TexelSize*Resolution;
+
+	shadow_cascade Result;
+	Result.Projection = Orthographic(Left, Left + Width, Bottom, Bottom + Width, Near, Far);
+	Result.SplitNear = 0.0f;
+	Result.SplitFar = 0.0f;
+	Result.TexelSize = TexelSize;
+	Result.DepthBias = SHADOW_CASCADE_BIAS_TEXELS*TexelSize / (Far - Near);
+	return(Result);
+}
+
+// NOTE(georgy): FarCorners are the camera's view space far corners, Near and ShadowDistance the range that gets shadows.
+// Tiles are where the cascades got in the atlas, every one has to have some.
+static void
+BuildShadowCascades(shadow_cascades *Cascades, v4 *FarCorners, mat4 CameraView, real32 Near, real32 ShadowDistance,
+					mat4 LightView, aabb CasterBounds, shadow_atlas_rect *Tiles, uint32_t AtlasSize)
+{
+	real32 Splits[SHADOW_CASCADE_COUNT + 1];
+	GetShadowCascadeSplits(Near, ShadowDistance, SHADOW_CASCADE_COUNT, SHADOW_CASCADE_SPLIT_LAMBDA, Splits);
+
+	Cascades->LightView = LightView;
+	Cascades->AtlasSize = AtlasSize;
+	for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+	{
+		Assert(Tiles[Cascade].Size > 1);
+
+		v3 Corners[8];
+		GetFrustumSliceCorners(FarCorners, CameraView, Splits[Cascade], Splits[Cascade + 1], Corners);
+		Cascades->Cascades[Cascade] = FitShadowCascade(Corners, LightView, CasterBounds, Tiles[Cascade].Size);
+		Cascades->Cascades[Cascade].SplitNear = Splits[Cascade];
+		Cascades->Cascades[Cascade].SplitFar = Splits[Cascade + 1];
+		Cascades->Cascades[Cascade].Tile = Tiles[Cascade];
+	}
+}
+
+// NOTE(georgy): First cascade that reaches past ViewZ, SHADOW_CASCADE_COUNT if none does (no shadow there)
+inline uint32_t
+GetShadowCascadeIndex(shadow_cascades *Cascades, real32 ViewZ)
+{
+	uint32_t Result = 0;
+	for(uint32_t Cascade = 0; Cascade < SHADOW_CASCADE_COUNT; Cascade++)
+	{
+		Result += (ViewZ > Cascades->Cascades[Cascade].SplitFar) ? 1 : 0;
+	}
+	return(Result);
+}
+
+// NOTE(georgy): Where a world position lands in the atlas, UV over the whole atlas in XY and the projection's depth in Z
+inline v3
+GetShadowCascadeAtlasPos(shadow_cascades *Cascades, uint32_t Cascade, v3 WorldPos)
+{
+	v4 Clip = V4(WorldPos, 1.0f) * Cascades->LightView * Cascades->Cascades[Cascade].Projection;
+	real32 U = 0.5f*Clip.x + 0.5f;
+	real32 V = -0.5f*Clip.y + 0.5f;
+
+	v4 Rect = GetShadowAtlasUVRect(Cascades->Cascades[Cascade].Tile, Cascades->AtlasSize);
+	v3 Result = V3(Rect.x + U*Rect.z, Rect.y + V*Rect.z, Clip.z);
+	return(Result);
+}
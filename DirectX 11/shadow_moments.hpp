@@ -0,0 +1,206 @@
+#pragma once
+
+#include "shadow_cascades.hpp"
+
+//
+// NOTE(georgy): Prefiltered shadow cascades, exponential variance shadow maps (EVSM). ShadowMomentsPS.hlsl filters the
+// atlas and GBufferPS.hlsl (MomentsPS) looks it up exactly like this.
+//
+// A depth compare can't be filtered, the average of the tests has to be taken after the test (PCF, one fetch per tap).
+// Moments can: every texel keeps E[x] and E[x^2] of its depth warped by exp(c*x) (and of -exp(-c*x), which catches
+// what the positive warp lets through), those get blurred, mipmapped and bilinearly filtered like any color, and
+// Chebyshev's inequality turns the filtered moments into an upper bound of the lit fraction. The warp makes the bound
+// tight where the occluder is far from the receiver (where plain variance shadow maps bleed light).
+//
+// Every cascade whose tile changed (shadow_cache.hpp) is turned into moments and blurred, once horizontally and once
+// vertically into the moments atlas, then the atlas gets its mips. Tiles are aligned to their size (shadow_atlas.hpp),
+// so every mip of a tile is made from the tile only, down to one texel. The lookup picks the mip from how many texels
+// the pixel covers and clamps the position half a texel of that mip inside the tile, so nothing of the neighbours gets in.
+//
+
+// NOTE(georgy): exp(40) squared still fits in a float, these need the 32 bit moments
+#define SHADOW_MOMENTS_POSITIVE_EXPONENT 40.0f
+#define SHADOW_MOMENTS_NEGATIVE_EXPONENT 5.0f
+#define SHADOW_MOMENTS_BLUR_RADIUS 2
+#define SHADOW_MOMENTS_BLUR_SIGMA 1.0f
+// NOTE(georgy): Smallest variance, relative to the warped depth. Keeps flat receivers from shadowing themselves.
+#define SHADOW_MOMENTS_VARIANCE_BIAS 0.0001f
+// NOTE(georgy): Bounds below this are cut to 0 and the rest stretched, where two occluders overlap light leaks less
+#define SHADOW_MOMENTS_LIGHT_BLEEDING 0.1f
+// NOTE(georgy): Down to one texel of the smallest cascade
+#define SHADOW_MOMENTS_MIP_COUNT 8
+static_assert((SHADOW_CASCADE_MIN_SIZE >> (SHADOW_MOMENTS_MIP_COUNT - 1)) == 1, "The last mip has to be one texel of the smallest cascade");
+
+// NOTE(georgy): Depth is the projection's, 0 to 1. X is the positive warp, Y the negative one.
+inline v2
+WarpShadowDepth(real32 Depth)
+{
+	real32 Centered = 2.0f*Depth - 1.0f;
+	v2 Result = V2(expf(SHADOW_MOMENTS_POSITIVE_EXPONENT*Centered), -expf(-SHADOW_MOMENTS_NEGATIVE_EXPONENT*Centered));
+	return(Result);
+}
+
+inline v4
+EncodeShadowMoments(real32 Depth)
+{
+	v2 Warped = WarpShadowDepth(Depth);
+	v4 Result = V4(Warped.x, Warped.x*Warped.x, Warped.y, Warped.y*Warped.y);
+	return(Result);
+}
+
+// NOTE(georgy): Upper bound of the fraction of the filter area that isn't in front of T
+inline real32
+GetChebyshevUpperBound(real32 Mean, real32 MeanSquared, real32 T, real32 MinVariance)
+{
+	real32 Result = 1.0f;
+	if(T > Mean)
+	{
+		real32 Variance = fmaxf(MeanSquared - Mean*Mean, MinVariance);
+		real32 Difference = T - Mean;
+		Result = Variance / (Variance + Difference*Difference);
+	}
+	return(Result);
+}
+
+inline real32
+ReduceShadowLightBleeding(real32 Visibility)
+{
+	real32 Result = (Visibility - SHADOW_MOMENTS_LIGHT_BLEEDING) / (1.0f - SHADOW_MOMENTS_LIGHT_BLEEDING);
+	Result = fminf(fmaxf(Result, 0.0f), 1.0f);
+	return(Result);
+}
+
+// NOTE(georgy): Moments are filtered ones, Depth is the receiver's
+inline real32
+GetShadowMomentsVisibility(v4 Moments, real32 Depth)
+{
+	v2 Warped = WarpShadowDepth(fminf(fmaxf(Depth, 0.0f), 1.0f));
+	real32 PositiveBias = SHADOW_MOMENTS_VARIANCE_BIAS*SHADOW_MOMENTS_POSITIVE_EXPONENT*Warped.x;
+	real32 NegativeBias = SHADOW_MOMENTS_VARIANCE_BIAS*SHADOW_MOMENTS_NEGATIVE_EXPONENT*Warped.y;
+
+	real32 Positive = GetChebyshevUpperBound(Moments.x, Moments.y, Warped.x, PositiveBias*PositiveBias);
+	real32 Negative = GetChebyshevUpperBound(Moments.z, Moments.w, Warped.y, NegativeBias*NegativeBias);
+
+	real32 Result = ReduceShadowLightBleeding(fminf(Positive, Negative));
+	return(Result);
+}
+
+inline real32
+GetShadowMomentsBlurWeight(int32_t Tap)
+{
+	real32 Result = expf(-(real32)(Tap*Tap) / (2.0f*SHADOW_MOMENTS_BLUR_SIGMA*SHADOW_MOMENTS_BLUR_SIGMA));
+	return(Result);
+}
+
+// NOTE(georgy): HorizontalPS, from the depths of a Size x Size tile. Taps past the tile's edges repeat the edge.
+static void
+FilterShadowMomentsHorizontal(v4 *Dest, real32 *Depths, uint32_t Size)
+{
+	for(int32_t Y = 0; Y < (int32_t)Size; Y++)
+	{
+		for(int32_t X = 0; X < (int32_t)Size; X++)
+		{
+			v4 Sum = V4(0.0f, 0.0f, 0.0f, 0.0f);
+			real32 WeightSum = 0.0f;
+			for(int32_t Tap = -SHADOW_MOMENTS_BLUR_RADIUS; Tap <= SHADOW_MOMENTS_BLUR_RADIUS; Tap++)
+			{
+				int32_t TapX = X + Tap;
+				TapX = (TapX < 0) ? 0 : ((TapX >= (int32_t)Size) ? (int32_t)Size - 1 : TapX);
+
+				real32 Weight = GetShadowMomentsBlurWeight(Tap);
+				Sum += Weight*EncodeShadowMoments(Depths[Y*Size + TapX]);
+				WeightSum += Weight;
+			}
+
+			Dest[Y*Size + X] = (1.0f / WeightSum)*Sum;
+		}
+	}
+}
+
+// NOTE(georgy): VerticalPS, from what the horizontal one gave
+static void
+FilterShadowMomentsVertical(v4 *Dest, v4 *Source, uint32_t Size)
+{
+	for(int32_t Y = 0; Y < (int32_t)Size; Y++)
+	{
+		for(int32_t X = 0; X < (int32_t)Size; X++)
+		{
+			v4 Sum = V4(0.0f, 0.0f, 0.0f, 0.0f);
+			real32 WeightSum = 0.0f;
+			for(int32_t Tap = -SHADOW_MOMENTS_BLUR_RADIUS; Tap <= SHADOW_MOMENTS_BLUR_RADIUS; Tap++)
+			{
+				int32_t TapY = Y + Tap;
+				TapY = (TapY < 0) ? 0 : ((TapY >= (int32_t)Size) ? (int32_t)Size - 1 : TapY);
+
+				real32 Weight = GetShadowMomentsBlurWeight(Tap);
+				Sum += Weight*Source[TapY*Size + X];
+				WeightSum += Weight;
+			}
+
+			Dest[Y*Size + X] = (1.0f / WeightSum)*Sum;
+		}
+	}
+}
+
+// NOTE(georgy): Both directions, Temp is the tile after the horizontal one
+inline void
+FilterShadowMoments(v4 *Dest, v4 *Temp, real32 *Depths, uint32_t Size)
+{
+	FilterShadowMomentsHorizontal(Temp, Depths, Size);
+	FilterShadowMomentsVertical(Dest, Temp, Size);
+}
+
+// NOTE(georgy): What GenerateMips does to a power of two texture, a 2x2 box. Size is the source's.
+static void
+DownsampleShadowMoments(v4 *Dest, v4 *Source, uint32_t Size)
+{
+	uint32_t HalfSize = Size / 2;
+	for(uint32_t Y = 0; Y < HalfSize; Y++)
+	{
+		for(uint32_t X = 0; X < HalfSize; X++)
+		{
+			v4 *Row = Source + 2*Y*Size + 2*X;
+			Dest[Y*HalfSize + X] = 0.25f*(Row[0] + Row[1] + Row[Size] + Row[Size + 1]);
+		}
+	}
+}
+
+// NOTE(georgy): Mip of the lookup, TexelsPerPixel is how many texels of the first mip one pixel covers
+inline real32
+GetShadowMomentsLod(real32 TexelsPerPixel)
+{
+	real32 Result = log2f(fmaxf(TexelsPerPixel, 1.0f));
+	Result = fminf(Result, (real32)(SHADOW_MOMENTS_MIP_COUNT - 1));
+	return(Result);
+}
+
+// NOTE(georgy): Bilinear inside one mip of a tile, U and V 0 to 1 across the tile
+static v4
+SampleShadowMomentsMip(v4 *Mip, uint32_t Size, real32 U, real32 V)
+{
+	real32 X = fminf(fmaxf(U*Size - 0.5f, 0.0f), (real32)(Size - 1));
+	real32 Y = fminf(fmaxf(V*Size - 0.5f, 0.0f), (real32)(Size - 1));
+	uint32_t X0 = (uint32_t)X, Y0 = (uint32_t)Y;
+	uint32_t X1 = (X0 + 1 < Size) ? X0 + 1 : X0;
+	uint32_t Y1 = (Y0 + 1 < Size) ? Y0 + 1 : Y0;
+	real32 FractionX = X - X0, FractionY = Y - Y0;
+
+	v4 Top = (1.0f - FractionX)*Mip[Y0*Size + X0] + FractionX*Mip[Y0*Size + X1];
+	v4 Bottom = (1.0f - FractionX)*Mip[Y1*Size + X0] + FractionX*Mip[Y1*Size + X1];
+	v4 Result = (1.0f - FractionY)*Top + FractionY*Bottom;
+	return(Result);
+}
+
+// NOTE(georgy): Trilinear, Mips[0] is Size x Size and every next one half of the one before
+static v4
+SampleShadowMoments(v4 **Mips, uint32_t Size, real32 U, real32 V, real32 Lod)
+{
+	uint32_t Mip = (uint32_t)Lod;
+	real32 Fraction = Lod - Mip;
+	v4 Result = SampleShadowMomentsMip(Mips[Mip], Size >> Mip, U, V);
+	if((Fraction > 0.0f) && (Mip + 1 < SHADOW_MOMENTS_MIP_COUNT))
+	{
+		Result = (1.0f - Fraction)*Result + Fraction*SampleShadowMomentsMip(Mips[Mip + 1], Size >> (Mip + 1), U, V);
+	}
+	return(Result);
+}
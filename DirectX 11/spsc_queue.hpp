@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+//
+// NOTE(georgy): Lock-free single-producer/single-consumer ring buffer.
+// Entries are written and read in place: the producer gets a slot with BeginPush, fills it
+// and publishes it with EndPush; the consumer does the same with BeginPop/EndPop.
+// The producer can never get more than Capacity entries ahead of the consumer,
+// so the capacity is also the maximum latency between the two threads.
+//
+
+template <typename type, uint32_t Capacity>
+struct spsc_queue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "spsc_queue capacity must be a power of 2");
+
+	type Entries[Capacity];
+
+	// NOTE(georgy): Separate cache lines, so the threads don't invalidate each other's index every push/pop
+	std::atomic<uint32_t> ReadIndex;
+	uint8_t Pad0[64 - sizeof(std::atomic<uint32_t>)];
+	std::atomic<uint32_t> WriteIndex;
+	uint8_t Pad1[64 - sizeof(std::atomic<uint32_t>)];
+};
+
+template <typename type, uint32_t Capacity> inline void
+InitializeQueue(spsc_queue<type, Capacity> *Queue)
+{
+	Queue->ReadIndex.store(0, std::memory_order_relaxed);
+	Queue->WriteIndex.store(0, std::memory_order_relaxed);
+}
+
+// NOTE(georgy): Returns 0 if the queue is full
+template <typename type, uint32_t Capacity> inline type *
+BeginPush(spsc_queue<type, Capacity> *Queue)
+{
+	type *Result = 0;
+
+	uint32_t WriteIndex = Queue->WriteIndex.load(std::memory_order_relaxed);
+	uint32_t ReadIndex = Queue->ReadIndex.load(std::memory_order_acquire);
+	if((WriteIndex - ReadIndex) < Capacity)
+	{
+		Result = Queue->Entries + (WriteIndex & (Capacity - 1));
+	}
+
+	return(Result);
+}
+
+template <typename type, uint32_t Capacity> inline void
+EndPush(spsc_queue<type, Capacity> *Queue)
+{
+	uint32_t WriteIndex = Queue->WriteIndex.load(std::memory_order_relaxed);
+	Queue->WriteIndex.store(WriteIndex + 1, std::memory_order_release);
+}
+
+// NOTE(georgy): Returns 0 if the queue is empty
+template <typename type, uint32_t Capacity> inline type *
+BeginPop(spsc_queue<type, Capacity> *Queue)
+{
+	type *Result = 0;
+
+	uint32_t ReadIndex = Queue->ReadIndex.load(std::memory_order_relaxed);
+	uint32_t WriteIndex = Queue->WriteIndex.load(std::memory_order_acquire);
+	if(ReadIndex != WriteIndex)
+	{
+		Result = Queue->Entries + (ReadIndex & (Capacity - 1));
+	}
+
+	return(Result);
+}
+
+template <typename type, uint32_t Capacity> inline void
+EndPop(spsc_queue<type, Capacity> *Queue)
+{
+	uint32_t ReadIndex = Queue->ReadIndex.load(std::memory_order_relaxed);
+	Queue->ReadIndex.store(ReadIndex + 1, std::memory_order_release);
+}
@@ -0,0 +1,637 @@
+#pragma once
+
+#include "graphics.hpp"
+
+//
+// NOTE(georgy): Redundant state filter. Sits in front of a graphics_context, keeps a shadow copy of the bound
+// pipeline state and drops calls that wouldn't change it. Slotted calls are trimmed to the slots that actually change.
+// Clears, maps, draws, queries and Present always go through.
+// Issued and Filtered count, per call, what reached the inner context and what was dropped.
+//
+
+// NOTE(georgy): Bit N of ValidMask is set when we know what is bound to slot N
+struct filter_slots
+{
+	void *Handles[GFX_MAX_BOUND_RESOURCES];
+	uint32_t ValidMask;
+};
+
+struct state_filter
+{
+	graphics_context *Inner;
+
+	uint64_t Issued[GraphicsCall_Count];
+	uint64_t Filtered[GraphicsCall_Count];
+
+	bool ViewportsValid;
+	uint32_t ViewportCount;
+	gfx_viewport Viewports[GFX_MAX_BOUND_RESOURCES];
+
+	bool RasterStateValid;
+	gfx_raster_state *RasterState;
+
+	bool RenderTargetsValid;
+	uint32_t RenderTargetCount;
+	gfx_texture *RenderTargets[GFX_MAX_BOUND_RESOURCES];
+	gfx_texture *DepthStencil;
+
+	bool DepthStateValid;
+	gfx_depth_state *DepthState;
+	uint32_t StencilRef;
+
+	bool BlendStateValid;
+	gfx_blend_state *BlendState;
+	real32 BlendFactor[4];
+	uint32_t SampleMask;
+
+	bool InputLayoutValid;
+	gfx_input_layout *InputLayout;
+
+	bool TopologyValid;
+	gfx_topology Topology;
+
+	filter_slots VertexBuffers;
+	uint32_t VertexStrides[GFX_MAX_BOUND_RESOURCES];
+	uint32_t VertexOffsets[GFX_MAX_BOUND_RESOURCES];
+
+	bool IndexBufferValid;
+	gfx_buffer *IndexBuffer;
+	gfx_index_format IndexFormat;
+	uint32_t IndexOffset;
+
+	bool VertexShaderValid;
+	gfx_vertex_shader *VertexShader;
+	bool PixelShaderValid;
+	gfx_pixel_shader *PixelShader;
+
+	// NOTE(georgy): Whole buffer bindings are range 0, 0
+	filter_slots VSConstantBuffers;
+	uint32_t VSFirstConstant[GFX_MAX_BOUND_RESOURCES];
+	uint32_t VSNumConstants[GFX_MAX_BOUND_RESOURCES];
+	filter_slots PSConstantBuffers;
+	uint32_t PSFirstConstant[GFX_MAX_BOUND_RESOURCES];
+	uint32_t PSNumConstants[GFX_MAX_BOUND_RESOURCES];
+	filter_slots PSShaderResources;
+	filter_slots PSSamplers;
+};
+
+inline state_filter *
+GetStateFilter(graphics_context *Context)
+{
+	state_filter *Result = (state_filter *)Context->Data;
+	return(Result);
+}
+
+// NOTE(georgy): Has to be called if anybody touches the inner context behind the filter's back
+static void
+InvalidateStateFilter(state_filter *Filter)
+{
+	Filter->ViewportsValid = false;
+	Filter->RasterStateValid = false;
+	Filter->RenderTargetsValid = false;
+	Filter->DepthStateValid = false;
+	Filter->BlendStateValid = false;
+	Filter->InputLayoutValid = false;
+	Filter->TopologyValid = false;
+	Filter->VertexBuffers.ValidMask = 0;
+	Filter->IndexBufferValid = false;
+	Filter->VertexShaderValid = false;
+	Filter->PixelShaderValid = false;
+	Filter->VSConstantBuffers.ValidMask = 0;
+	Filter->PSConstantBuffers.ValidMask = 0;
+	Filter->PSShaderResources.ValidMask = 0;
+	Filter->PSSamplers.ValidMask = 0;
+}
+
+// NOTE(georgy): Finds the smallest range of [Slot, Slot + Count) that differs from what is bound, and updates the shadow copy.
+// Returns false if nothing differs.
+static bool
+FilterSlots(filter_slots *Slots, uint32_t Slot, uint32_t Count, void **Handles, uint32_t *FirstChanged, uint32_t *ChangedCount)
+{
+	Assert(Slot + Count <= GFX_MAX_BOUND_RESOURCES);
+
+	uint32_t First = Slot + Count;
+	uint32_t OnePastLast = Slot;
+	for(uint32_t SlotIndex = Slot; SlotIndex < Slot + Count; SlotIndex++)
+	{
+		void *Handle = Handles[SlotIndex - Slot];
+		if(!(Slots->ValidMask & (1 << SlotIndex)) || (Slots->Handles[SlotIndex] != Handle))
+		{
+			First = (SlotIndex < First) ? SlotIndex : First;
+			OnePastLast = SlotIndex + 1;
+
+			Slots->Handles[SlotIndex] = Handle;
+			Slots->ValidMask |= (1 << SlotIndex);
+		}
+	}
+
+	bool Result = (First < OnePastLast);
+	*FirstChanged = First;
+	*ChangedCount = Result ? (OnePastLast - First) : 0;
+	return(Result);
+}
+
+#define FilterIssue(Filter, Name) (Filter)->Issued[GraphicsCall_##Name]++
+#define FilterDrop(Filter, Name) (Filter)->Filtered[GraphicsCall_##Name]++
+
+static void
+FilterRSSetViewports(graphics_context *Context, uint32_t Count, gfx_viewport *Viewports)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	Assert(Count <= ArrayCount(Filter->Viewports));
+	if(Filter->ViewportsValid && (Filter->ViewportCount == Count) && !memcmp(Filter->Viewports, Viewports, Count*sizeof(gfx_viewport)))
+	{
+		FilterDrop(Filter, RSSetViewports);
+	}
+	else
+	{
+		Filter->ViewportsValid = true;
+		Filter->ViewportCount = Count;
+		memcpy(Filter->Viewports, Viewports, Count*sizeof(gfx_viewport));
+
+		FilterIssue(Filter, RSSetViewports);
+		Filter->Inner->RSSetViewports(Filter->Inner, Count, Viewports);
+	}
+}
+
+static void
+FilterRSSetState(graphics_context *Context, gfx_raster_state *State)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	if(Filter->RasterStateValid && (Filter->RasterState == State))
+	{
+		FilterDrop(Filter, RSSetState);
+	}
+	else
+	{
+		Filter->RasterStateValid = true;
+		Filter->RasterState = State;
+
+		FilterIssue(Filter, RSSetState);
+		Filter->Inner->RSSetState(Filter->Inner, State);
+	}
+}
+
+inline bool
+IsBoundAsRenderTarget(state_filter *Filter, gfx_texture *Texture)
+{
+	bool Result = false;
+	if(Texture && Filter->RenderTargetsValid)
+	{
+		Result = (Filter->DepthStencil == Texture);
+		for(uint32_t TargetIndex = 0; !Result && (TargetIndex < Filter->RenderTargetCount); TargetIndex++)
+		{
+			Result = (Filter->RenderTargets[TargetIndex] == Texture);
+		}
+	}
+	return(Result);
+}
+
+static void
+FilterOMSetRenderTargets(graphics_context *Context, uint32_t Count, gfx_texture **RenderTargets, gfx_texture *DepthStencil)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	Assert(Count <= ArrayCount(Filter->RenderTargets));
+	if(Filter->RenderTargetsValid && (Filter->RenderTargetCount == Count) && (Filter->DepthStencil == DepthStencil) &&
+	   !memcmp(Filter->RenderTargets, RenderTargets, Count*sizeof(gfx_texture *)))
+	{
+		FilterDrop(Filter, OMSetRenderTargets);
+	}
+	else
+	{
+		Filter->RenderTargetsValid = true;
+		Filter->RenderTargetCount = Count;
+		memcpy(Filter->RenderTargets, RenderTargets, Count*sizeof(gfx_texture *));
+		Filter->DepthStencil = DepthStencil;
+
+		// NOTE(georgy): D3D11 unbinds shader resources that become render targets, our shadow copy must not think they are still there
+		for(uint32_t SlotIndex = 0; SlotIndex < GFX_MAX_BOUND_RESOURCES; SlotIndex++)
+		{
+			if((Filter->PSShaderResources.ValidMask & (1 << SlotIndex)) &&
+			   IsBoundAsRenderTarget(Filter, (gfx_texture *)Filter->PSShaderResources.Handles[SlotIndex]))
+			{
+				Filter->PSShaderResources.ValidMask &= ~(1 << SlotIndex);
+			}
+		}
+
+		FilterIssue(Filter, OMSetRenderTargets);
+		Filter->Inner->OMSetRenderTargets(Filter->Inner, Count, RenderTargets, DepthStencil);
+	}
+}
+
+static void
+FilterOMSetDepthStencilState(graphics_context *Context, gfx_depth_state *State, uint32_t StencilRef)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	if(Filter->DepthStateValid && (Filter->DepthState == State) && (Filter->StencilRef == StencilRef))
+	{
+		FilterDrop(Filter, OMSetDepthStencilState);
+	}
+	else
+	{
+		Filter->DepthStateValid = true;
+		Filter->DepthState = State;
+		Filter->StencilRef = StencilRef;
+
+		FilterIssue(Filter, OMSetDepthStencilState);
+		Filter->Inner->OMSetDepthStencilState(Filter->Inner, State, StencilRef);
+	}
+}
+
+static void
+FilterOMSetBlendState(graphics_context *Context, gfx_blend_state *State, const real32 *BlendFactor, uint32_t SampleMask)
+{
+	state_filter *Filter = GetStateFilter(Context);
+
+	// NOTE(georgy): Null blend factor means 1.0f, same as D3D11
+	real32 Factor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+	if(BlendFactor)
+	{
+		memcpy(Factor, BlendFactor, sizeof(Factor));
+	}
+
+	if(Filter->BlendStateValid && (Filter->BlendState == State) && (Filter->SampleMask == SampleMask) &&
+	   !memcmp(Filter->BlendFactor, Factor, sizeof(Factor)))
+	{
+		FilterDrop(Filter, OMSetBlendState);
+	}
+	else
+	{
+		Filter->BlendStateValid = true;
+		Filter->BlendState = State;
+		memcpy(Filter->BlendFactor, Factor, sizeof(Factor));
+		Filter->SampleMask = SampleMask;
+
+		FilterIssue(Filter, OMSetBlendState);
+		Filter->Inner->OMSetBlendState(Filter->Inner, State, BlendFactor, SampleMask);
+	}
+}
+
+static void
+FilterClearRenderTargetView(graphics_context *Context, gfx_texture *RenderTarget, const real32 *Color)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, ClearRenderTargetView);
+	Filter->Inner->ClearRenderTargetView(Filter->Inner, RenderTarget, Color);
+}
+
+static void
+FilterClearDepthStencilView(graphics_context *Context, gfx_texture *DepthStencil, uint32_t ClearFlags, real32 Depth, uint8_t Stencil)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, ClearDepthStencilView);
+	Filter->Inner->ClearDepthStencilView(Filter->Inner, DepthStencil, ClearFlags, Depth, Stencil);
+}
+
+static void
+FilterGenerateMips(graphics_context *Context, gfx_texture *Texture)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, GenerateMips);
+	Filter->Inner->GenerateMips(Filter->Inner, Texture);
+}
+
+static void
+FilterIASetInputLayout(graphics_context *Context, gfx_input_layout *Layout)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	if(Filter->InputLayoutValid && (Filter->InputLayout == Layout))
+	{
+		FilterDrop(Filter, IASetInputLayout);
+	}
+	else
+	{
+		Filter->InputLayoutValid = true;
+		Filter->InputLayout = Layout;
+
+		FilterIssue(Filter, IASetInputLayout);
+		Filter->Inner->IASetInputLayout(Filter->Inner, Layout);
+	}
+}
+
+static void
+FilterIASetPrimitiveTopology(graphics_context *Context, gfx_topology Topology)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	if(Filter->TopologyValid && (Filter->Topology == Topology))
+	{
+		FilterDrop(Filter, IASetPrimitiveTopology);
+	}
+	else
+	{
+		Filter->TopologyValid = true;
+		Filter->Topology = Topology;
+
+		FilterIssue(Filter, IASetPrimitiveTopology);
+		Filter->Inner->IASetPrimitiveTopology(Filter->Inner, Topology);
+	}
+}
+
+static void
+FilterIASetVertexBuffers(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *Strides, uint32_t *Offsets)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	filter_slots *Slots = &Filter->VertexBuffers;
+	Assert(Slot + Count <= GFX_MAX_BOUND_RESOURCES);
+
+	// NOTE(georgy): A slot only matches if buffer, stride and offset all do
+	for(uint32_t SlotIndex = Slot; SlotIndex < Slot + Count; SlotIndex++)
+	{
+		if((Filter->VertexStrides[SlotIndex] != Strides[SlotIndex - Slot]) || (Filter->VertexOffsets[SlotIndex] != Offsets[SlotIndex - Slot]))
+		{
+			Slots->ValidMask &= ~(1 << SlotIndex);
+		}
+		Filter->VertexStrides[SlotIndex] = Strides[SlotIndex - Slot];
+		Filter->VertexOffsets[SlotIndex] = Offsets[SlotIndex - Slot];
+	}
+
+	uint32_t First, ChangedCount;
+	if(FilterSlots(Slots, Slot, Count, (void **)Buffers, &First, &ChangedCount))
+	{
+		FilterIssue(Filter, IASetVertexBuffers);
+		Filter->Inner->IASetVertexBuffers(Filter->Inner, First, ChangedCount, Buffers + (First - Slot), Strides + (First - Slot), Offsets + (First - Slot));
+	}
+	else
+	{
+		FilterDrop(Filter, IASetVertexBuffers);
+	}
+}
+
+static void
+FilterIASetIndexBuffer(graphics_context *Context, gfx_buffer *Buffer, gfx_index_format Format, uint32_t Offset)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	if(Filter->IndexBufferValid && (Filter->IndexBuffer == Buffer) && (Filter->IndexFormat == Format) && (Filter->IndexOffset == Offset))
+	{
+		FilterDrop(Filter, IASetIndexBuffer);
+	}
+	else
+	{
+		Filter->IndexBufferValid = true;
+		Filter->IndexBuffer = Buffer;
+		Filter->IndexFormat = Format;
+		Filter->IndexOffset = Offset;
+
+		FilterIssue(Filter, IASetIndexBuffer);
+		Filter->Inner->IASetIndexBuffer(Filter->Inner, Buffer, Format, Offset);
+	}
+}
+
+static void
+FilterVSSetShader(graphics_context *Context, gfx_vertex_shader *Shader)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	if(Filter->VertexShaderValid && (Filter->VertexShader == Shader))
+	{
+		FilterDrop(Filter, VSSetShader);
+	}
+	else
+	{
+		Filter->VertexShaderValid = true;
+		Filter->VertexShader = Shader;
+
+		FilterIssue(Filter, VSSetShader);
+		Filter->Inner->VSSetShader(Filter->Inner, Shader);
+	}
+}
+
+static void
+FilterPSSetShader(graphics_context *Context, gfx_pixel_shader *Shader)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	if(Filter->PixelShaderValid && (Filter->PixelShader == Shader))
+	{
+		FilterDrop(Filter, PSSetShader);
+	}
+	else
+	{
+		Filter->PixelShaderValid = true;
+		Filter->PixelShader = Shader;
+
+		FilterIssue(Filter, PSSetShader);
+		Filter->Inner->PSSetShader(Filter->Inner, Shader);
+	}
+}
+
+// NOTE(georgy): Slots whose constant range changes are marked unknown, so FilterSlots picks them up as changed
+static void
+FilterConstantRanges(filter_slots *Slots, uint32_t *BoundFirst, uint32_t *BoundNum,
+					 uint32_t Slot, uint32_t Count, uint32_t *FirstConstant, uint32_t *NumConstants)
+{
+	Assert(Slot + Count <= GFX_MAX_BOUND_RESOURCES);
+	for(uint32_t SlotIndex = Slot; SlotIndex < Slot + Count; SlotIndex++)
+	{
+		uint32_t First = FirstConstant ? FirstConstant[SlotIndex - Slot] : 0;
+		uint32_t Num = NumConstants ? NumConstants[SlotIndex - Slot] : 0;
+		if((BoundFirst[SlotIndex] != First) || (BoundNum[SlotIndex] != Num))
+		{
+			Slots->ValidMask &= ~(1 << SlotIndex);
+		}
+		BoundFirst[SlotIndex] = First;
+		BoundNum[SlotIndex] = Num;
+	}
+}
+
+#define FILTER_SLOTTED_CALL(Name, type, Slots) \
+static void \
+Filter##Name(graphics_context *Context, uint32_t Slot, uint32_t Count, type **Handles) \
+{ \
+	state_filter *Filter = GetStateFilter(Context); \
+	uint32_t First, ChangedCount; \
+	if(FilterSlots(&Filter->Slots, Slot, Count, (void **)Handles, &First, &ChangedCount)) \
+	{ \
+		FilterIssue(Filter, Name); \
+		Filter->Inner->Name(Filter->Inner, First, ChangedCount, Handles + (First - Slot)); \
+	} \
+	else \
+	{ \
+		FilterDrop(Filter, Name); \
+	} \
+}
+
+FILTER_SLOTTED_CALL(PSSetSamplers, gfx_sampler, PSSamplers)
+#undef FILTER_SLOTTED_CALL
+
+#define FILTER_CONSTANT_BUFFERS_CALL(Name, Stage) \
+static void \
+Filter##Name(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers) \
+{ \
+	state_filter *Filter = GetStateFilter(Context); \
+	FilterConstantRanges(&Filter->Stage##ConstantBuffers, Filter->Stage##FirstConstant, Filter->Stage##NumConstants, Slot, Count, 0, 0); \
+	uint32_t First, ChangedCount; \
+	if(FilterSlots(&Filter->Stage##ConstantBuffers, Slot, Count, (void **)Buffers, &First, &ChangedCount)) \
+	{ \
+		FilterIssue(Filter, Name); \
+		Filter->Inner->Name(Filter->Inner, First, ChangedCount, Buffers + (First - Slot)); \
+	} \
+	else \
+	{ \
+		FilterDrop(Filter, Name); \
+	} \
+} \
+\
+static void \
+Filter##Name##1(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_buffer **Buffers, uint32_t *FirstConstant, uint32_t *NumConstants) \
+{ \
+	state_filter *Filter = GetStateFilter(Context); \
+	FilterConstantRanges(&Filter->Stage##ConstantBuffers, Filter->Stage##FirstConstant, Filter->Stage##NumConstants, Slot, Count, FirstConstant, NumConstants); \
+	uint32_t First, ChangedCount; \
+	if(FilterSlots(&Filter->Stage##ConstantBuffers, Slot, Count, (void **)Buffers, &First, &ChangedCount)) \
+	{ \
+		FilterIssue(Filter, Name##1); \
+		Filter->Inner->Name##1(Filter->Inner, First, ChangedCount, Buffers + (First - Slot), FirstConstant + (First - Slot), NumConstants + (First - Slot)); \
+	} \
+	else \
+	{ \
+		FilterDrop(Filter, Name##1); \
+	} \
+}
+
+FILTER_CONSTANT_BUFFERS_CALL(VSSetConstantBuffers, VS)
+FILTER_CONSTANT_BUFFERS_CALL(PSSetConstantBuffers, PS)
+#undef FILTER_CONSTANT_BUFFERS_CALL
+
+static void
+FilterPSSetShaderResources(graphics_context *Context, uint32_t Slot, uint32_t Count, gfx_texture **Textures)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	uint32_t First, ChangedCount;
+	if(FilterSlots(&Filter->PSShaderResources, Slot, Count, (void **)Textures, &First, &ChangedCount))
+	{
+		FilterIssue(Filter, PSSetShaderResources);
+		Filter->Inner->PSSetShaderResources(Filter->Inner, First, ChangedCount, Textures + (First - Slot));
+
+		// NOTE(georgy): D3D11 binds null instead of a texture that is still a render target, so we don't know what's in that slot
+		for(uint32_t SlotIndex = First; SlotIndex < First + ChangedCount; SlotIndex++)
+		{
+			if(IsBoundAsRenderTarget(Filter, Textures[SlotIndex - Slot]))
+			{
+				Filter->PSShaderResources.ValidMask &= ~(1 << SlotIndex);
+			}
+		}
+	}
+	else
+	{
+		FilterDrop(Filter, PSSetShaderResources);
+	}
+}
+
+static void *
+FilterMap(graphics_context *Context, gfx_buffer *Buffer, gfx_map MapType)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, Map);
+	void *Result = Filter->Inner->Map(Filter->Inner, Buffer, MapType);
+	return(Result);
+}
+
+static void
+FilterUnmap(graphics_context *Context, gfx_buffer *Buffer)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, Unmap);
+	Filter->Inner->Unmap(Filter->Inner, Buffer);
+}
+
+static void
+FilterDraw(graphics_context *Context, uint32_t VertexCount, uint32_t StartVertex)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, Draw);
+	Filter->Inner->Draw(Filter->Inner, VertexCount, StartVertex);
+}
+
+static void
+FilterDrawIndexed(graphics_context *Context, uint32_t IndexCount, uint32_t StartIndex, int32_t BaseVertex)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, DrawIndexed);
+	Filter->Inner->DrawIndexed(Filter->Inner, IndexCount, StartIndex, BaseVertex);
+}
+
+static void
+FilterDrawIndexedInstanced(graphics_context *Context, uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndex, int32_t BaseVertex, uint32_t StartInstance)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, DrawIndexedInstanced);
+	Filter->Inner->DrawIndexedInstanced(Filter->Inner, IndexCountPerInstance, InstanceCount, StartIndex, BaseVertex, StartInstance);
+}
+
+static void
+FilterBegin(graphics_context *Context, gfx_query *Query)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, Begin);
+	Filter->Inner->Begin(Filter->Inner, Query);
+}
+
+static void
+FilterEnd(graphics_context *Context, gfx_query *Query)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, End);
+	Filter->Inner->End(Filter->Inner, Query);
+}
+
+static bool
+FilterGetData(graphics_context *Context, gfx_query *Query, gfx_pipeline_statistics *Statistics)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, GetData);
+	bool Result = Filter->Inner->GetData(Filter->Inner, Query, Statistics);
+	return(Result);
+}
+
+static void
+FilterPresent(graphics_context *Context)
+{
+	state_filter *Filter = GetStateFilter(Context);
+	FilterIssue(Filter, Present);
+	Filter->Inner->Present(Filter->Inner);
+
+	// NOTE(georgy): Flip model swap chains unbind the back buffer on Present
+	Filter->RenderTargetsValid = false;
+}
+
+#undef FilterIssue
+#undef FilterDrop
+
+// NOTE(georgy): Context is what the renderer should use from now on
+static void
+InitializeStateFilter(state_filter *Filter, graphics_context *Inner, graphics_context *Context)
+{
+	*Filter = {};
+	Filter->Inner = Inner;
+	InvalidateStateFilter(Filter);
+
+	Context->RSSetViewports = FilterRSSetViewports;
+	Context->RSSetState = FilterRSSetState;
+	Context->OMSetRenderTargets = FilterOMSetRenderTargets;
+	Context->OMSetDepthStencilState = FilterOMSetDepthStencilState;
+	Context->OMSetBlendState = FilterOMSetBlendState;
+	Context->ClearRenderTargetView = FilterClearRenderTargetView;
+	Context->ClearDepthStencilView = FilterClearDepthStencilView;
+	Context->GenerateMips = FilterGenerateMips;
+	Context->IASetInputLayout = FilterIASetInputLayout;
+	Context->IASetPrimitiveTopology = FilterIASetPrimitiveTopology;
+	Context->IASetVertexBuffers = FilterIASetVertexBuffers;
+	Context->IASetIndexBuffer = FilterIASetIndexBuffer;
+	Context->VSSetShader = FilterVSSetShader;
+	Context->PSSetShader = FilterPSSetShader;
+	Context->VSSetConstantBuffers = FilterVSSetConstantBuffers;
+	Context->PSSetConstantBuffers = FilterPSSetConstantBuffers;
+	Context->VSSetConstantBuffers1 = FilterVSSetConstantBuffers1;
+	Context->PSSetConstantBuffers1 = FilterPSSetConstantBuffers1;
+	Context->PSSetShaderResources = FilterPSSetShaderResources;
+	Context->PSSetSamplers = FilterPSSetSamplers;
+	Context->Map = FilterMap;
+	Context->Unmap = FilterUnmap;
+	Context->Draw = FilterDraw;
+	Context->DrawIndexed = FilterDrawIndexed;
+	Context->DrawIndexedInstanced = FilterDrawIndexedInstanced;
+	Context->Begin = FilterBegin;
+	Context->End = FilterEnd;
+	Context->GetData = FilterGetData;
+	Context->Present = FilterPresent;
+	Context->Data = Filter;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+//
+// NOTE(georgy): Temporal accumulation of the RSM indirect illumination, TemporalPS.hlsl does exactly this per texel.
+//
+// Every frame the RSM gather turns the rotations of the blue noise tile by one more step of the R1 sequence
+// (the one dimensional R2, multiples of the golden ratio) around the circle. Neighbouring pixels keep their
+// blue noise offsets from each other, and after a few frames a pixel has gathered in many more directions
+// than it does per frame.
+//
+// The position of a low resolution texel is reprojected into the previous frame with ViewToPrevClip and the history
+// is read there with bilinear weights, leaving out the texels whose depth doesn't match where the position was
+// (it was hidden or off screen, a disocclusion). What's left is clamped to the range of the current frame's 3x3
+// neighbourhood, so stale light can't stay around, and blended with the current frame.
+//
+
+#define TEMPORAL_BLEND_FACTOR 0.1f
+// NOTE(georgy): Relative to the depth the reprojected position had in the previous frame
+#define TEMPORAL_DEPTH_TOLERANCE 0.05f
+// NOTE(georgy): Less than that of the bilinear footprint is valid history, and it's a disocclusion
+#define TEMPORAL_MIN_HISTORY_WEIGHT 0.01f
+
+// NOTE(georgy): Angle the sample sets are turned by in this frame
+inline real32
+GetRSMFrameRotation(uint64_t FrameIndex)
+{
+	real64 R1 = 0.5 + (real64)FrameIndex*0.61803398874989484820;
+	real32 Result = (real32)(R1 - floor(R1)) * 2.0f*PI;
+	return(Result);
+}
+
+// NOTE(georgy): View space of this frame to clip space of the previous one
+inline mat4
+GetViewToPrevClip(mat4 View, mat4 PrevViewProjection)
+{
+	mat4 Result = InverseAffine(View) * PrevViewProjection;
+	return(Result);
+}
+
+struct temporal_reprojection
+{
+	v2 UV;
+	real32 LinearDepth;
+};
+
+inline temporal_reprojection
+ReprojectToPrevFrame(v3 ViewPos, mat4 ViewToPrevClip, real32 FarPlane)
+{
+	v4 PrevClip = V4(ViewPos, 1.0f) * ViewToPrevClip;
+
+	temporal_reprojection Result;
+	Result.UV = V2(0.5f*PrevClip.x / PrevClip.w + 0.5f, -0.5f*PrevClip.y / PrevClip.w + 0.5f);
+	Result.LinearDepth = PrevClip.w / FarPlane;
+	return(Result);
+}
+
+struct temporal_history
+{
+	v3 *Colors;
+	real32 *LinearDepths;
+	uint32_t Width, Height;
+};
+
+// NOTE(georgy): Low resolution texel (X, Y) is the full resolution pixel (Downsample*X, Downsample*Y), ScreenWidth x ScreenHeight
+// is the full resolution. Current and History are both at low resolution. Without history only the current frame is returned.
+static v3
+ResolveTemporalTexel(uint32_t X, uint32_t Y, temporal_history *Current, temporal_history *History, v3 ViewPos, mat4 ViewToPrevClip,
+					 real32 FarPlane, uint32_t ScreenWidth, uint32_t ScreenHeight, uint32_t Downsample, bool HistoryValid)
+{
+	v3 Color = Current->Colors[Y*Current->Width + X];
+	v3 Result = Color;
+	if(HistoryValid)
+	{
+		temporal_reprojection Reprojection = ReprojectToPrevFrame(ViewPos, ViewToPrevClip, FarPlane);
+		real32 HistoryX = (Reprojection.UV.x*ScreenWidth - 0.5f) / Downsample;
+		real32 HistoryY = (Reprojection.UV.y*ScreenHeight - 0.5f) / Downsample;
+		int32_t BaseX = (int32_t)floorf(HistoryX);
+		int32_t BaseY = (int32_t)floorf(HistoryY);
+		real32 FractionX = HistoryX - BaseX;
+		real32 FractionY = HistoryY - BaseY;
+
+		v3 HistoryColor = V3(0.0f, 0.0f, 0.0f);
+		real32 WeightSum = 0.0f;
+		for(int32_t TapY = 0; TapY < 2; TapY++)
+		{
+			for(int32_t TapX = 0; TapX < 2; TapX++)
+			{
+				int32_t TexelX = BaseX + TapX;
+				int32_t TexelY = BaseY + TapY;
+				if((TexelX >= 0) && (TexelY >= 0) && (TexelX < (int32_t)History->Width) && (TexelY < (int32_t)History->Height))
+				{
+					uint32_t Texel = TexelY*History->Width + TexelX;
+					if(fabsf(History->LinearDepths[Texel] - Reprojection.LinearDepth) < TEMPORAL_DEPTH_TOLERANCE*Reprojection.LinearDepth)
+					{
+						real32 Weight = (TapX ? FractionX : 1.0f - FractionX) * (TapY ? FractionY : 1.0f - FractionY);
+						HistoryColor += Weight*History->Colors[Texel];
+						WeightSum += Weight;
+					}
+				}
+			}
+		}
+
+		if(WeightSum > TEMPORAL_MIN_HISTORY_WEIGHT)
+		{
+			HistoryColor = (1.0f / WeightSum)*HistoryColor;
+
+			v3 Min = Color, Max = Color;
+			for(int32_t NeighbourY = (int32_t)Y - 1; NeighbourY <= (int32_t)Y + 1; NeighbourY++)
+			{
+				for(int32_t NeighbourX = (int32_t)X - 1; NeighbourX <= (int32_t)X + 1; NeighbourX++)
+				{
+					int32_t ClampedX = (NeighbourX < 0) ? 0 : ((NeighbourX >= (int32_t)Current->Width) ? (int32_t)Current->Width - 1 : NeighbourX);
+					int32_t ClampedY = (NeighbourY < 0) ? 0 : ((NeighbourY >= (int32_t)Current->Height) ? (int32_t)Current->Height - 1 : NeighbourY);
+					v3 Neighbour = Current->Colors[ClampedY*Current->Width + ClampedX];
+					Min = V3(fminf(Min.x, Neighbour.x), fminf(Min.y, Neighbour.y), fminf(Min.z, Neighbour.z));
+					Max = V3(fmaxf(Max.x, Neighbour.x), fmaxf(Max.y, Neighbour.y), fmaxf(Max.z, Neighbour.z));
+				}
+			}
+			HistoryColor = V3(fminf(fmaxf(HistoryColor.x, Min.x), Max.x),
+							  fminf(fmaxf(HistoryColor.y, Min.y), Max.y),
+							  fminf(fmaxf(HistoryColor.z, Min.z), Max.z));
+
+			Result = HistoryColor + TEMPORAL_BLEND_FACTOR*(Color - HistoryColor);
+		}
+	}
+
+	return(Result);
+}
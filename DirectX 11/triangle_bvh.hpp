@@ -0,0 +1,1188 @@
+#pragma once
+
+#include "memory_arena.hpp"
+#include "job_system.hpp"
+#include "aabb.hpp"
+
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//
+// NOTE(georgy): Static BVH over a triangle mesh, for CPU ray queries (picking, ray traced shadows, baking).
+//
+// Build: binned SAH. Every node bins its triangles' centroids into BVH_BIN_COUNT bins on each axis and splits
+// at the bin boundary with the lowest surface area cost. The top of the tree is built one node at a time
+// (binning the big nodes in parallel), until the nodes are small enough to be handed out as independent subtrees
+// that are built in parallel. A subtree over K triangles has exactly 2K - 1 nodes, so where every subtree's nodes go
+// is known before it's built and the subtrees never share anything.
+//
+// The binary tree is then collapsed into a 4 wide BVH: each BVH4 node keeps the boxes of its 4 children
+// as structure of arrays, so a ray is tested against all 4 with SSE. Leaves hold up to 4 triangles in one block,
+// also structure of arrays, and a ray is tested against all of them at once too.
+//
+// Traversal is either one ray at a time (SIMD over the 4 children / triangles) or a packet of 4 rays
+// (SIMD over the rays), the packet pays off for coherent rays like camera rays or shadow rays to one light.
+//
+
+#define BVH_BIN_COUNT 16
+#define BVH_LEAF_SIZE 4
+#define BVH_STACK_SIZE 128
+
+// NOTE(georgy): Cost of visiting a node relative to testing one block of triangles
+#define BVH_TRAVERSAL_COST 1.0f
+
+#define BVH_MAX_BUILD_TASKS 256
+#define BVH_MIN_BUILD_TASK_SIZE 1024
+#define BVH_PARALLEL_BIN_MIN_COUNT 65536
+#define BVH_BIN_BLOCK_SIZE 16384
+#define BVH_MAX_BIN_BLOCKS 64
+
+#define BVH4_LEAF_FLAG 0x80000000
+#define BVH4_EMPTY_CHILD 0xFFFFFFFF
+#define BVH_NO_TRIANGLE 0xFFFFFFFF
+
+struct bvh4_node
+{
+	// NOTE(georgy): Empty children have Min = FLT_MAX and Max = -FLT_MAX
+	alignas(64) real32 MinX[4];
+	real32 MinY[4];
+	real32 MinZ[4];
+	real32 MaxX[4];
+	real32 MaxY[4];
+	real32 MaxZ[4];
+
+	// NOTE(georgy): Inner node index, BVH4_LEAF_FLAG | triangle block index, or BVH4_EMPTY_CHILD
+	uint32_t Children[4];
+};
+
+// NOTE(georgy): Triangles as first vertex and two edges. Unused lanes have zero edges and can't be hit.
+struct bvh_triangle_block
+{
+	alignas(16) real32 V0X[4];
+	real32 V0Y[4];
+	real32 V0Z[4];
+	real32 Edge1X[4];
+	real32 Edge1Y[4];
+	real32 Edge1Z[4];
+	real32 Edge2X[4];
+	real32 Edge2Y[4];
+	real32 Edge2Z[4];
+
+	// NOTE(georgy): Index of the triangle in the mesh's index array (first index / 3)
+	uint32_t Triangles[4];
+};
+
+struct triangle_bvh
+{
+	uint32_t NodeCount;
+	bvh4_node *Nodes;
+
+	uint32_t BlockCount;
+	bvh_triangle_block *Blocks;
+
+	uint32_t TriangleCount;
+	aabb Bounds;
+};
+
+struct bvh_hit
+{
+	real32 T;
+
+	// NOTE(georgy): Barycentrics of the hit point, P = (1 - U - V)*P0 + U*P1 + V*P2
+	real32 U, V;
+	uint32_t Triangle;
+};
+
+// NOTE(georgy): 4 rays as structure of arrays. Lanes that aren't needed can have MaxT = 0.
+struct bvh_ray_packet
+{
+	alignas(16) real32 OriginX[4];
+	real32 OriginY[4];
+	real32 OriginZ[4];
+	real32 DirectionX[4];
+	real32 DirectionY[4];
+	real32 DirectionZ[4];
+	real32 MaxT[4];
+
+	// NOTE(georgy): Results. Closest hit fills all of them, any hit only sets T to -1 for occluded rays.
+	real32 T[4];
+	real32 U[4];
+	real32 V[4];
+	uint32_t Triangles[4];
+};
+
+//
+// NOTE(georgy): Build. Boxes are kept in SSE registers here, w is always 0 for real boxes.
+//
+
+struct bvh_box
+{
+	__m128 Min;
+	__m128 Max;
+};
+
+struct bvh_bin
+{
+	bvh_box Box;
+	bvh_box CentroidBox;
+	uint32_t Count;
+};
+
+struct bvh_build_node
+{
+	bvh_box Box;
+
+	// NOTE(georgy): Count is 0 for inner nodes
+	uint32_t Left, Right;
+	uint32_t First, Count;
+};
+
+struct bvh_build_range
+{
+	bvh_box Box;
+	bvh_box CentroidBox;
+	uint32_t Node;
+	uint32_t Start, OnePastEnd;
+};
+
+struct bvh_builder
+{
+	uint8_t *Positions;
+	uint32_t PositionStride;
+	uint32_t *Indices;
+
+	uint32_t TriangleCount;
+	bvh_box *TriangleBoxes;
+	__m128 *Centroids;
+	uint32_t *TriangleOrder;
+
+	// NOTE(georgy): A range's node is followed by its left subtree's 2*LeftCount - 1 nodes and then the right subtree's
+	bvh_build_node *Nodes;
+
+	uint32_t TaskSize;
+	uint32_t TaskCount;
+	bvh_build_range Tasks[BVH_MAX_BUILD_TASKS];
+
+	// NOTE(georgy): For binning the big nodes at the top in parallel
+	job_system *JobSystem;
+	bvh_build_range *BinRange;
+	__m128 BinScale;
+	uint32_t BinBlockSize;
+	bvh_bin (*BlockBins)[3][BVH_BIN_COUNT];
+};
+
+inline uint32_t
+FindLeastSignificantSetBit(uint32_t Value)
+{
+	Assert(Value);
+#if defined(_MSC_VER)
+	unsigned long Result;
+	_BitScanForward(&Result, Value);
+	return((uint32_t)Result);
+#else
+	uint32_t Result = (uint32_t)__builtin_ctz(Value);
+	return(Result);
+#endif
+}
+
+inline bvh_box
+EmptyBVHBox(void)
+{
+	bvh_box Result = {_mm_set1_ps(FLT_MAX), _mm_set1_ps(-FLT_MAX)};
+	return(Result);
+}
+
+inline bvh_box
+Union(bvh_box A, bvh_box B)
+{
+	bvh_box Result = {_mm_min_ps(A.Min, B.Min), _mm_max_ps(A.Max, B.Max)};
+	return(Result);
+}
+
+inline bvh_box
+Union(bvh_box A, __m128 P)
+{
+	bvh_box Result = {_mm_min_ps(A.Min, P), _mm_max_ps(A.Max, P)};
+	return(Result);
+}
+
+inline real32
+SurfaceArea(bvh_box A)
+{
+	__m128 D = _mm_sub_ps(A.Max, A.Min);
+	__m128 Products = _mm_mul_ps(D, _mm_shuffle_ps(D, D, _MM_SHUFFLE(3, 0, 2, 1)));
+	alignas(16) real32 P[4];
+	_mm_store_ps(P, Products);
+	real32 Result = P[0] + P[1] + P[2];
+	return(Result);
+}
+
+inline aabb
+GetBVHBoxAABB(bvh_box Box)
+{
+	alignas(16) real32 Min[4], Max[4];
+	_mm_store_ps(Min, Box.Min);
+	_mm_store_ps(Max, Box.Max);
+	aabb Result = {V3(Min[0], Min[1], Min[2]), V3(Max[0], Max[1], Max[2])};
+	return(Result);
+}
+
+inline __m128
+GetBVHPosition(bvh_builder *Builder, uint32_t Index)
+{
+	v3 *P = (v3 *)(Builder->Positions + (size_t)Index*Builder->PositionStride);
+	__m128 Result = _mm_setr_ps(P->x, P->y, P->z, 0.0f);
+	return(Result);
+}
+
+// NOTE(georgy): Leaves are tested a block of 4 triangles at a time, so that's what the SAH counts
+inline real32
+GetBVHLeafCost(uint32_t TriangleCount)
+{
+	real32 Result = (real32)((TriangleCount + BVH_LEAF_SIZE - 1) / BVH_LEAF_SIZE);
+	return(Result);
+}
+
+// NOTE(georgy): Bin of the centroid on all 3 axes at once
+inline __m128i
+GetBVHBins(__m128 Centroid, __m128 CentroidMin, __m128 BinScale)
+{
+	__m128 Bin = _mm_mul_ps(_mm_sub_ps(Centroid, CentroidMin), BinScale);
+	Bin = _mm_min_ps(_mm_max_ps(Bin, _mm_setzero_ps()), _mm_set1_ps(BVH_BIN_COUNT - 1));
+	__m128i Result = _mm_cvttps_epi32(Bin);
+	return(Result);
+}
+
+static void
+BinBVHTriangles(bvh_builder *Builder, uint32_t Start, uint32_t OnePastEnd, __m128 CentroidMin, __m128 BinScale, bvh_bin (*Bins)[BVH_BIN_COUNT])
+{
+	for(uint32_t Axis = 0; Axis < 3; Axis++)
+	{
+		for(uint32_t Bin = 0; Bin < BVH_BIN_COUNT; Bin++)
+		{
+			Bins[Axis][Bin].Box = Bins[Axis][Bin].CentroidBox = EmptyBVHBox();
+			Bins[Axis][Bin].Count = 0;
+		}
+	}
+
+	for(uint32_t I = Start; I < OnePastEnd; I++)
+	{
+		uint32_t Triangle = Builder->TriangleOrder[I];
+		__m128 Centroid = Builder->Centroids[Triangle];
+		bvh_box Box = Builder->TriangleBoxes[Triangle];
+		alignas(16) int32_t BinIndices[4];
+		_mm_store_si128((__m128i *)BinIndices, GetBVHBins(Centroid, CentroidMin, BinScale));
+		for(uint32_t Axis = 0; Axis < 3; Axis++)
+		{
+			bvh_bin *Bin = &Bins[Axis][BinIndices[Axis]];
+			Bin->Box = Union(Bin->Box, Box);
+			Bin->CentroidBox = Union(Bin->CentroidBox, Centroid);
+			Bin->Count++;
+		}
+	}
+}
+
+static void
+BinBVHTriangleBlocks(uint32_t FirstBlock, uint32_t OnePastLastBlock, void *UserData)
+{
+	bvh_builder *Builder = (bvh_builder *)UserData;
+	bvh_build_range *Range = Builder->BinRange;
+	for(uint32_t Block = FirstBlock; Block < OnePastLastBlock; Block++)
+	{
+		uint32_t Start = Range->Start + Block*Builder->BinBlockSize;
+		uint32_t OnePastEnd = (Start + Builder->BinBlockSize < Range->OnePastEnd) ? (Start + Builder->BinBlockSize) : Range->OnePastEnd;
+		BinBVHTriangles(Builder, Start, OnePastEnd, Range->CentroidBox.Min, Builder->BinScale, Builder->BlockBins[Block]);
+	}
+}
+
+// NOTE(georgy): Returns false if the range should be a leaf. Otherwise reorders the range's triangles so that
+// [Start, Left->OnePastEnd) goes left and the rest right, and fills in the children's ranges.
+static bool
+SplitBVHRange(bvh_builder *Builder, bvh_build_range *Range, bool Parallel, bvh_build_range *Left, bvh_build_range *Right)
+{
+	uint32_t Count = Range->OnePastEnd - Range->Start;
+	if(Count <= 1)
+	{
+		return(false);
+	}
+
+	// NOTE(georgy): A bit less than BVH_BIN_COUNT, so the max centroid lands in the last bin and not one past it.
+	// Axes where all centroids are the same get a scale of 0 and aren't split.
+	alignas(16) real32 CentroidExtent[4], BinScales[4];
+	_mm_store_ps(CentroidExtent, _mm_sub_ps(Range->CentroidBox.Max, Range->CentroidBox.Min));
+	bool CanSplit = false;
+	for(uint32_t Axis = 0; Axis < 4; Axis++)
+	{
+		BinScales[Axis] = ((Axis < 3) && (CentroidExtent[Axis] > 0.0f)) ? (0.9999f*BVH_BIN_COUNT / CentroidExtent[Axis]) : 0.0f;
+		CanSplit = CanSplit || (BinScales[Axis] > 0.0f);
+	}
+	__m128 BinScale = _mm_load_ps(BinScales);
+
+	uint32_t BestAxis = 0, BestBin = 0;
+	real32 BestCost = FLT_MAX;
+	bvh_box BestBoxes[2], BestCentroidBoxes[2];
+	if(CanSplit)
+	{
+		bvh_bin Bins[3][BVH_BIN_COUNT];
+		if(Parallel)
+		{
+			uint32_t BlockCount = (Count + BVH_BIN_BLOCK_SIZE - 1) / BVH_BIN_BLOCK_SIZE;
+			BlockCount = (BlockCount > BVH_MAX_BIN_BLOCKS) ? BVH_MAX_BIN_BLOCKS : BlockCount;
+			Builder->BinRange = Range;
+			Builder->BinScale = BinScale;
+			Builder->BinBlockSize = (Count + BlockCount - 1) / BlockCount;
+			ParallelFor(Builder->JobSystem, BlockCount, BinBVHTriangleBlocks, Builder);
+
+			for(uint32_t Axis = 0; Axis < 3; Axis++)
+			{
+				for(uint32_t Bin = 0; Bin < BVH_BIN_COUNT; Bin++)
+				{
+					bvh_bin *Merged = &Bins[Axis][Bin];
+					*Merged = Builder->BlockBins[0][Axis][Bin];
+					for(uint32_t Block = 1; Block < BlockCount; Block++)
+					{
+						bvh_bin *BlockBin = &Builder->BlockBins[Block][Axis][Bin];
+						Merged->Box = Union(Merged->Box, BlockBin->Box);
+						Merged->CentroidBox = Union(Merged->CentroidBox, BlockBin->CentroidBox);
+						Merged->Count += BlockBin->Count;
+					}
+				}
+			}
+		}
+		else
+		{
+			BinBVHTriangles(Builder, Range->Start, Range->OnePastEnd, Range->CentroidBox.Min, BinScale, Bins);
+		}
+
+		// NOTE(georgy): Sweep from the right to get what is right of each bin boundary, then from the left and evaluate
+		for(uint32_t Axis = 0; Axis < 3; Axis++)
+		{
+			if(BinScales[Axis] == 0.0f)
+			{
+				continue;
+			}
+
+			bvh_box RightBoxes[BVH_BIN_COUNT], RightCentroidBoxes[BVH_BIN_COUNT];
+			uint32_t RightCounts[BVH_BIN_COUNT];
+			bvh_box Box = EmptyBVHBox(), CentroidBox = EmptyBVHBox();
+			uint32_t RightCount = 0;
+			for(uint32_t Bin = BVH_BIN_COUNT - 1; Bin > 0; Bin--)
+			{
+				Box = Union(Box, Bins[Axis][Bin].Box);
+				CentroidBox = Union(CentroidBox, Bins[Axis][Bin].CentroidBox);
+				RightCount += Bins[Axis][Bin].Count;
+				RightBoxes[Bin] = Box;
+				RightCentroidBoxes[Bin] = CentroidBox;
+				RightCounts[Bin] = RightCount;
+			}
+
+			Box = CentroidBox = EmptyBVHBox();
+			uint32_t LeftCount = 0;
+			for(uint32_t Bin = 1; Bin < BVH_BIN_COUNT; Bin++)
+			{
+				Box = Union(Box, Bins[Axis][Bin - 1].Box);
+				CentroidBox = Union(CentroidBox, Bins[Axis][Bin - 1].CentroidBox);
+				LeftCount += Bins[Axis][Bin - 1].Count;
+				if(LeftCount && RightCounts[Bin])
+				{
+					real32 Cost = SurfaceArea(Box)*GetBVHLeafCost(LeftCount) + SurfaceArea(RightBoxes[Bin])*GetBVHLeafCost(RightCounts[Bin]);
+					if(Cost < BestCost)
+					{
+						BestCost = Cost;
+						BestAxis = Axis;
+						BestBin = Bin;
+						BestBoxes[0] = Box;
+						BestBoxes[1] = RightBoxes[Bin];
+						BestCentroidBoxes[0] = CentroidBox;
+						BestCentroidBoxes[1] = RightCentroidBoxes[Bin];
+					}
+				}
+			}
+		}
+	}
+
+	uint32_t Mid;
+	if(BestCost < FLT_MAX)
+	{
+		real32 Area = SurfaceArea(Range->Box);
+		real32 LeafCost = Area*GetBVHLeafCost(Count);
+		real32 SplitCost = Area*BVH_TRAVERSAL_COST + BestCost;
+		if((Count <= BVH_LEAF_SIZE) && (LeafCost <= SplitCost))
+		{
+			return(false);
+		}
+
+		uint32_t I = Range->Start, J = Range->OnePastEnd;
+		while(I < J)
+		{
+			uint32_t Triangle = Builder->TriangleOrder[I];
+			alignas(16) int32_t BinIndices[4];
+			_mm_store_si128((__m128i *)BinIndices, GetBVHBins(Builder->Centroids[Triangle], Range->CentroidBox.Min, BinScale));
+			if((uint32_t)BinIndices[BestAxis] < BestBin)
+			{
+				I++;
+			}
+			else
+			{
+				Builder->TriangleOrder[I] = Builder->TriangleOrder[--J];
+				Builder->TriangleOrder[J] = Triangle;
+			}
+		}
+		Mid = I;
+
+		Left->Box = BestBoxes[0];
+		Left->CentroidBox = BestCentroidBoxes[0];
+		Right->Box = BestBoxes[1];
+		Right->CentroidBox = BestCentroidBoxes[1];
+	}
+	else
+	{
+		// NOTE(georgy): All centroids in one point, nothing to bin. Only too many triangles for a leaf are split, in the middle.
+		if(Count <= BVH_LEAF_SIZE)
+		{
+			return(false);
+		}
+
+		Mid = Range->Start + Count/2;
+		Left->Box = Right->Box = EmptyBVHBox();
+		for(uint32_t I = Range->Start; I < Range->OnePastEnd; I++)
+		{
+			bvh_box *Box = (I < Mid) ? &Left->Box : &Right->Box;
+			*Box = Union(*Box, Builder->TriangleBoxes[Builder->TriangleOrder[I]]);
+		}
+		Left->CentroidBox = Right->CentroidBox = Range->CentroidBox;
+	}
+
+	Assert((Mid > Range->Start) && (Mid < Range->OnePastEnd));
+	Left->Node = Range->Node + 1;
+	Left->Start = Range->Start;
+	Left->OnePastEnd = Mid;
+	Right->Node = Range->Node + 2*(Mid - Range->Start);
+	Right->Start = Mid;
+	Right->OnePastEnd = Range->OnePastEnd;
+
+	return(true);
+}
+
+inline void
+MakeBVHBuildLeaf(bvh_builder *Builder, bvh_build_range *Range)
+{
+	bvh_build_node *Node = Builder->Nodes + Range->Node;
+	Node->Box = Range->Box;
+	Node->First = Range->Start;
+	Node->Count = Range->OnePastEnd - Range->Start;
+}
+
+inline void
+MakeBVHBuildInner(bvh_builder *Builder, bvh_build_range *Range, bvh_build_range *Left, bvh_build_range *Right)
+{
+	bvh_build_node *Node = Builder->Nodes + Range->Node;
+	Node->Box = Range->Box;
+	Node->Left = Left->Node;
+	Node->Right = Right->Node;
+	Node->Count = 0;
+}
+
+static void
+BuildBVHSubtree(bvh_builder *Builder, bvh_build_range *Range)
+{
+	bvh_build_range Left, Right;
+	if(SplitBVHRange(Builder, Range, false, &Left, &Right))
+	{
+		MakeBVHBuildInner(Builder, Range, &Left, &Right);
+		BuildBVHSubtree(Builder, &Left);
+		BuildBVHSubtree(Builder, &Right);
+	}
+	else
+	{
+		MakeBVHBuildLeaf(Builder, Range);
+	}
+}
+
+static void
+BuildBVHTasks(uint32_t FirstTask, uint32_t OnePastLastTask, void *UserData)
+{
+	bvh_builder *Builder = (bvh_builder *)UserData;
+	for(uint32_t Task = FirstTask; Task < OnePastLastTask; Task++)
+	{
+		BuildBVHSubtree(Builder, Builder->Tasks + Task);
+	}
+}
+
+static void
+ComputeBVHTriangleBounds(uint32_t Start, uint32_t OnePastEnd, void *UserData)
+{
+	bvh_builder *Builder = (bvh_builder *)UserData;
+	for(uint32_t Triangle = Start; Triangle < OnePastEnd; Triangle++)
+	{
+		__m128 P0 = GetBVHPosition(Builder, Builder->Indices[3*Triangle + 0]);
+		__m128 P1 = GetBVHPosition(Builder, Builder->Indices[3*Triangle + 1]);
+		__m128 P2 = GetBVHPosition(Builder, Builder->Indices[3*Triangle + 2]);
+		bvh_box Box = {_mm_min_ps(_mm_min_ps(P0, P1), P2), _mm_max_ps(_mm_max_ps(P0, P1), P2)};
+		Builder->TriangleBoxes[Triangle] = Box;
+		Builder->Centroids[Triangle] = _mm_mul_ps(_mm_add_ps(Box.Min, Box.Max), _mm_set1_ps(0.5f));
+		Builder->TriangleOrder[Triangle] = Triangle;
+	}
+}
+
+//
+// NOTE(georgy): Collapsing the binary tree into BVH4
+//
+
+struct bvh_flatten
+{
+	bvh_builder *Builder;
+	uint32_t NodeCount;
+	bvh4_node *Nodes;
+	uint32_t BlockCount;
+	bvh_triangle_block *Blocks;
+};
+
+static uint32_t
+WriteBVHTriangleBlock(bvh_flatten *Flatten, bvh_build_node *Leaf)
+{
+	bvh_builder *Builder = Flatten->Builder;
+	uint32_t Result = Flatten->BlockCount++;
+	bvh_triangle_block *Block = Flatten->Blocks + Result;
+	memset(Block, 0, sizeof(*Block));
+
+	Assert(Leaf->Count <= BVH_LEAF_SIZE);
+	for(uint32_t Lane = 0; Lane < 4; Lane++)
+	{
+		Block->Triangles[Lane] = BVH_NO_TRIANGLE;
+		if(Lane < Leaf->Count)
+		{
+			uint32_t Triangle = Builder->TriangleOrder[Leaf->First + Lane];
+			alignas(16) real32 P0[4], Edge1[4], Edge2[4];
+			__m128 V0 = GetBVHPosition(Builder, Builder->Indices[3*Triangle + 0]);
+			_mm_store_ps(P0, V0);
+			_mm_store_ps(Edge1, _mm_sub_ps(GetBVHPosition(Builder, Builder->Indices[3*Triangle + 1]), V0));
+			_mm_store_ps(Edge2, _mm_sub_ps(GetBVHPosition(Builder, Builder->Indices[3*Triangle + 2]), V0));
+			Block->V0X[Lane] = P0[0]; Block->V0Y[Lane] = P0[1]; Block->V0Z[Lane] = P0[2];
+			Block->Edge1X[Lane] = Edge1[0]; Block->Edge1Y[Lane] = Edge1[1]; Block->Edge1Z[Lane] = Edge1[2];
+			Block->Edge2X[Lane] = Edge2[0]; Block->Edge2Y[Lane] = Edge2[1]; Block->Edge2Z[Lane] = Edge2[2];
+			Block->Triangles[Lane] = Triangle;
+		}
+	}
+
+	return(Result);
+}
+
+// NOTE(georgy): Starts with the binary node's two children and keeps opening the inner child with the biggest area
+// until there are 4. A leaf at the root becomes a node with just that leaf.
+static uint32_t
+FlattenBVHNode(bvh_flatten *Flatten, uint32_t BuildNodeIndex)
+{
+	bvh_build_node *BuildNodes = Flatten->Builder->Nodes;
+	bvh_build_node *BuildNode = BuildNodes + BuildNodeIndex;
+
+	uint32_t Children[4];
+	uint32_t ChildCount = 0;
+	if(BuildNode->Count)
+	{
+		Children[ChildCount++] = BuildNodeIndex;
+	}
+	else
+	{
+		Children[ChildCount++] = BuildNode->Left;
+		Children[ChildCount++] = BuildNode->Right;
+	}
+
+	while(ChildCount < 4)
+	{
+		uint32_t Open = ChildCount;
+		real32 OpenArea = -1.0f;
+		for(uint32_t Child = 0; Child < ChildCount; Child++)
+		{
+			bvh_build_node *ChildNode = BuildNodes + Children[Child];
+			if(!ChildNode->Count && (SurfaceArea(ChildNode->Box) > OpenArea))
+			{
+				Open = Child;
+				OpenArea = SurfaceArea(ChildNode->Box);
+			}
+		}
+		if(Open == ChildCount)
+		{
+			break;
+		}
+
+		bvh_build_node *OpenNode = BuildNodes + Children[Open];
+		Children[Open] = OpenNode->Left;
+		Children[ChildCount++] = OpenNode->Right;
+	}
+
+	uint32_t Result = Flatten->NodeCount++;
+	bvh4_node *Node = Flatten->Nodes + Result;
+	for(uint32_t Child = 0; Child < 4; Child++)
+	{
+		aabb Box = GetBVHBoxAABB((Child < ChildCount) ? BuildNodes[Children[Child]].Box : EmptyBVHBox());
+		Node->MinX[Child] = Box.Min.x; Node->MinY[Child] = Box.Min.y; Node->MinZ[Child] = Box.Min.z;
+		Node->MaxX[Child] = Box.Max.x; Node->MaxY[Child] = Box.Max.y; Node->MaxZ[Child] = Box.Max.z;
+		Node->Children[Child] = BVH4_EMPTY_CHILD;
+	}
+	for(uint32_t Child = 0; Child < ChildCount; Child++)
+	{
+		bvh_build_node *ChildNode = BuildNodes + Children[Child];
+		Node->Children[Child] = ChildNode->Count ? (BVH4_LEAF_FLAG | WriteBVHTriangleBlock(Flatten, ChildNode)) : FlattenBVHNode(Flatten, Children[Child]);
+	}
+
+	return(Result);
+}
+
+// NOTE(georgy): Positions are read as a v3 every PositionStride bytes, e.g. &Vertices[0].Pos and sizeof(vertex).
+// The BVH's nodes and triangles go to Arena, the build's scratch memory to TempArena.
+static void
+BuildTriangleBVH(triangle_bvh *BVH, memory_arena *Arena, memory_arena *TempArena, v3 *FirstPosition, uint32_t PositionStride,
+				 uint32_t *Indices, uint32_t TriangleCount, job_system *JobSystem)
+{
+	Assert(TriangleCount > 0);
+	temporary_memory TempMem = BeginTemporaryMemory(TempArena);
+
+	bvh_builder *Builder = PushStruct(TempArena, bvh_builder);
+	Builder->Positions = (uint8_t *)FirstPosition;
+	Builder->PositionStride = PositionStride;
+	Builder->Indices = Indices;
+	Builder->TriangleCount = TriangleCount;
+	Builder->TriangleBoxes = PushArray(TempArena, TriangleCount, bvh_box);
+	Builder->Centroids = PushArray(TempArena, TriangleCount, __m128);
+	Builder->TriangleOrder = PushArray(TempArena, TriangleCount, uint32_t);
+	Builder->Nodes = PushArray(TempArena, 2*TriangleCount - 1, bvh_build_node);
+	Builder->JobSystem = JobSystem;
+	Builder->BlockBins = (bvh_bin (*)[3][BVH_BIN_COUNT])PushSize(TempArena, BVH_MAX_BIN_BLOCKS*sizeof(bvh_bin[3][BVH_BIN_COUNT]));
+
+	ParallelFor(JobSystem, TriangleCount, ComputeBVHTriangleBounds, Builder, 1024);
+
+	bvh_build_range Root;
+	Root.Node = 0;
+	Root.Start = 0;
+	Root.OnePastEnd = TriangleCount;
+	Root.Box = Root.CentroidBox = EmptyBVHBox();
+	for(uint32_t Triangle = 0; Triangle < TriangleCount; Triangle++)
+	{
+		Root.Box = Union(Root.Box, Builder->TriangleBoxes[Triangle]);
+		Root.CentroidBox = Union(Root.CentroidBox, Builder->Centroids[Triangle]);
+	}
+
+	// NOTE(georgy): Top of the tree down to ranges smaller than TaskSize, those become the parallel tasks.
+	// In the unlikely case that SAH keeps peeling small ranges off big ones there are too many, the rest are built right away.
+	Builder->TaskSize = TriangleCount / (BVH_MAX_BUILD_TASKS / 4);
+	Builder->TaskSize = (Builder->TaskSize < BVH_MIN_BUILD_TASK_SIZE) ? BVH_MIN_BUILD_TASK_SIZE : Builder->TaskSize;
+	Builder->TaskCount = 0;
+
+	bvh_build_range Stack[BVH_STACK_SIZE];
+	uint32_t StackCount = 0;
+	Stack[StackCount++] = Root;
+	while(StackCount)
+	{
+		bvh_build_range Range = Stack[--StackCount];
+		if(Range.OnePastEnd - Range.Start < Builder->TaskSize)
+		{
+			if(Builder->TaskCount < BVH_MAX_BUILD_TASKS)
+			{
+				Builder->Tasks[Builder->TaskCount++] = Range;
+			}
+			else
+			{
+				BuildBVHSubtree(Builder, &Range);
+			}
+			continue;
+		}
+
+		bool Parallel = (JobSystem->WorkerThreadCount > 0) && (Range.OnePastEnd - Range.Start >= BVH_PARALLEL_BIN_MIN_COUNT);
+		bvh_build_range Left, Right;
+		if(SplitBVHRange(Builder, &Range, Parallel, &Left, &Right))
+		{
+			MakeBVHBuildInner(Builder, &Range, &Left, &Right);
+			Assert(StackCount + 2 <= BVH_STACK_SIZE);
+			Stack[StackCount++] = Right;
+			Stack[StackCount++] = Left;
+		}
+		else
+		{
+			MakeBVHBuildLeaf(Builder, &Range);
+		}
+	}
+
+	ParallelFor(JobSystem, Builder->TaskCount, BuildBVHTasks, Builder);
+
+	// NOTE(georgy): Flattened into scratch first, there can't be more BVH4 nodes or blocks than triangles,
+	// then copied to Arena at the exact size
+	bvh_flatten Flatten = {};
+	Flatten.Builder = Builder;
+	Flatten.Nodes = PushArray(TempArena, TriangleCount, bvh4_node);
+	Flatten.Blocks = PushArray(TempArena, TriangleCount, bvh_triangle_block);
+	FlattenBVHNode(&Flatten, Root.Node);
+
+	BVH->NodeCount = Flatten.NodeCount;
+	BVH->Nodes = PushArray(Arena, Flatten.NodeCount, bvh4_node);
+	memcpy(BVH->Nodes, Flatten.Nodes, Flatten.NodeCount*sizeof(bvh4_node));
+	BVH->BlockCount = Flatten.BlockCount;
+	BVH->Blocks = PushArray(Arena, Flatten.BlockCount, bvh_triangle_block);
+	memcpy(BVH->Blocks, Flatten.Blocks, Flatten.BlockCount*sizeof(bvh_triangle_block));
+	BVH->TriangleCount = TriangleCount;
+	BVH->Bounds = GetBVHBoxAABB(Root.Box);
+
+	EndTemporaryMemory(TempMem);
+}
+
+//
+// NOTE(georgy): Single ray traversal, SIMD over a node's 4 children and a leaf's 4 triangles
+//
+
+struct bvh_ray
+{
+	__m128 OriginX, OriginY, OriginZ;
+	__m128 DirectionX, DirectionY, DirectionZ;
+	__m128 InvDirectionX, InvDirectionY, InvDirectionZ;
+
+	// NOTE(georgy): Offsets (in floats) from MinX of the near and far planes for each axis, depends on the direction's signs
+	uint32_t NearX, NearY, NearZ;
+	uint32_t FarX, FarY, FarZ;
+};
+
+// NOTE(georgy): Direction components that are exactly 0 would give 0*inf = NaN in the slab test
+inline real32
+SafeBVHDirection(real32 D)
+{
+	real32 Result = (fabsf(D) < 1e-20f) ? ((D < 0.0f) ? -1e-20f : 1e-20f) : D;
+	return(Result);
+}
+
+static bvh_ray
+MakeBVHRay(v3 Origin, v3 Direction)
+{
+	bvh_ray Result;
+
+	Direction = V3(SafeBVHDirection(Direction.x), SafeBVHDirection(Direction.y), SafeBVHDirection(Direction.z));
+	Result.OriginX = _mm_set1_ps(Origin.x);
+	Result.OriginY = _mm_set1_ps(Origin.y);
+	Result.OriginZ = _mm_set1_ps(Origin.z);
+	Result.DirectionX = _mm_set1_ps(Direction.x);
+	Result.DirectionY = _mm_set1_ps(Direction.y);
+	Result.DirectionZ = _mm_set1_ps(Direction.z);
+	Result.InvDirectionX = _mm_set1_ps(1.0f / Direction.x);
+	Result.InvDirectionY = _mm_set1_ps(1.0f / Direction.y);
+	Result.InvDirectionZ = _mm_set1_ps(1.0f / Direction.z);
+
+	// NOTE(georgy): Going along -x the ray enters a box through MaxX. Empty children (Min > Max) then always miss.
+	Result.NearX = (Direction.x < 0.0f) ? 12 : 0;
+	Result.NearY = (Direction.y < 0.0f) ? 16 : 4;
+	Result.NearZ = (Direction.z < 0.0f) ? 20 : 8;
+	Result.FarX = Result.NearX ^ 12;
+	Result.FarY = 20 - Result.NearY;
+	Result.FarZ = 28 - Result.NearZ;
+
+	return(Result);
+}
+
+// NOTE(georgy): Returns a mask of the children the ray hits before MaxT, their entry distances in TEnter
+inline int
+IntersectBVH4Node(bvh4_node *Node, bvh_ray *Ray, __m128 MaxT, __m128 *TEnter)
+{
+	real32 *Planes = Node->MinX;
+	__m128 TNearX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Planes + Ray->NearX), Ray->OriginX), Ray->InvDirectionX);
+	__m128 TNearY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Planes + Ray->NearY), Ray->OriginY), Ray->InvDirectionY);
+	__m128 TNearZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Planes + Ray->NearZ), Ray->OriginZ), Ray->InvDirectionZ);
+	__m128 TFarX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Planes + Ray->FarX), Ray->OriginX), Ray->InvDirectionX);
+	__m128 TFarY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Planes + Ray->FarY), Ray->OriginY), Ray->InvDirectionY);
+	__m128 TFarZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Planes + Ray->FarZ), Ray->OriginZ), Ray->InvDirectionZ);
+
+	__m128 Enter = _mm_max_ps(_mm_max_ps(TNearX, TNearY), _mm_max_ps(TNearZ, _mm_setzero_ps()));
+	__m128 Exit = _mm_min_ps(_mm_min_ps(TFarX, TFarY), _mm_min_ps(TFarZ, MaxT));
+	*TEnter = Enter;
+	int Result = _mm_movemask_ps(_mm_cmple_ps(Enter, Exit));
+	return(Result);
+}
+
+// NOTE(georgy): Moller-Trumbore for 4 triangles at once, two sided. Returns a mask of the triangles hit before MaxT.
+inline int
+IntersectBVHTriangleBlock(bvh_triangle_block *Block, bvh_ray *Ray, __m128 MaxT, __m128 *T, __m128 *U, __m128 *V)
+{
+	__m128 E1X = _mm_load_ps(Block->Edge1X), E1Y = _mm_load_ps(Block->Edge1Y), E1Z = _mm_load_ps(Block->Edge1Z);
+	__m128 E2X = _mm_load_ps(Block->Edge2X), E2Y = _mm_load_ps(Block->Edge2Y), E2Z = _mm_load_ps(Block->Edge2Z);
+
+	// NOTE(georgy): P = D x E2
+	__m128 PX = _mm_sub_ps(_mm_mul_ps(Ray->DirectionY, E2Z), _mm_mul_ps(Ray->DirectionZ, E2Y));
+	__m128 PY = _mm_sub_ps(_mm_mul_ps(Ray->DirectionZ, E2X), _mm_mul_ps(Ray->DirectionX, E2Z));
+	__m128 PZ = _mm_sub_ps(_mm_mul_ps(Ray->DirectionX, E2Y), _mm_mul_ps(Ray->DirectionY, E2X));
+	__m128 Det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(E1X, PX), _mm_mul_ps(E1Y, PY)), _mm_mul_ps(E1Z, PZ));
+	__m128 InvDet = _mm_div_ps(_mm_set1_ps(1.0f), Det);
+
+	__m128 SX = _mm_sub_ps(Ray->OriginX, _mm_load_ps(Block->V0X));
+	__m128 SY = _mm_sub_ps(Ray->OriginY, _mm_load_ps(Block->V0Y));
+	__m128 SZ = _mm_sub_ps(Ray->OriginZ, _mm_load_ps(Block->V0Z));
+	__m128 HitU = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(SX, PX), _mm_mul_ps(SY, PY)), _mm_mul_ps(SZ, PZ)), InvDet);
+
+	// NOTE(georgy): Q = S x E1
+	__m128 QX = _mm_sub_ps(_mm_mul_ps(SY, E1Z), _mm_mul_ps(SZ, E1Y));
+	__m128 QY = _mm_sub_ps(_mm_mul_ps(SZ, E1X), _mm_mul_ps(SX, E1Z));
+	__m128 QZ = _mm_sub_ps(_mm_mul_ps(SX, E1Y), _mm_mul_ps(SY, E1X));
+	__m128 HitV = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Ray->DirectionX, QX), _mm_mul_ps(Ray->DirectionY, QY)), _mm_mul_ps(Ray->DirectionZ, QZ)), InvDet);
+	__m128 HitT = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(E2X, QX), _mm_mul_ps(E2Y, QY)), _mm_mul_ps(E2Z, QZ)), InvDet);
+
+	// NOTE(georgy): Degenerate lanes have Det = 0, so U, V and T are NaN or inf and every compare below fails for them
+	__m128 Zero = _mm_setzero_ps();
+	__m128 Hit = _mm_and_ps(_mm_cmpneq_ps(Det, Zero), _mm_cmpge_ps(HitU, Zero));
+	Hit = _mm_and_ps(Hit, _mm_cmpge_ps(HitV, Zero));
+	Hit = _mm_and_ps(Hit, _mm_cmple_ps(_mm_add_ps(HitU, HitV), _mm_set1_ps(1.0f)));
+	Hit = _mm_and_ps(Hit, _mm_cmpgt_ps(HitT, Zero));
+	Hit = _mm_and_ps(Hit, _mm_cmplt_ps(HitT, MaxT));
+
+	*T = HitT;
+	*U = HitU;
+	*V = HitV;
+	int Result = _mm_movemask_ps(Hit);
+	return(Result);
+}
+
+// NOTE(georgy): Closest hit along Origin + T*Direction for T in (0, MaxT). Triangle is BVH_NO_TRIANGLE on a miss.
+static bvh_hit
+IntersectTriangleBVH(triangle_bvh *BVH, v3 Origin, v3 Direction, real32 MaxT)
+{
+	bvh_hit Result = {MaxT, 0.0f, 0.0f, BVH_NO_TRIANGLE};
+	bvh_ray Ray = MakeBVHRay(Origin, Direction);
+
+	uint32_t Stack[BVH_STACK_SIZE];
+	real32 StackT[BVH_STACK_SIZE];
+	uint32_t StackCount = 0;
+	Stack[StackCount] = 0;
+	StackT[StackCount++] = 0.0f;
+	while(StackCount)
+	{
+		StackCount--;
+		if(StackT[StackCount] >= Result.T)
+		{
+			continue;
+		}
+
+		bvh4_node *Node = BVH->Nodes + Stack[StackCount];
+		alignas(16) real32 TEnter[4];
+		__m128 Enter;
+		int Mask = IntersectBVH4Node(Node, &Ray, _mm_set1_ps(Result.T), &Enter);
+		_mm_store_ps(TEnter, Enter);
+
+		// NOTE(georgy): Leaves right away, they may shorten the ray before the inner children are pushed
+		uint32_t Inner[4];
+		uint32_t InnerCount = 0;
+		while(Mask)
+		{
+			uint32_t Child = FindLeastSignificantSetBit(Mask);
+			Mask &= Mask - 1;
+
+			uint32_t Code = Node->Children[Child];
+			if(Code & BVH4_LEAF_FLAG)
+			{
+				if(TEnter[Child] < Result.T)
+				{
+					bvh_triangle_block *Block = BVH->Blocks + (Code & ~BVH4_LEAF_FLAG);
+					alignas(16) real32 T[4], U[4], V[4];
+					__m128 HitT, HitU, HitV;
+					int HitMask = IntersectBVHTriangleBlock(Block, &Ray, _mm_set1_ps(Result.T), &HitT, &HitU, &HitV);
+					if(HitMask)
+					{
+						_mm_store_ps(T, HitT);
+						_mm_store_ps(U, HitU);
+						_mm_store_ps(V, HitV);
+						while(HitMask)
+						{
+							uint32_t Lane = FindLeastSignificantSetBit(HitMask);
+							HitMask &= HitMask - 1;
+							if(T[Lane] < Result.T)
+							{
+								Result.T = T[Lane];
+								Result.U = U[Lane];
+								Result.V = V[Lane];
+								Result.Triangle = Block->Triangles[Lane];
+							}
+						}
+					}
+				}
+			}
+			else
+			{
+				Inner[InnerCount++] = Child;
+			}
+		}
+
+		// NOTE(georgy): Farthest pushed first, so the nearest is visited next
+		for(uint32_t I = 1; I < InnerCount; I++)
+		{
+			uint32_t Child = Inner[I];
+			uint32_t J = I;
+			while((J > 0) && (TEnter[Inner[J - 1]] < TEnter[Child]))
+			{
+				Inner[J] = Inner[J - 1];
+				J--;
+			}
+			Inner[J] = Child;
+		}
+		Assert(StackCount + InnerCount <= BVH_STACK_SIZE);
+		for(uint32_t I = 0; I < InnerCount; I++)
+		{
+			Stack[StackCount] = Node->Children[Inner[I]];
+			StackT[StackCount++] = TEnter[Inner[I]];
+		}
+	}
+
+	return(Result);
+}
+
+// NOTE(georgy): Whether anything is hit in (0, MaxT), stops at the first hit. For shadow and occlusion rays.
+static bool
+OccludedTriangleBVH(triangle_bvh *BVH, v3 Origin, v3 Direction, real32 MaxT)
+{
+	bvh_ray Ray = MakeBVHRay(Origin, Direction);
+	__m128 RayMaxT = _mm_set1_ps(MaxT);
+
+	uint32_t Stack[BVH_STACK_SIZE];
+	uint32_t StackCount = 0;
+	Stack[StackCount++] = 0;
+	while(StackCount)
+	{
+		bvh4_node *Node = BVH->Nodes + Stack[--StackCount];
+		__m128 Enter;
+		int Mask = IntersectBVH4Node(Node, &Ray, RayMaxT, &Enter);
+		while(Mask)
+		{
+			uint32_t Child = FindLeastSignificantSetBit(Mask);
+			Mask &= Mask - 1;
+
+			uint32_t Code = Node->Children[Child];
+			if(Code & BVH4_LEAF_FLAG)
+			{
+				__m128 T, U, V;
+				if(IntersectBVHTriangleBlock(BVH->Blocks + (Code & ~BVH4_LEAF_FLAG), &Ray, RayMaxT, &T, &U, &V))
+				{
+					return(true);
+				}
+			}
+			else
+			{
+				Assert(StackCount < BVH_STACK_SIZE);
+				Stack[StackCount++] = Code;
+			}
+		}
+	}
+
+	return(false);
+}
+
+//
+// NOTE(georgy): Packet traversal, SIMD over 4 rays. A node is entered if any of the rays hits it.
+//
+
+struct bvh_packet
+{
+	__m128 OriginX, OriginY, OriginZ;
+	__m128 DirectionX, DirectionY, DirectionZ;
+	__m128 InvDirectionX, InvDirectionY, InvDirectionZ;
+};
+
+static bvh_packet
+MakeBVHPacket(bvh_ray_packet *Packet)
+{
+	bvh_packet Result;
+
+	alignas(16) real32 DX[4], DY[4], DZ[4];
+	for(uint32_t Lane = 0; Lane < 4; Lane++)
+	{
+		DX[Lane] = SafeBVHDirection(Packet->DirectionX[Lane]);
+		DY[Lane] = SafeBVHDirection(Packet->DirectionY[Lane]);
+		DZ[Lane] = SafeBVHDirection(Packet->DirectionZ[Lane]);
+	}
+	Result.OriginX = _mm_load_ps(Packet->OriginX);
+	Result.OriginY = _mm_load_ps(Packet->OriginY);
+	Result.OriginZ = _mm_load_ps(Packet->OriginZ);
+	Result.DirectionX = _mm_load_ps(DX);
+	Result.DirectionY = _mm_load_ps(DY);
+	Result.DirectionZ = _mm_load_ps(DZ);
+	Result.InvDirectionX = _mm_div_ps(_mm_set1_ps(1.0f), Result.DirectionX);
+	Result.InvDirectionY = _mm_div_ps(_mm_set1_ps(1.0f), Result.DirectionY);
+	Result.InvDirectionZ = _mm_div_ps(_mm_set1_ps(1.0f), Result.DirectionZ);
+
+	return(Result);
+}
+
+// NOTE(georgy): One child box against the 4 rays. Returns the lanes that hit it before their T, and the smallest entry distance.
+inline int
+IntersectBVHPacketBox(bvh4_node *Node, uint32_t Child, bvh_packet *Packet, __m128 MaxT, real32 *MinEnter)
+{
+	__m128 T0X = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->MinX[Child]), Packet->OriginX), Packet->InvDirectionX);
+	__m128 T1X = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->MaxX[Child]), Packet->OriginX), Packet->InvDirectionX);
+	__m128 T0Y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->MinY[Child]), Packet->OriginY), Packet->InvDirectionY);
+	__m128 T1Y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->MaxY[Child]), Packet->OriginY), Packet->InvDirectionY);
+	__m128 T0Z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->MinZ[Child]), Packet->OriginZ), Packet->InvDirectionZ);
+	__m128 T1Z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->MaxZ[Child]), Packet->OriginZ), Packet->InvDirectionZ);
+
+	__m128 Enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(T0X, T1X), _mm_min_ps(T0Y, T1Y)), _mm_max_ps(_mm_min_ps(T0Z, T1Z), _mm_setzero_ps()));
+	__m128 Exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(T0X, T1X), _mm_max_ps(T0Y, T1Y)), _mm_min_ps(_mm_max_ps(T0Z, T1Z), MaxT));
+	__m128 Hit = _mm_cmple_ps(Enter, Exit);
+
+	__m128 HitEnter = _mm_or_ps(_mm_and_ps(Hit, Enter), _mm_andnot_ps(Hit, _mm_set1_ps(FLT_MAX)));
+	HitEnter = _mm_min_ps(HitEnter, _mm_shuffle_ps(HitEnter, HitEnter, _MM_SHUFFLE(2, 3, 0, 1)));
+	HitEnter = _mm_min_ps(HitEnter, _mm_shuffle_ps(HitEnter, HitEnter, _MM_SHUFFLE(1, 0, 3, 2)));
+	*MinEnter = _mm_cvtss_f32(HitEnter);
+
+	int Result = _mm_movemask_ps(Hit);
+	return(Result);
+}
+
+// NOTE(georgy): Triangle Lane of the block against the 4 rays, same math as IntersectBVHTriangleBlock
+inline __m128
+IntersectBVHPacketTriangle(bvh_triangle_block *Block, uint32_t Lane, bvh_packet *Packet, __m128 MaxT, __m128 *T, __m128 *U, __m128 *V)
+{
+	__m128 E1X = _mm_set1_ps(Block->Edge1X[Lane]), E1Y = _mm_set1_ps(Block->Edge1Y[Lane]), E1Z = _mm_set1_ps(Block->Edge1Z[Lane]);
+	__m128 E2X = _mm_set1_ps(Block->Edge2X[Lane]), E2Y = _mm_set1_ps(Block->Edge2Y[Lane]), E2Z = _mm_set1_ps(Block->Edge2Z[Lane]);
+
+	__m128 PX = _mm_sub_ps(_mm_mul_ps(Packet->DirectionY, E2Z), _mm_mul_ps(Packet->DirectionZ, E2Y));
+	__m128 PY = _mm_sub_ps(_mm_mul_ps(Packet->DirectionZ, E2X), _mm_mul_ps(Packet->DirectionX, E2Z));
+	__m128 PZ = _mm_sub_ps(_mm_mul_ps(Packet->DirectionX, E2Y), _mm_mul_ps(Packet->DirectionY, E2X));
+	__m128 Det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(E1X, PX), _mm_mul_ps(E1Y, PY)), _mm_mul_ps(E1Z, PZ));
+	__m128 InvDet = _mm_div_ps(_mm_set1_ps(1.0f), Det);
+
+	__m128 SX = _mm_sub_ps(Packet->OriginX, _mm_set1_ps(Block->V0X[Lane]));
+	__m128 SY = _mm_sub_ps(Packet->OriginY, _mm_set1_ps(Block->V0Y[Lane]));
+	__m128 SZ = _mm_sub_ps(Packet->OriginZ, _mm_set1_ps(Block->V0Z[Lane]));
+	__m128 HitU = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(SX, PX), _mm_mul_ps(SY, PY)), _mm_mul_ps(SZ, PZ)), InvDet);
+
+	__m128 QX = _mm_sub_ps(_mm_mul_ps(SY, E1Z), _mm_mul_ps(SZ, E1Y));
+	__m128 QY = _mm_sub_ps(_mm_mul_ps(SZ, E1X), _mm_mul_ps(SX, E1Z));
+	__m128 QZ = _mm_sub_ps(_mm_mul_ps(SX, E1Y), _mm_mul_ps(SY, E1X));
+	__m128 HitV = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Packet->DirectionX, QX), _mm_mul_ps(Packet->DirectionY, QY)), _mm_mul_ps(Packet->DirectionZ, QZ)), InvDet);
+	__m128 HitT = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(E2X, QX), _mm_mul_ps(E2Y, QY)), _mm_mul_ps(E2Z, QZ)), InvDet);
+
+	__m128 Zero = _mm_setzero_ps();
+	__m128 Result = _mm_and_ps(_mm_cmpneq_ps(Det, Zero), _mm_cmpge_ps(HitU, Zero));
+	Result = _mm_and_ps(Result, _mm_cmpge_ps(HitV, Zero));
+	Result = _mm_and_ps(Result, _mm_cmple_ps(_mm_add_ps(HitU, HitV), _mm_set1_ps(1.0f)));
+	Result = _mm_and_ps(Result, _mm_cmpgt_ps(HitT, Zero));
+	Result = _mm_and_ps(Result, _mm_cmplt_ps(HitT, MaxT));
+
+	*T = HitT;
+	*U = HitU;
+	*V = HitV;
+	return(Result);
+}
+
+inline __m128
+SelectBVH(__m128 Mask, __m128 A, __m128 B)
+{
+	__m128 Result = _mm_or_ps(_mm_and_ps(Mask, A), _mm_andnot_ps(Mask, B));
+	return(Result);
+}
+
+// NOTE(georgy): Closest hits of the 4 rays, Packet->T/U/V/Triangles get the results
+static void
+IntersectTriangleBVHPacket(triangle_bvh *BVH, bvh_ray_packet *RayPacket, bool AnyHit = false)
+{
+	bvh_packet Packet = MakeBVHPacket(RayPacket);
+	__m128 BestT = _mm_load_ps(RayPacket->MaxT);
+	__m128 BestU = _mm_setzero_ps(), BestV = _mm_setzero_ps();
+	__m128 BestTriangle = _mm_castsi128_ps(_mm_set1_epi32((int)BVH_NO_TRIANGLE));
+
+	// NOTE(georgy): For any hit, occluded rays get T = -1, which no box or triangle can be in front of
+	__m128 Occluded = _mm_setzero_ps();
+	int AllOccluded = 0;
+	int ActiveMask = _mm_movemask_ps(_mm_cmpgt_ps(BestT, _mm_setzero_ps()));
+
+	uint32_t Stack[BVH_STACK_SIZE];
+	real32 StackT[BVH_STACK_SIZE];
+	uint32_t StackCount = 0;
+	Stack[StackCount] = 0;
+	StackT[StackCount++] = 0.0f;
+	while(StackCount && (AllOccluded != ActiveMask))
+	{
+		StackCount--;
+		alignas(16) real32 MaxT[4];
+		_mm_store_ps(MaxT, BestT);
+		if(StackT[StackCount] >= fmaxf(fmaxf(MaxT[0], MaxT[1]), fmaxf(MaxT[2], MaxT[3])))
+		{
+			continue;
+		}
+
+		bvh4_node *Node = BVH->Nodes + Stack[StackCount];
+		uint32_t Inner[4];
+		real32 InnerT[4];
+		uint32_t InnerCount = 0;
+		for(uint32_t Child = 0; Child < 4; Child++)
+		{
+			uint32_t Code = Node->Children[Child];
+			if(Code == BVH4_EMPTY_CHILD)
+			{
+				continue;
+			}
+
+			real32 MinEnter;
+			if(!IntersectBVHPacketBox(Node, Child, &Packet, BestT, &MinEnter))
+			{
+				continue;
+			}
+
+			if(Code & BVH4_LEAF_FLAG)
+			{
+				bvh_triangle_block *Block = BVH->Blocks + (Code & ~BVH4_LEAF_FLAG);
+				for(uint32_t Lane = 0; (Lane < 4) && (Block->Triangles[Lane] != BVH_NO_TRIANGLE); Lane++)
+				{
+					__m128 T, U, V;
+					__m128 Hit = IntersectBVHPacketTriangle(Block, Lane, &Packet, BestT, &T, &U, &V);
+					if(_mm_movemask_ps(Hit))
+					{
+						if(AnyHit)
+						{
+							Occluded = _mm_or_ps(Occluded, Hit);
+							BestT = SelectBVH(Hit, _mm_set1_ps(-1.0f), BestT);
+						}
+						else
+						{
+							BestT = SelectBVH(Hit, T, BestT);
+							BestU = SelectBVH(Hit, U, BestU);
+							BestV = SelectBVH(Hit, V, BestV);
+							BestTriangle = SelectBVH(Hit, _mm_castsi128_ps(_mm_set1_epi32((int)Block->Triangles[Lane])), BestTriangle);
+						}
+					}
+				}
+				AllOccluded = _mm_movemask_ps(Occluded) & ActiveMask;
+			}
+			else
+			{
+				Inner[InnerCount] = Code;
+				InnerT[InnerCount++] = MinEnter;
+			}
+		}
+
+		for(uint32_t I = 1; I < InnerCount; I++)
+		{
+			uint32_t Code = Inner[I];
+			real32 T = InnerT[I];
+			uint32_t J = I;
+			while((J > 0) && (InnerT[J - 1] < T))
+			{
+				Inner[J] = Inner[J - 1];
+				InnerT[J] = InnerT[J - 1];
+				J--;
+			}
+			Inner[J] = Code;
+			InnerT[J] = T;
+		}
+		Assert(StackCount + InnerCount <= BVH_STACK_SIZE);
+		for(uint32_t I = 0; I < InnerCount; I++)
+		{
+			Stack[StackCount] = Inner[I];
+			StackT[StackCount++] = InnerT[I];
+		}
+	}
+
+	_mm_store_ps(RayPacket->T, BestT);
+	_mm_store_ps(RayPacket->U, BestU);
+	_mm_store_ps(RayPacket->V, BestV);
+	_mm_store_ps((real32 *)RayPacket->Triangles, BestTriangle);
+}
+
+// NOTE(georgy): Occluded rays come back with T = -1, the rest keep their MaxT
+static void
+OccludedTriangleBVHPacket(triangle_bvh *BVH, bvh_ray_packet *RayPacket)
+{
+	IntersectTriangleBVHPacket(BVH, RayPacket, true);
+}
@@ -769,6 +769,40 @@ LookAt(v3 From, v3 Target, v3 UpAxis = V3(0.0f, 1.0f, 0.0f))
 	return(Result);
 }
 
+// NOTE(georgy): Inverse of a matrix made of scales, rotations and translations (last column 0, 0, 0, 1).
+// Row vectors: p' = p*A + t, so p = p'*Inverse(A) - t*Inverse(A).
+static mat4
+InverseAffine(mat4 M)
+{
+	mat4 Result;
+
+	real32 C11 = M.a22*M.a33 - M.a23*M.a32;
+	real32 C12 = M.a23*M.a31 - M.a21*M.a33;
+	real32 C13 = M.a21*M.a32 - M.a22*M.a31;
+	real32 InvDet = 1.0f / (M.a11*C11 + M.a12*C12 + M.a13*C13);
+
+	Result.a11 = C11*InvDet;
+	Result.a12 = (M.a13*M.a32 - M.a12*M.a33)*InvDet;
+	Result.a13 = (M.a12*M.a23 - M.a13*M.a22)*InvDet;
+	Result.a21 = C12*InvDet;
+	Result.a22 = (M.a11*M.a33 - M.a13*M.a31)*InvDet;
+	Result.a23 = (M.a13*M.a21 - M.a11*M.a23)*InvDet;
+	Result.a31 = C13*InvDet;
+	Result.a32 = (M.a12*M.a31 - M.a11*M.a32)*InvDet;
+	Result.a33 = (M.a11*M.a22 - M.a12*M.a21)*InvDet;
+
+	Result.a41 = -(M.a41*Result.a11 + M.a42*Result.a21 + M.a43*Result.a31);
+	Result.a42 = -(M.a41*Result.a12 + M.a42*Result.a22 + M.a43*Result.a32);
+	Result.a43 = -(M.a41*Result.a13 + M.a42*Result.a23 + M.a43*Result.a33);
+
+	Result.a14 = 0.0f;
+	Result.a24 = 0.0f;
+	Result.a34 = 0.0f;
+	Result.a44 = 1.0f;
+
+	return(Result);
+}
+
 static mat4 
 Orthographic(float Left, float Right, float Bottom, float Top, float Near, float Far)
 {